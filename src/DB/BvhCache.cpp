@@ -0,0 +1,239 @@
+#include <DB/BvhCache.hpp>
+#include <DB/CacheFile.hpp>
+#include <DB/Hash.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhGeometry;
+using Renderer::Host::BvhNode;
+using Renderer::Host::BvhReport;
+using Renderer::Host::BvhTriangle;
+
+namespace {
+
+const char MAGIC[8] = {'E', 'X', 'P', 'B', 'V', 'H', 0, 0};
+constexpr uint32_t LAYOUT = (uint32_t)sizeof(BvhNode) << 16 | (uint32_t)sizeof(BvhTriangle);
+constexpr uint32_t STACK = 128; // Bvh::intersect's traversal stack: one entry per level at most
+
+inline uint64_t floatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline bool inside(const Repository::ExpBvhSection& section, uint64_t fileBytes, size_t element) {
+  return section.bytes % element == 0 && Repository::inFile(section.offset, section.bytes, fileBytes, Repository::BvhCache::ALIGNMENT);
+}
+
+} // namespace
+
+
+uint64_t Repository::BvhCache::key(const std::vector<BvhGeometry>& geometries, const BvhCacheSettings& settings) {
+  uint64_t hash = Hash::mix(VERSION);
+  for (const BvhGeometry& geometry : geometries) {
+    hash = Hash::combine(hash, geometry.vertexCount);
+    hash = Hash::combine(hash, geometry.vertexStride);
+    hash = Hash::combine(hash, geometry.triangleCount);
+    hash = Hash::combine(hash, geometry.indexSize);
+    // The last vertex only needs its position
+    const size_t vertexBytes = geometry.vertexCount ? (geometry.vertexCount - 1) * geometry.vertexStride + sizeof(EXP::MATH::packed3) : 0;
+    hash = Hash::combine(hash, Hash::bytes(geometry.vertices, vertexBytes));
+    hash = Hash::combine(hash, Hash::bytes(geometry.indices, geometry.triangleCount * 3 * geometry.indexSize));
+  }
+  // Everything that shapes the tree; the thread count does not
+  const Renderer::Host::BvhSettings& bvh = settings.bvh;
+  for (uint64_t value : {(uint64_t)settings.build, (uint64_t)bvh.bins, (uint64_t)bvh.maxLeafSize, floatBits(bvh.traversalCost),
+                         floatBits(bvh.intersectionCost), (uint64_t)bvh.taskSize, (uint64_t)bvh.mortonBits,
+                         floatBits(bvh.spatialBudget), floatBits(bvh.spatialAlpha), (uint64_t)settings.layout.order,
+                         (uint64_t)settings.layout.triangles}) {
+    hash = Hash::combine(hash, value);
+  }
+  return hash ? hash : 1;
+}
+
+std::string Repository::BvhCache::fileName(uint64_t key) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.expbvh", (unsigned long long)key);
+  return name;
+}
+
+BvhReport Repository::BvhCache::build(const std::vector<BvhGeometry>& geometries, Bvh& bvh, const BvhCacheSettings& settings) {
+  const auto start = std::chrono::steady_clock::now();
+  BvhReport report;
+  if (settings.build == BvhBuild::SPATIAL) report = Renderer::Host::BvhBuilder::spatial(geometries, bvh, settings.bvh);
+  else if (settings.build == BvhBuild::LINEAR) report = Renderer::Host::BvhBuilder::linear(geometries, bvh, settings.bvh);
+  else report = Renderer::Host::BvhBuilder::binnedSah(geometries, bvh, settings.bvh);
+  Renderer::Host::BvhLayout::reorder(bvh, settings.layout);
+  report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return report;
+}
+
+
+bool Repository::BvhCache::write(
+  const std::string& path,
+  const Bvh& bvh,
+  uint64_t key,
+  const BvhReport& report,
+  std::string* error
+) {
+  // open() takes children after their parent only: linear builds left in build order are not cached
+  for (size_t i = 0; i < bvh.nodes.size(); i++) {
+    if (!bvh.nodes[i].isLeaf() && bvh.nodes[i].index <= i) return fail(error, "Cache needs children after their parent: lay the tree out first");
+  }
+
+  ExpBvhHeader header = {};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.alignment = ALIGNMENT;
+  header.key = key;
+  header.layout = LAYOUT;
+  header.flags = (bvh.spatial ? SPATIAL : 0) | (bvh.leafOrder ? LEAF_ORDER : 0);
+  header.sahCost = report.sahCost;
+  header.leaves = report.leaves;
+  header.references = report.references;
+  header.depth = report.depth;
+  header.buildSeconds = report.seconds;
+
+  uint64_t offset = alignUp(sizeof(ExpBvhHeader), ALIGNMENT);
+  auto place = [&](ExpBvhSection& section, uint64_t bytes) {
+    section = {offset, bytes};
+    offset = alignUp(offset + bytes, ALIGNMENT);
+  };
+  place(header.nodes, bvh.nodes.size() * sizeof(BvhNode));
+  place(header.primitives, bvh.primitives.size() * sizeof(uint32_t));
+  place(header.triangles, bvh.triangles.size() * sizeof(BvhTriangle));
+  place(header.geometryFirst, bvh.geometryFirst.size() * sizeof(uint32_t));
+  header.fileBytes = offset;
+
+  CacheWriter file(path, ALIGNMENT);
+  file.put(&header, sizeof(header));
+  file.padTo(header.nodes.offset);
+  file.put(bvh.nodes.data(), header.nodes.bytes);
+  file.padTo(header.primitives.offset);
+  file.put(bvh.primitives.data(), header.primitives.bytes);
+  file.padTo(header.triangles.offset);
+  file.put(bvh.triangles.data(), header.triangles.bytes);
+  file.padTo(header.geometryFirst.offset);
+  file.put(bvh.geometryFirst.data(), header.geometryFirst.bytes);
+  file.padTo(header.fileBytes);
+  return file.commit(error);
+}
+
+BvhReport Repository::BvhCache::fetch(
+  const std::string& path,
+  uint64_t key,
+  const std::vector<BvhGeometry>& geometries,
+  Bvh& bvh,
+  const BvhCacheSettings& settings,
+  bool* cached,
+  std::string* error
+) {
+  const auto start = std::chrono::steady_clock::now();
+  BvhCache cache;
+  if (cache.open(path, key, error)) {
+    cache.toBvh(bvh);
+    BvhReport result = cache.report();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (cached) *cached = true;
+    return result;
+  }
+  if (cached) *cached = false;
+  const BvhReport result = build(geometries, bvh, settings);
+  write(path, bvh, key, result, error);
+  return result;
+}
+
+
+bool Repository::BvhCache::open(const std::string& path, uint64_t key, std::string* error) {
+  close();
+  std::unique_ptr<MappedFile> mapped = std::make_unique<MappedFile>();
+  if (!mapped->open(path)) return fail(error, "No cache: " + path);
+
+  const uint64_t size = mapped->size();
+  const char* base = mapped->data();
+  if (!isCache<ExpBvhHeader>(base, size, MAGIC)) return fail(error, "Not an expbvh file: " + path);
+  const ExpBvhHeader* candidate = (const ExpBvhHeader*)base;
+  const bool version = candidate->version == VERSION && candidate->alignment == ALIGNMENT && candidate->layout == LAYOUT;
+  if (!checkCache(version, candidate->key == key, candidate->fileBytes == size, path, error)) return false;
+
+  const ExpBvhHeader& h = *candidate;
+  if (!inside(h.nodes, size, sizeof(BvhNode)) || !inside(h.primitives, size, sizeof(uint32_t)) ||
+      !inside(h.triangles, size, sizeof(BvhTriangle)) || !inside(h.geometryFirst, size, sizeof(uint32_t)) ||
+      h.nodes.bytes == 0 || h.geometryFirst.bytes == 0) {
+    return fail(error, "Cache is corrupt: " + path);
+  }
+  // Traversal trusts the indices, so they are checked once here. Children after their parent, so
+  // it cannot loop, and no deeper than its stack
+  const BvhNode* nodes = (const BvhNode*)(base + h.nodes.offset);
+  const uint32_t* primitives = (const uint32_t*)(base + h.primitives.offset);
+  const size_t nodeCount = h.nodes.bytes / sizeof(BvhNode), entryCount = h.primitives.bytes / sizeof(uint32_t);
+  const size_t triangleCount = h.triangles.bytes / sizeof(BvhTriangle);
+  const bool leafOrder = h.flags & LEAF_ORDER;
+  if (leafOrder && triangleCount != entryCount) return fail(error, "Cache is corrupt: " + path);
+  std::vector<uint32_t> depth(nodeCount, 0);
+  for (size_t i = 0; i < nodeCount; i++) {
+    const BvhNode& node = nodes[i];
+    if (node.isLeaf()) {
+      if ((uint64_t)node.index + node.count > entryCount) return fail(error, "Cache is corrupt: " + path);
+      continue;
+    }
+    if (node.index <= i || (uint64_t)node.index + 2 > nodeCount || depth[i] + 1 >= STACK) {
+      return fail(error, "Cache is corrupt: " + path);
+    }
+    for (uint32_t child : {node.index, node.index + 1}) depth[child] = std::max(depth[child], depth[i] + 1);
+  }
+  // Geometry ranges start at 0 and never run backwards; without leaf order they end at the triangles
+  const uint32_t* geometryFirst = (const uint32_t*)(base + h.geometryFirst.offset);
+  const size_t geometryEntries = h.geometryFirst.bytes / sizeof(uint32_t);
+  if (geometryFirst[0] != 0) return fail(error, "Cache is corrupt: " + path);
+  for (size_t g = 1; g < geometryEntries; g++) {
+    if (geometryFirst[g] < geometryFirst[g - 1]) return fail(error, "Cache is corrupt: " + path);
+  }
+  const uint64_t ids = geometryFirst[geometryEntries - 1];
+  if (!leafOrder && ids != triangleCount) return fail(error, "Cache is corrupt: " + path);
+  for (size_t i = 0; i < entryCount; i++) {
+    if (primitives[i] >= ids) return fail(error, "Cache is corrupt: " + path);
+  }
+
+  file = std::move(mapped);
+  header = candidate;
+  nodeData = nodes;
+  primitiveData = primitives;
+  triangleData = (const BvhTriangle*)(base + h.triangles.offset);
+  geometryFirstData = geometryFirst;
+  return true;
+}
+
+void Repository::BvhCache::close() {
+  file.reset();
+  header = nullptr;
+  nodeData = nullptr;
+  primitiveData = nullptr;
+  triangleData = nullptr;
+  geometryFirstData = nullptr;
+}
+
+void Repository::BvhCache::toBvh(Bvh& bvh) const {
+  bvh = Bvh();
+  if (!header) return;
+  bvh.nodes.assign(nodeData, nodeData + nodeCount());
+  bvh.primitives.assign(primitiveData, primitiveData + header->primitives.bytes / sizeof(uint32_t));
+  bvh.triangles.assign(triangleData, triangleData + header->triangles.bytes / sizeof(BvhTriangle));
+  bvh.geometryFirst.assign(geometryFirstData, geometryFirstData + header->geometryFirst.bytes / sizeof(uint32_t));
+  bvh.spatial = header->flags & SPATIAL;
+  bvh.leafOrder = header->flags & LEAF_ORDER;
+}
+
+BvhReport Repository::BvhCache::report() const {
+  BvhReport result;
+  if (!header) return result;
+  result.sahCost = header->sahCost;
+  result.nodes = nodeCount();
+  result.leaves = header->leaves;
+  result.depth = header->depth;
+  result.references = header->references;
+  return result;
+}
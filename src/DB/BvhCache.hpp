@@ -0,0 +1,131 @@
+#pragma once
+#include <DB/MappedFile.hpp>
+#include <Renderer/HostBvh.h>
+#include <Renderer/HostBvhLayout.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * .expbvh: a built CPU BVH, so that static geometry is built once rather than at every launch.
+ *
+ * [Header] | nodes | primitives | triangles | geometryFirst
+ *
+ * Sections are the Bvh's arrays byte for byte, each starting on ALIGNMENT: open() maps the file,
+ * checks it and hands out pointers, toBvh() copies the sections straight into the vectors. No
+ * parsing and no pointer fix-ups, so a load runs at memory speed, but it is a copy: a Bvh owns its
+ * arrays and never traverses the mapping itself.
+ *
+ * The key hashes the geometry (vertex and index bytes as BvhGeometry describes them) and every
+ * setting that changes the tree: builder, BvhSettings (not the thread count) and LayoutSettings.
+ * The cache is stale when the version, the struct layouts or the key differ; open() then fails and
+ * the caller builds again. BvhCache::fetch does all of it: load, or build, lay out and write.
+ **/
+
+namespace Repository {
+
+struct ExpBvhSection {
+  uint64_t offset = 0;
+  uint64_t bytes = 0;
+};
+
+struct ExpBvhHeader {
+  char magic[8];          // "EXPBVH"
+  uint32_t version;
+  uint32_t alignment;
+  uint64_t key;
+  uint64_t fileBytes;
+  uint32_t layout;        // sizeof(BvhNode) << 16 | sizeof(BvhTriangle)
+  uint32_t flags;         // SPATIAL | LEAF_ORDER
+  ExpBvhSection nodes;
+  ExpBvhSection primitives;
+  ExpBvhSection triangles;
+  ExpBvhSection geometryFirst;
+  double sahCost;         // BvhReport of the build
+  uint64_t leaves;
+  uint64_t references;
+  uint32_t depth;
+  uint32_t reserved;
+  double buildSeconds;
+};
+
+enum struct BvhBuild { BINNED_SAH = 0, SPATIAL = 1, LINEAR = 2 };
+
+struct BvhCacheSettings {
+  BvhBuild build = BvhBuild::BINNED_SAH;
+  Renderer::Host::BvhSettings bvh;
+  Renderer::Host::LayoutSettings layout;
+};
+
+class BvhCache {
+public:
+  BvhCache(){};
+  ~BvhCache(){};
+
+public:
+  static constexpr uint32_t VERSION = 1;
+  static constexpr uint32_t ALIGNMENT = 16384;
+  static constexpr uint32_t SPATIAL = 1;
+  static constexpr uint32_t LEAF_ORDER = 2;
+
+  // Of the geometry and the settings. Never 0.
+  static uint64_t key(const std::vector<Renderer::Host::BvhGeometry>& geometries, const BvhCacheSettings& settings);
+  // File name for a key, to keep caches of many meshes in one directory
+  static std::string fileName(uint64_t key);
+  // Builds with settings.build, then lays the tree out with settings.layout
+  static Renderer::Host::BvhReport build(
+    const std::vector<Renderer::Host::BvhGeometry>& geometries,
+    Renderer::Host::Bvh& bvh,
+    const BvhCacheSettings& settings = {}
+  );
+  // Written to a temporary file, then renamed. Needs children after their parent, as every
+  // LayoutSettings order but BUILD of a linear build leaves them
+  static bool write(
+    const std::string& path,
+    const Renderer::Host::Bvh& bvh,
+    uint64_t key,
+    const Renderer::Host::BvhReport& report = {},
+    std::string* error = nullptr
+  );
+  // The tree cached at `path` under `key`, or built and written there. `cached` tells which, and
+  // `error` why the cache was not used or not written; the report's seconds are those of the load or
+  // the build. A failed write only costs the next launch its build.
+  static Renderer::Host::BvhReport fetch(
+    const std::string& path,
+    uint64_t key,
+    const std::vector<Renderer::Host::BvhGeometry>& geometries,
+    Renderer::Host::Bvh& bvh,
+    const BvhCacheSettings& settings = {},
+    bool* cached = nullptr,
+    std::string* error = nullptr
+  );
+
+public:
+  bool open(const std::string& path, uint64_t key, std::string* error = nullptr);
+  void close();
+  // Copies the mapped sections into a Bvh
+  void toBvh(Renderer::Host::Bvh& bvh) const;
+  // Build report as written, without the seconds
+  Renderer::Host::BvhReport report() const;
+
+public:
+  inline bool isOpen() const { return header != nullptr; }
+  inline size_t nodeCount() const { return header ? header->nodes.bytes / sizeof(Renderer::Host::BvhNode) : 0; }
+  inline const Renderer::Host::BvhNode* nodes() const { return nodeData; }
+  inline const uint32_t* primitives() const { return primitiveData; }
+  inline const Renderer::Host::BvhTriangle* triangles() const { return triangleData; }
+  // What the build took when the cache was written: what a load saves
+  inline double buildSeconds() const { return header ? header->buildSeconds : 0.0; }
+
+private:
+  std::unique_ptr<MappedFile> file;
+  const ExpBvhHeader* header = nullptr;
+  const Renderer::Host::BvhNode* nodeData = nullptr;
+  const uint32_t* primitiveData = nullptr;
+  const Renderer::Host::BvhTriangle* triangleData = nullptr;
+  const uint32_t* geometryFirstData = nullptr;
+};
+
+}; // namespace Repository
@@ -0,0 +1,38 @@
+#include <DB/CacheFile.hpp>
+#include <algorithm>
+#include <filesystem>
+
+
+bool Repository::checkCache(bool version, bool key, bool size, const std::string& path, std::string* error) {
+  if (!version) return fail(error, "Cache written by another version: " + path);
+  if (!key) return fail(error, "Cache is stale: " + path);
+  if (!size) return fail(error, "Cache is truncated: " + path);
+  return true;
+}
+
+
+Repository::CacheWriter::CacheWriter(const std::string& path, uint32_t alignment)
+    : path(path), temporary(path + ".tmp"), file(temporary, std::ios::binary | std::ios::trunc), zeros(alignment, 0) {}
+
+Repository::CacheWriter::~CacheWriter() {
+  if (committed) return;
+  file.close();
+  std::error_code code;
+  std::filesystem::remove(temporary, code);
+}
+
+void Repository::CacheWriter::padTo(uint64_t offset) {
+  for (uint64_t at = (uint64_t)file.tellp(); file && at < offset; at = (uint64_t)file.tellp()) {
+    put(zeros.data(), (size_t)std::min<uint64_t>(offset - at, zeros.size()));
+  }
+}
+
+bool Repository::CacheWriter::commit(std::string* error) {
+  file.close();
+  if (!file) return fail(error, "Cannot write " + temporary);
+  std::error_code code;
+  std::filesystem::rename(temporary, path, code);
+  if (code) return fail(error, "Cannot replace " + path);
+  committed = true;
+  return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * What the .expmesh, .exptex and .expbvh caches have in common. Each file starts with 8 magic bytes
+ * and a header, then holds sections at aligned offsets.
+ *
+ * CacheWriter writes to `path`.tmp and renames that over `path` once it is complete, so a reader never
+ * maps half a file. isCache and checkCache are the checks every open() starts with, in the order that
+ * says best why a cache was not used: not a cache, another version, stale, truncated.
+ **/
+
+namespace Repository {
+
+// Sets `error` when there is one to set; false, for callers to return
+inline bool fail(std::string* error, const std::string& message) {
+  if (error) *error = message;
+  return false;
+}
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+// [offset, offset + bytes) lies in a file of `fileBytes`, offset a multiple of `alignment`
+inline bool inFile(uint64_t offset, uint64_t bytes, uint64_t fileBytes, uint64_t alignment) {
+  return offset % alignment == 0 && offset <= fileBytes && bytes <= fileBytes - offset;
+}
+
+// A whole `Header` that starts with `magic`
+template <typename Header> inline bool isCache(const char* data, uint64_t size, const char (&magic)[8]) {
+  return size >= sizeof(Header) && memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+// Header fields against what open() expects. `version` covers whatever else the format ties to it
+// (alignment, struct layouts), `key` the source hash or key, `size` the file size in the header.
+bool checkCache(bool version, bool key, bool size, const std::string& path, std::string* error);
+
+class CacheWriter {
+public:
+  CacheWriter(const std::string& path, uint32_t alignment);
+  ~CacheWriter(); // Removes the temporary file unless committed
+  CacheWriter(const CacheWriter&) = delete;
+  CacheWriter& operator=(const CacheWriter&) = delete;
+
+public:
+  inline void put(const void* data, size_t bytes) { file.write(static_cast<const char*>(data), (std::streamsize)bytes); }
+  // Zeros up to `offset`, where the next section starts
+  void padTo(uint64_t offset);
+  // Closes the temporary file and renames it over the path; false and `error` when either failed
+  bool commit(std::string* error = nullptr);
+
+private:
+  std::string path;
+  std::string temporary;
+  std::ofstream file;
+  std::vector<char> zeros;
+  bool committed = false;
+};
+
+}; // namespace Repository
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * 64-bit content hash for cache keys (not cryptographic).
+ * Four independent lanes over 32 byte blocks, so long inputs hash at memory speed.
+ **/
+
+namespace Repository {
+
+struct Hash {
+  static inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 33);
+  }
+
+  static inline uint64_t combine(uint64_t seed, uint64_t value) {
+    return mix(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+  }
+
+  static inline uint64_t bytes(const void* data, size_t size, uint64_t seed = 0) {
+    const uint64_t prime0 = 0x9e3779b185ebca87ull;
+    const uint64_t prime1 = 0xc2b2ae3d27d4eb4full;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t lanes[4] = {seed + prime0, seed + prime1, seed, seed - prime0};
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+      for (int lane = 0; lane < 4; lane++) {
+        uint64_t word;
+        memcpy(&word, p + i + lane * 8, 8);
+        lanes[lane] += word * prime1;
+        lanes[lane] = ((lanes[lane] << 31) | (lanes[lane] >> 33)) * prime0;
+      }
+    }
+    uint64_t h = (uint64_t)size * prime0;
+    for (uint64_t lane : lanes) h = combine(h, lane);
+    for (; i < size; i += 8) {
+      uint64_t word = 0;
+      memcpy(&word, p + i, size - i < 8 ? size - i : 8);
+      h = combine(h, word);
+    }
+    return mix(h);
+  }
+};
+
+}; // namespace Repository
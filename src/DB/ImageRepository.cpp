@@ -0,0 +1,744 @@
+#include <DB/ImageRepository.hpp>
+#include <DB/MappedFile.hpp>
+#include <Thread/Pool.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+using Renderer::Host::Image;
+using Renderer::Host::PixelFormat;
+
+namespace {
+
+constexpr size_t ROW_GRAIN = 32;
+constexpr uint32_t MAX_DIMENSION = 1 << 15;
+
+inline bool fail(std::string* error, const std::string& message) {
+  if (error) *error = message;
+  return false;
+}
+
+inline uint16_t u16le(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+inline uint32_t u32le(const uint8_t* p) { return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24; }
+inline uint16_t u16be(const uint8_t* p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+inline void put(uint8_t* pixel, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+  pixel[0] = r, pixel[1] = g, pixel[2] = b, pixel[3] = a;
+}
+
+inline std::string lowercaseExtension(const std::string& path) {
+  const size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos) return "";
+  std::string extension = path.substr(dot + 1);
+  for (char& c : extension) c = (char)std::tolower((unsigned char)c);
+  return extension;
+}
+
+// BMP bitfield: mask -> shift and the scale that stretches its bits to 0..255
+struct Channel {
+  uint32_t mask = 0;
+  uint32_t shift = 0;
+  uint32_t maximum = 0;
+
+  inline explicit Channel(uint32_t m = 0) : mask(m) {
+    if (!mask) return;
+    while (!((mask >> shift) & 1)) shift++;
+    maximum = mask >> shift;
+  }
+  inline uint8_t operator()(uint32_t pixel, uint8_t fallback) const {
+    if (!mask) return fallback;
+    return (uint8_t)((((pixel & mask) >> shift) * 255 + maximum / 2) / maximum);
+  }
+};
+
+
+/** JPEG **/
+
+const uint8_t ZIGZAG[64] = {
+  0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48,
+  41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+  30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+constexpr int FAST_BITS = 9;
+
+struct Huffman {
+  uint16_t fast[1 << FAST_BITS];   // length << 8 | symbol, 0 when the code is longer
+  int32_t maxcode[18];             // Largest code of each length, -1 when none
+  int32_t valptr[17];              // Index of the first symbol of each length, minus its code
+  uint8_t symbols[256];
+  bool defined = false;
+
+  bool build(const uint8_t counts[16], const uint8_t* values, size_t total) {
+    memcpy(symbols, values, total);
+    memset(fast, 0, sizeof(fast));
+    int32_t code = 0;
+    size_t k = 0;
+    for (int length = 1; length <= 16; length++) {
+      valptr[length] = (int32_t)k - code;
+      for (int i = 0; i < counts[length - 1]; i++, k++, code++) {
+        // More codes than the length has room for, before they reach fast
+        if (code >= (1 << length)) return false;
+        if (length <= FAST_BITS) {
+          const int first = code << (FAST_BITS - length);
+          for (int fill = 0; fill < 1 << (FAST_BITS - length); fill++) fast[first + fill] = (uint16_t)(length << 8 | symbols[k]);
+        }
+      }
+      maxcode[length] = counts[length - 1] ? code - 1 : -1;
+      code <<= 1;
+    }
+    maxcode[17] = INT32_MAX;
+    defined = true;
+    return true;
+  }
+};
+
+// Entropy coded segment reader: removes FF 00 stuffing, stops at markers and then feeds zeros.
+struct BitReader {
+  const uint8_t* p;
+  const uint8_t* end;
+  uint64_t bits = 0;
+  int count = 0;
+  bool marker = false;
+
+  inline void fill() {
+    while (count <= 56) {
+      uint32_t byte = 0;
+      if (!marker && p < end) {
+        byte = *p;
+        if (byte == 0xFF) {
+          const uint8_t next = p + 1 < end ? p[1] : 0xD9;
+          if (next == 0x00) p += 2;
+          else marker = true, byte = 0;
+        } else {
+          p++;
+        }
+      }
+      bits |= (uint64_t)byte << (56 - count);
+      count += 8;
+    }
+  }
+  inline uint32_t peek(int n) const { return (uint32_t)(bits >> (64 - n)); }
+  inline void skip(int n) { bits <<= n, count -= n; }
+
+  inline int decode(const Huffman& table) {
+    if (count < 16) fill();
+    const uint16_t entry = table.fast[peek(FAST_BITS)];
+    if (entry) {
+      skip(entry >> 8);
+      return entry & 0xFF;
+    }
+    int length = FAST_BITS + 1;
+    while ((int32_t)peek(length) > table.maxcode[length]) length++;
+    if (length > 16) return -1;
+    const int32_t slot = table.valptr[length] + (int32_t)peek(length);
+    if (slot < 0 || slot > 255) return -1;
+    skip(length);
+    return table.symbols[slot];
+  }
+  inline int receiveExtend(int size) {
+    if (size == 0) return 0;
+    if (count < size) fill();
+    const int value = (int)peek(size);
+    skip(size);
+    return value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+  }
+  // Drops the buffered bits and steps over the next RSTn marker
+  inline void restart() {
+    bits = 0, count = 0, marker = false;
+    while (p + 1 < end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7)) p++;
+    if (p + 1 < end) p += 2;
+  }
+};
+
+struct JpegComponent {
+  int id = 0;
+  int h = 1;
+  int v = 1;
+  int quant = 0;
+  int dcTable = 0;
+  int acTable = 0;
+  int dc = 0;                  // DC predictor
+  int blocksWide = 0;          // Padded to whole MCUs
+  int blocksHigh = 0;
+  int width = 0;               // Samples actually covered by the image
+  int height = 0;
+  std::vector<int32_t> coefficients; // Dequantized, natural order, 64 per block
+  std::vector<uint8_t> samples;      // blocksWide * 8 per row
+};
+
+struct Jpeg {
+  const uint8_t* data;
+  size_t size;
+  size_t at = 0;
+  std::string* error = nullptr;
+
+  uint16_t quant[4][64] = {};
+  Huffman dc[4] = {};
+  Huffman ac[4] = {};
+  std::vector<JpegComponent> components = {};
+  int width = 0, height = 0;
+  int hmax = 1, vmax = 1;
+  int mcusWide = 0, mcusHigh = 0;
+  int restartInterval = 0;
+  int adobeTransform = -1;
+  bool frame = false;
+
+  bool segment(size_t& length) {
+    if (at + 2 > size) return fail(error, "JPEG segment is truncated");
+    length = u16be(data + at);
+    if (length < 2 || at + length > size) return fail(error, "JPEG segment is truncated");
+    return true;
+  }
+
+  bool readQuant(size_t end) {
+    size_t p = at + 2;
+    while (p < end) {
+      const int precision = data[p] >> 4, index = data[p] & 3;
+      p++;
+      if (p + 64 * (precision + 1) > end) return fail(error, "JPEG DQT is truncated");
+      for (int k = 0; k < 64; k++) quant[index][k] = precision ? u16be(data + p + 2 * k) : data[p + k];
+      p += 64 * (precision + 1);
+    }
+    return true;
+  }
+
+  bool readHuffman(size_t end) {
+    size_t p = at + 2;
+    while (p < end) {
+      if (p + 17 > end) return fail(error, "JPEG DHT is truncated");
+      const int type = data[p] >> 4, index = data[p] & 3;
+      const uint8_t* counts = data + p + 1;
+      size_t total = 0;
+      for (int i = 0; i < 16; i++) total += counts[i];
+      if (total > 256 || p + 17 + total > end) return fail(error, "JPEG DHT is corrupt");
+      Huffman& table = type ? ac[index] : dc[index];
+      if (!table.build(counts, data + p + 17, total)) return fail(error, "JPEG DHT is corrupt");
+      p += 17 + total;
+    }
+    return true;
+  }
+
+  bool readFrame(size_t length) {
+    const uint8_t* p = data + at + 2;
+    if (length < 8 || p[0] != 8) return fail(error, "Only 8 bit JPEG is supported");
+    height = u16be(p + 1), width = u16be(p + 3);
+    const int count = p[5];
+    if (width == 0 || height == 0) return fail(error, "JPEG has no size (DNL is not supported)");
+    if (width > (int)MAX_DIMENSION || height > (int)MAX_DIMENSION) return fail(error, "JPEG is too large");
+    if (count != 1 && count != 3) return fail(error, "Only grey and 3 component JPEG is supported");
+    if (length < 8 + 3 * (size_t)count) return fail(error, "JPEG SOF is truncated");
+    components.assign(count, JpegComponent{});
+    for (int c = 0; c < count; c++) {
+      JpegComponent& component = components[c];
+      component.id = p[6 + 3 * c];
+      component.h = p[7 + 3 * c] >> 4, component.v = p[7 + 3 * c] & 15;
+      component.quant = p[8 + 3 * c] & 3;
+      if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4) return fail(error, "JPEG sampling factors are invalid");
+      hmax = std::max(hmax, component.h), vmax = std::max(vmax, component.v);
+    }
+    mcusWide = (width + 8 * hmax - 1) / (8 * hmax);
+    mcusHigh = (height + 8 * vmax - 1) / (8 * vmax);
+    for (JpegComponent& component : components) {
+      if (hmax % component.h || vmax % component.v) return fail(error, "JPEG sampling factors are not supported");
+      component.blocksWide = mcusWide * component.h;
+      component.blocksHigh = mcusHigh * component.v;
+      component.width = (width * component.h + hmax - 1) / hmax;
+      component.height = (height * component.v + vmax - 1) / vmax;
+      component.coefficients.assign((size_t)component.blocksWide * component.blocksHigh * 64, 0);
+    }
+    frame = true;
+    return true;
+  }
+
+  bool decodeBlock(BitReader& reader, JpegComponent& component, int bx, int by) {
+    int32_t* block = component.coefficients.data() + ((size_t)by * component.blocksWide + bx) * 64;
+    const uint16_t* q = quant[component.quant];
+    const int t = reader.decode(dc[component.dcTable]);
+    if (t < 0 || t > 11) return fail(error, "JPEG entropy data is corrupt");
+    component.dc += reader.receiveExtend(t);
+    block[0] = component.dc * q[0];
+    for (int k = 1; k < 64;) {
+      const int rs = reader.decode(ac[component.acTable]);
+      if (rs < 0) return fail(error, "JPEG entropy data is corrupt");
+      const int run = rs >> 4, bits = rs & 15;
+      if (bits == 0) {
+        if (run != 15) break; // End of block
+        k += 16;
+        continue;
+      }
+      k += run;
+      if (k > 63) return fail(error, "JPEG entropy data is corrupt");
+      block[ZIGZAG[k]] = reader.receiveExtend(bits) * q[k];
+      k++;
+    }
+    return true;
+  }
+
+  bool readScan(size_t length) {
+    if (!frame) return fail(error, "JPEG scan before frame");
+    if (length < 3) return fail(error, "JPEG SOS is corrupt");
+    const uint8_t* p = data + at + 2;
+    const int count = p[0];
+    if (count < 1 || count > 4 || length < 6 + 2 * (size_t)count) return fail(error, "JPEG SOS is corrupt");
+    std::vector<JpegComponent*> scan;
+    for (int i = 0; i < count; i++) {
+      const int id = p[1 + 2 * i];
+      auto found = std::find_if(components.begin(), components.end(), [&](const JpegComponent& c) { return c.id == id; });
+      if (found == components.end()) return fail(error, "JPEG scan names an unknown component");
+      found->dcTable = p[2 + 2 * i] >> 4 & 3, found->acTable = p[2 + 2 * i] & 3;
+      if (!dc[found->dcTable].defined || !ac[found->acTable].defined) return fail(error, "JPEG scan uses an undefined table");
+      found->dc = 0;
+      scan.push_back(&*found);
+    }
+    at += length;
+
+    BitReader reader{data + at, data + size};
+    // One component: blocks in raster order over the component itself, otherwise whole MCUs
+    const bool interleaved = count > 1;
+    const int unitsWide = interleaved ? mcusWide : (scan[0]->width + 7) / 8;
+    const int unitsHigh = interleaved ? mcusHigh : (scan[0]->height + 7) / 8;
+    int untilRestart = restartInterval;
+    for (int uy = 0; uy < unitsHigh; uy++) {
+      for (int ux = 0; ux < unitsWide; ux++) {
+        if (restartInterval && untilRestart-- == 0) {
+          reader.restart();
+          for (JpegComponent* component : scan) component->dc = 0;
+          untilRestart = restartInterval - 1;
+        }
+        if (!interleaved) {
+          if (!decodeBlock(reader, *scan[0], ux, uy)) return false;
+          continue;
+        }
+        for (JpegComponent* component : scan) {
+          for (int v = 0; v < component->v; v++) {
+            for (int h = 0; h < component->h; h++) {
+              if (!decodeBlock(reader, *component, ux * component->h + h, uy * component->v + v)) return false;
+            }
+          }
+        }
+      }
+    }
+    // Continue at the marker that ended the entropy coded segment
+    at = (size_t)(reader.p - data);
+    while (at + 1 < size && !(data[at] == 0xFF && data[at + 1] != 0x00 && !(data[at + 1] >= 0xD0 && data[at + 1] <= 0xD7))) at++;
+    return true;
+  }
+
+  bool parse() {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return fail(error, "Not a JPEG file");
+    at = 2;
+    bool scanned = false;
+    while (at + 1 < size) {
+      if (data[at] != 0xFF) return fail(error, "JPEG marker expected");
+      const uint8_t marker = data[at + 1];
+      at += 2;
+      if (marker == 0xFF) {
+        at--; // Fill byte
+        continue;
+      }
+      if (marker == 0xD9) break;
+      if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) continue;
+      size_t length;
+      if (!segment(length)) return false;
+      const size_t end = at + length;
+      switch (marker) {
+      case 0xC0:
+      case 0xC1:
+        if (frame) return fail(error, "JPEG has more than one frame");
+        if (!readFrame(length)) return false;
+        break;
+      case 0xC2:
+      case 0xC6:
+      case 0xCA:
+      case 0xCE: return fail(error, "Progressive JPEG is not supported");
+      case 0xC3:
+      case 0xC5:
+      case 0xC7:
+      case 0xC9:
+      case 0xCB:
+      case 0xCD:
+      case 0xCF: return fail(error, "Lossless, hierarchical and arithmetic JPEG is not supported");
+      case 0xC4:
+        if (!readHuffman(end)) return false;
+        break;
+      case 0xDB:
+        if (!readQuant(end)) return false;
+        break;
+      case 0xDD:
+        if (length < 4) return fail(error, "JPEG DRI is truncated");
+        restartInterval = u16be(data + at + 2);
+        break;
+      case 0xEE:
+        if (length >= 14 && memcmp(data + at + 2, "Adobe", 5) == 0) adobeTransform = data[at + 13];
+        break;
+      case 0xDA:
+        if (!readScan(length)) return false;
+        scanned = true;
+        continue; // readScan moved `at` past the entropy coded data
+      default: break; // APPn, COM, ...
+      }
+      at = end;
+    }
+    if (!scanned) return fail(error, "JPEG has no scan");
+    return true;
+  }
+};
+
+// Separable float IDCT: out = C^T * F * C with C[u][x] = c(u) / 2 * cos((2x + 1) u pi / 16).
+// Both passes accumulate whole rows of eight, which the compiler turns into vector code.
+struct Idct {
+  float basis[8][8]; // [u][x]
+
+  Idct() {
+    for (int u = 0; u < 8; u++) {
+      for (int x = 0; x < 8; x++) {
+        const float scale = u == 0 ? std::sqrt(0.5f) : 1.0f;
+        basis[u][x] = 0.5f * scale * std::cos((2 * x + 1) * u * 3.14159265358979f / 16.0f);
+      }
+    }
+  }
+
+  inline void operator()(const int32_t* block, uint8_t* out, size_t stride) const {
+    float rows[8][8];
+    for (int v = 0; v < 8; v++) {
+      const int32_t* f = block + v * 8;
+      for (int x = 0; x < 8; x++) rows[v][x] = basis[0][x] * f[0];
+      for (int u = 1; u < 8; u++) {
+        if (f[u] == 0) continue;
+        for (int x = 0; x < 8; x++) rows[v][x] += basis[u][x] * f[u];
+      }
+    }
+    for (int y = 0; y < 8; y++) {
+      float column[8];
+      for (int x = 0; x < 8; x++) column[x] = 128.5f;
+      for (int v = 0; v < 8; v++) {
+        const float b = basis[v][y];
+        for (int x = 0; x < 8; x++) column[x] += b * rows[v][x];
+      }
+      // Truncation rounds: anything below zero is clamped anyway
+      for (int x = 0; x < 8; x++) out[y * stride + x] = (uint8_t)std::clamp((int)column[x], 0, 255);
+    }
+  }
+};
+
+inline uint8_t clampByte(int value) { return (uint8_t)std::clamp(value, 0, 255); }
+
+// Sample of a subsampled plane at full resolution: 2x factors use a triangle filter between the
+// two nearest samples (weights in quarters), other factors replicate. Both match libjpeg's
+// default upsampling.
+struct Upsampler {
+  std::vector<int> x0, x1;
+  std::vector<int> wx; // Weight of x1 in quarters
+
+  void prepare(int width, int scale, int samples) {
+    x0.resize(width), x1.resize(width), wx.resize(width);
+    for (int x = 0; x < width; x++) {
+      if (scale != 2) {
+        x0[x] = x1[x] = std::min(x / scale, samples - 1), wx[x] = 0;
+        continue;
+      }
+      // Source position x / 2 - 1 / 4: odd pixels lean right, even pixels lean left
+      const int left = x % 2 ? x / 2 : x / 2 - 1;
+      wx[x] = x % 2 ? 1 : 3;
+      x0[x] = std::clamp(left, 0, samples - 1);
+      x1[x] = std::clamp(left + 1, 0, samples - 1);
+    }
+  }
+};
+
+}; // namespace
+
+
+bool Repository::Images::supports(const std::string& path) {
+  const std::string extension = lowercaseExtension(path);
+  return extension == "bmp" || extension == "tga" || extension == "jpg" || extension == "jpeg";
+}
+
+bool Repository::Images::read(const std::string& path, Image& image, std::string* error, unsigned int threads) {
+  MappedFile file;
+  if (!file.open(path)) return fail(error, "Cannot open " + path);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(file.data());
+  if (!decode(data, file.size(), image, error, threads)) {
+    if (error) *error += ": " + path;
+    return false;
+  }
+  return true;
+}
+
+bool Repository::Images::decode(const uint8_t* data, size_t size, Image& image, std::string* error, unsigned int threads) {
+  if (size >= 2 && data[0] == 'B' && data[1] == 'M') return decodeBmp(data, size, image, error);
+  if (size >= 2 && data[0] == 0xFF && data[1] == 0xD8) return decodeJpeg(data, size, image, error, threads);
+  return decodeTga(data, size, image, error);
+}
+
+bool Repository::Images::write(const std::string& path, const Image& image, std::string* error) {
+  if (lowercaseExtension(path) != "tga") return fail(error, "Only TGA can be written: " + path);
+  std::vector<uint8_t> data;
+  if (!encodeTga(image, data, error)) return false;
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+  if (!file) return fail(error, "Cannot write " + path);
+  return true;
+}
+
+bool Repository::Images::encodeTga(const Image& image, std::vector<uint8_t>& data, std::string* error) {
+  if (image.format == PixelFormat::RGBA16F) return fail(error, "TGA holds 8 bit pixels only");
+  if (image.width == 0 || image.height == 0 || image.width > 0xFFFF || image.height > 0xFFFF) return fail(error, "TGA size is invalid");
+  if (image.data.size() != (size_t)image.width * image.height * 4) return fail(error, "Image data does not match its size");
+  data.assign(18 + image.data.size(), 0);
+  data[2] = 2; // True color, raw
+  data[12] = (uint8_t)image.width, data[13] = (uint8_t)(image.width >> 8);
+  data[14] = (uint8_t)image.height, data[15] = (uint8_t)(image.height >> 8);
+  data[16] = 32;
+  data[17] = 0x20 | 8; // Top down, 8 alpha bits
+  uint8_t* out = data.data() + 18;
+  for (size_t i = 0; i < image.data.size(); i += 4) {
+    out[i] = image.data[i + 2], out[i + 1] = image.data[i + 1], out[i + 2] = image.data[i], out[i + 3] = image.data[i + 3];
+  }
+  return true;
+}
+
+bool Repository::Images::decodeBmp(const uint8_t* data, size_t size, Image& image, std::string* error) {
+  if (size < 26 || data[0] != 'B' || data[1] != 'M') return fail(error, "Not a BMP file");
+  const uint32_t offset = u32le(data + 10);
+  const uint32_t headerBytes = u32le(data + 14);
+  int32_t width, height;
+  uint32_t bits, compression = 0, colors = 0;
+  if (headerBytes == 12) {
+    width = u16le(data + 18), height = u16le(data + 20), bits = u16le(data + 24);
+  } else {
+    if (headerBytes < 40 || size < 14 + (size_t)headerBytes) return fail(error, "BMP header is truncated");
+    width = (int32_t)u32le(data + 18), height = (int32_t)u32le(data + 22);
+    bits = u16le(data + 28), compression = u32le(data + 30), colors = u32le(data + 46);
+  }
+  const bool topDown = height < 0;
+  height = std::abs(height);
+  if (width <= 0 || height == 0 || width > (int32_t)MAX_DIMENSION || height > (int32_t)MAX_DIMENSION) {
+    return fail(error, "BMP size is invalid");
+  }
+  if (compression != 0 && compression != 3 && compression != 6) return fail(error, "Compressed BMP is not supported");
+
+  // Palette, or the channel masks of 16 and 32 bit images
+  std::vector<uint8_t> palette;
+  if (bits == 1 || bits == 2 || bits == 4 || bits == 8) {
+    const size_t entry = headerBytes == 12 ? 3 : 4;
+    const size_t entries = colors ? colors : (size_t)1 << bits;
+    const size_t start = 14 + headerBytes;
+    if (entries > 256 || start + entries * entry > size) return fail(error, "BMP palette is truncated");
+    palette.assign(256 * 4, 255);
+    for (size_t i = 0; i < entries; i++) {
+      const uint8_t* bgr = data + start + i * entry;
+      put(palette.data() + i * 4, bgr[2], bgr[1], bgr[0]);
+    }
+  } else if (bits != 16 && bits != 24 && bits != 32) {
+    return fail(error, "BMP bit depth " + std::to_string(bits) + " is not supported");
+  }
+  Channel red(0x00FF0000), green(0x0000FF00), blue(0x000000FF), alpha(0);
+  if (bits == 16) red = Channel(0x7C00), green = Channel(0x03E0), blue = Channel(0x001F);
+  if (compression == 3 || compression == 6) {
+    if (size < 66) return fail(error, "BMP bitfields are truncated");
+    red = Channel(u32le(data + 54)), green = Channel(u32le(data + 58)), blue = Channel(u32le(data + 62));
+    if ((compression == 6 || headerBytes >= 56) && size >= 70) alpha = Channel(u32le(data + 66));
+  }
+
+  const size_t stride = ((size_t)width * bits + 31) / 32 * 4;
+  if (offset > size || size - offset < stride * height) return fail(error, "BMP pixel data is truncated");
+
+  image.allocate((uint32_t)width, (uint32_t)height, PixelFormat::RGBA8_SRGB);
+  EXP::THREAD::parallelFor((size_t)height, ROW_GRAIN, [&](size_t first, size_t last) {
+    for (size_t y = first; y < last; y++) {
+      const uint8_t* source = data + offset + (topDown ? y : height - 1 - y) * stride;
+      uint8_t* target = image.row((uint32_t)y);
+      for (int32_t x = 0; x < width; x++, target += 4) {
+        switch (bits) {
+        case 1:
+        case 2:
+        case 4:
+        case 8: {
+          const uint32_t perByte = 8 / bits;
+          const uint32_t index = (source[x / perByte] >> ((perByte - 1 - x % perByte) * bits)) & ((1u << bits) - 1);
+          memcpy(target, palette.data() + index * 4, 4);
+          break;
+        }
+        case 16: {
+          const uint32_t pixel = u16le(source + x * 2);
+          put(target, red(pixel, 0), green(pixel, 0), blue(pixel, 0), alpha(pixel, 255));
+          break;
+        }
+        case 24: put(target, source[x * 3 + 2], source[x * 3 + 1], source[x * 3]); break;
+        default: {
+          const uint32_t pixel = u32le(source + x * 4);
+          put(target, red(pixel, 0), green(pixel, 0), blue(pixel, 0), alpha(pixel, 255));
+        }
+        }
+      }
+    }
+  });
+  return true;
+}
+
+bool Repository::Images::decodeTga(const uint8_t* data, size_t size, Image& image, std::string* error) {
+  if (size < 18) return fail(error, "Not a TGA file");
+  const uint8_t idLength = data[0], mapType = data[1], type = data[2];
+  const uint16_t mapFirst = u16le(data + 3), mapLength = u16le(data + 5);
+  const uint8_t mapBits = data[7];
+  const uint32_t width = u16le(data + 12), height = u16le(data + 14);
+  const uint8_t bits = data[16], descriptor = data[17];
+  const bool rle = type >= 9;
+  const uint8_t kind = rle ? type - 8 : type; // 1 color mapped, 2 true color, 3 grey
+  if (kind < 1 || kind > 3 || mapType > 1 || (kind == 1 && mapType != 1)) return fail(error, "Not a supported TGA file");
+  if (width == 0 || height == 0 || width > MAX_DIMENSION || height > MAX_DIMENSION) return fail(error, "TGA size is invalid");
+  if (kind == 1 ? bits != 8 : kind == 3 ? bits != 8 : (bits != 15 && bits != 16 && bits != 24 && bits != 32)) {
+    return fail(error, "TGA bit depth " + std::to_string(bits) + " is not supported");
+  }
+
+  const size_t pixelBytes = (bits + 7) / 8;
+  const size_t mapEntryBytes = (mapBits + 7) / 8;
+  size_t at = 18 + idLength;
+  const bool alphaBits = (descriptor & 15) != 0;
+
+  // Color or palette entry in file order (BGR(A), ARGB1555 or grey) to RGBA
+  auto color = [&](const uint8_t* p, size_t bytes, uint8_t* out) {
+    switch (bytes) {
+    case 1: put(out, p[0], p[0], p[0]); break;
+    case 2: {
+      const uint16_t pixel = u16le(p);
+      const auto expand = [](uint32_t five) { return (uint8_t)((five * 255 + 15) / 31); };
+      put(out, expand(pixel >> 10 & 31), expand(pixel >> 5 & 31), expand(pixel & 31), alphaBits && !(pixel & 0x8000) ? 0 : 255);
+      break;
+    }
+    case 3: put(out, p[2], p[1], p[0]); break;
+    default: put(out, p[2], p[1], p[0], p[3]);
+    }
+  };
+
+  std::vector<uint8_t> palette;
+  if (mapType == 1) {
+    if (mapEntryBytes < 2 || mapEntryBytes > 4 || at + (size_t)mapLength * mapEntryBytes > size) return fail(error, "TGA color map is invalid");
+    palette.assign(256 * 4, 0);
+    for (size_t i = 0; i < mapLength; i++) {
+      if (mapFirst + i < 256) color(data + at + i * mapEntryBytes, mapEntryBytes, palette.data() + (mapFirst + i) * 4);
+    }
+    at += (size_t)mapLength * mapEntryBytes;
+  }
+  auto pixel = [&](const uint8_t* p, uint8_t* out) {
+    if (kind == 1) memcpy(out, palette.data() + p[0] * 4, 4);
+    else color(p, pixelBytes, out);
+  };
+
+  // Too few bytes for the pixels, before allocating: an RLE packet covers at most 128 of them
+  const size_t total = (size_t)width * height;
+  const size_t left = at < size ? size - at : 0;
+  if (rle ? left / (1 + pixelBytes) * 128 < total : left / pixelBytes < total) return fail(error, "TGA pixel data is truncated");
+
+  // Pixels come in file order: rows bottom up unless bit 5, right to left when bit 4
+  image.allocate(width, height, PixelFormat::RGBA8_SRGB);
+  const bool topDown = descriptor & 0x20, rightToLeft = descriptor & 0x10;
+  auto target = [&](size_t index) {
+    const uint32_t y = (uint32_t)(index / width), x = (uint32_t)(index % width);
+    return image.row(topDown ? y : height - 1 - y) + (rightToLeft ? width - 1 - x : x) * 4;
+  };
+  if (!rle) {
+    EXP::THREAD::parallelFor(height, ROW_GRAIN, [&](size_t first, size_t last) {
+      for (size_t i = first * width; i < last * width; i++) pixel(data + at + i * pixelBytes, target(i));
+    });
+    return true;
+  }
+  for (size_t i = 0; i < total;) {
+    if (at >= size) return fail(error, "TGA pixel data is truncated");
+    const uint8_t header = data[at++];
+    const size_t run = std::min((size_t)(header & 0x7F) + 1, total - i);
+    if (header & 0x80) {
+      if (at + pixelBytes > size) return fail(error, "TGA pixel data is truncated");
+      uint8_t value[4];
+      pixel(data + at, value);
+      at += pixelBytes;
+      for (size_t k = 0; k < run; k++) memcpy(target(i++), value, 4);
+    } else {
+      if (at + run * pixelBytes > size) return fail(error, "TGA pixel data is truncated");
+      for (size_t k = 0; k < run; k++, at += pixelBytes) pixel(data + at, target(i++));
+    }
+  }
+  return true;
+}
+
+bool Repository::Images::decodeJpeg(const uint8_t* data, size_t size, Image& image, std::string* error, unsigned int threads) {
+  Jpeg jpeg{data, size};
+  jpeg.error = error;
+  if (!jpeg.parse()) return false;
+
+  // IDCT in parallel over block rows of every component
+  static const Idct idct;
+  for (JpegComponent& component : jpeg.components) {
+    const size_t stride = (size_t)component.blocksWide * 8;
+    component.samples.assign(stride * component.blocksHigh * 8, 0);
+    EXP::THREAD::parallelFor((size_t)component.blocksHigh, 4, [&](size_t first, size_t last) {
+      for (size_t by = first; by < last; by++) {
+        for (int bx = 0; bx < component.blocksWide; bx++) {
+          const int32_t* block = component.coefficients.data() + (by * component.blocksWide + bx) * 64;
+          idct(block, component.samples.data() + by * 8 * stride + bx * 8, stride);
+        }
+      }
+    }, threads);
+    std::vector<int32_t>().swap(component.coefficients);
+  }
+
+  // Upsampling and color conversion in parallel row bands
+  const int width = jpeg.width, height = jpeg.height;
+  const bool rgb = jpeg.components.size() == 3 &&
+                   (jpeg.adobeTransform == 0 ||
+                    (jpeg.components[0].id == 'R' && jpeg.components[1].id == 'G' && jpeg.components[2].id == 'B'));
+  std::vector<Upsampler> upsamplers(jpeg.components.size());
+  for (size_t c = 0; c < jpeg.components.size(); c++) {
+    const JpegComponent& component = jpeg.components[c];
+    upsamplers[c].prepare(width, jpeg.hmax / component.h, component.width);
+  }
+
+  image.allocate((uint32_t)width, (uint32_t)height, PixelFormat::RGBA8_SRGB);
+  EXP::THREAD::parallelFor((size_t)height, ROW_GRAIN, [&](size_t first, size_t last) {
+    std::vector<uint8_t> planes(jpeg.components.size() * width);
+    for (size_t y = first; y < last; y++) {
+      for (size_t c = 0; c < jpeg.components.size(); c++) {
+        const JpegComponent& component = jpeg.components[c];
+        const Upsampler& up = upsamplers[c];
+        const size_t stride = (size_t)component.blocksWide * 8;
+        uint8_t* plane = planes.data() + c * width;
+        const int vscale = jpeg.vmax / component.v, hscale = jpeg.hmax / component.h;
+        if (vscale == 1 && hscale == 1) {
+          memcpy(plane, component.samples.data() + y * stride, width);
+          continue;
+        }
+        int top = (int)y / vscale, wy = 0;
+        if (vscale == 2) top = y % 2 ? (int)y / 2 : (int)y / 2 - 1, wy = y % 2 ? 1 : 3;
+        const uint8_t* row0 = component.samples.data() + std::clamp(top, 0, component.height - 1) * stride;
+        const uint8_t* row1 = component.samples.data() + std::clamp(top + 1, 0, component.height - 1) * stride;
+        for (int x = 0; x < width; x++) {
+          const int a = row0[up.x0[x]] * (4 - up.wx[x]) + row0[up.x1[x]] * up.wx[x];
+          const int b = row1[up.x0[x]] * (4 - up.wx[x]) + row1[up.x1[x]] * up.wx[x];
+          plane[x] = (uint8_t)((a * (4 - wy) + b * wy + 8) >> 4);
+        }
+      }
+
+      uint8_t* target = image.row((uint32_t)y);
+      if (jpeg.components.size() == 1) {
+        for (int x = 0; x < width; x++) put(target + x * 4, planes[x], planes[x], planes[x]);
+      } else if (rgb) {
+        for (int x = 0; x < width; x++) put(target + x * 4, planes[x], planes[width + x], planes[2 * width + x]);
+      } else {
+        // JFIF YCbCr in 16.16 fixed point
+        for (int x = 0; x < width; x++) {
+          const int luma = planes[x] << 16, cb = planes[width + x] - 128, cr = planes[2 * width + x] - 128;
+          put(
+            target + x * 4,
+            clampByte((luma + 91881 * cr + 32768) >> 16),
+            clampByte((luma - 22554 * cb - 46802 * cr + 32768) >> 16),
+            clampByte((luma + 116130 * cb + 32768) >> 16)
+          );
+        }
+      }
+    }
+  }, threads);
+  return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <Renderer/HostImage.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Portable BMP / TGA / JPEG decoders. No MetalKit: runs headless on Linux.
+ *
+ * Every decoder produces RGBA8_SRGB, row 0 at the top, alpha 255 unless the file has one.
+ * - BMP: 1/2/4/8 bit palettes, 16/24/32 bit (BI_RGB and BI_BITFIELDS), bottom up or top down.
+ * - TGA: color mapped, true color and grey, raw or RLE, 8/15/16/24/32 bit, either origin.
+ * - JPEG: baseline and extended sequential Huffman, 8 bit, grey / YCbCr / RGB, any sampling
+ *   factors, restart markers. Entropy decoding is serial; dequantized blocks go through the
+ *   IDCT, upsampling and color conversion in parallel row bands.
+ *
+ * Writing is TGA only (32 bit, uncompressed, top down), for debug output of headless tools.
+ **/
+
+namespace Repository {
+
+class Images {
+public:
+  Images(){};
+  ~Images(){};
+
+public: // Read
+  static bool supports(const std::string& path); // By extension
+  static bool read(
+    const std::string& path,
+    Renderer::Host::Image& image,
+    std::string* error = nullptr,
+    unsigned int threads = 0
+  );
+  // Picks the decoder from the signature: "BM", FF D8, otherwise TGA
+  static bool decode(
+    const uint8_t* data,
+    size_t size,
+    Renderer::Host::Image& image,
+    std::string* error = nullptr,
+    unsigned int threads = 0
+  );
+
+public: // Write
+  // 8 bit formats only; the bytes go out as they are, no sRGB conversion
+  static bool write(const std::string& path, const Renderer::Host::Image& image, std::string* error = nullptr);
+  static bool encodeTga(const Renderer::Host::Image& image, std::vector<uint8_t>& data, std::string* error = nullptr);
+
+public: // Formats
+  static bool decodeBmp(const uint8_t* data, size_t size, Renderer::Host::Image& image, std::string* error = nullptr);
+  static bool decodeTga(const uint8_t* data, size_t size, Renderer::Host::Image& image, std::string* error = nullptr);
+  static bool decodeJpeg(
+    const uint8_t* data,
+    size_t size,
+    Renderer::Host::Image& image,
+    std::string* error = nullptr,
+    unsigned int threads = 0
+  );
+};
+
+}; // namespace Repository
@@ -0,0 +1,43 @@
+#include <DB/MappedFile.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool Repository::MappedFile::open(const std::string& path, bool copyOnWrite) {
+  close();
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) return false;
+
+  struct stat info;
+  if (fstat(descriptor, &info) != 0) {
+    ::close(descriptor);
+    return false;
+  }
+  length = (size_t)info.st_size;
+  opened = true;
+  if (length > 0) {
+    const int protection = copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* result = mmap(nullptr, length, protection, MAP_PRIVATE, descriptor, 0);
+    if (result == MAP_FAILED) {
+      ::close(descriptor);
+      length = 0;
+      opened = false;
+      return false;
+    }
+    mapping = result;
+    writes = copyOnWrite;
+    // Parsers stream through the file front to back
+    madvise(mapping, length, MADV_SEQUENTIAL);
+  }
+  ::close(descriptor);
+  return true;
+}
+
+void Repository::MappedFile::close() {
+  if (mapping) munmap(mapping, length);
+  mapping = nullptr;
+  length = 0;
+  opened = false;
+  writes = false;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/**
+ * Memory mapped file (POSIX mmap). The mapping lives as long as the object.
+ * Read-only by default; `copyOnWrite` maps private writable pages, writes never reach the file.
+ **/
+
+namespace Repository {
+
+class MappedFile {
+public:
+  MappedFile(){};
+  explicit MappedFile(const std::string& path, bool copyOnWrite = false) { open(path, copyOnWrite); }
+  ~MappedFile() { close(); }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+public:
+  bool open(const std::string& path, bool copyOnWrite = false);
+  void close();
+  inline bool isOpen() const { return mapping != nullptr || (opened && length == 0); }
+  inline const char* data() const { return static_cast<const char*>(mapping); }
+  inline char* writable() const { return writes ? static_cast<char*>(mapping) : nullptr; }
+  inline const char* end() const { return data() + length; }
+  inline size_t size() const { return length; }
+
+private:
+  void* mapping = nullptr;
+  size_t length = 0;
+  bool opened = false;
+  bool writes = false;
+};
+
+}; // namespace Repository
@@ -0,0 +1,270 @@
+#include <DB/CacheFile.hpp>
+#include <DB/Hash.hpp>
+#include <DB/MeshCache.hpp>
+#include <DB/Tokenizer.hpp>
+#include <Renderer/HostBuffer.h>
+#include <Thread/Pool.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+using HostMesh = EXP::MDL::HostMesh;
+using HostMaterial = EXP::MDL::HostMaterial;
+using PrimitiveAttributes = Renderer::Host::PrimitiveAttributes;
+using VertexAttributes = Renderer::Host::VertexAttributes;
+
+namespace {
+
+const char MAGIC[8] = {'E', 'X', 'P', 'M', 'E', 'S', 'H', 0};
+constexpr uint32_t LAYOUT = (uint32_t)sizeof(VertexAttributes) << 16 | (uint32_t)sizeof(PrimitiveAttributes);
+constexpr size_t HASH_BLOCK_BYTES = 4 << 20;
+
+// Blocks are hashed in parallel and combined in order, so the result does not depend on the thread count.
+uint64_t hashContent(const char* data, size_t size, uint64_t seed) {
+  if (size <= HASH_BLOCK_BYTES) return Repository::Hash::bytes(data, size, seed);
+  std::vector<uint64_t> blocks((size + HASH_BLOCK_BYTES - 1) / HASH_BLOCK_BYTES);
+  EXP::THREAD::parallelFor(blocks.size(), 1, [&](size_t first, size_t last) {
+    for (size_t b = first; b < last; b++) {
+      const size_t offset = b * HASH_BLOCK_BYTES;
+      blocks[b] = Repository::Hash::bytes(data + offset, std::min(HASH_BLOCK_BYTES, size - offset), seed);
+    }
+  });
+  uint64_t hash = Repository::Hash::mix(seed ^ size);
+  for (uint64_t block : blocks) hash = Repository::Hash::combine(hash, block);
+  return hash;
+}
+
+// Strings are stored back to back; records refer to them by offset and length.
+struct StringTable {
+  std::string data;
+  inline void add(const std::string& value, uint32_t& offset, uint32_t& length) {
+    offset = (uint32_t)data.size();
+    length = (uint32_t)value.size();
+    data += value;
+  }
+};
+
+inline bool inside(const Repository::ExpMeshSection& section, uint64_t fileBytes, uint64_t expectedBytes, uint64_t alignment) {
+  return section.bytes == expectedBytes && Repository::inFile(section.offset, section.bytes, fileBytes, alignment);
+}
+
+} // namespace
+
+
+uint64_t Repository::MeshCache::hashSources(const std::string& objPath) {
+  MappedFile obj(objPath);
+  if (!obj.isOpen()) return 0;
+  uint64_t hash = hashContent(obj.data(), obj.size(), VERSION);
+
+  // Material libraries change the import too (colors, texture paths)
+  const std::filesystem::path directory = std::filesystem::path(objPath).parent_path();
+  const char* end = obj.end();
+  for (const char* p = obj.data(); p < end; Tokenizer::skipLine(p, end)) {
+    Tokenizer::skipBlank(p, end);
+    if (end - p < 7 || memcmp(p, "mtllib", 6) != 0 || !Tokenizer::isBlank(p[6])) continue;
+    const char* first = p + 6;
+    Tokenizer::skipBlank(first, end);
+    const char* last = Tokenizer::lineEnd(first, end);
+    while (last > first && Tokenizer::isBlank(*(last - 1))) last--;
+    const std::string name(first, last);
+
+    MappedFile mtl((directory / name).string());
+    hash = Hash::combine(hash, Hash::bytes(name.data(), name.size()));
+    hash = Hash::combine(hash, mtl.isOpen() ? Hash::bytes(mtl.data(), mtl.size()) : 0);
+  }
+  return hash ? hash : 1;
+}
+
+
+bool Repository::MeshCache::write(
+  const std::string& path,
+  const HostMesh& mesh,
+  uint64_t sourceHash,
+  const std::vector<int>& texindices,
+  std::string* error
+) {
+  const std::string directory = std::filesystem::path(path).parent_path().string();
+  ExpMeshHeader header = {};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.alignment = ALIGNMENT;
+  header.sourceHash = sourceHash;
+  header.layout = LAYOUT;
+  header.vertexCount = (uint32_t)mesh.vertexCount();
+  header.submeshCount = (uint32_t)mesh.submeshes.size();
+  header.materialCount = (uint32_t)mesh.materials.size();
+
+  StringTable strings;
+  strings.add(mesh.name, header.name, header.nameLength);
+  std::vector<ExpMeshMaterial> materials(mesh.materials.size());
+  for (size_t m = 0; m < mesh.materials.size(); m++) {
+    const HostMaterial& source = mesh.materials[m];
+    ExpMeshMaterial& material = materials[m];
+    for (int k = 0; k < 3; k++) {
+      material.ambient[k] = source.ambient[k];
+      material.diffuse[k] = source.diffuse[k];
+      material.specular[k] = source.specular[k];
+      material.emission[k] = source.emission[k];
+    }
+    material.shininess = source.shininess;
+    strings.add(source.name, material.name, material.nameLength);
+    // Relative texture paths keep the cache valid when the asset folder moves
+    std::string texture = source.diffuseTexture;
+    if (!directory.empty() && texture.compare(0, directory.size() + 1, directory + "/") == 0) {
+      texture = texture.substr(directory.size() + 1);
+    }
+    strings.add(texture, material.texture, material.textureLength);
+  }
+
+  // Records first, then the page aligned GPU sections
+  uint64_t offset = sizeof(ExpMeshHeader);
+  header.submeshes = {offset, header.submeshCount * sizeof(ExpMeshSubmesh)};
+  offset += header.submeshes.bytes;
+  header.materials = {offset, header.materialCount * sizeof(ExpMeshMaterial)};
+  offset += header.materials.bytes;
+  header.strings = {offset, strings.data.size()};
+  offset = alignUp(offset + header.strings.bytes, ALIGNMENT);
+
+  header.vertices = {offset, mesh.vertices.size() * sizeof(EXP::MATH::packed3)};
+  offset = alignUp(offset + header.vertices.bytes, ALIGNMENT);
+  header.attributes = {offset, mesh.attributes.size() * sizeof(VertexAttributes)};
+  offset = alignUp(offset + header.attributes.bytes, ALIGNMENT);
+
+  std::vector<ExpMeshSubmesh> submeshes(mesh.submeshes.size());
+  for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+    const EXP::MDL::HostSubmesh& source = mesh.submeshes[s];
+    ExpMeshSubmesh& submesh = submeshes[s];
+    submesh.material = source.material;
+    submesh.texindex = s < texindices.size() ? texindices[s] : 0;
+    submesh.indexCount = (uint32_t)source.indices.size();
+    submesh.indices = {offset, source.indices.size() * sizeof(uint32_t)};
+    offset = alignUp(offset + submesh.indices.bytes, ALIGNMENT);
+    submesh.primitives = {offset, source.indices.size() / 3 * sizeof(PrimitiveAttributes)};
+    offset = alignUp(offset + submesh.primitives.bytes, ALIGNMENT);
+  }
+  header.fileBytes = offset;
+
+  CacheWriter file(path, ALIGNMENT);
+  file.put(&header, sizeof(header));
+  file.put(submeshes.data(), header.submeshes.bytes);
+  file.put(materials.data(), header.materials.bytes);
+  file.put(strings.data.data(), header.strings.bytes);
+  file.padTo(header.vertices.offset);
+  file.put(mesh.vertices.data(), header.vertices.bytes);
+  file.padTo(header.attributes.offset);
+  file.put(mesh.attributes.data(), header.attributes.bytes);
+
+  std::vector<PrimitiveAttributes> primitives;
+  for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+    const std::vector<uint32_t>& indices = mesh.submeshes[s].indices;
+    file.padTo(submeshes[s].indices.offset);
+    file.put(indices.data(), submeshes[s].indices.bytes);
+
+    primitives.assign(indices.size() / 3, PrimitiveAttributes{});
+    Renderer::Host::Buffer::perPrimitive(mesh.attributes.data(), indices.data(), indices.size(), submeshes[s].texindex, primitives.data());
+    file.padTo(submeshes[s].primitives.offset);
+    file.put(primitives.data(), submeshes[s].primitives.bytes);
+  }
+  file.padTo(header.fileBytes);
+  return file.commit(error);
+}
+
+
+bool Repository::MeshCache::open(const std::string& path, uint64_t sourceHash, std::string* error) {
+  close();
+  std::shared_ptr<MappedFile> mapped = std::make_shared<MappedFile>();
+  if (!mapped->open(path, true) || !mapped->writable()) return fail(error, "No cache: " + path);
+
+  const uint64_t size = mapped->size();
+  char* base = mapped->writable();
+  if (!isCache<ExpMeshHeader>(base, size, MAGIC)) return fail(error, "Not an expmesh file: " + path);
+  const ExpMeshHeader* candidate = (const ExpMeshHeader*)base;
+  const bool version = candidate->version == VERSION && candidate->alignment == ALIGNMENT && candidate->layout == LAYOUT;
+  if (!checkCache(version, candidate->sourceHash == sourceHash, candidate->fileBytes == size, path, error)) return false;
+
+  // Pointer fix-ups, every section bounds checked against the mapping
+  const ExpMeshHeader& h = *candidate;
+  if (!inside(h.submeshes, size, h.submeshCount * sizeof(ExpMeshSubmesh), 8) ||
+      !inside(h.materials, size, h.materialCount * sizeof(ExpMeshMaterial), 4) ||
+      !inside(h.strings, size, h.strings.bytes, 1) ||
+      !inside(h.vertices, size, (uint64_t)h.vertexCount * sizeof(EXP::MATH::packed3), ALIGNMENT) ||
+      !inside(h.attributes, size, (uint64_t)h.vertexCount * sizeof(VertexAttributes), ALIGNMENT)) {
+    return fail(error, "Cache is corrupt: " + path);
+  }
+  const char* strings = base + h.strings.offset;
+  auto string = [&](uint32_t offset, uint32_t length, std::string& out) {
+    if ((uint64_t)offset + length > h.strings.bytes) return false;
+    out.assign(strings + offset, length);
+    return true;
+  };
+
+  std::vector<CachedSubmesh> submeshes(h.submeshCount);
+  const ExpMeshSubmesh* records = (const ExpMeshSubmesh*)(base + h.submeshes.offset);
+  for (uint32_t s = 0; s < h.submeshCount; s++) {
+    const ExpMeshSubmesh& record = records[s];
+    if (!inside(record.indices, size, (uint64_t)record.indexCount * sizeof(uint32_t), ALIGNMENT) ||
+        !inside(record.primitives, size, (uint64_t)record.indexCount / 3 * sizeof(PrimitiveAttributes), ALIGNMENT) ||
+        record.material >= (int32_t)h.materialCount) {
+      return fail(error, "Cache is corrupt: " + path);
+    }
+    CachedSubmesh& submesh = submeshes[s];
+    submesh.material = record.material;
+    submesh.texindex = record.texindex;
+    submesh.indexCount = record.indexCount;
+    submesh.indices = (uint32_t*)(base + record.indices.offset);
+    submesh.primitives = (PrimitiveAttributes*)(base + record.primitives.offset);
+    submesh.indexSection = record.indices;
+    submesh.primitiveSection = record.primitives;
+  }
+
+  const std::string directory = std::filesystem::path(path).parent_path().string();
+  std::vector<HostMaterial> materials(h.materialCount);
+  const ExpMeshMaterial* materialRecords = (const ExpMeshMaterial*)(base + h.materials.offset);
+  for (uint32_t m = 0; m < h.materialCount; m++) {
+    const ExpMeshMaterial& record = materialRecords[m];
+    HostMaterial& material = materials[m];
+    for (int k = 0; k < 3; k++) {
+      material.ambient[k] = record.ambient[k];
+      material.diffuse[k] = record.diffuse[k];
+      material.specular[k] = record.specular[k];
+      material.emission[k] = record.emission[k];
+    }
+    material.shininess = record.shininess;
+    std::string texture;
+    if (!string(record.name, record.nameLength, material.name) || !string(record.texture, record.textureLength, texture)) {
+      return fail(error, "Cache is corrupt: " + path);
+    }
+    const bool relative = !texture.empty() && !std::filesystem::path(texture).is_absolute();
+    material.diffuseTexture = relative ? (std::filesystem::path(directory) / texture).string() : texture;
+  }
+  if (!string(h.name, h.nameLength, meshName)) return fail(error, "Cache is corrupt: " + path);
+
+  file = mapped;
+  header = candidate;
+  vertexData = (EXP::MATH::packed3*)(base + h.vertices.offset);
+  attributeData = (VertexAttributes*)(base + h.attributes.offset);
+  cachedSubmeshes = std::move(submeshes);
+  cachedMaterials = std::move(materials);
+  return true;
+}
+
+void Repository::MeshCache::close() {
+  file.reset();
+  header = nullptr;
+  vertexData = nullptr;
+  attributeData = nullptr;
+  cachedSubmeshes.clear();
+  cachedMaterials.clear();
+  meshName.clear();
+}
+
+void Repository::MeshCache::toHostMesh(HostMesh& mesh) const {
+  mesh = HostMesh();
+  mesh.name = meshName;
+  mesh.vertices.assign(vertexData, vertexData + vertexCount());
+  mesh.attributes.assign(attributeData, attributeData + vertexCount());
+  mesh.materials = cachedMaterials;
+  for (const CachedSubmesh& submesh : cachedSubmeshes) {
+    mesh.submeshes.push_back({std::vector<uint32_t>(submesh.indices, submesh.indices + submesh.indexCount), submesh.material});
+  }
+}
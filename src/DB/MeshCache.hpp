@@ -0,0 +1,137 @@
+#pragma once
+#include <DB/MappedFile.hpp>
+#include <Model/HostMesh.h>
+#include <Renderer/HostTypes.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * .expmesh: binary mesh cache, laid out the way the GPU buffers are.
+ *
+ * [Header][submesh records][material records][strings] | vertices | attributes | per submesh: indices, primitives
+ *
+ * Every section after the records starts on ALIGNMENT (the largest page size we run on) and
+ * the file is padded to a multiple of it, so a section can back a Metal buffer without a
+ * copy (newBufferWithBytesNoCopy wants page aligned pointers and lengths).
+ *
+ * open() maps the file once (private, copy on write) and turns section offsets into
+ * pointers. The cache is stale when the version, the struct layouts or the hash of the
+ * source OBJ and its MTL files differ; open() then fails and the caller re-imports.
+ **/
+
+namespace Repository {
+
+struct ExpMeshSection {
+  uint64_t offset = 0;
+  uint64_t bytes = 0;
+};
+
+struct ExpMeshHeader {
+  char magic[8];           // "EXPMESH"
+  uint32_t version;
+  uint32_t alignment;
+  uint64_t sourceHash;
+  uint64_t fileBytes;
+  uint32_t layout;         // sizeof(VertexAttributes) << 16 | sizeof(PrimitiveAttributes)
+  uint32_t vertexCount;
+  uint32_t submeshCount;
+  uint32_t materialCount;
+  ExpMeshSection submeshes;
+  ExpMeshSection materials;
+  ExpMeshSection strings;
+  ExpMeshSection vertices;
+  ExpMeshSection attributes;
+  uint32_t name;           // Offset into strings
+  uint32_t nameLength;
+};
+
+struct ExpMeshSubmesh {
+  int32_t material;
+  int32_t texindex;        // flags.x the primitives were written with
+  uint32_t indexCount;
+  uint32_t reserved;
+  ExpMeshSection indices;
+  ExpMeshSection primitives;
+};
+
+struct ExpMeshMaterial {
+  float ambient[3];
+  float diffuse[3];
+  float specular[3];
+  float emission[3];
+  float shininess;
+  uint32_t name;
+  uint32_t nameLength;
+  uint32_t texture;        // Relative to the cache directory when it was below it
+  uint32_t textureLength;
+};
+
+struct CachedSubmesh {
+  int material = -1;
+  int texindex = 0;
+  uint32_t indexCount = 0;
+  uint32_t* indices = nullptr;
+  Renderer::Host::PrimitiveAttributes* primitives = nullptr;
+  ExpMeshSection indexSection;
+  ExpMeshSection primitiveSection;
+
+  inline uint32_t triangleCount() const { return indexCount / 3; }
+};
+
+class MeshCache {
+public:
+  MeshCache(){};
+  ~MeshCache(){};
+
+public:
+  static constexpr uint32_t VERSION = 1;
+  static constexpr uint32_t ALIGNMENT = 16384;
+
+  // Hash of the OBJ bytes and of every mtllib it names. 0 when the OBJ cannot be read.
+  static uint64_t hashSources(const std::string& objPath);
+  // texindices: flags.x per submesh (empty: 0). Written to a temporary file, then renamed.
+  static bool write(
+    const std::string& path,
+    const EXP::MDL::HostMesh& mesh,
+    uint64_t sourceHash,
+    const std::vector<int>& texindices = {},
+    std::string* error = nullptr
+  );
+
+public:
+  bool open(const std::string& path, uint64_t sourceHash, std::string* error = nullptr);
+  void close();
+  // Section rounded up to ALIGNMENT: the length a no-copy GPU buffer over it needs
+  static inline uint64_t alignedBytes(const ExpMeshSection& section) {
+    return (section.bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  }
+  // Copies the mapped streams into a HostMesh (tests, tools)
+  void toHostMesh(EXP::MDL::HostMesh& mesh) const;
+
+public:
+  inline bool isOpen() const { return header != nullptr; }
+  inline const std::string& name() const { return meshName; }
+  inline uint32_t vertexCount() const { return header ? header->vertexCount : 0; }
+  inline EXP::MATH::packed3* vertices() const { return vertexData; }
+  inline Renderer::Host::VertexAttributes* attributes() const { return attributeData; }
+  inline const ExpMeshSection& vertexSection() const { return header->vertices; }
+  inline const ExpMeshSection& attributeSection() const { return header->attributes; }
+  inline std::vector<CachedSubmesh>& submeshes() { return cachedSubmeshes; }
+  inline const std::vector<EXP::MDL::HostMaterial>& materials() const { return cachedMaterials; }
+  // Keeps the mapping alive for as long as GPU buffers point into it
+  inline std::shared_ptr<MappedFile> mapping() const { return file; }
+
+private:
+  std::shared_ptr<MappedFile> file;
+  const ExpMeshHeader* header = nullptr;
+  EXP::MATH::packed3* vertexData = nullptr;
+  Renderer::Host::VertexAttributes* attributeData = nullptr;
+  std::vector<CachedSubmesh> cachedSubmeshes;
+  std::vector<EXP::MDL::HostMaterial> cachedMaterials;
+  std::string meshName;
+};
+
+}; // namespace Repository
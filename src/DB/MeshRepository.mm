@@ -1,26 +1,36 @@
 #include "Renderer/Types.h"
 #include <DB/Repository.h>
+#include <DB/MeshCache.hpp>
+#include <DB/ObjRepository.hpp>
 #include <DB/Repository.hpp>
+#include <Model/Weld.h>
 #include <ModelIO/ModelIO.h>
+#include <chrono>
 
 
 EXP::MDL::Submesh* buildSubmesh(
 	MTL::Device* device, 
 	MTKSubmesh* mtkSubmesh, 
 	MDLSubmesh* mdlSubmesh, 
-	MTL::Buffer* vertexAttribBuffer
+	MTL::Buffer* vertexAttribBuffer,
+	const std::vector<uint32_t>& indices
 ) {
   
 	Renderer::Material material = [TextureRepository readMaterial:device material:mdlSubmesh.material];
 	Renderer::Texture texture = [TextureRepository read:device material:mdlSubmesh.material];
 	const int& texindex = EXP::SCENE::addTexture(texture);
 	
-	MTL::Buffer* indexBuffer = (__bridge MTL::Buffer*)mtkSubmesh.indexBuffer.buffer;
+	// Welded indices replace the ModelIO index buffer
+	MTL::Buffer* indexBuffer = device->newBuffer(
+		indices.data(), 
+		indices.size() * sizeof(uint32_t), 
+		MTL::ResourceStorageModeShared
+	);
 	MTL::Buffer* primitiveAttribBuffer = Renderer::Buffer::perPrimitive(
 		device, 
 		vertexAttribBuffer, 
 		indexBuffer,
-		mtkSubmesh.indexCount,
+		(int)indices.size(),
 		texindex
 	);
 
@@ -28,13 +38,44 @@ EXP::MDL::Submesh* buildSubmesh(
       indexBuffer,
 			primitiveAttribBuffer,	
 			(__bridge MTL::PrimitiveType)mtkSubmesh.primitiveType,
-      (__bridge MTL::IndexType)mtkSubmesh.indexType,
-			mtkSubmesh.indexCount,
-      mtkSubmesh.indexBuffer.offset
+      MTL::IndexTypeUInt32,
+			(int)indices.size(),
+      0
   );
   return submesh;
 }
 
+// Reads the MTKMesh streams back (MTKMeshBufferAllocator buffers are CPU visible) so they can be welded.
+EXP::MDL::HostMesh readBack(MTKMesh* mtkMesh, const std::string& name) {
+	EXP::MDL::HostMesh hostMesh;
+	hostMesh.name = name;
+
+	MTKMeshBuffer* positions = [mtkMesh.vertexBuffers objectAtIndex:0];
+	MTKMeshBuffer* attributes = [mtkMesh.vertexBuffers objectAtIndex:1];
+	const char* positionData = (const char*)((__bridge MTL::Buffer*)positions.buffer)->contents() + positions.offset;
+	const char* attributeData = (const char*)((__bridge MTL::Buffer*)attributes.buffer)->contents() + attributes.offset;
+	hostMesh.vertices.resize(mtkMesh.vertexCount);
+	hostMesh.attributes.resize(mtkMesh.vertexCount);
+	memcpy(hostMesh.vertices.data(), positionData, mtkMesh.vertexCount * sizeof(EXP::MATH::packed3));
+	memcpy(hostMesh.attributes.data(), attributeData, mtkMesh.vertexCount * sizeof(Renderer::Host::VertexAttributes));
+
+	for (MTKSubmesh* mtkSubmesh in mtkMesh.submeshes) {
+		const char* indexData = (const char*)((__bridge MTL::Buffer*)mtkSubmesh.indexBuffer.buffer)->contents() + mtkSubmesh.indexBuffer.offset;
+		EXP::MDL::HostSubmesh hostSubmesh;
+		hostSubmesh.indices.resize(mtkSubmesh.indexCount);
+		for (NSUInteger i = 0; i < mtkSubmesh.indexCount; i++) {
+			hostSubmesh.indices[i] = mtkSubmesh.indexType == MTLIndexTypeUInt16 ? ((const uint16_t*)indexData)[i] : ((const uint32_t*)indexData)[i];
+		}
+		hostMesh.submeshes.emplace_back(std::move(hostSubmesh));
+	}
+	return hostMesh;
+}
+
+std::string weldSummary(const EXP::MDL::WeldReport& report) {
+	return "vertices " + std::to_string(report.verticesBefore) + " -> " + std::to_string(report.verticesAfter) + 
+		", bytes saved: " + std::to_string(report.bytesSaved());
+}
+
 MDLVertexDescriptor*
 buildMDLVertexDescriptor(MTL::Device* device, MTL::VertexDescriptor* vertexDescriptor) {
   MDLVertexDescriptor* mdlVertexDescriptor =
@@ -57,28 +98,28 @@ EXP::MDL::Mesh* buildMesh(MTL::Device* device, MDLMesh* mdlMesh, MTL::VertexDesc
   if (err) EXP::printError((__bridge NS::Error*)err);
   assert(mtkMesh.submeshes.count == mtkMesh.submeshes.count);
 
-  std::vector<MTL::Buffer*> buffers;
-  std::vector<int> offsets;
-	
 	// MDLMeshBufferTypeVertex 
 	// Both buffers use the same amount of vertices -> buf[0] the points, buf[1] the attribs. So safe to use.
 	DEBUG("Found vertex buffer count.");
 	DEBUG(std::to_string([mtkMesh.vertexBuffers objectAtIndex:1].length / sizeof(Renderer::VertexAttributes)));
 
 	DEBUG(std::to_string(mtkMesh.vertexBuffers.count));
-  for (int i = 0; i < mtkMesh.vertexBuffers.count; i++) {
-		MTL::Buffer* buffer = (__bridge MTL::Buffer*)[mtkMesh.vertexBuffers objectAtIndex:i].buffer;
-    int offset = [mtkMesh.vertexBuffers objectAtIndex:i].offset;
-    buffers.emplace_back(buffer);
-    offsets.emplace_back(offset);
-  }
+	EXP::MDL::HostMesh hostMesh = readBack(mtkMesh, [[mdlMesh name] UTF8String]);
+	EXP::MDL::WeldReport report = EXP::MDL::Weld::apply(hostMesh);
+	DEBUG("Weld " + hostMesh.name + ": " + weldSummary(report));
+
+  std::vector<MTL::Buffer*> buffers = {
+		device->newBuffer(hostMesh.vertices.data(), hostMesh.vertices.size() * sizeof(EXP::MATH::packed3), MTL::ResourceStorageModeShared),
+		device->newBuffer(hostMesh.attributes.data(), hostMesh.attributes.size() * sizeof(Renderer::VertexAttributes), MTL::ResourceStorageModeShared)
+	};
+  std::vector<int> offsets = {0, 0};
 	
 	EXP::MDL::Mesh* mesh = new EXP::MDL::Mesh(
       buffers,
       offsets,
-      mtkMesh.vertexBuffers.count,
-      [[mdlMesh name] UTF8String],
-      mdlMesh.vertexCount
+      (int)buffers.size(),
+      hostMesh.name,
+      (int)hostMesh.vertexCount()
   );
 	
 	DEBUG("Submeshes: " + std::to_string(mtkMesh.submeshes.count));
@@ -88,7 +129,8 @@ EXP::MDL::Mesh* buildMesh(MTL::Device* device, MDLMesh* mdlMesh, MTL::VertexDesc
 				device, 
 				mtkMesh.submeshes[i], 
 				mdlMesh.submeshes[i],
-				buffers[1]
+				buffers[1],
+				hostMesh.submeshes[i].indices
 			)
 		);
   }
@@ -110,7 +152,7 @@ std::vector<EXP::MDL::Mesh*> buildMeshes(MTL::Device* device, MDLObject* object,
   return meshes;
 }
 
-EXP::Model* Repository::Meshes::read(MTL::Device* cppDevice, MTL::VertexDescriptor* vertexDescriptor, const std::string& path) {
+EXP::Model* readModelIO(MTL::Device* cppDevice, MTL::VertexDescriptor* vertexDescriptor, const std::string& path) {
   NSURL* url = (__bridge NSURL*)EXP::nsUrl(path + ".obj");
 	id<MTLDevice> device = (__bridge id<MTLDevice>) cppDevice;
   MTKMeshBufferAllocator* bufferAllocator = [[MTKMeshBufferAllocator alloc] initWithDevice: device];
@@ -126,3 +168,196 @@ EXP::Model* Repository::Meshes::read(MTL::Device* cppDevice, MTL::VertexDescript
   return model;
 }
 
+// Loads and registers the diffuse texture of every submesh; returns flags.x per submesh.
+std::vector<int> addTextures(
+	MTL::Device* device, 
+	const std::vector<EXP::MDL::HostMaterial>& materials, 
+	const std::vector<int>& submeshMaterials
+) {
+	std::vector<int> texindices;
+	for (int material : submeshMaterials) {
+		Renderer::Texture texture = {"default", Renderer::TextureAccess::SAMPLE, nullptr};
+		if (material >= 0 && !materials[material].diffuseTexture.empty()) {
+			const std::string& path = materials[material].diffuseTexture;
+			const std::string name = path.substr(path.find_last_of("/") + 1);
+			// Shared by an earlier submesh or model: its index, without decoding the file again
+			if (EXP::SCENE::hasTexture(name, Renderer::TextureAccess::SAMPLE)) {
+				texindices.emplace_back(EXP::SCENE::addTexture({name, Renderer::TextureAccess::SAMPLE, nullptr}));
+				continue;
+			}
+			Renderer::Host::StreamSource source;
+			if (EXP::SCENE::isStreaming() && Repository::Textures::source(device, path, source)) {
+				texindices.emplace_back(EXP::SCENE::addTexture(name, std::move(source)));
+				continue;
+			}
+			MTL::Texture* value = Repository::Textures::read(device, path);
+			if (value) texture = {name, Renderer::TextureAccess::SAMPLE, value};
+			else WARN("No texture found: " + path);
+		}
+		texindices.emplace_back(EXP::SCENE::addTexture(texture));
+	}
+	return texindices;
+}
+
+std::vector<int> submeshMaterials(const EXP::MDL::HostMesh& hostMesh) {
+	std::vector<int> materials;
+	for (const EXP::MDL::HostSubmesh& submesh : hostMesh.submeshes) materials.emplace_back(submesh.material);
+	return materials;
+}
+
+// No-copy buffer over a page aligned cache section. The deallocator holds the mapping until Metal lets go.
+MTL::Buffer* mappedBuffer(MTL::Device* device, const Repository::MeshCache& cache, void* pointer, const Repository::ExpMeshSection& section) {
+	if (section.bytes == 0) return device->newBuffer(sizeof(uint32_t), MTL::ResourceStorageModeShared);
+	std::shared_ptr<Repository::MappedFile> mapping = cache.mapping();
+	return device->newBuffer(
+		pointer, 
+		Repository::MeshCache::alignedBytes(section), 
+		MTL::ResourceStorageModeShared, 
+		^(void*, NS::UInteger) { (void)mapping.get(); }
+	);
+}
+
+EXP::Model* readHost(MTL::Device* device, const std::string& path) {
+	const std::string objPath = path + ".obj";
+	const std::string cachePath = path + ".expmesh";
+	const uint64_t sourceHash = Repository::MeshCache::hashSources(objPath);
+	std::string error;
+
+	Repository::MeshCache cache;
+	if (sourceHash && cache.open(cachePath, sourceHash, &error)) {
+		DEBUG("Mesh cache hit: " + cachePath);
+		EXP::MDL::Mesh* mesh = Repository::Meshes::upload(device, cache);
+		return new EXP::Model({mesh}, mesh->name, mesh->vertexCount);
+	}
+	DEBUG(error);
+
+	EXP::MDL::HostMesh hostMesh;
+	error.clear();
+	if (!Repository::Obj::readMapped(objPath, hostMesh, 0, &error)) {
+		ERROR("Cannot read mesh: " + error);
+		return nullptr;
+	}
+	if (!error.empty()) WARN(error);
+	EXP::MDL::WeldReport report = EXP::MDL::Weld::apply(hostMesh);
+	DEBUG("Weld " + hostMesh.name + ": " + weldSummary(report));
+
+	const std::vector<int> texindices = addTextures(device, hostMesh.materials, submeshMaterials(hostMesh));
+	EXP::MDL::Mesh* mesh = nullptr;
+	if (sourceHash && Repository::MeshCache::write(cachePath, hostMesh, sourceHash, texindices, &error) && cache.open(cachePath, sourceHash, &error)) {
+		mesh = Repository::Meshes::upload(device, cache, texindices);
+	} else {
+		WARN("Mesh cache not written: " + error);
+		mesh = Repository::Meshes::upload(device, hostMesh, texindices);
+	}
+	return new EXP::Model({mesh}, mesh->name, mesh->vertexCount);
+}
+
+// Copies the CPU buffers into shared Metal buffers in the Layouts::vertexNIP split layout.
+EXP::MDL::Mesh* Repository::Meshes::upload(
+	MTL::Device* device, 
+	const EXP::MDL::HostMesh& hostMesh, 
+	const std::vector<int>& texindices
+) {
+	static_assert(sizeof(Renderer::Host::VertexAttributes) == sizeof(Renderer::VertexAttributes));
+	static_assert(sizeof(Renderer::Host::PrimitiveAttributes) == sizeof(Renderer::PrimitiveAttributes));
+	static_assert(sizeof(EXP::MATH::packed3) == sizeof(MTL::PackedFloat3));
+
+	MTL::Buffer* vertexBuffer = device->newBuffer(
+		hostMesh.vertices.data(), 
+		hostMesh.vertices.size() * sizeof(EXP::MATH::packed3), 
+		MTL::ResourceStorageModeShared
+	);
+	MTL::Buffer* vertexAttribBuffer = device->newBuffer(
+		hostMesh.attributes.data(), 
+		hostMesh.attributes.size() * sizeof(Renderer::Host::VertexAttributes), 
+		MTL::ResourceStorageModeShared
+	);
+
+	EXP::MDL::Mesh* mesh = new EXP::MDL::Mesh(
+		{vertexBuffer, vertexAttribBuffer},
+		{0, 0},
+		2,
+		hostMesh.name,
+		(int)hostMesh.vertexCount()
+	);
+
+	const std::vector<int> textures = texindices.empty() ? addTextures(device, hostMesh.materials, submeshMaterials(hostMesh)) : texindices;
+	for (size_t s = 0; s < hostMesh.submeshes.size(); s++) {
+		const EXP::MDL::HostSubmesh& hostSubmesh = hostMesh.submeshes[s];
+		const int indexCount = (int)hostSubmesh.indices.size();
+		MTL::Buffer* indexBuffer = device->newBuffer(
+			hostSubmesh.indices.data(), 
+			indexCount * sizeof(uint32_t), 
+			MTL::ResourceStorageModeShared
+		);
+		MTL::Buffer* primitiveAttribBuffer = Renderer::Buffer::perPrimitive(
+			device, 
+			vertexAttribBuffer, 
+			indexBuffer, 
+			indexCount, 
+			textures[s]
+		);
+		mesh->addSubmesh(new EXP::MDL::Submesh(
+			indexBuffer,
+			primitiveAttribBuffer,
+			MTL::PrimitiveTypeTriangle,
+			MTL::IndexTypeUInt32,
+			indexCount,
+			0
+		));
+	}
+	return mesh;
+}
+
+// Zero copy: every buffer points into the mapped cache. Primitives only get written (copy on
+// write pages) when the scene handed out different texture indices than the cache was written with.
+EXP::MDL::Mesh* Repository::Meshes::upload(
+	MTL::Device* device, 
+	Repository::MeshCache& cache, 
+	const std::vector<int>& texindices
+) {
+	std::vector<int> materials;
+	for (const Repository::CachedSubmesh& submesh : cache.submeshes()) materials.emplace_back(submesh.material);
+	const std::vector<int> textures = texindices.empty() ? addTextures(device, cache.materials(), materials) : texindices;
+
+	EXP::MDL::Mesh* mesh = new EXP::MDL::Mesh(
+		{
+			mappedBuffer(device, cache, cache.vertices(), cache.vertexSection()), 
+			mappedBuffer(device, cache, cache.attributes(), cache.attributeSection())
+		},
+		{0, 0},
+		2,
+		cache.name(),
+		(int)cache.vertexCount()
+	);
+
+	for (size_t s = 0; s < cache.submeshes().size(); s++) {
+		Repository::CachedSubmesh& submesh = cache.submeshes()[s];
+		if (submesh.texindex != textures[s]) {
+			for (uint32_t t = 0; t < submesh.triangleCount(); t++) submesh.primitives[t].flags.x = (uint8_t)textures[s];
+			submesh.texindex = textures[s];
+		}
+		mesh->addSubmesh(new EXP::MDL::Submesh(
+			mappedBuffer(device, cache, submesh.indices, submesh.indexSection),
+			mappedBuffer(device, cache, submesh.primitives, submesh.primitiveSection),
+			MTL::PrimitiveTypeTriangle,
+			MTL::IndexTypeUInt32,
+			(int)submesh.indexCount,
+			0
+		));
+	}
+	return mesh;
+}
+
+EXP::Model* Repository::Meshes::read(
+	MTL::Device* device, 
+	MTL::VertexDescriptor* vertexDescriptor, 
+	const std::string& path,
+	const MeshLoader& loader
+) {
+	auto start = std::chrono::steady_clock::now();
+	EXP::Model* model = loader == MeshLoader::HOST ? readHost(device, path) : readModelIO(device, vertexDescriptor, path);
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	DEBUG(std::string(loader == MeshLoader::HOST ? "Host" : "ModelIO") + " mesh load: " + path + ", ms: " + std::to_string(elapsed));
+	return model;
+}
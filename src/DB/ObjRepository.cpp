@@ -0,0 +1,575 @@
+#include <DB/MappedFile.hpp>
+#include <DB/ObjRepository.hpp>
+#include <DB/Tokenizer.hpp>
+#include <Thread/Pool.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+using HostMesh = EXP::MDL::HostMesh;
+using HostMaterial = EXP::MDL::HostMaterial;
+using HostSubmesh = EXP::MDL::HostSubmesh;
+using Isa = Repository::Isa;
+using Tokenizer = Repository::Tokenizer;
+
+namespace {
+
+constexpr size_t MIN_CHUNK_BYTES = 1 << 20;      // Smaller files are tokenized in one go
+constexpr size_t PARTITION_POSITIONS = 1 << 14;  // Positions per deduplication partition
+constexpr size_t MAX_PARTITIONS = 4096;
+
+inline std::string parseName(const char*& p, const char* end) {
+  Tokenizer::skipBlank(p, end);
+  const char* last = Tokenizer::lineEnd(p, end);
+  while (last > p && Tokenizer::isBlank(*(last - 1))) last--;
+  std::string name(p, last);
+  p = last;
+  return name;
+}
+
+// Negative indices count back from the current element; they are stored 1-based relative
+// to the start of this record range and marked so build() can shift them per chunk.
+inline void pushIndex(Repository::ObjRecords& records, int32_t index, size_t count) {
+  if (index < 0) {
+    records.relative.emplace_back((uint32_t)records.corners.size());
+    index = (int32_t)count + index + 1;
+  }
+  records.corners.emplace_back(index);
+}
+
+void parseFace(const char*& p, const char* end, Repository::ObjRecords& records, const Isa& isa) {
+  const size_t positionCount = records.positionCount();
+  const size_t texcoordCount = records.texcoordCount();
+  const size_t normalCount = records.normalCount();
+  uint32_t cornerCount = 0;
+  while (true) {
+    Tokenizer::skipBlank(p, end);
+    int32_t v = 0, vt = 0, vn = 0;
+    if (!Tokenizer::parseInt(p, end, v, isa)) break;
+    if (p < end && *p == '/') {
+      p++;
+      Tokenizer::parseInt(p, end, vt, isa);
+      if (p < end && *p == '/') {
+        p++;
+        Tokenizer::parseInt(p, end, vn, isa);
+      }
+    }
+    pushIndex(records, v, positionCount);
+    if (vt) pushIndex(records, vt, texcoordCount); else records.corners.emplace_back(0);
+    if (vn) pushIndex(records, vn, normalCount); else records.corners.emplace_back(0);
+    cornerCount += 1;
+  }
+  if (cornerCount >= 3) {
+    records.faces.emplace_back(cornerCount);
+  } else {
+    // Points and lines are not rendered
+    records.corners.resize(records.corners.size() - cornerCount * 3);
+    while (!records.relative.empty() && records.relative.back() >= records.corners.size()) {
+      records.relative.pop_back();
+    }
+  }
+}
+
+inline bool keyword(const char* p, const char* end, const char* word, size_t length) {
+  return (size_t)(end - p) > length && memcmp(p, word, length) == 0 && Tokenizer::isBlank(p[length]);
+}
+
+// Output vertex lookup keyed on the (partition local) position index; small chains of (vt, vn) per position.
+struct CornerTable {
+  struct Entry {
+    int32_t texcoord;
+    int32_t normal;
+    uint32_t vertex;
+    int32_t next;
+  };
+  std::vector<int32_t> heads;
+  std::vector<Entry> entries;
+
+  CornerTable(size_t positionCount) : heads(positionCount, -1) {}
+
+  // Returns the output vertex, or inserts `candidate` when the triple was not seen yet.
+  inline uint32_t find(int32_t position, int32_t texcoord, int32_t normal, uint32_t candidate, bool& inserted) {
+    for (int32_t e = heads[position]; e >= 0; e = entries[e].next) {
+      if (entries[e].texcoord == texcoord && entries[e].normal == normal) {
+        inserted = false;
+        return entries[e].vertex;
+      }
+    }
+    entries.push_back({texcoord, normal, candidate, heads[position]});
+    heads[position] = (int32_t)entries.size() - 1;
+    inserted = true;
+    return candidate;
+  }
+};
+
+} // namespace
+
+
+void Repository::Obj::tokenize(const char* begin, const char* end, ObjRecords& records) {
+  const Isa isa = Tokenizer::best();
+  const char* p = begin;
+  while (p < end) {
+    Tokenizer::skipBlank(p, end);
+    if (p >= end) break;
+    switch (*p) {
+    case 'v':
+      if (p + 1 < end && Tokenizer::isBlank(p[1])) {
+        p += 1;
+        float xyz[3] = {0.0f, 0.0f, 0.0f};
+        Tokenizer::parseFloats(p, end, xyz, 3, isa);
+        records.positions.insert(records.positions.end(), xyz, xyz + 3);
+      } else if (keyword(p, end, "vt", 2)) {
+        p += 2;
+        float uv[2] = {0.0f, 0.0f};
+        Tokenizer::parseFloats(p, end, uv, 2, isa);
+        records.texcoords.insert(records.texcoords.end(), uv, uv + 2);
+      } else if (keyword(p, end, "vn", 2)) {
+        p += 2;
+        float xyz[3] = {0.0f, 0.0f, 0.0f};
+        Tokenizer::parseFloats(p, end, xyz, 3, isa);
+        records.normals.insert(records.normals.end(), xyz, xyz + 3);
+      }
+      break;
+    case 'f':
+      if (keyword(p, end, "f", 1)) {
+        p += 1;
+        parseFace(p, end, records, isa);
+      }
+      break;
+    case 'u':
+      if (keyword(p, end, "usemtl", 6)) {
+        p += 6;
+        records.usemtl.emplace_back((uint32_t)records.faces.size(), parseName(p, end));
+      }
+      break;
+    case 'm':
+      if (keyword(p, end, "mtllib", 6)) {
+        p += 6;
+        records.mtllibs.emplace_back(parseName(p, end));
+      }
+      break;
+    case 'o':
+      if (keyword(p, end, "o", 1) && records.name.empty()) {
+        p += 1;
+        records.name = parseName(p, end);
+      }
+      break;
+    default:
+      break; // Comments, groups, smoothing groups
+    }
+    Tokenizer::skipLine(p, end);
+  }
+}
+
+
+bool Repository::Obj::build(
+  std::vector<ObjRecords>& chunks,
+  const std::string& directory,
+  HostMesh& mesh,
+  std::string* error,
+  unsigned int threads
+) {
+  using EXP::THREAD::Pool;
+  Pool& pool = Pool::shared();
+  const size_t chunkCount = chunks.size();
+
+  // Prefix sums over the element counts of each chunk
+  std::vector<size_t> positionBase(chunkCount + 1, 0), texcoordBase(chunkCount + 1, 0);
+  std::vector<size_t> normalBase(chunkCount + 1, 0), cornerBase(chunkCount + 1, 0);
+  for (size_t c = 0; c < chunkCount; c++) {
+    positionBase[c + 1] = positionBase[c] + chunks[c].positionCount();
+    texcoordBase[c + 1] = texcoordBase[c] + chunks[c].texcoordCount();
+    normalBase[c + 1] = normalBase[c] + chunks[c].normalCount();
+    cornerBase[c + 1] = cornerBase[c] + chunks[c].corners.size() / 3;
+  }
+  const size_t positionCount = positionBase[chunkCount];
+  const size_t texcoordCount = texcoordBase[chunkCount];
+  const size_t normalCount = normalBase[chunkCount];
+
+  mesh = HostMesh();
+  if (positionCount == 0 || cornerBase[chunkCount] == 0) {
+    if (error) *error = "No triangles found";
+    return false;
+  }
+  if (positionCount >= UINT32_MAX || cornerBase[chunkCount] >= UINT32_MAX) {
+    if (error) *error = "Too many elements for 32-bit indices";
+    return false;
+  }
+
+  // Shift relative indices by the counts of all previous chunks, then merge the attribute streams
+  std::vector<float> mergedPositions, mergedTexcoords, mergedNormals;
+  const float* positions = chunks[0].positions.data();
+  const float* texcoords = chunks[0].texcoords.data();
+  const float* normals = chunks[0].normals.data();
+  if (chunkCount > 1) {
+    mergedPositions.resize(positionCount * 3);
+    mergedTexcoords.resize(texcoordCount * 2);
+    mergedNormals.resize(normalCount * 3);
+    positions = mergedPositions.data();
+    texcoords = mergedTexcoords.data();
+    normals = mergedNormals.data();
+  }
+  pool.parallelFor(chunkCount, 1, [&](size_t first, size_t last) {
+    for (size_t c = first; c < last; c++) {
+      ObjRecords& chunk = chunks[c];
+      const size_t prefix[3] = {positionBase[c], texcoordBase[c], normalBase[c]};
+      for (uint32_t slot : chunk.relative) chunk.corners[slot] += (int32_t)prefix[slot % 3];
+      if (chunkCount == 1) continue;
+      std::copy(chunk.positions.begin(), chunk.positions.end(), mergedPositions.begin() + positionBase[c] * 3);
+      std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), mergedTexcoords.begin() + texcoordBase[c] * 2);
+      std::copy(chunk.normals.begin(), chunk.normals.end(), mergedNormals.begin() + normalBase[c] * 3);
+    }
+  }, threads);
+
+  // Materials. Slot 0 is 'no material', slot m + 1 is mesh.materials[m].
+  std::unordered_map<std::string, int> materialIndices;
+  for (const ObjRecords& chunk : chunks) {
+    if (mesh.name == "Mesh" && !chunk.name.empty()) mesh.name = chunk.name;
+    for (const std::string& library : chunk.mtllibs) {
+      std::vector<HostMaterial> materials;
+      readMaterials((std::filesystem::path(directory) / library).string(), materials);
+      for (HostMaterial& material : materials) {
+        if (materialIndices.count(material.name)) continue;
+        materialIndices.insert({material.name, (int)mesh.materials.size()});
+        mesh.materials.emplace_back(std::move(material));
+      }
+    }
+  }
+  std::vector<uint32_t> startSlot(chunkCount, 0);
+  std::vector<std::vector<uint32_t>> switchSlots(chunkCount);
+  uint32_t currentSlot = 0;
+  for (size_t c = 0; c < chunkCount; c++) {
+    startSlot[c] = currentSlot;
+    for (const auto& usemtl : chunks[c].usemtl) {
+      if (!materialIndices.count(usemtl.second)) {
+        HostMaterial placeholder;
+        placeholder.name = usemtl.second;
+        materialIndices.insert({usemtl.second, (int)mesh.materials.size()});
+        mesh.materials.emplace_back(placeholder);
+      }
+      currentSlot = materialIndices[usemtl.second] + 1;
+      switchSlots[c].push_back(currentSlot);
+    }
+  }
+  const size_t slotCount = mesh.materials.size() + 1;
+
+  // Walks the faces of a chunk with the material slot that applies to each face
+  auto forEachFace = [&](size_t c, const auto& fn) {
+    const ObjRecords& chunk = chunks[c];
+    uint32_t slot = startSlot[c];
+    size_t nextSwitch = 0;
+    const int32_t* corner = chunk.corners.data();
+    for (uint32_t face = 0; face < chunk.faces.size(); face++) {
+      while (nextSwitch < chunk.usemtl.size() && chunk.usemtl[nextSwitch].first == face) {
+        slot = switchSlots[c][nextSwitch++];
+      }
+      fn(face, slot, corner, chunk.faces[face]);
+      corner += chunk.faces[face] * 3;
+    }
+  };
+
+  // Vertices are deduplicated per partition of the position range. Partitions depend on the data
+  // only, so the output is identical for any thread or chunk count.
+  const size_t partitionCount = std::min<size_t>(
+    std::max<size_t>((positionCount + PARTITION_POSITIONS - 1) / PARTITION_POSITIONS, 1), MAX_PARTITIONS
+  );
+  auto partitionOf = [&](uint32_t v) { return (size_t)((uint64_t)v * partitionCount / positionCount); };
+  auto partitionStart = [&](size_t p) { return (uint32_t)((p * positionCount + partitionCount - 1) / partitionCount); };
+
+  struct ChunkCounts {
+    std::vector<uint8_t> valid;       // Per face
+    std::vector<size_t> corners;      // Per partition; becomes the scatter offset
+    std::vector<size_t> triangles;    // Per material slot; becomes the index offset
+    std::vector<uint32_t> slotOrder;  // Material slots in order of first use
+    size_t invalid = 0;
+  };
+  std::vector<ChunkCounts> counts(chunkCount);
+
+  // Pass 1: validate faces, count corners per partition and triangles per material
+  pool.parallelFor(chunkCount, 1, [&](size_t first, size_t last) {
+    for (size_t c = first; c < last; c++) {
+      ChunkCounts& count = counts[c];
+      count.valid.assign(chunks[c].faces.size(), 0);
+      count.corners.assign(partitionCount, 0);
+      count.triangles.assign(slotCount, 0);
+      forEachFace(c, [&](uint32_t face, uint32_t slot, const int32_t* corner, uint32_t cornerCount) {
+        for (uint32_t k = 0; k < cornerCount; k++) {
+          if (corner[k * 3] < 1 || (size_t)corner[k * 3] > positionCount) {
+            count.invalid += 1;
+            return;
+          }
+        }
+        count.valid[face] = 1;
+        for (uint32_t k = 0; k < cornerCount; k++) count.corners[partitionOf(corner[k * 3] - 1)] += 1;
+        if (count.triangles[slot] == 0) count.slotOrder.push_back(slot);
+        count.triangles[slot] += cornerCount - 2;
+      });
+    }
+  }, threads);
+
+  // Bucket offsets: partition major, chunk minor, so every bucket stays in file order
+  std::vector<size_t> bucketBase(partitionCount + 1, 0);
+  for (size_t p = 0; p < partitionCount; p++) {
+    size_t offset = bucketBase[p];
+    for (size_t c = 0; c < chunkCount; c++) {
+      size_t corners = counts[c].corners[p];
+      counts[c].corners[p] = offset;
+      offset += corners;
+    }
+    bucketBase[p + 1] = offset;
+  }
+
+  // Pass 2: scatter global corner ids into their partition bucket
+  std::vector<uint32_t> buckets(bucketBase[partitionCount]);
+  std::vector<uint32_t> cornerVertex(cornerBase[chunkCount]);
+  pool.parallelFor(chunkCount, 1, [&](size_t first, size_t last) {
+    for (size_t c = first; c < last; c++) {
+      std::vector<size_t>& offsets = counts[c].corners;
+      forEachFace(c, [&](uint32_t face, uint32_t, const int32_t* corner, uint32_t cornerCount) {
+        if (!counts[c].valid[face]) return;
+        const uint32_t id = (uint32_t)(cornerBase[c] + (corner - chunks[c].corners.data()) / 3);
+        for (uint32_t k = 0; k < cornerCount; k++) buckets[offsets[partitionOf(corner[k * 3] - 1)]++] = id + k;
+      });
+    }
+  }, threads);
+
+  // Pass 3: deduplicate every partition, vertices numbered in order of first use
+  std::vector<std::vector<uint32_t>> sources(partitionCount);
+  pool.parallelFor(partitionCount, 1, [&](size_t first, size_t last) {
+    for (size_t p = first; p < last; p++) {
+      const uint32_t start = partitionStart(p);
+      CornerTable table(partitionStart(p + 1) - start);
+      size_t c = 0;
+      for (size_t b = bucketBase[p]; b < bucketBase[p + 1]; b++) {
+        const uint32_t id = buckets[b];
+        while (id >= cornerBase[c + 1]) c++; // Ids ascend within a bucket
+        const int32_t* corner = chunks[c].corners.data() + (id - cornerBase[c]) * 3;
+        const int32_t vt = corner[1] > 0 && (size_t)corner[1] <= texcoordCount ? corner[1] : 0;
+        const int32_t vn = corner[2] > 0 && (size_t)corner[2] <= normalCount ? corner[2] : 0;
+        bool inserted = false;
+        cornerVertex[id] = table.find(corner[0] - 1 - start, vt, vn, (uint32_t)sources[p].size(), inserted);
+        if (inserted) sources[p].push_back(id);
+      }
+    }
+  }, threads);
+
+  std::vector<size_t> vertexBase(partitionCount + 1, 0);
+  for (size_t p = 0; p < partitionCount; p++) vertexBase[p + 1] = vertexBase[p] + sources[p].size();
+  mesh.vertices.resize(vertexBase[partitionCount]);
+  mesh.attributes.resize(vertexBase[partitionCount]);
+  std::vector<uint8_t> missingNormal(vertexBase[partitionCount], 0);
+  std::atomic<bool> anyMissingNormal{false};
+
+  // Pass 4: fill the vertex streams and turn partition local ids into global ones
+  pool.parallelFor(partitionCount, 1, [&](size_t first, size_t last) {
+    for (size_t p = first; p < last; p++) {
+      size_t c = 0;
+      for (size_t i = 0; i < sources[p].size(); i++) {
+        const uint32_t id = sources[p][i];
+        while (id >= cornerBase[c + 1]) c++;
+        const int32_t* corner = chunks[c].corners.data() + (id - cornerBase[c]) * 3;
+        const int32_t vt = corner[1] > 0 && (size_t)corner[1] <= texcoordCount ? corner[1] : 0;
+        const int32_t vn = corner[2] > 0 && (size_t)corner[2] <= normalCount ? corner[2] : 0;
+        const float* position = positions + (size_t)(corner[0] - 1) * 3;
+        const size_t vertex = vertexBase[p] + i;
+
+        mesh.vertices[vertex] = {position[0], position[1], position[2]};
+        Renderer::Host::VertexAttributes& attribute = mesh.attributes[vertex];
+        attribute = {{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+        if (vt) attribute.texture = {texcoords[(vt - 1) * 2], texcoords[(vt - 1) * 2 + 1]};
+        if (vn) attribute.normal = {normals[(vn - 1) * 3], normals[(vn - 1) * 3 + 1], normals[(vn - 1) * 3 + 2]};
+        if (!vn) {
+          missingNormal[vertex] = 1;
+          anyMissingNormal = true;
+        }
+      }
+      for (size_t b = bucketBase[p]; b < bucketBase[p + 1]; b++) cornerVertex[buckets[b]] += (uint32_t)vertexBase[p];
+    }
+  }, threads);
+
+  // Submeshes in order of first use, sized from the per chunk triangle counts
+  std::vector<int> submeshOfSlot(slotCount, -1);
+  for (size_t c = 0; c < chunkCount; c++) {
+    for (uint32_t slot : counts[c].slotOrder) {
+      if (submeshOfSlot[slot] >= 0) continue;
+      submeshOfSlot[slot] = (int)mesh.submeshes.size();
+      mesh.submeshes.emplace_back();
+      mesh.submeshes.back().material = (int)slot - 1;
+    }
+  }
+  if (mesh.submeshes.empty()) {
+    if (error) *error = "No triangles found";
+    return false;
+  }
+  for (size_t slot = 0; slot < slotCount; slot++) {
+    size_t offset = 0;
+    for (size_t c = 0; c < chunkCount; c++) {
+      size_t triangles = counts[c].triangles[slot];
+      counts[c].triangles[slot] = offset;
+      offset += triangles;
+    }
+    if (submeshOfSlot[slot] >= 0) mesh.submeshes[submeshOfSlot[slot]].indices.resize(offset * 3);
+  }
+
+  // Pass 5: fan triangulate straight into the submesh index lists
+  pool.parallelFor(chunkCount, 1, [&](size_t first, size_t last) {
+    for (size_t c = first; c < last; c++) {
+      forEachFace(c, [&](uint32_t face, uint32_t slot, const int32_t* corner, uint32_t cornerCount) {
+        if (!counts[c].valid[face]) return;
+        const size_t id = cornerBase[c] + (corner - chunks[c].corners.data()) / 3;
+        uint32_t* out = mesh.submeshes[submeshOfSlot[slot]].indices.data() + counts[c].triangles[slot] * 3;
+        for (uint32_t k = 2; k < cornerCount; k++, out += 3) {
+          out[0] = cornerVertex[id];
+          out[1] = cornerVertex[id + k - 1];
+          out[2] = cornerVertex[id + k];
+        }
+        counts[c].triangles[slot] += cornerCount - 2;
+      });
+    }
+  }, threads);
+
+  // Area weighted smooth normals for vertices the file gave none
+  if (anyMissingNormal) {
+    for (const HostSubmesh& s : mesh.submeshes) {
+      for (size_t i = 0; i + 2 < s.indices.size(); i += 3) {
+        const EXP::MATH::float3 a = EXP::MATH::f3(mesh.vertices[s.indices[i]]);
+        const EXP::MATH::float3 b = EXP::MATH::f3(mesh.vertices[s.indices[i + 1]]);
+        const EXP::MATH::float3 c = EXP::MATH::f3(mesh.vertices[s.indices[i + 2]]);
+        const EXP::MATH::float3 n = EXP::MATH::cross(b - a, c - a);
+        for (int k = 0; k < 3; k++) {
+          if (missingNormal[s.indices[i + k]]) mesh.attributes[s.indices[i + k]].normal += n;
+        }
+      }
+    }
+    for (size_t i = 0; i < mesh.attributes.size(); i++) {
+      if (missingNormal[i]) mesh.attributes[i].normal = EXP::MATH::normalize(mesh.attributes[i].normal);
+    }
+  }
+
+  size_t invalid = 0;
+  for (const ChunkCounts& count : counts) invalid += count.invalid;
+  if (invalid && error) *error = "Skipped faces with out of range indices: " + std::to_string(invalid);
+  return true;
+}
+
+
+std::vector<std::pair<size_t, size_t>> Repository::Obj::split(const char* begin, const char* end, size_t count) {
+  std::vector<std::pair<size_t, size_t>> ranges;
+  const size_t size = end - begin;
+  count = std::max<size_t>(count, 1);
+  size_t start = 0;
+  for (size_t i = 1; i <= count && start < size; i++) {
+    size_t stop = i == count ? size : std::max(start, size * i / count);
+    if (stop < size) {
+      const char* newline = (const char*)memchr(begin + stop, '\n', size - stop);
+      stop = newline ? (size_t)(newline - begin) + 1 : size;
+    }
+    if (stop > start) ranges.emplace_back(start, stop);
+    start = stop;
+  }
+  return ranges;
+}
+
+
+bool Repository::Obj::parse(
+  const char* begin,
+  const char* end,
+  const std::string& directory,
+  HostMesh& mesh,
+  std::string* error
+) {
+  std::vector<ObjRecords> chunks(1);
+  tokenize(begin, end, chunks[0]);
+  return build(chunks, directory, mesh, error);
+}
+
+
+bool Repository::Obj::read(const std::string& path, HostMesh& mesh, std::string* error) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    if (error) *error = "Cannot open: " + path;
+    return false;
+  }
+  std::string text;
+  text.resize((size_t)file.tellg());
+  file.seekg(0);
+  file.read(&text[0], text.size());
+
+  std::filesystem::path filePath(path);
+  bool result = parse(text.data(), text.data() + text.size(), filePath.parent_path().string(), mesh, error);
+  if (result && mesh.name == "Mesh") mesh.name = filePath.stem().string();
+  return result;
+}
+
+
+bool Repository::Obj::readMapped(const std::string& path, HostMesh& mesh, unsigned int threads, std::string* error) {
+  MappedFile file;
+  if (!file.open(path)) {
+    if (error) *error = "Cannot open: " + path;
+    return false;
+  }
+  const unsigned int workers = threads ? threads : EXP::THREAD::Pool::shared().size();
+  const size_t chunkCount = std::min<size_t>(std::max<size_t>(file.size() / MIN_CHUNK_BYTES, 1), workers * 4);
+  const std::vector<std::pair<size_t, size_t>> ranges = split(file.data(), file.end(), chunkCount);
+
+  std::vector<ObjRecords> chunks(std::max<size_t>(ranges.size(), 1));
+  EXP::THREAD::Pool::shared().parallelFor(ranges.size(), 1, [&](size_t first, size_t last) {
+    for (size_t c = first; c < last; c++) tokenize(file.data() + ranges[c].first, file.data() + ranges[c].second, chunks[c]);
+  }, threads);
+
+  std::filesystem::path filePath(path);
+  bool result = build(chunks, filePath.parent_path().string(), mesh, error, threads);
+  if (result && mesh.name == "Mesh") mesh.name = filePath.stem().string();
+  return result;
+}
+
+
+bool Repository::Obj::readMaterials(const std::string& path, std::vector<HostMaterial>& materials) {
+  const Isa isa = Tokenizer::best();
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::stringstream reader;
+  reader << file.rdbuf();
+  const std::string text = reader.str();
+  const std::string directory = std::filesystem::path(path).parent_path().string();
+
+  const char* p = text.data();
+  const char* end = text.data() + text.size();
+  HostMaterial* material = nullptr;
+  while (p < end) {
+    Tokenizer::skipBlank(p, end);
+    if (keyword(p, end, "newmtl", 6)) {
+      p += 6;
+      materials.emplace_back();
+      material = &materials.back();
+      material->name = parseName(p, end);
+    } else if (material) {
+      float* target = nullptr;
+      if (keyword(p, end, "Ka", 2)) target = &material->ambient.x;
+      else if (keyword(p, end, "Kd", 2)) target = &material->diffuse.x;
+      else if (keyword(p, end, "Ks", 2)) target = &material->specular.x;
+      else if (keyword(p, end, "Ke", 2)) target = &material->emission.x;
+
+      if (target) {
+        p += 2;
+        Tokenizer::parseFloats(p, end, target, 3, isa);
+      } else if (keyword(p, end, "Ns", 2)) {
+        p += 2;
+        Tokenizer::parseFloats(p, end, &material->shininess, 1, isa);
+      } else if (keyword(p, end, "map_Kd", 6)) {
+        p += 6;
+        // Options (-s, -o, ...) precede the file name; the file name is the last token
+        std::string value = parseName(p, end);
+        size_t split = value.find_last_of(" \t");
+        std::string filename = split == std::string::npos ? value : value.substr(split + 1);
+        material->diffuseTexture = (std::filesystem::path(directory) / filename).string();
+      }
+    }
+    Tokenizer::skipLine(p, end);
+  }
+  return true;
+}
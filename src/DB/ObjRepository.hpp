@@ -0,0 +1,74 @@
+#pragma once
+#include <Model/HostMesh.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Portable OBJ / MTL reader. No ModelIO, no Metal: runs headless on Linux.
+ *
+ * Reading happens in two stages:
+ * 1) tokenize: a range of OBJ text becomes raw records (floats, face corners, usemtl switches).
+ * 2) build: records are resolved into a HostMesh; one output vertex per unique v/vt/vn triple,
+ *    polygons are fan triangulated, one submesh per material.
+ *
+ * readMapped maps the file, splits it at newlines into chunks and tokenizes those in parallel.
+ * build merges the chunks with prefix sums over their element counts. The result does not
+ * depend on the number of chunks or threads.
+ **/
+
+namespace Repository {
+
+struct ObjRecords {
+  std::vector<float> positions;  // XYZXYZ...
+  std::vector<float> texcoords;  // UVUV...
+  std::vector<float> normals;    // XYZXYZ...
+  std::vector<int32_t> corners;  // v, vt, vn per corner. 1-based, 0 when absent
+  std::vector<uint32_t> faces;   // Corner count per face
+  std::vector<uint32_t> relative; // Slots in corners written from negative (relative) indices
+  std::vector<std::pair<uint32_t, std::string>> usemtl; // Face index where the material switches
+  std::vector<std::string> mtllibs;
+  std::string name;
+
+  inline size_t positionCount() const { return positions.size() / 3; }
+  inline size_t texcoordCount() const { return texcoords.size() / 2; }
+  inline size_t normalCount() const { return normals.size() / 3; }
+};
+
+class Obj {
+public:
+  Obj(){};
+  ~Obj(){};
+
+public: // Read
+  static bool read(const std::string& path, EXP::MDL::HostMesh& mesh, std::string* error = nullptr);
+  static bool parse(
+    const char* begin,
+    const char* end,
+    const std::string& directory,
+    EXP::MDL::HostMesh& mesh,
+    std::string* error = nullptr
+  );
+  static bool readMapped(
+    const std::string& path,
+    EXP::MDL::HostMesh& mesh,
+    unsigned int threads = 0,
+    std::string* error = nullptr
+  );
+  static bool readMaterials(const std::string& path, std::vector<EXP::MDL::HostMaterial>& materials);
+
+public: // Stages
+  static std::vector<std::pair<size_t, size_t>> split(const char* begin, const char* end, size_t count);
+  static void tokenize(const char* begin, const char* end, ObjRecords& records);
+  static bool build(
+    std::vector<ObjRecords>& chunks,
+    const std::string& directory,
+    EXP::MDL::HostMesh& mesh,
+    std::string* error = nullptr,
+    unsigned int threads = 0
+  );
+};
+
+}; // namespace Repository
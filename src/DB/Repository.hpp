@@ -1,5 +1,11 @@
 #pragma once
+#include <DB/MeshCache.hpp>
+#include <DB/TextureCache.hpp>
+#include <Model/HostMesh.h>
 #include <Model/MeshFactory.h>
+#include <Renderer/HostBlock.h>
+#include <Renderer/HostImage.h>
+#include <Renderer/HostStreaming.h>
 #include <Renderer/Buffer.h>
 #include <pch.h>
 
@@ -26,13 +32,38 @@ public: // Read
   static MTL::Library* readLibrary(MTL::Device*, std::string name);
 };
 
+// How Textures::read imports BMP / TGA / JPEG files
+struct TextureImport {
+	bool compress = true; // Block compressed chain, cached as .exptex next to the image
+	Renderer::Host::BlockFormat format = Renderer::Host::BlockFormat::BC7;
+	Renderer::Host::BlockQuality quality = Renderer::Host::BlockQuality::NORMAL;
+};
+
 class Textures {
 public:
   Textures(){};
   ~Textures(){};
 
 public:
-	static MTL::Texture* read(MTL::Device* device, std::string path);
+	static MTL::Texture* read(MTL::Device* device, std::string path, const TextureImport& import = {});
+	// Every level of the chain, pixel format from the host image
+	static MTL::Texture* upload(MTL::Device* device, const Renderer::Host::MipChain& chain);
+	// BC1 / BC7 levels, straight from the encoder or from a mapped .exptex
+	static MTL::Texture* upload(MTL::Device* device, const Renderer::Host::BlockChain& chain);
+	static MTL::Texture* upload(MTL::Device* device, const TextureCache& cache);
+	// CPU backing store for Renderer::Host::TextureStreamer: the mapped .exptex, or the imported
+	// chain kept in memory. False for files only MTKTextureLoader reads.
+	static bool source(
+			MTL::Device* device,
+			const std::string& path,
+			Renderer::Host::StreamSource& source,
+			const TextureImport& import = {}
+	);
+};
+
+enum struct MeshLoader {
+	MODELIO = 0,	// MDLAsset / MTKMesh, macOS only
+	HOST = 1			// Portable OBJ reader (DB/ObjRepository.hpp), cached as .expmesh next to the OBJ
 };
 
 class Meshes {
@@ -40,6 +71,22 @@ public:
   Meshes(){};
   ~Meshes(){};
   //static EXP::Model* read(MTL::Device* device, MTL::VertexDescriptor* vertexDescriptor, std::string path, bool useTexture = true, bool useLight = true);
-	static EXP::Model* read(MTL::Device* device, MTL::VertexDescriptor* vertexDescriptor, const std::string& relativePath);
+	static EXP::Model* read(
+		MTL::Device* device,
+		MTL::VertexDescriptor* vertexDescriptor,
+		const std::string& relativePath,
+		const MeshLoader& loader = MeshLoader::HOST
+	);
+	// texindices: flags.x per submesh; empty loads and registers the textures
+	static EXP::MDL::Mesh* upload(
+		MTL::Device* device, 
+		const EXP::MDL::HostMesh& hostMesh, 
+		const std::vector<int>& texindices = {}
+	);
+	static EXP::MDL::Mesh* upload(
+		MTL::Device* device, 
+		MeshCache& cache, 
+		const std::vector<int>& texindices = {}
+	);
 };
 }; // namespace Repository
@@ -0,0 +1,119 @@
+#include <DB/BvhCache.hpp>
+#include <DB/ImageRepository.hpp>
+#include <DB/ObjRepository.hpp>
+#include <DB/SceneRepository.hpp>
+#include <filesystem>
+#include <map>
+
+using Renderer::Host::Bvh;
+using Renderer::Host::Bvh8;
+using Renderer::Host::Image;
+using Renderer::Host::Instance;
+using Renderer::Host::PrimitiveAttributes;
+
+
+namespace {
+
+inline bool fail(std::string* error, const std::string& message) {
+  if (error) *error = message;
+  return false;
+}
+
+} // namespace
+
+
+bool Repository::Scenes::load(
+  const std::vector<HostModel>& models,
+  HostScene& scene,
+  const std::string& cacheDirectory,
+  std::string* error
+) {
+  scene.meshes.assign(models.size(), EXP::MDL::HostMesh());
+  scene.structures.assign(models.size(), Bvh8());
+  scene.restir = Renderer::Host::RestirScene();
+  std::map<std::string, uint32_t> slots; // Texture path to its slot
+
+  std::vector<Instance> instances(models.size());
+  bool lit = false;
+  for (size_t m = 0; m < models.size(); m++) {
+    const HostModel& model = models[m];
+    EXP::MDL::HostMesh& mesh = scene.meshes[m];
+    if (!Obj::read(model.path, mesh, error)) return false;
+
+    // Textures::read for each submesh's diffuse map, an empty slot for the rest
+    std::vector<uint32_t> textures;
+    for (const EXP::MDL::HostSubmesh& submesh : mesh.submeshes) {
+      const std::string path = submesh.material >= 0 ? mesh.materials[submesh.material].diffuseTexture : "";
+      auto found = slots.find(path);
+      if (found == slots.end()) {
+        Image image;
+        if (!path.empty() && Images::read(path, image)) image.flipVertical(); // MTKTextureLoaderOriginBottomLeft
+        else image = Image();
+        found = slots.emplace(path, (uint32_t)scene.restir.textures.size()).first;
+        scene.restir.textures.push_back(std::move(image));
+      }
+      textures.push_back(found->second);
+    }
+
+    // Model::setColor and setEmissive
+    if (model.colored) {
+      for (Renderer::Host::VertexAttributes& attributes : mesh.attributes) attributes.color = model.color;
+    }
+    std::vector<PrimitiveAttributes> primitives = Renderer::Host::RestirRenderer::primitives(mesh, textures);
+    for (PrimitiveAttributes& primitive : primitives) {
+      if (model.colored) primitive.color[0] = primitive.color[1] = primitive.color[2] = model.color;
+      primitive.flags.y = model.emissive;
+    }
+    scene.restir.primitives.push_back(std::move(primitives));
+
+    const std::vector<Renderer::Host::BvhGeometry> geometries = Renderer::Host::BvhBuilder::geometries(mesh);
+    Bvh bvh;
+    if (cacheDirectory.empty()) {
+      BvhCache::build(geometries, bvh);
+    } else {
+      std::error_code code;
+      std::filesystem::create_directories(cacheDirectory, code);
+      const uint64_t key = BvhCache::key(geometries, {});
+      BvhCache::fetch((std::filesystem::path(cacheDirectory) / BvhCache::fileName(key)).string(), key, geometries, bvh);
+    }
+    Renderer::Host::WideBuilder::collapse(bvh, scene.structures[m]);
+
+    instances[m].transformationMatrix = model.transform;
+    instances[m].accelerationStructureIndex = (uint32_t)m;
+    if (model.emissive && !lit) {
+      scene.restir.light.vertices = mesh.vertices;
+      scene.restir.light.attributes = mesh.attributes;
+      scene.restir.light.orientation = model.transform;
+      lit = true;
+    }
+  }
+
+  std::vector<const Bvh8*> pointers;
+  for (const Bvh8& structure : scene.structures) pointers.push_back(&structure);
+  Renderer::Host::TlasBuilder::build(instances, pointers, scene.tlas);
+  scene.restir.structure = &scene.tlas;
+  if (!lit) return fail(error, "No emissive model to light the scene");
+  return true;
+}
+
+std::vector<Repository::HostModel> Repository::Scenes::showcase(const std::string& meshDirectory) {
+  const std::filesystem::path directory(meshDirectory);
+  HostModel f16, sphere1, sphere2;
+  f16.path = (directory / "f16/f16.obj").string();
+  sphere1.path = sphere2.path = (directory / "sphere/sphere.obj").string();
+  sphere1.emissive = true;
+  sphere1.colored = true;
+  sphere1.color = {4.0f, 4.0f, 1.0f, 0.0f};
+  sphere1.transform = placement({-0.3f, 0.6f, 0.1f}, 0.2f);
+  sphere2.colored = true;
+  sphere2.color = {0.0f, 1.0f, 0.0f, 1.0f};
+  sphere2.transform = placement({-0.2f, 0.3f, -0.3f}, 0.25f);
+  return {f16, sphere1, sphere2};
+}
+
+EXP::MATH::packed4x3 Repository::Scenes::placement(const EXP::MATH::float3& position, float scale) {
+  EXP::MATH::packed4x3 result = EXP::MATH::identity4x3();
+  result.columns[0].x = result.columns[1].y = result.columns[2].z = scale;
+  result.columns[3] = EXP::MATH::p3(position);
+  return result;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <Model/HostMesh.h>
+#include <Renderer/HostRestir.h>
+#include <Renderer/HostWideBvh.h>
+#include <string>
+#include <vector>
+
+/**
+ * Scenes for the CPU renderer, read without Metal: what EXP::SCENE sets up for RayTraceLayer, from
+ * OBJ files and the portable image decoders.
+ *
+ * Every HostModel is read, given its color and emission the way Model::setColor and setEmissive
+ * change the uploaded buffers, and placed by its transform. Diffuse textures are decoded and flipped
+ * as Textures::read does; submeshes without one get an empty slot, which samples 0. Each mesh gets a
+ * Bvh8 (through the .expbvh cache when a directory is given), and the instances a Tlas over them.
+ * The first emissive model is the light.
+ *
+ * HostScene points into itself: load it in place and do not copy or move it after.
+ **/
+
+namespace Repository {
+
+struct HostModel {
+  std::string path;                                                  // .obj
+  EXP::MATH::packed4x3 transform = EXP::MATH::identity4x3();         // Object to world
+  bool colored = false;                                              // Replace the colors with `color`
+  EXP::MATH::float4 color = {1.0f, 1.0f, 1.0f, 1.0f};
+  bool emissive = false;
+};
+
+struct HostScene {
+  std::vector<EXP::MDL::HostMesh> meshes;
+  std::vector<Renderer::Host::Bvh8> structures;
+  Renderer::Host::Tlas<Renderer::Host::Bvh8> tlas;
+  Renderer::Host::RestirScene restir;
+
+  HostScene(){};
+  HostScene(const HostScene&) = delete;
+  HostScene& operator=(const HostScene&) = delete;
+};
+
+class Scenes {
+public:
+  Scenes(){};
+  ~Scenes(){};
+
+public:
+  // The camera is left to the caller
+  static bool load(
+    const std::vector<HostModel>& models,
+    HostScene& scene,
+    const std::string& cacheDirectory = "",
+    std::string* error = nullptr
+  );
+  // RayTraceLayer::buildModels: the f16, an emissive sphere and a green one
+  static std::vector<HostModel> showcase(const std::string& meshDirectory);
+  // translation * scale, as Mesh::f4x4 without rotation
+  static EXP::MATH::packed4x3 placement(const EXP::MATH::float3& position, float scale);
+};
+
+}; // namespace Repository
@@ -0,0 +1,123 @@
+#include <DB/CacheFile.hpp>
+#include <DB/Hash.hpp>
+#include <DB/TextureCache.hpp>
+#include <cstring>
+
+using Renderer::Host::BlockChain;
+using Renderer::Host::BlockFormat;
+using Renderer::Host::BlockImage;
+using Renderer::Host::BlockQuality;
+using Renderer::Host::BlockReport;
+
+namespace {
+
+const char MAGIC[8] = {'E', 'X', 'P', 'T', 'E', 'X', 0, 0};
+
+} // namespace
+
+
+uint64_t Repository::TextureCache::hashSource(const std::string& imagePath, BlockFormat format, BlockQuality quality) {
+  MappedFile image(imagePath);
+  if (!image.isOpen()) return 0;
+  uint64_t hash = Hash::bytes(image.data(), image.size(), VERSION);
+  hash = Hash::combine(hash, (uint64_t)format << 8 | (uint64_t)quality);
+  return hash ? hash : 1;
+}
+
+
+bool Repository::TextureCache::write(
+  const std::string& path,
+  const BlockChain& chain,
+  uint64_t sourceHash,
+  const BlockReport& report,
+  std::string* error
+) {
+  if (chain.levels.empty()) return fail(error, "Nothing to write: " + path);
+  const BlockImage& base = chain.levels[0];
+  ExpTexHeader header = {};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.format = (uint32_t)base.format;
+  header.sourceHash = sourceHash;
+  header.width = base.width;
+  header.height = base.height;
+  header.levelCount = (uint32_t)chain.levels.size();
+  header.srgb = base.srgb ? 1 : 0;
+  header.psnr = (float)report.psnr;
+  header.alphaPsnr = (float)report.alphaPsnr;
+
+  std::vector<ExpTexLevel> levels(chain.levels.size());
+  uint64_t offset = alignUp(sizeof(ExpTexHeader) + levels.size() * sizeof(ExpTexLevel), ALIGNMENT);
+  for (size_t l = 0; l < levels.size(); l++) {
+    const BlockImage& level = chain.levels[l];
+    if (level.format != base.format || level.data.size() != level.blocksWide() * (size_t)level.blocksHigh() * level.blockBytes()) {
+      return fail(error, "Inconsistent block chain: " + path);
+    }
+    levels[l] = {level.width, level.height, offset, level.data.size()};
+    offset = alignUp(offset + level.data.size(), ALIGNMENT);
+  }
+  header.fileBytes = offset;
+
+  CacheWriter file(path, ALIGNMENT);
+  file.put(&header, sizeof(header));
+  file.put(levels.data(), levels.size() * sizeof(ExpTexLevel));
+  for (size_t l = 0; l < levels.size(); l++) {
+    file.padTo(levels[l].offset);
+    file.put(chain.levels[l].data.data(), levels[l].bytes);
+  }
+  file.padTo(header.fileBytes);
+  return file.commit(error);
+}
+
+
+bool Repository::TextureCache::open(const std::string& path, uint64_t sourceHash, std::string* error) {
+  close();
+  std::shared_ptr<MappedFile> mapped = std::make_shared<MappedFile>();
+  if (!mapped->open(path) || mapped->size() == 0) return fail(error, "No cache: " + path);
+
+  const uint64_t size = mapped->size();
+  const char* base = mapped->data();
+  if (!isCache<ExpTexHeader>(base, size, MAGIC)) return fail(error, "Not an exptex file: " + path);
+  const ExpTexHeader* candidate = (const ExpTexHeader*)base;
+  if (!checkCache(candidate->version == VERSION, candidate->sourceHash == sourceHash, candidate->fileBytes == size, path, error)) return false;
+  if (candidate->format > (uint32_t)BlockFormat::BC7 || candidate->levelCount == 0 ||
+      sizeof(ExpTexHeader) + (uint64_t)candidate->levelCount * sizeof(ExpTexLevel) > size) {
+    return fail(error, "Cache is corrupt: " + path);
+  }
+
+  // Every level bounds checked against the mapping and its block count
+  const size_t blockBytes = BlockImage::blockBytes((BlockFormat)candidate->format);
+  const ExpTexLevel* records = (const ExpTexLevel*)(base + sizeof(ExpTexHeader));
+  std::vector<CachedLevel> levels(candidate->levelCount);
+  for (uint32_t l = 0; l < candidate->levelCount; l++) {
+    const ExpTexLevel& record = records[l];
+    const size_t rowBytes = (record.width + 3) / 4 * blockBytes;
+    if (!inFile(record.offset, record.bytes, size, ALIGNMENT) || record.bytes != rowBytes * ((record.height + 3) / 4)) {
+      return fail(error, "Cache is corrupt: " + path);
+    }
+    levels[l] = {record.width, record.height, (const uint8_t*)base + record.offset, (size_t)record.bytes, rowBytes};
+  }
+
+  file = mapped;
+  header = candidate;
+  cachedLevels = std::move(levels);
+  return true;
+}
+
+void Repository::TextureCache::close() {
+  file.reset();
+  header = nullptr;
+  cachedLevels.clear();
+}
+
+void Repository::TextureCache::toBlockChain(BlockChain& chain) const {
+  chain.levels.assign(cachedLevels.size(), BlockImage{});
+  for (size_t l = 0; l < cachedLevels.size(); l++) {
+    BlockImage& level = chain.levels[l];
+    level.width = cachedLevels[l].width;
+    level.height = cachedLevels[l].height;
+    level.format = format();
+    level.srgb = srgb();
+    level.data.assign(cachedLevels[l].data, cachedLevels[l].data + cachedLevels[l].bytes);
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <DB/MappedFile.hpp>
+#include <Renderer/HostBlock.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * .exptex: block compressed mip chain, written next to the source image on first import.
+ *
+ * [Header][level records] | level 0 | level 1 | ...
+ *
+ * Levels are stored as the GPU wants them (rows of 4x4 blocks) and start on ALIGNMENT, so
+ * open() maps the file and hands out pointers for replaceRegion without copying. The cache is
+ * stale when the version, the encoder settings or the hash of the source image differ; open()
+ * then fails and the caller encodes again. The PSNR of the encode is kept in the header.
+ **/
+
+namespace Repository {
+
+struct ExpTexHeader {
+  char magic[8];      // "EXPTEX"
+  uint32_t version;
+  uint32_t format;    // Renderer::Host::BlockFormat
+  uint64_t sourceHash;
+  uint64_t fileBytes;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levelCount;
+  uint32_t srgb;
+  float psnr;
+  float alphaPsnr;
+};
+
+struct ExpTexLevel {
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+struct CachedLevel {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  const uint8_t* data = nullptr;
+  size_t bytes = 0;
+  size_t rowBytes = 0;
+};
+
+class TextureCache {
+public:
+  TextureCache(){};
+  ~TextureCache(){};
+
+public:
+  static constexpr uint32_t VERSION = 1;
+  static constexpr uint32_t ALIGNMENT = 256;
+
+  // Hash of the image bytes and the encoder settings. 0 when the image cannot be read.
+  static uint64_t hashSource(
+    const std::string& imagePath,
+    Renderer::Host::BlockFormat format,
+    Renderer::Host::BlockQuality quality
+  );
+  // Written to a temporary file, then renamed
+  static bool write(
+    const std::string& path,
+    const Renderer::Host::BlockChain& chain,
+    uint64_t sourceHash,
+    const Renderer::Host::BlockReport& report = {},
+    std::string* error = nullptr
+  );
+
+public:
+  bool open(const std::string& path, uint64_t sourceHash, std::string* error = nullptr);
+  void close();
+  // Copies the mapped levels (tests, tools)
+  void toBlockChain(Renderer::Host::BlockChain& chain) const;
+
+public:
+  inline bool isOpen() const { return header != nullptr; }
+  inline Renderer::Host::BlockFormat format() const { return (Renderer::Host::BlockFormat)header->format; }
+  inline bool srgb() const { return header->srgb != 0; }
+  inline uint32_t width() const { return header ? header->width : 0; }
+  inline uint32_t height() const { return header ? header->height : 0; }
+  inline const std::vector<CachedLevel>& levels() const { return cachedLevels; }
+  inline float psnr() const { return header ? header->psnr : 0.0f; }
+
+private:
+  std::shared_ptr<MappedFile> file;
+  const ExpTexHeader* header = nullptr;
+  std::vector<CachedLevel> cachedLevels;
+};
+
+}; // namespace Repository
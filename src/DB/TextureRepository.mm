@@ -1,5 +1,6 @@
 #include "Renderer/Types.h"
 #include <DB/Repository.h>
+#include <DB/ImageRepository.hpp>
 #include <DB/Repository.hpp>
 #include <Foundation/Foundation.h>
 #include <Metal/Metal.h>
@@ -8,6 +9,7 @@
 #include <ModelIO/MDLMaterial.h>
 #include <ModelIO/ModelIO.h>
 #include <Model/ResourceManager.h>
+#include <Renderer/HostMipmap.h>
 
 @implementation TextureRepository
 
@@ -80,7 +82,55 @@
 
 @end
 
-MTL::Texture* Repository::Textures::read(MTL::Device* device, std::string path) {
+namespace {
+
+MTL::PixelFormat pixelFormat(Renderer::Host::PixelFormat format) {
+	if (format == Renderer::Host::PixelFormat::RGBA8_UNORM) return MTL::PixelFormatRGBA8Unorm;
+	if (format == Renderer::Host::PixelFormat::RGBA16F) return MTL::PixelFormatRGBA16Float;
+	return MTL::PixelFormatRGBA8Unorm_sRGB;
+}
+
+MTL::PixelFormat blockFormat(Renderer::Host::BlockFormat format, bool srgb) {
+	if (format == Renderer::Host::BlockFormat::BC1) return srgb ? MTL::PixelFormatBC1_RGBA_sRGB : MTL::PixelFormatBC1_RGBA;
+	return srgb ? MTL::PixelFormatBC7_RGBAUnorm_sRGB : MTL::PixelFormatBC7_RGBAUnorm;
+}
+
+MTL::Texture* newTexture(MTL::Device* device, MTL::PixelFormat format, uint32_t width, uint32_t height, size_t levels) {
+	MTL::TextureDescriptor* descriptor = MTL::TextureDescriptor::texture2DDescriptor(format, width, height, levels > 1);
+	descriptor->setMipmapLevelCount(levels);
+	descriptor->setUsage(MTL::TextureUsageShaderRead);
+	descriptor->setStorageMode(MTL::StorageModeShared);
+	return device->newTexture(descriptor);
+}
+
+} // namespace
+
+MTL::Texture* Repository::Textures::read(MTL::Device* device, std::string path, const TextureImport& import) {
+	// BMP / TGA / JPEG decode on the CPU, with a gamma correct mip chain
+	if (Repository::Images::supports(path)) {
+		const bool compress = import.compress && device->supportsBCTextureCompression();
+		const std::string cachePath = path + ".exptex";
+		const uint64_t sourceHash = compress ? Repository::TextureCache::hashSource(path, import.format, import.quality) : 0;
+		Repository::TextureCache cache;
+		if (sourceHash && cache.open(cachePath, sourceHash)) return upload(device, cache);
+
+		Renderer::Host::Image image;
+		std::string error;
+		if (Repository::Images::read(path, image, &error)) {
+			image.flipVertical(); // MTKTextureLoaderOriginBottomLeft
+			Renderer::Host::MipChain chain;
+			Renderer::Host::Mipmap::build(image, chain);
+			if (!compress) return upload(device, chain);
+
+			Renderer::Host::BlockChain blocks;
+			const Renderer::Host::BlockReport report = Renderer::Host::BlockCompress::encode(chain, blocks, import.format, import.quality);
+			DEBUG("Compressed " + path + ": " + std::to_string(report.psnr) + " dB, " + std::to_string(report.seconds * 1000.0) + " ms");
+			if (!Repository::TextureCache::write(cachePath, blocks, sourceHash, report, &error)) WARN(error);
+			return upload(device, blocks);
+		}
+		WARN(error);
+	}
+
   NSError* error = nil;
   MTKTextureLoader* loader = [[MTKTextureLoader alloc] initWithDevice:(__bridge id<MTLDevice>)device];
   NSURL* fullPath = (__bridge NSURL*)EXP::nsUrl(path);
@@ -88,3 +138,89 @@ MTL::Texture* Repository::Textures::read(MTL::Device* device, std::string path)
   id<MTLTexture> texture = [loader newTextureWithContentsOfURL:fullPath options:options error:&error];
   return (__bridge MTL::Texture*)texture;
 }
+
+MTL::Texture* Repository::Textures::upload(MTL::Device* device, const Renderer::Host::MipChain& chain) {
+	if (chain.levels.empty()) return nullptr;
+	const Renderer::Host::Image& base = chain.levels[0];
+	MTL::Texture* texture = newTexture(device, pixelFormat(base.format), base.width, base.height, chain.levels.size());
+	for (size_t level = 0; level < chain.levels.size(); level++) {
+		const Renderer::Host::Image& image = chain.levels[level];
+		texture->replaceRegion(MTL::Region(0, 0, image.width, image.height), level, image.data.data(), image.rowBytes());
+	}
+	return texture;
+}
+
+// Compressed levels: bytesPerRow is one row of 4x4 blocks
+MTL::Texture* Repository::Textures::upload(MTL::Device* device, const Renderer::Host::BlockChain& chain) {
+	if (chain.levels.empty()) return nullptr;
+	const Renderer::Host::BlockImage& base = chain.levels[0];
+	MTL::Texture* texture = newTexture(device, blockFormat(base.format, base.srgb), base.width, base.height, chain.levels.size());
+	for (size_t level = 0; level < chain.levels.size(); level++) {
+		const Renderer::Host::BlockImage& image = chain.levels[level];
+		texture->replaceRegion(MTL::Region(0, 0, image.width, image.height), level, image.data.data(), image.rowBytes());
+	}
+	return texture;
+}
+
+MTL::Texture* Repository::Textures::upload(MTL::Device* device, const TextureCache& cache) {
+	if (!cache.isOpen()) return nullptr;
+	MTL::Texture* texture = newTexture(device, blockFormat(cache.format(), cache.srgb()), cache.width(), cache.height(), cache.levels().size());
+	for (size_t level = 0; level < cache.levels().size(); level++) {
+		const CachedLevel& image = cache.levels()[level];
+		texture->replaceRegion(MTL::Region(0, 0, image.width, image.height), level, image.data, image.rowBytes);
+	}
+	return texture;
+}
+
+bool Repository::Textures::source(
+		MTL::Device* device,
+		const std::string& path,
+		Renderer::Host::StreamSource& source,
+		const TextureImport& import
+) {
+	if (!Repository::Images::supports(path)) return false;
+	source = {};
+	const bool compress = import.compress && device->supportsBCTextureCompression();
+	const std::string cachePath = path + ".exptex";
+	const uint64_t sourceHash = compress ? Repository::TextureCache::hashSource(path, import.format, import.quality) : 0;
+
+	// Levels stay in the mapping, the cache object keeps it open
+	std::shared_ptr<Repository::TextureCache> cache = std::make_shared<Repository::TextureCache>();
+	if (sourceHash && cache->open(cachePath, sourceHash)) {
+		for (const CachedLevel& level : cache->levels()) {
+			source.levels.push_back({level.width, level.height, level.data, level.bytes, level.rowBytes});
+		}
+		source.format = (uint32_t)blockFormat(cache->format(), cache->srgb());
+		source.store = cache;
+		return true;
+	}
+
+	Renderer::Host::Image image;
+	std::string error;
+	if (!Repository::Images::read(path, image, &error)) {
+		WARN(error);
+		return false;
+	}
+	image.flipVertical(); // MTKTextureLoaderOriginBottomLeft
+	std::shared_ptr<Renderer::Host::MipChain> chain = std::make_shared<Renderer::Host::MipChain>();
+	Renderer::Host::Mipmap::build(image, *chain);
+	if (!compress) {
+		for (const Renderer::Host::Image& level : chain->levels) {
+			source.levels.push_back({level.width, level.height, level.data.data(), level.data.size(), level.rowBytes()});
+		}
+		source.format = (uint32_t)pixelFormat(chain->levels[0].format);
+		source.store = chain;
+		return true;
+	}
+
+	std::shared_ptr<Renderer::Host::BlockChain> blocks = std::make_shared<Renderer::Host::BlockChain>();
+	const Renderer::Host::BlockReport report = Renderer::Host::BlockCompress::encode(*chain, *blocks, import.format, import.quality);
+	DEBUG("Compressed " + path + ": " + std::to_string(report.psnr) + " dB, " + std::to_string(report.seconds * 1000.0) + " ms");
+	if (!Repository::TextureCache::write(cachePath, *blocks, sourceHash, report, &error)) WARN(error);
+	for (const Renderer::Host::BlockImage& level : blocks->levels) {
+		source.levels.push_back({level.width, level.height, level.data.data(), level.data.size(), level.rowBytes()});
+	}
+	source.format = (uint32_t)blockFormat(blocks->levels[0].format, blocks->levels[0].srgb);
+	source.store = blocks;
+	return true;
+}
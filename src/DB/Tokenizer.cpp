@@ -0,0 +1,433 @@
+#include <DB/Tokenizer.hpp>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EXP_TOKENIZER_X86 1
+#include <immintrin.h>
+#define TARGET_SSE41 __attribute__((target("ssse3,sse4.1")))
+#define TARGET_AVX2 __attribute__((target("ssse3,sse4.1,avx2")))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define EXP_TOKENIZER_NEON 1
+#include <arm_neon.h>
+#endif
+
+using Tokenizer = Repository::Tokenizer;
+using Isa = Repository::Isa;
+
+namespace {
+
+const double POW10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Widest field the vector paths take: 15 characters plus the terminator fit in one 16 byte load.
+constexpr int FIELD_BYTES = 16;
+
+// Every path ends here, which is what makes them bit identical.
+inline float convert(uint64_t mantissa, int exponent, bool negative) {
+  double value = (double)mantissa;
+  if (mantissa == 0) {
+    value = 0.0;
+  } else if (mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+    // Both operands exact: one rounding to double, one to float
+    value = exponent < 0 ? value / POW10[-exponent] : value * POW10[exponent];
+  } else {
+    value = value * std::pow(10.0, (double)exponent);
+  }
+  return (float)(negative ? -value : value);
+}
+
+inline int countTrailing(uint32_t mask) { return __builtin_ctz(mask); }
+
+inline bool sign(const char*& s, const char* end) {
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+  return negative;
+}
+
+struct Field {
+  int length = 0;  // Characters, point included
+  int digits = 0;
+  int point = 0;   // Digits before the decimal point
+};
+
+// Where the vector paths agree with the scalar parser. `digitMask` / `dotMask` hold one bit per
+// byte of the 16 bytes at s. The number must end inside them and must not carry an exponent.
+// When `blankTerminated` the number must also end on a blank or newline, so the next field
+// starts at the next non-blank (what the scalar skipBlank would find).
+inline bool classify(const char* s, uint32_t digitMask, uint32_t dotMask, bool blankTerminated, Field& field) {
+  const uint32_t stopMask = ~(digitMask | dotMask) & 0xFFFF;
+  if (!stopMask) return false;
+  field.length = countTrailing(stopMask);
+
+  const char terminator = s[field.length];
+  if (terminator == 'e' || terminator == 'E') return false;
+  if (blankTerminated && !(Tokenizer::isBlank(terminator) || terminator == '\n')) return false;
+
+  const uint32_t dots = dotMask & ((1u << field.length) - 1);
+  if (dots & (dots - 1)) return false;
+  field.point = dots ? countTrailing(dots) : field.length;
+  field.digits = field.length - (dots ? 1 : 0);
+  return field.digits > 0;
+}
+
+// Up to 19 significant digits go into the mantissa; leading zeros do not count.
+inline bool scalarFloat(const char*& p, const char* end, float& out) {
+  const char* s = p;
+  const bool negative = sign(s, end);
+
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  for (; s < end && Tokenizer::isDigit(*s); s++, any = true) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*s - '0');
+      digits += mantissa != 0;
+    } else {
+      exponent += 1;
+    }
+  }
+  if (s < end && *s == '.') {
+    for (s++; s < end && Tokenizer::isDigit(*s); s++, any = true) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*s - '0');
+        digits += mantissa != 0;
+        exponent -= 1;
+      }
+    }
+  }
+  if (!any) return false;
+
+  if (s < end && (*s == 'e' || *s == 'E')) {
+    const char* e = s + 1;
+    const bool negativeExp = sign(e, end);
+    if (e < end && Tokenizer::isDigit(*e)) {
+      int value = 0;
+      for (; e < end && Tokenizer::isDigit(*e); e++) value = value < 10000 ? value * 10 + (*e - '0') : value;
+      exponent += negativeExp ? -value : value;
+      s = e;
+    }
+  }
+
+  out = convert(mantissa, exponent, negative);
+  p = s;
+  return true;
+}
+
+inline bool scalarInt(const char*& p, const char* end, int32_t& out) {
+  const char* s = p;
+  const bool negative = sign(s, end);
+  if (s >= end || !Tokenizer::isDigit(*s)) return false;
+  int64_t value = 0;
+  for (; s < end && Tokenizer::isDigit(*s); s++) value = value * 10 + (*s - '0');
+  out = (int32_t)(negative ? -value : value);
+  p = s;
+  return true;
+}
+
+inline int scalarFloats(const char*& p, const char* end, float* out, int count) {
+  int parsed = 0;
+  for (; parsed < count; parsed++) {
+    Tokenizer::skipBlank(p, end);
+    if (!scalarFloat(p, end, out[parsed])) break;
+  }
+  return parsed;
+}
+
+
+#if EXP_TOKENIZER_X86
+
+// Byte k of the result is digit (k - 16 + digits) of the field, skipping the point; zero before.
+TARGET_SSE41 inline __m128i alignDigits(__m128i digits, int count, int point) {
+  const __m128i k = _mm_sub_epi8(_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm_set1_epi8((char)(16 - count)));
+  const __m128i skip = _mm_cmpgt_epi8(k, _mm_set1_epi8((char)(point - 1)));
+  const __m128i index = _mm_or_si128(_mm_sub_epi8(k, skip), _mm_cmpgt_epi8(_mm_setzero_si128(), k));
+  return _mm_shuffle_epi8(digits, index);
+}
+
+// 16 right aligned digits (one per byte) to their value: pairs, quads, octets, then one multiply.
+TARGET_SSE41 inline uint64_t digitsValue(__m128i digits) {
+  const __m128i pairs = _mm_maddubs_epi16(digits, _mm_set1_epi16(0x010A));
+  const __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00010064));
+  const __m128i octets = _mm_madd_epi16(_mm_packus_epi32(quads, quads), _mm_set1_epi32(0x00012710));
+  return (uint64_t)(uint32_t)_mm_cvtsi128_si32(octets) * 100000000ull + (uint32_t)_mm_extract_epi32(octets, 1);
+}
+
+TARGET_SSE41 inline void classifyBytes(__m128i bytes, uint32_t& digitMask, uint32_t& dotMask) {
+  const __m128i digits = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+  digitMask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits));
+  dotMask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('.')));
+}
+
+TARGET_SSE41 bool floatSse(const char*& p, const char* end, float& out) {
+  const char* s = p;
+  const bool negative = sign(s, end);
+  if (end - s < FIELD_BYTES) return scalarFloat(p, end, out);
+
+  const __m128i bytes = _mm_loadu_si128((const __m128i*)s);
+  uint32_t digitMask, dotMask;
+  classifyBytes(bytes, digitMask, dotMask);
+  Field field;
+  if (!classify(s, digitMask, dotMask, false, field)) return scalarFloat(p, end, out);
+
+  const __m128i digits = alignDigits(_mm_sub_epi8(bytes, _mm_set1_epi8('0')), field.digits, field.point);
+  out = convert(digitsValue(digits), field.point - field.digits, negative);
+  p = s + field.length;
+  return true;
+}
+
+TARGET_SSE41 bool intSse(const char*& p, const char* end, int32_t& out) {
+  const char* s = p;
+  const bool negative = sign(s, end);
+  if (end - s < FIELD_BYTES) return scalarInt(p, end, out);
+
+  const __m128i bytes = _mm_loadu_si128((const __m128i*)s);
+  uint32_t digitMask, dotMask;
+  classifyBytes(bytes, digitMask, dotMask);
+  const int count = countTrailing(~digitMask);
+  // Ten digits and up may overflow int32; the scalar parser defines what happens then
+  if (count == 0 || count > 9) return scalarInt(p, end, out);
+
+  const int64_t value = (int64_t)digitsValue(alignDigits(_mm_sub_epi8(bytes, _mm_set1_epi8('0')), count, count));
+  out = (int32_t)(negative ? -value : value);
+  p = s + count;
+  return true;
+}
+
+TARGET_SSE41 int floatsSse(const char*& p, const char* end, float* out, int count) {
+  int parsed = 0;
+  for (; parsed < count; parsed++) {
+    Tokenizer::skipBlank(p, end);
+    if (!floatSse(p, end, out[parsed])) break;
+  }
+  return parsed;
+}
+
+// One 32 byte load finds where every field of the line starts; fields are then converted two
+// at a time, one per 128 bit lane. Shuffles and multiply-adds never cross lanes.
+TARGET_AVX2 int floatsAvx2(const char*& p, const char* end, float* out, int count) {
+  Tokenizer::skipBlank(p, end);
+  // 32 bytes of starts, each followed by a sign and a 16 byte field load
+  if (count < 2 || end - p < 32 + 1 + FIELD_BYTES) return floatsSse(p, end, out, count);
+
+  const __m256i window = _mm256_loadu_si256((const __m256i*)p);
+  const __m256i blanks = _mm256_or_si256(
+    _mm256_or_si256(_mm256_cmpeq_epi8(window, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(window, _mm256_set1_epi8('\t'))),
+    _mm256_cmpeq_epi8(window, _mm256_set1_epi8('\r'))
+  );
+  const uint32_t blank = (uint32_t)_mm256_movemask_epi8(blanks);
+  const uint32_t newline = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(window, _mm256_set1_epi8('\n')));
+  const uint32_t line = newline ? (1u << countTrailing(newline)) - 1 : ~0u;
+  uint32_t startMask = ~blank & ((blank << 1) | 1u) & line;
+
+  const char* starts[4];
+  int found = 0;
+  for (; startMask && found < count && found < 4; startMask &= startMask - 1) starts[found++] = p + countTrailing(startMask);
+
+  int parsed = 0;
+  const char* resume = p;
+  while (parsed + 1 < found) {
+    const char* s[2] = {starts[parsed], starts[parsed + 1]};
+    bool negative[2];
+    for (int lane = 0; lane < 2; lane++) negative[lane] = sign(s[lane], end);
+
+    const __m256i bytes = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)s[0])), _mm_loadu_si128((const __m128i*)s[1]), 1
+    );
+    const __m256i digits = _mm256_sub_epi8(bytes, _mm256_set1_epi8('0'));
+    const uint32_t digitMask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(digits, _mm256_set1_epi8(9)), digits));
+    const uint32_t dotMask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('.')));
+
+    Field field[2];
+    const bool valid[2] = {
+      classify(s[0], digitMask & 0xFFFF, dotMask & 0xFFFF, true, field[0]),
+      classify(s[1], digitMask >> 16, dotMask >> 16, true, field[1])
+    };
+    if (!valid[0]) break;
+
+    const __m256i iota = _mm256_setr_epi8(
+      0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+      0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    );
+    const __m256i k = _mm256_sub_epi8(iota, _mm256_set_m128i(_mm_set1_epi8((char)(16 - field[1].digits)), _mm_set1_epi8((char)(16 - field[0].digits))));
+    const __m256i skip = _mm256_cmpgt_epi8(k, _mm256_set_m128i(_mm_set1_epi8((char)(field[1].point - 1)), _mm_set1_epi8((char)(field[0].point - 1))));
+    const __m256i index = _mm256_or_si256(_mm256_sub_epi8(k, skip), _mm256_cmpgt_epi8(_mm256_setzero_si256(), k));
+    const __m256i aligned = _mm256_shuffle_epi8(digits, index);
+
+    const __m256i pairs = _mm256_maddubs_epi16(aligned, _mm256_set1_epi16(0x010A));
+    const __m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00010064));
+    const __m256i octets = _mm256_madd_epi16(_mm256_packus_epi32(quads, quads), _mm256_set1_epi32(0x00012710));
+
+    // high * 10^8 + low per lane, in 64 bit: the mantissas land in elements 0 and 2
+    const __m256i mantissas = _mm256_add_epi64(_mm256_mul_epu32(octets, _mm256_set1_epi64x(100000000)), _mm256_srli_epi64(octets, 32));
+    const uint64_t first = (uint64_t)_mm256_extract_epi64(mantissas, 0);
+    out[parsed++] = convert(first, field[0].point - field[0].digits, negative[0]);
+    resume = s[0] + field[0].length;
+    if (!valid[1]) break;
+
+    const uint64_t second = (uint64_t)_mm256_extract_epi64(mantissas, 2);
+    out[parsed++] = convert(second, field[1].point - field[1].digits, negative[1]);
+    resume = s[1] + field[1].length;
+  }
+  // Odd field out, fields past the window and rejected fields: the single field path.
+  // resume is the end of the last accepted field, where the scalar loop would be too.
+  p = resume;
+  return parsed + floatsSse(p, end, out + parsed, count - parsed);
+}
+
+#endif // EXP_TOKENIZER_X86
+
+
+#if EXP_TOKENIZER_NEON
+
+inline uint32_t bitmask(uint8x16_t mask) {
+  const uint8x16_t bits = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  const uint8x16_t selected = vandq_u8(mask, bits);
+  return (uint32_t)vaddv_u8(vget_low_u8(selected)) | ((uint32_t)vaddv_u8(vget_high_u8(selected)) << 8);
+}
+
+inline uint8x16_t alignDigits(uint8x16_t digits, int count, int point) {
+  const int8x16_t iota = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+  const int8x16_t k = vsubq_s8(iota, vdupq_n_s8((int8_t)(16 - count)));
+  const int8x16_t skip = vreinterpretq_s8_u8(vcgeq_s8(k, vdupq_n_s8((int8_t)point)));
+  // Out of range indices (negative k) read as zero
+  const uint8x16_t index = vorrq_u8(vreinterpretq_u8_s8(vsubq_s8(k, skip)), vcltzq_s8(k));
+  return vqtbl1q_u8(digits, index);
+}
+
+inline uint64_t digitsValue(uint8x16_t digits) {
+  const uint8x16_t tens = {10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1};
+  const uint16x8_t hundreds = {100, 1, 100, 1, 100, 1, 100, 1};
+  const uint32x4_t tenThousands = {10000, 1, 10000, 1};
+  const uint16x8_t pairs = vpaddlq_u8(vmulq_u8(digits, tens));
+  const uint32x4_t quads = vpaddlq_u16(vmulq_u16(pairs, hundreds));
+  const uint64x2_t octets = vpaddlq_u32(vmulq_u32(quads, tenThousands));
+  return vgetq_lane_u64(octets, 0) * 100000000ull + vgetq_lane_u64(octets, 1);
+}
+
+inline void classifyBytes(uint8x16_t bytes, uint8x16_t& digits, uint32_t& digitMask, uint32_t& dotMask) {
+  digits = vsubq_u8(bytes, vdupq_n_u8('0'));
+  digitMask = bitmask(vcltq_u8(digits, vdupq_n_u8(10)));
+  dotMask = bitmask(vceqq_u8(bytes, vdupq_n_u8('.')));
+}
+
+bool floatNeon(const char*& p, const char* end, float& out) {
+  const char* s = p;
+  const bool negative = sign(s, end);
+  if (end - s < FIELD_BYTES) return scalarFloat(p, end, out);
+
+  uint8x16_t digits;
+  uint32_t digitMask, dotMask;
+  classifyBytes(vld1q_u8((const uint8_t*)s), digits, digitMask, dotMask);
+  Field field;
+  if (!classify(s, digitMask, dotMask, false, field)) return scalarFloat(p, end, out);
+
+  out = convert(digitsValue(alignDigits(digits, field.digits, field.point)), field.point - field.digits, negative);
+  p = s + field.length;
+  return true;
+}
+
+bool intNeon(const char*& p, const char* end, int32_t& out) {
+  const char* s = p;
+  const bool negative = sign(s, end);
+  if (end - s < FIELD_BYTES) return scalarInt(p, end, out);
+
+  uint8x16_t digits;
+  uint32_t digitMask, dotMask;
+  classifyBytes(vld1q_u8((const uint8_t*)s), digits, digitMask, dotMask);
+  const int count = countTrailing(~digitMask);
+  if (count == 0 || count > 9) return scalarInt(p, end, out);
+
+  const int64_t value = (int64_t)digitsValue(alignDigits(digits, count, count));
+  out = (int32_t)(negative ? -value : value);
+  p = s + count;
+  return true;
+}
+
+int floatsNeon(const char*& p, const char* end, float* out, int count) {
+  int parsed = 0;
+  for (; parsed < count; parsed++) {
+    Tokenizer::skipBlank(p, end);
+    if (!floatNeon(p, end, out[parsed])) break;
+  }
+  return parsed;
+}
+
+#endif // EXP_TOKENIZER_NEON
+
+Isa detect() {
+#if EXP_TOKENIZER_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+  if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3")) return Isa::SSE41;
+#elif EXP_TOKENIZER_NEON
+  return Isa::NEON;
+#endif
+  return Isa::SCALAR;
+}
+
+} // namespace
+
+
+Isa Tokenizer::best() {
+  static const Isa isa = detect();
+  return isa;
+}
+
+bool Tokenizer::supported(const Isa& isa) {
+  if (isa == Isa::SCALAR) return true;
+  const Isa available = best();
+  if (available == Isa::NEON) return isa == Isa::NEON;
+  return isa != Isa::NEON && (int)isa <= (int)available;
+}
+
+const char* Tokenizer::name(const Isa& isa) {
+  switch (isa) {
+  case Isa::SSE41: return "sse4.1";
+  case Isa::AVX2: return "avx2";
+  case Isa::NEON: return "neon";
+  default: return "scalar";
+  }
+}
+
+float Tokenizer::toFloat(uint64_t mantissa, int exponent, bool negative) {
+  return convert(mantissa, exponent, negative);
+}
+
+bool Tokenizer::parseFloat(const char*& p, const char* end, float& out) {
+  return scalarFloat(p, end, out);
+}
+
+bool Tokenizer::parseInt(const char*& p, const char* end, int32_t& out) {
+  return parseInt(p, end, out, best());
+}
+
+bool Tokenizer::parseInt(const char*& p, const char* end, int32_t& out, const Isa& isa) {
+  switch (isa) {
+#if EXP_TOKENIZER_X86
+  case Isa::SSE41:
+  case Isa::AVX2: return intSse(p, end, out);
+#elif EXP_TOKENIZER_NEON
+  case Isa::NEON: return intNeon(p, end, out);
+#endif
+  default: return scalarInt(p, end, out);
+  }
+}
+
+int Tokenizer::parseFloats(const char*& p, const char* end, float* out, int count) {
+  return parseFloats(p, end, out, count, best());
+}
+
+int Tokenizer::parseFloats(const char*& p, const char* end, float* out, int count, const Isa& isa) {
+  switch (isa) {
+#if EXP_TOKENIZER_X86
+  case Isa::SSE41: return floatsSse(p, end, out, count);
+  case Isa::AVX2: return floatsAvx2(p, end, out, count);
+#elif EXP_TOKENIZER_NEON
+  case Isa::NEON: return floatsNeon(p, end, out, count);
+#endif
+  default: return scalarFloats(p, end, out, count);
+  }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Locale independent number tokenizer for text assets (OBJ, MTL).
+ *
+ * Vector paths classify 16 bytes at a time: the end of the number and the decimal point
+ * come out of a compare + movemask, the digits are right aligned with one byte shuffle and
+ * converted with multiply-adds (AVX2 converts two fields per instruction, one per lane).
+ * Anything the fast path does not handle (exponents, more than 15 characters, end of buffer)
+ * goes through the scalar parser. Both produce the same mantissa / exponent pair and share
+ * the final conversion, so results are bit identical for every Isa.
+ **/
+
+namespace Repository {
+
+enum struct Isa {
+  SCALAR = 0,
+  SSE41 = 1,  // SSSE3 shuffle + SSE4.1 pack
+  AVX2 = 2,
+  NEON = 3
+};
+
+struct Tokenizer {
+public: // Dispatch
+  static Isa best();
+  static bool supported(const Isa& isa);
+  static const char* name(const Isa& isa);
+
+public: // Numbers
+  // A single number at p; advances p past it. Returns false (p untouched) when there is none.
+  static bool parseFloat(const char*& p, const char* end, float& out);
+  static bool parseInt(const char*& p, const char* end, int32_t& out);
+  static bool parseInt(const char*& p, const char* end, int32_t& out, const Isa& isa);
+
+  // Up to `count` blank separated floats on the current line. Returns how many were read.
+  static int parseFloats(const char*& p, const char* end, float* out, int count);
+  static int parseFloats(const char*& p, const char* end, float* out, int count, const Isa& isa);
+
+  // Decimal mantissa * 10^exponent, rounded once when the double fast path applies.
+  static float toFloat(uint64_t mantissa, int exponent, bool negative);
+
+public: // Lines
+  static inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+  static inline bool isDigit(char c) { return (unsigned char)(c - '0') < 10; }
+
+  static inline void skipBlank(const char*& p, const char* end) {
+    while (p < end && isBlank(*p)) p++;
+  }
+
+  static inline const char* lineEnd(const char* p, const char* end) {
+    if (p >= end) return end;
+    const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+    return newline ? newline : end;
+  }
+
+  static inline void skipLine(const char*& p, const char* end) {
+    const char* last = lineEnd(p, end);
+    p = last < end ? last + 1 : end;
+  }
+};
+
+}; // namespace Repository
@@ -40,6 +40,7 @@ EXP::RayTraceLayer::RayTraceLayer(MTL::Device* device, std::shared_ptr<const App
 void EXP::RayTraceLayer::buildModels(MTL::Device* device) {
 
 	EXP::SCENE::addTexture(device, "reservoirs", Renderer::TextureAccess::READ_WRITE);
+	EXP::SCENE::setTextureBudget(device, {}, _gridSize.width);
 	
 	EXP::SCENE::addModel(device, _vertexDescriptor, config->mesh_path / "f16/f16", "f16");
 	EXP::SCENE::addModel(device, _vertexDescriptor, config->mesh_path / "sphere/sphere", "sphere1");
@@ -81,14 +82,30 @@ void EXP::RayTraceLayer::buildAccelerationStructures(MTL::Device* device) {
 	// instance acc structure
 	_instanceDescriptor = Renderer::Descriptor::instance(device, _primitiveAccStructures, EXP::SCENE::getMeshes())->retain();
 	_instanceSizes = device->accelerationStructureSizes(_instanceDescriptor);
-	_scratchBuffer = device->newBuffer(_instanceSizes.buildScratchBufferSize, MTL::ResourceStorageModePrivate)->retain();
+	size_t scratchSize = std::max(_instanceSizes.buildScratchBufferSize, _instanceSizes.refitScratchBufferSize);
+	_scratchBuffer = device->newBuffer(scratchSize, MTL::ResourceStorageModePrivate)->retain();
 	_instanceAccStructure = device->newAccelerationStructure(_instanceSizes.accelerationStructureSize);
   	_instanceAccStructure = Renderer::Acceleration::instance(device, queue, _instanceAccStructure, _instanceDescriptor, _scratchBuffer, _buildEvent);
+
+	// the same top level on the CPU, to tell what each frame needs. Nothing traverses it yet, so
+	// the meshes are boxes only; hostWidePrimitives has the full trees once something does
+	_hostStructures = Renderer::Acceleration::hostBounds(EXP::SCENE::getMeshes(), vStride);
+	Renderer::Acceleration::hostInstance(_hostStructures, EXP::SCENE::getMeshes(), _hostTlas);
 }
 
+// Nothing when no model moved, a refit when some did, a full build once refits have cost too much quality
 void EXP::RayTraceLayer::rebuildAccelerationStructures(MTK::View* view) {
-    _instanceDescriptor = Renderer::Descriptor::updateTransformationMatrix(EXP::SCENE::getMeshes(), _instanceDescriptor);
-    _instanceAccStructure = Renderer::Acceleration::instance(device, queue, _instanceAccStructure, _instanceDescriptor, _scratchBuffer, _buildEvent);
+	const std::vector<Renderer::Host::Instance> instances = Renderer::Descriptor::hostInstance(EXP::SCENE::getMeshes());
+	const Renderer::Host::TlasUpdate update = Renderer::Host::TlasBuilder::update(instances, _hostTlas);
+	if (update.action == Renderer::Host::TlasAction::NONE) return;
+
+	_instanceDescriptor = Renderer::Descriptor::updateTransformationMatrix(EXP::SCENE::getMeshes(), _instanceDescriptor);
+	if (update.action == Renderer::Host::TlasAction::REFIT) {
+		_instanceAccStructure = Renderer::Acceleration::refit(device, queue, _instanceDescriptor, _instanceAccStructure, _scratchBuffer, _buildEvent);
+	} else {
+		DEBUG("Instance structure rebuilt, SAH " + std::to_string(update.sahCost));
+		_instanceAccStructure = Renderer::Acceleration::instance(device, queue, _instanceAccStructure, _instanceDescriptor, _scratchBuffer, _buildEvent);
+	}
 }
 
 void EXP::RayTraceLayer::onUpdate(MTK::View* view, MTL::RenderCommandEncoder* notUsed) {
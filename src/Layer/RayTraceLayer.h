@@ -6,6 +6,7 @@
 #include <Model/Camera.h>
 #include <Model/MeshFactory.h>
 #include <Model/ResourceManager.h>
+#include <Renderer/HostInstance.h>
 #include <pch.h>
 
 namespace EXP {
@@ -60,7 +61,11 @@ private:
   MTL::InstanceAccelerationStructureDescriptor* _instanceRefitDescriptor;
   MTL::AccelerationStructure* _instanceAccStructure;
   MTL::AccelerationStructureSizes _instanceSizes;
-  MTL::Buffer* _scratchBuffer;
+  MTL::Buffer* _scratchBuffer; // Build and refit both, sized for the larger
+
+private: // CPU copy of the instance structure: what moved, and whether a refit still does
+  std::vector<Renderer::Host::BlasBounds> _hostStructures;
+  Renderer::Host::Tlas<Renderer::Host::BlasBounds> _hostTlas;
 
 private:
   MTL::ComputePassDescriptor* _temporalDescriptor;
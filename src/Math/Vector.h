@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/**
+ * Portable counterparts of the simd vector types.
+ *
+ * Size and alignment match simd::float2 / float3 / float4 so that host side
+ * buffers can be memcpy'd into Metal buffers without repacking.
+ * packed3 matches MTL::PackedFloat3 (tightly packed XYZ, 12 bytes), packed4x3 matches
+ * MTL::PackedFloat4x3 (four packed columns, the last one the translation).
+ *
+ * Nothing in here includes Metal or simd, so it compiles on Linux.
+ **/
+
+namespace EXP {
+namespace MATH {
+
+struct alignas(8) float2 {
+  float x, y;
+};
+
+struct alignas(16) float3 {
+  float x, y, z;
+  inline float& operator[](int i) { return (&x)[i]; }
+  inline const float& operator[](int i) const { return (&x)[i]; }
+};
+
+struct alignas(16) float4 {
+  float x, y, z, w;
+  inline float& operator[](int i) { return (&x)[i]; }
+  inline const float& operator[](int i) const { return (&x)[i]; }
+};
+
+struct packed3 {
+  float x, y, z;
+  inline float& operator[](int i) { return (&x)[i]; }
+  inline const float& operator[](int i) const { return (&x)[i]; }
+};
+
+struct alignas(8) uint2 {
+  uint32_t x, y;
+  inline uint32_t& operator[](int i) { return (&x)[i]; }
+  inline const uint32_t& operator[](int i) const { return (&x)[i]; }
+};
+
+// Affine transform, column major: columns[3] is the translation
+struct packed4x3 {
+  packed3 columns[4];
+};
+
+static_assert(sizeof(float2) == 8, "float2 must match simd::float2");
+static_assert(sizeof(float3) == 16, "float3 must match simd::float3");
+static_assert(sizeof(float4) == 16, "float4 must match simd::float4");
+static_assert(sizeof(packed3) == 12, "packed3 must match MTL::PackedFloat3");
+static_assert(sizeof(packed4x3) == 48, "packed4x3 must match MTL::PackedFloat4x3");
+
+inline float3 f3(const packed3& p) { return {p.x, p.y, p.z}; }
+inline packed3 p3(const float3& v) { return {v.x, v.y, v.z}; }
+
+inline float2 operator+(const float2& a, const float2& b) { return {a.x + b.x, a.y + b.y}; }
+inline float2 operator-(const float2& a, const float2& b) { return {a.x - b.x, a.y - b.y}; }
+inline float2 operator*(const float2& a, float s) { return {a.x * s, a.y * s}; }
+
+inline float3 operator+(const float3& a, const float3& b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline float3 operator-(const float3& a, const float3& b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline float3 operator*(const float3& a, const float3& b) { return {a.x * b.x, a.y * b.y, a.z * b.z}; }
+inline float3 operator/(const float3& a, const float3& b) { return {a.x / b.x, a.y / b.y, a.z / b.z}; }
+inline float3 operator*(const float3& a, float s) { return {a.x * s, a.y * s, a.z * s}; }
+inline float3 operator*(float s, const float3& a) { return {a.x * s, a.y * s, a.z * s}; }
+inline float3 operator/(const float3& a, float s) { return a * (1.0f / s); }
+inline float3 operator-(const float3& a) { return {-a.x, -a.y, -a.z}; }
+inline float3& operator+=(float3& a, const float3& b) { a = a + b; return a; }
+inline float3& operator-=(float3& a, const float3& b) { a = a - b; return a; }
+inline float3& operator*=(float3& a, float s) { a = a * s; return a; }
+
+inline float4 operator+(const float4& a, const float4& b) { return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w}; }
+inline float4 operator-(const float4& a, const float4& b) { return {a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w}; }
+inline float4 operator*(const float4& a, const float4& b) { return {a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w}; }
+inline float4 operator*(const float4& a, float s) { return {a.x * s, a.y * s, a.z * s, a.w * s}; }
+inline float4& operator+=(float4& a, const float4& b) { a = a + b; return a; }
+
+inline float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float3 cross(const float3& a, const float3& b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+inline float length(const float3& a) { return std::sqrt(dot(a, a)); }
+inline float length_squared(const float3& a) { return dot(a, a); }
+inline float distance_squared(const float3& a, const float3& b) { return length_squared(a - b); }
+inline float3 normalize(const float3& a) {
+  float len = length(a);
+  return len > 0.0f ? a * (1.0f / len) : a;
+}
+inline float3 min(const float3& a, const float3& b) {
+  return {std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+}
+inline float3 max(const float3& a, const float3& b) {
+  return {std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+}
+inline float3 reflect(const float3& i, const float3& n) { return i - n * (2.0f * dot(n, i)); }
+inline float3 xyz(const float4& a) { return {a.x, a.y, a.z}; }
+
+inline packed4x3 identity4x3() { return {{{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}}}; }
+inline float3 transformVector(const packed4x3& m, const float3& v) {
+  return f3(m.columns[0]) * v.x + f3(m.columns[1]) * v.y + f3(m.columns[2]) * v.z;
+}
+inline float3 transformPoint(const packed4x3& m, const float3& p) { return transformVector(m, p) + f3(m.columns[3]); }
+// False, and `result` untouched, when the 3x3 part is singular
+inline bool inverse(const packed4x3& m, packed4x3& result) {
+  const float3 a = f3(m.columns[0]), b = f3(m.columns[1]), c = f3(m.columns[2]);
+  const float3 bc = cross(b, c), ca = cross(c, a), ab = cross(a, b);
+  const float determinant = dot(a, bc);
+  if (!(std::fabs(determinant) > 0.0f) || !std::isfinite(determinant)) return false;
+  // Rows of the inverse are the cross products over the determinant
+  const float s = 1.0f / determinant;
+  packed4x3 inverted;
+  inverted.columns[0] = {bc.x * s, ca.x * s, ab.x * s};
+  inverted.columns[1] = {bc.y * s, ca.y * s, ab.y * s};
+  inverted.columns[2] = {bc.z * s, ca.z * s, ab.z * s};
+  inverted.columns[3] = p3(-transformVector(inverted, f3(m.columns[3])));
+  result = inverted;
+  return true;
+}
+
+} // namespace MATH
+} // namespace EXP
@@ -0,0 +1,56 @@
+#pragma once
+#include <Math/Vector.h>
+#include <Renderer/HostTypes.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * CPU side mesh in the same split layout the renderer uses:
+ * - vertices: packed XYZXYZ... (Layouts::vertexNIP buffer 0)
+ * - attributes: Renderer::VertexAttributes (Layouts::vertexNIP buffer 1)
+ * - submeshes: 32-bit triangle index lists, one per material
+ *
+ * Produced by the portable repositories, uploaded by MeshRepository.mm.
+ **/
+
+namespace EXP {
+namespace MDL {
+
+struct HostMaterial {
+  std::string name = "default";
+  MATH::float3 ambient = {0.0f, 0.0f, 0.0f};  // Ka
+  MATH::float3 diffuse = {1.0f, 1.0f, 1.0f};  // Kd
+  MATH::float3 specular = {0.0f, 0.0f, 0.0f}; // Ks
+  MATH::float3 emission = {0.0f, 0.0f, 0.0f}; // Ke
+  float shininess = 0.0f;                     // Ns
+  std::string diffuseTexture;                 // map_Kd, resolved against the .mtl directory
+};
+
+struct HostSubmesh {
+  std::vector<uint32_t> indices;
+  int material = -1; // Index into HostMesh::materials, -1 if none
+};
+
+struct HostMesh {
+  std::string name = "Mesh";
+  std::vector<MATH::packed3> vertices;
+  std::vector<Renderer::Host::VertexAttributes> attributes;
+  std::vector<HostSubmesh> submeshes;
+  std::vector<HostMaterial> materials;
+
+  inline size_t vertexCount() const { return vertices.size(); }
+  inline size_t triangleCount() const {
+    size_t count = 0;
+    for (const HostSubmesh& submesh : submeshes) count += submesh.indices.size() / 3;
+    return count;
+  }
+  inline size_t bytes() const {
+    size_t size = vertices.size() * sizeof(MATH::packed3) + attributes.size() * sizeof(Renderer::Host::VertexAttributes);
+    for (const HostSubmesh& submesh : submeshes) size += submesh.indices.size() * sizeof(uint32_t);
+    return size;
+  }
+};
+
+}; // namespace MDL
+}; // namespace EXP
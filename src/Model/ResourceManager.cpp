@@ -73,6 +73,29 @@ const int& SCENE::addTexture(MTL::Device* device, const std::string& name, const
 	return EXP::SCENE::addTexture(texture);	
 }
 
+const int& SCENE::addTexture(const std::string& name, Renderer::Host::StreamSource source) {
+	const bool stored = textSampleNames.find(name) != textSampleNames.end();
+	const int& index = EXP::SCENE::addTexture({name, Renderer::TextureAccess::SAMPLE, nullptr});
+	if (!stored) streamer->add(index, std::move(source));
+	return index;
+}
+
+// Textures are requested at the level the drawable can resolve: rays can hit any of them in a frame
+void SCENE::setTextureBudget(MTL::Device* device, const Renderer::Host::StreamSettings& settings, uint32_t pixels) {
+	if (streamer) return;
+	streamingBackend = new Renderer::Streaming(device);
+	streamer = new Renderer::Host::TextureStreamer(streamingBackend, settings);
+	streamPixels = pixels;
+	DEBUG("Texture streaming budget: " + std::to_string(settings.budget >> 20) + " MB");
+}
+
+bool SCENE::isStreaming() { return streamer != nullptr; };
+
+bool SCENE::hasTexture(const std::string& name, Renderer::TextureAccess access) {
+	if (access == Renderer::TextureAccess::SAMPLE) return textSampleNames.find(name) != textSampleNames.end();
+	return textReadWriteNames.find(name) != textReadWriteNames.end();
+}
+
 MTL::Texture* SCENE::getTexture(const std::string& name, Renderer::TextureAccess access) {
 	if (access == Renderer::TextureAccess::SAMPLE) {
 		const int& index = textSampleNames[name];
@@ -101,7 +124,7 @@ EXP::VCamera* SCENE::getCamera() {
 
 MTL::Buffer* SCENE::buildTextSampleBuffer(MTL::Device* device) {
 	DEBUG("Preparing sample texture buffer...");
-	MTL::Buffer* textSampleBuffer = 
+	textSampleBuffer = 
 		device->newBuffer(sizeof(Renderer::Text2D) * textSample.size(), MTL::ResourceStorageModeShared);
 	resources.emplace_back(textSampleBuffer);
 
@@ -111,9 +134,23 @@ MTL::Buffer* SCENE::buildTextSampleBuffer(MTL::Device* device) {
 			DEBUG("Default nullptr texture is skipped.");
 			continue;
 		}
+		if (!textSample[t].value) continue; // Streamed
 		(textureBufferPtr + t)->value = textSample[t].value->gpuResourceID();
 		resources.emplace_back(textSample[t].value);
 	}
+
+	// The streamer patches this table from here on; the first update brings in the tails
+	if (streamer) {
+		static_assert(sizeof(Renderer::Text2D) == sizeof(uint64_t), "Streamer writes one uint64 per slot");
+		streamer->setTable((uint64_t*)textureBufferPtr, textSample.size());
+		streamer->update();
+		for (int t = 0; t < textSample.size(); t += 1) {
+			if (textSample[t].value || streamer->residentLevel(t) == Renderer::Host::TextureStreamer::NONE) continue;
+			streamedResources.insert({t, (int)resources.size()});
+			resources.emplace_back(streamingBackend->texture(streamer->handle(t)));
+		}
+		DEBUG("Streamed textures: " + std::to_string(streamedResources.size()));
+	}
 	return textSampleBuffer;
 };
 
@@ -208,5 +245,17 @@ const void SCENE::updateBindlessScene(MTL::Device* device) {
 	for (int i = 0; i < SCENE::lights.size(); i += 1) {
 		(meshPtr + i)->orientation = SCENE::lights[i]->f4x4()->get();
 	}
+
+	// Text2D slots are patched by the streamer, the resources made resident follow them
+	if (streamer) {
+		for (auto& [slot, resource] : streamedResources) {
+			streamer->request(slot, Renderer::Host::TextureStreamer::levelFor(streamer->width(slot), streamPixels));
+		}
+		if (streamer->update() > 0) {
+			for (auto& [slot, resource] : streamedResources) {
+				resources[resource] = streamingBackend->texture(streamer->handle(slot));
+			}
+		}
+	}
 };
 
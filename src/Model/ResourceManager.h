@@ -2,6 +2,7 @@
 #include <pch.h>
 #include <Model/Camera.h>
 #include <DB/Repository.hpp>
+#include <Renderer/Streaming.h>
 #include <unordered_map>
 
 
@@ -26,6 +27,13 @@ class SCENE {
 	static inline std::unordered_map<std::string, int> textSampleNames = {};
 	static inline std::unordered_map<std::string, int> textReadWriteNames = {};
 
+	// Sample textures owned by the streamer: its slots are indices into textSample
+	static inline MTL::Buffer* textSampleBuffer = nullptr;
+	static inline Renderer::Streaming* streamingBackend = nullptr;
+	static inline Renderer::Host::TextureStreamer* streamer = nullptr;
+	static inline std::unordered_map<int, int> streamedResources = {}; // Slot -> index in resources
+	static inline uint32_t streamPixels = 0;
+
 	static inline int textsampleCounter = -1;
 	static inline int textreadwriteCounter = -1;
 
@@ -51,6 +59,11 @@ public:
 
 	static const int& addTexture(const Renderer::Texture& texture);
 	static const int& addTexture(MTL::Device* device, const std::string& name, const Renderer::TextureAccess& access);
+	// Streamed: only the levels that fit the budget are on the GPU, the slot is patched as they arrive
+	static const int& addTexture(const std::string& name, Renderer::Host::StreamSource source);
+	static void setTextureBudget(MTL::Device* device, const Renderer::Host::StreamSettings& settings, uint32_t pixels);
+	static bool isStreaming();
+	static bool hasTexture(const std::string& name, Renderer::TextureAccess access);
 	static MTL::Texture* getTexture(const std::string& name, Renderer::TextureAccess access);
 	static MTL::Texture* getTexture(const int& index, Renderer::TextureAccess access);
 	static const std::vector<Renderer::Texture>& getTextures(); 
@@ -0,0 +1,164 @@
+#include <Model/Weld.h>
+#include <cmath>
+#include <cstring>
+
+using HostMesh = EXP::MDL::HostMesh;
+using VertexAttributes = Renderer::Host::VertexAttributes;
+
+namespace {
+
+constexpr int COMPONENTS = 12;
+
+// The components the shaders read, in a fixed order. Adding +0 folds -0 into +0.
+struct Key {
+  float value[COMPONENTS];
+};
+
+inline Key keyOf(const EXP::MATH::packed3& v, const VertexAttributes& a) {
+  Key key = {{
+    v.x, v.y, v.z,
+    a.color.x, a.color.y, a.color.z, a.color.w,
+    a.texture.x, a.texture.y,
+    a.normal.x, a.normal.y, a.normal.z
+  }};
+  for (float& value : key.value) value = value + 0.0f;
+  return key;
+}
+
+inline uint64_t mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  return h ^ (h >> 33);
+}
+
+inline uint64_t hashBits(const Key& key) {
+  uint64_t words[COMPONENTS / 2];
+  memcpy(words, key.value, sizeof(words));
+  uint64_t h = 0;
+  for (uint64_t word : words) h = (h ^ word) * 0x9e3779b97f4a7c15ull;
+  return mix(h);
+}
+
+inline uint64_t hashCell(int64_t x, int64_t y, int64_t z) {
+  return mix((uint64_t)x * 0x9e3779b97f4a7c15ull ^ (uint64_t)y * 0xc2b2ae3d27d4eb4full ^ (uint64_t)z * 0x165667b19e3779f9ull);
+}
+
+inline bool within(const Key& a, const Key& b, float epsilon) {
+  for (int i = 0; i < COMPONENTS; i++) {
+    if (!(std::fabs(a.value[i] - b.value[i]) <= epsilon)) return false;
+  }
+  return true;
+}
+
+// Chained hash over the output vertices; buckets are keyed on all bits (exact) or on the position cell.
+struct Table {
+  std::vector<int32_t> heads;
+  std::vector<int32_t> next;
+  std::vector<Key> keys;
+  uint64_t mask = 0;
+
+  Table(size_t count) {
+    size_t size = 16;
+    while (size < count * 2) size *= 2;
+    heads.assign(size, -1);
+    mask = size - 1;
+    next.reserve(count);
+    keys.reserve(count);
+  }
+
+  inline uint32_t insert(const Key& key, uint64_t hash) {
+    const uint32_t vertex = (uint32_t)keys.size();
+    keys.push_back(key);
+    next.push_back(heads[hash & mask]);
+    heads[hash & mask] = (int32_t)vertex;
+    return vertex;
+  }
+
+  inline uint32_t findExact(const Key& key, uint64_t hash) const {
+    for (int32_t e = heads[hash & mask]; e >= 0; e = next[e]) {
+      if (memcmp(keys[e].value, key.value, sizeof(key.value)) == 0) return (uint32_t)e;
+    }
+    return EXP::MDL::Weld::UNUSED;
+  }
+
+  // Earliest vertex within epsilon in the 3x3x3 cells around `cell`.
+  inline uint32_t findNear(const Key& key, const int64_t cell[3], float epsilon) const {
+    uint32_t best = EXP::MDL::Weld::UNUSED;
+    for (int64_t dz = -1; dz <= 1; dz++) {
+      for (int64_t dy = -1; dy <= 1; dy++) {
+        for (int64_t dx = -1; dx <= 1; dx++) {
+          const uint64_t hash = hashCell(cell[0] + dx, cell[1] + dy, cell[2] + dz);
+          for (int32_t e = heads[hash & mask]; e >= 0; e = next[e]) {
+            if ((uint32_t)e < best && within(keys[e], key, epsilon)) best = (uint32_t)e;
+          }
+        }
+      }
+    }
+    return best;
+  }
+};
+
+} // namespace
+
+
+size_t EXP::MDL::Weld::remap(const HostMesh& mesh, std::vector<uint32_t>& remap, float epsilon) {
+  const size_t count = mesh.vertexCount();
+  remap.assign(count, UNUSED);
+  Table table(count);
+
+  for (const HostSubmesh& submesh : mesh.submeshes) {
+    for (uint32_t index : submesh.indices) {
+      if (index >= count || remap[index] != UNUSED) continue;
+      const Key key = keyOf(mesh.vertices[index], mesh.attributes[index]);
+
+      if (epsilon <= 0.0f) {
+        const uint64_t hash = hashBits(key);
+        uint32_t vertex = table.findExact(key, hash);
+        remap[index] = vertex != UNUSED ? vertex : table.insert(key, hash);
+      } else {
+        const int64_t cell[3] = {
+          (int64_t)std::floor(key.value[0] / epsilon),
+          (int64_t)std::floor(key.value[1] / epsilon),
+          (int64_t)std::floor(key.value[2] / epsilon)
+        };
+        uint32_t vertex = table.findNear(key, cell, epsilon);
+        remap[index] = vertex != UNUSED ? vertex : table.insert(key, hashCell(cell[0], cell[1], cell[2]));
+      }
+    }
+  }
+  return table.keys.size();
+}
+
+EXP::MDL::WeldReport EXP::MDL::Weld::apply(HostMesh& mesh, float epsilon) {
+  WeldReport report;
+  report.verticesBefore = mesh.vertexCount();
+  report.bytesBefore = mesh.bytes();
+
+  std::vector<uint32_t> table;
+  const size_t count = remap(mesh, table, epsilon);
+
+  // Each output vertex keeps the values of the vertex that created it (its first use)
+  std::vector<MATH::packed3> vertices(count);
+  std::vector<VertexAttributes> attributes(count);
+  std::vector<uint8_t> written(count, 0);
+  for (HostSubmesh& submesh : mesh.submeshes) {
+    for (uint32_t& index : submesh.indices) {
+      if (index >= table.size()) continue;
+      const uint32_t vertex = table[index];
+      if (!written[vertex]) {
+        vertices[vertex] = mesh.vertices[index];
+        attributes[vertex] = mesh.attributes[index];
+        written[vertex] = 1;
+      }
+      index = vertex;
+    }
+  }
+  mesh.vertices = std::move(vertices);
+  mesh.attributes = std::move(attributes);
+
+  report.verticesAfter = mesh.vertexCount();
+  report.bytesAfter = mesh.bytes();
+  return report;
+}
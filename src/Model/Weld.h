@@ -0,0 +1,48 @@
+#pragma once
+#include <Model/HostMesh.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Vertex welding for imported meshes.
+ *
+ * Vertices are compared on what the shaders read: position, color, texcoord and normal
+ * (padding is ignored, -0 equals +0). With epsilon 0 only exact duplicates merge; with
+ * epsilon > 0 a vertex merges into the first earlier vertex whose components all lie within
+ * epsilon (positions are bucketed in epsilon sized cells, the 27 neighbours are searched).
+ *
+ * Output vertices are numbered in order of first use by the index lists, which also drops
+ * vertices no triangle references.
+ **/
+
+namespace EXP {
+namespace MDL {
+
+struct WeldReport {
+  size_t verticesBefore = 0;
+  size_t verticesAfter = 0;
+  size_t bytesBefore = 0; // HostMesh::bytes(), index lists included
+  size_t bytesAfter = 0;
+
+  inline size_t bytesSaved() const { return bytesBefore - bytesAfter; }
+  inline double ratio() const { return bytesBefore ? (double)bytesAfter / (double)bytesBefore : 1.0; }
+};
+
+class Weld {
+public:
+  Weld(){};
+  ~Weld(){};
+
+public:
+  // remap[old] = new vertex, or UNUSED when no index refers to it. Returns the new vertex count.
+  static size_t remap(const HostMesh& mesh, std::vector<uint32_t>& remap, float epsilon = 0.0f);
+  // Welds in place: vertex streams compacted, every index list rewritten.
+  static WeldReport apply(HostMesh& mesh, float epsilon = 0.0f);
+
+public:
+  static constexpr uint32_t UNUSED = 0xFFFFFFFFu;
+};
+
+}; // namespace MDL
+}; // namespace EXP
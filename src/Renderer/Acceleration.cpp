@@ -1,7 +1,10 @@
 #include "Metal/MTLAccelerationStructure.hpp"
 #include "Metal/MTLAccelerationStructureCommandEncoder.hpp"
+#include <DB/BvhCache.hpp>
 #include <Metal/MTLDevice.hpp>
 #include <Renderer/Acceleration.h>
+#include <Renderer/Descriptor.h>
+#include <filesystem>
 
 MTL::AccelerationStructureSizes Renderer::Acceleration::sizes(
 		MTL::Device* device,
@@ -45,6 +48,92 @@ std::vector<MTL::AccelerationStructure*> Renderer::Acceleration::primitives(
 	return structures;
 }
 
+std::vector<Renderer::Host::Bvh> Renderer::Acceleration::hostPrimitives(
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		const int& vStride,
+		const Host::BvhSettings& settings,
+		const std::string& cacheDirectory
+) {
+	Repository::BvhCacheSettings cacheSettings;
+	cacheSettings.bvh = settings;
+	std::vector<Host::Bvh> structures(meshes.size());
+	for (int i = 0; i < meshes.size(); i++) {
+		const std::vector<Host::BvhGeometry> geometries = Descriptor::hostPrimitive(meshes[i], vStride);
+		Host::BvhReport report;
+		bool cached = false;
+		if (cacheDirectory.empty()) report = Repository::BvhCache::build(geometries, structures[i], cacheSettings);
+		else {
+			std::error_code code;
+			std::filesystem::create_directories(cacheDirectory, code);
+			const uint64_t key = Repository::BvhCache::key(geometries, cacheSettings);
+			const std::string path = (std::filesystem::path(cacheDirectory) / Repository::BvhCache::fileName(key)).string();
+			std::string error;
+			report = Repository::BvhCache::fetch(path, key, geometries, structures[i], cacheSettings, &cached, &error);
+			if (!cached) DEBUG("BVH cache miss for " + meshes[i]->name + ": " + error);
+		}
+		DEBUG("CPU BVH for " + meshes[i]->name + ": " + std::to_string(structures[i].triangleCount()) + " triangles, " +
+			std::to_string(report.nodes) + " nodes, SAH " + std::to_string(report.sahCost) + ", " +
+			std::to_string(report.seconds * 1000.0) + (cached ? " ms to load" : " ms to build"));
+	}
+	return structures;
+}
+
+std::vector<Renderer::Host::Bvh8> Renderer::Acceleration::hostWidePrimitives(
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		const int& vStride,
+		const Host::BvhSettings& settings,
+		const Host::WideSettings& wideSettings,
+		const std::string& cacheDirectory
+) {
+	const std::vector<Host::Bvh> binary = hostPrimitives(meshes, vStride, settings, cacheDirectory);
+	std::vector<Host::Bvh8> structures(binary.size());
+	for (int i = 0; i < binary.size(); i++) {
+		const Host::BvhReport report = Host::WideBuilder::collapse(binary[i], structures[i], wideSettings);
+		DEBUG("Wide CPU BVH for " + meshes[i]->name + ": " + std::to_string(report.nodes) + " nodes, " +
+			std::to_string(structures[i].bytes() / 1024) + " kb");
+	}
+	return structures;
+}
+
+std::vector<Renderer::Host::BlasBounds> Renderer::Acceleration::hostBounds(
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		const int& vStride
+) {
+	std::vector<Host::BlasBounds> structures(meshes.size());
+	for (int i = 0; i < meshes.size(); i++) structures[i].box = Host::BvhBuilder::bounds(Descriptor::hostPrimitive(meshes[i], vStride));
+	return structures;
+}
+
+template <typename Blas>
+static Renderer::Host::BvhReport buildHostInstance(
+		const std::vector<Blas>& structures,
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		Renderer::Host::Tlas<Blas>& tlas
+) {
+	std::vector<const Blas*> pointers;
+	for (const Blas& structure : structures) pointers.push_back(&structure);
+	const Renderer::Host::BvhReport report = Renderer::Host::TlasBuilder::build(Renderer::Descriptor::hostInstance(meshes), pointers, tlas);
+	DEBUG("CPU TLAS: " + std::to_string(report.leaves) + " instances, " + std::to_string(report.nodes) + " nodes, " +
+		std::to_string(report.seconds * 1000.0) + " ms");
+	return report;
+}
+
+Renderer::Host::BvhReport Renderer::Acceleration::hostInstance(
+		const std::vector<Host::Bvh8>& structures,
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		Host::Tlas<Host::Bvh8>& tlas
+) {
+	return buildHostInstance(structures, meshes, tlas);
+}
+
+Renderer::Host::BvhReport Renderer::Acceleration::hostInstance(
+		const std::vector<Host::BlasBounds>& structures,
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		Host::Tlas<Host::BlasBounds>& tlas
+) {
+	return buildHostInstance(structures, meshes, tlas);
+}
+
 MTL::AccelerationStructure* Renderer::Acceleration::instance(
   MTL::Device* device,
   MTL::CommandQueue* queue,
@@ -70,17 +159,15 @@ MTL::AccelerationStructure* Renderer::Acceleration::refit(
 		MTL::CommandQueue* queue,
 		MTL::InstanceAccelerationStructureDescriptor* descriptor,
 		MTL::AccelerationStructure* structure,
+		MTL::Buffer* scratchBuffer,
 		MTL::Event* buildEvent
 ) {
   MTL::CommandBuffer* cmd = queue->commandBuffer();
-  MTL::AccelerationStructureSizes sizes = device->accelerationStructureSizes(descriptor);
-  MTL::Buffer* scratchBuffer = device->newBuffer(sizes.refitScratchBufferSize, MTL::ResourceStorageModePrivate);
+  cmd->encodeWait(buildEvent, 1);
   MTL::AccelerationStructureCommandEncoder* encoder = cmd->accelerationStructureCommandEncoder();
   encoder->refitAccelerationStructure(structure, descriptor, nullptr, scratchBuffer, 0);
   encoder->endEncoding();
+  cmd->encodeSignalEvent(buildEvent, 2);  // signal render pass
   cmd->commit();
-  cmd->waitUntilCompleted();
-  scratchBuffer->release();
   return structure;
 }
-
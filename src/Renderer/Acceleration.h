@@ -1,6 +1,8 @@
 #pragma once
 #include "Metal/MTLAccelerationStructure.hpp"
 #include "Metal/MTLDevice.hpp"
+#include <Model/Mesh.h>
+#include <Renderer/HostInstance.h>
 #include <pch.h>
 
 
@@ -25,6 +27,42 @@ struct Acceleration {
 		MTL::Event* buildEvent
 	);
 
+	// The same structures built on the CPU, one Bvh per mesh, each across the thread pool. With a
+	// cache directory they are loaded from .expbvh files there, and built and written when missing
+	static std::vector<Host::Bvh> hostPrimitives(
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		const int& vStride,
+		const Host::BvhSettings& settings = {},
+		const std::string& cacheDirectory = ""
+	);
+
+	// Those collapsed to 8 children per node for CPU traversal, see Host::WideBvh
+	static std::vector<Host::Bvh8> hostWidePrimitives(
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		const int& vStride,
+		const Host::BvhSettings& settings = {},
+		const Host::WideSettings& wideSettings = {},
+		const std::string& cacheDirectory = ""
+	);
+
+	// Only each mesh's box, no tree: what a top level needs while nothing traverses the host trees
+	static std::vector<Host::BlasBounds> hostBounds(
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		const int& vStride
+	);
+
+	// The top level over those, as `instance` builds it on the GPU; `structures` must outlive `tlas`
+	static Host::BvhReport hostInstance(
+		const std::vector<Host::Bvh8>& structures,
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		Host::Tlas<Host::Bvh8>& tlas
+	);
+	static Host::BvhReport hostInstance(
+		const std::vector<Host::BlasBounds>& structures,
+		const std::vector<EXP::MDL::Mesh*>& meshes,
+		Host::Tlas<Host::BlasBounds>& tlas
+	);
+
 	static NS::Array* primitivesWithoutHeapAllocation(
 		MTL::Device* device,
 		MTL::CommandQueue* queue,
@@ -43,11 +81,13 @@ struct Acceleration {
 		MTL::Event* buildEvent
 	);
 
+	// In place, with the scratch buffer kept from the build; signals like `instance`, does not wait
 	static MTL::AccelerationStructure* refit(
 		MTL::Device* device,
 		MTL::CommandQueue* queue,
 		MTL::InstanceAccelerationStructureDescriptor* descriptor,
 		MTL::AccelerationStructure* structure,
+		MTL::Buffer* scratchBuffer,
 		MTL::Event* buildEvent
 	);
 };
@@ -1,6 +1,7 @@
 #include "Metal/MTLResource.hpp"
 #include "Renderer/Types.h"
 #include <Renderer/Buffer.h>
+#include <Renderer/HostBuffer.h>
 #include <cstdint>
 #include <stdint.h>
 
@@ -37,36 +38,16 @@ MTL::Buffer* Renderer::Buffer::perPrimitive(
 	int perPrimitiveBufferSize = sizeof(Renderer::PrimitiveAttributes) * indexCount / 3;
 	MTL::Buffer* perPrimitiveBuffer = device->newBuffer(perPrimitiveBufferSize, MTL::ResourceStorageModeShared);
 
-	Renderer::PrimitiveAttributes* primAttribPtr = (Renderer::PrimitiveAttributes*)perPrimitiveBuffer->contents();
-	Renderer::VertexAttributes* verAttribPtr = (Renderer::VertexAttributes*)vertexAttribBuffer->contents();
-	uint32_t* indexPtr = (uint32_t*)indices->contents();
-  	
-	for (int i = 0; i < indexCount / 3; i += 1) {
-
-		uint32_t vertAttribIndex1 = *(indexPtr + i * 3 + 0);
-		uint32_t vertAttribIndex2 = *(indexPtr + i * 3 + 1);
-		uint32_t vertAttribIndex3 = *(indexPtr + i * 3 + 2);
-
-		Renderer::VertexAttributes* vertAttrib1 = verAttribPtr + vertAttribIndex1;
-		Renderer::VertexAttributes* vertAttrib2 = verAttribPtr + vertAttribIndex2;
-		Renderer::VertexAttributes* vertAttrib3 = verAttribPtr + vertAttribIndex3;
-		
-		Renderer::PrimitiveAttributes* primAttrib = primAttribPtr + i;
-
-		primAttrib->color[0] = vertAttrib1->color;
-		primAttrib->color[1] = vertAttrib2->color;
-		primAttrib->color[2] = vertAttrib3->color;
-
-		primAttrib->normal[0] = vertAttrib1->normal;
-		primAttrib->normal[1] = vertAttrib2->normal;
-		primAttrib->normal[2] = vertAttrib3->normal;
-
-		primAttrib->txcoord[0] = vertAttrib1->texture;
-		primAttrib->txcoord[1] = vertAttrib2->texture;
-		primAttrib->txcoord[2] = vertAttrib3->texture;
-		
-		primAttrib->flags = {(uint8_t)txindex, 0};
-	}
+	// Host twin builds in parallel with streaming stores; the structs share one byte layout
+	static_assert(sizeof(Renderer::Host::PrimitiveAttributes) == sizeof(Renderer::PrimitiveAttributes));
+	static_assert(sizeof(Renderer::Host::VertexAttributes) == sizeof(Renderer::VertexAttributes));
+	Renderer::Host::Buffer::perPrimitive(
+		(const Renderer::Host::VertexAttributes*)vertexAttribBuffer->contents(),
+		(const uint32_t*)indices->contents(),
+		indexCount,
+		txindex,
+		(Renderer::Host::PrimitiveAttributes*)perPrimitiveBuffer->contents()
+	);
 	return perPrimitiveBuffer;
 };
 
@@ -1,5 +1,6 @@
 #include <DB/Repository.hpp>
 #include <Renderer/Descriptor.h>
+#include <cstring>
 
 
 MTL::VertexDescriptor* Renderer::Descriptor::vertex(
@@ -115,6 +116,27 @@ prim_acc_desc* Renderer::Descriptor::primitive(
   return dPrimitive;
 }
 
+std::vector<Renderer::Host::BvhGeometry> Renderer::Descriptor::hostPrimitive(
+  EXP::MDL::Mesh* mesh, 
+  const int& vStride
+) {
+  std::vector<Host::BvhGeometry> geometries;
+  std::vector<EXP::MDL::Submesh*> submeshes = mesh->getSubmeshes();
+  MTL::Buffer* vertexBuffer = mesh->buffers[0];
+  for (int i = 0; i < mesh->count; i++) {
+    EXP::MDL::Submesh* submesh = submeshes[i];
+    Host::BvhGeometry geometry;
+    geometry.vertices = (const char*)vertexBuffer->contents() + mesh->offsets[0];
+    geometry.vertexStride = vStride;
+    geometry.vertexCount = (vertexBuffer->length() - mesh->offsets[0]) / vStride;
+    geometry.indices = (const char*)submesh->indexBuffer->contents() + submesh->offset;
+    geometry.indexSize = submesh->indexType == MTL::IndexTypeUInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    geometry.triangleCount = submesh->indexCount / 3;
+    geometries.emplace_back(geometry);
+  }
+  return geometries;
+}
+
 
 inst_acc_desc* Renderer::Descriptor::instance(
     MTL::Device* device,
@@ -122,6 +144,7 @@ inst_acc_desc* Renderer::Descriptor::instance(
     mesh_array meshes
 ) {
   inst_acc_desc* descriptor = inst_acc_desc::descriptor();  
+  descriptor->setUsage(MTL::AccelerationStructureUsageRefit);
   descriptor->setInstancedAccelerationStructures(
     NS::Array::array(reinterpret_cast<NS::Object* const*>(&primitiveStructures[0]), primitiveStructures.size())
   );
@@ -142,6 +165,18 @@ inst_acc_desc* Renderer::Descriptor::instance(
   return descriptor;
 }
 
+std::vector<Renderer::Host::Instance> Renderer::Descriptor::hostInstance(
+  mesh_array meshes
+) {
+  std::vector<Host::Instance> instances(meshes.size());
+  for (unsigned int i = 0; i < meshes.size(); i+=1) {
+    const MTL::PackedFloat4x3 transformationMatrix = EXP::MATH::pack(meshes[i]->f4x4()->get());
+    std::memcpy(&instances[i].transformationMatrix, &transformationMatrix, sizeof(EXP::MATH::packed4x3));
+    instances[i].accelerationStructureIndex = i;
+  }
+  return instances;
+}
+
 
 // NOTE TO SELF: INST_ACC_DESC contains ACC_INST_DEC
 // SO: INST_ACC_DESC > ACC_INST_DEC
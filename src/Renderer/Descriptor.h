@@ -3,6 +3,7 @@
 #include "Metal/MTLRenderPipeline.hpp"
 #include <Model/MeshFactory.h>
 #include <Renderer/Buffer.h>
+#include <Renderer/HostInstance.h>
 #include <pch.h>
 
 using inst_desc = MTL::AccelerationStructureInstanceDescriptor;
@@ -46,12 +47,23 @@ struct Descriptor {
 		const int& pStride
 	);
 
+	// What `primitive` hands to Metal, read back from the shared buffers for the CPU builder
+	static std::vector<Host::BvhGeometry> hostPrimitive(
+		EXP::MDL::Mesh* mesh, 
+		const int& vStride
+	);
+
 	static inst_acc_desc* instance(
 		MTL::Device* device,
 		acc_array primitiveStructures,
 		mesh_array meshes
 	);
 
+	// What `instance` hands to Metal, for the CPU top level: structure i for mesh i
+	static std::vector<Host::Instance> hostInstance(
+		mesh_array meshes
+	);
+
 	static inst_acc_desc* updateTransformationMatrix(
 		mesh_array meshes, 
 		inst_acc_desc* descriptor
@@ -0,0 +1,927 @@
+#include <Renderer/HostBlock.h>
+#include <Thread/Pool.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+using Renderer::Host::BlockChain;
+using Renderer::Host::BlockCompress;
+using Renderer::Host::BlockFormat;
+using Renderer::Host::BlockImage;
+using Renderer::Host::BlockQuality;
+using Renderer::Host::BlockReport;
+using Renderer::Host::Image;
+using Renderer::Host::MipChain;
+using Renderer::Host::PixelFormat;
+
+namespace {
+
+const int WEIGHTS2[4] = {0, 21, 43, 64};
+const int WEIGHTS3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+const int WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+// BC7 two subset partitions: bit i set when texel i belongs to subset 1
+const uint16_t PARTITIONS2[64] = {
+  0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8,
+  0xFF00, 0xFFF0, 0xF000, 0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110,
+  0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C, 0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696,
+  0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660, 0x0272, 0x04E4, 0x4E40, 0x2720,
+  0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+// Anchor texel of subset 1 (subset 0 always anchors at texel 0)
+const uint8_t ANCHORS2[64] = {
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 2,  8,  2,  2,  8,  8, 15, 2, 8, 2, 2,
+  8,  8,  2,  2,  15, 15, 6,  8,  2,  8,  15, 15, 2,  8,  2,  2,  2,  15, 15, 6,  6,  2,  6, 8, 15, 15, 2, 2,
+  15, 15, 15, 15, 15, 2,  2,  15,
+};
+
+// BC1 palette positions by index: endpoints first, then the interpolated colors
+const float BC1_FOUR[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+const float BC1_THREE[4] = {0.0f, 1.0f, 0.5f, 0.0f};
+
+inline int refinePasses(BlockQuality quality) {
+  return quality == BlockQuality::FAST ? 0 : quality == BlockQuality::NORMAL ? 2 : 4;
+}
+
+// Squared error of a block below which BC7 tries no other mode: one level per channel
+constexpr int GOOD_ENOUGH = 16 * 4;
+
+// BC7 mode 1 candidates: partitions with the lowest estimated error that get a full encode
+inline int partitionCandidates(BlockQuality quality) {
+  return quality == BlockQuality::FAST ? 1 : quality == BlockQuality::NORMAL ? 2 : 8;
+}
+
+inline int interpolate(int e0, int e1, int weight) { return ((64 - weight) * e0 + weight * e1 + 32) >> 6; }
+
+// Texels as ints, so distances need no casts
+struct Block {
+  int texels[16][4];
+
+  explicit Block(const uint8_t* rgba) {
+    for (int i = 0; i < 16; i++) {
+      for (int c = 0; c < 4; c++) texels[i][c] = rgba[i * 4 + c];
+    }
+  }
+};
+
+// Little endian bit stream over one 128 bit block
+struct Bits {
+  uint8_t* bytes;
+  int position = 0;
+
+  explicit Bits(uint8_t* block) : bytes(block) {}
+  inline void put(uint32_t value, int count) {
+    for (int i = 0; i < count; i++, position++) {
+      if (value >> i & 1) bytes[position >> 3] |= (uint8_t)(1 << (position & 7));
+    }
+  }
+  inline uint32_t get(int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++, position++) value |= (uint32_t)(bytes[position >> 3] >> (position & 7) & 1) << i;
+    return value;
+  }
+};
+
+// Endpoints along the principal axis of channels [first, first + count) of the used texels,
+// clamped to [0, 255]. A uniform block gets its mean twice.
+void principalEndpoints(const Block& block, const bool* use, int first, int count, float* e0, float* e1) {
+  float mean[4] = {};
+  int n = 0;
+  for (int i = 0; i < 16; i++) {
+    if (!use[i]) continue;
+    for (int c = first; c < first + count; c++) mean[c] += block.texels[i][c];
+    n++;
+  }
+  for (int c = first; c < first + count; c++) mean[c] /= std::max(n, 1);
+
+  float covariance[4][4] = {};
+  for (int i = 0; i < 16; i++) {
+    if (!use[i]) continue;
+    for (int a = first; a < first + count; a++) {
+      for (int b = a; b < first + count; b++) {
+        covariance[a][b] += (block.texels[i][a] - mean[a]) * (block.texels[i][b] - mean[b]);
+      }
+    }
+  }
+  for (int a = first; a < first + count; a++) {
+    for (int b = first; b < a; b++) covariance[a][b] = covariance[b][a];
+  }
+
+  // Power iteration from the row with the largest variance
+  int start = first;
+  for (int c = first; c < first + count; c++) start = covariance[c][c] > covariance[start][start] ? c : start;
+  float axis[4] = {};
+  for (int c = first; c < first + count; c++) axis[c] = covariance[start][c];
+  for (int iteration = 0; iteration < 8; iteration++) {
+    float next[4] = {};
+    float largest = 0.0f;
+    for (int a = first; a < first + count; a++) {
+      for (int b = first; b < first + count; b++) next[a] += covariance[a][b] * axis[b];
+      largest = std::max(largest, std::fabs(next[a]));
+    }
+    if (largest == 0.0f) break;
+    for (int c = first; c < first + count; c++) axis[c] = next[c] / largest;
+  }
+
+  float length = 0.0f;
+  for (int c = first; c < first + count; c++) length += axis[c] * axis[c];
+  float low = 0.0f, high = 0.0f;
+  if (length > 0.0f) {
+    low = std::numeric_limits<float>::max(), high = -low;
+    for (int i = 0; i < 16; i++) {
+      if (!use[i]) continue;
+      float t = 0.0f;
+      for (int c = first; c < first + count; c++) t += (block.texels[i][c] - mean[c]) * axis[c];
+      low = std::min(low, t / length), high = std::max(high, t / length);
+    }
+  }
+  for (int c = first; c < first + count; c++) {
+    e0[c] = std::clamp(mean[c] + low * axis[c], 0.0f, 255.0f);
+    e1[c] = std::clamp(mean[c] + high * axis[c], 0.0f, 255.0f);
+  }
+}
+
+// Endpoints minimizing the squared error of the used texels for fixed indices (palette
+// position `weights[index]` between them). False when every texel sits on one position.
+bool leastSquares(
+  const Block& block,
+  const bool* use,
+  const uint8_t* indices,
+  const float* weights,
+  int first,
+  int count,
+  float* e0,
+  float* e1
+) {
+  float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[4] = {}, bx[4] = {};
+  for (int i = 0; i < 16; i++) {
+    if (!use[i]) continue;
+    const float t = weights[indices[i]], s = 1.0f - t;
+    aa += s * s, ab += s * t, bb += t * t;
+    for (int c = first; c < first + count; c++) ax[c] += s * block.texels[i][c], bx[c] += t * block.texels[i][c];
+  }
+  const float determinant = aa * bb - ab * ab;
+  if (std::fabs(determinant) < 1e-4f) return false;
+  for (int c = first; c < first + count; c++) {
+    e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+    e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+// BC1 --------------------------------------------------------------------------------------
+
+inline void expand565(uint16_t value, int* rgb) {
+  const int r = value >> 11, g = value >> 5 & 63, b = value & 31;
+  rgb[0] = r << 3 | r >> 2, rgb[1] = g << 2 | g >> 4, rgb[2] = b << 3 | b >> 2;
+}
+
+inline uint16_t quantize565(const float* rgb) {
+  const int r = std::clamp((int)(rgb[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+  const int g = std::clamp((int)(rgb[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+  const int b = std::clamp((int)(rgb[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+  return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+// c0 > c1: four colors; otherwise three and transparent black
+void bc1Palette(uint16_t c0, uint16_t c1, int palette[4][4]) {
+  expand565(c0, palette[0]), expand565(c1, palette[1]);
+  palette[0][3] = palette[1][3] = palette[2][3] = 255;
+  for (int c = 0; c < 3; c++) {
+    if (c0 > c1) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    } else {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+  }
+  palette[3][3] = c0 > c1 ? 255 : 0;
+}
+
+struct Bc1 {
+  uint16_t c0 = 0, c1 = 0;
+  uint8_t indices[16] = {};
+  int error = 0;
+};
+
+// Indices and RGB error for two endpoints in either order. `three` picks the three color mode,
+// which transparent texels need; equal endpoints always decode in it (index 0 stays valid).
+Bc1 fitBc1(const Block& block, const bool* transparent, uint16_t a, uint16_t b, bool three) {
+  Bc1 fit;
+  fit.c0 = three ? std::min(a, b) : std::max(a, b);
+  fit.c1 = three ? std::max(a, b) : std::min(a, b);
+  int palette[4][4];
+  bc1Palette(fit.c0, fit.c1, palette);
+  const int colors = fit.c0 > fit.c1 ? 4 : 3;
+  for (int i = 0; i < 16; i++) {
+    if (transparent[i]) {
+      fit.indices[i] = 3;
+      continue;
+    }
+    int best = std::numeric_limits<int>::max();
+    for (int p = 0; p < colors; p++) {
+      int distance = 0;
+      for (int c = 0; c < 3; c++) distance += (block.texels[i][c] - palette[p][c]) * (block.texels[i][c] - palette[p][c]);
+      if (distance < best) best = distance, fit.indices[i] = (uint8_t)p;
+    }
+    fit.error += best;
+  }
+  return fit;
+}
+
+void refineBc1(const Block& block, const bool* transparent, Bc1& best, int passes) {
+  bool use[16];
+  for (int i = 0; i < 16; i++) use[i] = !transparent[i];
+  for (int pass = 0; pass < passes && best.error > 0; pass++) {
+    const bool three = best.c0 <= best.c1;
+    float e0[4], e1[4];
+    if (!leastSquares(block, use, best.indices, three ? BC1_THREE : BC1_FOUR, 0, 3, e0, e1)) break;
+    const Bc1 next = fitBc1(block, transparent, quantize565(e0), quantize565(e1), three);
+    if (next.error >= best.error) break;
+    best = next;
+  }
+}
+
+// +-1 steps on each 565 channel of either endpoint while the error drops
+void searchBc1(const Block& block, const bool* transparent, Bc1& best) {
+  const int shifts[3] = {11, 5, 0}, limits[3] = {31, 63, 31};
+  for (bool improved = true; improved && best.error > 0;) {
+    improved = false;
+    const bool three = best.c0 <= best.c1;
+    for (int endpoint = 0; endpoint < 2; endpoint++) {
+      for (int c = 0; c < 3; c++) {
+        for (int step = -1; step <= 1; step += 2) {
+          uint16_t ends[2] = {best.c0, best.c1};
+          const int value = (ends[endpoint] >> shifts[c] & limits[c]) + step;
+          if (value < 0 || value > limits[c]) continue;
+          ends[endpoint] = (uint16_t)((ends[endpoint] & ~(limits[c] << shifts[c])) | value << shifts[c]);
+          const Bc1 next = fitBc1(block, transparent, ends[0], ends[1], three);
+          if (next.error < best.error) best = next, improved = true;
+        }
+      }
+    }
+  }
+}
+
+// BC7 --------------------------------------------------------------------------------------
+
+// Index of the nearest weight for every position in [0, 64]
+struct NearestWeight {
+  uint8_t index[65];
+
+  NearestWeight(const int* weights, int count) {
+    for (int w = 0; w <= 64; w++) {
+      int best = 0;
+      for (int i = 1; i < count; i++) best = std::abs(weights[i] - w) < std::abs(weights[best] - w) ? i : best;
+      index[w] = (uint8_t)best;
+    }
+  }
+};
+const NearestWeight NEAREST3(WEIGHTS3, 8);
+const NearestWeight NEAREST4(WEIGHTS4, 16);
+
+struct Bc7 {
+  int mode = 6;
+  int rotation = 0;
+  int partition = 0;
+  // Quantized, two per subset: mode 6 7777 (+ p-bit), mode 5 777 color and 8 bit alpha,
+  // mode 1 666 (+ p-bit shared by the subset)
+  int ends[4][4] = {};
+  int pbits[4] = {};
+  uint8_t color[16] = {};
+  uint8_t alpha[16] = {};
+  int error = 0;        // Mode 5 keeps color and alpha error apart
+  int alphaError = 0;
+};
+
+// Mode 6: the projection on the endpoint axis picks the weight, its neighbours absorb rounding
+void fitMode6(const Block& block, Bc7& fit) {
+  int e0[4], e1[4], direction[4], length = 0;
+  for (int c = 0; c < 4; c++) {
+    e0[c] = fit.ends[0][c] << 1 | fit.pbits[0];
+    e1[c] = fit.ends[1][c] << 1 | fit.pbits[1];
+    direction[c] = e1[c] - e0[c];
+    length += direction[c] * direction[c];
+  }
+  int palette[16][4];
+  for (int i = 0; i < 16; i++) {
+    for (int c = 0; c < 4; c++) palette[i][c] = interpolate(e0[c], e1[c], WEIGHTS4[i]);
+  }
+
+  fit.error = 0;
+  for (int i = 0; i < 16; i++) {
+    const int* texel = block.texels[i];
+    int guess = 0;
+    if (length > 0) {
+      int dot = 0;
+      for (int c = 0; c < 4; c++) dot += (texel[c] - e0[c]) * direction[c];
+      guess = NEAREST4.index[std::clamp((dot * 64 + length / 2) / length, 0, 64)];
+    }
+    int best = std::numeric_limits<int>::max();
+    for (int p = std::max(guess - 1, 0); p <= std::min(guess + 1, 15); p++) {
+      int distance = 0;
+      for (int c = 0; c < 4; c++) distance += (texel[c] - palette[p][c]) * (texel[c] - palette[p][c]);
+      if (distance < best) best = distance, fit.color[i] = (uint8_t)p;
+    }
+    fit.error += best;
+  }
+}
+
+inline void quantizeMode6(const float* value, int pbit, int* out) {
+  for (int c = 0; c < 4; c++) out[c] = std::clamp((int)((value[c] - pbit) * 0.5f + 0.5f), 0, 127);
+}
+
+// Endpoint error of one p-bit choice, for FAST
+inline float pbitError(const float* value, int pbit) {
+  int quantized[4];
+  quantizeMode6(value, pbit, quantized);
+  float error = 0.0f;
+  for (int c = 0; c < 4; c++) error += (quantized[c] * 2 + pbit - value[c]) * (quantized[c] * 2 + pbit - value[c]);
+  return error;
+}
+
+Bc7 bestMode6(const Block& block, const float* e0, const float* e1, BlockQuality quality) {
+  Bc7 best;
+  best.error = std::numeric_limits<int>::max();
+  for (int p0 = 0; p0 < 2; p0++) {
+    for (int p1 = 0; p1 < 2; p1++) {
+      if (quality == BlockQuality::FAST &&
+          (p0 != (pbitError(e0, 1) < pbitError(e0, 0)) || p1 != (pbitError(e1, 1) < pbitError(e1, 0)))) {
+        continue;
+      }
+      Bc7 fit;
+      fit.pbits[0] = p0, fit.pbits[1] = p1;
+      quantizeMode6(e0, p0, fit.ends[0]);
+      quantizeMode6(e1, p1, fit.ends[1]);
+      fitMode6(block, fit);
+      if (fit.error < best.error) best = fit;
+    }
+  }
+  return best;
+}
+
+Bc7 encodeMode6(const Block& block, BlockQuality quality) {
+  const bool all[16] = {true, true, true, true, true, true, true, true, true, true, true, true, true, true, true, true};
+  float weights[16];
+  for (int i = 0; i < 16; i++) weights[i] = WEIGHTS4[i] / 64.0f;
+
+  float e0[4], e1[4];
+  principalEndpoints(block, all, 0, 4, e0, e1);
+  Bc7 best = bestMode6(block, e0, e1, quality);
+  for (int pass = 0; pass < refinePasses(quality) && best.error > 0; pass++) {
+    if (!leastSquares(block, all, best.color, weights, 0, 4, e0, e1)) break;
+    const Bc7 next = bestMode6(block, e0, e1, quality);
+    if (next.error >= best.error) break;
+    best = next;
+  }
+
+  // +-1 steps on each 7 bit endpoint channel, p-bits fixed
+  for (bool improved = quality == BlockQuality::BEST; improved && best.error > 0;) {
+    improved = false;
+    for (int endpoint = 0; endpoint < 2; endpoint++) {
+      for (int c = 0; c < 4; c++) {
+        for (int step = -1; step <= 1; step += 2) {
+          Bc7 next = best;
+          next.ends[endpoint][c] += step;
+          if (next.ends[endpoint][c] < 0 || next.ends[endpoint][c] > 127) continue;
+          fitMode6(block, next);
+          if (next.error < best.error) best = next, improved = true;
+        }
+      }
+    }
+  }
+  return best;
+}
+
+// Mode 5 color: 777 endpoints expanded by bit replication, 2 bit indices over RGB
+inline int expand7(int value) { return value << 1 | value >> 6; }
+
+void fitColor5(const Block& block, Bc7& fit) {
+  int palette[4][3];
+  for (int i = 0; i < 4; i++) {
+    for (int c = 0; c < 3; c++) palette[i][c] = interpolate(expand7(fit.ends[0][c]), expand7(fit.ends[1][c]), WEIGHTS2[i]);
+  }
+  fit.error = 0;
+  for (int i = 0; i < 16; i++) {
+    int best = std::numeric_limits<int>::max();
+    for (int p = 0; p < 4; p++) {
+      int distance = 0;
+      for (int c = 0; c < 3; c++) distance += (block.texels[i][c] - palette[p][c]) * (block.texels[i][c] - palette[p][c]);
+      if (distance < best) best = distance, fit.color[i] = (uint8_t)p;
+    }
+    fit.error += best;
+  }
+}
+
+void fitAlpha5(const Block& block, Bc7& fit) {
+  int palette[4];
+  for (int i = 0; i < 4; i++) palette[i] = interpolate(fit.ends[0][3], fit.ends[1][3], WEIGHTS2[i]);
+  fit.alphaError = 0;
+  for (int i = 0; i < 16; i++) {
+    int best = std::numeric_limits<int>::max();
+    for (int p = 0; p < 4; p++) {
+      const int distance = (block.texels[i][3] - palette[p]) * (block.texels[i][3] - palette[p]);
+      if (distance < best) best = distance, fit.alpha[i] = (uint8_t)p;
+    }
+    fit.alphaError += best;
+  }
+}
+
+// Mode 5 after swapping channel `rotation - 1` into alpha; color and alpha are fitted apart
+Bc7 encodeMode5(const Block& source, int rotation, BlockQuality quality) {
+  Block block = source;
+  if (rotation > 0) {
+    for (int i = 0; i < 16; i++) std::swap(block.texels[i][rotation - 1], block.texels[i][3]);
+  }
+  const bool all[16] = {true, true, true, true, true, true, true, true, true, true, true, true, true, true, true, true};
+  float weights[4];
+  for (int i = 0; i < 4; i++) weights[i] = WEIGHTS2[i] / 64.0f;
+
+  Bc7 best;
+  best.mode = 5, best.rotation = rotation;
+  float e0[4], e1[4];
+  principalEndpoints(block, all, 0, 3, e0, e1);
+  auto quantizeColor = [](const float* e0, const float* e1, Bc7& fit) {
+    for (int c = 0; c < 3; c++) {
+      fit.ends[0][c] = std::clamp((int)(e0[c] * 127.0f / 255.0f + 0.5f), 0, 127);
+      fit.ends[1][c] = std::clamp((int)(e1[c] * 127.0f / 255.0f + 0.5f), 0, 127);
+    }
+  };
+  quantizeColor(e0, e1, best);
+  fitColor5(block, best);
+  for (int pass = 0; pass < refinePasses(quality) && best.error > 0; pass++) {
+    if (!leastSquares(block, all, best.color, weights, 0, 3, e0, e1)) break;
+    Bc7 next = best;
+    quantizeColor(e0, e1, next);
+    fitColor5(block, next);
+    if (next.error >= best.error) break;
+    best = next;
+  }
+
+  int low = 255, high = 0;
+  for (int i = 0; i < 16; i++) low = std::min(low, block.texels[i][3]), high = std::max(high, block.texels[i][3]);
+  best.ends[0][3] = low, best.ends[1][3] = high;
+  fitAlpha5(block, best);
+  for (int pass = 0; pass < refinePasses(quality) && best.alphaError > 0; pass++) {
+    if (!leastSquares(block, all, best.alpha, weights, 3, 1, e0, e1)) break;
+    Bc7 next = best;
+    next.ends[0][3] = (int)(e0[3] + 0.5f), next.ends[1][3] = (int)(e1[3] + 0.5f);
+    fitAlpha5(block, next);
+    if (next.alphaError >= best.alphaError) break;
+    best = next;
+  }
+  return best;
+}
+
+// Mode 1 ----------------------------------------------------------------------------------
+
+// -1 where texel i belongs to subset 1 of partition p, so partitions vectorize as lanes
+struct SubsetMasks {
+  int32_t mask[16][64];
+
+  SubsetMasks() {
+    for (int i = 0; i < 16; i++) {
+      for (int p = 0; p < 64; p++) mask[i][p] = PARTITIONS2[p] >> i & 1 ? -1 : 0;
+    }
+  }
+};
+const SubsetMasks SUBSET1;
+
+// Residual variance of a 3x3 covariance off its principal axis
+inline float offAxis(const float covariance[3][3]) {
+  int start = 0;
+  for (int c = 1; c < 3; c++) start = covariance[c][c] > covariance[start][start] ? c : start;
+  float axis[3] = {covariance[start][0], covariance[start][1], covariance[start][2]};
+  for (int iteration = 0; iteration < 2; iteration++) {
+    float next[3];
+    for (int a = 0; a < 3; a++) next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+    const float largest = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+    if (largest == 0.0f) break;
+    for (int a = 0; a < 3; a++) axis[a] = next[a] / largest;
+  }
+  // Rayleigh quotient: the variance along the axis
+  float along = 0.0f, length = 0.0f;
+  for (int a = 0; a < 3; a++) {
+    along += axis[a] * (covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2]);
+    length += axis[a] * axis[a];
+  }
+  const float trace = covariance[0][0] + covariance[1][1] + covariance[2][2];
+  return length > 0.0f ? trace - along / length : trace;
+}
+
+// What a line through each subset cannot represent, for all 64 partitions: ranks them.
+// Subset 1 sums accumulate per partition lane, subset 0 is the block total minus those.
+void partitionErrors(const Block& block, float* errors) {
+  int32_t sums[10][64] = {};
+  int32_t total[10] = {};
+  for (int i = 0; i < 16; i++) {
+    const int* t = block.texels[i];
+    const int32_t values[10] = {1, t[0], t[1], t[2], t[0] * t[0], t[0] * t[1], t[0] * t[2], t[1] * t[1], t[1] * t[2], t[2] * t[2]};
+    for (int k = 0; k < 10; k++) {
+      total[k] += values[k];
+      for (int p = 0; p < 64; p++) sums[k][p] += values[k] & SUBSET1.mask[i][p];
+    }
+  }
+  for (int p = 0; p < 64; p++) {
+    errors[p] = 0.0f;
+    for (int subset = 0; subset < 2; subset++) {
+      int32_t s[10];
+      for (int k = 0; k < 10; k++) s[k] = subset ? sums[k][p] : total[k] - sums[k][p];
+      const float n = (float)s[0];
+      const float mean[3] = {s[1] / n, s[2] / n, s[3] / n};
+      float covariance[3][3];
+      covariance[0][0] = s[4] - mean[0] * s[1], covariance[0][1] = s[5] - mean[0] * s[2], covariance[0][2] = s[6] - mean[0] * s[3];
+      covariance[1][1] = s[7] - mean[1] * s[2], covariance[1][2] = s[8] - mean[1] * s[3], covariance[2][2] = s[9] - mean[2] * s[3];
+      covariance[1][0] = covariance[0][1], covariance[2][0] = covariance[0][2], covariance[2][1] = covariance[1][2];
+      errors[p] += offAxis(covariance);
+    }
+  }
+}
+
+// 6 bit endpoint channel and shared p-bit to the 8 bit value the decoder sees
+inline int expandMode1(int value, int pbit) { return expand7(value << 1 | pbit); }
+
+inline void quantizeMode1(const float* value, int pbit, int* out) {
+  for (int c = 0; c < 3; c++) {
+    const int guess = std::clamp((int)((value[c] * 127.0f / 255.0f - pbit) * 0.5f + 0.5f), 0, 63);
+    out[c] = guess;
+    for (int q = std::max(guess - 1, 0); q <= std::min(guess + 1, 63); q++) {
+      if (std::fabs(expandMode1(q, pbit) - value[c]) < std::fabs(expandMode1(out[c], pbit) - value[c])) out[c] = q;
+    }
+  }
+}
+
+// Indices and RGB error of one subset, nearest weight by projection as in mode 6
+int fitSubset1(const Block& block, uint16_t partition, int subset, Bc7& fit) {
+  int e0[3], e1[3], direction[3], length = 0;
+  const int pbit = fit.pbits[subset * 2];
+  for (int c = 0; c < 3; c++) {
+    e0[c] = expandMode1(fit.ends[subset * 2][c], pbit);
+    e1[c] = expandMode1(fit.ends[subset * 2 + 1][c], pbit);
+    direction[c] = e1[c] - e0[c];
+    length += direction[c] * direction[c];
+  }
+  int palette[8][3];
+  for (int i = 0; i < 8; i++) {
+    for (int c = 0; c < 3; c++) palette[i][c] = interpolate(e0[c], e1[c], WEIGHTS3[i]);
+  }
+  int error = 0;
+  for (int i = 0; i < 16; i++) {
+    if ((partition >> i & 1) != subset) continue;
+    const int* texel = block.texels[i];
+    int guess = 0;
+    if (length > 0) {
+      const int dot = (texel[0] - e0[0]) * direction[0] + (texel[1] - e0[1]) * direction[1] + (texel[2] - e0[2]) * direction[2];
+      guess = NEAREST3.index[std::clamp((dot * 64 + length / 2) / length, 0, 64)];
+    }
+    int best = std::numeric_limits<int>::max();
+    for (int p = std::max(guess - 1, 0); p <= std::min(guess + 1, 7); p++) {
+      int distance = 0;
+      for (int c = 0; c < 3; c++) distance += (texel[c] - palette[p][c]) * (texel[c] - palette[p][c]);
+      if (distance < best) best = distance, fit.color[i] = (uint8_t)p;
+    }
+    error += best;
+  }
+  return error;
+}
+
+// Both p-bits tried for every endpoint pair; the subsets are independent
+int encodeSubset1(const Block& block, uint16_t partition, int subset, const float* e0, const float* e1, Bc7& fit) {
+  Bc7 trial = fit;
+  int best = std::numeric_limits<int>::max();
+  for (int pbit = 0; pbit < 2; pbit++) {
+    trial.pbits[subset * 2] = trial.pbits[subset * 2 + 1] = pbit;
+    quantizeMode1(e0, pbit, trial.ends[subset * 2]);
+    quantizeMode1(e1, pbit, trial.ends[subset * 2 + 1]);
+    const int error = fitSubset1(block, partition, subset, trial);
+    if (error < best) best = error, fit = trial;
+  }
+  return best;
+}
+
+Bc7 encodeMode1(const Block& block, int partition, BlockQuality quality) {
+  const uint16_t mask = PARTITIONS2[partition];
+  float weights[8];
+  for (int i = 0; i < 8; i++) weights[i] = WEIGHTS3[i] / 64.0f;
+
+  Bc7 fit;
+  fit.mode = 1, fit.partition = partition;
+  fit.error = 0;
+  for (int subset = 0; subset < 2; subset++) {
+    bool use[16];
+    for (int i = 0; i < 16; i++) use[i] = (mask >> i & 1) == subset;
+    float e0[4], e1[4];
+    principalEndpoints(block, use, 0, 3, e0, e1);
+    int error = encodeSubset1(block, mask, subset, e0, e1, fit);
+    for (int pass = 0; pass < refinePasses(quality) && error > 0; pass++) {
+      if (!leastSquares(block, use, fit.color, weights, 0, 3, e0, e1)) break;
+      Bc7 next = fit;
+      const int refined = encodeSubset1(block, mask, subset, e0, e1, next);
+      if (refined >= error) break;
+      error = refined, fit = next;
+    }
+    fit.error += error;
+  }
+  return fit;
+}
+
+// Anchor texels store their index without the top bit, so it must be in the lower half
+void writeBc7(Bc7 fit, uint8_t* out) {
+  memset(out, 0, 16);
+  Bits bits(out);
+  if (fit.mode == 6) {
+    if (fit.color[0] >= 8) {
+      std::swap(fit.ends[0], fit.ends[1]);
+      std::swap(fit.pbits[0], fit.pbits[1]);
+      for (uint8_t& index : fit.color) index = (uint8_t)(15 - index);
+    }
+    bits.put(1 << 6, 7);
+    for (int c = 0; c < 4; c++) bits.put(fit.ends[0][c], 7), bits.put(fit.ends[1][c], 7);
+    bits.put(fit.pbits[0], 1), bits.put(fit.pbits[1], 1);
+    for (int i = 0; i < 16; i++) bits.put(fit.color[i], i == 0 ? 3 : 4);
+    return;
+  }
+
+  if (fit.mode == 1) {
+    const uint16_t mask = PARTITIONS2[fit.partition];
+    const int anchors[2] = {0, ANCHORS2[fit.partition]};
+    for (int subset = 0; subset < 2; subset++) {
+      if (fit.color[anchors[subset]] < 4) continue;
+      std::swap(fit.ends[subset * 2], fit.ends[subset * 2 + 1]);
+      for (int i = 0; i < 16; i++) {
+        if ((mask >> i & 1) == subset) fit.color[i] = (uint8_t)(7 - fit.color[i]);
+      }
+    }
+    bits.put(1 << 1, 2);
+    bits.put(fit.partition, 6);
+    for (int c = 0; c < 3; c++) {
+      for (int e = 0; e < 4; e++) bits.put(fit.ends[e][c], 6);
+    }
+    bits.put(fit.pbits[0], 1), bits.put(fit.pbits[2], 1);
+    for (int i = 0; i < 16; i++) bits.put(fit.color[i], i == anchors[0] || i == anchors[1] ? 2 : 3);
+    return;
+  }
+
+  if (fit.color[0] >= 2) {
+    for (int c = 0; c < 3; c++) std::swap(fit.ends[0][c], fit.ends[1][c]);
+    for (uint8_t& index : fit.color) index = (uint8_t)(3 - index);
+  }
+  if (fit.alpha[0] >= 2) {
+    std::swap(fit.ends[0][3], fit.ends[1][3]);
+    for (uint8_t& index : fit.alpha) index = (uint8_t)(3 - index);
+  }
+  bits.put(1 << 5, 6);
+  bits.put(fit.rotation, 2);
+  for (int c = 0; c < 3; c++) bits.put(fit.ends[0][c], 7), bits.put(fit.ends[1][c], 7);
+  bits.put(fit.ends[0][3], 8), bits.put(fit.ends[1][3], 8);
+  for (int i = 0; i < 16; i++) bits.put(fit.color[i], i == 0 ? 1 : 2);
+  for (int i = 0; i < 16; i++) bits.put(fit.alpha[i], i == 0 ? 1 : 2);
+}
+
+// Edge blocks repeat the last row and column
+inline void gather(const Image& image, uint32_t bx, uint32_t by, uint8_t* texels) {
+  for (uint32_t y = 0; y < 4; y++) {
+    const uint8_t* row = image.row(std::min(by * 4 + y, image.height - 1));
+    for (uint32_t x = 0; x < 4; x++) memcpy(texels + (y * 4 + x) * 4, row + std::min(bx * 4 + x, image.width - 1) * 4, 4);
+  }
+}
+
+} // namespace
+
+
+void Renderer::Host::BlockCompress::encodeBC1(const uint8_t* texels, uint8_t* out, BlockQuality quality) {
+  const Block block(texels);
+  bool transparent[16], use[16], anyTransparent = false, allTransparent = true;
+  for (int i = 0; i < 16; i++) {
+    transparent[i] = texels[i * 4 + 3] < 128;
+    use[i] = !transparent[i];
+    anyTransparent |= transparent[i];
+    allTransparent &= transparent[i];
+  }
+
+  Bc1 best;
+  if (allTransparent) {
+    for (uint8_t& index : best.indices) index = 3;
+  } else {
+    float e0[4], e1[4];
+    principalEndpoints(block, use, 0, 3, e0, e1);
+    best = fitBc1(block, transparent, quantize565(e0), quantize565(e1), anyTransparent);
+    refineBc1(block, transparent, best, refinePasses(quality));
+    if (quality == BlockQuality::BEST && !anyTransparent) {
+      // The three color mode's midpoint can fit two clusters better
+      Bc1 three = fitBc1(block, transparent, best.c0, best.c1, true);
+      refineBc1(block, transparent, three, refinePasses(quality));
+      if (three.error < best.error) best = three;
+    }
+    if (quality == BlockQuality::BEST) searchBc1(block, transparent, best);
+  }
+
+  uint32_t indices = 0;
+  for (int i = 0; i < 16; i++) indices |= (uint32_t)best.indices[i] << (2 * i);
+  out[0] = (uint8_t)best.c0, out[1] = (uint8_t)(best.c0 >> 8);
+  out[2] = (uint8_t)best.c1, out[3] = (uint8_t)(best.c1 >> 8);
+  for (int b = 0; b < 4; b++) out[4 + b] = (uint8_t)(indices >> (8 * b));
+}
+
+
+void Renderer::Host::BlockCompress::encodeBC7(const uint8_t* texels, uint8_t* out, BlockQuality quality) {
+  const Block block(texels);
+  Bc7 best = encodeMode6(block, quality);
+
+  // Mode 1 has no alpha: opaque blocks only, on the partitions a line fits best
+  bool opaque = true;
+  for (int i = 0; i < 16; i++) opaque &= texels[i * 4 + 3] == 255;
+  if (opaque && best.error > GOOD_ENOUGH && partitionCandidates(quality) > 0) {
+    float errors[64];
+    partitionErrors(block, errors);
+    std::pair<float, int> ranked[64];
+    for (int p = 0; p < 64; p++) ranked[p] = {errors[p], p};
+    std::partial_sort(ranked, ranked + partitionCandidates(quality), ranked + 64);
+    for (int candidate = 0; candidate < partitionCandidates(quality); candidate++) {
+      const Bc7 fit = encodeMode1(block, ranked[candidate].second, quality);
+      if (fit.error < best.error) best = fit;
+    }
+  }
+  // Mode 5 indexes alpha on its own: blocks with alpha, or any channel swapped into it at BEST
+  const int rotations = quality == BlockQuality::BEST ? 4 : opaque ? 0 : 1;
+  for (int rotation = 0; rotation < rotations && best.error > GOOD_ENOUGH; rotation++) {
+    const Bc7 fit = encodeMode5(block, rotation, quality);
+    if (fit.error + fit.alphaError < best.error) best = fit, best.error += best.alphaError;
+  }
+  writeBc7(best, out);
+}
+
+
+void Renderer::Host::BlockCompress::decodeBC1(const uint8_t* block, uint8_t* texels) {
+  const uint16_t c0 = (uint16_t)(block[0] | block[1] << 8), c1 = (uint16_t)(block[2] | block[3] << 8);
+  int palette[4][4];
+  bc1Palette(c0, c1, palette);
+  const uint32_t indices = (uint32_t)block[4] | (uint32_t)block[5] << 8 | (uint32_t)block[6] << 16 | (uint32_t)block[7] << 24;
+  for (int i = 0; i < 16; i++) {
+    const int* color = palette[indices >> (2 * i) & 3];
+    for (int c = 0; c < 4; c++) texels[i * 4 + c] = (uint8_t)color[c];
+  }
+}
+
+
+void Renderer::Host::BlockCompress::decodeBC7(const uint8_t* block, uint8_t* texels) {
+  uint8_t copy[16];
+  memcpy(copy, block, 16);
+  Bits bits(copy);
+  int mode = 0;
+  while (mode < 8 && bits.get(1) == 0) mode++;
+
+  if (mode == 6) {
+    int ends[2][4];
+    for (int c = 0; c < 4; c++) ends[0][c] = (int)bits.get(7) << 1, ends[1][c] = (int)bits.get(7) << 1;
+    const int p0 = (int)bits.get(1), p1 = (int)bits.get(1);
+    for (int c = 0; c < 4; c++) ends[0][c] |= p0, ends[1][c] |= p1;
+    for (int i = 0; i < 16; i++) {
+      const int weight = WEIGHTS4[bits.get(i == 0 ? 3 : 4)];
+      for (int c = 0; c < 4; c++) texels[i * 4 + c] = (uint8_t)interpolate(ends[0][c], ends[1][c], weight);
+    }
+    return;
+  }
+
+  if (mode == 1) {
+    const int partition = (int)bits.get(6);
+    int ends[4][3];
+    for (int c = 0; c < 3; c++) {
+      for (int e = 0; e < 4; e++) ends[e][c] = (int)bits.get(6);
+    }
+    const int pbits[2] = {(int)bits.get(1), (int)bits.get(1)};
+    for (int i = 0; i < 16; i++) {
+      const int subset = PARTITIONS2[partition] >> i & 1;
+      const int weight = WEIGHTS3[bits.get(i == 0 || i == ANCHORS2[partition] ? 2 : 3)];
+      for (int c = 0; c < 3; c++) {
+        const int e0 = expandMode1(ends[subset * 2][c], pbits[subset]);
+        const int e1 = expandMode1(ends[subset * 2 + 1][c], pbits[subset]);
+        texels[i * 4 + c] = (uint8_t)interpolate(e0, e1, weight);
+      }
+      texels[i * 4 + 3] = 255;
+    }
+    return;
+  }
+
+  if (mode == 5) {
+    const int rotation = (int)bits.get(2);
+    int ends[2][4];
+    for (int c = 0; c < 3; c++) ends[0][c] = expand7((int)bits.get(7)), ends[1][c] = expand7((int)bits.get(7));
+    ends[0][3] = (int)bits.get(8), ends[1][3] = (int)bits.get(8);
+    for (int i = 0; i < 16; i++) {
+      const int weight = WEIGHTS2[bits.get(i == 0 ? 1 : 2)];
+      for (int c = 0; c < 3; c++) texels[i * 4 + c] = (uint8_t)interpolate(ends[0][c], ends[1][c], weight);
+    }
+    for (int i = 0; i < 16; i++) {
+      texels[i * 4 + 3] = (uint8_t)interpolate(ends[0][3], ends[1][3], WEIGHTS2[bits.get(i == 0 ? 1 : 2)]);
+      if (rotation > 0) std::swap(texels[i * 4 + rotation - 1], texels[i * 4 + 3]);
+    }
+    return;
+  }
+
+  for (int i = 0; i < 16; i++) texels[i * 4] = 255, texels[i * 4 + 1] = 0, texels[i * 4 + 2] = 255, texels[i * 4 + 3] = 255;
+}
+
+
+void Renderer::Host::BlockCompress::encode(
+  const Image& image,
+  BlockImage& out,
+  BlockFormat format,
+  BlockQuality quality,
+  unsigned int maxThreads
+) {
+  out.width = image.width, out.height = image.height;
+  out.format = format;
+  out.srgb = image.format == PixelFormat::RGBA8_SRGB;
+  out.data.clear();
+  if (image.format == PixelFormat::RGBA16F || image.width == 0 || image.height == 0) return;
+  out.data.assign(out.blocksWide() * (size_t)out.blocksHigh() * out.blockBytes(), 0);
+
+  // One block row per claim: BEST costs up to 30x FAST, so rows vary a lot less than that
+  EXP::THREAD::parallelFor(out.blocksHigh(), 1, [&](size_t first, size_t last) {
+    uint8_t texels[64];
+    for (size_t by = first; by < last; by++) {
+      uint8_t* target = out.data.data() + by * out.rowBytes();
+      for (uint32_t bx = 0; bx < out.blocksWide(); bx++, target += out.blockBytes()) {
+        gather(image, bx, (uint32_t)by, texels);
+        if (format == BlockFormat::BC1) encodeBC1(texels, target, quality);
+        else encodeBC7(texels, target, quality);
+      }
+    }
+  }, maxThreads);
+}
+
+
+BlockReport Renderer::Host::BlockCompress::encode(
+  const MipChain& chain,
+  BlockChain& out,
+  BlockFormat format,
+  BlockQuality quality,
+  unsigned int maxThreads
+) {
+  const auto start = std::chrono::steady_clock::now();
+  out.levels.assign(chain.levels.size(), BlockImage{});
+  for (size_t level = 0; level < chain.levels.size(); level++) {
+    encode(chain.levels[level], out.levels[level], format, quality, maxThreads);
+  }
+
+  BlockReport report;
+  report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double color = 0.0, alpha = 0.0, texels = 0.0;
+  Image decoded;
+  for (size_t level = 0; level < chain.levels.size(); level++) {
+    const Image& source = chain.levels[level];
+    decode(out.levels[level], decoded);
+    const double count = (double)source.width * source.height;
+    color += mse(source, decoded, 0, 3) * count, alpha += mse(source, decoded, 3, 1) * count, texels += count;
+  }
+  report.psnr = psnr(texels > 0.0 ? color / texels : 0.0);
+  report.alphaPsnr = psnr(texels > 0.0 ? alpha / texels : 0.0);
+  return report;
+}
+
+
+void Renderer::Host::BlockCompress::decode(const BlockImage& image, Image& out) {
+  out.allocate(image.width, image.height, image.srgb ? PixelFormat::RGBA8_SRGB : PixelFormat::RGBA8_UNORM);
+  if (image.data.size() < image.blocksWide() * (size_t)image.blocksHigh() * image.blockBytes()) return;
+  uint8_t texels[64];
+  for (uint32_t by = 0; by < image.blocksHigh(); by++) {
+    for (uint32_t bx = 0; bx < image.blocksWide(); bx++) {
+      const uint8_t* block = image.data.data() + by * image.rowBytes() + bx * image.blockBytes();
+      if (image.format == BlockFormat::BC1) decodeBC1(block, texels);
+      else decodeBC7(block, texels);
+      for (uint32_t y = 0; y < 4 && by * 4 + y < image.height; y++) {
+        const uint32_t width = std::min<uint32_t>(4, image.width - bx * 4);
+        memcpy(out.row(by * 4 + y) + bx * 16, texels + y * 16, width * 4);
+      }
+    }
+  }
+}
+
+
+double Renderer::Host::BlockCompress::mse(const Image& a, const Image& b, int first, int count) {
+  if (a.width != b.width || a.height != b.height || a.format == PixelFormat::RGBA16F || b.format == PixelFormat::RGBA16F) {
+    return std::numeric_limits<double>::infinity();
+  }
+  uint64_t sum = 0;
+  for (uint32_t y = 0; y < a.height; y++) {
+    const uint8_t* p = a.row(y);
+    const uint8_t* q = b.row(y);
+    for (uint32_t x = 0; x < a.width; x++) {
+      for (int c = first; c < first + count; c++) {
+        const int d = p[x * 4 + c] - q[x * 4 + c];
+        sum += (uint64_t)(d * d);
+      }
+    }
+  }
+  const double samples = (double)a.width * a.height * count;
+  return samples > 0.0 ? sum / samples : 0.0;
+}
+
+
+double Renderer::Host::BlockCompress::psnr(double mse) {
+  return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <Renderer/HostImage.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Block compression of RGBA8 images into the BCn formats Metal samples directly.
+ *
+ * - BC1: 4x4 texels in 8 bytes (two RGB565 endpoints, 2 bit indices). Blocks with texels
+ *   below alpha 128 use the three color mode with transparent black, like BC1_RGBA does.
+ * - BC7: 4x4 texels in 16 bytes. The encoder writes three of the eight modes: 6 (one subset,
+ *   RGBA 7777 with p-bits, 4 bit indices), 1 (two subsets from the 64 partition table, RGB
+ *   666 with p-bits, 3 bit indices; opaque blocks) and 5 (separate alpha indices; blocks with
+ *   alpha, or a color channel rotated into alpha at BEST).
+ *
+ * Endpoints come from the principal axis of each subset and are refined by least squares on
+ * the chosen indices. Mode 1 partitions are ranked by the variance a line through each subset
+ * leaves; blocks mode 6 already fits to about a level per channel skip the other modes. The
+ * quality knob trades encode time for error:
+ *
+ * - FAST: principal axis endpoints; BC7 modes 6 and 1 on the best ranked partition.
+ * - NORMAL: two refinement passes, every p-bit combination, the best two partitions.
+ * - BEST: four passes, eight partitions, a greedy +-1 search around the quantized endpoints,
+ *   the three color mode for opaque BC1 blocks and BC7 mode 5 with all four rotations.
+ *
+ * Blocks are independent and encoded in parallel block rows; the output does not depend on
+ * the thread count. Images are encoded as stored (sRGB data in sRGB), edge blocks repeat the
+ * last row and column. decode() reads BC1 and the BC7 modes the encoder writes.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+enum struct BlockFormat { BC1 = 0, BC7 = 1 };
+enum struct BlockQuality { FAST = 0, NORMAL = 1, BEST = 2 };
+
+struct BlockImage {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  BlockFormat format = BlockFormat::BC7;
+  bool srgb = true;
+  std::vector<uint8_t> data;
+
+  static inline size_t blockBytes(BlockFormat format) { return format == BlockFormat::BC1 ? 8 : 16; }
+  inline size_t blockBytes() const { return blockBytes(format); }
+  inline uint32_t blocksWide() const { return (width + 3) / 4; }
+  inline uint32_t blocksHigh() const { return (height + 3) / 4; }
+  // bytesPerRow for replaceRegion: one row of blocks
+  inline size_t rowBytes() const { return blocksWide() * blockBytes(); }
+  inline size_t bytes() const { return data.size(); }
+};
+
+struct BlockChain {
+  std::vector<BlockImage> levels;
+
+  inline size_t bytes() const {
+    size_t total = 0;
+    for (const BlockImage& level : levels) total += level.bytes();
+    return total;
+  }
+};
+
+// Error of the compressed chain against its source, over all levels
+struct BlockReport {
+  double psnr = 0.0;  // RGB, dB; infinity when lossless
+  double alphaPsnr = 0.0;
+  double seconds = 0.0;
+};
+
+struct BlockCompress {
+  // RGBA8 images only (RGBA8_SRGB or RGBA8_UNORM)
+  static void encode(
+    const Image& image,
+    BlockImage& out,
+    BlockFormat format = BlockFormat::BC7,
+    BlockQuality quality = BlockQuality::NORMAL,
+    unsigned int maxThreads = 0
+  );
+  static BlockReport encode(
+    const MipChain& chain,
+    BlockChain& out,
+    BlockFormat format = BlockFormat::BC7,
+    BlockQuality quality = BlockQuality::NORMAL,
+    unsigned int maxThreads = 0
+  );
+  static void decode(const BlockImage& image, Image& out);
+
+public: // Single blocks: 16 RGBA texels, row major
+  static void encodeBC1(const uint8_t* texels, uint8_t* block, BlockQuality quality);
+  static void encodeBC7(const uint8_t* texels, uint8_t* block, BlockQuality quality);
+  static void decodeBC1(const uint8_t* block, uint8_t* texels);
+  // Modes other than 1, 5 and 6 decode to opaque magenta
+  static void decodeBC7(const uint8_t* block, uint8_t* texels);
+
+public: // Error
+  // Mean squared error per sample over channels [first, first + count): RGB 0, 3; alpha 3, 1
+  static double mse(const Image& a, const Image& b, int first = 0, int count = 3);
+  static double psnr(double mse);
+};
+
+}; // namespace Host
+}; // namespace Renderer
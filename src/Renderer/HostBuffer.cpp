@@ -0,0 +1,120 @@
+#include <Renderer/HostBuffer.h>
+#include <Thread/Pool.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using Renderer::Host::PrimitiveAttributes;
+using Renderer::Host::VertexAttributes;
+
+inline void buildRange(
+  const VertexAttributes* attributes,
+  const uint32_t* indices,
+  int texindex,
+  PrimitiveAttributes* out,
+  size_t begin,
+  size_t end
+) {
+  for (size_t i = begin; i < end; i++) {
+    const VertexAttributes& a = attributes[indices[i * 3 + 0]];
+    const VertexAttributes& b = attributes[indices[i * 3 + 1]];
+    const VertexAttributes& c = attributes[indices[i * 3 + 2]];
+    PrimitiveAttributes& primitive = out[i];
+    primitive.color[0] = a.color;
+    primitive.color[1] = b.color;
+    primitive.color[2] = c.color;
+    primitive.normal[0] = a.normal;
+    primitive.normal[1] = b.normal;
+    primitive.normal[2] = c.normal;
+    primitive.txcoord[0] = a.texture;
+    primitive.txcoord[1] = b.texture;
+    primitive.txcoord[2] = c.texture;
+    primitive.flags = {(uint8_t)texindex, 0};
+  }
+}
+
+#if defined(__SSE2__)
+// A primitive is nine 16 byte rows: 3 colors, txcoord a|b, txcoord c|pad, 3 normals, flags|pad.
+// Every row is assembled in registers and streamed out, so no output line is ever read.
+inline void streamRange(
+  const VertexAttributes* attributes,
+  const uint32_t* indices,
+  int texindex,
+  PrimitiveAttributes* out,
+  size_t begin,
+  size_t end
+) {
+  const __m128i flags = _mm_set_epi32(0, 0, 0, (int)(uint8_t)texindex);
+  for (size_t i = begin; i < end; i++) {
+    const float* a = reinterpret_cast<const float*>(attributes + indices[i * 3 + 0]);
+    const float* b = reinterpret_cast<const float*>(attributes + indices[i * 3 + 1]);
+    const float* c = reinterpret_cast<const float*>(attributes + indices[i * 3 + 2]);
+    float* row = reinterpret_cast<float*>(out + i);
+
+    const __m128 txa = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(a + 4)));
+    const __m128 txb = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(b + 4)));
+    const __m128 txc = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(c + 4)));
+
+    _mm_stream_ps(row + 0, _mm_load_ps(a));
+    _mm_stream_ps(row + 4, _mm_load_ps(b));
+    _mm_stream_ps(row + 8, _mm_load_ps(c));
+    _mm_stream_ps(row + 12, _mm_movelh_ps(txa, txb));
+    _mm_stream_ps(row + 16, txc);
+    _mm_stream_ps(row + 20, _mm_load_ps(a + 8));
+    _mm_stream_ps(row + 24, _mm_load_ps(b + 8));
+    _mm_stream_ps(row + 28, _mm_load_ps(c + 8));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(row + 32), flags);
+  }
+  // Streaming stores are weakly ordered: publish them before the block counts as done
+  _mm_sfence();
+}
+#else
+inline void streamRange(
+  const VertexAttributes* attributes,
+  const uint32_t* indices,
+  int texindex,
+  PrimitiveAttributes* out,
+  size_t begin,
+  size_t end
+) {
+  buildRange(attributes, indices, texindex, out, begin, end);
+}
+#endif
+
+}; // namespace
+
+
+void Renderer::Host::Buffer::perPrimitiveScalar(
+  const VertexAttributes* attributes,
+  const uint32_t* indices,
+  size_t indexCount,
+  int texindex,
+  PrimitiveAttributes* out
+) {
+  buildRange(attributes, indices, texindex, out, 0, indexCount / 3);
+}
+
+void Renderer::Host::Buffer::perPrimitive(
+  const VertexAttributes* attributes,
+  const uint32_t* indices,
+  size_t indexCount,
+  int texindex,
+  PrimitiveAttributes* out,
+  unsigned int maxThreads
+) {
+  const size_t triangles = indexCount / 3;
+  const bool stream = (uintptr_t)out % 16 == 0 && (uintptr_t)attributes % 16 == 0 &&
+                      triangles * sizeof(PrimitiveAttributes) >= STREAM_BYTES;
+
+  EXP::THREAD::parallelFor(
+    triangles,
+    GRAIN,
+    [&](size_t begin, size_t end) {
+      if (stream) streamRange(attributes, indices, texindex, out, begin, end);
+      else buildRange(attributes, indices, texindex, out, begin, end);
+    },
+    maxThreads
+  );
+}
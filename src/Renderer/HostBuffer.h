@@ -0,0 +1,41 @@
+#pragma once
+#include <Renderer/HostTypes.h>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * CPU side buffer builders, shared by the Metal upload and the headless tools.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+struct Buffer {
+  // Same output as Renderer::Buffer::perPrimitive: the three corner attributes of every
+  // triangle plus the texture index in flags.x. `out` holds indexCount / 3 entries.
+  // Built in parallel over triangle ranges; large, 16 byte aligned outputs are written with
+  // streaming (non temporal) stores on x86, since the GPU reads them and the CPU never does.
+  static void perPrimitive(
+    const VertexAttributes* attributes,
+    const uint32_t* indices,
+    size_t indexCount,
+    int texindex,
+    PrimitiveAttributes* out,
+    unsigned int maxThreads = 0
+  );
+  // Single threaded, regular stores: the reference the parallel builder is tested against
+  static void perPrimitiveScalar(
+    const VertexAttributes* attributes,
+    const uint32_t* indices,
+    size_t indexCount,
+    int texindex,
+    PrimitiveAttributes* out
+  );
+
+public:
+  static constexpr size_t GRAIN = 4096;               // Triangles per parallel block
+  static constexpr size_t STREAM_BYTES = 1024 * 1024; // Smaller outputs stay in cache
+};
+
+}; // namespace Host
+}; // namespace Renderer
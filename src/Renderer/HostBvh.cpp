@@ -0,0 +1,1172 @@
+#include <Renderer/HostBvh.h>
+#include <Thread/Pool.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <cstring>
+#include <memory>
+#include <numeric>
+
+using EXP::MATH::packed3;
+using Renderer::Host::Aabb;
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhGeometry;
+using Renderer::Host::BvhNode;
+using Renderer::Host::BvhReport;
+using Renderer::Host::BvhSettings;
+using Renderer::Host::BvhTriangle;
+
+namespace {
+
+constexpr uint32_t MAX_BINS = 64;
+constexpr uint32_t MAX_DEPTH = 64; // Traversal stack size
+constexpr uint32_t SMALL = 16;     // Ranges up to this size try every centroid plane instead of bins
+constexpr uint32_t CHUNK = 8192;   // Primitives per block when one range is binned or partitioned across threads
+constexpr uint32_t SORT_BLOCK = 65536; // Keys per block of a radix sort pass
+constexpr uint32_t RADIX_BITS = 11;     // Digit size: three passes for 30 bit keys, six for 63
+constexpr uint32_t RADIX = 1u << RADIX_BITS;
+
+inline bool fail(std::string* error, const std::string& message) {
+  if (error) *error = message;
+  return false;
+}
+
+inline packed3 centroid(const Aabb& b) {
+  return {(b.min.x + b.max.x) * 0.5f, (b.min.y + b.max.y) * 0.5f, (b.min.z + b.max.z) * 0.5f};
+}
+
+struct Bin {
+  Aabb bounds;
+  Aabb centroids;
+  uint32_t count = 0;
+
+  inline void merge(const Bin& other) {
+    bounds.grow(other.bounds);
+    centroids.grow(other.centroids);
+    count += other.count;
+  }
+};
+
+struct Split {
+  float cost = INFINITY;
+  int axis = -1;
+  uint32_t bin = 0; // Bins [0, bin) go left; for sorted splits, the size of the left side
+  bool sorted = false; // Range already reordered along `axis`
+  Aabb left, right, leftCentroids, rightCentroids;
+};
+
+struct Task {
+  uint32_t node;
+  uint32_t begin, end;
+  uint32_t depth;
+  Aabb bounds;
+  Aabb centroids;
+};
+
+// What every stage of one build reads
+struct Build {
+  const std::vector<Aabb>& boxes;
+  const std::vector<packed3>& centers;
+  uint32_t* primitives;
+  const BvhSettings& settings;
+};
+
+// Bin planes of a range along each axis, bounded by its centroid extent
+struct Binning {
+  uint32_t count;
+  float low[3], scale[3];
+
+  Binning(const Task& task, const BvhSettings& settings) : count(std::min(std::max(settings.bins, 2u), MAX_BINS)) {
+    for (int axis = 0; axis < 3; axis++) {
+      const float extent = task.centroids.max[axis] - task.centroids.min[axis];
+      low[axis] = task.centroids.min[axis];
+      scale[axis] = extent > 0.0f ? count / extent : 0.0f;
+    }
+  }
+  inline uint32_t bin(const packed3& center, int axis) const {
+    return std::min((uint32_t)((center[axis] - low[axis]) * scale[axis]), count - 1);
+  }
+};
+
+inline uint32_t blocks(const Task& task, bool parallel) {
+  return parallel ? (task.end - task.begin + CHUNK - 1) / CHUNK : 1;
+}
+
+// Bins primitives[begin, end) on all three axes in one pass, into 3 * binning.count entries
+void binRange(const Build& build, uint32_t begin, uint32_t end, const Binning& binning, Bin* bins) {
+  for (uint32_t i = begin; i < end; i++) {
+    const uint32_t primitive = build.primitives[i];
+    for (int axis = 0; axis < 3; axis++) {
+      Bin& bin = bins[axis * binning.count + binning.bin(build.centers[primitive], axis)];
+      bin.bounds.grow(build.boxes[primitive]);
+      bin.centroids.grow(build.centers[primitive]);
+      bin.count++;
+    }
+  }
+}
+
+// Cheapest plane between the bins of any axis
+Split bestPlane(const Bin* bins, const Binning& binning, const Task& task, const BvhSettings& settings) {
+  const uint32_t binCount = binning.count;
+  Split best;
+  for (int axis = 0; axis < 3; axis++) {
+    if (binning.scale[axis] == 0.0f) continue;
+    const Bin* axisBins = bins + axis * binCount;
+
+    // Right to left: area and count of everything from bin b on
+    float rightArea[MAX_BINS];
+    uint32_t rightCount[MAX_BINS];
+    Aabb right;
+    uint32_t count = 0;
+    for (uint32_t b = binCount - 1; b > 0; b--) {
+      right.grow(axisBins[b].bounds);
+      count += axisBins[b].count;
+      rightArea[b] = right.area();
+      rightCount[b] = count;
+    }
+    Aabb left;
+    count = 0;
+    for (uint32_t b = 1; b < binCount; b++) {
+      left.grow(axisBins[b - 1].bounds);
+      count += axisBins[b - 1].count;
+      if (count == 0 || rightCount[b] == 0) continue;
+      const float cost = left.area() * count + rightArea[b] * rightCount[b];
+      if (cost < best.cost) {
+        best.cost = cost;
+        best.axis = axis;
+        best.bin = b;
+      }
+    }
+  }
+  if (best.axis < 0) return best;
+
+  // Children bounds from the bins of the winning plane
+  const Bin* axisBins = bins + best.axis * binCount;
+  for (uint32_t b = 0; b < binCount; b++) {
+    (b < best.bin ? best.left : best.right).grow(axisBins[b].bounds);
+    (b < best.bin ? best.leftCentroids : best.rightCentroids).grow(axisBins[b].centroids);
+  }
+  const float area = task.bounds.area();
+  best.cost = settings.traversalCost + settings.intersectionCost * (area > 0.0f ? best.cost / area : 0.0f);
+  return best;
+}
+
+// Best binned split of a range. In parallel, every CHUNK primitives bin into their own set,
+// merged in block order so the result does not depend on the thread count.
+Split findSplit(const Build& build, const Task& task, std::vector<Bin>& bins, bool parallel) {
+  const Binning binning(task, build.settings);
+  const uint32_t count = blocks(task, parallel), stride = 3 * binning.count;
+  bins.assign((size_t)count * stride, Bin());
+  if (count == 1) {
+    binRange(build, task.begin, task.end, binning, bins.data());
+  } else {
+    EXP::THREAD::parallelFor(count, 1, [&](size_t first, size_t last) {
+      for (size_t b = first; b < last; b++) {
+        const uint32_t begin = task.begin + (uint32_t)b * CHUNK;
+        binRange(build, begin, std::min(begin + CHUNK, task.end), binning, bins.data() + b * stride);
+      }
+    }, build.settings.threads);
+    for (uint32_t b = 1; b < count; b++) {
+      for (uint32_t i = 0; i < stride; i++) bins[i].merge(bins[(size_t)b * stride + i]);
+    }
+  }
+  return bestPlane(bins.data(), binning, task, build.settings);
+}
+
+// Exact SAH for small ranges, where setting up bins costs more than the primitives: sorts the
+// range along each axis, tries every split between neighbours and leaves the winning order behind
+Split sweepSplit(const Build& build, const Task& task) {
+  const uint32_t size = task.end - task.begin;
+  uint32_t* primitives = build.primitives;
+  uint32_t order[3][SMALL];
+  float rightArea[SMALL];
+  Split best;
+  for (int axis = 0; axis < 3; axis++) {
+    if (!(task.centroids.max[axis] > task.centroids.min[axis])) continue;
+    uint32_t* sorted = order[axis];
+    for (uint32_t i = 0; i < size; i++) {
+      const uint32_t primitive = primitives[task.begin + i];
+      uint32_t k = i;
+      for (; k > 0 && build.centers[sorted[k - 1]][axis] > build.centers[primitive][axis]; k--) sorted[k] = sorted[k - 1];
+      sorted[k] = primitive;
+    }
+    Aabb right;
+    for (uint32_t i = size - 1; i > 0; i--) {
+      right.grow(build.boxes[sorted[i]]);
+      rightArea[i] = right.area();
+    }
+    Aabb left;
+    for (uint32_t i = 1; i < size; i++) {
+      left.grow(build.boxes[sorted[i - 1]]);
+      const float cost = left.area() * i + rightArea[i] * (size - i);
+      if (cost < best.cost) {
+        best.cost = cost;
+        best.axis = axis;
+        best.bin = i;
+      }
+    }
+  }
+  if (best.axis < 0) return best;
+
+  best.sorted = true;
+  for (uint32_t i = 0; i < size; i++) {
+    const uint32_t primitive = order[best.axis][i];
+    primitives[task.begin + i] = primitive;
+    (i < best.bin ? best.left : best.right).grow(build.boxes[primitive]);
+    (i < best.bin ? best.leftCentroids : best.rightCentroids).grow(build.centers[primitive]);
+  }
+  const float area = task.bounds.area();
+  best.cost = build.settings.traversalCost + build.settings.intersectionCost * (area > 0.0f ? best.cost / area : 0.0f);
+  return best;
+}
+
+// Moves the primitives left of a binned split to the front, returns where the right side starts.
+// In parallel the partition is stable: blocks count their left side, then scatter through `scratch`.
+uint32_t partition(const Build& build, const Task& task, const Split& split, std::vector<uint32_t>& scratch, bool parallel) {
+  const Binning binning(task, build.settings);
+  auto left = [&](uint32_t primitive) { return binning.bin(build.centers[primitive], split.axis) < split.bin; };
+  uint32_t* primitives = build.primitives;
+  const uint32_t count = blocks(task, parallel);
+  if (count == 1) return (uint32_t)(std::partition(primitives + task.begin, primitives + task.end, left) - primitives);
+
+  std::vector<uint32_t> offsets(count + 1, 0);
+  EXP::THREAD::parallelFor(count, 1, [&](size_t first, size_t last) {
+    for (size_t b = first; b < last; b++) {
+      const uint32_t begin = task.begin + (uint32_t)b * CHUNK, end = std::min(begin + CHUNK, task.end);
+      offsets[b + 1] = (uint32_t)std::count_if(primitives + begin, primitives + end, left);
+    }
+  }, build.settings.threads);
+  for (uint32_t b = 0; b < count; b++) offsets[b + 1] += offsets[b];
+  const uint32_t leftCount = offsets[count];
+  if (scratch.size() < task.end) scratch.resize(task.end);
+
+  EXP::THREAD::parallelFor(count, 1, [&](size_t first, size_t last) {
+    for (size_t b = first; b < last; b++) {
+      const uint32_t begin = task.begin + (uint32_t)b * CHUNK, end = std::min(begin + CHUNK, task.end);
+      uint32_t l = task.begin + offsets[b], r = task.begin + leftCount + ((uint32_t)b * CHUNK - offsets[b]);
+      for (uint32_t i = begin; i < end; i++) {
+        if (left(primitives[i])) scratch[l++] = primitives[i];
+        else scratch[r++] = primitives[i];
+      }
+    }
+  }, build.settings.threads);
+  EXP::THREAD::parallelFor(count, 1, [&](size_t first, size_t last) {
+    const uint32_t begin = task.begin + (uint32_t)first * CHUNK, end = std::min(task.begin + (uint32_t)last * CHUNK, task.end);
+    std::copy(scratch.begin() + begin, scratch.begin() + end, primitives + begin);
+  }, build.settings.threads);
+  return task.begin + leftCount;
+}
+
+Aabb rangeBounds(const Build& build, uint32_t begin, uint32_t end, Aabb& centroids, bool parallel) {
+  const Task range = {0, begin, end, 0, Aabb(), Aabb()};
+  std::vector<std::pair<Aabb, Aabb>> partial(blocks(range, parallel));
+  EXP::THREAD::parallelFor(partial.size(), 1, [&](size_t first, size_t last) {
+    for (size_t b = first; b < last; b++) {
+      const uint32_t from = begin + (uint32_t)b * CHUNK, to = partial.size() == 1 ? end : std::min(from + CHUNK, end);
+      for (uint32_t i = from; i < to; i++) {
+        partial[b].first.grow(build.boxes[build.primitives[i]]);
+        partial[b].second.grow(build.centers[build.primitives[i]]);
+      }
+    }
+  }, build.settings.threads);
+  Aabb bounds;
+  centroids = Aabb();
+  for (const std::pair<Aabb, Aabb>& block : partial) {
+    bounds.grow(block.first);
+    centroids.grow(block.second);
+  }
+  return bounds;
+}
+
+// Splits a range in two, or returns false when it is better off as a leaf
+bool splitTask(
+  const Build& build,
+  const Task& task,
+  Task& left,
+  Task& right,
+  std::vector<Bin>& bins,
+  std::vector<uint32_t>& scratch,
+  bool parallel
+) {
+  const BvhSettings& settings = build.settings;
+  const uint32_t size = task.end - task.begin;
+  Split split;
+  if (size > 1 && task.depth < MAX_DEPTH) {
+    if (size <= SMALL) split = sweepSplit(build, task);
+    else split = findSplit(build, task, bins, parallel);
+  }
+  const float leafCost = settings.intersectionCost * size;
+  const bool fits = size <= settings.maxLeafSize || task.depth >= MAX_DEPTH;
+  if (size <= 1 || (fits && !(split.cost < leafCost))) return false;
+
+  uint32_t middle = task.begin;
+  left = {0, task.begin, 0, task.depth + 1, split.left, split.leftCentroids};
+  right = {0, 0, task.end, task.depth + 1, split.right, split.rightCentroids};
+  if (split.sorted) middle = task.begin + split.bin;
+  else if (split.axis >= 0) middle = partition(build, task, split, scratch, parallel);
+  if (split.axis < 0 || middle == task.begin || middle == task.end) {
+    // Every centroid in one point: halve the range
+    middle = task.begin + size / 2;
+    left.bounds = rangeBounds(build, task.begin, middle, left.centroids, parallel);
+    right.bounds = rangeBounds(build, middle, task.end, right.centroids, parallel);
+  }
+  left.end = right.begin = middle;
+  return true;
+}
+
+// Depth first from `root`, whose node already exists. With `deferred`, ranges of settings.taskSize
+// and below are handed back instead of built, and the ones above are split across the pool.
+void buildNodes(const Build& build, const Task& root, std::vector<BvhNode>& nodes, std::vector<Task>* deferred) {
+  std::vector<Task> stack = {root};
+  std::vector<Bin> bins;
+  std::vector<uint32_t> scratch;
+  while (!stack.empty()) {
+    const Task task = stack.back();
+    stack.pop_back();
+    if (deferred && task.end - task.begin <= build.settings.taskSize) {
+      deferred->push_back(task);
+      continue;
+    }
+    Task left, right;
+    if (!splitTask(build, task, left, right, bins, scratch, deferred != nullptr)) {
+      nodes[task.node] = {task.bounds.min, task.begin, task.bounds.max, task.end - task.begin};
+      continue;
+    }
+    left.node = (uint32_t)nodes.size();
+    right.node = left.node + 1;
+    nodes.push_back({});
+    nodes.push_back({});
+    nodes[task.node] = {task.bounds.min, left.node, task.bounds.max, 0};
+    stack.push_back(right);
+    stack.push_back(left);
+  }
+}
+
+// Spreads the low 21 bits of x to every third bit
+inline uint64_t spread(uint64_t x) {
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffull;
+  x = (x | x << 16) & 0x1f0000ff0000ffull;
+  x = (x | x << 8) & 0x100f00f00f00f00full;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+  x = (x | x << 2) & 0x1249249249249249ull;
+  return x;
+}
+
+// Length of the common prefix of sorted keys i and j, -1 outside the array. Equal keys compare
+// by position, so every key is unique as far as the hierarchy is concerned.
+inline int delta(const uint64_t* keys, int64_t count, int64_t i, int64_t j) {
+  if (j < 0 || j >= count) return -1;
+  if (keys[i] == keys[j]) return 64 + __builtin_clz((uint32_t)i ^ (uint32_t)j);
+  return __builtin_clzll(keys[i] ^ keys[j]);
+}
+
+inline Aabb triangleBounds(const BvhTriangle& triangle) {
+  Aabb box;
+  box.grow(triangle.v0);
+  box.grow(triangle.v1);
+  box.grow(triangle.v2);
+  return box;
+}
+
+// Empty (Aabb()) when they do not overlap; touching boxes overlap in a face
+inline Aabb intersection(const Aabb& a, const Aabb& b) {
+  Aabb result;
+  for (int axis = 0; axis < 3; axis++) {
+    result.min[axis] = std::max(a.min[axis], b.min[axis]);
+    result.max[axis] = std::min(a.max[axis], b.max[axis]);
+    if (result.min[axis] > result.max[axis]) return Aabb();
+  }
+  return result;
+}
+
+struct SpatialBin {
+  Aabb bounds;
+  uint32_t entries = 0, exits = 0;
+};
+
+struct SpatialSplit {
+  float cost = INFINITY;
+  int axis = -1;
+  float position = 0.0f;
+  Aabb left, right;
+  uint32_t leftCount = 0, rightCount = 0;
+};
+
+// Bounds of the parts of a triangle either side of a plane, each kept within `bounds`, the part
+// of the triangle the reference stands for. Crossing points sit exactly on the plane, so the two
+// sides always meet.
+void splitReference(const BvhTriangle& triangle, const Aabb bounds, int axis, float position, Aabb& left, Aabb& right) {
+  left = right = Aabb();
+  const packed3* corners = &triangle.v0;
+  for (int k = 0; k < 3; k++) {
+    const packed3& a = corners[k];
+    const packed3& b = corners[(k + 1) % 3];
+    if (a[axis] <= position) left.grow(a);
+    if (a[axis] >= position) right.grow(a);
+    if ((a[axis] < position && b[axis] > position) || (a[axis] > position && b[axis] < position)) {
+      const float t = (position - a[axis]) / (b[axis] - a[axis]);
+      packed3 crossing = {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t};
+      crossing[axis] = position;
+      left.grow(crossing);
+      right.grow(crossing);
+    }
+  }
+  left = intersection(left, bounds);
+  right = intersection(right, bounds);
+}
+
+// Best split plane between spatial bins over the node bounds: references are chopped into every
+// bin they cross, counted where they enter and where they leave (Stich et al. 2009)
+SpatialSplit findSpatialSplit(
+  const std::vector<BvhTriangle>& triangles,
+  const std::vector<Aabb>& boxes,
+  const std::vector<uint32_t>& owners,
+  const std::vector<uint32_t>& references,
+  const Task& task,
+  const BvhSettings& settings,
+  std::vector<SpatialBin>& bins
+) {
+  const uint32_t binCount = std::min(std::max(settings.bins, 2u), MAX_BINS);
+  SpatialSplit best;
+  for (int axis = 0; axis < 3; axis++) {
+    const float low = task.bounds.min[axis], extent = task.bounds.max[axis] - low;
+    if (!(extent > 0.0f)) continue;
+    const float width = extent / binCount;
+    bins.assign(binCount, SpatialBin());
+    for (uint32_t reference : references) {
+      const Aabb& box = boxes[reference];
+      const uint32_t first = std::min((uint32_t)std::max((box.min[axis] - low) / width, 0.0f), binCount - 1);
+      const uint32_t last = std::max(std::min((uint32_t)std::max((box.max[axis] - low) / width, 0.0f), binCount - 1), first);
+      bins[first].entries++;
+      bins[last].exits++;
+      Aabb rest = box, part;
+      for (uint32_t b = first; b < last; b++) {
+        splitReference(triangles[owners[reference]], rest, axis, low + width * (b + 1), part, rest);
+        bins[b].bounds.grow(part);
+      }
+      bins[last].bounds.grow(rest);
+    }
+
+    float rightArea[MAX_BINS];
+    uint32_t rightCount[MAX_BINS];
+    Aabb right;
+    uint32_t count = 0;
+    for (uint32_t b = binCount - 1; b > 0; b--) {
+      right.grow(bins[b].bounds);
+      count += bins[b].exits;
+      rightArea[b] = right.area();
+      rightCount[b] = count;
+    }
+    Aabb left;
+    count = 0;
+    for (uint32_t b = 1; b < binCount; b++) {
+      left.grow(bins[b - 1].bounds);
+      count += bins[b - 1].entries;
+      if (count == 0 || rightCount[b] == 0) continue;
+      const float cost = left.area() * count + rightArea[b] * rightCount[b];
+      if (cost < best.cost) {
+        best.cost = cost;
+        best.axis = axis;
+        best.position = low + width * b;
+        best.leftCount = count;
+        best.rightCount = rightCount[b];
+        best.left = left;
+        best.right = Aabb();
+        for (uint32_t k = b; k < binCount; k++) best.right.grow(bins[k].bounds);
+      }
+    }
+  }
+  const float area = task.bounds.area();
+  if (best.axis >= 0) best.cost = settings.traversalCost + settings.intersectionCost * (area > 0.0f ? best.cost / area : 0.0f);
+  return best;
+}
+
+// Binned SAH over boxes: the top levels split across the pool, the ranges below them as
+// independent subtrees, biggest first
+void buildBoxes(const std::vector<Aabb>& boxes, const std::vector<packed3>& centers, Bvh& bvh, const BvhSettings& settings) {
+  const uint32_t count = (uint32_t)boxes.size();
+  bvh.spatial = false;
+  bvh.nodes.clear();
+  bvh.primitives.resize(count);
+  std::iota(bvh.primitives.begin(), bvh.primitives.end(), 0);
+  if (count == 0) return;
+  bvh.nodes.reserve(2 * count - 1);
+  bvh.nodes.push_back({});
+  const Build build = {boxes, centers, bvh.primitives.data(), settings};
+  Task root = {0, 0, count, 1, Aabb(), Aabb()};
+  root.bounds = rangeBounds(build, 0, count, root.centroids, true);
+
+  // Top levels one range at a time, each binned and partitioned across the pool
+  std::vector<Task> subtrees;
+  buildNodes(build, root, bvh.nodes, &subtrees);
+
+  // Below them, independent subtrees into their own node lists, biggest first
+  std::vector<uint32_t> order(subtrees.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return subtrees[a].end - subtrees[a].begin > subtrees[b].end - subtrees[b].begin;
+  });
+  std::vector<std::vector<BvhNode>> local(subtrees.size());
+  EXP::THREAD::parallelFor(order.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      Task task = subtrees[order[i]];
+      task.node = 0;
+      local[order[i]].reserve(2 * (task.end - task.begin) - 1);
+      local[order[i]].push_back({});
+      buildNodes(build, task, local[order[i]], nullptr);
+    }
+  }, settings.threads);
+
+  // Stitched in the order the top levels handed them out, so the tree is the same for any thread
+  // count: a subtree root replaces its placeholder, the rest follows contiguously
+  std::vector<uint32_t> base(subtrees.size());
+  size_t total = bvh.nodes.size();
+  for (size_t k = 0; k < subtrees.size(); k++) {
+    base[k] = (uint32_t)total;
+    total += local[k].size() - 1;
+  }
+  bvh.nodes.resize(total);
+  EXP::THREAD::parallelFor(subtrees.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; k++) {
+      for (size_t i = 0; i < local[k].size(); i++) {
+        BvhNode node = local[k][i];
+        if (!node.isLeaf()) node.index = base[k] + node.index - 1;
+        bvh.nodes[i == 0 ? subtrees[k].node : base[k] + i - 1] = node;
+      }
+      std::vector<BvhNode>().swap(local[k]);
+    }
+  }, settings.threads);
+}
+
+} // namespace
+
+
+void Renderer::Host::BvhBuilder::gather(const std::vector<BvhGeometry>& geometries, Bvh& bvh, unsigned int threads) {
+  bvh.leafOrder = false;
+  bvh.geometryFirst.assign(1, 0);
+  for (const BvhGeometry& geometry : geometries) bvh.geometryFirst.push_back(bvh.geometryFirst.back() + (uint32_t)geometry.triangleCount);
+  bvh.triangles.resize(bvh.geometryFirst.back());
+
+  for (size_t g = 0; g < geometries.size(); g++) {
+    const BvhGeometry& geometry = geometries[g];
+    const uint8_t* vertices = static_cast<const uint8_t*>(geometry.vertices);
+    const bool shortIndices = geometry.indexSize == sizeof(uint16_t);
+    BvhTriangle* triangles = bvh.triangles.data() + bvh.geometryFirst[g];
+    EXP::THREAD::parallelFor(geometry.triangleCount, 16384, [&](size_t begin, size_t end) {
+      for (size_t t = begin; t < end; t++) {
+        packed3* corners = &triangles[t].v0;
+        for (int k = 0; k < 3; k++) {
+          const uint32_t index = shortIndices ? static_cast<const uint16_t*>(geometry.indices)[t * 3 + k]
+                                              : static_cast<const uint32_t*>(geometry.indices)[t * 3 + k];
+          if (index < geometry.vertexCount) memcpy(&corners[k], vertices + index * geometry.vertexStride, sizeof(packed3));
+          else corners[k] = {0.0f, 0.0f, 0.0f};
+        }
+      }
+    }, threads);
+  }
+}
+
+Aabb Renderer::Host::BvhBuilder::bounds(const std::vector<BvhGeometry>& geometries) {
+  Aabb result;
+  for (const BvhGeometry& geometry : geometries) {
+    const uint8_t* vertices = static_cast<const uint8_t*>(geometry.vertices);
+    const bool shortIndices = geometry.indexSize == sizeof(uint16_t);
+    for (size_t k = 0; k < geometry.triangleCount * 3; k++) {
+      const uint32_t index = shortIndices ? static_cast<const uint16_t*>(geometry.indices)[k] : static_cast<const uint32_t*>(geometry.indices)[k];
+      packed3 corner = {0.0f, 0.0f, 0.0f};
+      if (index < geometry.vertexCount) memcpy(&corner, vertices + index * geometry.vertexStride, sizeof(packed3));
+      result.grow(corner);
+    }
+  }
+  return result;
+}
+
+std::vector<BvhGeometry> Renderer::Host::BvhBuilder::geometries(const EXP::MDL::HostMesh& mesh) {
+  std::vector<BvhGeometry> result;
+  for (const EXP::MDL::HostSubmesh& submesh : mesh.submeshes) {
+    BvhGeometry geometry;
+    geometry.vertices = mesh.vertices.data();
+    geometry.vertexCount = mesh.vertices.size();
+    geometry.indices = submesh.indices.data();
+    geometry.triangleCount = submesh.indices.size() / 3;
+    result.push_back(geometry);
+  }
+  return result;
+}
+
+BvhReport Renderer::Host::BvhBuilder::binnedSah(const EXP::MDL::HostMesh& mesh, Bvh& bvh, const BvhSettings& settings) {
+  return binnedSah(geometries(mesh), bvh, settings);
+}
+
+BvhReport Renderer::Host::BvhBuilder::binnedSah(const std::vector<BvhGeometry>& geometries, Bvh& bvh, const BvhSettings& settings) {
+  const auto start = std::chrono::steady_clock::now();
+  gather(geometries, bvh, settings.threads);
+  const uint32_t count = (uint32_t)bvh.triangles.size();
+
+  std::vector<Aabb> boxes(count);
+  std::vector<packed3> centers(count);
+  EXP::THREAD::parallelFor(count, 16384, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const BvhTriangle& triangle = bvh.triangles[i];
+      boxes[i] = Aabb();
+      boxes[i].grow(triangle.v0);
+      boxes[i].grow(triangle.v1);
+      boxes[i].grow(triangle.v2);
+      centers[i] = centroid(boxes[i]);
+    }
+  }, settings.threads);
+
+  BvhReport result;
+  buildBoxes(boxes, centers, bvh, settings);
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  report(bvh, settings, result);
+  return result;
+}
+
+BvhReport Renderer::Host::BvhBuilder::binnedSah(const std::vector<Aabb>& boxes, Bvh& bvh, const BvhSettings& settings) {
+  const auto start = std::chrono::steady_clock::now();
+  bvh.triangles.clear();
+  bvh.geometryFirst.assign(1, 0);
+  bvh.leafOrder = false;
+  std::vector<packed3> centers(boxes.size());
+  for (size_t i = 0; i < boxes.size(); i++) centers[i] = centroid(boxes[i]);
+
+  BvhReport result;
+  buildBoxes(boxes, centers, bvh, settings);
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  report(bvh, settings, result);
+  return result;
+}
+
+void Renderer::Host::BvhBuilder::refit(const std::vector<Aabb>& boxes, Bvh& bvh) {
+  for (size_t i = bvh.nodes.size(); i-- > 0;) {
+    BvhNode& node = bvh.nodes[i];
+    Aabb bounds;
+    if (node.isLeaf()) {
+      for (uint32_t p = node.index; p < node.index + node.count; p++) bounds.grow(boxes[bvh.primitives[p]]);
+    } else {
+      bounds = bvh.nodes[node.index].bounds();
+      bounds.grow(bvh.nodes[node.index + 1].bounds());
+    }
+    node.min = bounds.min;
+    node.max = bounds.max;
+  }
+}
+
+BvhReport Renderer::Host::BvhBuilder::linear(
+  const std::vector<BvhGeometry>& geometries,
+  Bvh& bvh,
+  const BvhSettings& settings,
+  BvhScratch* scratch
+) {
+  const auto start = std::chrono::steady_clock::now();
+  BvhScratch local;
+  BvhScratch& work = scratch ? *scratch : local;
+  gather(geometries, bvh, settings.threads);
+  bvh.spatial = false;
+  const uint32_t count = (uint32_t)bvh.triangles.size();
+  BvhReport result;
+  if (count == 0) {
+    bvh.nodes.clear();
+    bvh.primitives.clear();
+    return result;
+  }
+
+  // Centroids and their bounds, which the codes are quantized in
+  std::vector<Aabb> partial((count + CHUNK - 1) / CHUNK);
+  EXP::THREAD::parallelFor(partial.size(), 1, [&](size_t first, size_t last) {
+    for (size_t b = first; b < last; b++) {
+      for (uint32_t i = (uint32_t)b * CHUNK; i < std::min((uint32_t)b * CHUNK + CHUNK, count); i++) {
+        partial[b].grow(centroid(triangleBounds(bvh.triangles[i])));
+      }
+    }
+  }, settings.threads);
+  Aabb extent;
+  for (const Aabb& block : partial) extent.grow(block);
+  float scale[3];
+  for (int axis = 0; axis < 3; axis++) {
+    const float size = extent.max[axis] - extent.min[axis];
+    scale[axis] = size > 0.0f ? 1.0f / size : 0.0f;
+  }
+
+  const uint32_t bits = settings.mortonBits >= 63 ? 63 : 30;
+  std::vector<uint64_t>& keys = work.keys;
+  keys.resize(count);
+  bvh.primitives.resize(count);
+  EXP::THREAD::parallelFor(count, 16384, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const packed3 center = centroid(triangleBounds(bvh.triangles[i]));
+      const packed3 unit = {
+        (center.x - extent.min.x) * scale[0], (center.y - extent.min.y) * scale[1], (center.z - extent.min.z) * scale[2]
+      };
+      keys[i] = morton(unit, bits);
+      bvh.primitives[i] = (uint32_t)i;
+    }
+  }, settings.threads);
+  radixSort(keys, bvh.primitives, bits, settings.threads, &work);
+
+  bvh.nodes.resize(2 * (size_t)count - 1);
+  if (count == 1) {
+    const Aabb box = triangleBounds(bvh.triangles[0]);
+    bvh.nodes[0] = {box.min, 0, box.max, 1};
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report(bvh, settings, result);
+    return result;
+  }
+
+  // Every internal node on its own: its range of keys, then the split inside it. Children go to
+  // the node's own pair of slots, 2i + 1 and 2i + 2, and each child remembers its slot.
+  const uint32_t internals = count - 1;
+  std::vector<uint32_t>& slots = work.slots;
+  std::vector<uint32_t>& leafSlots = work.leafSlots;
+  slots.resize(internals);
+  leafSlots.resize(count);
+  if (work.arrivalCount < internals) {
+    work.arrivals.reset(new std::atomic<uint32_t>[internals]);
+    work.arrivalCount = internals;
+  }
+  std::atomic<uint32_t>* arrivals = work.arrivals.get();
+  const uint64_t* sorted = keys.data();
+  BvhNode* nodes = bvh.nodes.data();
+  slots[0] = 0;
+  EXP::THREAD::parallelFor(internals, 4096, [&](size_t begin, size_t end) {
+    for (int64_t i = (int64_t)begin; i < (int64_t)end; i++) {
+      const int d = delta(sorted, count, i, i + 1) > delta(sorted, count, i, i - 1) ? 1 : -1;
+      const int minimum = delta(sorted, count, i, i - d);
+      int64_t limit = 2;
+      while (delta(sorted, count, i, i + limit * d) > minimum) limit *= 2;
+      int64_t length = 0;
+      for (int64_t step = limit / 2; step >= 1; step /= 2) {
+        if (delta(sorted, count, i, i + (length + step) * d) > minimum) length += step;
+      }
+      const int64_t j = i + length * d;
+      const int common = delta(sorted, count, i, j);
+      int64_t split = 0, step = length;
+      do {
+        step = (step + 1) / 2;
+        if (delta(sorted, count, i, i + (split + step) * d) > common) split += step;
+      } while (step > 1);
+      const uint32_t gamma = (uint32_t)(i + split * d + std::min(d, 0));
+
+      const uint32_t slot = 2 * (uint32_t)i + 1;
+      if (std::min<int64_t>(i, j) == gamma) leafSlots[gamma] = slot;
+      else slots[gamma] = slot, nodes[slot].index = 2 * gamma + 1, nodes[slot].count = 0;
+      if (std::max<int64_t>(i, j) == gamma + 1) leafSlots[gamma + 1] = slot + 1;
+      else slots[gamma + 1] = slot + 1, nodes[slot + 1].index = 2 * gamma + 3, nodes[slot + 1].count = 0;
+      arrivals[i].store(0, std::memory_order_relaxed);
+    }
+  }, settings.threads);
+  nodes[0].index = 1;
+  nodes[0].count = 0;
+
+  // Leaves in key order, then bottom-up bounds: the second child to reach a parent fills it in
+  // and carries on
+  EXP::THREAD::parallelFor(count, 16384, [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; k++) {
+      const Aabb box = triangleBounds(bvh.triangles[bvh.primitives[k]]);
+      nodes[leafSlots[k]] = {box.min, (uint32_t)k, box.max, 1};
+      uint32_t node = (leafSlots[k] - 1) / 2;
+      while (arrivals[node].fetch_add(1, std::memory_order_acq_rel) == 1) {
+        Aabb bounds = nodes[2 * node + 1].bounds();
+        bounds.grow(nodes[2 * node + 2].bounds());
+        nodes[slots[node]].min = bounds.min;
+        nodes[slots[node]].max = bounds.max;
+        if (node == 0) break;
+        node = (slots[node] - 1) / 2;
+      }
+    }
+  }, settings.threads);
+
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  report(bvh, settings, result);
+  return result;
+}
+
+uint64_t Renderer::Host::BvhBuilder::morton(const packed3& unit, uint32_t bits) {
+  const uint32_t axisBits = bits >= 63 ? 21 : 10;
+  const float cells = (float)(1u << axisBits);
+  auto quantize = [&](float v) { return (uint64_t)std::min(std::max(v * cells, 0.0f), cells - 1.0f); };
+  return spread(quantize(unit.x)) << 2 | spread(quantize(unit.y)) << 1 | spread(quantize(unit.z));
+}
+
+void Renderer::Host::BvhBuilder::radixSort(
+  std::vector<uint64_t>& keys,
+  std::vector<uint32_t>& values,
+  uint32_t bits,
+  unsigned int threads,
+  BvhScratch* scratch
+) {
+  const size_t count = keys.size();
+  const size_t blocks = (count + SORT_BLOCK - 1) / SORT_BLOCK;
+  BvhScratch local;
+  std::vector<uint64_t>& keyScratch = (scratch ? *scratch : local).sortKeys;
+  std::vector<uint32_t>& valueScratch = (scratch ? *scratch : local).sortValues;
+  keyScratch.resize(count);
+  valueScratch.resize(count);
+  std::vector<size_t> offsets(blocks * RADIX);
+  for (uint32_t shift = 0; shift < bits; shift += RADIX_BITS) {
+    // Digit histogram per block
+    EXP::THREAD::parallelFor(blocks, 1, [&](size_t first, size_t last) {
+      for (size_t b = first; b < last; b++) {
+        size_t* histogram = offsets.data() + b * RADIX;
+        std::fill(histogram, histogram + RADIX, 0);
+        for (size_t i = b * SORT_BLOCK; i < std::min(b * SORT_BLOCK + SORT_BLOCK, count); i++) histogram[(keys[i] >> shift) & (RADIX - 1)]++;
+      }
+    }, threads);
+    // Digit major, then block: each block scatters into its own slice of every bucket, which
+    // keeps the pass stable. A pass where every key has the same digit moves nothing.
+    size_t sum = 0;
+    bool uniform = false;
+    for (uint32_t digit = 0; digit < RADIX; digit++) {
+      const size_t before = sum;
+      for (size_t b = 0; b < blocks; b++) {
+        const size_t histogram = offsets[b * RADIX + digit];
+        offsets[b * RADIX + digit] = sum;
+        sum += histogram;
+      }
+      uniform |= sum - before == count;
+    }
+    if (uniform) continue;
+    EXP::THREAD::parallelFor(blocks, 1, [&](size_t first, size_t last) {
+      for (size_t b = first; b < last; b++) {
+        size_t* offset = offsets.data() + b * RADIX;
+        for (size_t i = b * SORT_BLOCK; i < std::min(b * SORT_BLOCK + SORT_BLOCK, count); i++) {
+          const size_t to = offset[(keys[i] >> shift) & (RADIX - 1)]++;
+          keyScratch[to] = keys[i];
+          valueScratch[to] = values[i];
+        }
+      }
+    }, threads);
+    keys.swap(keyScratch);
+    values.swap(valueScratch);
+  }
+}
+
+BvhReport Renderer::Host::BvhBuilder::spatial(const EXP::MDL::HostMesh& mesh, Bvh& bvh, const BvhSettings& settings) {
+  return spatial(geometries(mesh), bvh, settings);
+}
+
+BvhReport Renderer::Host::BvhBuilder::spatial(const std::vector<BvhGeometry>& geometries, Bvh& bvh, const BvhSettings& settings) {
+  const auto start = std::chrono::steady_clock::now();
+  gather(geometries, bvh, settings.threads);
+  const uint32_t count = (uint32_t)bvh.triangles.size();
+  bvh.nodes.clear();
+  bvh.primitives.clear();
+  bvh.spatial = true;
+  BvhReport result;
+  if (count == 0) return result;
+
+  // References: a triangle, or the part of one a spatial split left on one side of its plane
+  std::vector<Aabb> boxes(count);
+  std::vector<packed3> centers(count);
+  std::vector<uint32_t> owners(count);
+  for (uint32_t i = 0; i < count; i++) {
+    boxes[i] = triangleBounds(bvh.triangles[i]);
+    centers[i] = centroid(boxes[i]);
+    owners[i] = i;
+  }
+  const size_t budget = count + (size_t)(std::max(settings.spatialBudget, 0.0f) * count);
+
+  struct Range {
+    Task task;
+    std::vector<uint32_t> references;
+  };
+  Range root = {{0, 0, count, 1, Aabb(), Aabb()}, owners};
+  for (uint32_t i = 0; i < count; i++) {
+    root.task.bounds.grow(boxes[i]);
+    root.task.centroids.grow(centers[i]);
+  }
+  const float rootArea = root.task.bounds.area();
+  bvh.nodes.reserve(2 * count);
+  bvh.primitives.reserve(budget);
+  bvh.nodes.push_back({});
+
+  // Breadth first, so the duplication budget goes to the top levels, where splits pay off the most
+  std::deque<Range> queue;
+  queue.emplace_back(std::move(root));
+  std::vector<Bin> bins;
+  std::vector<SpatialBin> spatialBins;
+  std::vector<uint32_t> scratch;
+  while (!queue.empty()) {
+    Range range = std::move(queue.front());
+    queue.pop_front();
+    const Task& task = range.task;
+    std::vector<uint32_t>& references = range.references;
+    const uint32_t size = (uint32_t)references.size();
+    const Build build = {boxes, centers, references.data(), settings};
+
+    Split split;
+    if (size > 1 && task.depth < MAX_DEPTH) {
+      if (size <= SMALL) split = sweepSplit(build, task);
+      else split = findSplit(build, task, bins, false);
+    }
+    // Spatial splits only where the object split children overlap noticeably, while there is budget
+    SpatialSplit chop;
+    if (size > 1 && task.depth < MAX_DEPTH && boxes.size() < budget &&
+        (split.axis < 0 || intersection(split.left, split.right).area() > settings.spatialAlpha * rootArea)) {
+      chop = findSpatialSplit(bvh.triangles, boxes, owners, references, task, settings, spatialBins);
+    }
+    const float cost = std::min(split.cost, chop.cost);
+    const bool fits = size <= settings.maxLeafSize || task.depth >= MAX_DEPTH;
+    if (size <= 1 || (fits && !(cost < settings.intersectionCost * size))) {
+      bvh.nodes[task.node] = {task.bounds.min, (uint32_t)bvh.primitives.size(), task.bounds.max, size};
+      for (uint32_t reference : references) bvh.primitives.push_back(owners[reference]);
+      continue;
+    }
+
+    Range left = {{0, 0, 0, task.depth + 1, Aabb(), Aabb()}, {}};
+    Range right = {{0, 0, 0, task.depth + 1, Aabb(), Aabb()}, {}};
+    if (chop.cost < split.cost) {
+      // References on one side go there. A straddling one stays whole on a side when that is
+      // cheaper than duplicating it, or when the budget has run out.
+      const int axis = chop.axis;
+      for (uint32_t reference : references) {
+        const Aabb box = boxes[reference];
+        bool toLeft = box.max[axis] <= chop.position, toRight = box.min[axis] >= chop.position;
+        if (!toLeft && !toRight) {
+          Aabb grownLeft = chop.left, grownRight = chop.right;
+          grownLeft.grow(box);
+          grownRight.grow(box);
+          const float both = chop.left.area() * chop.leftCount + chop.right.area() * chop.rightCount;
+          const float onlyLeft = grownLeft.area() * chop.leftCount + chop.right.area() * (chop.rightCount - 1.0f);
+          const float onlyRight = chop.left.area() * (chop.leftCount - 1.0f) + grownRight.area() * chop.rightCount;
+          if (std::min(onlyLeft, onlyRight) < both || boxes.size() >= budget) {
+            (onlyLeft <= onlyRight ? toLeft : toRight) = true;
+            if (toLeft) chop.left = grownLeft, chop.rightCount -= chop.rightCount > 0;
+            else chop.right = grownRight, chop.leftCount -= chop.leftCount > 0;
+          }
+        }
+        if (toLeft || toRight) {
+          Range& side = toLeft ? left : right;
+          side.references.push_back(reference);
+          side.task.bounds.grow(box);
+          side.task.centroids.grow(centers[reference]);
+          continue;
+        }
+
+        Aabb leftPart, rightPart;
+        splitReference(bvh.triangles[owners[reference]], box, axis, chop.position, leftPart, rightPart);
+        uint32_t rightReference = reference;
+        if (!leftPart.empty() && !rightPart.empty()) {
+          rightReference = (uint32_t)boxes.size();
+          boxes.push_back(rightPart);
+          centers.push_back(centroid(rightPart));
+          owners.push_back(owners[reference]);
+        }
+        if (!leftPart.empty()) {
+          boxes[reference] = leftPart;
+          centers[reference] = centroid(leftPart);
+          left.references.push_back(reference);
+          left.task.bounds.grow(leftPart);
+          left.task.centroids.grow(centers[reference]);
+        }
+        if (!rightPart.empty()) {
+          if (rightReference == reference) boxes[reference] = rightPart, centers[reference] = centroid(rightPart);
+          right.references.push_back(rightReference);
+          right.task.bounds.grow(rightPart);
+          right.task.centroids.grow(centers[rightReference]);
+        }
+      }
+    } else {
+      Task leftTask, rightTask;
+      if (splitTask(build, task, leftTask, rightTask, bins, scratch, false)) {
+        left.task = leftTask;
+        right.task = rightTask;
+        left.references.assign(references.begin() + leftTask.begin, references.begin() + leftTask.end);
+        right.references.assign(references.begin() + rightTask.begin, references.begin() + rightTask.end);
+      }
+    }
+    if (left.references.empty() || right.references.empty()) {
+      // Nothing separated after all: keep what there is as one leaf
+      bvh.nodes[task.node] = {task.bounds.min, (uint32_t)bvh.primitives.size(), task.bounds.max, size};
+      for (uint32_t reference : references) bvh.primitives.push_back(owners[reference]);
+      continue;
+    }
+
+    left.task.node = (uint32_t)bvh.nodes.size();
+    right.task.node = left.task.node + 1;
+    left.task.begin = right.task.begin = 0;
+    left.task.end = (uint32_t)left.references.size();
+    right.task.end = (uint32_t)right.references.size();
+    bvh.nodes.push_back({});
+    bvh.nodes.push_back({});
+    bvh.nodes[task.node] = {task.bounds.min, left.task.node, task.bounds.max, 0};
+    queue.emplace_back(std::move(left));
+    queue.emplace_back(std::move(right));
+  }
+
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  report(bvh, settings, result);
+  return result;
+}
+
+void Renderer::Host::BvhBuilder::report(const Bvh& bvh, const BvhSettings& settings, BvhReport& report) {
+  report.nodes = bvh.nodes.size();
+  report.references = bvh.primitives.size();
+  report.leaves = 0;
+  report.depth = 0;
+  report.sahCost = bvh.sahCost(settings);
+  if (bvh.nodes.empty()) return;
+  std::vector<std::pair<uint32_t, uint32_t>> stack = {{0, 1}};
+  while (!stack.empty()) {
+    const auto [node, depth] = stack.back();
+    stack.pop_back();
+    report.depth = std::max(report.depth, depth);
+    if (bvh.nodes[node].isLeaf()) report.leaves++;
+    else {
+      stack.push_back({bvh.nodes[node].index, depth + 1});
+      stack.push_back({bvh.nodes[node].index + 1, depth + 1});
+    }
+  }
+}
+
+
+double Renderer::Host::Bvh::sahCost(const BvhSettings& settings) const {
+  if (nodes.empty()) return 0.0;
+  const double root = nodes[0].bounds().area();
+  if (!(root > 0.0)) return 0.0;
+  double cost = 0.0;
+  for (const BvhNode& node : nodes) {
+    const double area = node.bounds().area() / root;
+    cost += area * (node.isLeaf() ? settings.intersectionCost * node.count : settings.traversalCost);
+  }
+  return cost;
+}
+
+bool Renderer::Host::Bvh::validate(std::string* error) const {
+  if (nodes.empty()) return fail(error, "No nodes");
+  if (leafOrder && triangles.size() != primitives.size()) return fail(error, "Leaf order triangles do not match the entries");
+  std::vector<uint8_t> seen(triangleCount(), 0);
+  std::vector<uint32_t> stack = {0};
+  size_t visited = 0;
+  while (!stack.empty()) {
+    const uint32_t index = stack.back();
+    stack.pop_back();
+    if (index >= nodes.size()) return fail(error, "Child out of range: " + std::to_string(index));
+    if (++visited > nodes.size()) return fail(error, "Node reached twice");
+    const BvhNode& node = nodes[index];
+    if (node.isLeaf()) {
+      if ((size_t)node.index + node.count > primitives.size()) return fail(error, "Leaf out of range: " + std::to_string(index));
+      for (uint32_t i = node.index; i < node.index + node.count; i++) {
+        const uint32_t primitive = primitives[i];
+        if (primitive >= seen.size() || (seen[primitive] && !spatial)) {
+          return fail(error, "Triangle twice or unknown: " + std::to_string(primitive));
+        }
+        seen[primitive] = 1;
+        const Aabb box = triangleBounds(triangle(i));
+        // A spatial split leaf only bounds its part of the triangle
+        if (spatial ? intersection(node.bounds(), box).empty() : !node.bounds().contains(box)) {
+          return fail(error, "Leaf does not contain its triangle: " + std::to_string(index));
+        }
+      }
+      continue;
+    }
+    for (uint32_t child = node.index; child < node.index + 2; child++) {
+      if (child >= nodes.size()) return fail(error, "Child out of range: " + std::to_string(child));
+      if (!nodes[child].bounds().empty() && !node.bounds().contains(nodes[child].bounds())) {
+        return fail(error, "Child outside its parent: " + std::to_string(child));
+      }
+      stack.push_back(child);
+    }
+  }
+  for (size_t t = 0; t < seen.size(); t++) {
+    if (!seen[t]) return fail(error, "Triangle in no leaf: " + std::to_string(t));
+  }
+  return true;
+}
+
+
+bool Renderer::Host::Bvh::intersect(const BvhRay& ray, BvhHit& hit, BvhCounters* counters) const {
+  if (nodes.empty() || triangles.empty()) return false;
+  const packed3 o = ray.origin, d = ray.direction;
+  const packed3 inverse = {1.0f / d.x, 1.0f / d.y, 1.0f / d.z};
+  float closest = ray.tmax;
+  uint32_t found = 0xFFFFFFFF;
+  float foundU = 0.0f, foundV = 0.0f;
+
+  // Entry distance of the slab test, INFINITY on a miss
+  auto enter = [&](const BvhNode& node) {
+    float near, far;
+    slab(node, o, inverse, near, far);
+    near = std::max(near, ray.tmin);
+    return near <= std::min(far, closest) ? near : INFINITY;
+  };
+
+  uint32_t stack[MAX_DEPTH * 2];
+  int top = 0;
+  uint32_t index = 0;
+  if (enter(nodes[0]) == INFINITY) return false;
+  while (true) {
+    const BvhNode& node = nodes[index];
+    if (node.isLeaf()) {
+      if (counters) counters->leaves++, counters->triangles += node.count;
+      for (uint32_t i = node.index; i < node.index + node.count; i++) {
+        float t, u, v;
+        if (!triangle(i).intersect(o, d, ray.tmin, closest, t, u, v)) continue;
+        closest = t, found = i, foundU = u, foundV = v;
+      }
+    } else {
+      if (counters) counters->nodes++;
+      // Nearer child first, the other one waits on the stack
+      uint32_t near = node.index, far = node.index + 1;
+      float tNear = enter(nodes[near]), tFar = enter(nodes[far]);
+      if (tFar < tNear) std::swap(near, far), std::swap(tNear, tFar);
+      if (tNear != INFINITY) {
+        if (tFar != INFINITY) stack[top++] = far;
+        index = near;
+        continue;
+      }
+    }
+    // Pop, skipping nodes a closer hit has ruled out since they were pushed
+    do {
+      if (top == 0) {
+        if (found == 0xFFFFFFFF) return false;
+        const uint32_t primitive = primitives[found];
+        hit.t = closest, hit.u = foundU, hit.v = foundV, hit.primitive = primitive, hit.entry = found;
+        hit.geometry = (uint32_t)(std::upper_bound(geometryFirst.begin(), geometryFirst.end(), primitive) - geometryFirst.begin()) - 1;
+        return true;
+      }
+      index = stack[--top];
+    } while (enter(nodes[index]) == INFINITY);
+  }
+}
+
+bool Renderer::Host::Bvh::occluded(const BvhRay& ray, BvhCounters* counters) const {
+  if (nodes.empty() || triangles.empty()) return false;
+  const packed3 o = ray.origin, d = ray.direction;
+  const packed3 inverse = {1.0f / d.x, 1.0f / d.y, 1.0f / d.z};
+
+  // The slab test alone: any hit will do, so children are not ordered
+  auto enters = [&](const BvhNode& node) {
+    float near, far;
+    slab(node, o, inverse, near, far);
+    return std::max(near, ray.tmin) <= std::min(far, ray.tmax);
+  };
+
+  uint32_t stack[MAX_DEPTH * 2];
+  int top = 0;
+  uint32_t index = 0;
+  if (!enters(nodes[0])) return false;
+  while (true) {
+    const BvhNode& node = nodes[index];
+    if (node.isLeaf()) {
+      if (counters) counters->leaves++, counters->triangles += node.count;
+      for (uint32_t i = node.index; i < node.index + node.count; i++) {
+        float t, u, v;
+        if (triangle(i).intersect(o, d, ray.tmin, ray.tmax, t, u, v)) return true;
+      }
+    } else {
+      if (counters) counters->nodes++;
+      const bool first = enters(nodes[node.index]), second = enters(nodes[node.index + 1]);
+      if (first || second) {
+        if (first && second) stack[top++] = node.index + 1;
+        index = first ? node.index : node.index + 1;
+        continue;
+      }
+    }
+    if (top == 0) return false;
+    index = stack[--top];
+  }
+}
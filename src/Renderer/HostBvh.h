@@ -0,0 +1,270 @@
+#pragma once
+#include <Math/Vector.h>
+#include <Model/HostMesh.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * CPU bounding volume hierarchy over the triangles Descriptor::primitive hands to Metal: one
+ * BvhGeometry per submesh, packed XYZ positions at a vertex stride and 32-bit indices.
+ * Triangle ids run across geometries in order, like Metal's geometry / primitive id pair.
+ *
+ * Layout: 32 byte nodes, two per cache line. An interior node's children are adjacent at
+ * `index` and `index + 1`; a leaf covers primitives[index, index + count). Triangles are
+ * gathered once (three packed3 per id) so traversal does not go back to the index buffers.
+ * BvhLayout (HostBvhLayout.h) reorders a built tree for the cache and can gather the triangles
+ * into leaf order, Bvh::triangle reads them either way.
+ *
+ * BvhBuilder::binnedSah splits on the cheapest of `bins` planes per axis by the surface area
+ * heuristic (cost = traversal + intersection * (A_l N_l + A_r N_r) / A), bins bounded by the
+ * centroid extent; all three axes are binned in one pass over the range. Ranges of 16 and
+ * fewer try every centroid plane instead, exactly. Ranges that are cheaper as a leaf, and fit
+ * one, stop there. Degenerate ranges (all centroids equal) are halved.
+ *
+ * The build runs on the thread pool in two phases. Ranges above `taskSize` are split one at a
+ * time, binned and partitioned in blocks across the pool. The ranges below become independent
+ * subtree tasks, biggest first, each built serially into its own node list and then stitched in
+ * behind the top levels. Blocks and subtrees are merged in a fixed order, so the tree is the same
+ * for any thread count.
+ *
+ * BvhBuilder::linear trades quality for speed, for geometry rebuilt every frame (Karras 2012):
+ * centroids become 30 or 63 bit Morton codes in the centroid bounds, a parallel radix sort puts
+ * the triangles in curve order, and each internal node finds its own range and split from the
+ * sorted codes alone, all of them at once. Bounds are filled bottom-up, the second child to
+ * arrive at a parent computes it. Leaves hold one triangle; the layout is the one above, with
+ * internal node i's children at 2i + 1 and 2i + 2.
+ *
+ * BvhBuilder::spatial is an SBVH (Stich et al. 2009) for meshes with long thin triangles, whose
+ * boxes overlap whatever object split is chosen. Where the children of the best object split
+ * overlap, it also bins space itself, chopping triangles at the bin planes, and takes a spatial
+ * split when that is cheaper. Straddling references are duplicated into both children, or kept
+ * whole on one side when that costs less, and duplication stops at `spatialBudget`. Leaves bound
+ * only their part of a triangle, and a triangle may be in several leaves (Bvh::spatial).
+ **/
+
+namespace Renderer {
+namespace Host {
+
+struct Aabb {
+  EXP::MATH::packed3 min = {INFINITY, INFINITY, INFINITY};
+  EXP::MATH::packed3 max = {-INFINITY, -INFINITY, -INFINITY};
+
+  inline void grow(const EXP::MATH::packed3& p) {
+    min = {std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z)};
+    max = {std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z)};
+  }
+  inline void grow(const Aabb& b) {
+    min = {std::min(min.x, b.min.x), std::min(min.y, b.min.y), std::min(min.z, b.min.z)};
+    max = {std::max(max.x, b.max.x), std::max(max.y, b.max.y), std::max(max.z, b.max.z)};
+  }
+  inline bool empty() const { return min.x > max.x; }
+  // Half the surface area: the SAH only needs ratios
+  inline float area() const {
+    if (empty()) return 0.0f;
+    const float x = max.x - min.x, y = max.y - min.y, z = max.z - min.z;
+    return x * y + y * z + z * x;
+  }
+  inline bool contains(const Aabb& b) const {
+    return b.min.x >= min.x && b.min.y >= min.y && b.min.z >= min.z && b.max.x <= max.x && b.max.y <= max.y &&
+           b.max.z <= max.z;
+  }
+};
+
+// One geom_desc of Descriptor::primitive
+struct BvhGeometry {
+  const void* vertices = nullptr; // Packed XYZ floats
+  size_t vertexStride = sizeof(EXP::MATH::packed3);
+  size_t vertexCount = 0;
+  const void* indices = nullptr;
+  size_t triangleCount = 0;
+  size_t indexSize = sizeof(uint32_t); // 2 for the uint16_t indices of the MeshFactory shapes
+};
+
+struct BvhNode {
+  EXP::MATH::packed3 min;
+  uint32_t index; // Left child, or first primitive of a leaf
+  EXP::MATH::packed3 max;
+  uint32_t count; // Primitives in a leaf, 0 for interior nodes
+
+  inline bool isLeaf() const { return count > 0; }
+  inline Aabb bounds() const { return {min, max}; }
+};
+
+struct BvhTriangle {
+  EXP::MATH::packed3 v0, v1, v2;
+
+  // Möller-Trumbore: distance and barycentrics of a hit in [tmin, tmax)
+  inline bool intersect(
+    const EXP::MATH::packed3& o,
+    const EXP::MATH::packed3& d,
+    float tmin,
+    float tmax,
+    float& t,
+    float& u,
+    float& v
+  ) const {
+    const float e1x = v1.x - v0.x, e1y = v1.y - v0.y, e1z = v1.z - v0.z;
+    const float e2x = v2.x - v0.x, e2y = v2.y - v0.y, e2z = v2.z - v0.z;
+    const float px = d.y * e2z - d.z * e2y, py = d.z * e2x - d.x * e2z, pz = d.x * e2y - d.y * e2x;
+    const float determinant = e1x * px + e1y * py + e1z * pz;
+    if (determinant == 0.0f) return false;
+    const float inv = 1.0f / determinant;
+    const float sx = o.x - v0.x, sy = o.y - v0.y, sz = o.z - v0.z;
+    u = (sx * px + sy * py + sz * pz) * inv;
+    if (u < 0.0f || u > 1.0f) return false;
+    const float qx = sy * e1z - sz * e1y, qy = sz * e1x - sx * e1z, qz = sx * e1y - sy * e1x;
+    v = (d.x * qx + d.y * qy + d.z * qz) * inv;
+    if (v < 0.0f || u + v > 1.0f) return false;
+    t = (e2x * qx + e2y * qy + e2z * qz) * inv;
+    return t >= tmin && t < tmax;
+  }
+};
+
+struct BvhRay {
+  EXP::MATH::packed3 origin;
+  float tmin = 0.0f;
+  EXP::MATH::packed3 direction;
+  float tmax = INFINITY;
+};
+
+// Entry and exit distances of the ray through node's box, near > far when it misses; inverse is
+// 1 / direction. An axis the ray runs parallel to (infinite inverse) is decided by the origin alone:
+// on one of the box's planes, the products would be 0 * inf = NaN and skip a box the ray touches
+inline void slab(const BvhNode& node, const EXP::MATH::packed3& o, const EXP::MATH::packed3& inverse, float& near, float& far) {
+  near = -INFINITY, far = INFINITY;
+  for (int axis = 0; axis < 3; axis++) {
+    if (std::isinf(inverse[axis])) {
+      if (o[axis] < node.min[axis] || o[axis] > node.max[axis]) near = INFINITY, far = -INFINITY;
+      continue;
+    }
+    const float t0 = (node.min[axis] - o[axis]) * inverse[axis], t1 = (node.max[axis] - o[axis]) * inverse[axis];
+    near = std::max(near, std::min(t0, t1)), far = std::min(far, std::max(t0, t1));
+  }
+}
+
+struct BvhHit {
+  float t = INFINITY;
+  float u = 0.0f, v = 0.0f;
+  uint32_t primitive = 0xFFFFFFFF; // Triangle id
+  uint32_t geometry = 0xFFFFFFFF;
+  uint32_t instance = 0xFFFFFFFF; // Set by Tlas::intersect
+  uint32_t entry = 0xFFFFFFFF;    // Of the tree's `primitives`: where data in leaf order sits (BvhLayout::gather)
+};
+
+// Work done by traversal, summed over the rays traced with it
+struct BvhCounters {
+  uint64_t nodes = 0;     // Interior nodes visited
+  uint64_t leaves = 0;    // Leaves visited
+  uint64_t triangles = 0; // Triangles tested
+};
+
+struct BvhSettings {
+  uint32_t bins = 32;
+  uint32_t maxLeafSize = 8;
+  float traversalCost = 1.0f;
+  float intersectionCost = 1.0f;
+  uint32_t taskSize = 65536; // Ranges up to this size are built as independent subtrees
+  unsigned int threads = 0;  // Pool threads to use, 0 for all of them
+  uint32_t mortonBits = 30;  // Linear builds: 30 (10 per axis) or 63 (21 per axis)
+  float spatialBudget = 0.3f; // Spatial builds: extra references allowed, as a share of the triangle count
+  float spatialAlpha = 1e-5f; // Spatial builds: try them where object split children overlap by this much of the root area
+};
+
+struct BvhReport {
+  double sahCost = 0.0;
+  size_t nodes = 0;
+  size_t leaves = 0;
+  uint32_t depth = 0;
+  size_t references = 0; // Leaf entries, above the triangle count where spatial splits duplicated some
+  double seconds = 0.0;
+};
+
+static_assert(sizeof(BvhNode) == 32, "Two nodes per cache line");
+static_assert(sizeof(BvhRay) == 32, "Ray must stay packed");
+
+struct Bvh {
+  std::vector<BvhNode> nodes;           // nodes[0] is the root
+  std::vector<uint32_t> primitives;     // Triangle ids in leaf order
+  std::vector<BvhTriangle> triangles;   // By triangle id, or with leafOrder by entry of `primitives`
+  std::vector<uint32_t> geometryFirst;  // Geometry g holds ids [geometryFirst[g], geometryFirst[g + 1])
+  bool spatial = false;                 // Triangles may sit in several leaves, each bounding only its part
+  bool leafOrder = false;               // BvhLayout gathered the triangles into leaf order
+
+  inline size_t triangleCount() const { return leafOrder ? geometryFirst.back() : triangles.size(); }
+  // Of entry i of `primitives`
+  inline const BvhTriangle& triangle(uint32_t i) const { return leafOrder ? triangles[i] : triangles[primitives[i]]; }
+  inline Aabb bounds() const { return nodes.empty() ? Aabb() : nodes[0].bounds(); }
+  inline size_t bytes() const {
+    return nodes.size() * sizeof(BvhNode) + primitives.size() * sizeof(uint32_t) +
+           triangles.size() * sizeof(BvhTriangle);
+  }
+
+  // Closest hit in [ray.tmin, ray.tmax]
+  bool intersect(const BvhRay& ray, BvhHit& hit, BvhCounters* counters = nullptr) const;
+  // Whether any triangle is hit in [ray.tmin, ray.tmax): stops at the first, in no particular order
+  bool occluded(const BvhRay& ray, BvhCounters* counters = nullptr) const;
+  // Traversal + intersection cost by the SAH, relative to the root area
+  double sahCost(const BvhSettings& settings = {}) const;
+  // Every triangle in exactly one leaf, children inside their parent, leaves around their triangles
+  bool validate(std::string* error = nullptr) const;
+};
+
+// Working memory of BvhBuilder::linear, kept between builds so per-frame rebuilds do not allocate
+struct BvhScratch {
+  std::vector<uint64_t> keys, sortKeys;
+  std::vector<uint32_t> sortValues;
+  std::vector<uint32_t> slots, leafSlots; // Where each internal node and leaf went
+  std::unique_ptr<std::atomic<uint32_t>[]> arrivals;
+  size_t arrivalCount = 0;
+};
+
+class BvhBuilder {
+public:
+  BvhBuilder(){};
+  ~BvhBuilder(){};
+
+public:
+  // Gathers the triangles, then builds; one geometry per submesh
+  static BvhReport binnedSah(const std::vector<BvhGeometry>& geometries, Bvh& bvh, const BvhSettings& settings = {});
+  static BvhReport binnedSah(const EXP::MDL::HostMesh& mesh, Bvh& bvh, const BvhSettings& settings = {});
+  // Over boxes alone (instances, say): primitives are box indices, there are no triangles
+  static BvhReport binnedSah(const std::vector<Aabb>& boxes, Bvh& bvh, const BvhSettings& settings = {});
+  // New boxes for the same primitives, tree kept: one backward pass, as children follow their parents
+  static void refit(const std::vector<Aabb>& boxes, Bvh& bvh);
+  // Object or spatial split per node, whichever is cheaper: better trees for long thin triangles
+  static BvhReport spatial(const std::vector<BvhGeometry>& geometries, Bvh& bvh, const BvhSettings& settings = {});
+  static BvhReport spatial(const EXP::MDL::HostMesh& mesh, Bvh& bvh, const BvhSettings& settings = {});
+  // Morton order, one triangle per leaf: fast rather than good
+  static BvhReport linear(
+    const std::vector<BvhGeometry>& geometries,
+    Bvh& bvh,
+    const BvhSettings& settings = {},
+    BvhScratch* scratch = nullptr
+  );
+
+public: // Stages
+  static void gather(const std::vector<BvhGeometry>& geometries, Bvh& bvh, unsigned int threads = 0);
+  static std::vector<BvhGeometry> geometries(const EXP::MDL::HostMesh& mesh);
+  // Box of the triangles gather would make, the root box of any tree over them, without a build
+  static Aabb bounds(const std::vector<BvhGeometry>& geometries);
+  static void report(const Bvh& bvh, const BvhSettings& settings, BvhReport& report);
+  // Interleaved bits of a point in [0, 1]^3, x highest: 10 per axis for 30 bits, 21 for 63
+  static uint64_t morton(const EXP::MATH::packed3& unit, uint32_t bits);
+  // Stable LSD radix sort of keys below 2^bits, values moved alongside
+  static void radixSort(
+    std::vector<uint64_t>& keys,
+    std::vector<uint32_t>& values,
+    uint32_t bits,
+    unsigned int threads = 0,
+    BvhScratch* scratch = nullptr
+  );
+};
+
+}; // namespace Host
+}; // namespace Renderer
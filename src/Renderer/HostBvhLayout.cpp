@@ -0,0 +1,133 @@
+#include <Renderer/HostBvhLayout.h>
+#include <algorithm>
+
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhNode;
+using Renderer::Host::BvhTriangle;
+using Renderer::Host::LayoutSettings;
+using Renderer::Host::NodeOrder;
+using Renderer::Host::PrimitiveAttributes;
+
+
+namespace {
+
+// A block of the layout: the root alone, or a sibling pair starting at `first`
+inline uint32_t members(uint32_t first) { return first == 0 ? 1 : 2; }
+
+// The pairs below a block's members, hot child's first
+void below(const std::vector<BvhNode>& nodes, uint32_t first, std::vector<uint32_t>& out) {
+  if (members(first) == 1) {
+    if (!nodes[0].isLeaf()) out.push_back(nodes[0].index);
+    return;
+  }
+  uint32_t hot = first, cold = first + 1;
+  if (nodes[cold].bounds().area() > nodes[hot].bounds().area()) std::swap(hot, cold);
+  if (!nodes[hot].isLeaf()) out.push_back(nodes[hot].index);
+  if (!nodes[cold].isLeaf()) out.push_back(nodes[cold].index);
+}
+
+void emit(uint32_t first, std::vector<uint32_t>& order) {
+  order.push_back(first);
+  if (members(first) == 2) order.push_back(first + 1);
+}
+
+void depthFirst(const std::vector<BvhNode>& nodes, std::vector<uint32_t>& order) {
+  std::vector<uint32_t> stack = {0}, children;
+  while (!stack.empty()) {
+    const uint32_t first = stack.back();
+    stack.pop_back();
+    emit(first, order);
+    children.clear();
+    below(nodes, first, children);
+    // Hot on top, so its pair comes next
+    for (size_t i = children.size(); i-- > 0;) stack.push_back(children[i]);
+  }
+}
+
+struct VanEmdeBoas {
+  const std::vector<BvhNode>& nodes;
+  std::vector<uint32_t>& order;
+
+  // The top `levels` block levels below `first`
+  void place(uint32_t first, uint32_t levels) {
+    if (levels <= 1) return emit(first, order);
+    const uint32_t top = levels / 2;
+    place(first, top);
+    // The blocks `top` levels down root the bottom subtrees, hot first
+    std::vector<uint32_t> frontier = {first}, next;
+    for (uint32_t level = 0; level < top; level++) {
+      next.clear();
+      for (uint32_t block : frontier) below(nodes, block, next);
+      frontier.swap(next);
+    }
+    for (uint32_t block : frontier) place(block, levels - top);
+  }
+};
+
+} // namespace
+
+
+void Renderer::Host::BvhLayout::reorder(Bvh& bvh, const LayoutSettings& settings) {
+  const std::vector<BvhNode>& nodes = bvh.nodes;
+  if (nodes.empty()) return;
+
+  // Old index of each new node
+  std::vector<uint32_t> order;
+  order.reserve(nodes.size());
+  if (settings.order == NodeOrder::DEPTH_FIRST) depthFirst(nodes, order);
+  else if (settings.order == NodeOrder::VAN_EMDE_BOAS) {
+    // Height in blocks, children before parents: linear builds put some children ahead of theirs
+    std::vector<uint32_t> height(nodes.size(), 0), parents;
+    parents.reserve(nodes.size() / 2);
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty()) {
+      const uint32_t index = stack.back();
+      stack.pop_back();
+      if (nodes[index].isLeaf()) continue;
+      parents.push_back(index);
+      stack.push_back(nodes[index].index), stack.push_back(nodes[index].index + 1);
+    }
+    for (size_t i = parents.size(); i-- > 0;) {
+      const BvhNode& node = nodes[parents[i]];
+      height[parents[i]] = 1 + std::max(height[node.index], height[node.index + 1]);
+    }
+    VanEmdeBoas{nodes, order}.place(0, 1 + height[0]);
+  } else {
+    for (uint32_t i = 0; i < nodes.size(); i++) order.push_back(i);
+  }
+
+  std::vector<uint32_t> moved(nodes.size());
+  for (uint32_t i = 0; i < order.size(); i++) moved[order[i]] = i;
+  // Old entry of each new one, leaves taken in their new order
+  std::vector<uint32_t> entries;
+  entries.reserve(bvh.primitives.size());
+  std::vector<BvhNode> result(nodes.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    BvhNode node = nodes[order[i]];
+    if (node.isLeaf()) {
+      const uint32_t first = (uint32_t)entries.size();
+      for (uint32_t e = node.index; e < node.index + node.count; e++) entries.push_back(e);
+      node.index = first;
+    } else node.index = moved[node.index];
+    result[i] = node;
+  }
+  bvh.nodes.swap(result);
+
+  std::vector<uint32_t> primitives(entries.size());
+  for (size_t i = 0; i < entries.size(); i++) primitives[i] = bvh.primitives[entries[i]];
+  if (bvh.leafOrder) {
+    std::vector<BvhTriangle> triangles(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) triangles[i] = bvh.triangles[entries[i]];
+    bvh.triangles.swap(triangles);
+  } else if (settings.triangles && !bvh.triangles.empty()) {
+    std::vector<BvhTriangle> triangles(primitives.size());
+    for (size_t i = 0; i < primitives.size(); i++) triangles[i] = bvh.triangles[primitives[i]];
+    bvh.triangles.swap(triangles);
+    bvh.leafOrder = true;
+  }
+  bvh.primitives.swap(primitives);
+}
+
+void Renderer::Host::BvhLayout::gather(const Bvh& bvh, const PrimitiveAttributes* byId, PrimitiveAttributes* out) {
+  for (size_t i = 0; i < bvh.primitives.size(); i++) out[i] = byId[bvh.primitives[i]];
+}
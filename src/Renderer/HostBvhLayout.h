@@ -0,0 +1,49 @@
+#pragma once
+#include <Renderer/HostBvh.h>
+#include <Renderer/HostTypes.h>
+#include <cstdint>
+
+/**
+ * Memory layout of a built Bvh, for cache behaviour rather than correctness. The builders leave
+ * nodes in the order they were made: recursion order for the SAH builders, one internal level after
+ * the other for the linear one. Traversal then jumps across the node array at every level.
+ *
+ * BvhLayout::reorder moves the sibling pairs (children stay adjacent, after their parent):
+ * - DEPTH_FIRST: the pair below the hot child, the one with the larger surface area and so the more
+ *   likely to be entered, follows its parent's pair directly; the cold child's subtree comes after.
+ * - VAN_EMDE_BOAS: the pair tree is cut at half its height, the top half laid out first and then
+ *   each bottom subtree, recursively (hot child first), so a path down the tree crosses few blocks
+ *   of any size: cache lines and pages alike.
+ *
+ * The primitive entries are rewritten in the new leaf order. With `triangles` the triangles are
+ * gathered into that order as well (Bvh::leafOrder): a leaf's triangles are one contiguous run, and
+ * traversal no longer loads the triangle id before the triangle. BvhLayout::gather puts per triangle
+ * data, PrimitiveAttributes say, in the same order, read at BvhHit::entry: shading a hit touches
+ * the entry next to those of its neighbours. Triangle and geometry ids in hits are unchanged.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+enum struct NodeOrder { BUILD = 0, DEPTH_FIRST = 1, VAN_EMDE_BOAS = 2 };
+
+struct LayoutSettings {
+  NodeOrder order = NodeOrder::DEPTH_FIRST;
+  bool triangles = true; // Gather the triangles into leaf order
+};
+
+class BvhLayout {
+public:
+  BvhLayout(){};
+  ~BvhLayout(){};
+
+public:
+  // Hits, SAH cost and the tree itself are unchanged; node and entry indices are not
+  static void reorder(Bvh& bvh, const LayoutSettings& settings = {});
+  // out[i] = byId[bvh.primitives[i]] for every entry: `byId` holds the submeshes one after the
+  // other, geometry g from geometryFirst[g], and `out` bvh.primitives.size() entries
+  static void gather(const Bvh& bvh, const PrimitiveAttributes* byId, PrimitiveAttributes* out);
+};
+
+}; // namespace Host
+}; // namespace Renderer
@@ -0,0 +1,211 @@
+#include <Renderer/HostBvhQuality.h>
+#include <Renderer/HostWideBvh.h>
+#include <Thread/Pool.h>
+#include <algorithm>
+#include <cmath>
+
+using EXP::MATH::float3;
+using EXP::MATH::packed3;
+using Renderer::Host::Aabb;
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhCounters;
+using Renderer::Host::BvhQuality;
+using Renderer::Host::BvhSettings;
+using Renderer::Host::BvhTriangle;
+using Renderer::Host::HeatmapSettings;
+using Renderer::Host::Image;
+using Renderer::Host::PixelFormat;
+using Renderer::Host::VCamera;
+
+
+namespace {
+
+constexpr size_t TRIANGLE_GRAIN = 256;
+constexpr size_t ROW_GRAIN = 4;
+constexpr int MAX_POLYGON = 9; // A triangle clipped by six planes
+
+// Keeps the part of the polygon where sign * (p[axis] - plane) >= 0
+int clip(const float3* in, int count, float3* out, int axis, float plane, float sign) {
+  int result = 0;
+  for (int i = 0; i < count; i++) {
+    const float3& a = in[i];
+    const float3& b = in[(i + 1) % count];
+    const float da = sign * (a[axis] - plane), db = sign * (b[axis] - plane);
+    if (da >= 0.0f) out[result++] = a;
+    if ((da >= 0.0f) != (db >= 0.0f)) {
+      float3 p = a + (b - a) * (da / (da - db));
+      p[axis] = plane;
+      out[result++] = p;
+    }
+  }
+  return result;
+}
+
+inline bool overlaps(const Aabb& a, const Aabb& b) {
+  return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y && a.min.z <= b.max.z &&
+         b.min.z <= a.max.z;
+}
+
+inline float triangleArea(const BvhTriangle& t) {
+  return 0.5f * EXP::MATH::length(EXP::MATH::cross(EXP::MATH::f3(t.v1) - EXP::MATH::f3(t.v0), EXP::MATH::f3(t.v2) - EXP::MATH::f3(t.v0)));
+}
+
+// Blue, green, yellow, red over [0, 1]
+inline void heat(float t, uint8_t* pixel) {
+  static const float stops[4][3] = {{0.0f, 0.0f, 255.0f}, {0.0f, 255.0f, 0.0f}, {255.0f, 255.0f, 0.0f}, {255.0f, 0.0f, 0.0f}};
+  t = std::min(std::max(t, 0.0f), 1.0f) * 3.0f;
+  const int i = std::min((int)t, 2);
+  const float f = t - i;
+  for (int c = 0; c < 3; c++) pixel[c] = (uint8_t)std::lround(stops[i][c] + (stops[i + 1][c] - stops[i][c]) * f);
+  pixel[3] = 255;
+}
+
+} // namespace
+
+
+float Renderer::Host::BvhAnalyzer::clippedArea(const BvhTriangle& triangle, const Aabb& box) {
+  float3 a[MAX_POLYGON], b[MAX_POLYGON];
+  a[0] = EXP::MATH::f3(triangle.v0), a[1] = EXP::MATH::f3(triangle.v1), a[2] = EXP::MATH::f3(triangle.v2);
+  int count = 3;
+  for (int axis = 0; axis < 3 && count > 0; axis++) {
+    count = clip(a, count, b, axis, box.min[axis], 1.0f);
+    count = clip(b, count, a, axis, box.max[axis], -1.0f);
+  }
+  if (count < 3) return 0.0f;
+  float3 sum = {0.0f, 0.0f, 0.0f};
+  for (int i = 1; i + 1 < count; i++) sum += EXP::MATH::cross(a[i] - a[0], a[i + 1] - a[0]);
+  return 0.5f * EXP::MATH::length(sum);
+}
+
+double Renderer::Host::BvhAnalyzer::epo(const Bvh& bvh, const BvhSettings& settings) {
+  if (bvh.nodes.empty() || bvh.triangles.empty()) return 0.0;
+
+  // Leaves numbered depth first, so every subtree holds a range of them: sizes children first, then
+  // ranges parents first. Linear builds put some children ahead of their parents, so not by index
+  std::vector<uint32_t> leaves(bvh.nodes.size(), 1), ranges(bvh.nodes.size(), 0), parents = {0};
+  for (size_t k = 0; k < parents.size(); k++) {
+    const Renderer::Host::BvhNode& node = bvh.nodes[parents[k]];
+    if (node.isLeaf()) continue;
+    parents.push_back(node.index), parents.push_back(node.index + 1);
+  }
+  for (size_t k = parents.size(); k-- > 0;) {
+    const Renderer::Host::BvhNode& node = bvh.nodes[parents[k]];
+    if (!node.isLeaf()) leaves[parents[k]] = leaves[node.index] + leaves[node.index + 1];
+  }
+  for (uint32_t i : parents) {
+    const Renderer::Host::BvhNode& node = bvh.nodes[i];
+    if (!node.isLeaf()) ranges[node.index] = ranges[i], ranges[node.index + 1] = ranges[i] + leaves[node.index];
+  }
+  // By triangle id, also when BvhLayout put them in leaf order
+  const size_t count = bvh.triangleCount();
+  std::vector<BvhTriangle> byId;
+  if (bvh.leafOrder) {
+    byId.resize(count);
+    for (size_t i = 0; i < bvh.primitives.size(); i++) byId[bvh.primitives[i]] = bvh.triangles[i];
+  }
+  const BvhTriangle* triangles = bvh.leafOrder ? byId.data() : bvh.triangles.data();
+  // The leaves each triangle is in; several for spatial splits
+  std::vector<uint32_t> first(count + 1, 0), positions(bvh.primitives.size());
+  for (uint32_t primitive : bvh.primitives) first[primitive + 1]++;
+  for (size_t t = 0; t < count; t++) first[t + 1] += first[t];
+  std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+  for (size_t i = 0; i < bvh.nodes.size(); i++) {
+    const Renderer::Host::BvhNode& node = bvh.nodes[i];
+    if (!node.isLeaf()) continue;
+    for (uint32_t p = node.index; p < node.index + node.count; p++) positions[fill[bvh.primitives[p]]++] = ranges[i];
+  }
+
+  // Per triangle, in any order; summed in triangle order so the result does not depend on threads
+  std::vector<double> overlap(count, 0.0), area(count, 0.0);
+  EXP::THREAD::parallelFor(count, TRIANGLE_GRAIN, [&](size_t begin, size_t end) {
+    std::vector<uint32_t> stack;
+    for (size_t t = begin; t < end; t++) {
+      const BvhTriangle& triangle = triangles[t];
+      area[t] = triangleArea(triangle);
+      Aabb box;
+      box.grow(triangle.v0), box.grow(triangle.v1), box.grow(triangle.v2);
+      stack.assign(1, 0);
+      while (!stack.empty()) {
+        const uint32_t index = stack.back();
+        stack.pop_back();
+        const Renderer::Host::BvhNode& node = bvh.nodes[index];
+        if (!overlaps(node.bounds(), box)) continue;
+        bool inside = false;
+        for (uint32_t k = first[t]; k < first[t + 1] && !inside; k++) {
+          inside = positions[k] >= ranges[index] && positions[k] < ranges[index] + leaves[index];
+        }
+        if (!inside) {
+          // Children lie inside their parent: no surface here, none below
+          const float part = clippedArea(triangle, node.bounds());
+          if (part <= 0.0f) continue;
+          overlap[t] += part * (node.isLeaf() ? settings.intersectionCost * node.count : settings.traversalCost);
+        }
+        if (!node.isLeaf()) stack.push_back(node.index), stack.push_back(node.index + 1);
+      }
+    }
+  }, settings.threads);
+
+  double total = 0.0, surface = 0.0;
+  for (size_t t = 0; t < overlap.size(); t++) total += overlap[t], surface += area[t];
+  return surface > 0.0 ? total / surface : 0.0;
+}
+
+BvhQuality Renderer::Host::BvhAnalyzer::analyze(const Bvh& bvh, const BvhSettings& settings) {
+  BvhQuality quality;
+  quality.sahCost = bvh.sahCost(settings);
+  quality.epo = epo(bvh, settings);
+  quality.nodes = bvh.nodes.size();
+  quality.references = bvh.primitives.size();
+  quality.bytes = bvh.bytes();
+  if (bvh.nodes.empty()) return quality;
+  std::vector<std::pair<uint32_t, uint32_t>> stack = {{0, 1}};
+  double depths = 0.0;
+  while (!stack.empty()) {
+    const auto [index, depth] = stack.back();
+    stack.pop_back();
+    const Renderer::Host::BvhNode& node = bvh.nodes[index];
+    quality.depth = std::max(quality.depth, depth);
+    if (node.isLeaf()) {
+      quality.leaves++;
+      depths += depth;
+      if (quality.leafSizes.size() <= node.count) quality.leafSizes.resize(node.count + 1, 0);
+      quality.leafSizes[node.count]++;
+    } else {
+      stack.push_back({node.index, depth + 1});
+      stack.push_back({node.index + 1, depth + 1});
+    }
+  }
+  quality.leafDepth = depths / quality.leaves;
+  return quality;
+}
+
+template <typename Tree>
+BvhCounters Renderer::Host::BvhAnalyzer::heatmap(const Tree& tree, const VCamera& camera, Image& image, const HeatmapSettings& settings) {
+  const uint32_t width = (uint32_t)camera.resolution.x, height = (uint32_t)camera.resolution.y;
+  if (width == 0 || height == 0) return {};
+  std::vector<float> counts((size_t)width * height, 0.0f);
+  std::vector<BvhCounters> rows(height);
+  EXP::THREAD::parallelFor(height, ROW_GRAIN, [&](size_t begin, size_t end) {
+    for (size_t y = begin; y < end; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        BvhCounters counters;
+        Renderer::Host::BvhHit hit;
+        tree.intersect(primaryRay(camera, x, (uint32_t)y), hit, &counters);
+        counts[y * width + x] = (float)(settings.triangles ? counters.triangles : counters.nodes + counters.leaves);
+        rows[y].nodes += counters.nodes, rows[y].leaves += counters.leaves, rows[y].triangles += counters.triangles;
+      }
+    }
+  });
+
+  BvhCounters total;
+  for (const BvhCounters& row : rows) total.nodes += row.nodes, total.leaves += row.leaves, total.triangles += row.triangles;
+  float scale = settings.scale;
+  if (!(scale > 0.0f)) scale = std::max(1.0f, *std::max_element(counts.begin(), counts.end()));
+  image.allocate(width, height, PixelFormat::RGBA8_UNORM);
+  for (size_t i = 0; i < counts.size(); i++) heat(counts[i] / scale, image.data.data() + i * 4);
+  return total;
+}
+
+template BvhCounters Renderer::Host::BvhAnalyzer::heatmap(const Bvh&, const VCamera&, Image&, const HeatmapSettings&);
+template BvhCounters Renderer::Host::BvhAnalyzer::heatmap(const Renderer::Host::Bvh4&, const VCamera&, Image&, const HeatmapSettings&);
+template BvhCounters Renderer::Host::BvhAnalyzer::heatmap(const Renderer::Host::Bvh8&, const VCamera&, Image&, const HeatmapSettings&);
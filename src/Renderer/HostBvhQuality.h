@@ -0,0 +1,58 @@
+#pragma once
+#include <Renderer/HostBvh.h>
+#include <Renderer/HostCamera.h>
+#include <Renderer/HostImage.h>
+#include <cstdint>
+#include <vector>
+
+/**
+ * How good a CPU BVH is, in numbers and pictures, to compare builders and catch regressions.
+ *
+ * Besides the SAH cost, BvhQuality has the end-point overlap (EPO, Aila et al. 2013): the surface
+ * of every triangle that lies inside a node without being in that node's subtree, weighted by the
+ * node's cost and relative to the total triangle surface. A ray reaching such a surface has to
+ * visit the node for nothing; where the SAH only sees boxes, EPO sees the triangles inside them.
+ * Each triangle goes down the tree through the nodes its box overlaps and is clipped to their
+ * boxes, the triangles spread over the pool.
+ *
+ * Heatmaps trace one primary ray per pixel of a VCamera and color it by the traversal steps (nodes
+ * and leaves visited) or triangles tested, from blue through green and yellow to red at `scale`.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+struct BvhQuality {
+  double sahCost = 0.0;
+  double epo = 0.0;
+  size_t nodes = 0;
+  size_t leaves = 0;
+  size_t references = 0;
+  uint32_t depth = 0;
+  double leafDepth = 0.0;        // Mean over the leaves
+  size_t bytes = 0;
+  std::vector<size_t> leafSizes; // leafSizes[n]: leaves holding n references
+};
+
+struct HeatmapSettings {
+  bool triangles = false; // Color by triangles tested rather than traversal steps
+  float scale = 0.0f;     // Count shown red, 0 for the largest in the image; fix it to compare images
+};
+
+class BvhAnalyzer {
+public:
+  BvhAnalyzer(){};
+  ~BvhAnalyzer(){};
+
+public:
+  static BvhQuality analyze(const Bvh& bvh, const BvhSettings& settings = {});
+  static double epo(const Bvh& bvh, const BvhSettings& settings = {});
+  // Counts summed over all pixels; `image` is camera.resolution in RGBA8_UNORM. Bvh, Bvh4 or Bvh8
+  template <typename Tree>
+  static BvhCounters heatmap(const Tree& tree, const VCamera& camera, Image& image, const HeatmapSettings& settings = {});
+  // Area of the part of a triangle inside a box
+  static float clippedArea(const BvhTriangle& triangle, const Aabb& box);
+};
+
+}; // namespace Host
+}; // namespace Renderer
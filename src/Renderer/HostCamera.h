@@ -0,0 +1,66 @@
+#pragma once
+#include <Renderer/HostBvh.h>
+#include <Renderer/HostTypes.h>
+#include <cmath>
+#include <cstdint>
+
+/**
+ * The ray tracing camera without Metal: EXP::VCamera's default view, and the rays build_ray in
+ * RayUtils.h makes from it. The view is orthographic, all rays along vecForward, starting 5 units
+ * behind the view plane at pixel (x, y); fovScale is its half height.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+// v turned by `angle` about the unit `axis`, as simd_act with simd::quatf(angle, axis)
+inline EXP::MATH::float3 rotate(const EXP::MATH::float3& v, const EXP::MATH::float3& axis, float angle) {
+  const float c = std::cos(angle), s = std::sin(angle);
+  return v * c + EXP::MATH::cross(axis, v) * s + axis * (EXP::MATH::dot(axis, v) * (1.0f - c));
+}
+
+// EXP::VCamera after setIsometric, at `width` x `height`
+inline VCamera isometricCamera(uint32_t width, uint32_t height) {
+  const float RAD_45 = 45.0f * (float)M_PI / 180.0f;
+  const EXP::MATH::float3 up = {0.0f, 1.0f, 0.0f};
+  EXP::MATH::float3 forward = {0.0f, 0.0f, -1.0f}, origin = {0.0f, 0.0f, 3.0f};
+  const EXP::MATH::float3 right = EXP::MATH::cross(forward, up);
+  forward = rotate(rotate(forward, up, -RAD_45), right, -RAD_45);
+  origin = rotate(rotate(origin, up, -RAD_45), right, -RAD_45);
+  VCamera camera;
+  camera.vecOrigin = EXP::MATH::p3(origin);
+  camera.resolution = {(float)width, (float)height, 1.0f};
+  camera.vecRight = EXP::MATH::p3(EXP::MATH::cross(forward, up));
+  camera.vecUp = EXP::MATH::p3(up);
+  camera.vecForward = EXP::MATH::p3(forward);
+  camera.fovScale = std::tan(RAD_45 * 0.5f);
+  return camera;
+}
+
+// The same direction, moved and scaled so that `bounds` fills the view and every ray starts in front of it
+inline VCamera frameCamera(VCamera camera, const Aabb& bounds) {
+  if (bounds.empty()) return camera;
+  const EXP::MATH::float3 center = (EXP::MATH::f3(bounds.min) + EXP::MATH::f3(bounds.max)) * 0.5f;
+  const float radius = EXP::MATH::length(EXP::MATH::f3(bounds.max) - center);
+  const EXP::MATH::float3 forward = EXP::MATH::normalize(EXP::MATH::f3(camera.vecForward));
+  // build_ray starts 5 units behind vecOrigin, keep a unit clear of the bounds
+  camera.vecOrigin = EXP::MATH::p3(center + forward * (4.0f - radius));
+  camera.fovScale = radius;
+  return camera;
+}
+
+inline BvhRay primaryRay(const VCamera& camera, uint32_t x, uint32_t y) {
+  const float u = (float)x / camera.resolution.x * 2.0f - 1.0f, v = -((float)y / camera.resolution.y * 2.0f - 1.0f);
+  const float aspectRatio = camera.resolution.x / camera.resolution.y;
+  const EXP::MATH::float3 right = EXP::MATH::f3(camera.vecRight), up = EXP::MATH::f3(camera.vecUp), forward = EXP::MATH::f3(camera.vecForward);
+  BvhRay ray;
+  ray.origin = EXP::MATH::p3(
+    EXP::MATH::f3(camera.vecOrigin) + right * (u * camera.fovScale * aspectRatio) + up * (v * camera.fovScale) - forward * 5.0f
+  );
+  ray.direction = EXP::MATH::p3(EXP::MATH::normalize(forward));
+  ray.tmin = 0.1f;
+  return ray;
+}
+
+}; // namespace Host
+}; // namespace Renderer
@@ -0,0 +1,140 @@
+#include <Renderer/HostCompact.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using EXP::MATH::float2;
+using EXP::MATH::float3;
+using EXP::MATH::float4;
+
+namespace {
+
+inline float signNotZero(float value) { return value < 0.0f ? -1.0f : 1.0f; }
+
+inline int8_t snorm8(float value) { return (int8_t)std::lround(std::clamp(value, -1.0f, 1.0f) * 127.0f); }
+
+inline uint16_t pack(int8_t x, int8_t y) { return (uint16_t)((uint8_t)x | ((uint8_t)y << 8)); }
+
+inline float3 octDecode(float x, float y) {
+  float3 n = {x, y, 1.0f - std::fabs(x) - std::fabs(y)};
+  if (n.z < 0.0f) {
+    n.x = (1.0f - std::fabs(y)) * signNotZero(x);
+    n.y = (1.0f - std::fabs(x)) * signNotZero(y);
+  }
+  return EXP::MATH::normalize(n);
+}
+
+inline uint16_t unorm16(float value, float minimum, float extent) {
+  if (extent <= 0.0f) return 0;
+  return (uint16_t)std::lround(std::clamp((value - minimum) / extent, 0.0f, 1.0f) * 65535.0f);
+}
+
+struct ColorKey {
+  float4 value;
+  inline bool operator==(const ColorKey& other) const { return memcmp(&value, &other.value, sizeof(value)) == 0; }
+};
+
+struct ColorHash {
+  inline size_t operator()(const ColorKey& key) const {
+    uint32_t bits[4];
+    memcpy(bits, &key.value, sizeof(bits));
+    uint64_t h = 1469598103934665603ull;
+    for (uint32_t word : bits) h = (h ^ word) * 1099511628211ull;
+    return (size_t)h;
+  }
+};
+
+inline bool sameColor(const float4& a, const float4& b) { return memcmp(&a, &b, sizeof(float4)) == 0; }
+
+}; // namespace
+
+
+uint16_t Renderer::Host::Compact::encodeNormal(const float3& normal) {
+  const float3 n = EXP::MATH::normalize(normal);
+  const float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+  if (!(l1 > 0.0f)) return pack(0, 0); // Zero or NaN normals normalize to NaN
+  float x = n.x / l1, y = n.y / l1;
+  if (n.z < 0.0f) {
+    const float wrappedX = (1.0f - std::fabs(y)) * signNotZero(x);
+    y = (1.0f - std::fabs(x)) * signNotZero(y);
+    x = wrappedX;
+  }
+
+  // Rounding each axis on its own is not the closest direction; try the four grid neighbours
+  const float fx = std::floor(std::clamp(x, -1.0f, 1.0f) * 127.0f) / 127.0f;
+  const float fy = std::floor(std::clamp(y, -1.0f, 1.0f) * 127.0f) / 127.0f;
+  uint16_t best = pack(snorm8(x), snorm8(y));
+  float bestDot = EXP::MATH::dot(decodeNormal(best), n);
+  for (int corner = 0; corner < 4; corner++) {
+    const uint16_t candidate = pack(snorm8(fx + (corner & 1) / 127.0f), snorm8(fy + (corner >> 1) / 127.0f));
+    const float candidateDot = EXP::MATH::dot(decodeNormal(candidate), n);
+    if (candidateDot > bestDot) best = candidate, bestDot = candidateDot;
+  }
+  return best;
+}
+
+float3 Renderer::Host::Compact::decodeNormal(uint16_t encoded) {
+  const float x = std::max((int8_t)(encoded & 0xFF) / 127.0f, -1.0f);
+  const float y = std::max((int8_t)(encoded >> 8) / 127.0f, -1.0f);
+  return octDecode(x, y);
+}
+
+void Renderer::Host::Compact::encode(const PrimitiveAttributes* primitives, size_t count, CompactSubmesh& out) {
+  out.primitives.assign(count, CompactPrimitive{});
+  out.colors.clear();
+  if (count == 0) return;
+
+  std::unordered_map<ColorKey, size_t, ColorHash> histogram;
+  float2 uvMax = primitives[0].txcoord[0];
+  out.uvMin = uvMax;
+  for (size_t i = 0; i < count; i++) {
+    for (int k = 0; k < 3; k++) {
+      histogram[{primitives[i].color[k]}]++;
+      const float2& uv = primitives[i].txcoord[k];
+      out.uvMin = {std::min(out.uvMin.x, uv.x), std::min(out.uvMin.y, uv.y)};
+      uvMax = {std::max(uvMax.x, uv.x), std::max(uvMax.y, uv.y)};
+    }
+  }
+  size_t most = 0;
+  for (const auto& [key, uses] : histogram) {
+    if (uses > most || (uses == most && memcmp(&key.value, &out.color, sizeof(float4)) < 0)) most = uses, out.color = key.value;
+  }
+  out.uvExtent = uvMax - out.uvMin;
+
+  for (size_t i = 0; i < count; i++) {
+    const PrimitiveAttributes& primitive = primitives[i];
+    CompactPrimitive& compact = out.primitives[i];
+    compact.flags = (uint16_t)(primitive.flags.x & TEXINDEX_MASK);
+    for (int k = 0; k < 3; k++) {
+      compact.normal[k] = encodeNormal(primitive.normal[k]);
+      compact.txcoord[k][0] = unorm16(primitive.txcoord[k].x, out.uvMin.x, out.uvExtent.x);
+      compact.txcoord[k][1] = unorm16(primitive.txcoord[k].y, out.uvMin.y, out.uvExtent.y);
+    }
+    if (!sameColor(primitive.color[0], out.color) || !sameColor(primitive.color[1], out.color) ||
+        !sameColor(primitive.color[2], out.color)) {
+      compact.flags |= COLOR_OVERRIDE;
+      compact.color = (uint32_t)out.colors.size();
+      out.colors.insert(out.colors.end(), primitive.color, primitive.color + 3);
+    }
+  }
+}
+
+Renderer::Host::PrimitiveAttributes Renderer::Host::Compact::decodePrimitive(const CompactSubmesh& submesh, size_t index) {
+  const CompactPrimitive& compact = submesh.primitives[index];
+  PrimitiveAttributes primitive = {};
+  for (int k = 0; k < 3; k++) {
+    primitive.color[k] = compact.flags & COLOR_OVERRIDE ? submesh.colors[compact.color + k] : submesh.color;
+    primitive.normal[k] = decodeNormal(compact.normal[k]);
+    primitive.txcoord[k] = {
+      submesh.uvMin.x + compact.txcoord[k][0] / 65535.0f * submesh.uvExtent.x,
+      submesh.uvMin.y + compact.txcoord[k][1] / 65535.0f * submesh.uvExtent.y
+    };
+  }
+  primitive.flags = {(uint32_t)(compact.flags & TEXINDEX_MASK), 0};
+  return primitive;
+}
+
+void Renderer::Host::Compact::decode(const CompactSubmesh& submesh, PrimitiveAttributes* out) {
+  for (size_t i = 0; i < submesh.primitives.size(); i++) out[i] = decodePrimitive(submesh, i);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <Renderer/HostTypes.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Compact alternative to PrimitiveAttributes: 24 instead of 144 bytes per triangle.
+ *
+ * - Normals: octahedral, 8 + 8 bit snorm per normal (oct16), encoded with the best of the
+ *   four neighbouring grid points: at most 0.65 degrees off, 0.31 on average.
+ * - Texture coordinates: 16 bit unorm within the bounds of the submesh.
+ * - Colors: one per submesh. Triangles whose corner colors differ from it set COLOR_OVERRIDE
+ *   and point at three exact float4 colors in CompactSubmesh::colors.
+ *
+ * The decoder rebuilds full PrimitiveAttributes (normals come back unit length).
+ **/
+
+namespace Renderer {
+namespace Host {
+
+struct CompactPrimitive {
+  uint16_t normal[3];     // oct16
+  uint16_t flags;         // Bits 0..7 texindex, COLOR_OVERRIDE
+  uint16_t txcoord[3][2]; // unorm16 in [uvMin, uvMin + uvExtent]
+  uint32_t color;         // Index of the first of three override colors
+};
+
+static_assert(sizeof(CompactPrimitive) == 24, "CompactPrimitive is tightly packed");
+
+struct CompactSubmesh {
+  EXP::MATH::float4 color = {0.0f, 0.0f, 0.0f, 1.0f};
+  EXP::MATH::float2 uvMin = {0.0f, 0.0f};
+  EXP::MATH::float2 uvExtent = {0.0f, 0.0f};
+  std::vector<CompactPrimitive> primitives;
+  std::vector<EXP::MATH::float4> colors;
+
+  // What the GPU copy would take: primitives, override colors and the uniform block
+  inline size_t bytes() const {
+    return primitives.size() * sizeof(CompactPrimitive) + colors.size() * sizeof(EXP::MATH::float4) +
+           sizeof(color) + sizeof(uvMin) + sizeof(uvExtent);
+  }
+};
+
+struct Compact {
+  static constexpr uint16_t TEXINDEX_MASK = 0x00FF;
+  static constexpr uint16_t COLOR_OVERRIDE = 0x0100;
+
+  static uint16_t encodeNormal(const EXP::MATH::float3& normal);
+  static EXP::MATH::float3 decodeNormal(uint16_t encoded);
+
+  // The submesh color is the most common corner color
+  static void encode(const PrimitiveAttributes* primitives, size_t count, CompactSubmesh& out);
+  static PrimitiveAttributes decodePrimitive(const CompactSubmesh& submesh, size_t index);
+  static void decode(const CompactSubmesh& submesh, PrimitiveAttributes* out);
+};
+
+}; // namespace Host
+}; // namespace Renderer
@@ -0,0 +1,113 @@
+#include <Renderer/HostImage.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EXP_HALF_F16C 1
+#include <immintrin.h>
+#define TARGET_F16C __attribute__((target("avx,f16c")))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define EXP_HALF_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+#if EXP_HALF_F16C
+const bool F16C = __builtin_cpu_supports("f16c") && __builtin_cpu_supports("avx");
+
+TARGET_F16C size_t fromFloatsF16C(const float* values, uint16_t* out, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), half);
+  }
+  return i;
+}
+
+TARGET_F16C size_t toFloatsF16C(const uint16_t* values, float* out, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i))));
+  }
+  return i;
+}
+#endif
+
+}; // namespace
+
+void Renderer::Host::Image::flipVertical() {
+  const size_t bytes = rowBytes();
+  std::vector<uint8_t> scratch(bytes);
+  for (uint32_t top = 0, bottom = height - 1; top < bottom; top++, bottom--) {
+    memcpy(scratch.data(), row(top), bytes);
+    memcpy(row(top), row(bottom), bytes);
+    memcpy(row(bottom), scratch.data(), bytes);
+  }
+}
+
+uint16_t Renderer::Host::Half::fromFloat(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = bits & 0x7FFFFF;
+
+  if (((bits >> 23) & 0xFF) == 0xFF) return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 | (mantissa >> 13) : 0));
+  if (exponent >= 31) return (uint16_t)(sign | 0x7C00);
+  if (exponent <= 0) {
+    // Subnormal half (or zero)
+    if (exponent < -10) return (uint16_t)sign;
+    mantissa |= 0x800000;
+    const uint32_t shift = (uint32_t)(14 - exponent);
+    uint32_t half = mantissa >> shift;
+    const uint32_t rest = mantissa & ((1u << shift) - 1);
+    const uint32_t midpoint = 1u << (shift - 1);
+    if (rest > midpoint || (rest == midpoint && (half & 1))) half++;
+    return (uint16_t)(sign | half);
+  }
+  uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+  const uint32_t rest = mantissa & 0x1FFF;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; // May carry into the exponent: still correct
+  return (uint16_t)(sign | half);
+}
+
+float Renderer::Host::Half::toFloat(uint16_t value) {
+  const uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+  const uint32_t exponent = (value >> 10) & 0x1F;
+  const uint32_t mantissa = value & 0x3FF;
+  uint32_t bits;
+  if (exponent == 0) {
+    const float magnitude = std::ldexp((float)mantissa, -24);
+    memcpy(&bits, &magnitude, sizeof(bits));
+    bits |= sign;
+  } else if (exponent == 31) {
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+void Renderer::Host::Half::fromFloats(const float* values, uint16_t* out, size_t count) {
+  size_t i = 0;
+#if EXP_HALF_F16C
+  if (F16C) i = fromFloatsF16C(values, out, count);
+#elif EXP_HALF_NEON
+  for (; i + 4 <= count; i += 4) vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(values + i))));
+#endif
+  for (; i < count; i++) out[i] = fromFloat(values[i]);
+}
+
+void Renderer::Host::Half::toFloats(const uint16_t* values, float* out, size_t count) {
+  size_t i = 0;
+#if EXP_HALF_F16C
+  if (F16C) i = toFloatsF16C(values, out, count);
+#elif EXP_HALF_NEON
+  for (; i + 4 <= count; i += 4) vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(values + i))));
+#endif
+  for (; i < count; i++) out[i] = toFloat(values[i]);
+}
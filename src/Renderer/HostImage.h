@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * CPU side images: what the portable decoders produce and the mip generator consumes.
+ *
+ * Pixels are RGBA, tightly packed, row 0 at the top. RGBA8_SRGB matches
+ * MTL::PixelFormatRGBA8Unorm_sRGB and RGBA16F matches MTL::PixelFormatRGBA16Float (linear),
+ * so every level can be handed to replaceRegion as it is.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+enum struct PixelFormat { RGBA8_UNORM = 0, RGBA8_SRGB = 1, RGBA16F = 2 };
+
+struct Image {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  PixelFormat format = PixelFormat::RGBA8_SRGB;
+  std::vector<uint8_t> data;
+
+  static inline size_t bytesPerPixel(PixelFormat format) { return format == PixelFormat::RGBA16F ? 8 : 4; }
+  inline size_t bytesPerPixel() const { return bytesPerPixel(format); }
+  inline size_t rowBytes() const { return width * bytesPerPixel(); }
+  inline size_t bytes() const { return data.size(); }
+  inline uint8_t* row(uint32_t y) { return data.data() + y * rowBytes(); }
+  inline const uint8_t* row(uint32_t y) const { return data.data() + y * rowBytes(); }
+
+  inline void allocate(uint32_t w, uint32_t h, PixelFormat f) {
+    width = w, height = h, format = f;
+    data.assign((size_t)w * h * bytesPerPixel(f), 0);
+  }
+  // Rows bottom up: what MTKTextureLoaderOriginBottomLeft does
+  void flipVertical();
+};
+
+struct MipChain {
+  std::vector<Image> levels; // levels[0] is the full size image
+
+  inline size_t bytes() const {
+    size_t total = 0;
+    for (const Image& level : levels) total += level.bytes();
+    return total;
+  }
+};
+
+struct Half {
+  static uint16_t fromFloat(float value); // Round to nearest even
+  static float toFloat(uint16_t value);
+  // Same results, F16C on x86 when the CPU has it, NEON on arm64
+  static void fromFloats(const float* values, uint16_t* out, size_t count);
+  static void toFloats(const uint16_t* values, float* out, size_t count);
+};
+
+}; // namespace Host
+}; // namespace Renderer
@@ -0,0 +1,272 @@
+#include <Renderer/HostInstance.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using EXP::MATH::f3;
+using EXP::MATH::p3;
+using EXP::MATH::packed3;
+using EXP::MATH::packed4x3;
+using Renderer::Host::Aabb;
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhCounters;
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhNode;
+using Renderer::Host::BvhRay;
+using Renderer::Host::BvhReport;
+using Renderer::Host::BvhSettings;
+using Renderer::Host::Instance;
+using Renderer::Host::Tlas;
+using Renderer::Host::TlasAction;
+using Renderer::Host::TlasSettings;
+using Renderer::Host::TlasUpdate;
+
+
+namespace {
+
+constexpr uint32_t MAX_DEPTH = 64; // Traversal stack size, as Bvh::intersect
+
+} // namespace
+
+
+Aabb Renderer::Host::TlasBuilder::transform(const Aabb& bounds, const packed4x3& matrix) {
+  Aabb result;
+  if (bounds.empty()) return result;
+  for (int corner = 0; corner < 8; corner++) {
+    const EXP::MATH::float3 p = {
+      corner & 1 ? bounds.max.x : bounds.min.x, corner & 2 ? bounds.max.y : bounds.min.y, corner & 4 ? bounds.max.z : bounds.min.z
+    };
+    result.grow(p3(EXP::MATH::transformPoint(matrix, p)));
+  }
+  return result;
+}
+
+template <typename Blas>
+BvhReport Renderer::Host::TlasBuilder::build(
+  const std::vector<Instance>& instances,
+  const std::vector<const Blas*>& structures,
+  Tlas<Blas>& tlas,
+  const BvhSettings& settings
+) {
+  const auto start = std::chrono::steady_clock::now();
+  tlas.instances = instances;
+  tlas.structures = structures;
+  tlas.inverses.assign(instances.size(), EXP::MATH::identity4x3());
+  tlas.boxes.assign(instances.size(), Aabb());
+
+  // Instances that can be hit, and their world boxes
+  std::vector<uint32_t> ids;
+  std::vector<Aabb> boxes;
+  for (uint32_t i = 0; i < instances.size(); i++) {
+    const Instance& instance = instances[i];
+    if (instance.accelerationStructureIndex >= structures.size() || !structures[instance.accelerationStructureIndex]) continue;
+    if (!EXP::MATH::inverse(instance.transformationMatrix, tlas.inverses[i])) continue;
+    const Aabb box = transform(structures[instance.accelerationStructureIndex]->bounds(), instance.transformationMatrix);
+    if (box.empty()) continue;
+    ids.push_back(i);
+    boxes.push_back(box);
+    tlas.boxes[i] = box;
+  }
+
+  BvhSettings leaves = settings;
+  leaves.maxLeafSize = 1;
+  BvhReport result = BvhBuilder::binnedSah(boxes, tlas.bvh, leaves);
+  for (uint32_t& primitive : tlas.bvh.primitives) primitive = ids[primitive];
+  tlas.builtSahCost = result.sahCost;
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+template <typename Blas>
+TlasUpdate Renderer::Host::TlasBuilder::update(
+  const std::vector<Instance>& instances,
+  Tlas<Blas>& tlas,
+  const BvhSettings& settings,
+  const TlasSettings& tlasSettings
+) {
+  const auto start = std::chrono::steady_clock::now();
+  TlasUpdate result;
+
+  // A different list, or a structure swapped under an instance: the tree no longer fits
+  bool rebuild = instances.size() != tlas.instances.size();
+  std::vector<uint32_t> moved;
+  for (uint32_t i = 0; i < instances.size() && !rebuild; i++) {
+    const Instance& instance = instances[i];
+    if (instance.accelerationStructureIndex != tlas.instances[i].accelerationStructureIndex) rebuild = true;
+    else if (std::memcmp(&instance.transformationMatrix, &tlas.instances[i].transformationMatrix, sizeof(packed4x3))) {
+      moved.push_back(i);
+    }
+  }
+
+  if (!rebuild) {
+    // Masks and options take effect without touching the tree
+    tlas.instances = instances;
+    result.moved = (uint32_t)moved.size();
+    if (moved.empty()) {
+      result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      return result;
+    }
+    // Boxes of the moved instances; one coming into or leaving the tree needs a new one
+    for (uint32_t i : moved) {
+      const Instance& instance = instances[i];
+      packed4x3 inverse;
+      Aabb box;
+      const Blas* structure = instance.accelerationStructureIndex < tlas.structures.size() ? tlas.structures[instance.accelerationStructureIndex] : nullptr;
+      if (structure && EXP::MATH::inverse(instance.transformationMatrix, inverse)) {
+        box = transform(structure->bounds(), instance.transformationMatrix);
+        tlas.inverses[i] = inverse;
+      }
+      if (box.empty() != tlas.boxes[i].empty()) rebuild = true;
+      tlas.boxes[i] = box;
+    }
+  }
+
+  if (!rebuild) {
+    BvhBuilder::refit(tlas.boxes, tlas.bvh);
+    result.action = TlasAction::REFIT;
+    result.sahCost = tlas.bvh.sahCost(settings);
+    rebuild = result.sahCost > tlas.builtSahCost * tlasSettings.rebuildRatio;
+  }
+  if (rebuild) {
+    result.action = TlasAction::REBUILD;
+    result.moved = (uint32_t)instances.size();
+    result.sahCost = build(instances, tlas.structures, tlas, settings).sahCost;
+  }
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+template <typename Blas>
+bool Renderer::Host::Tlas<Blas>::intersect(const BvhRay& ray, BvhHit& hit, uint32_t mask, BvhCounters* counters) const {
+  if (bvh.nodes.empty()) return false;
+  const packed3 o = ray.origin, d = ray.direction;
+  const packed3 inverse = {1.0f / d.x, 1.0f / d.y, 1.0f / d.z};
+  float closest = ray.tmax;
+  bool found = false;
+
+  // Entry distance of the slab test, INFINITY on a miss
+  auto enter = [&](const BvhNode& node) {
+    float near, far;
+    slab(node, o, inverse, near, far);
+    near = std::max(near, ray.tmin);
+    return near <= std::min(far, closest) ? near : INFINITY;
+  };
+
+  uint32_t stack[MAX_DEPTH * 2];
+  int top = 0;
+  uint32_t index = 0;
+  if (enter(bvh.nodes[0]) == INFINITY) return false;
+  while (true) {
+    const BvhNode& node = bvh.nodes[index];
+    if (node.isLeaf()) {
+      if (counters) counters->leaves++;
+      for (uint32_t i = node.index; i < node.index + node.count; i++) {
+        const uint32_t id = bvh.primitives[i];
+        const Instance& instance = instances[id];
+        if (!(instance.mask & mask)) continue;
+        // Object space ray, same parameter t as the world space one
+        BvhRay local;
+        local.origin = p3(EXP::MATH::transformPoint(inverses[id], f3(o)));
+        local.direction = p3(EXP::MATH::transformVector(inverses[id], f3(d)));
+        local.tmin = ray.tmin;
+        local.tmax = closest;
+        BvhHit candidate;
+        if (!structures[instance.accelerationStructureIndex]->intersect(local, candidate, counters)) continue;
+        hit = candidate;
+        hit.instance = id;
+        closest = candidate.t;
+        found = true;
+      }
+    } else {
+      if (counters) counters->nodes++;
+      uint32_t near = node.index, far = node.index + 1;
+      float tNear = enter(bvh.nodes[near]), tFar = enter(bvh.nodes[far]);
+      if (tFar < tNear) std::swap(near, far), std::swap(tNear, tFar);
+      if (tNear != INFINITY) {
+        if (tFar != INFINITY) stack[top++] = far;
+        index = near;
+        continue;
+      }
+    }
+    do {
+      if (top == 0) return found;
+      index = stack[--top];
+    } while (enter(bvh.nodes[index]) == INFINITY);
+  }
+}
+
+template <typename Blas>
+bool Renderer::Host::Tlas<Blas>::occluded(const BvhRay& ray, uint32_t mask, BvhCounters* counters) const {
+  if (bvh.nodes.empty()) return false;
+  const packed3 o = ray.origin, d = ray.direction;
+  const packed3 inverse = {1.0f / d.x, 1.0f / d.y, 1.0f / d.z};
+
+  auto enters = [&](const BvhNode& node) {
+    float near, far;
+    slab(node, o, inverse, near, far);
+    return std::max(near, ray.tmin) <= std::min(far, ray.tmax);
+  };
+
+  uint32_t stack[MAX_DEPTH * 2];
+  int top = 0;
+  uint32_t index = 0;
+  if (!enters(bvh.nodes[0])) return false;
+  while (true) {
+    const BvhNode& node = bvh.nodes[index];
+    if (node.isLeaf()) {
+      if (counters) counters->leaves++;
+      for (uint32_t i = node.index; i < node.index + node.count; i++) {
+        const uint32_t id = bvh.primitives[i];
+        const Instance& instance = instances[id];
+        if (!(instance.mask & mask)) continue;
+        BvhRay local;
+        local.origin = p3(EXP::MATH::transformPoint(inverses[id], f3(o)));
+        local.direction = p3(EXP::MATH::transformVector(inverses[id], f3(d)));
+        local.tmin = ray.tmin;
+        local.tmax = ray.tmax;
+        if (structures[instance.accelerationStructureIndex]->occluded(local, counters)) return true;
+      }
+    } else {
+      if (counters) counters->nodes++;
+      const bool first = enters(bvh.nodes[node.index]), second = enters(bvh.nodes[node.index + 1]);
+      if (first || second) {
+        if (first && second) stack[top++] = node.index + 1;
+        index = first ? node.index : node.index + 1;
+        continue;
+      }
+    }
+    if (top == 0) return false;
+    index = stack[--top];
+  }
+}
+
+template struct Renderer::Host::Tlas<Bvh>;
+template struct Renderer::Host::Tlas<Renderer::Host::Bvh4>;
+template struct Renderer::Host::Tlas<Renderer::Host::Bvh8>;
+
+template BvhReport Renderer::Host::TlasBuilder::build(
+  const std::vector<Instance>&, const std::vector<const Bvh*>&, Tlas<Bvh>&, const BvhSettings&
+);
+template BvhReport Renderer::Host::TlasBuilder::build(
+  const std::vector<Instance>&, const std::vector<const Renderer::Host::Bvh4*>&, Tlas<Renderer::Host::Bvh4>&, const BvhSettings&
+);
+template BvhReport Renderer::Host::TlasBuilder::build(
+  const std::vector<Instance>&, const std::vector<const Renderer::Host::Bvh8*>&, Tlas<Renderer::Host::Bvh8>&, const BvhSettings&
+);
+template TlasUpdate Renderer::Host::TlasBuilder::update(
+  const std::vector<Instance>&, Tlas<Bvh>&, const BvhSettings&, const TlasSettings&
+);
+template TlasUpdate Renderer::Host::TlasBuilder::update(
+  const std::vector<Instance>&, Tlas<Renderer::Host::Bvh4>&, const BvhSettings&, const TlasSettings&
+);
+template TlasUpdate Renderer::Host::TlasBuilder::update(
+  const std::vector<Instance>&, Tlas<Renderer::Host::Bvh8>&, const BvhSettings&, const TlasSettings&
+);
+
+// Built and updated only: Tlas<BlasBounds> has nothing to traverse
+template BvhReport Renderer::Host::TlasBuilder::build(
+  const std::vector<Instance>&, const std::vector<const Renderer::Host::BlasBounds*>&, Tlas<Renderer::Host::BlasBounds>&, const BvhSettings&
+);
+template TlasUpdate Renderer::Host::TlasBuilder::update(
+  const std::vector<Instance>&, Tlas<Renderer::Host::BlasBounds>&, const BvhSettings&, const TlasSettings&
+);
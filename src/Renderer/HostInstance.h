@@ -0,0 +1,105 @@
+#pragma once
+#include <Renderer/HostBvh.h>
+#include <Renderer/HostWideBvh.h>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Two level acceleration on the CPU, the counterpart of Descriptor::instance: a top level BVH over
+ * instances of bottom level structures (Bvh, Bvh4 or Bvh8), one per mesh.
+ *
+ * Instance has the layout of MTL::AccelerationStructureInstanceDescriptor, its object to world
+ * transform the packed 4x3 EXP::MATH::pack makes, so one array can fill both. A ray visits an
+ * instance when its mask shares a bit with the instance's; Metal's 0xFF on both sides visits all.
+ * Rays go into object space through the inverse transform, the direction left unnormalized so
+ * distances stay those of the world space ray, and the closest hit so far bounds every bottom
+ * level traversal after it. Occlusion queries (shadow rays) need no closest hit: they stop at the
+ * first triangle in range, in whichever instance and leaf comes first.
+ *
+ * The top level is a binned SAH BVH over the instances' world boxes (the corners of the bottom level
+ * box, transformed) with one instance per leaf: entering an instance costs a whole bottom level
+ * traversal, so it pays to separate them all. Instances with a singular transform, an empty or
+ * missing structure are left out of it.
+ *
+ * Between frames TlasBuilder::update keeps the top level current at the least cost: nothing when no
+ * transform changed, a refit of the moved instances' boxes (tree kept, bounds redone bottom-up) when
+ * some did, and a full build when the instance list or a structure changed, an instance came into or
+ * left the tree, or refits have let the SAH cost grow past `rebuildRatio` times that of the last build.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+struct Instance {
+  EXP::MATH::packed4x3 transformationMatrix = EXP::MATH::identity4x3(); // Object to world
+  uint32_t options = 0; // MTL::AccelerationStructureInstanceOptions, for the Metal side
+  uint32_t mask = 0xFF;
+  uint32_t intersectionFunctionTableOffset = 0;
+  uint32_t accelerationStructureIndex = 0;
+};
+
+static_assert(sizeof(Instance) == 64, "Instance must match MTL::AccelerationStructureInstanceDescriptor");
+
+// Bottom level that is only its box: all TlasBuilder reads, for a top level kept current while
+// nothing traverses the host trees. A Tlas over these is built and updated, never traced.
+struct BlasBounds {
+  Aabb box;
+  inline Aabb bounds() const { return box; }
+};
+
+enum struct TlasAction { NONE = 0, REFIT = 1, REBUILD = 2 };
+
+struct TlasSettings {
+  float rebuildRatio = 1.3f; // Rebuild once a refit tree's SAH cost passes this times the built one's
+};
+
+struct TlasUpdate {
+  TlasAction action = TlasAction::NONE;
+  uint32_t moved = 0;    // Instances whose transform changed
+  double sahCost = 0.0;  // Of the tree after a refit or rebuild
+  double seconds = 0.0;
+};
+
+template <typename Blas> struct Tlas {
+  std::vector<Instance> instances;
+  std::vector<const Blas*> structures;        // By Instance::accelerationStructureIndex
+  std::vector<EXP::MATH::packed4x3> inverses; // World to object, per instance
+  std::vector<Aabb> boxes;                    // World box per instance, empty for those left out
+  Bvh bvh;                                    // Over instance world boxes, primitives are instance ids
+  double builtSahCost = 0.0;                  // SAH cost right after the last full build
+
+  // Closest hit over the instances whose mask shares a bit with `mask`; hit.instance says which
+  bool intersect(const BvhRay& ray, BvhHit& hit, uint32_t mask = 0xFF, BvhCounters* counters = nullptr) const;
+  // Whether any of those instances is hit in [ray.tmin, ray.tmax): the first hit found ends the
+  // traversal, nothing is ordered, as Metal's accept_any_intersection
+  bool occluded(const BvhRay& ray, uint32_t mask = 0xFF, BvhCounters* counters = nullptr) const;
+};
+
+class TlasBuilder {
+public:
+  TlasBuilder(){};
+  ~TlasBuilder(){};
+
+public:
+  // `structures` must outlive the Tlas; settings.maxLeafSize is 1 whatever is passed
+  template <typename Blas>
+  static BvhReport build(
+    const std::vector<Instance>& instances,
+    const std::vector<const Blas*>& structures,
+    Tlas<Blas>& tlas,
+    const BvhSettings& settings = {}
+  );
+  // Brings a built Tlas up to `instances`: nothing, a refit or a full build, whichever will do
+  template <typename Blas>
+  static TlasUpdate update(
+    const std::vector<Instance>& instances,
+    Tlas<Blas>& tlas,
+    const BvhSettings& settings = {},
+    const TlasSettings& tlasSettings = {}
+  );
+  // World box of a bottom level box under a transform
+  static Aabb transform(const Aabb& bounds, const EXP::MATH::packed4x3& matrix);
+};
+
+}; // namespace Host
+}; // namespace Renderer
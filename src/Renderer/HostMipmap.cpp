@@ -0,0 +1,296 @@
+#include <Renderer/HostMipmap.h>
+#include <Thread/Pool.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+using Renderer::Host::Half;
+using Renderer::Host::Image;
+using Renderer::Host::MipFilter;
+using Renderer::Host::Mipmap;
+using Renderer::Host::PixelFormat;
+
+namespace {
+
+constexpr size_t BAND_PIXELS = 16384; // Pixels per parallel block
+constexpr float KAISER_ALPHA = 4.0f;
+constexpr float KAISER_RADIUS = 1.5f; // In output pixels
+
+// One float4 pixel: weighted accumulation is the only vector operation the filters need
+#if defined(__SSE2__)
+struct Pixel {
+  __m128 value = _mm_setzero_ps();
+  inline void madd(const float* p, float w) { value = _mm_add_ps(value, _mm_mul_ps(_mm_loadu_ps(p), _mm_set1_ps(w))); }
+  inline void store(float* p) const { _mm_storeu_ps(p, value); }
+};
+#elif defined(__ARM_NEON)
+struct Pixel {
+  float32x4_t value = vdupq_n_f32(0.0f);
+  inline void madd(const float* p, float w) { value = vmlaq_n_f32(value, vld1q_f32(p), w); }
+  inline void store(float* p) const { vst1q_f32(p, value); }
+};
+#else
+struct Pixel {
+  float value[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  inline void madd(const float* p, float w) {
+    for (int c = 0; c < 4; c++) value[c] += p[c] * w;
+  }
+  inline void store(float* p) const { memcpy(p, value, sizeof(value)); }
+};
+#endif
+
+// Fixed number of taps per output sample; unused taps carry weight 0
+struct Taps {
+  uint32_t count = 0;
+  std::vector<uint32_t> index;
+  std::vector<float> weight;
+};
+
+float besselI0(float x) {
+  float sum = 1.0f, term = 1.0f;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / (2.0f * k)) * (x / (2.0f * k));
+    sum += term;
+    if (term < sum * 1e-8f) break;
+  }
+  return sum;
+}
+
+float kaiser(float distance) {
+  const float x = distance / KAISER_RADIUS;
+  if (std::fabs(x) >= 1.0f) return 0.0f;
+  const float window = besselI0(KAISER_ALPHA * std::sqrt(1.0f - x * x)) / besselI0(KAISER_ALPHA);
+  const float sinc = distance == 0.0f ? 1.0f : std::sin(3.14159265f * distance) / (3.14159265f * distance);
+  return sinc * window;
+}
+
+Taps taps(uint32_t source, uint32_t target, MipFilter filter) {
+  const float scale = (float)source / target;
+  const float radius = filter == MipFilter::BOX ? scale * 0.5f : KAISER_RADIUS * scale;
+  Taps result;
+  result.count = (uint32_t)std::ceil(2.0f * radius) + 1;
+  result.index.resize((size_t)target * result.count);
+  result.weight.resize((size_t)target * result.count);
+
+  for (uint32_t o = 0; o < target; o++) {
+    const float center = (o + 0.5f) * scale;
+    const int first = (int)std::floor(center - radius);
+    float total = 0.0f;
+    for (uint32_t t = 0; t < result.count; t++) {
+      const int i = first + (int)t;
+      float w;
+      if (filter == MipFilter::BOX) {
+        // Overlap of source pixel [i, i + 1) with the footprint of o
+        w = std::max(0.0f, std::min((float)i + 1.0f, center + radius) - std::max((float)i, center - radius));
+      } else {
+        w = kaiser((i + 0.5f - center) / scale);
+      }
+      result.index[o * result.count + t] = (uint32_t)std::clamp(i, 0, (int)source - 1);
+      result.weight[o * result.count + t] = w;
+      total += w;
+    }
+    for (uint32_t t = 0; t < result.count; t++) result.weight[o * result.count + t] /= total;
+  }
+
+  // Drop trailing taps no output uses (an even box only needs two)
+  uint32_t used = 1;
+  for (uint32_t o = 0; o < target; o++) {
+    for (uint32_t t = 0; t < result.count; t++) if (result.weight[o * result.count + t] != 0.0f) used = std::max(used, t + 1);
+  }
+  if (used < result.count) {
+    for (uint32_t o = 0; o < target; o++) {
+      for (uint32_t t = 0; t < used; t++) {
+        result.index[o * used + t] = result.index[o * result.count + t];
+        result.weight[o * used + t] = result.weight[o * result.count + t];
+      }
+    }
+    result.count = used;
+  }
+  return result;
+}
+
+inline size_t grain(uint32_t width) { return std::max<size_t>(1, BAND_PIXELS / std::max<uint32_t>(width, 1)); }
+
+// Linear float RGBA, what every level is filtered in
+struct Linear {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<float> data;
+
+  inline float* row(uint32_t y) { return data.data() + (size_t)y * width * 4; }
+  inline const float* row(uint32_t y) const { return data.data() + (size_t)y * width * 4; }
+};
+
+const std::vector<uint8_t>& srgbTable() {
+  static const std::vector<uint8_t> table = [] {
+    std::vector<uint8_t> values(65536);
+    for (size_t i = 0; i < values.size(); i++) {
+      const double linear = i / 65535.0;
+      const double srgb = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+      values[i] = (uint8_t)std::lround(srgb * 255.0);
+    }
+    return values;
+  }();
+  return table;
+}
+
+const float* linearTable() {
+  static const std::vector<float> table = [] {
+    std::vector<float> values(256);
+    for (int i = 0; i < 256; i++) {
+      const double srgb = i / 255.0;
+      values[i] = (float)(srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4));
+    }
+    return values;
+  }();
+  return table.data();
+}
+
+inline float saturate(float value) { return std::clamp(value, 0.0f, 1.0f); }
+
+// One row of an image in linear float RGBA
+void linearRow(const Image& image, uint32_t y, float* target) {
+  const uint8_t* source = image.row(y);
+  const size_t count = (size_t)image.width * 4;
+  if (image.format == PixelFormat::RGBA16F) {
+    Half::toFloats(reinterpret_cast<const uint16_t*>(source), target, count);
+  } else if (image.format == PixelFormat::RGBA8_SRGB) {
+    const float* table = linearTable();
+    for (size_t i = 0; i < count; i += 4) {
+      target[i + 0] = table[source[i + 0]];
+      target[i + 1] = table[source[i + 1]];
+      target[i + 2] = table[source[i + 2]];
+      target[i + 3] = source[i + 3] * (1.0f / 255.0f);
+    }
+  } else {
+    for (size_t i = 0; i < count; i++) target[i] = source[i] * (1.0f / 255.0f);
+  }
+}
+
+// One linear float RGBA row into an image row of its format
+void storeRow(const float* source, Image& image, uint32_t y) {
+  uint8_t* target = image.row(y);
+  const size_t count = (size_t)image.width * 4;
+  if (image.format == PixelFormat::RGBA16F) {
+    float clamped[256];
+    for (size_t i = 0; i < count; i += 256) {
+      const size_t chunk = std::min<size_t>(256, count - i);
+      for (size_t k = 0; k < chunk; k++) clamped[k] = saturate(source[i + k]);
+      Half::fromFloats(clamped, reinterpret_cast<uint16_t*>(target) + i, chunk);
+    }
+  } else if (image.format == PixelFormat::RGBA8_SRGB) {
+    const uint8_t* table = srgbTable().data();
+    for (size_t i = 0; i < count; i += 4) {
+      target[i + 0] = table[(uint32_t)(saturate(source[i + 0]) * 65535.0f + 0.5f)];
+      target[i + 1] = table[(uint32_t)(saturate(source[i + 1]) * 65535.0f + 0.5f)];
+      target[i + 2] = table[(uint32_t)(saturate(source[i + 2]) * 65535.0f + 0.5f)];
+      target[i + 3] = (uint8_t)(saturate(source[i + 3]) * 255.0f + 0.5f);
+    }
+  } else {
+    for (size_t i = 0; i < count; i++) target[i] = (uint8_t)(saturate(source[i]) * 255.0f + 0.5f);
+  }
+}
+
+// Level 0 is read straight from the image (converted a row at a time), later levels from Linear
+struct ImageRows {
+  const Image& image;
+  inline uint32_t width() const { return image.width; }
+  inline uint32_t height() const { return image.height; }
+  inline const float* row(uint32_t y, float* scratch) const {
+    linearRow(image, y, scratch);
+    return scratch;
+  }
+};
+
+struct LinearRows {
+  const Linear& linear;
+  inline uint32_t width() const { return linear.width; }
+  inline uint32_t height() const { return linear.height; }
+  inline const float* row(uint32_t y, float*) const { return linear.row(y); }
+};
+
+// Next level in row bands: each band filters the source rows it needs horizontally, then sums
+// them vertically into its output rows. Bands only overlap by the filter footprint.
+template <typename Source>
+void reduce(const Source& source, Linear& target, Image& level, MipFilter filter, unsigned int maxThreads) {
+  const uint32_t width = std::max(1u, source.width() / 2), height = std::max(1u, source.height() / 2);
+  const Taps horizontal = taps(source.width(), width, filter);
+  const Taps vertical = taps(source.height(), height, filter);
+  target.width = width, target.height = height;
+  target.data.resize((size_t)width * height * 4);
+  level.allocate(width, height, level.format);
+
+  EXP::THREAD::parallelFor(height, std::max<size_t>(4, grain(width)), [&](size_t first, size_t last) {
+    uint32_t top = UINT32_MAX, bottom = 0;
+    for (size_t i = first * vertical.count; i < last * vertical.count; i++) {
+      top = std::min(top, vertical.index[i]), bottom = std::max(bottom, vertical.index[i]);
+    }
+    std::vector<float> scratch((size_t)source.width() * 4);
+    std::vector<float> rows((size_t)(bottom - top + 1) * width * 4);
+    for (uint32_t y = top; y <= bottom; y++) {
+      const float* in = source.row(y, scratch.data());
+      float* out = rows.data() + (size_t)(y - top) * width * 4;
+      for (uint32_t x = 0; x < width; x++) {
+        Pixel pixel;
+        const uint32_t* index = horizontal.index.data() + x * horizontal.count;
+        const float* weight = horizontal.weight.data() + x * horizontal.count;
+        for (uint32_t t = 0; t < horizontal.count; t++) pixel.madd(in + index[t] * 4, weight[t]);
+        pixel.store(out + x * 4);
+      }
+    }
+    for (size_t y = first; y < last; y++) {
+      const uint32_t* index = vertical.index.data() + y * vertical.count;
+      const float* weight = vertical.weight.data() + y * vertical.count;
+      float* out = target.row((uint32_t)y);
+      for (uint32_t x = 0; x < width; x++) {
+        Pixel pixel;
+        for (uint32_t t = 0; t < vertical.count; t++) pixel.madd(rows.data() + ((size_t)(index[t] - top) * width + x) * 4, weight[t]);
+        pixel.store(out + x * 4);
+      }
+      storeRow(out, level, (uint32_t)y);
+    }
+  }, maxThreads);
+}
+
+}; // namespace
+
+
+uint32_t Mipmap::levelCount(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  while (width > 1 || height > 1) width = std::max(1u, width / 2), height = std::max(1u, height / 2), levels++;
+  return levels;
+}
+
+float Mipmap::toLinear(uint8_t srgb) { return linearTable()[srgb]; }
+
+uint8_t Mipmap::toSrgb(float linear) { return srgbTable()[(uint32_t)(saturate(linear) * 65535.0f + 0.5f)]; }
+
+void Mipmap::build(const Image& base, MipChain& chain, MipFilter filter, PixelFormat format, unsigned int maxThreads) {
+  chain.levels.assign(levelCount(base.width, base.height), Image{});
+  for (Image& level : chain.levels) level.format = format;
+  if (base.format == format) {
+    chain.levels[0] = base;
+  } else {
+    chain.levels[0].allocate(base.width, base.height, format);
+    EXP::THREAD::parallelFor(base.height, grain(base.width), [&](size_t first, size_t last) {
+      std::vector<float> row((size_t)base.width * 4);
+      for (size_t y = first; y < last; y++) {
+        linearRow(base, (uint32_t)y, row.data());
+        storeRow(row.data(), chain.levels[0], (uint32_t)y);
+      }
+    }, maxThreads);
+  }
+  if (chain.levels.size() == 1) return;
+
+  Linear current, next;
+  reduce(ImageRows{base}, current, chain.levels[1], filter, maxThreads);
+  for (size_t level = 2; level < chain.levels.size(); level++) {
+    reduce(LinearRows{current}, next, chain.levels[level], filter, maxThreads);
+    std::swap(current, next);
+  }
+}
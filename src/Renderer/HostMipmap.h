@@ -0,0 +1,42 @@
+#pragma once
+#include <Renderer/HostImage.h>
+#include <cstdint>
+
+/**
+ * Mip chain generator for decoded images.
+ *
+ * Filtering happens in linear light: sRGB levels are converted to float once, every level is
+ * reduced from the one above it (separable, horizontal then vertical) and converted back, so a
+ * black and white checkerboard becomes sRGB 188 and not 128. Alpha is linear throughout.
+ *
+ * - BOX: 2x2 average (area weighted for odd sizes).
+ * - KAISER: Kaiser windowed sinc (alpha 4, three taps per side at the source rate); sharper,
+ *   slight ringing is clamped away.
+ *
+ * Each level runs in parallel row bands; the inner loops work on whole float4 pixels with
+ * SSE / NEON and a scalar fallback. Output levels are RGBA8_SRGB or linear RGBA16F.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+enum struct MipFilter { BOX = 0, KAISER = 1 };
+
+struct Mipmap {
+  // Levels down to 1x1, each dimension halved and rounded down
+  static uint32_t levelCount(uint32_t width, uint32_t height);
+  static void build(
+    const Image& base,
+    MipChain& chain,
+    MipFilter filter = MipFilter::BOX,
+    PixelFormat format = PixelFormat::RGBA8_SRGB,
+    unsigned int maxThreads = 0
+  );
+
+public: // Conversions
+  static float toLinear(uint8_t srgb);
+  static uint8_t toSrgb(float linear);
+};
+
+}; // namespace Host
+}; // namespace Renderer
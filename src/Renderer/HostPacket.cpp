@@ -0,0 +1,675 @@
+#include <Renderer/HostCamera.h>
+#include <Renderer/HostPacket.h>
+#include <Thread/TileScheduler.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EXP_PACKET_X86 1
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+// Everything the kernel calls is inlined into the per instruction set entry points below, so that
+// each is compiled for its target
+#define PACKET_INLINE inline __attribute__((always_inline))
+
+// Wide vectors are returned by those helpers only ever inlined, their calling convention never used
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+using EXP::MATH::packed3;
+using Renderer::Host::Bvh8;
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhRay;
+using Renderer::Host::PacketIsa;
+using Renderer::Host::PacketSettings;
+using Renderer::Host::PacketStats;
+using Renderer::Host::Tlas;
+
+
+namespace {
+
+constexpr uint32_t TLAS_DEPTH = 64;    // Top level stack size, as Tlas::intersect
+constexpr uint32_t STACK_DEPTH = 128;  // Binary depth a bottom level stack is sized for, as WideBvh::intersect
+constexpr uint32_t PACKET_GRAIN = 64;  // Packets per parallelFor block in intersect()
+constexpr float INTERVAL_SLACK = 1e-5f; // Relative: the interval test rounds differently from the lane test
+
+// R floats and R ints in the compiler's vector extensions, R the lanes of one register: 4 on the
+// 128 bit baseline, 8 on AVX2, 16 on AVX-512. A packet of W rays is W / R of them; GCC lowers compares
+// on vectors wider than the target's registers one lane at a time, so wider types are not used.
+template <uint32_t R> struct Lanes {
+  typedef float F __attribute__((vector_size(4 * R)));
+  typedef int32_t I __attribute__((vector_size(4 * R)));
+};
+
+template <uint32_t R> PACKET_INLINE typename Lanes<R>::F splat(float x) { return typename Lanes<R>::F{} + x; }
+
+template <uint32_t R>
+PACKET_INLINE typename Lanes<R>::F select(const typename Lanes<R>::I& mask, const typename Lanes<R>::F& a, const typename Lanes<R>::F& b) {
+  typedef typename Lanes<R>::I I;
+  typedef typename Lanes<R>::F F;
+  return (F)((mask & (I)a) | (~mask & (I)b));
+}
+
+template <uint32_t R> PACKET_INLINE typename Lanes<R>::F vmin(const typename Lanes<R>::F& a, const typename Lanes<R>::F& b) {
+  return select<R>(a < b, a, b);
+}
+
+template <uint32_t R> PACKET_INLINE typename Lanes<R>::F vmax(const typename Lanes<R>::F& a, const typename Lanes<R>::F& b) {
+  return select<R>(a > b, a, b);
+}
+
+// Lane i holds bit i: masks go to and from bits by and / compare, as SSE2 has no per lane shift
+template <uint32_t R> PACKET_INLINE typename Lanes<R>::I laneBits() {
+  typename Lanes<R>::I result;
+  for (uint32_t i = 0; i < R; i++) result[i] = (int32_t)(1u << i);
+  return result;
+}
+
+// Horizontal reductions, halving the vector until four lanes are left
+template <uint32_t R> PACKET_INLINE float reduceMin(const typename Lanes<R>::F& v) {
+  if constexpr (R == 4) {
+    return std::min(std::min(v[0], v[1]), std::min(v[2], v[3]));
+  } else {
+    typename Lanes<R / 2>::F lo, hi;
+    std::memcpy(&lo, &v, sizeof(lo));
+    std::memcpy(&hi, (const char*)&v + sizeof(lo), sizeof(hi));
+    return reduceMin<R / 2>(vmin<R / 2>(lo, hi));
+  }
+}
+
+template <uint32_t R> PACKET_INLINE float reduceMax(const typename Lanes<R>::F& v) {
+  if constexpr (R == 4) {
+    return std::max(std::max(v[0], v[1]), std::max(v[2], v[3]));
+  } else {
+    typename Lanes<R / 2>::F lo, hi;
+    std::memcpy(&lo, &v, sizeof(lo));
+    std::memcpy(&hi, (const char*)&v + sizeof(lo), sizeof(hi));
+    return reduceMax<R / 2>(vmax<R / 2>(lo, hi));
+  }
+}
+
+template <uint32_t R> PACKET_INLINE int32_t reduceOr(const typename Lanes<R>::I& v) {
+  if constexpr (R == 4) {
+    return (v[0] | v[1]) | (v[2] | v[3]);
+  } else {
+    typename Lanes<R / 2>::I lo, hi;
+    std::memcpy(&lo, &v, sizeof(lo));
+    std::memcpy(&hi, (const char*)&v + sizeof(lo), sizeof(hi));
+    return reduceOr<R / 2>(lo | hi);
+  }
+}
+
+// A bit per lane of a comparison result
+template <uint32_t R> PACKET_INLINE uint32_t bits(const typename Lanes<R>::I& mask) {
+  return (uint32_t)reduceOr<R>(mask & laneBits<R>());
+}
+
+// Lane i of the result is all ones when bit i is set
+template <uint32_t R> PACKET_INLINE typename Lanes<R>::I expand(uint32_t mask) {
+  return ((typename Lanes<R>::I{} + (int32_t)mask) & laneBits<R>()) != 0;
+}
+
+// W rays, structure of arrays, K registers of R lanes per component: lane i is lane i % R of register
+// i / R. What the box tests need is precomputed.
+template <uint32_t W, uint32_t R> struct Packet {
+  static constexpr uint32_t K = W / R;
+  typedef typename Lanes<R>::F F;
+  typedef typename Lanes<R>::I I;
+  F ox[K], oy[K], oz[K], dx[K], dy[K], dz[K];
+  F ix[K], iy[K], iz[K];    // Inverse direction
+  F oix[K], oiy[K], oiz[K]; // Origin times inverse direction
+  F tmin[K], closest[K];    // closest starts out as tmax
+  uint32_t active = 0;
+
+  // Over the active lanes, for the interval test
+  uint32_t negative[3]; // Direction sign per axis, the same for every lane
+  float originLo[3], originHi[3], inverseLo[3], inverseHi[3];
+  float tminLo;
+
+  static PACKET_INLINE float& lane(F* v, uint32_t i) { return ((float*)v)[i]; }
+  static PACKET_INLINE float lane(const F* v, uint32_t i) { return ((const float*)v)[i]; }
+
+  static PACKET_INLINE uint32_t bitsOf(const I* mask) {
+    uint32_t result = 0;
+    for (uint32_t k = 0; k < K; k++) result |= bits<R>(mask[k]) << (k * R);
+    return result;
+  }
+  static PACKET_INLINE float lowest(const F* v, uint32_t mask) {
+    F result = splat<R>(INFINITY);
+    for (uint32_t k = 0; k < K; k++) result = vmin<R>(result, select<R>(expand<R>(mask >> (k * R)), v[k], splat<R>(INFINITY)));
+    return reduceMin<R>(result);
+  }
+  static PACKET_INLINE float highest(const F* v, uint32_t mask) {
+    F result = splat<R>(-INFINITY);
+    for (uint32_t k = 0; k < K; k++) result = vmax<R>(result, select<R>(expand<R>(mask >> (k * R)), v[k], splat<R>(-INFINITY)));
+    return reduceMax<R>(result);
+  }
+  // Lanes whose closest hit is at or beyond t
+  PACKET_INLINE uint32_t beyond(float t) const {
+    uint32_t result = 0;
+    for (uint32_t k = 0; k < K; k++) result |= bits<R>(closest[k] >= t) << (k * R);
+    return result;
+  }
+
+  // False when the lanes do not share direction signs. A 0 component becomes 1e-30 of the sign the
+  // other lanes have on its axis (positive when all are 0), in the inverse only, which makes it 1e30:
+  // the packet keeps a finite interval and axis aligned views stay on the packet path
+  PACKET_INLINE bool setup() {
+    const F* origin[3] = {ox, oy, oz};
+    const F* direction[3] = {dx, dy, dz};
+    F* inverse[3] = {ix, iy, iz};
+    F* scaled[3] = {oix, oiy, oiz};
+    for (int axis = 0; axis < 3; axis++) {
+      uint32_t positive = 0, below = 0;
+      for (uint32_t k = 0; k < K; k++) {
+        positive |= bits<R>(direction[axis][k] > 0.0f) << (k * R);
+        below |= bits<R>(direction[axis][k] < 0.0f) << (k * R);
+      }
+      positive &= active, below &= active;
+      if (positive && below) return false;
+      negative[axis] = below != 0;
+      const F tiny = splat<R>(negative[axis] ? -1e-30f : 1e-30f);
+      for (uint32_t k = 0; k < K; k++) {
+        inverse[axis][k] = 1.0f / select<R>(direction[axis][k] == 0.0f, tiny, direction[axis][k]);
+        scaled[axis][k] = origin[axis][k] * inverse[axis][k];
+      }
+      originLo[axis] = lowest(origin[axis], active), originHi[axis] = highest(origin[axis], active);
+      inverseLo[axis] = lowest(inverse[axis], active), inverseHi[axis] = highest(inverse[axis], active);
+      if (!std::isfinite(inverseLo[axis]) || !std::isfinite(inverseHi[axis])) return false;
+    }
+    tminLo = lowest(tmin, active);
+    return true;
+  }
+
+  // Interval arithmetic over the whole packet: false when no lane can enter the box before `reach`
+  PACKET_INLINE bool reaches(const float* lo, const float* hi, float reach) const {
+    float enter = tminLo, exit = reach;
+    for (int axis = 0; axis < 3; axis++) {
+      const float nearPlane = negative[axis] ? hi[axis] : lo[axis], farPlane = negative[axis] ? lo[axis] : hi[axis];
+      const float n0 = nearPlane - originHi[axis], n1 = nearPlane - originLo[axis];
+      const float f0 = farPlane - originHi[axis], f1 = farPlane - originLo[axis];
+      const float a = inverseLo[axis], b = inverseHi[axis];
+      enter = std::max(enter, std::min(std::min(n0 * a, n0 * b), std::min(n1 * a, n1 * b)));
+      exit = std::min(exit, std::max(std::max(f0 * a, f0 * b), std::max(f1 * a, f1 * b)));
+    }
+    return enter - exit <= INTERVAL_SLACK * (std::fabs(enter) + std::fabs(exit));
+  }
+
+  // The same for the eight children of a Bvh8 node at once, their planes being rows of eight, G at a
+  // time: a bit per child the packet may reach
+  PACKET_INLINE uint32_t reaches(const Renderer::Host::WideNode<8>& node, float reach) const {
+    constexpr uint32_t G = R < 8 ? R : 8;
+    typedef typename Lanes<G>::F FG;
+    uint32_t result = 0;
+    for (uint32_t g = 0; g < 8; g += G) {
+      FG enter = splat<G>(tminLo), exit = splat<G>(reach);
+      for (int axis = 0; axis < 3; axis++) {
+        FG nearPlane, farPlane;
+        std::memcpy(&nearPlane, node.bounds[2 * axis + negative[axis]] + g, sizeof(FG));
+        std::memcpy(&farPlane, node.bounds[2 * axis + 1 - negative[axis]] + g, sizeof(FG));
+        const FG n0 = nearPlane - originHi[axis], n1 = nearPlane - originLo[axis];
+        const FG f0 = farPlane - originHi[axis], f1 = farPlane - originLo[axis];
+        const float a = inverseLo[axis], b = inverseHi[axis];
+        enter = vmax<G>(enter, vmin<G>(vmin<G>(n0 * a, n0 * b), vmin<G>(n1 * a, n1 * b)));
+        exit = vmin<G>(exit, vmax<G>(vmax<G>(f0 * a, f0 * b), vmax<G>(f1 * a, f1 * b)));
+      }
+      const FG magnitude = vmax<G>(enter, -enter) + vmax<G>(exit, -exit);
+      result |= bits<G>(enter - exit <= magnitude * INTERVAL_SLACK) << g;
+    }
+    return result;
+  }
+
+  // Slab test per lane, as the wide BVH's: lanes of `mask` that enter the box before their closest hit,
+  // and the nearest of their entry distances
+  PACKET_INLINE uint32_t test(const float* lo, const float* hi, uint32_t mask, float& tEnter) const {
+    const F nearX = splat<R>(negative[0] ? hi[0] : lo[0]), farX = splat<R>(negative[0] ? lo[0] : hi[0]);
+    const F nearY = splat<R>(negative[1] ? hi[1] : lo[1]), farY = splat<R>(negative[1] ? lo[1] : hi[1]);
+    const F nearZ = splat<R>(negative[2] ? hi[2] : lo[2]), farZ = splat<R>(negative[2] ? lo[2] : hi[2]);
+    uint32_t result = 0;
+    F nearest = splat<R>(INFINITY);
+    for (uint32_t k = 0; k < K; k++) {
+      const F nx = nearX * ix[k] - oix[k], fx = farX * ix[k] - oix[k];
+      const F ny = nearY * iy[k] - oiy[k], fy = farY * iy[k] - oiy[k];
+      const F nz = nearZ * iz[k] - oiz[k], fz = farZ * iz[k] - oiz[k];
+      const F enter = vmax<R>(vmax<R>(nx, ny), vmax<R>(nz, tmin[k]));
+      const F exit = vmin<R>(vmin<R>(fx, fy), vmin<R>(fz, closest[k]));
+      const I entered = (enter <= exit) & expand<R>(mask >> (k * R));
+      result |= bits<R>(entered) << (k * R);
+      nearest = vmin<R>(nearest, select<R>(entered, enter, splat<R>(INFINITY)));
+    }
+    tEnter = reduceMin<R>(nearest);
+    return result;
+  }
+};
+
+template <uint32_t W, uint32_t R> struct LaneHits {
+  typename Lanes<R>::F u[W / R], v[W / R];
+  typename Lanes<R>::I entry[W / R]; // Of the structure's `triangles`, -1 for none
+
+  PACKET_INLINE void clear() {
+    for (uint32_t k = 0; k < W / R; k++) u[k] = v[k] = splat<R>(0.0f), entry[k] = typename Lanes<R>::I{} - 1;
+  }
+};
+
+// Möller-Trumbore on every lane of `mask`, the same steps as BvhTriangle::intersect
+template <uint32_t W, uint32_t R>
+PACKET_INLINE void intersect(const Renderer::Host::BvhTriangle& triangle, int32_t entry, Packet<W, R>& p, uint32_t mask, LaneHits<W, R>& hits) {
+  typedef typename Lanes<R>::F F;
+  typedef typename Lanes<R>::I I;
+  const packed3 v0 = triangle.v0, v1 = triangle.v1, v2 = triangle.v2;
+  const float e1x = v1.x - v0.x, e1y = v1.y - v0.y, e1z = v1.z - v0.z;
+  const float e2x = v2.x - v0.x, e2y = v2.y - v0.y, e2z = v2.z - v0.z;
+  for (uint32_t k = 0; k < W / R; k++) {
+    const I lanes = expand<R>(mask >> (k * R));
+    const F px = p.dy[k] * e2z - p.dz[k] * e2y, py = p.dz[k] * e2x - p.dx[k] * e2z, pz = p.dx[k] * e2y - p.dy[k] * e2x;
+    const F determinant = e1x * px + e1y * py + e1z * pz;
+    const F inv = 1.0f / determinant;
+    const F sx = p.ox[k] - v0.x, sy = p.oy[k] - v0.y, sz = p.oz[k] - v0.z;
+    const F u = (sx * px + sy * py + sz * pz) * inv;
+    const F qx = sy * e1z - sz * e1y, qy = sz * e1x - sx * e1z, qz = sx * e1y - sy * e1x;
+    const F v = (p.dx[k] * qx + p.dy[k] * qy + p.dz[k] * qz) * inv;
+    const F t = (e2x * qx + e2y * qy + e2z * qz) * inv;
+    const I hit = lanes & (determinant != 0.0f) & (u >= 0.0f) & (u <= 1.0f) & (v >= 0.0f) & (u + v <= 1.0f) &
+                  (t >= p.tmin[k]) & (t < p.closest[k]);
+    p.closest[k] = select<R>(hit, t, p.closest[k]);
+    hits.u[k] = select<R>(hit, u, hits.u[k]);
+    hits.v[k] = select<R>(hit, v, hits.v[k]);
+    hits.entry[k] = (hit & (I{} + entry)) | (~hit & hits.entry[k]);
+  }
+}
+
+inline uint32_t geometryOf(const Bvh8& wide, uint32_t primitive) {
+  return (uint32_t)(std::upper_bound(wide.geometryFirst.begin(), wide.geometryFirst.end(), primitive) - wide.geometryFirst.begin()) - 1;
+}
+
+// Closest hits of the lanes of `mask` in one bottom level structure, in its object space
+template <uint32_t W, uint32_t R>
+PACKET_INLINE void traverse(const Bvh8& wide, Packet<W, R>& p, uint32_t mask, LaneHits<W, R>& hits, PacketStats& stats) {
+  constexpr uint32_t N = 8;
+  struct Entry {
+    uint32_t child;
+    uint32_t count; // 0 for a node
+    uint32_t mask;
+    float t;
+  };
+  Entry stack[STACK_DEPTH * (N - 1)];
+  int top = 0;
+  Entry current = {0, 0, mask, -INFINITY};
+  while (true) {
+    if (current.count > 0) {
+      stats.triangles += current.count;
+      for (uint32_t i = current.child; i < current.child + current.count; i++) intersect(wide.triangles[i], (int32_t)i, p, current.mask, hits);
+    } else {
+      stats.nodes++;
+      const Renderer::Host::WideNode<N>& node = wide.nodes[current.child];
+      // Children hit, farthest first: the last one is next, the others wait on the stack
+      Entry children[N];
+      uint32_t count = 0;
+      const uint32_t reached = p.reaches(node, Packet<W, R>::highest(p.closest, current.mask));
+      for (uint32_t lane = 0; lane < N; lane++) {
+        if (node.child[lane] == Bvh8::EMPTY) continue;
+        if (!(reached >> lane & 1)) {
+          stats.culled++;
+          continue;
+        }
+        stats.laneTests++;
+        const float lo[3] = {node.bounds[0][lane], node.bounds[2][lane], node.bounds[4][lane]};
+        const float hi[3] = {node.bounds[1][lane], node.bounds[3][lane], node.bounds[5][lane]};
+        float t;
+        const uint32_t entered = p.test(lo, hi, current.mask, t);
+        if (!entered) continue;
+        const Entry entry = {node.child[lane], node.count[lane], entered, t};
+        uint32_t j = count++;
+        for (; j > 0 && children[j - 1].t < entry.t; j--) children[j] = children[j - 1];
+        children[j] = entry;
+      }
+      if (count > 0) {
+        for (uint32_t j = 0; j + 1 < count; j++) stack[top++] = children[j];
+        current = children[count - 1];
+        continue;
+      }
+    }
+    // Pop, dropping lanes whose closest hit is nearer than where the entry starts
+    do {
+      if (top == 0) return;
+      current = stack[--top];
+      current.mask &= p.beyond(current.t);
+    } while (!current.mask);
+  }
+}
+
+template <uint32_t W, uint32_t R> PACKET_INLINE void load(Packet<W, R>& p, const BvhRay* rays, uint32_t count) {
+  typedef Packet<W, R> P;
+  p.active = count >= 32 ? 0xFFFFFFFF : (1u << count) - 1;
+  for (uint32_t i = 0; i < W; i++) {
+    // Idle lanes repeat the first ray, so that they stay finite
+    const BvhRay& ray = rays[i < count ? i : 0];
+    P::lane(p.ox, i) = ray.origin.x, P::lane(p.oy, i) = ray.origin.y, P::lane(p.oz, i) = ray.origin.z;
+    P::lane(p.dx, i) = ray.direction.x, P::lane(p.dy, i) = ray.direction.y, P::lane(p.dz, i) = ray.direction.z;
+    P::lane(p.tmin, i) = ray.tmin, P::lane(p.closest, i) = ray.tmax;
+  }
+}
+
+// One packet: rays[0, count) with count <= W, closest hits (or BvhHit() on a miss) to *hits[i]
+template <uint32_t W, uint32_t R>
+PACKET_INLINE void trace(const Tlas<Bvh8>& tlas, const BvhRay* rays, uint32_t count, BvhHit* const* hits, uint32_t mask, PacketStats& stats) {
+  typedef Packet<W, R> P;
+  constexpr uint32_t K = P::K;
+  stats.packets++;
+  stats.rays += count;
+  for (uint32_t i = 0; i < count; i++) *hits[i] = BvhHit();
+  if (tlas.bvh.nodes.empty() || count == 0) return;
+
+  P p;
+  load(p, rays, count);
+  if (count == 1 || !p.setup()) {
+    for (uint32_t i = 0; i < count; i++) tlas.intersect(rays[i], *hits[i], mask);
+    stats.singleRays += count;
+    for (uint32_t i = 0; i < count; i++) stats.hits += hits[i]->t < INFINITY;
+    return;
+  }
+
+  struct Entry {
+    uint32_t node;
+    uint32_t mask;
+    float t;
+  };
+  Entry stack[TLAS_DEPTH * 2];
+  int top = 0;
+  Entry current = {0, 0, 0.0f};
+  {
+    const Renderer::Host::BvhNode& root = tlas.bvh.nodes[0];
+    if (!p.reaches(&root.min.x, &root.max.x, P::highest(p.closest, p.active))) return;
+    current.mask = p.test(&root.min.x, &root.max.x, p.active, current.t);
+    if (!current.mask) return;
+  }
+  uint32_t found = 0;
+  while (true) {
+    const Renderer::Host::BvhNode& node = tlas.bvh.nodes[current.node];
+    if (node.isLeaf()) {
+      for (uint32_t i = node.index; i < node.index + node.count; i++) {
+        const uint32_t id = tlas.bvh.primitives[i];
+        const Renderer::Host::Instance& instance = tlas.instances[id];
+        if (!(instance.mask & mask)) continue;
+        const Bvh8& blas = *tlas.structures[instance.accelerationStructureIndex];
+        const EXP::MATH::packed4x3& m = tlas.inverses[id];
+
+        // Object space lanes, same parameter t as the world space ones
+        P local;
+        for (uint32_t k = 0; k < K; k++) {
+          local.ox[k] = ((p.ox[k] * m.columns[0].x + p.oy[k] * m.columns[1].x) + p.oz[k] * m.columns[2].x) + m.columns[3].x;
+          local.oy[k] = ((p.ox[k] * m.columns[0].y + p.oy[k] * m.columns[1].y) + p.oz[k] * m.columns[2].y) + m.columns[3].y;
+          local.oz[k] = ((p.ox[k] * m.columns[0].z + p.oy[k] * m.columns[1].z) + p.oz[k] * m.columns[2].z) + m.columns[3].z;
+          local.dx[k] = (p.dx[k] * m.columns[0].x + p.dy[k] * m.columns[1].x) + p.dz[k] * m.columns[2].x;
+          local.dy[k] = (p.dx[k] * m.columns[0].y + p.dy[k] * m.columns[1].y) + p.dz[k] * m.columns[2].y;
+          local.dz[k] = (p.dx[k] * m.columns[0].z + p.dy[k] * m.columns[1].z) + p.dz[k] * m.columns[2].z;
+          local.tmin[k] = p.tmin[k], local.closest[k] = p.closest[k];
+        }
+        local.active = current.mask;
+
+        if (blas.isQuantized() || blas.nodes.empty() || !local.setup()) {
+          // Diverged in object space: this instance one lane at a time
+          for (uint32_t lane = 0; lane < W; lane++) {
+            if (!(current.mask >> lane & 1)) continue;
+            stats.singleRays++;
+            BvhRay ray;
+            ray.origin = {P::lane(local.ox, lane), P::lane(local.oy, lane), P::lane(local.oz, lane)};
+            ray.direction = {P::lane(local.dx, lane), P::lane(local.dy, lane), P::lane(local.dz, lane)};
+            ray.tmin = P::lane(local.tmin, lane), ray.tmax = P::lane(p.closest, lane);
+            BvhHit candidate;
+            if (!blas.intersect(ray, candidate)) continue;
+            *hits[lane] = candidate;
+            hits[lane]->instance = id;
+            P::lane(p.closest, lane) = candidate.t;
+            found |= 1u << lane;
+          }
+          continue;
+        }
+        LaneHits<W, R> laneHits;
+        laneHits.clear();
+        traverse(blas, local, current.mask, laneHits, stats);
+        const int32_t* entries = (const int32_t*)laneHits.entry;
+        for (uint32_t lane = 0; lane < W; lane++) {
+          if (entries[lane] < 0) continue;
+          const uint32_t entry = (uint32_t)entries[lane];
+          BvhHit& hit = *hits[lane];
+          hit.t = P::lane(local.closest, lane), hit.u = P::lane(laneHits.u, lane), hit.v = P::lane(laneHits.v, lane);
+          hit.primitive = blas.primitives[entry], hit.entry = entry, hit.instance = id;
+          hit.geometry = geometryOf(blas, hit.primitive);
+          found |= 1u << lane;
+        }
+        for (uint32_t k = 0; k < K; k++) p.closest[k] = local.closest[k];
+      }
+    } else {
+      stats.nodes++;
+      const float reach = P::highest(p.closest, current.mask);
+      Entry children[2];
+      uint32_t count = 0;
+      for (uint32_t c = node.index; c < node.index + 2; c++) {
+        const Renderer::Host::BvhNode& child = tlas.bvh.nodes[c];
+        if (!p.reaches(&child.min.x, &child.max.x, reach)) {
+          stats.culled++;
+          continue;
+        }
+        stats.laneTests++;
+        Entry entry = {c, 0, 0.0f};
+        entry.mask = p.test(&child.min.x, &child.max.x, current.mask, entry.t);
+        if (entry.mask) children[count++] = entry;
+      }
+      if (count == 2 && children[1].t < children[0].t) std::swap(children[0], children[1]);
+      if (count > 0) {
+        if (count == 2) stack[top++] = children[1];
+        current = children[0];
+        continue;
+      }
+    }
+    bool done = false;
+    do {
+      if (top == 0) {
+        done = true;
+        break;
+      }
+      current = stack[--top];
+      current.mask &= p.beyond(current.t);
+    } while (!current.mask);
+    if (done) break;
+  }
+  stats.hits += __builtin_popcount(found);
+}
+
+using Kernel = void (*)(const Tlas<Bvh8>&, const BvhRay*, uint32_t, BvhHit* const*, uint32_t, PacketStats&);
+
+void baseline8(const Tlas<Bvh8>& tlas, const BvhRay* rays, uint32_t count, BvhHit* const* hits, uint32_t mask, PacketStats& stats) {
+  trace<8, 4>(tlas, rays, count, hits, mask, stats);
+}
+void baseline16(const Tlas<Bvh8>& tlas, const BvhRay* rays, uint32_t count, BvhHit* const* hits, uint32_t mask, PacketStats& stats) {
+  trace<16, 4>(tlas, rays, count, hits, mask, stats);
+}
+
+#if EXP_PACKET_X86
+TARGET_AVX2 void avx2_8(const Tlas<Bvh8>& tlas, const BvhRay* rays, uint32_t count, BvhHit* const* hits, uint32_t mask, PacketStats& stats) {
+  trace<8, 8>(tlas, rays, count, hits, mask, stats);
+}
+TARGET_AVX2 void avx2_16(const Tlas<Bvh8>& tlas, const BvhRay* rays, uint32_t count, BvhHit* const* hits, uint32_t mask, PacketStats& stats) {
+  trace<16, 8>(tlas, rays, count, hits, mask, stats);
+}
+TARGET_AVX512 void avx512_8(const Tlas<Bvh8>& tlas, const BvhRay* rays, uint32_t count, BvhHit* const* hits, uint32_t mask, PacketStats& stats) {
+  trace<8, 8>(tlas, rays, count, hits, mask, stats);
+}
+// Two 8 lane registers: on 16 lanes every compare goes through a mask register and back, which
+// costs more than the second register saves
+TARGET_AVX512 void avx512_16(const Tlas<Bvh8>& tlas, const BvhRay* rays, uint32_t count, BvhHit* const* hits, uint32_t mask, PacketStats& stats) {
+  trace<16, 8>(tlas, rays, count, hits, mask, stats);
+}
+#endif
+
+void scalar(const Tlas<Bvh8>& tlas, const BvhRay* rays, uint32_t count, BvhHit* const* hits, uint32_t mask, PacketStats& stats) {
+  stats.packets++;
+  stats.rays += count, stats.singleRays += count;
+  for (uint32_t i = 0; i < count; i++) {
+    *hits[i] = BvhHit();
+    stats.hits += tlas.intersect(rays[i], *hits[i], mask);
+  }
+}
+
+inline uint32_t width(const PacketSettings& settings) { return settings.width == 16 ? 16 : 8; }
+
+Kernel kernel(const PacketIsa& isa, uint32_t lanes) {
+  switch (isa) {
+#if EXP_PACKET_X86
+  case PacketIsa::AVX2: return lanes == 16 ? avx2_16 : avx2_8;
+  case PacketIsa::AVX512: return lanes == 16 ? avx512_16 : avx512_8;
+#endif
+  case PacketIsa::BASELINE: return lanes == 16 ? baseline16 : baseline8;
+  default: return scalar;
+  }
+}
+
+PacketIsa detect() {
+#if EXP_PACKET_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return PacketIsa::AVX512;
+  if (__builtin_cpu_supports("avx2")) return PacketIsa::AVX2;
+#endif
+  return PacketIsa::BASELINE;
+}
+
+} // namespace
+
+
+void Renderer::Host::PacketStats::add(const PacketStats& other) {
+  rays += other.rays, hits += other.hits, packets += other.packets, singleRays += other.singleRays;
+  nodes += other.nodes, culled += other.culled, laneTests += other.laneTests, triangles += other.triangles;
+}
+
+PacketIsa Renderer::Host::PacketTracer::best() {
+  static const PacketIsa isa = detect();
+  return isa;
+}
+
+bool Renderer::Host::PacketTracer::supported(const PacketIsa& isa) { return (int)isa <= (int)best(); }
+
+const char* Renderer::Host::PacketTracer::name(const PacketIsa& isa) {
+  switch (isa) {
+#if EXP_PACKET_X86
+  case PacketIsa::BASELINE: return "sse2";
+#elif defined(__ARM_NEON)
+  case PacketIsa::BASELINE: return "neon";
+#else
+  case PacketIsa::BASELINE: return "vector";
+#endif
+  case PacketIsa::AVX2: return "avx2";
+  case PacketIsa::AVX512: return "avx-512";
+  default: return "scalar";
+  }
+}
+
+PacketStats Renderer::Host::PacketTracer::intersect(
+  const Tlas<Bvh8>& tlas,
+  const BvhRay* rays,
+  size_t count,
+  BvhHit* hits,
+  const PacketSettings& settings,
+  EXP::THREAD::Pool& pool
+) {
+  return intersect(tlas, rays, count, hits, settings, best(), pool);
+}
+
+PacketStats Renderer::Host::PacketTracer::intersect(
+  const Tlas<Bvh8>& tlas,
+  const BvhRay* rays,
+  size_t count,
+  BvhHit* hits,
+  const PacketSettings& settings,
+  const PacketIsa& isa,
+  EXP::THREAD::Pool& pool
+) {
+  const auto start = std::chrono::steady_clock::now();
+  const Kernel trace = kernel(supported(isa) ? isa : best(), width(settings));
+  const uint32_t lanes = width(settings);
+  PacketStats result;
+  std::mutex mutex;
+  pool.parallelFor(
+    (count + lanes - 1) / lanes,
+    PACKET_GRAIN,
+    [&](size_t begin, size_t end) {
+      PacketStats stats;
+      BvhHit* out[16];
+      for (size_t packet = begin; packet < end; packet++) {
+        const size_t first = packet * lanes;
+        const uint32_t n = (uint32_t)std::min<size_t>(lanes, count - first);
+        for (uint32_t i = 0; i < n; i++) out[i] = hits + first + i;
+        trace(tlas, rays + first, n, out, settings.mask, stats);
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      result.add(stats);
+    },
+    settings.threads
+  );
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+PacketStats Renderer::Host::PacketTracer::primary(
+  const Tlas<Bvh8>& tlas,
+  const VCamera& camera,
+  std::vector<BvhHit>& hits,
+  const PacketSettings& settings,
+  EXP::THREAD::Pool& pool
+) {
+  return primary(tlas, camera, hits, settings, best(), pool);
+}
+
+PacketStats Renderer::Host::PacketTracer::primary(
+  const Tlas<Bvh8>& tlas,
+  const VCamera& camera,
+  std::vector<BvhHit>& hits,
+  const PacketSettings& settings,
+  const PacketIsa& isa,
+  EXP::THREAD::Pool& pool
+) {
+  const auto start = std::chrono::steady_clock::now();
+  const uint32_t w = (uint32_t)camera.resolution.x, h = (uint32_t)camera.resolution.y;
+  hits.assign((size_t)w * h, BvhHit());
+  const Kernel trace = kernel(supported(isa) ? isa : best(), width(settings));
+  // 4 x 2 or 4 x 4 pixel blocks: square enough that a block stays inside few leaves
+  const uint32_t blockWidth = 4, blockHeight = width(settings) / 4;
+
+  EXP::THREAD::TileSettings tiles;
+  tiles.size = std::max(settings.tileSize, 1u);
+  tiles.threads = settings.threads;
+  std::vector<PacketStats> workers(EXP::THREAD::TileScheduler::workers(tiles, pool));
+  EXP::THREAD::TileScheduler::run(
+    w,
+    h,
+    [&](const EXP::THREAD::Tile& tile, unsigned int worker) {
+      BvhRay rays[16];
+      BvhHit* out[16];
+      for (uint32_t by = tile.y; by < tile.y + tile.height; by += blockHeight) {
+        for (uint32_t bx = tile.x; bx < tile.x + tile.width; bx += blockWidth) {
+          uint32_t n = 0;
+          for (uint32_t y = by; y < std::min(by + blockHeight, tile.y + tile.height); y++) {
+            for (uint32_t x = bx; x < std::min(bx + blockWidth, tile.x + tile.width); x++) {
+              rays[n] = primaryRay(camera, x, y);
+              out[n++] = &hits[(size_t)y * w + x];
+            }
+          }
+          trace(tlas, rays, n, out, settings.mask, workers[worker]);
+        }
+      }
+    },
+    tiles,
+    pool
+  );
+
+  PacketStats result;
+  for (const PacketStats& stats : workers) result.add(stats);
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <Renderer/HostBvh.h>
+#include <Renderer/HostInstance.h>
+#include <Renderer/HostTypes.h>
+#include <Renderer/HostWideBvh.h>
+#include <Thread/Pool.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Ray packets for coherent rays: the orthographic primary rays of build_ray all share one direction,
+ * so 8 or 16 of them side by side visit nearly the same nodes. A packet walks the Tlas<Bvh8> once
+ * for all of its rays, with every box and triangle tested against all lanes at once.
+ *
+ * Rays are held structure of arrays, each component in 8 lane registers on AVX2 and AVX-512 and in
+ * 4 lane ones on the 128 bit baseline (SSE2, NEON), two to four per packet. The kernel is written in
+ * the compiler's vector extensions, as the wide BVH's, and compiled once per instruction set with
+ * target attributes; PacketTracer::best picks the widest the CPU has at run time, as the Tokenizer
+ * does.
+ *
+ * Before the lanes are tested against a child box, the packet as a whole is: the interval of its
+ * origins times the interval of its inverse directions bounds every lane's entry and exit distance,
+ * and a box the interval misses is culled for all rays with a few scalar operations. For parallel
+ * rays the interval is the beam around the packet. Boxes it does reach are tested per lane, and the
+ * child goes on the stack with the mask of lanes that enter it before their closest hit.
+ *
+ * A 0 direction component counts as the sign of the packet's other lanes on that axis, its inverse
+ * as 1e30 of that sign, so that views along an axis keep their interval. Packets whose directions
+ * differ in sign on some axis have none: their rays go through Tlas::intersect one by one, as do
+ * those of an instance whose transform makes them diverge, through that instance's structure. Both
+ * paths find the same closest hits, up to rounding (a fused multiply-add on some targets); a ray
+ * that hits nothing gets BvhHit(), t INFINITY.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+enum struct PacketIsa {
+  SCALAR = 0,   // One ray at a time through Tlas::intersect
+  BASELINE = 1, // 128 bit vectors: SSE2 on x86, NEON on ARM
+  AVX2 = 2,
+  AVX512 = 3    // AVX-512F
+};
+
+struct PacketSettings {
+  uint32_t width = 8;        // Rays per packet: 8 or 16. Primary rays are packed in 4 x 2 or 4 x 4 pixel blocks
+  unsigned int threads = 0;  // Pool threads to use, 0 for all of them
+  uint32_t tileSize = 16;    // primary(): tile edge handed to the TileScheduler
+  uint32_t mask = 0xFF;      // Instance mask, as Tlas::intersect's
+};
+
+struct PacketStats {
+  double seconds = 0.0;
+  uint64_t rays = 0;
+  uint64_t hits = 0;
+  uint64_t packets = 0;
+  uint64_t singleRays = 0; // Rays that fell back to single ray traversal
+  uint64_t nodes = 0;      // Nodes a packet visited
+  uint64_t culled = 0;     // Child boxes the packet interval rejected before any lane test
+  uint64_t laneTests = 0;  // Child boxes tested lane by lane
+  uint64_t triangles = 0;  // Triangles tested against a packet
+
+  inline double raysPerSecond() const { return seconds > 0.0 ? rays / seconds : 0.0; }
+  void add(const PacketStats& other);
+};
+
+class PacketTracer {
+public:
+  PacketTracer(){};
+  ~PacketTracer(){};
+
+public: // Dispatch
+  static PacketIsa best();
+  static bool supported(const PacketIsa& isa);
+  static const char* name(const PacketIsa& isa);
+
+public:
+  // Closest hits of `count` rays, packed settings.width consecutive rays at a time
+  static PacketStats intersect(
+    const Tlas<Bvh8>& tlas,
+    const BvhRay* rays,
+    size_t count,
+    BvhHit* hits,
+    const PacketSettings& settings = {},
+    EXP::THREAD::Pool& pool = EXP::THREAD::Pool::shared()
+  );
+  static PacketStats intersect(
+    const Tlas<Bvh8>& tlas,
+    const BvhRay* rays,
+    size_t count,
+    BvhHit* hits,
+    const PacketSettings& settings,
+    const PacketIsa& isa,
+    EXP::THREAD::Pool& pool = EXP::THREAD::Pool::shared()
+  );
+  // The primary ray of every pixel of camera.resolution (primaryRay in HostCamera.h), hits[y * width + x]
+  static PacketStats primary(
+    const Tlas<Bvh8>& tlas,
+    const VCamera& camera,
+    std::vector<BvhHit>& hits,
+    const PacketSettings& settings = {},
+    EXP::THREAD::Pool& pool = EXP::THREAD::Pool::shared()
+  );
+  static PacketStats primary(
+    const Tlas<Bvh8>& tlas,
+    const VCamera& camera,
+    std::vector<BvhHit>& hits,
+    const PacketSettings& settings,
+    const PacketIsa& isa,
+    EXP::THREAD::Pool& pool = EXP::THREAD::Pool::shared()
+  );
+};
+
+}; // namespace Host
+}; // namespace Renderer
@@ -0,0 +1,667 @@
+#include <Renderer/HostBuffer.h>
+#include <Renderer/HostMipmap.h>
+#include <Renderer/HostRestir.h>
+#include <Thread/Pool.h>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <functional>
+
+using EXP::MATH::float2;
+using EXP::MATH::float3;
+using EXP::MATH::float4;
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhRay;
+using Renderer::Host::Image;
+using Renderer::Host::PixelFormat;
+using Renderer::Host::PrimitiveAttributes;
+using Renderer::Host::RestirScene;
+using Renderer::Host::RestirSettings;
+using Renderer::Host::RestirStats;
+
+
+namespace {
+
+constexpr size_t ROW_GRAIN = 4;
+constexpr size_t PATH_GRAIN = 256; // Paths per parallelFor block of a wavefront stage
+constexpr float PI = 3.14159265358979f; // M_PI_F
+constexpr float4 SKY = {0.3f, 0.4f, 0.5f, 1.0f};
+constexpr float3 LUMINANCE = {0.2126f, 0.7152f, 0.0722f};
+
+// Metal's ray
+struct Ray {
+  float3 origin;
+  float3 direction;
+  float min_distance = 0.0f;
+  float max_distance = FLT_MAX;
+};
+
+// What the intersector's result gives the kernel
+struct Intersection {
+  float distance = 0.0f;
+  float2 bary = {0.0f, 0.0f};       // triangle_barycentric_coord
+  uint32_t primitive_id = 0;        // Within its geometry
+  const PrimitiveAttributes* prim = nullptr;
+  const EXP::MATH::packed4x3* object_to_world = nullptr;
+};
+
+inline float4 f4(const float3& v, float w) { return {v.x, v.y, v.z, w}; }
+inline float length(const float4& v) { return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z); } // Of .xyz
+inline float fract(float v) { return v - std::floor(v); }
+
+// A float assigned to a uint: truncated and saturated, as the GPU converts
+inline uint32_t toUint(float value) {
+  if (!(value > 0.0f)) return 0;
+  return value >= 4294967296.0f ? 0xFFFFFFFFu : (uint32_t)value;
+}
+
+// RTUtils.h
+inline uint32_t pcg_hash(uint32_t input) {
+  const uint32_t state = input * 747796405u + 2891336453u;
+  const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+inline float rand(uint32_t& seed) {
+  seed = pcg_hash(seed);
+  return (float)seed / (float)0xffffffff;
+}
+
+inline float3 uniform_pdf(uint32_t& seed) {
+  const float x = rand(seed), y = rand(seed), z = rand(seed);
+  return EXP::MATH::normalize(float3{x, y, z} * 2.0f - float3{1.0f, 1.0f, 1.0f});
+}
+
+inline float3 vec_perpendicular(const float3& u) {
+  const float3 a = {std::fabs(u.x), std::fabs(u.y), std::fabs(u.z)};
+  const uint32_t xm = ((a.x - a.y) < 0 && (a.x - a.z) < 0) ? 1 : 0;
+  const uint32_t ym = (a.y - a.z) < 0 ? (1 ^ xm) : 0;
+  const uint32_t zm = 1 ^ (xm | ym);
+  return EXP::MATH::cross(u, float3{(float)xm, (float)ym, (float)zm});
+}
+
+inline float3 rand_hemisphere(uint32_t& seed, const float3& normal) {
+  const float px = rand(seed), py = rand(seed);
+  const float3 bitangent = vec_perpendicular(normal);
+  const float3 tangent = EXP::MATH::cross(bitangent, normal);
+  const float r = std::sqrt(std::max(0.0f, 1.0f - px * px));
+  const float phi = 2.0f * 3.14159265f * py;
+  return tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * px;
+}
+
+inline float lambertian(const float3& wi, const float3& normal) {
+  return std::max(EXP::MATH::dot(EXP::MATH::normalize(wi), normal), 0.0f);
+}
+
+// RayUtils.h
+void update_reservoir(float4& reservoir, int light_indices, float p_hat_weight, uint32_t& seed) {
+  reservoir.x += p_hat_weight;
+  reservoir.z += 1.0f;
+  const float random = rand(seed);
+  if (random <= (p_hat_weight / std::max(reservoir.x, 1e-6f))) reservoir.y = (float)light_indices;
+}
+
+bool intersect_ground_plane(Ray& r, float plane_y, float& distance, float3& vec_normal, float4& color) {
+  const float denom = r.direction.y;
+  if (std::fabs(denom) < 1e-6f) return false;
+  distance = (plane_y - r.origin.y) / denom;
+  if (distance < r.min_distance || distance > r.max_distance) return false;
+
+  r.origin = r.origin + r.direction * distance;
+  vec_normal = {0.0f, 1.0f, 0.0f};
+
+  // Grid pattern as the surface color
+  const float line = std::min(std::fabs(fract(r.origin.x * 5.0f) - 0.5f), std::fabs(fract(r.origin.z * 5.0f) - 0.5f));
+  color = line <= 0.01f ? float4{0.1f, 0.1f, 0.1f, 1.0f} : float4{0.3f, 0.3f, 0.3f, 1.0f};
+  return true;
+}
+
+// What temporal_reuse carries from one traced ray to the next, so that a pixel's rays may be traced
+// a stage at a time for many pixels (wavefront) as well as one after the other
+struct Path {
+  uint32_t x = 0, y = 0;
+  Ray r;
+  float4 color = {0.0f, 0.0f, 0.0f, 0.0f};
+  float3 vec_normal = {0.0f, 0.0f, 0.0f};
+  uint32_t seed = 0;
+  bool alive = true; // Waiting on a traced ray; `result` is final otherwise
+
+  // Resampling
+  float4 curr_reservoir = {0.0f, 0.0f, 0.0f, 0.0f};
+  float4 combined_reservoir = {0.0f, 0.0f, 0.0f, 0.0f};
+  float3 vec_to_light, vec_world_light_pos;
+  float4 vec_light_col;
+  float distance_to_light = 0.0f, l_dot_n = 0.0f, complex_pdf_sample = 0.0f;
+  float3 shade;
+  float n_dot_l = 0.0f;
+
+  // transport_ray's bounce
+  float4 contribution = {1.0f, 1.0f, 1.0f, 1.0f};
+  float4 wo_color, light_color;
+  float wi_dot_n = 0.0f, mis_weight = 0.0f;
+  int light_index = 0;
+
+  float3 shadow_target; // What the shadow ray in flight must reach for its light to be visible
+  float4 result = {0.0f, 0.0f, 0.0f, 0.0f};
+};
+
+// One pixel's kernel invocation, cut where it traces a ray; counts the rays it traces
+struct Kernel {
+  const RestirScene& scene;
+  float groundPlane = -0.2f;
+  bool occlusion = true;
+  uint64_t primaryRays = 0;
+  uint64_t shadowRays = 0;
+  uint64_t bounceRays = 0;
+
+  static BvhRay toBvh(const Ray& r) {
+    BvhRay ray;
+    ray.origin = EXP::MATH::p3(r.origin);
+    ray.direction = EXP::MATH::p3(r.direction);
+    ray.tmin = r.min_distance;
+    ray.tmax = r.max_distance;
+    return ray;
+  }
+
+  BvhHit trace(const BvhRay& ray) const {
+    BvhHit hit;
+    scene.structure->intersect(ray, hit);
+    return hit;
+  }
+
+  // What the intersector's result gives the kernel, false for a miss (t INFINITY)
+  bool intersection(const BvhHit& hit, Intersection& result) const {
+    if (!(hit.t < INFINITY)) return false;
+    static const PrimitiveAttributes none = {};
+    const Renderer::Host::Instance& instance = scene.structure->instances[hit.instance];
+    const Renderer::Host::Bvh8& blas = *scene.structure->structures[instance.accelerationStructureIndex];
+    const uint32_t index = instance.accelerationStructureIndex;
+    result.distance = hit.t;
+    result.bary = {hit.u, hit.v};
+    result.primitive_id = hit.primitive - blas.geometryFirst[hit.geometry];
+    result.prim = index < scene.primitives.size() && hit.primitive < scene.primitives[index].size()
+                    ? &scene.primitives[index][hit.primitive] : &none;
+    result.object_to_world = &instance.transformationMatrix;
+    return true;
+  }
+
+  float3 normal(const Intersection& result) const {
+    const float3 bary = {1.0f - result.bary.x - result.bary.y, result.bary.x, result.bary.y};
+    const PrimitiveAttributes& prim = *result.prim;
+    const float3 n = prim.normal[0] * bary.x + prim.normal[1] * bary.y + prim.normal[2] * bary.z;
+    return EXP::MATH::normalize(EXP::MATH::transformVector(*result.object_to_world, n));
+  }
+
+  // Texture plus primitive color, wo_color
+  float4 surface(const Intersection& result) const {
+    const float3 bary = {1.0f - result.bary.x - result.bary.y, result.bary.x, result.bary.y};
+    const PrimitiveAttributes& prim = *result.prim;
+    const float2 txcoord = prim.txcoord[0] * bary.x + prim.txcoord[1] * bary.y + prim.txcoord[2] * bary.z;
+    const uint32_t texture = prim.flags.x;
+    const float4 sampled = texture < scene.textures.size()
+                             ? Renderer::Host::RestirRenderer::sample(scene.textures[texture], txcoord) : float4{0.0f, 0.0f, 0.0f, 0.0f};
+    return sampled + prim.color[0];
+  }
+
+  // The ray shadow_ray traces from s towards the light; an occlusion query stops short of it
+  BvhRay shadow_ray(const Ray& s, const float3& vec_to_light, const float3& vec_light_origin) {
+    Ray shadow = s;
+    shadow.min_distance = 0.001f; // Set to avoid self-occlusion
+    if (occlusion) shadow.max_distance = std::sqrt(EXP::MATH::distance_squared(vec_light_origin, s.origin)) - 0.001f;
+    shadow.direction = vec_to_light;
+    shadowRays++;
+    return toBvh(shadow);
+  }
+
+  // shadow_ray's answer, nothing in the way with occlusion, else a closest hit on the light itself
+  bool lit(const BvhRay& s, const float3& vec_light_origin) const {
+    return occlusion ? !scene.structure->occluded(s) : visible(s, trace(s), vec_light_origin);
+  }
+
+  // The closest hit is the light itself
+  static bool visible(const BvhRay& s, const BvhHit& hit, const float3& vec_light_origin) {
+    if (!(hit.t < INFINITY)) return false;
+    const float3 origin = EXP::MATH::f3(s.origin) + EXP::MATH::f3(s.direction) * hit.t;
+    return std::sqrt(EXP::MATH::distance_squared(vec_light_origin, origin)) < 0.001f;
+  }
+
+  void sample_light(
+    int light_index,
+    const float3& vec_ray_world_pos,
+    float3& vec_world_light_pos,
+    float3& vec_to_light,
+    float4& vec_light_col,
+    float& distance_to_light
+  ) const {
+    const Renderer::Host::RestirLight& light = scene.light;
+    // A reservoir from before the light changed may point past it, where the GPU would read garbage
+    light_index = std::clamp(light_index, 0, (int)light.vertices.size() - 1);
+    vec_world_light_pos = EXP::MATH::transformPoint(light.orientation, EXP::MATH::f3(light.vertices[light_index]));
+    vec_to_light = EXP::MATH::normalize(vec_world_light_pos - vec_ray_world_pos);
+    vec_light_col = light.attributes[light_index].color;
+    distance_to_light = EXP::MATH::distance_squared(vec_world_light_pos, vec_ray_world_pos);
+  }
+
+  bool color_ray(Ray& r, const BvhHit& hit, uint32_t x, uint32_t y, float4& color, float3& vec_normal, uint32_t& seed, bool& light) {
+    const float4 contribution = {1.0f, 1.0f, 1.0f, 1.0f};
+    Intersection intersection;
+    if (!this->intersection(hit, intersection)) {
+      color += contribution * SKY;
+      return false;
+    }
+
+    vec_normal = normal(intersection);
+    r.origin = r.origin + r.direction * intersection.distance;
+    const float pid = (float)intersection.primitive_id;
+    seed = toUint((float)x * (pid * intersection.bary.y) + (float)y * (pid * intersection.bary.y));
+    const float3 jittered_normal = EXP::MATH::normalize(vec_normal + uniform_pdf(seed) * 0.0f);
+    r.direction = EXP::MATH::reflect(r.direction, jittered_normal);
+    const float wi_dot_n = lambertian(r.direction, vec_normal);
+
+    color += contribution * surface(intersection);
+    light = intersection.prim->flags.y;
+    if (!light) color = color * wi_dot_n;
+    return true;
+  }
+
+  // Up to the bounce's shadow ray; false when the bounce hits nothing
+  bool shade_ray(Path& p, const BvhHit& hit, BvhRay& shadow) {
+    Ray& r = p.r;
+    float3 vec_to_light;
+    float distance_to_light = 0.0f;
+
+    Intersection result;
+    if (!intersection(hit, result)) return false;
+
+    const float3 normal = this->normal(result);
+    const float pid = (float)result.primitive_id;
+    p.seed = toUint((float)p.x * (pid * result.bary.y * 1.0f) + (float)p.y * (pid * result.bary.y));
+
+    r.origin = r.origin + r.direction * result.distance;
+    const float3 jittered_normal = EXP::MATH::normalize(normal + uniform_pdf(p.seed) * 0.1f);
+    r.direction = EXP::MATH::reflect(r.direction, jittered_normal);
+
+    // Direct lighting contribution, from one light sampled uniformly
+    const int vertexCount = (int)scene.light.vertices.size();
+    p.light_index = std::min((int)(rand(p.seed) * vertexCount), vertexCount - 1);
+    sample_light(p.light_index, r.origin, p.shadow_target, vec_to_light, p.light_color, distance_to_light);
+    const float3 wi = EXP::MATH::normalize(vec_to_light);
+    p.wi_dot_n = std::max(EXP::MATH::dot(normal, wi), 0.0f);
+
+    // MIS weight (balance heuristic)
+    const float p_light = 1.0f / vertexCount;
+    const float p_bsdf = p.wi_dot_n / PI;
+    p.mis_weight = p_light / (p_light + p_bsdf);
+
+    p.wo_color = surface(result);
+    shadow = shadow_ray(r, vec_to_light, p.shadow_target);
+    return true;
+  }
+
+  // The rest of shade_ray, once its shadow ray is traced
+  void shade_ray(Path& p, bool visible) {
+    const float4 weighted_contribution = p.wo_color * p.light_color * ((float)visible * p.wi_dot_n * p.mis_weight);
+
+    // As the kernel has it, the contribution doubles as a reservoir
+    update_reservoir(p.contribution, p.light_index, length(weighted_contribution), p.seed);
+  }
+
+  // dot(color / pi * light * cos / distance², luminance) / pdf: the target function of the kernel
+  inline float p_hat(const float4& color, const float4& light, float l_dot_n, float distance, float pdf) const {
+    return EXP::MATH::dot(EXP::MATH::xyz(color) / PI * EXP::MATH::xyz(light) * l_dot_n / distance, LUMINANCE) / pdf;
+  }
+
+  // temporal_reuse, from here on in stages: the primary ray
+  BvhRay camera(Path& p, uint32_t x, uint32_t y) const {
+    p.x = x, p.y = y;
+    p.seed = (1 + x) * (y - x) + (1 + y) * (x + y);
+    const BvhRay primary = Renderer::Host::primaryRay(scene.camera, x, y);
+    p.r = {EXP::MATH::f3(primary.origin), EXP::MATH::f3(primary.direction), primary.tmin, FLT_MAX};
+    return toBvh(p.r);
+  }
+
+  // Shading and resampling; the shadow ray for the current reservoir, or false when the pixel is done
+  bool primary(Path& p, const BvhHit& primary_hit, BvhRay& shadow) {
+    Ray& r = p.r;
+    bool hit = false, light = false;
+    Ray ground_r = r;
+    float distance = 0.0f;
+    primaryRays++;
+    p.alive = false;
+    if (!(hit = color_ray(r, primary_hit, p.x, p.y, p.color, p.vec_normal, p.seed, light))) {
+      if ((hit = intersect_ground_plane(ground_r, groundPlane, distance, p.vec_normal, p.color))) r = ground_r;
+    }
+    p.result = p.color;
+    if (!hit || light) return false;
+
+    // Global illumination: resample candidate lights into a reservoir
+    const int vertexCount = (int)scene.light.vertices.size();
+    p.result = {0.0f, 0.0f, 0.0f, 0.0f};
+    if (vertexCount == 0) return false;
+    const float uniform_pdf_sample = 1.0f / vertexCount;
+
+    for (int i = 0; i < std::min(vertexCount, 32); i += 1) {
+      const int light_index = std::min((int)(rand(p.seed) * vertexCount), vertexCount - 1);
+      sample_light(light_index, r.origin, p.vec_world_light_pos, p.vec_to_light, p.vec_light_col, p.distance_to_light);
+      p.l_dot_n = lambertian(p.vec_to_light, p.vec_normal);
+      p.complex_pdf_sample = p_hat(p.color, p.vec_light_col, p.l_dot_n, p.distance_to_light, uniform_pdf_sample);
+      update_reservoir(p.curr_reservoir, light_index, p.complex_pdf_sample, p.seed);
+    }
+
+    // Retrieve final selected weight
+    sample_light((int)p.curr_reservoir.y, r.origin, p.vec_world_light_pos, p.vec_to_light, p.vec_light_col, p.distance_to_light);
+    p.l_dot_n = lambertian(p.vec_to_light, p.vec_normal);
+    p.complex_pdf_sample = p_hat(p.color, p.vec_light_col, p.l_dot_n, p.distance_to_light, uniform_pdf_sample);
+    p.curr_reservoir.w = (p.curr_reservoir.x / p.curr_reservoir.z) / std::max(p.complex_pdf_sample, 1e-4f);
+
+    // Shadow ray for current reservoir
+    shadow = shadow_ray(r, p.vec_to_light, p.vec_world_light_pos);
+    p.shadow_target = p.vec_world_light_pos;
+    p.alive = true;
+    return true;
+  }
+
+  // Temporal reuse with the current reservoir's visibility; the combined reservoir's shadow ray and
+  // the bounce
+  void resample(Path& p, bool visible, float4& prev_frame, BvhRay& shadow, BvhRay& bounce) {
+    Ray& r = p.r;
+    const float uniform_pdf_sample = 1.0f / (int)scene.light.vertices.size();
+    float4& curr_reservoir = p.curr_reservoir;
+    curr_reservoir.w *= (float)visible;
+
+    // Add current reservoir to combined reservoir
+    float4& combined_reservoir = p.combined_reservoir;
+    update_reservoir(combined_reservoir, (int)curr_reservoir.y, p.complex_pdf_sample * curr_reservoir.w * curr_reservoir.z, p.seed);
+
+    // Add previous reservoir to combined reservoir
+    float4 prev_reservoir = prev_frame;
+    sample_light((int)prev_reservoir.y, r.origin, p.vec_world_light_pos, p.vec_to_light, p.vec_light_col, p.distance_to_light);
+    p.l_dot_n = lambertian(p.vec_to_light, p.vec_normal);
+    const float prev_p_hat_weight =
+      EXP::MATH::length(EXP::MATH::xyz(p.color) / PI * EXP::MATH::xyz(p.vec_light_col) * p.l_dot_n / p.distance_to_light) / uniform_pdf_sample;
+    prev_reservoir.z = std::min(20.0f * curr_reservoir.z, prev_reservoir.z);
+    update_reservoir(combined_reservoir, (int)prev_reservoir.y, prev_p_hat_weight * prev_reservoir.w * prev_reservoir.z, p.seed);
+
+    // Set sample size and adjusted weight of combined reservoir
+    combined_reservoir.z = curr_reservoir.z + prev_reservoir.z;
+    sample_light((int)combined_reservoir.y, r.origin, p.vec_world_light_pos, p.vec_to_light, p.vec_light_col, p.distance_to_light);
+    p.l_dot_n = lambertian(p.vec_to_light, p.vec_normal);
+    p.complex_pdf_sample = p_hat(p.color, p.vec_light_col, p.l_dot_n, p.distance_to_light, uniform_pdf_sample);
+    combined_reservoir.w = (combined_reservoir.x / combined_reservoir.z) / std::max(p.complex_pdf_sample, 1e-4f);
+
+    // Shadow ray for combined reservoir
+    shadow = shadow_ray(r, p.vec_to_light, p.vec_world_light_pos);
+    p.shadow_target = p.vec_world_light_pos;
+    prev_frame = combined_reservoir;
+
+    // Indirect illumination: one bounce in a uniformly sampled direction
+    r.direction = rand_hemisphere(p.seed, p.vec_normal);
+    p.n_dot_l = lambertian(r.direction, p.vec_normal);
+    bounceRays++;
+    bounce = toBvh(r);
+  }
+
+  // With the combined reservoir's visibility, through transport_ray: the bounce's shadow ray, or false
+  // when the pixel is done
+  bool transport_ray(Path& p, bool visible, const BvhHit& hit, BvhRay& shadow) {
+    p.shade = EXP::MATH::xyz(p.color) / PI * EXP::MATH::xyz(p.vec_light_col) * p.l_dot_n / p.distance_to_light *
+              ((float)visible * p.combined_reservoir.w);
+    if (shade_ray(p, hit, shadow)) return true;
+    p.alive = false;
+    p.result = transported(p);
+    return false;
+  }
+
+  // With the bounce's shadow ray traced
+  void finish(Path& p, bool visible) {
+    shade_ray(p, visible);
+    p.alive = false;
+    p.result = transported(p);
+  }
+
+  // One bounce, so transport_ray's loop has ended
+  float4 transported(const Path& p) const {
+    float4 color = {0.0f, 0.0f, 0.0f, 0.0f};
+    color += p.contribution * SKY;
+    const float sample_probability = 1.0f / (2.0f * PI);
+    const float3 indirect = EXP::MATH::xyz(color) * p.n_dot_l * EXP::MATH::xyz(p.color) / PI / sample_probability;
+    return f4(indirect + p.shade, 2.0f); // Both written with alpha 1, summed
+  }
+
+  // The stages one after the other, each ray traced as it comes
+  float4 temporal_reuse(uint32_t x, uint32_t y, float4& prev_frame) {
+    if (!scene.structure) return {0.0f, 0.0f, 0.0f, 0.0f};
+    Path p;
+    BvhRay shadow, bounce;
+    if (!primary(p, trace(camera(p, x, y)), shadow)) return p.result;
+    resample(p, lit(shadow, p.shadow_target), prev_frame, shadow, bounce);
+    const bool visible = lit(shadow, p.shadow_target);
+    if (transport_ray(p, visible, trace(bounce), shadow)) finish(p, lit(shadow, p.shadow_target));
+    return p.result;
+  }
+};
+
+inline uint8_t unorm(float value) { return (uint8_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); }
+// NaN, from a degenerate normal or a zero light distance, is stored as 0 by the GPU
+inline float number(float value) { return value == value ? value : 0.0f; }
+
+// Texel in linear light, coordinates clamped to the edge
+inline float4 texel(const Image& texture, int x, int y) {
+  x = std::clamp(x, 0, (int)texture.width - 1), y = std::clamp(y, 0, (int)texture.height - 1);
+  const uint8_t* p = texture.row((uint32_t)y) + (size_t)x * texture.bytesPerPixel();
+  if (texture.format == PixelFormat::RGBA16F) {
+    float values[4];
+    Renderer::Host::Half::toFloats(reinterpret_cast<const uint16_t*>(p), values, 4);
+    return {values[0], values[1], values[2], values[3]};
+  }
+  if (texture.format == PixelFormat::RGBA8_SRGB) {
+    using Renderer::Host::Mipmap;
+    return {Mipmap::toLinear(p[0]), Mipmap::toLinear(p[1]), Mipmap::toLinear(p[2]), p[3] * (1.0f / 255.0f)};
+  }
+  return {p[0] * (1.0f / 255.0f), p[1] * (1.0f / 255.0f), p[2] * (1.0f / 255.0f), p[3] * (1.0f / 255.0f)};
+}
+
+inline void store(Image& image, uint32_t x, uint32_t y, const float4& color) {
+  uint8_t* pixel = image.row(y) + 4 * (size_t)x;
+  pixel[0] = Renderer::Host::Mipmap::toSrgb(number(color.x));
+  pixel[1] = Renderer::Host::Mipmap::toSrgb(number(color.y));
+  pixel[2] = Renderer::Host::Mipmap::toSrgb(number(color.z));
+  pixel[3] = unorm(number(color.w));
+}
+
+// settings.wavefront: the kernel a stage at a time over a wave of pixels, the rays of each stage
+// queued, binned and traced together before the next stage shades them. Pixels go in tile order, so
+// that a wave covers a compact part of the frame.
+void wavefront(
+  const RestirScene& scene,
+  Image& image,
+  std::vector<float4>& reservoirs,
+  const RestirSettings& settings,
+  EXP::THREAD::Pool& pool,
+  RestirStats& stats
+) {
+  using Renderer::Host::WavefrontTracer;
+  const uint32_t w = image.width, h = image.height;
+  if (!scene.structure) {
+    std::fill(image.data.begin(), image.data.end(), 0);
+    return;
+  }
+  Renderer::Host::WavefrontSettings queues = settings.queues;
+  queues.threads = settings.threads;
+  std::vector<uint32_t> pixels;
+  pixels.reserve((size_t)w * h);
+  for (const EXP::THREAD::Tile& tile : EXP::THREAD::TileScheduler::tiles(w, h, settings.tiles.size, settings.tiles.morton)) {
+    for (uint32_t y = tile.y; y < tile.y + tile.height; y++) {
+      for (uint32_t x = tile.x; x < tile.x + tile.width; x++) pixels.push_back(y * w + x);
+    }
+  }
+
+  std::vector<Path> paths;
+  Renderer::Host::RayQueue rays, bounces; // Primary rays, then shadow rays; bounces
+  std::vector<BvhHit> hits, bounceHits;
+  std::vector<uint8_t> occluded; // Of the shadow rays, with settings.occlusion
+  std::mutex mutex;
+  auto stage = [&](size_t count, const std::function<void(Kernel&, size_t)>& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(
+      count,
+      PATH_GRAIN,
+      [&](size_t begin, size_t end) {
+        Kernel kernel = {scene, settings.groundPlane, settings.occlusion};
+        for (size_t i = begin; i < end; i++) fn(kernel, i);
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.primaryRays += kernel.primaryRays, stats.shadowRays += kernel.shadowRays, stats.bounceRays += kernel.bounceRays;
+      },
+      settings.threads
+    );
+    stats.wavefront.shadeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+  auto trace = [&](Renderer::Host::RayQueue& queue, std::vector<BvhHit>& found) {
+    WavefrontTracer::trace(*scene.structure, queue, found, queues, &stats.wavefront, pool);
+    queue.clear();
+  };
+  // The shadow rays in `rays`, visible(i) reading the answer for a slot
+  auto shadows = [&]() {
+    if (settings.occlusion) WavefrontTracer::occluded(*scene.structure, rays, occluded, queues, &stats.wavefront, pool);
+    else WavefrontTracer::trace(*scene.structure, rays, hits, queues, &stats.wavefront, pool);
+    rays.clear();
+  };
+  auto visible = [&](size_t i) {
+    return settings.occlusion ? !occluded[i] : Kernel::visible(rays.ray(i), hits[i], paths[i].shadow_target);
+  };
+
+  const size_t wave = std::max<uint32_t>(queues.wave, 1);
+  for (size_t first = 0; first < pixels.size(); first += wave) {
+    const size_t count = std::min(wave, pixels.size() - first);
+    const uint32_t* pixel = pixels.data() + first;
+    paths.assign(count, Path());
+    rays.resize(count), bounces.resize(count);
+    stats.wavefront.waves++;
+
+    stage(count, [&](Kernel& kernel, size_t i) { rays.push(i, kernel.camera(paths[i], pixel[i] % w, pixel[i] / w)); });
+    trace(rays, hits);
+    stage(count, [&](Kernel& kernel, size_t i) {
+      BvhRay shadow;
+      if (kernel.primary(paths[i], hits[i], shadow)) rays.push(i, shadow);
+      else store(image, paths[i].x, paths[i].y, paths[i].result);
+    });
+    shadows();
+    // A slot's traced ray is read before the next one is pushed over it
+    stage(count, [&](Kernel& kernel, size_t i) {
+      Path& path = paths[i];
+      if (!path.alive) return;
+      BvhRay shadow, bounce;
+      kernel.resample(path, visible(i), reservoirs[pixel[i]], shadow, bounce);
+      rays.push(i, shadow), bounces.push(i, bounce);
+    });
+    shadows();
+    trace(bounces, bounceHits);
+    stage(count, [&](Kernel& kernel, size_t i) {
+      Path& path = paths[i];
+      if (!path.alive) return;
+      BvhRay shadow;
+      if (kernel.transport_ray(path, visible(i), bounceHits[i], shadow)) rays.push(i, shadow);
+      else store(image, path.x, path.y, path.result);
+    });
+    shadows();
+    stage(count, [&](Kernel& kernel, size_t i) {
+      Path& path = paths[i];
+      if (!path.alive) return;
+      kernel.finish(path, visible(i));
+      store(image, path.x, path.y, path.result);
+    });
+  }
+}
+
+} // namespace
+
+
+float4 Renderer::Host::RestirRenderer::sample(const Image& texture, const float2& txcoord) {
+  if (texture.width == 0 || texture.height == 0) return {0.0f, 0.0f, 0.0f, 0.0f};
+  // Linear filter: the four texels around the sample point, coordinates clamped to [0, 1]
+  const float u = std::clamp(txcoord.x, 0.0f, 1.0f) * texture.width - 0.5f;
+  const float v = std::clamp(txcoord.y, 0.0f, 1.0f) * texture.height - 0.5f;
+  const int x0 = (int)std::floor(u), y0 = (int)std::floor(v);
+  const float fx = u - x0, fy = v - y0;
+  const float4 top = texel(texture, x0, y0) * (1.0f - fx) + texel(texture, x0 + 1, y0) * fx;
+  const float4 bottom = texel(texture, x0, y0 + 1) * (1.0f - fx) + texel(texture, x0 + 1, y0 + 1) * fx;
+  return top * (1.0f - fy) + bottom * fy;
+}
+
+std::vector<PrimitiveAttributes> Renderer::Host::RestirRenderer::primitives(
+  const EXP::MDL::HostMesh& mesh,
+  const std::vector<uint32_t>& textures
+) {
+  std::vector<PrimitiveAttributes> result(mesh.triangleCount());
+  size_t first = 0;
+  for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+    const std::vector<uint32_t>& indices = mesh.submeshes[s].indices;
+    const int texture = s < textures.size() ? (int)textures[s] : 0;
+    Buffer::perPrimitive(mesh.attributes.data(), indices.data(), indices.size(), texture, result.data() + first);
+    first += indices.size() / 3;
+  }
+  return result;
+}
+
+
+RestirStats Renderer::Host::RestirRenderer::render(const RestirScene& scene, Image& image, const RestirSettings& settings) {
+  const auto start = std::chrono::steady_clock::now();
+  const uint32_t w = (uint32_t)scene.camera.resolution.x, h = (uint32_t)scene.camera.resolution.y;
+  if (w != width || h != height) {
+    width = w, height = h;
+    reset();
+  }
+  image.allocate(w, h, PixelFormat::RGBA8_SRGB);
+
+  EXP::THREAD::Pool& pool = settings.pool ? *settings.pool : EXP::THREAD::Pool::shared();
+  auto shade = [&](Kernel& kernel, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    for (uint32_t y = y0; y < y1; y++) {
+      for (uint32_t x = x0; x < x1; x++) store(image, x, y, kernel.temporal_reuse(x, y, reservoirs[(size_t)y * w + x]));
+    }
+  };
+
+  RestirStats stats;
+  std::vector<Kernel> kernels;
+  if (settings.wavefront) {
+    wavefront(scene, image, reservoirs, settings, pool, stats);
+  } else if (settings.tiled) {
+    EXP::THREAD::TileSettings tiles = settings.tiles;
+    tiles.threads = settings.threads;
+    for (unsigned int k = 0; k < EXP::THREAD::TileScheduler::workers(tiles, pool); k++) kernels.push_back({scene, settings.groundPlane, settings.occlusion});
+    stats.tiles = EXP::THREAD::TileScheduler::run(
+      w,
+      h,
+      [&](const EXP::THREAD::Tile& tile, unsigned int worker) {
+        shade(kernels[worker], tile.x, tile.y, tile.x + tile.width, tile.y + tile.height);
+      },
+      tiles,
+      pool
+    );
+  } else {
+    std::mutex mutex;
+    pool.parallelFor(
+      h,
+      ROW_GRAIN,
+      [&](size_t begin, size_t end) {
+        Kernel kernel = {scene, settings.groundPlane, settings.occlusion};
+        shade(kernel, 0, (uint32_t)begin, w, (uint32_t)end);
+        std::lock_guard<std::mutex> lock(mutex);
+        kernels.push_back(kernel);
+      },
+      settings.threads
+    );
+  }
+
+  for (const Kernel& kernel : kernels) {
+    stats.primaryRays += kernel.primaryRays, stats.shadowRays += kernel.shadowRays, stats.bounceRays += kernel.bounceRays;
+  }
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  stats.pixels = (uint64_t)w * h;
+  return stats;
+}
+
+void Renderer::Host::RestirRenderer::reset() {
+  reservoirs.assign((size_t)width * height, {0.0f, 0.0f, 0.0f, 0.0f});
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <Model/HostMesh.h>
+#include <Renderer/HostCamera.h>
+#include <Renderer/HostImage.h>
+#include <Renderer/HostInstance.h>
+#include <Renderer/HostTypes.h>
+#include <Renderer/HostWavefront.h>
+#include <Thread/TileScheduler.h>
+#include <cstdint>
+#include <vector>
+
+/**
+ * temporal_reuse (Shaders/ReSTIR.metal) on the CPU, so that machines without Metal can render a frame.
+ *
+ * Every kernel function has its counterpart here, line for line: build_ray (primaryRay), color_ray,
+ * intersect_ground_plane, sample_light, shadow_ray, update_reservoir, shade_ray and transport_ray,
+ * with the same pcg_hash seeds, so a pixel draws the same random numbers as on the GPU. Rays go
+ * through a Tlas<Bvh8>, the counterpart of the instance acceleration structure, and primitive_data
+ * is looked up by the hit's structure index and triangle id.
+ *
+ * RestirScene stands in for the kernel's Scene: textsample is `textures` (sampled bilinear, clamped
+ * to the edge, in linear light; an empty image samples 0 like a missing texture), lights[0] is
+ * `light`. The prev_frame reservoir texture is kept by the renderer between frames, one float4 per
+ * pixel, {w_sum, light index, M, W} as the kernel has it; reset() forgets it. The written color goes
+ * out as RGBA8_SRGB, what the sRGB drawable stores.
+ *
+ * Pixels are shaded in tiles through the TileScheduler: Morton ordered, per worker deques, stolen
+ * when a worker runs dry, since a sky pixel costs one ray and a shaded one five. Row bands over
+ * parallelFor remain for comparison.
+ *
+ * The kernel is kept as stages cut at each traced ray (primary, two shadow rays, the bounce and its
+ * shadow ray), the state between them in a per pixel path. Shading a pixel runs them one after the
+ * other; settings.wavefront runs each stage over a wave of pixels instead, their rays going through
+ * RayQueues binned by the WavefrontTracer. Both write the same image.
+ *
+ * A shadow ray asks whether anything lies between the surface and the light, as the kernel's
+ * shadow_ray does with accept_any_intersection: Tlas::occluded over [0.001, light - 0.001), stopping
+ * at the first blocker. settings.occlusion off keeps the older closest hit test, the light visible
+ * when that hit is within 0.001 of it; a ray aimed at a light vertex often slips between the light's
+ * triangles there and finds something behind, so that test leaves some unblocked lights dark.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+// scene->lights[0]: the emissive mesh whose vertices are sampled as point lights
+struct RestirLight {
+  std::vector<EXP::MATH::packed3> vertices;
+  std::vector<VertexAttributes> attributes;                          // color per vertex
+  EXP::MATH::packed4x3 orientation = EXP::MATH::identity4x3();       // Object to world
+};
+
+struct RestirScene {
+  const Tlas<Bvh8>* structure = nullptr;                    // Null renders black, as a null structure does
+  std::vector<std::vector<PrimitiveAttributes>> primitives; // By accelerationStructureIndex, then triangle id
+  std::vector<Image> textures;                              // By PrimitiveAttributes::flags.x
+  RestirLight light;
+  VCamera camera;
+};
+
+struct RestirSettings {
+  unsigned int threads = 0;          // Pool threads to use, 0 for all of them
+  float groundPlane = -0.2f;         // Height of intersect_ground_plane
+  bool tiled = true;                 // Through the TileScheduler, row bands over parallelFor otherwise
+  EXP::THREAD::TileSettings tiles;   // Its threads are the ones above
+  bool occlusion = true;             // Shadow rays as occlusion queries, a closest hit on the light otherwise
+  bool wavefront = false;            // Stage by stage over waves of pixels, tiles only ordering them
+  WavefrontSettings queues;          // Its threads are the ones above
+  EXP::THREAD::Pool* pool = nullptr; // Pool::shared() when null
+};
+
+struct RestirStats {
+  double seconds = 0.0;
+  uint64_t pixels = 0;
+  uint64_t primaryRays = 0;
+  uint64_t shadowRays = 0;
+  uint64_t bounceRays = 0;
+  EXP::THREAD::TileStats tiles; // Load balance of a tiled frame
+  WavefrontStats wavefront;     // Of a wavefront frame
+
+  inline uint64_t rays() const { return primaryRays + shadowRays + bounceRays; }
+  inline double raysPerSecond() const { return seconds > 0.0 ? rays() / seconds : 0.0; }
+};
+
+class RestirRenderer {
+public:
+  RestirRenderer(){};
+  ~RestirRenderer(){};
+
+public:
+  // One dispatch of temporal_reuse over camera.resolution; `image` is RGBA8_SRGB
+  RestirStats render(const RestirScene& scene, Image& image, const RestirSettings& settings = {});
+  // Clears the previous frame's reservoirs
+  void reset();
+  inline const EXP::MATH::float4& reservoir(uint32_t x, uint32_t y) const { return reservoirs[(size_t)y * width + x]; }
+
+public:
+  // Per primitive data of a mesh as MeshRepository uploads it, triangle ids across submeshes;
+  // textures[s] is submesh s's slot in RestirScene::textures
+  static std::vector<PrimitiveAttributes> primitives(const EXP::MDL::HostMesh& mesh, const std::vector<uint32_t>& textures);
+  // What Texture::sample with sampler2d returns
+  static EXP::MATH::float4 sample(const Image& texture, const EXP::MATH::float2& txcoord);
+
+private:
+  std::vector<EXP::MATH::float4> reservoirs; // prev_frame
+  uint32_t width = 0;
+  uint32_t height = 0;
+};
+
+}; // namespace Host
+}; // namespace Renderer
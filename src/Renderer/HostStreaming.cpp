@@ -0,0 +1,230 @@
+#include <Renderer/HostStreaming.h>
+#include <algorithm>
+
+using Renderer::Host::CpuStreamBackend;
+using Renderer::Host::StreamSource;
+using Renderer::Host::StreamUpload;
+using Renderer::Host::TextureStreamer;
+
+
+Renderer::Host::TextureStreamer::TextureStreamer(StreamBackend* backend, const StreamSettings& settings)
+    : backend(backend), config(settings) {}
+
+uint32_t Renderer::Host::TextureStreamer::levelFor(uint32_t texels, uint32_t pixels) {
+  if (pixels == 0) return NONE;
+  uint32_t level = 0;
+  while ((texels >> (level + 1)) >= pixels) level++;
+  return level;
+}
+
+
+void Renderer::Host::TextureStreamer::add(uint32_t slot, StreamSource source) {
+  if (source.levels.empty()) return;
+  if (slot >= entries.size()) entries.resize(slot + 1);
+  Entry& entry = entries[slot];
+  if (entry.active) return;
+
+  entry.source = std::move(source);
+  entry.count = (uint32_t)entry.source.levels.size();
+  entry.tail = entry.count - 1;
+  for (uint32_t l = 0; l < entry.count; l++) {
+    const StreamLevel& level = entry.source.levels[l];
+    if (std::max(level.width, level.height) <= config.tailSize) {
+      entry.tail = l;
+      break;
+    }
+  }
+  entry.resident = entry.count;
+  entry.wanted = entry.tail;
+  entry.pending = NONE;
+  entry.lastUsed = frames;
+  entry.active = true;
+  touch(slot);
+  // Tails go past the budget and the upload limit; update() retries when the queue is full
+  if (!submit(slot, entry.tail)) statistics.stalls++;
+}
+
+void Renderer::Host::TextureStreamer::request(uint32_t slot, uint32_t level) {
+  if (slot >= entries.size() || !entries[slot].active) return;
+  Entry& entry = entries[slot];
+  // First request this frame sets the level, later ones can only sharpen it
+  entry.wanted = entry.lastUsed == frames ? std::min(entry.wanted, level) : level;
+  entry.wanted = std::min(entry.wanted, entry.tail);
+  entry.lastUsed = frames;
+  touch(slot);
+}
+
+
+size_t Renderer::Host::TextureStreamer::update() {
+  // Finished uploads go into the slot table, the textures they replace are retired
+  done.clear();
+  backend->poll(done);
+  for (const StreamUpload& upload : done) {
+    Entry& entry = entries[upload.slot];
+    const size_t previous = entry.resident < entry.count ? bytesFrom(entry, entry.resident) : 0;
+    statistics.pendingBytes -= upload.bytes;
+    statistics.residentBytes += upload.bytes;
+    statistics.residentBytes -= previous;
+    if (upload.first > entry.resident) {
+      freeing -= previous - upload.bytes;
+      statistics.evictions++;
+      statistics.evictedBytes += previous - upload.bytes;
+    } else {
+      statistics.uploads++;
+      statistics.uploadedBytes += upload.bytes;
+    }
+    if (entry.handle) backend->retire(entry.handle);
+    entry.handle = upload.handle;
+    entry.resident = upload.first;
+    entry.pending = NONE;
+    if (slotTable && upload.slot < slotTableSize) {
+      slotTable[upload.slot] = upload.handle;
+      statistics.patches++;
+    }
+  }
+
+  // Missing tails first, then what was requested this frame: blurriest first, ties in LRU order
+  order.clear();
+  for (uint32_t slot = lruHead; slot != NONE; slot = entries[slot].next) {
+    const Entry& entry = entries[slot];
+    if (entry.pending != NONE) continue;
+    if (entry.resident == entry.count || (entry.lastUsed == frames && entry.resident > entry.wanted)) {
+      order.emplace_back(slot);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    const Entry& x = entries[a];
+    const Entry& y = entries[b];
+    const bool xTail = x.resident == x.count, yTail = y.resident == y.count;
+    if (xTail != yTail) return xTail;
+    return x.resident - x.wanted > y.resident - y.wanted;
+  });
+
+  size_t submitted = 0;
+  for (uint32_t slot : order) {
+    Entry& entry = entries[slot];
+    const bool missingTail = entry.resident == entry.count;
+    const uint32_t first = missingTail ? entry.tail : entry.resident - 1;
+    const size_t bytes = bytesFrom(entry, first);
+    if (!missingTail) {
+      if (submitted > 0 && submitted + bytes > config.uploadBytesPerFrame) break;
+      const size_t committed = statistics.residentBytes + statistics.pendingBytes;
+      if (committed + bytes > config.budget) {
+        // Shrinks land in a later frame; until then everything behind this one waits too
+        evictFor(committed + bytes - config.budget);
+        statistics.stalls++;
+        break;
+      }
+    }
+    if (!submit(slot, first)) {
+      statistics.stalls++;
+      break;
+    }
+    submitted += bytes;
+  }
+
+  frames++;
+  return done.size();
+}
+
+
+uint32_t Renderer::Host::TextureStreamer::residentLevel(uint32_t slot) const {
+  if (slot >= entries.size() || !entries[slot].active || entries[slot].resident == entries[slot].count) return NONE;
+  return entries[slot].resident;
+}
+
+uint64_t Renderer::Host::TextureStreamer::handle(uint32_t slot) const {
+  return slot < entries.size() ? entries[slot].handle : 0;
+}
+
+uint32_t Renderer::Host::TextureStreamer::width(uint32_t slot) const {
+  return slot < entries.size() && entries[slot].active ? entries[slot].source.levels[0].width : 0;
+}
+
+size_t Renderer::Host::TextureStreamer::bytesFrom(const Entry& entry, uint32_t first) const {
+  size_t bytes = 0;
+  for (uint32_t l = first; l < entry.count; l++) bytes += entry.source.levels[l].bytes;
+  return bytes;
+}
+
+bool Renderer::Host::TextureStreamer::submit(uint32_t slot, uint32_t first) {
+  Entry& entry = entries[slot];
+  StreamUpload upload;
+  upload.slot = slot;
+  upload.first = first;
+  upload.bytes = bytesFrom(entry, first);
+  if (!backend->submit(entry.source, upload)) return false;
+
+  entry.pending = first;
+  statistics.pendingBytes += upload.bytes;
+  if (entry.resident < entry.count && first > entry.resident) freeing += bytesFrom(entry, entry.resident) - upload.bytes;
+  statistics.peakBytes = std::max(statistics.peakBytes, statistics.residentBytes + statistics.pendingBytes);
+  return true;
+}
+
+// Shrinks from the cold end of the LRU list until the shrinks in flight cover `deficit`.
+// Slots not used this frame drop to their tail, slots used this frame to what they asked for.
+void Renderer::Host::TextureStreamer::evictFor(size_t deficit) {
+  for (uint32_t slot = lruTail; slot != NONE && freeing < deficit; slot = entries[slot].prev) {
+    const Entry& entry = entries[slot];
+    const uint32_t target = entry.lastUsed == frames ? entry.wanted : entry.tail;
+    if (entry.pending != NONE || entry.resident >= target) continue;
+    if (!submit(slot, target)) return;
+  }
+}
+
+void Renderer::Host::TextureStreamer::touch(uint32_t slot) {
+  if (lruHead == slot) return;
+  unlink(slot);
+  Entry& entry = entries[slot];
+  entry.next = lruHead;
+  if (lruHead != NONE) entries[lruHead].prev = slot;
+  lruHead = slot;
+  if (lruTail == NONE) lruTail = slot;
+}
+
+void Renderer::Host::TextureStreamer::unlink(uint32_t slot) {
+  Entry& entry = entries[slot];
+  if (entry.prev != NONE) entries[entry.prev].next = entry.next;
+  else if (lruHead == slot) lruHead = entry.next;
+  if (entry.next != NONE) entries[entry.next].prev = entry.prev;
+  else if (lruTail == slot) lruTail = entry.prev;
+  entry.prev = entry.next = NONE;
+}
+
+
+bool Renderer::Host::CpuStreamBackend::submit(const StreamSource& source, const StreamUpload& upload) {
+  if (queue.size() >= depth) return false;
+  Texture texture;
+  texture.first = upload.first;
+  for (size_t l = upload.first; l < source.levels.size(); l++) {
+    const StreamLevel& level = source.levels[l];
+    texture.levels.emplace_back(level.data, level.data + level.bytes);
+  }
+  Job job = {upload, polls + latency};
+  job.upload.handle = nextHandle++;
+  textures.emplace(job.upload.handle, std::move(texture));
+  bytes += upload.bytes;
+  queue.emplace_back(job);
+  return true;
+}
+
+void Renderer::Host::CpuStreamBackend::poll(std::vector<StreamUpload>& done) {
+  polls++;
+  while (!queue.empty() && queue.front().ready <= polls) {
+    done.emplace_back(queue.front().upload);
+    queue.pop_front();
+  }
+}
+
+void Renderer::Host::CpuStreamBackend::retire(uint64_t handle) {
+  auto found = textures.find(handle);
+  if (found == textures.end()) return;
+  for (const std::vector<uint8_t>& level : found->second.levels) bytes -= level.size();
+  textures.erase(found);
+}
+
+const CpuStreamBackend::Texture* Renderer::Host::CpuStreamBackend::texture(uint64_t handle) const {
+  auto found = textures.find(handle);
+  return found == textures.end() ? nullptr : &found->second;
+}
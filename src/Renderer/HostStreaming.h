@@ -0,0 +1,187 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Texture streaming under a fixed memory budget.
+ *
+ * Every streamed texture keeps its whole mip chain on the CPU (a mapped .exptex, or a chain
+ * decoded on import) and only a suffix of it on the GPU: levels [first, count). The small
+ * levels from `tailSize` down are always resident, so every slot can be sampled from the
+ * first frame. Callers request the finest level they need each frame; update() then
+ *
+ * - patches finished uploads into the slot table (Renderer::Text2D, one uint64 per slot) and
+ *   retires the texture they replace,
+ * - shrinks textures that were not requested this frame, least recently used first, until
+ *   the requested levels fit the budget,
+ * - submits one level at a time (coarse to fine), most recently requested first, within a
+ *   per-frame upload limit.
+ *
+ * The GPU side is a StreamBackend: Renderer::Streaming on Metal, CpuStreamBackend for tests
+ * and tools. A change of residency builds a new texture holding [first, count) and swaps the
+ * slot over once it is done, so the budget covers both while the upload is in flight.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+// One mip level in the CPU backing store
+struct StreamLevel {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  const uint8_t* data = nullptr;
+  size_t bytes = 0;
+  size_t rowBytes = 0;
+};
+
+struct StreamSource {
+  std::vector<StreamLevel> levels; // 0 is the largest
+  uint32_t format = 0;             // Pixel format for the backend, not interpreted here
+  std::shared_ptr<const void> store; // Keeps `levels` alive (mapped file, decoded chain)
+};
+
+struct StreamUpload {
+  uint32_t slot = 0;
+  uint32_t first = 0;  // The new texture holds levels [first, count)
+  size_t bytes = 0;    // Size of the new texture
+  uint64_t handle = 0; // Set by the backend once done: the value for the slot table
+};
+
+class StreamBackend {
+public:
+  virtual ~StreamBackend(){};
+  // Starts building the texture for `upload`. False when the queue is full, try again next frame.
+  virtual bool submit(const StreamSource& source, const StreamUpload& upload) = 0;
+  // Appends the uploads finished since the last call, handles filled in
+  virtual void poll(std::vector<StreamUpload>& done) = 0;
+  // `handle` left the slot table; free it once the GPU is done with it
+  virtual void retire(uint64_t handle) = 0;
+};
+
+struct StreamSettings {
+  size_t budget = 64ull << 20;              // GPU bytes for all streamed textures
+  size_t uploadBytesPerFrame = 8ull << 20;  // Submitted per update()
+  uint32_t tailSize = 64;                   // Levels this size and below never leave
+};
+
+struct StreamStats {
+  size_t residentBytes = 0;  // Textures in the slot table
+  size_t pendingBytes = 0;   // Textures being built
+  size_t peakBytes = 0;      // Highest resident + pending so far
+  uint64_t uploads = 0;      // Finished uploads that made a slot sharper
+  uint64_t uploadedBytes = 0;
+  uint64_t evictions = 0;    // Finished shrinks
+  uint64_t evictedBytes = 0; // Resident bytes given back by them
+  uint64_t patches = 0;      // Slot table writes
+  uint64_t stalls = 0;       // Requests that did not fit the budget or the queue
+};
+
+class TextureStreamer {
+public:
+  static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+  TextureStreamer(StreamBackend* backend, const StreamSettings& settings = {});
+  ~TextureStreamer(){};
+
+public:
+  // Finest level worth loading when the texture covers `pixels` pixels across the screen
+  static uint32_t levelFor(uint32_t texels, uint32_t pixels);
+
+public:
+  // Slot table the handles are written to, one uint64 per slot (the Text2D buffer contents)
+  inline void setTable(uint64_t* table, size_t size) { slotTable = table, slotTableSize = size; }
+  // Registers `slot` and submits its tail; the slot reads 0 until that lands
+  void add(uint32_t slot, StreamSource source);
+  // Levels [level, count) are wanted this frame; marks the slot used
+  void request(uint32_t slot, uint32_t level);
+  // One frame: completions, evictions, submissions. Returns the number of slots patched.
+  size_t update();
+
+public:
+  uint32_t residentLevel(uint32_t slot) const; // First resident level, NONE before the tail lands
+  uint64_t handle(uint32_t slot) const;
+  uint32_t width(uint32_t slot) const; // Of level 0
+  inline const StreamStats& stats() const { return statistics; }
+  inline const StreamSettings& settings() const { return config; }
+  inline uint64_t frame() const { return frames; }
+
+private:
+  struct Entry {
+    StreamSource source;
+    uint32_t count = 0;      // Levels in the chain
+    uint32_t tail = 0;       // First level of the always resident tail
+    uint32_t resident = 0;   // First resident level, count when none
+    uint32_t wanted = 0;     // Finest level requested
+    uint32_t pending = 0;    // First level of the texture in flight, NONE when idle
+    uint64_t handle = 0;
+    uint64_t lastUsed = 0;   // Frame of the last request
+    uint32_t prev = NONE;    // LRU list, most recent at the head
+    uint32_t next = NONE;
+    bool active = false;
+  };
+
+private:
+  size_t bytesFrom(const Entry& entry, uint32_t first) const;
+  bool submit(uint32_t slot, uint32_t first);
+  void touch(uint32_t slot);
+  void unlink(uint32_t slot);
+  void evictFor(size_t deficit);
+
+private:
+  StreamBackend* backend;
+  StreamSettings config;
+  StreamStats statistics;
+  std::vector<Entry> entries;
+  uint32_t lruHead = NONE;
+  uint32_t lruTail = NONE;
+  size_t freeing = 0; // Resident bytes that in-flight shrinks give back
+  uint64_t frames = 1;
+  uint64_t* slotTable = nullptr;
+  size_t slotTableSize = 0;
+  std::vector<StreamUpload> done;
+  std::vector<uint32_t> order;
+};
+
+/**
+ * CPU backing store with a simulated upload queue: textures are byte copies of their levels,
+ * uploads finish `latency` polls after submit, at most `depth` at a time. Handles count up from 1.
+ **/
+class CpuStreamBackend : public StreamBackend {
+public:
+  CpuStreamBackend(uint32_t latency = 1, uint32_t depth = 8) : latency(latency), depth(depth){};
+  ~CpuStreamBackend(){};
+
+public:
+  bool submit(const StreamSource& source, const StreamUpload& upload) override;
+  void poll(std::vector<StreamUpload>& done) override;
+  void retire(uint64_t handle) override;
+
+public:
+  struct Texture {
+    uint32_t first = 0;
+    std::vector<std::vector<uint8_t>> levels; // levels[i] is level first + i
+  };
+  const Texture* texture(uint64_t handle) const;
+  inline size_t liveBytes() const { return bytes; }
+  inline size_t liveTextures() const { return textures.size(); }
+
+private:
+  struct Job {
+    StreamUpload upload;
+    uint64_t ready;
+  };
+  uint32_t latency;
+  uint32_t depth;
+  uint64_t polls = 0;
+  uint64_t nextHandle = 1;
+  size_t bytes = 0;
+  std::deque<Job> queue;
+  std::unordered_map<uint64_t, Texture> textures;
+};
+
+}; // namespace Host
+}; // namespace Renderer
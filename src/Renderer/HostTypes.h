@@ -0,0 +1,47 @@
+#pragma once
+#include <Math/Vector.h>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Host (CPU) mirrors of the GPU structs in Renderer/Types.h.
+ * Byte layout is identical, so a std::vector of these can be copied straight
+ * into the MTL::Buffer that the shaders read. These do not pull in Metal and
+ * can be used by headless tools and tests.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+struct VertexAttributes {
+  EXP::MATH::float4 color;   // {r, g, b, w}
+  EXP::MATH::float2 texture; // {x, y}
+  EXP::MATH::float3 normal;  // {x, y, z}
+};
+
+struct PrimitiveAttributes {
+  EXP::MATH::float4 color[3];
+  EXP::MATH::float2 txcoord[3];
+  EXP::MATH::float3 normal[3];
+  EXP::MATH::uint2 flags;
+};
+
+// Camera of the ray tracing kernels, see RayUtils.h build_ray
+struct VCamera {
+  EXP::MATH::packed3 vecOrigin;
+  EXP::MATH::packed3 resolution;
+  EXP::MATH::packed3 vecRight;
+  EXP::MATH::packed3 vecUp;
+  EXP::MATH::packed3 vecForward;
+  float fovScale; // Half height of the orthographic view
+};
+
+static_assert(sizeof(VertexAttributes) == 48, "Must match Renderer::VertexAttributes");
+static_assert(offsetof(VertexAttributes, normal) == 32, "Must match Renderer::VertexAttributes");
+static_assert(sizeof(PrimitiveAttributes) == 144, "Must match Renderer::PrimitiveAttributes");
+static_assert(offsetof(PrimitiveAttributes, normal) == 80, "Must match Renderer::PrimitiveAttributes");
+static_assert(offsetof(PrimitiveAttributes, flags) == 128, "Must match Renderer::PrimitiveAttributes");
+static_assert(sizeof(VCamera) == 64, "Must match Renderer::VCamera");
+
+}; // namespace Host
+}; // namespace Renderer
@@ -0,0 +1,183 @@
+#include <Renderer/HostWavefront.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+using EXP::MATH::packed3;
+using Renderer::Host::Aabb;
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhRay;
+using Renderer::Host::RayQueue;
+using Renderer::Host::WavefrontSettings;
+using Renderer::Host::WavefrontStats;
+
+
+namespace {
+
+constexpr size_t SLOT_GRAIN = 4096; // Slots per parallelFor block when binning
+constexpr uint32_t MAX_CELL_BITS = 10; // What a 30 bit Morton code holds per axis
+
+inline double since(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Bounds of the queued origins, the grid the cells divide
+Aabb origins(const RayQueue& queue, unsigned int threads) {
+  Aabb result;
+  std::mutex mutex;
+  EXP::THREAD::parallelFor(
+    queue.slots(),
+    SLOT_GRAIN,
+    [&](size_t begin, size_t end) {
+      Aabb local;
+      for (size_t i = begin; i < end; i++) {
+        if (queue.queued[i]) local.grow(packed3{queue.ox[i], queue.oy[i], queue.oz[i]});
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      result.grow(local);
+    },
+    threads
+  );
+  return result;
+}
+
+} // namespace
+
+
+void Renderer::Host::WavefrontStats::add(const WavefrontStats& other) {
+  waves += other.waves, queues += other.queues, rays += other.rays;
+  binSeconds += other.binSeconds, traceSeconds += other.traceSeconds, shadeSeconds += other.shadeSeconds;
+  packets.add(other.packets);
+  packets.seconds += other.packets.seconds;
+}
+
+void Renderer::Host::RayQueue::resize(size_t count) {
+  for (std::vector<float>* component : {&ox, &oy, &oz, &dx, &dy, &dz, &tmin, &tmax}) component->resize(count);
+  queued.assign(count, 0);
+  order.clear();
+}
+
+void Renderer::Host::RayQueue::clear() {
+  std::fill(queued.begin(), queued.end(), 0);
+  order.clear();
+}
+
+uint64_t Renderer::Host::WavefrontTracer::key(const BvhRay& ray, const Aabb& origins, uint32_t cellBits) {
+  cellBits = std::min(cellBits, MAX_CELL_BITS);
+  const uint64_t octant = (uint64_t)(ray.direction.x < 0.0f) << 2 | (uint64_t)(ray.direction.y < 0.0f) << 1 | (uint64_t)(ray.direction.z < 0.0f);
+  auto unit = [](float v, float lo, float hi) { return hi > lo ? (v - lo) / (hi - lo) : 0.0f; };
+  const packed3 position = {
+    unit(ray.origin.x, origins.min.x, origins.max.x),
+    unit(ray.origin.y, origins.min.y, origins.max.y),
+    unit(ray.origin.z, origins.min.z, origins.max.z)
+  };
+  const uint64_t cell = BvhBuilder::morton(position, 30) >> (3 * (MAX_CELL_BITS - cellBits));
+  return octant << (3 * cellBits) | cell;
+}
+
+void Renderer::Host::WavefrontTracer::bin(RayQueue& queue, const WavefrontSettings& settings) {
+  queue.order.clear();
+  for (size_t i = 0; i < queue.slots(); i++) {
+    if (queue.queued[i]) queue.order.push_back((uint32_t)i);
+  }
+  if (!settings.sort || queue.order.size() < 2) return;
+
+  const uint32_t cellBits = std::min(settings.cellBits, MAX_CELL_BITS);
+  const Aabb bounds = origins(queue, settings.threads);
+  std::vector<uint64_t> keys(queue.order.size());
+  EXP::THREAD::parallelFor(
+    keys.size(),
+    SLOT_GRAIN,
+    [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) keys[i] = key(queue.ray(queue.order[i]), bounds, cellBits);
+    },
+    settings.threads
+  );
+  BvhBuilder::radixSort(keys, queue.order, 3 + 3 * cellBits, settings.threads);
+}
+
+void Renderer::Host::WavefrontTracer::trace(
+  const Tlas<Bvh8>& tlas,
+  RayQueue& queue,
+  std::vector<BvhHit>& hits,
+  const WavefrontSettings& settings,
+  WavefrontStats* stats,
+  EXP::THREAD::Pool& pool
+) {
+  auto start = std::chrono::steady_clock::now();
+  bin(queue, settings);
+  WavefrontStats result;
+  result.binSeconds = since(start);
+
+  start = std::chrono::steady_clock::now();
+  hits.resize(queue.slots());
+  const size_t count = queue.order.size(), batch = std::max<uint32_t>(settings.batch, 1);
+  PacketSettings packets;
+  packets.width = settings.width;
+  packets.threads = 1; // Inside a pool job: the batch is one task
+  packets.mask = settings.mask;
+  const PacketIsa isa = PacketTracer::supported(settings.isa) ? settings.isa : PacketTracer::best();
+  std::mutex mutex;
+  pool.parallelFor(
+    (count + batch - 1) / batch,
+    1,
+    [&](size_t first, size_t last) {
+      std::vector<BvhRay> rays(batch);
+      std::vector<BvhHit> found(batch);
+      PacketStats local;
+      for (size_t b = first; b < last; b++) {
+        const size_t begin = b * batch, n = std::min(batch, count - begin);
+        for (size_t i = 0; i < n; i++) rays[i] = queue.ray(queue.order[begin + i]);
+        local.add(PacketTracer::intersect(tlas, rays.data(), n, found.data(), packets, isa, pool));
+        for (size_t i = 0; i < n; i++) hits[queue.order[begin + i]] = found[i];
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      result.packets.add(local);
+    },
+    settings.threads
+  );
+  result.traceSeconds = since(start);
+  result.packets.seconds = result.traceSeconds;
+  result.queues = 1;
+  result.rays = count;
+  if (stats) stats->add(result);
+}
+
+void Renderer::Host::WavefrontTracer::occluded(
+  const Tlas<Bvh8>& tlas,
+  RayQueue& queue,
+  std::vector<uint8_t>& occluded,
+  const WavefrontSettings& settings,
+  WavefrontStats* stats,
+  EXP::THREAD::Pool& pool
+) {
+  auto start = std::chrono::steady_clock::now();
+  bin(queue, settings);
+  WavefrontStats result;
+  result.binSeconds = since(start);
+
+  start = std::chrono::steady_clock::now();
+  occluded.resize(queue.slots());
+  const size_t count = queue.order.size(), batch = std::max<uint32_t>(settings.batch, 1);
+  std::mutex mutex;
+  pool.parallelFor(
+    (count + batch - 1) / batch,
+    1,
+    [&](size_t first, size_t last) {
+      PacketStats local;
+      for (size_t i = first * batch; i < std::min(last * batch, count); i++) {
+        const uint32_t slot = queue.order[i];
+        occluded[slot] = tlas.occluded(queue.ray(slot), settings.mask);
+        local.rays++, local.singleRays++, local.hits += occluded[slot];
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      result.packets.add(local);
+    },
+    settings.threads
+  );
+  result.traceSeconds = since(start);
+  result.packets.seconds = result.traceSeconds;
+  result.queues = 1;
+  result.rays = count;
+  if (stats) stats->add(result);
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <Renderer/HostBvh.h>
+#include <Renderer/HostInstance.h>
+#include <Renderer/HostPacket.h>
+#include <Renderer/HostWideBvh.h>
+#include <Thread/Pool.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Ray queues for wavefront tracing: instead of following one pixel's rays one after the other, a
+ * renderer generates the rays of one step for a whole wave of pixels, traces them all, then shades
+ * them all, so that the tracer sees thousands of rays at once and may reorder them.
+ *
+ * A RayQueue has one slot per path of the wave, structure of arrays; a shading stage pushes into
+ * its path's slot, from any thread, and the queue is traced as a whole. Shadow and bounce rays leave
+ * the surface in every direction, so slot order is poor for traversal: WavefrontTracer::bin orders
+ * the queued slots by direction octant, then by the Morton code of the origin's cell in the queue's
+ * origin bounds (a stable radix sort, so a cell keeps pixel order). Rays of one bin share direction
+ * signs and start close together, which is what keeps a traversal's nodes in cache from one ray to
+ * the next, and what lets the PacketTracer pack them.
+ *
+ * Binned rays are traced in batches spread over the pool, one at a time through Tlas::intersect or
+ * in packets. Hits land in the slot of their ray, BvhHit() (t INFINITY) for a miss. Shadow queues
+ * may be asked the occlusion question instead, through Tlas::occluded.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+struct RayQueue {
+  std::vector<float> ox, oy, oz;
+  std::vector<float> dx, dy, dz;
+  std::vector<float> tmin, tmax;
+  std::vector<uint8_t> queued; // Per slot
+  std::vector<uint32_t> order; // Queued slots in tracing order, from WavefrontTracer::bin
+
+  // Slots for `count` paths, none queued
+  void resize(size_t count);
+  // Unqueues every slot; their rays stay readable until pushed over
+  void clear();
+  inline size_t slots() const { return queued.size(); }
+  inline void push(size_t slot, const BvhRay& ray) {
+    ox[slot] = ray.origin.x, oy[slot] = ray.origin.y, oz[slot] = ray.origin.z;
+    dx[slot] = ray.direction.x, dy[slot] = ray.direction.y, dz[slot] = ray.direction.z;
+    tmin[slot] = ray.tmin, tmax[slot] = ray.tmax;
+    queued[slot] = 1;
+  }
+  inline BvhRay ray(size_t slot) const {
+    BvhRay result;
+    result.origin = {ox[slot], oy[slot], oz[slot]};
+    result.direction = {dx[slot], dy[slot], dz[slot]};
+    result.tmin = tmin[slot], result.tmax = tmax[slot];
+    return result;
+  }
+};
+
+struct WavefrontSettings {
+  uint32_t wave = 1 << 16;           // Paths in flight: the queues hold a ray per path
+  bool sort = true;                  // Bin by octant and origin cell; slot order otherwise
+  uint32_t cellBits = 4;             // 2^cellBits origin cells per axis, at most 10
+  uint32_t batch = 256;              // Binned rays per parallelFor block
+  PacketIsa isa = PacketIsa::SCALAR; // SCALAR: one ray at a time; packets of `width` otherwise
+  uint32_t width = 8;
+  unsigned int threads = 0;          // Pool threads to use, 0 for all of them
+  uint32_t mask = 0xFF;              // Instance mask, as Tlas::intersect's
+};
+
+struct WavefrontStats {
+  uint64_t waves = 0;
+  uint64_t queues = 0;        // Queues traced
+  uint64_t rays = 0;
+  double binSeconds = 0.0;
+  double traceSeconds = 0.0;
+  double shadeSeconds = 0.0;  // Left to the renderer
+  PacketStats packets;        // Of the traced batches
+
+  void add(const WavefrontStats& other);
+};
+
+class WavefrontTracer {
+public:
+  WavefrontTracer(){};
+  ~WavefrontTracer(){};
+
+public:
+  // queue.order: the queued slots, binned when settings.sort
+  static void bin(RayQueue& queue, const WavefrontSettings& settings = {});
+  // Bins, then the closest hit of every queued ray to hits[slot]; hits is sized to the slots
+  static void trace(
+    const Tlas<Bvh8>& tlas,
+    RayQueue& queue,
+    std::vector<BvhHit>& hits,
+    const WavefrontSettings& settings = {},
+    WavefrontStats* stats = nullptr,
+    EXP::THREAD::Pool& pool = EXP::THREAD::Pool::shared()
+  );
+  // Bins, then whether anything blocks each queued ray (Tlas::occluded) to occluded[slot]; one ray
+  // at a time whatever settings.isa, packets being for closest hits
+  static void occluded(
+    const Tlas<Bvh8>& tlas,
+    RayQueue& queue,
+    std::vector<uint8_t>& occluded,
+    const WavefrontSettings& settings = {},
+    WavefrontStats* stats = nullptr,
+    EXP::THREAD::Pool& pool = EXP::THREAD::Pool::shared()
+  );
+
+public:
+  // Bin key: octant (sign bits, x highest) above the 3 * cellBits bit Morton code of the cell
+  static uint64_t key(const BvhRay& ray, const Aabb& origins, uint32_t cellBits);
+};
+
+}; // namespace Host
+}; // namespace Renderer
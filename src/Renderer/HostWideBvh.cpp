@@ -0,0 +1,442 @@
+#include <Renderer/HostWideBvh.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using EXP::MATH::packed3;
+using Renderer::Host::Aabb;
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhCounters;
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhNode;
+using Renderer::Host::BvhRay;
+using Renderer::Host::BvhReport;
+using Renderer::Host::BvhTriangle;
+using Renderer::Host::WideBvh;
+using Renderer::Host::WideNode;
+using Renderer::Host::WideQuantizedNode;
+using Renderer::Host::WideSettings;
+
+
+namespace {
+
+constexpr uint32_t STACK_DEPTH = 128; // Binary tree depth traversal is sized for, as Bvh::intersect
+constexpr int MIN_EXPONENT = -126;    // Quantization scales stay normal floats
+
+inline bool fail(std::string* error, const std::string& message) {
+  if (error) *error = message;
+  return false;
+}
+
+// Four floats, ints and bytes in the compiler's vector extensions: one 128 bit register on NEON and
+// SSE alike. Bvh8 nodes are tested as two groups of four.
+typedef float F4 __attribute__((vector_size(16)));
+typedef int32_t I4 __attribute__((vector_size(16)));
+typedef uint8_t B4 __attribute__((vector_size(4)));
+
+inline F4 splat(float x) { return F4{x, x, x, x}; }
+inline F4 load(const float* p) {
+  F4 v;
+  std::memcpy(&v, p, sizeof(F4));
+  return v;
+}
+inline F4 load(const uint8_t* p) {
+  B4 v;
+  std::memcpy(&v, p, sizeof(B4));
+  return __builtin_convertvector(v, F4);
+}
+inline F4 select(I4 mask, F4 a, F4 b) { return (F4)((mask & (I4)a) | (~mask & (I4)b)); }
+inline F4 min(F4 a, F4 b) { return select(a < b, a, b); }
+inline F4 max(F4 a, F4 b) { return select(a > b, a, b); }
+inline uint32_t bits(I4 mask) { return (mask[0] & 1) | (mask[1] & 2) | (mask[2] & 4) | (mask[3] & 8); }
+
+inline float exp2i(int exponent) {
+  const uint32_t bits = (uint32_t)(exponent + 127) << 23;
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+// What the slab tests need of a ray, splatted once
+struct RayLanes {
+  packed3 origin, inverse;
+  uint32_t near[3], far[3]; // Plane rows: min for a positive direction, max for a negative one
+  F4 ix, iy, iz, ox, oy, oz, tmin;
+
+  explicit RayLanes(const BvhRay& ray) : origin(ray.origin) {
+    inverse = {1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+    for (int axis = 0; axis < 3; axis++) {
+      near[axis] = 2 * axis + (inverse[axis] < 0.0f);
+      far[axis] = near[axis] ^ 1;
+    }
+    ix = splat(inverse.x), iy = splat(inverse.y), iz = splat(inverse.z);
+    ox = splat(origin.x * inverse.x), oy = splat(origin.y * inverse.y), oz = splat(origin.z * inverse.z);
+    tmin = splat(ray.tmin);
+  }
+};
+
+// Entry distances of the children, and a bit per child whose box the ray enters before `closest`
+template <uint32_t N> inline uint32_t test(const WideNode<N>& node, const RayLanes& r, float closest, float* tNear) {
+  uint32_t result = 0;
+  for (uint32_t g = 0; g < N; g += 4) {
+    const F4 nx = load(node.bounds[r.near[0]] + g) * r.ix - r.ox;
+    const F4 ny = load(node.bounds[r.near[1]] + g) * r.iy - r.oy;
+    const F4 nz = load(node.bounds[r.near[2]] + g) * r.iz - r.oz;
+    const F4 fx = load(node.bounds[r.far[0]] + g) * r.ix - r.ox;
+    const F4 fy = load(node.bounds[r.far[1]] + g) * r.iy - r.oy;
+    const F4 fz = load(node.bounds[r.far[2]] + g) * r.iz - r.oz;
+    const F4 enter = max(max(nx, ny), max(nz, r.tmin));
+    const F4 exit = min(min(fx, fy), min(fz, splat(closest)));
+    std::memcpy(tNear + g, &enter, sizeof(F4));
+    result |= bits(enter <= exit) << g;
+  }
+  return result;
+}
+
+// A plane is origin + q * scale, so t = q * (scale * inverse) + (origin - o) * inverse
+template <uint32_t N>
+inline uint32_t test(const WideQuantizedNode<N>& node, const RayLanes& r, float closest, float* tNear) {
+  F4 a[3], b[3];
+  for (int axis = 0; axis < 3; axis++) {
+    a[axis] = splat(exp2i(node.exponent[axis]) * r.inverse[axis]);
+    b[axis] = splat((node.origin[axis] - r.origin[axis]) * r.inverse[axis]);
+  }
+  uint32_t result = 0;
+  for (uint32_t g = 0; g < N; g += 4) {
+    const F4 nx = load(node.bounds[r.near[0]] + g) * a[0] + b[0];
+    const F4 ny = load(node.bounds[r.near[1]] + g) * a[1] + b[1];
+    const F4 nz = load(node.bounds[r.near[2]] + g) * a[2] + b[2];
+    const F4 fx = load(node.bounds[r.far[0]] + g) * a[0] + b[0];
+    const F4 fy = load(node.bounds[r.far[1]] + g) * a[1] + b[1];
+    const F4 fz = load(node.bounds[r.far[2]] + g) * a[2] + b[2];
+    const F4 enter = max(max(nx, ny), max(nz, r.tmin));
+    const F4 exit = min(min(fx, fy), min(fz, splat(closest)));
+    std::memcpy(tNear + g, &enter, sizeof(F4));
+    result |= bits(enter <= exit) << g;
+  }
+  return result;
+}
+
+template <uint32_t N, typename Node>
+bool traverse(const WideBvh<N>& wide, const std::vector<Node>& nodes, const BvhRay& ray, BvhHit& hit, BvhCounters* counters) {
+  const RayLanes lanes(ray);
+  float closest = ray.tmax;
+  uint32_t found = WideBvh<N>::EMPTY;
+  float foundU = 0.0f, foundV = 0.0f;
+
+  struct Entry {
+    uint32_t child;
+    uint32_t count; // 0 for a node
+    float t;
+  };
+  Entry stack[STACK_DEPTH * (N - 1)];
+  int top = 0;
+  Entry current = {0, 0, ray.tmin};
+  while (true) {
+    if (current.count > 0) {
+      if (counters) counters->leaves++, counters->triangles += current.count;
+      for (uint32_t i = current.child; i < current.child + current.count; i++) {
+        float t, u, v;
+        if (!wide.triangles[i].intersect(ray.origin, ray.direction, ray.tmin, closest, t, u, v)) continue;
+        closest = t, found = i, foundU = u, foundV = v;
+      }
+    } else {
+      if (counters) counters->nodes++;
+      const Node& node = nodes[current.child];
+      float tNear[N];
+      uint32_t bits = test(node, lanes, closest, tNear);
+      // Children hit, farthest first: the last one is next, the others wait on the stack
+      Entry hits[N];
+      uint32_t count = 0;
+      while (bits) {
+        const uint32_t lane = __builtin_ctz(bits);
+        bits &= bits - 1;
+        if (node.child[lane] == WideBvh<N>::EMPTY) continue;
+        const Entry entry = {node.child[lane], node.count[lane], tNear[lane]};
+        uint32_t j = count++;
+        for (; j > 0 && hits[j - 1].t < entry.t; j--) hits[j] = hits[j - 1];
+        hits[j] = entry;
+      }
+      if (count > 0) {
+        for (uint32_t j = 0; j + 1 < count; j++) stack[top++] = hits[j];
+        current = hits[count - 1];
+        continue;
+      }
+    }
+    // Pop, skipping entries a closer hit has ruled out since they were pushed
+    do {
+      if (top == 0) {
+        if (found == WideBvh<N>::EMPTY) return false;
+        const uint32_t primitive = wide.primitives[found];
+        hit.t = closest, hit.u = foundU, hit.v = foundV, hit.primitive = primitive, hit.entry = found;
+        hit.geometry =
+          (uint32_t)(std::upper_bound(wide.geometryFirst.begin(), wide.geometryFirst.end(), primitive) - wide.geometryFirst.begin()) - 1;
+        return true;
+      }
+      current = stack[--top];
+    } while (current.t > closest);
+  }
+}
+
+// Any hit: the first triangle found ends it, children are visited in lane order. tmax is exclusive,
+// as for triangles, where the slab test's `closest` is not: boxes touching it are entered.
+template <uint32_t N, typename Node>
+bool occlude(const WideBvh<N>& wide, const std::vector<Node>& nodes, const BvhRay& ray, BvhCounters* counters) {
+  const RayLanes lanes(ray);
+  struct Entry {
+    uint32_t child;
+    uint32_t count; // 0 for a node
+  };
+  Entry stack[STACK_DEPTH * (N - 1)];
+  int top = 0;
+  Entry current = {0, 0};
+  while (true) {
+    if (current.count > 0) {
+      if (counters) counters->leaves++, counters->triangles += current.count;
+      for (uint32_t i = current.child; i < current.child + current.count; i++) {
+        float t, u, v;
+        if (wide.triangles[i].intersect(ray.origin, ray.direction, ray.tmin, ray.tmax, t, u, v)) return true;
+      }
+    } else {
+      if (counters) counters->nodes++;
+      const Node& node = nodes[current.child];
+      float tNear[N];
+      uint32_t bits = test(node, lanes, ray.tmax, tNear);
+      bool next = false;
+      while (bits) {
+        const uint32_t lane = __builtin_ctz(bits);
+        bits &= bits - 1;
+        if (node.child[lane] == WideBvh<N>::EMPTY) continue;
+        const Entry entry = {node.child[lane], node.count[lane]};
+        if (next) stack[top++] = current;
+        current = entry, next = true;
+      }
+      if (next) continue;
+    }
+    if (top == 0) return false;
+    current = stack[--top];
+  }
+}
+
+// 8 bits per plane on a power of two grid from the node's minimum, rounded outwards
+template <uint32_t N> WideQuantizedNode<N> quantize(const WideNode<N>& node) {
+  WideQuantizedNode<N> result;
+  Aabb box;
+  for (uint32_t lane = 0; lane < N; lane++) {
+    if (node.child[lane] == WideBvh<N>::EMPTY) continue;
+    box.grow(Aabb{{node.bounds[0][lane], node.bounds[2][lane], node.bounds[4][lane]}, {node.bounds[1][lane], node.bounds[3][lane], node.bounds[5][lane]}});
+  }
+  if (box.empty()) box = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+  result.origin = box.min;
+
+  for (int axis = 0; axis < 3; axis++) {
+    const float origin = box.min[axis], extent = box.max[axis] - box.min[axis];
+    int exponent = MIN_EXPONENT;
+    if (extent > 0.0f) std::frexp(extent / 255.0f, &exponent);
+    exponent = std::max(exponent, MIN_EXPONENT);
+    while (origin + 255.0f * exp2i(exponent) < box.max[axis]) exponent++;
+    result.exponent[axis] = (int8_t)exponent;
+    const float scale = exp2i(exponent);
+
+    for (uint32_t lane = 0; lane < N; lane++) {
+      const float lo = node.bounds[2 * axis][lane], hi = node.bounds[2 * axis + 1][lane];
+      int qlo = 255, qhi = 0; // Empty: no ray gets from the near plane to the far one
+      if (node.child[lane] != WideBvh<N>::EMPTY && lo <= hi) {
+        qlo = std::clamp((int)std::floor((lo - origin) / scale), 0, 255);
+        while (qlo > 0 && origin + qlo * scale > lo) qlo--;
+        qhi = std::clamp((int)std::ceil((hi - origin) / scale), 0, 255);
+        while (qhi < 255 && origin + qhi * scale < hi) qhi++;
+      }
+      result.bounds[2 * axis][lane] = (uint8_t)qlo;
+      result.bounds[2 * axis + 1][lane] = (uint8_t)qhi;
+    }
+  }
+  for (uint32_t lane = 0; lane < N; lane++) {
+    result.child[lane] = node.child[lane];
+    result.count[lane] = (uint16_t)node.count[lane];
+  }
+  return result;
+}
+
+template <uint32_t N> Aabb laneBounds(const WideNode<N>& node, uint32_t lane) {
+  return {{node.bounds[0][lane], node.bounds[2][lane], node.bounds[4][lane]}, {node.bounds[1][lane], node.bounds[3][lane], node.bounds[5][lane]}};
+}
+
+template <uint32_t N> Aabb laneBounds(const WideQuantizedNode<N>& node, uint32_t lane) {
+  Aabb box;
+  for (int axis = 0; axis < 3; axis++) {
+    const float scale = exp2i(node.exponent[axis]);
+    box.min[axis] = node.origin[axis] + node.bounds[2 * axis][lane] * scale;
+    box.max[axis] = node.origin[axis] + node.bounds[2 * axis + 1][lane] * scale;
+  }
+  return box;
+}
+
+template <uint32_t N, typename Node> bool validateNodes(const WideBvh<N>& wide, const std::vector<Node>& nodes, std::string* error) {
+  if (nodes.empty()) return fail(error, "No nodes");
+  std::vector<uint8_t> reached(nodes.size(), 0), covered(wide.triangles.size(), 0);
+  std::vector<uint32_t> stack = {0};
+  while (!stack.empty()) {
+    const uint32_t index = stack.back();
+    stack.pop_back();
+    if (index >= nodes.size()) return fail(error, "Child out of range: " + std::to_string(index));
+    if (reached[index]) return fail(error, "Node reached twice: " + std::to_string(index));
+    reached[index] = 1;
+    const Node& node = nodes[index];
+    for (uint32_t lane = 0; lane < N; lane++) {
+      if (node.child[lane] == WideBvh<N>::EMPTY) continue;
+      if (node.count[lane] == 0) {
+        stack.push_back(node.child[lane]);
+        continue;
+      }
+      const Aabb box = laneBounds(node, lane);
+      if ((size_t)node.child[lane] + node.count[lane] > wide.triangles.size()) return fail(error, "Leaf out of range in node " + std::to_string(index));
+      for (uint32_t i = node.child[lane]; i < node.child[lane] + node.count[lane]; i++) {
+        if (covered[i]) return fail(error, "Triangle in two leaves: " + std::to_string(i));
+        covered[i] = 1;
+        Aabb triangle;
+        triangle.grow(wide.triangles[i].v0);
+        triangle.grow(wide.triangles[i].v1);
+        triangle.grow(wide.triangles[i].v2);
+        const bool touches = box.min.x <= triangle.max.x && triangle.min.x <= box.max.x && box.min.y <= triangle.max.y &&
+                             triangle.min.y <= box.max.y && box.min.z <= triangle.max.z && triangle.min.z <= box.max.z;
+        if (wide.spatial ? !touches : !box.contains(triangle)) {
+          return fail(error, "Leaf does not contain its triangle: " + std::to_string(i));
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < covered.size(); i++) {
+    if (!covered[i]) return fail(error, "Triangle in no leaf: " + std::to_string(i));
+  }
+  return true;
+}
+
+template <uint32_t N> BvhReport collapse(const Bvh& bvh, WideBvh<N>& wide, const WideSettings& settings) {
+  const auto start = std::chrono::steady_clock::now();
+  wide.nodes.clear();
+  wide.quantized.clear();
+  wide.triangles.clear();
+  wide.primitives.clear();
+  wide.geometryFirst = bvh.geometryFirst;
+  wide.spatial = bvh.spatial;
+  BvhReport result;
+  if (bvh.nodes.empty()) return result;
+
+  const Renderer::Host::BvhSettings costs;
+  const double rootArea = std::max((double)bvh.nodes[0].bounds().area(), 1e-30);
+  wide.triangles.reserve(bvh.primitives.size());
+  wide.primitives.reserve(bvh.primitives.size());
+  wide.nodes.reserve(bvh.nodes.size() / (N - 1) + 1);
+  wide.nodes.emplace_back();
+
+  struct Pending {
+    uint32_t binary, wide, depth;
+  };
+  std::vector<Pending> stack = {{0, 0, 1}};
+  while (!stack.empty()) {
+    const Pending pending = stack.back();
+    stack.pop_back();
+    result.depth = std::max(result.depth, pending.depth);
+    result.sahCost += costs.traversalCost * bvh.nodes[pending.binary].bounds().area() / rootArea;
+
+    // Open the largest interior child until there are N
+    uint32_t children[N];
+    uint32_t count = 0;
+    const BvhNode& source = bvh.nodes[pending.binary];
+    if (source.isLeaf()) children[count++] = pending.binary;
+    else children[count++] = source.index, children[count++] = source.index + 1;
+    while (count < N) {
+      int largest = -1;
+      float area = -1.0f;
+      for (uint32_t i = 0; i < count; i++) {
+        const BvhNode& child = bvh.nodes[children[i]];
+        if (!child.isLeaf() && child.bounds().area() > area) largest = (int)i, area = child.bounds().area();
+      }
+      if (largest < 0) break;
+      const uint32_t opened = bvh.nodes[children[largest]].index;
+      children[largest] = opened;
+      children[count++] = opened + 1;
+    }
+
+    WideNode<N> node;
+    for (uint32_t lane = 0; lane < N; lane++) {
+      if (lane >= count) {
+        for (int axis = 0; axis < 3; axis++) node.bounds[2 * axis][lane] = INFINITY, node.bounds[2 * axis + 1][lane] = -INFINITY;
+        node.child[lane] = WideBvh<N>::EMPTY;
+        node.count[lane] = 0;
+        continue;
+      }
+      const BvhNode& child = bvh.nodes[children[lane]];
+      for (int axis = 0; axis < 3; axis++) node.bounds[2 * axis][lane] = child.min[axis], node.bounds[2 * axis + 1][lane] = child.max[axis];
+      if (child.isLeaf()) {
+        node.child[lane] = (uint32_t)wide.triangles.size();
+        node.count[lane] = child.count;
+        for (uint32_t i = child.index; i < child.index + child.count; i++) {
+          wide.primitives.push_back(bvh.primitives[i]);
+          wide.triangles.push_back(bvh.triangle(i));
+        }
+        result.leaves++;
+        result.sahCost += costs.intersectionCost * child.count * child.bounds().area() / rootArea;
+      } else {
+        node.child[lane] = (uint32_t)wide.nodes.size();
+        node.count[lane] = 0;
+        wide.nodes.emplace_back();
+        stack.push_back({children[lane], node.child[lane], pending.depth + 1});
+      }
+    }
+    wide.nodes[pending.wide] = node;
+  }
+
+  if (settings.quantized) {
+    wide.quantized.resize(wide.nodes.size());
+    for (size_t i = 0; i < wide.nodes.size(); i++) wide.quantized[i] = quantize(wide.nodes[i]);
+    wide.nodes.clear();
+    wide.nodes.shrink_to_fit();
+  }
+  result.nodes = wide.nodeCount();
+  result.references = wide.triangles.size();
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+} // namespace
+
+
+template <uint32_t N>
+bool Renderer::Host::WideBvh<N>::intersect(const BvhRay& ray, BvhHit& hit, BvhCounters* counters) const {
+  if (nodeCount() == 0 || triangles.empty()) return false;
+  return isQuantized() ? traverse(*this, quantized, ray, hit, counters) : traverse(*this, nodes, ray, hit, counters);
+}
+
+template <uint32_t N> bool Renderer::Host::WideBvh<N>::occluded(const BvhRay& ray, BvhCounters* counters) const {
+  if (nodeCount() == 0 || triangles.empty()) return false;
+  return isQuantized() ? occlude(*this, quantized, ray, counters) : occlude(*this, nodes, ray, counters);
+}
+
+template <uint32_t N> Aabb Renderer::Host::WideBvh<N>::bounds() const {
+  Aabb result;
+  for (uint32_t lane = 0; lane < N && nodeCount() > 0; lane++) {
+    if (isQuantized() ? quantized[0].child[lane] != EMPTY : nodes[0].child[lane] != EMPTY) {
+      result.grow(isQuantized() ? laneBounds(quantized[0], lane) : laneBounds(nodes[0], lane));
+    }
+  }
+  return result;
+}
+
+template <uint32_t N> bool Renderer::Host::WideBvh<N>::validate(std::string* error) const {
+  return isQuantized() ? validateNodes(*this, quantized, error) : validateNodes(*this, nodes, error);
+}
+
+template struct Renderer::Host::WideBvh<4>;
+template struct Renderer::Host::WideBvh<8>;
+
+
+BvhReport Renderer::Host::WideBuilder::collapse(const Bvh& bvh, Bvh4& wide, const WideSettings& settings) {
+  return ::collapse(bvh, wide, settings);
+}
+
+BvhReport Renderer::Host::WideBuilder::collapse(const Bvh& bvh, Bvh8& wide, const WideSettings& settings) {
+  return ::collapse(bvh, wide, settings);
+}
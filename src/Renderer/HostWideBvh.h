@@ -0,0 +1,98 @@
+#pragma once
+#include <Renderer/HostBvh.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Wide BVHs for CPU traversal: a binary Bvh collapsed so that every node holds up to 4 (Bvh4) or
+ * 8 (Bvh8) children, tested against a ray all at once. A binary tree needs two or three levels,
+ * each a dependent load, to get to the children one wide node holds side by side.
+ *
+ * Collapse: a node starts out with its two binary children; the interior child with the largest
+ * surface area is replaced by its own two until there are N, or no interior ones are left. Binary
+ * leaves stay leaves. Their triangles are copied out in leaf order, so a leaf is one contiguous run
+ * and traversal does not go through the primitive ids.
+ *
+ * WideNode holds the child boxes structure of arrays: a row of N floats per plane (min x, max x,
+ * min y, ...), so one vector load covers a plane of four children. WideQuantizedNode stores each plane
+ * as 8 bits relative to the node's own box, with a power of two scale per axis, rounded outwards
+ * (Ylitie et al. 2017): half the node bytes for a few more false positive box hits.
+ *
+ * The kernel uses the compiler's vector extensions rather than intrinsics: four children per 128 bit
+ * register, NEON on Apple silicon and SSE on x86 from the same source, two registers for a Bvh8 node.
+ * The near plane of each axis is picked once per ray from the sign of its direction, so the slab test
+ * is a multiply-subtract and a min / max per plane. Children hit are visited nearest first.
+ **/
+
+namespace Renderer {
+namespace Host {
+
+template <uint32_t N> struct alignas(64) WideNode {
+  float bounds[6][N]; // min x, max x, min y, max y, min z, max z of each child
+  uint32_t child[N];  // Interior: node index. Leaf: first triangle. EMPTY for unused lanes.
+  uint32_t count[N];  // Triangles of a leaf, 0 for interior children
+};
+
+template <uint32_t N> struct alignas(64) WideQuantizedNode {
+  EXP::MATH::packed3 origin; // Minimum of the node's box
+  int8_t exponent[3];        // Per axis, a plane is at origin + q * 2^exponent
+  uint8_t pad = 0;
+  uint8_t bounds[6][N]; // q of each plane, same order as WideNode
+  uint16_t count[N];
+  uint32_t child[N];
+};
+
+static_assert(sizeof(WideNode<4>) == 128, "Two cache lines");
+static_assert(sizeof(WideNode<8>) == 256, "Four cache lines");
+static_assert(sizeof(WideQuantizedNode<4>) == 64, "One cache line");
+static_assert(sizeof(WideQuantizedNode<8>) == 128, "Two cache lines");
+
+struct WideSettings {
+  bool quantized = false;
+};
+
+template <uint32_t N> struct WideBvh {
+  static constexpr uint32_t EMPTY = 0xFFFFFFFF;
+
+  std::vector<WideNode<N>> nodes;              // nodes[0] is the root
+  std::vector<WideQuantizedNode<N>> quantized; // Instead of `nodes` with WideSettings::quantized
+  std::vector<BvhTriangle> triangles;          // Leaf order
+  std::vector<uint32_t> primitives;            // Triangle id of each entry in `triangles`
+  std::vector<uint32_t> geometryFirst;         // As in Bvh
+  bool spatial = false;                        // As in Bvh
+
+  inline bool isQuantized() const { return !quantized.empty(); }
+  inline size_t nodeCount() const { return isQuantized() ? quantized.size() : nodes.size(); }
+  // Of the root's children
+  Aabb bounds() const;
+  inline size_t bytes() const {
+    return nodes.size() * sizeof(WideNode<N>) + quantized.size() * sizeof(WideQuantizedNode<N>) +
+           triangles.size() * sizeof(BvhTriangle) + primitives.size() * sizeof(uint32_t);
+  }
+
+  // Closest hit in [ray.tmin, ray.tmax], the same one Bvh::intersect finds
+  bool intersect(const BvhRay& ray, BvhHit& hit, BvhCounters* counters = nullptr) const;
+  // Whether any triangle is hit in [ray.tmin, ray.tmax), as Bvh::occluded
+  bool occluded(const BvhRay& ray, BvhCounters* counters = nullptr) const;
+  // Nodes reached once, leaves tiling `triangles`, leaf boxes around (or, spatial, touching) them
+  bool validate(std::string* error = nullptr) const;
+};
+
+using Bvh4 = WideBvh<4>;
+using Bvh8 = WideBvh<8>;
+
+class WideBuilder {
+public:
+  WideBuilder(){};
+  ~WideBuilder(){};
+
+public:
+  // Collapses a built binary tree; sahCost and depth are those of the wide tree
+  static BvhReport collapse(const Bvh& bvh, Bvh4& wide, const WideSettings& settings = {});
+  static BvhReport collapse(const Bvh& bvh, Bvh8& wide, const WideSettings& settings = {});
+};
+
+}; // namespace Host
+}; // namespace Renderer
@@ -0,0 +1,99 @@
+#include <Renderer/Streaming.h>
+
+
+Renderer::Streaming::Streaming(MTL::Device* device, uint32_t framesInFlight, uint32_t depth)
+    : device(device->retain()), framesInFlight(framesInFlight), depth(depth) {
+	worker = std::thread(&Streaming::upload, this);
+}
+
+Renderer::Streaming::~Streaming() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	worker.join();
+	for (Job& job : queued) job.texture->release();
+	for (Job& job : finished) job.texture->release();
+	for (auto& [handle, texture] : textures) texture->release();
+	for (Retired& entry : retired) entry.texture->release();
+	device->release();
+}
+
+bool Renderer::Streaming::submit(const Host::StreamSource& source, const Host::StreamUpload& upload) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (inFlight >= depth) return false;
+	}
+	const Host::StreamLevel& top = source.levels[upload.first];
+	const size_t levels = source.levels.size() - upload.first;
+	MTL::TextureDescriptor* descriptor =
+		MTL::TextureDescriptor::texture2DDescriptor((MTL::PixelFormat)source.format, top.width, top.height, levels > 1);
+	descriptor->setMipmapLevelCount(levels);
+	descriptor->setUsage(MTL::TextureUsageShaderRead);
+	descriptor->setStorageMode(MTL::StorageModeShared);
+	MTL::Texture* texture = device->newTexture(descriptor);
+	if (!texture) return false;
+
+	Job job = {source, upload, texture};
+	job.upload.handle = texture->gpuResourceID()._impl;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.emplace_back(std::move(job));
+		inFlight++;
+	}
+	wake.notify_one();
+	return true;
+}
+
+// Upload thread: the level copies, off the render thread
+void Renderer::Streaming::upload() {
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || !queued.empty(); });
+			if (stopping) return;
+			job = std::move(queued.front());
+			queued.pop_front();
+		}
+		for (size_t level = 0; level + job.upload.first < job.source.levels.size(); level++) {
+			const Host::StreamLevel& image = job.source.levels[job.upload.first + level];
+			job.texture->replaceRegion(MTL::Region(0, 0, image.width, image.height), level, image.data, image.rowBytes);
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.emplace_back(std::move(job));
+	}
+}
+
+void Renderer::Streaming::poll(std::vector<Host::StreamUpload>& done) {
+	frame += 1;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (Job& job : finished) {
+			textures.insert({job.upload.handle, job.texture});
+			done.emplace_back(job.upload);
+		}
+		inFlight -= finished.size();
+		finished.clear();
+	}
+
+	size_t kept = 0;
+	for (Retired& entry : retired) {
+		if (entry.frame + framesInFlight <= frame) entry.texture->release();
+		else retired[kept++] = entry;
+	}
+	retired.resize(kept);
+}
+
+void Renderer::Streaming::retire(uint64_t handle) {
+	auto found = textures.find(handle);
+	if (found == textures.end()) return;
+	retired.push_back({found->second, frame});
+	textures.erase(found);
+}
+
+MTL::Texture* Renderer::Streaming::texture(uint64_t handle) const {
+	auto found = textures.find(handle);
+	return found == textures.end() ? nullptr : found->second;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <Renderer/HostStreaming.h>
+#include <pch.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace Renderer {
+
+/**
+ * Metal side of Host::TextureStreamer. Handles are gpuResourceID() values, so the streamer writes
+ * them straight into the Text2D buffer. Textures are shared storage: submit only allocates, and an
+ * upload thread copies the CPU levels in with replaceRegion, at most `depth` textures queued. poll
+ * hands out the ones it finished. Retired textures are released `framesInFlight` polls later, once
+ * no command buffer can still sample them.
+ **/
+class Streaming : public Host::StreamBackend {
+public:
+	Streaming(MTL::Device* device, uint32_t framesInFlight = 3, uint32_t depth = 8);
+	~Streaming();
+
+public:
+	bool submit(const Host::StreamSource& source, const Host::StreamUpload& upload) override;
+	void poll(std::vector<Host::StreamUpload>& done) override;
+	void retire(uint64_t handle) override;
+
+public:
+	MTL::Texture* texture(uint64_t handle) const;
+
+private:
+	void upload();
+
+private:
+	struct Job {
+		Host::StreamSource source; // Its store keeps the levels alive until the copy is done
+		Host::StreamUpload upload;
+		MTL::Texture* texture = nullptr;
+	};
+	struct Retired {
+		MTL::Texture* texture;
+		uint64_t frame;
+	};
+	MTL::Device* device;
+	uint32_t framesInFlight;
+	uint32_t depth;
+	uint64_t frame = 0;
+	std::vector<Retired> retired;
+	std::unordered_map<uint64_t, MTL::Texture*> textures;
+
+	// Shared with the upload thread
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Job> queued;
+	std::vector<Job> finished;
+	size_t inFlight = 0; // Queued or being copied, not yet polled
+	bool stopping = false;
+	std::thread worker;
+};
+
+}; // namespace Renderer
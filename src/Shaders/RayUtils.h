@@ -51,31 +51,30 @@ bool intersect_ground_plane(
 }
 
 
+// Occlusion query: any triangle in [min_distance, light) blocks it, the first one found ends traversal
 bool shadow_ray(
 	thread ray& s,
 	thread instance_acceleration_structure& structure,
 	float3 vec_to_light,
 	float3 vec_light_origin
 ) {
-	bool result = false;
 	float prev_min_distance = s.min_distance;
+	float prev_max_distance = s.max_distance;
 	float3 prev_direction = s.direction;
 
 	s.min_distance = 0.001f;						// Set to avoid self-occlusion
+	s.max_distance = distance(vec_light_origin, s.origin) - 0.001f;	// Short of the light's own triangles
 	s.direction = vec_to_light;
 
-	intersector<instancing, triangle_data> shadow_intersector;	
+	intersector<instancing> shadow_intersector;
 	shadow_intersector.assume_geometry_type(geometry_type::triangle);
-	intersection_result<instancing, triangle_data> shadow_intersection;
+	shadow_intersector.accept_any_intersection(true);
+	intersection_result<instancing> shadow_intersection;
 	shadow_intersection = shadow_intersector.intersect(s, structure, 0xFF);
-
-	if (shadow_intersection.type == intersection_type::triangle) {
-		// const device PrimitiveAttributes* prim = (const device PrimitiveAttributes*) shadow_intersection.primitive_data;
-		float3 origin = s.origin + s.direction * shadow_intersection.distance;
-		result = (abs(distance(vec_light_origin, origin)) < 0.001);
-	}
+	bool result = shadow_intersection.type == intersection_type::none;
 
 	s.min_distance = prev_min_distance;
+	s.max_distance = prev_max_distance;
 	s.direction = prev_direction;
 	return result;
 }
@@ -0,0 +1,104 @@
+#include <Thread/Pool.h>
+#include <algorithm>
+
+namespace {
+thread_local bool insideJob = false;
+}
+
+EXP::THREAD::Pool::Pool(unsigned int threads) {
+  if (threads == 0) threads = hardwareThreads();
+  for (unsigned int i = 1; i < threads; i++) workers.emplace_back(&Pool::work, this);
+}
+
+EXP::THREAD::Pool::~Pool() {
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread& worker : workers) worker.join();
+}
+
+EXP::THREAD::Pool& EXP::THREAD::Pool::shared() {
+  static Pool pool;
+  return pool;
+}
+
+unsigned int EXP::THREAD::Pool::hardwareThreads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+bool EXP::THREAD::Pool::isWorker() { return insideJob; }
+
+void EXP::THREAD::Pool::runBlocks() {
+  const std::function<void(size_t, size_t)>& fn = *job;
+  for (size_t begin = next.fetch_add(jobGrain); begin < jobCount; begin = next.fetch_add(jobGrain)) {
+    fn(begin, std::min(begin + jobGrain, jobCount));
+  }
+}
+
+void EXP::THREAD::Pool::work() {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(stateMutex);
+      wake.wait(lock, [&] { return stopping || (generation != seen && seats > 0); });
+      if (stopping) return;
+      seen = generation;
+      seats -= 1;
+      running += 1;
+    }
+    insideJob = true;
+    runBlocks();
+    insideJob = false;
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      running -= 1;
+    }
+    done.notify_all();
+  }
+}
+
+void EXP::THREAD::Pool::parallelFor(
+  size_t count,
+  size_t grain,
+  const std::function<void(size_t, size_t)>& fn,
+  unsigned int maxThreads
+) {
+  if (count == 0) return;
+  grain = std::max<size_t>(grain, 1);
+  unsigned int helpers = (unsigned int)workers.size();
+  if (maxThreads) helpers = std::min(helpers, maxThreads - 1);
+  helpers = (unsigned int)std::min<size_t>(helpers, (count + grain - 1) / grain - 1);
+
+  // Serial: nothing to share, or we are already inside a job
+  if (helpers == 0 || insideJob) {
+    bool wasInside = insideJob;
+    insideJob = true;
+    for (size_t begin = 0; begin < count; begin += grain) fn(begin, std::min(begin + grain, count));
+    insideJob = wasInside;
+    return;
+  }
+
+  std::lock_guard<std::mutex> jobLock(jobMutex);
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    job = &fn;
+    jobCount = count;
+    jobGrain = grain;
+    next.store(0);
+    seats = helpers;
+    generation += 1;
+  }
+  wake.notify_all();
+
+  insideJob = true;
+  runBlocks();
+  insideJob = false;
+
+  // All blocks are claimed; close the seats and wait for workers still inside
+  std::unique_lock<std::mutex> lock(stateMutex);
+  seats = 0;
+  done.wait(lock, [&] { return running == 0; });
+  job = nullptr;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Small fork/join thread pool for the CPU side (asset import, builders).
+ *
+ * parallelFor splits [0, count) in blocks of `grain` which are claimed through an
+ * atomic counter, so uneven blocks balance out. The calling thread joins in.
+ * Nested calls from inside a job run inline on the calling worker.
+ **/
+
+namespace EXP {
+namespace THREAD {
+
+class Pool {
+public:
+  explicit Pool(unsigned int threads = 0);
+  ~Pool();
+  Pool(const Pool&) = delete;
+  Pool& operator=(const Pool&) = delete;
+
+public:
+  static Pool& shared();
+  static unsigned int hardwareThreads();
+  static bool isWorker();
+
+public:
+  // Participants = min(maxThreads, size()); 0 means all of them.
+  void parallelFor(
+    size_t count,
+    size_t grain,
+    const std::function<void(size_t begin, size_t end)>& fn,
+    unsigned int maxThreads = 0
+  );
+  inline unsigned int size() const { return (unsigned int)workers.size() + 1; }
+
+private:
+  void work();
+  void runBlocks();
+
+private:
+  std::vector<std::thread> workers;
+  std::mutex jobMutex;   // One job at a time
+  std::mutex stateMutex; // Guards the fields below
+  std::condition_variable wake;
+  std::condition_variable done;
+
+  const std::function<void(size_t, size_t)>* job = nullptr;
+  size_t jobCount = 0;
+  size_t jobGrain = 1;
+  std::atomic<size_t> next{0};
+  unsigned int seats = 0;   // Workers still allowed to join the current job
+  unsigned int running = 0; // Workers inside the current job
+  uint64_t generation = 0;
+  bool stopping = false;
+};
+
+// Convenience wrapper around Pool::shared()
+inline void parallelFor(
+  size_t count,
+  size_t grain,
+  const std::function<void(size_t begin, size_t end)>& fn,
+  unsigned int maxThreads = 0
+) {
+  Pool::shared().parallelFor(count, grain, fn, maxThreads);
+}
+
+} // namespace THREAD
+} // namespace EXP
@@ -0,0 +1,174 @@
+#include <Thread/TileScheduler.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+using EXP::THREAD::Tile;
+using EXP::THREAD::TileSettings;
+using EXP::THREAD::TileStats;
+
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// One worker's run of tile indices; the owner takes from the head, thieves from the tail
+struct alignas(64) Deque {
+  std::mutex mutex;
+  std::vector<uint32_t> tiles;
+  size_t head = 0;
+  size_t tail = 0;
+
+  bool pop(uint32_t& tile) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (head == tail) return false;
+    tile = tiles[head++];
+    return true;
+  }
+  // The back half, rounded up
+  bool stealHalf(std::vector<uint32_t>& stolen) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (head == tail) return false;
+    const size_t count = (tail - head + 1) / 2;
+    stolen.assign(tiles.begin() + (tail - count), tiles.begin() + tail);
+    tail -= count;
+    return true;
+  }
+  void refill(std::vector<uint32_t>& stolen) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tiles.swap(stolen);
+    head = 0, tail = tiles.size();
+  }
+};
+
+// Spreads the low 32 bits of v into the even bits
+inline uint64_t spread(uint64_t v) {
+  v &= 0xFFFFFFFFull;
+  v = (v | v << 16) & 0x0000FFFF0000FFFFull;
+  v = (v | v << 8) & 0x00FF00FF00FF00FFull;
+  v = (v | v << 4) & 0x0F0F0F0F0F0F0F0Full;
+  v = (v | v << 2) & 0x3333333333333333ull;
+  v = (v | v << 1) & 0x5555555555555555ull;
+  return v;
+}
+
+} // namespace
+
+
+double EXP::THREAD::TileStats::imbalance() const {
+  if (workers.empty()) return 1.0;
+  double slowest = 0.0, total = 0.0;
+  for (const TileWorkerStats& worker : workers) slowest = std::max(slowest, worker.busy), total += worker.busy;
+  return total > 0.0 ? slowest * workers.size() / total : 1.0;
+}
+
+double EXP::THREAD::TileStats::efficiency() const {
+  if (workers.empty() || seconds <= 0.0) return 0.0;
+  double total = 0.0;
+  for (const TileWorkerStats& worker : workers) total += worker.busy;
+  return total / (workers.size() * seconds);
+}
+
+uint32_t EXP::THREAD::TileStats::steals() const {
+  uint32_t total = 0;
+  for (const TileWorkerStats& worker : workers) total += worker.steals;
+  return total;
+}
+
+uint32_t EXP::THREAD::TileStats::stolen() const {
+  uint32_t total = 0;
+  for (const TileWorkerStats& worker : workers) total += worker.stolen;
+  return total;
+}
+
+
+uint64_t EXP::THREAD::TileScheduler::morton(uint32_t x, uint32_t y) { return spread(x) | spread(y) << 1; }
+
+std::vector<Tile> EXP::THREAD::TileScheduler::tiles(uint32_t width, uint32_t height, uint32_t size, bool morton) {
+  size = std::max(size, 1u);
+  const uint32_t columns = (width + size - 1) / size, rows = (height + size - 1) / size;
+  std::vector<Tile> result;
+  result.reserve((size_t)columns * rows);
+  for (uint32_t ty = 0; ty < rows; ty++) {
+    for (uint32_t tx = 0; tx < columns; tx++) {
+      const uint32_t x = tx * size, y = ty * size;
+      result.push_back({x, y, std::min(size, width - x), std::min(size, height - y)});
+    }
+  }
+  // Z order over the tile grid; grids that are not square powers of two leave gaps in the curve,
+  // the order between the tiles there is kept
+  if (morton) {
+    std::stable_sort(result.begin(), result.end(), [&](const Tile& a, const Tile& b) {
+      return TileScheduler::morton(a.x / size, a.y / size) < TileScheduler::morton(b.x / size, b.y / size);
+    });
+  }
+  return result;
+}
+
+unsigned int EXP::THREAD::TileScheduler::workers(const TileSettings& settings, const Pool& pool) {
+  return settings.threads ? std::min(settings.threads, pool.size()) : pool.size();
+}
+
+TileStats EXP::THREAD::TileScheduler::run(
+  uint32_t width,
+  uint32_t height,
+  const std::function<void(const Tile&, unsigned int)>& fn,
+  const TileSettings& settings,
+  Pool& pool
+) {
+  const auto start = clock_type::now();
+  const std::vector<Tile> order = tiles(width, height, settings.size, settings.morton);
+  TileStats stats;
+  stats.tiles = (uint32_t)order.size();
+  if (order.empty()) return stats;
+  if (settings.timeTiles) stats.tileSeconds.assign(order.size(), 0.0);
+
+  // Contiguous runs of the order, one per worker
+  const unsigned int count = (unsigned int)std::min<size_t>(workers(settings, pool), order.size());
+  std::unique_ptr<Deque[]> deques(new Deque[count]);
+  for (unsigned int w = 0; w < count; w++) {
+    const size_t begin = order.size() * w / count, end = order.size() * (w + 1) / count;
+    for (size_t i = begin; i < end; i++) deques[w].tiles.push_back((uint32_t)i);
+    deques[w].tail = end - begin;
+  }
+  stats.workers.assign(count, {});
+
+  pool.parallelFor(
+    count,
+    1,
+    [&](size_t begin, size_t end) {
+      for (size_t w = begin; w < end; w++) {
+        TileWorkerStats& worker = stats.workers[w];
+        Deque& own = deques[w];
+        std::vector<uint32_t> stolen;
+        bool fromOthers = false;
+        while (true) {
+          uint32_t index;
+          if (!own.pop(index)) {
+            if (!settings.steal) break;
+            // Right neighbour first, so thieves spread over the victims
+            bool found = false;
+            for (unsigned int k = 1; k < count && !found; k++) found = deques[(w + k) % count].stealHalf(stolen);
+            if (!found) break;
+            worker.steals++;
+            own.refill(stolen);
+            fromOthers = true;
+            continue;
+          }
+          const auto tileStart = clock_type::now();
+          fn(order[index], (unsigned int)w);
+          const double seconds = std::chrono::duration<double>(clock_type::now() - tileStart).count();
+          worker.busy += seconds;
+          worker.tiles++;
+          worker.stolen += fromOthers;
+          if (settings.timeTiles) stats.tileSeconds[index] = seconds;
+        }
+      }
+    },
+    count
+  );
+
+  stats.seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+  return stats;
+}
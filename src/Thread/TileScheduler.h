@@ -0,0 +1,86 @@
+#pragma once
+#include <Thread/Pool.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * Tile scheduler for frames whose pixels cost very different amounts: sky pixels return after one
+ * ray, shaded ones trace shadow and bounce rays.
+ *
+ * The frame is cut into square tiles, ordered along a Morton (Z) curve of their tile coordinates so
+ * that tiles next to each other in the order are next to each other on screen, and touch the same
+ * nodes and triangles. Each worker gets a deque holding one contiguous run of that order. It takes
+ * tiles from the front of its own deque; once empty it steals the back half of another worker's
+ * (the tiles furthest from where that worker is), visiting the others from its right neighbour on.
+ * No tiles are added while a frame runs, so a worker that finds every deque empty is done.
+ *
+ * Deques are short (a few hundred tiles a frame) and touched once per tile, so each has its own
+ * lock rather than a lock free protocol. Workers are the participants of one Pool::parallelFor.
+ *
+ * TileStats has what it takes to judge the balance: per worker busy time, tiles run and stolen,
+ * steals; the frame time, the imbalance (slowest worker over the mean) and the efficiency (busy time
+ * over workers times frame time). With `timeTiles` it also keeps every tile's cost.
+ **/
+
+namespace EXP {
+namespace THREAD {
+
+struct Tile {
+  uint32_t x = 0, y = 0;          // Top left pixel
+  uint32_t width = 0, height = 0; // Clipped to the frame
+};
+
+struct TileSettings {
+  uint32_t size = 16;        // Tile edge in pixels
+  unsigned int threads = 0;  // Workers, 0 for the whole pool
+  bool morton = true;        // Z order; scanline order otherwise
+  bool steal = true;         // Workers only run their own deque otherwise
+  bool timeTiles = false;    // Keep the cost of every tile in TileStats::tileSeconds
+};
+
+struct TileWorkerStats {
+  double busy = 0.0;    // Seconds spent inside tiles
+  uint32_t tiles = 0;   // Tiles run
+  uint32_t stolen = 0;  // Of those, taken from other deques
+  uint32_t steals = 0;  // Successful steals
+};
+
+struct TileStats {
+  double seconds = 0.0;
+  uint32_t tiles = 0;
+  std::vector<TileWorkerStats> workers;
+  std::vector<double> tileSeconds; // By tile index in TileScheduler::tiles order, with timeTiles
+
+  double imbalance() const;  // Slowest worker's busy time over the mean, 1 when balanced
+  double efficiency() const; // Busy time over workers * seconds
+  uint32_t steals() const;
+  uint32_t stolen() const;
+};
+
+class TileScheduler {
+public:
+  TileScheduler(){};
+  ~TileScheduler(){};
+
+public:
+  // Calls fn(tile, worker) once for every tile of a width x height frame; worker is below the
+  // number of workers, and no two calls run on the same worker at once
+  static TileStats run(
+    uint32_t width,
+    uint32_t height,
+    const std::function<void(const Tile& tile, unsigned int worker)>& fn,
+    const TileSettings& settings = {},
+    Pool& pool = Pool::shared()
+  );
+  // Workers run will use
+  static unsigned int workers(const TileSettings& settings, const Pool& pool = Pool::shared());
+  // The tiles of a frame in the order they are dealt out
+  static std::vector<Tile> tiles(uint32_t width, uint32_t height, uint32_t size, bool morton = true);
+  // Bits of x and y interleaved, x in the even ones
+  static uint64_t morton(uint32_t x, uint32_t y);
+};
+
+} // namespace THREAD
+} // namespace EXP
@@ -0,0 +1,61 @@
+//
+// Block compression: encode throughput, PSNR and size per asset texture, format and quality.
+//
+#include <gtest/gtest.h>
+#include <DB/ImageRepository.hpp>
+#include <Renderer/HostBlock.h>
+#include <Renderer/HostMipmap.h>
+#include <Thread/Pool.h>
+#include <chrono>
+
+using clock_type = std::chrono::steady_clock;
+using Renderer::Host::BlockChain;
+using Renderer::Host::BlockCompress;
+using Renderer::Host::BlockFormat;
+using Renderer::Host::BlockQuality;
+using Renderer::Host::Image;
+
+static const char* QUALITY_NAMES[3] = {"fast", "normal", "best"};
+
+static Renderer::Host::MipChain readChain(const char* name) {
+  Image image;
+  EXPECT_TRUE(Repository::Images::read(std::string(EXPLORER_ASSET_DIR) + "/" + name, image));
+  Renderer::Host::MipChain chain;
+  Renderer::Host::Mipmap::build(image, chain);
+  return chain;
+}
+
+static double megapixels(const Renderer::Host::MipChain& chain) {
+  double pixels = 0.0;
+  for (const Image& level : chain.levels) pixels += (double)level.width * level.height;
+  return pixels / 1e6;
+}
+
+
+TEST(BENCH_BLOCK, Encode) {
+  for (const char* name : {"Meshes/f16/f16.bmp", "Meshes/cruiser/cruiser.bmp", "Textures/island.jpg"}) {
+    const Renderer::Host::MipChain chain = readChain(name);
+    for (BlockFormat format : {BlockFormat::BC1, BlockFormat::BC7}) {
+      for (int quality = 0; quality < 3; quality++) {
+        BlockChain blocks;
+        const Renderer::Host::BlockReport report = BlockCompress::encode(chain, blocks, format, (BlockQuality)quality);
+        std::cout << name << " " << (format == BlockFormat::BC1 ? "bc1" : "bc7") << " " << QUALITY_NAMES[quality] << ": "
+                  << report.seconds * 1000.0 << " ms, " << megapixels(chain) / report.seconds << " MP/s, " << report.psnr
+                  << " dB, " << chain.bytes() / 1024 << " -> " << blocks.bytes() / 1024 << " KB" << std::endl;
+      }
+    }
+  }
+}
+
+
+TEST(BENCH_BLOCK, Threads) {
+  const Renderer::Host::MipChain chain = readChain("Meshes/f16/f16.bmp");
+  double single = 0.0;
+  for (unsigned int threads = 1; threads <= EXP::THREAD::Pool::shared().size(); threads *= 2) {
+    BlockChain blocks;
+    const double seconds = BlockCompress::encode(chain, blocks, BlockFormat::BC7, BlockQuality::NORMAL, threads).seconds;
+    if (threads == 1) single = seconds;
+    std::cout << "bc7 normal x" << threads << ": " << seconds * 1000.0 << " ms, " << megapixels(chain) / seconds
+              << " MP/s, speedup " << single / seconds << std::endl;
+  }
+}
@@ -0,0 +1,295 @@
+//
+// Binned SAH BVH over the asset meshes: build time, SAH cost, node count, depth and closest hit rays/s.
+// Build scaling from one thread to the whole pool on a 5M triangle height field, and linear builds
+// of a 1M triangle one against the binned SAH build. Spatial splits against object splits only on the
+// asset meshes: rays/s gained for build time lost. Wide (4 and 8 child, float and quantized) trees
+// against the binary one: node visits per ray and rays/s. An animated instance list replayed through
+// the top level, rebuilt every frame against updated (skip / refit / rebuild): cost per frame.
+//
+#include <gtest/gtest.h>
+#include <DB/ObjRepository.hpp>
+#include <Renderer/HostBvh.h>
+#include <Renderer/HostInstance.h>
+#include <Renderer/HostWideBvh.h>
+#include <Thread/Pool.h>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using clock_type = std::chrono::steady_clock;
+using Renderer::Host::Aabb;
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhBuilder;
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhRay;
+using Renderer::Host::BvhSettings;
+
+// Rays from a sphere around the bounds towards points inside them
+static std::vector<BvhRay> rays(const Aabb& bounds, size_t count) {
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  const EXP::MATH::float3 center = {(bounds.min.x + bounds.max.x) * 0.5f, (bounds.min.y + bounds.max.y) * 0.5f, (bounds.min.z + bounds.max.z) * 0.5f};
+  const EXP::MATH::float3 half = {bounds.max.x - center.x, bounds.max.y - center.y, bounds.max.z - center.z};
+  const float radius = 2.0f * EXP::MATH::length(half);
+  std::vector<BvhRay> result(count);
+  for (BvhRay& ray : result) {
+    const EXP::MATH::float3 direction = EXP::MATH::normalize({unit(random), unit(random), unit(random)});
+    const EXP::MATH::float3 origin = center + direction * radius;
+    const EXP::MATH::float3 target = center + half * EXP::MATH::float3{unit(random), unit(random), unit(random)} * 0.5f;
+    ray.origin = EXP::MATH::p3(origin);
+    ray.direction = EXP::MATH::p3(target - origin);
+  }
+  return result;
+}
+
+
+TEST(BENCH_BVH, BinnedSah) {
+  for (const char* name : {"f16/f16", "sphere/sphere", "cruiser/cruiser"}) {
+    EXP::MDL::HostMesh mesh;
+    ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/" + name + ".obj", mesh));
+    Bvh bvh;
+    Renderer::Host::BvhReport report = BvhBuilder::binnedSah(mesh, bvh);
+    for (int run = 0; run < 4; run++) report.seconds = std::min(report.seconds, BvhBuilder::binnedSah(mesh, bvh).seconds);
+
+    const std::vector<BvhRay> batch = rays(bvh.nodes[0].bounds(), 200000);
+    size_t hits = 0;
+    const auto start = clock_type::now();
+    for (const BvhRay& ray : batch) {
+      BvhHit hit;
+      hits += bvh.intersect(ray, hit);
+    }
+    const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    std::cout << name << ": " << mesh.triangleCount() << " triangles, build " << report.seconds * 1000.0 << " ms, SAH "
+              << report.sahCost << ", " << report.nodes << " nodes, " << report.leaves << " leaves, depth " << report.depth
+              << ", " << bvh.bytes() / 1024 << " KB, " << batch.size() / seconds / 1e6 << " Mrays/s ("
+              << 100.0 * hits / batch.size() << "% hit)" << std::endl;
+  }
+}
+
+
+// Wavy height field of size x size quads, two triangles each
+struct Terrain {
+  std::vector<EXP::MATH::packed3> vertices;
+  std::vector<uint32_t> indices;
+
+  explicit Terrain(uint32_t size) {
+    vertices.reserve((size_t)(size + 1) * (size + 1));
+    indices.reserve((size_t)size * size * 6);
+    for (uint32_t z = 0; z <= size; z++) {
+      for (uint32_t x = 0; x <= size; x++) {
+        const float u = (float)x / size, w = (float)z / size;
+        vertices.push_back({u, 0.05f * std::sin(40.0f * u) * std::cos(27.0f * w), w});
+      }
+    }
+    for (uint32_t z = 0; z < size; z++) {
+      for (uint32_t x = 0; x < size; x++) {
+        const uint32_t a = z * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+        indices.insert(indices.end(), {a, b, c, b, d, c});
+      }
+    }
+  }
+
+  std::vector<Renderer::Host::BvhGeometry> geometries() const {
+    return {{vertices.data(), sizeof(EXP::MATH::packed3), vertices.size(), indices.data(), indices.size() / 3}};
+  }
+};
+
+template <typename Tree> static double raysPerSecond(const Tree& bvh, const std::vector<BvhRay>& batch) {
+  const auto start = clock_type::now();
+  for (const BvhRay& ray : batch) {
+    BvhHit hit;
+    bvh.intersect(ray, hit);
+  }
+  return batch.size() / std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+
+TEST(BENCH_BVH, Scaling) {
+  // 1581 x 1581 quads, 5.0M triangles
+  const Terrain terrain(1581);
+  const std::vector<Renderer::Host::BvhGeometry> geometries = terrain.geometries();
+  const std::vector<uint32_t>& indices = terrain.indices;
+
+  double single = 0.0;
+  for (unsigned int threads = 1; threads <= EXP::THREAD::Pool::shared().size(); threads++) {
+    BvhSettings settings;
+    settings.threads = threads;
+    Bvh bvh;
+    Renderer::Host::BvhReport report = BvhBuilder::binnedSah(geometries, bvh, settings);
+    report.seconds = std::min(report.seconds, BvhBuilder::binnedSah(geometries, bvh, settings).seconds);
+    if (threads == 1) single = report.seconds;
+    std::cout << threads << " threads: " << indices.size() / 3 << " triangles, build " << report.seconds * 1000.0
+              << " ms, " << indices.size() / 3 / report.seconds / 1e6 << " Mtris/s, speedup " << single / report.seconds
+              << " (" << 100.0 * single / report.seconds / threads << "% efficiency), SAH " << report.sahCost << ", "
+              << report.nodes << " nodes" << std::endl;
+  }
+}
+
+
+TEST(BENCH_BVH, Linear) {
+  // 707 x 707 quads, 1.0M triangles
+  const Terrain terrain(707);
+  const std::vector<Renderer::Host::BvhGeometry> geometries = terrain.geometries();
+  const size_t triangles = terrain.indices.size() / 3;
+  Bvh bvh;
+  const Renderer::Host::BvhReport binned = BvhBuilder::binnedSah(geometries, bvh);
+  const std::vector<BvhRay> batch = rays(bvh.nodes[0].bounds(), 200000);
+  std::cout << "binned SAH: " << triangles << " triangles, build " << binned.seconds * 1000.0 << " ms, SAH "
+            << binned.sahCost << ", " << raysPerSecond(bvh, batch) / 1e6 << " Mrays/s" << std::endl;
+
+  for (uint32_t bits : {30u, 63u}) {
+    BvhSettings settings;
+    settings.mortonBits = bits;
+    // Rebuilt in place like every frame would, after a first build that allocates
+    Renderer::Host::BvhScratch scratch;
+    Renderer::Host::BvhReport report = BvhBuilder::linear(geometries, bvh, settings, &scratch);
+    const double first = report.seconds;
+    report.seconds = INFINITY;
+    for (int run = 0; run < 5; run++) {
+      report.seconds = std::min(report.seconds, BvhBuilder::linear(geometries, bvh, settings, &scratch).seconds);
+    }
+    std::cout << "linear " << bits << " bit: build " << report.seconds * 1000.0 << " ms (first " << first * 1000.0 << " ms), "
+              << triangles / report.seconds / 1e6 << " Mtris/s, SAH " << report.sahCost << ", depth " << report.depth
+              << ", " << raysPerSecond(bvh, batch) / 1e6 << " Mrays/s" << std::endl;
+  }
+}
+
+
+TEST(BENCH_BVH, Spatial) {
+  for (const char* name : {"f16/f16", "sphere/sphere", "cruiser/cruiser"}) {
+    EXP::MDL::HostMesh mesh;
+    ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/" + name + ".obj", mesh));
+    Bvh binned, spatial;
+    Renderer::Host::BvhReport binnedReport = BvhBuilder::binnedSah(mesh, binned);
+    Renderer::Host::BvhReport report = BvhBuilder::spatial(mesh, spatial);
+    for (int run = 0; run < 4; run++) {
+      binnedReport.seconds = std::min(binnedReport.seconds, BvhBuilder::binnedSah(mesh, binned).seconds);
+      report.seconds = std::min(report.seconds, BvhBuilder::spatial(mesh, spatial).seconds);
+    }
+    const std::vector<BvhRay> batch = rays(binned.nodes[0].bounds(), 200000);
+    const double binnedRays = std::max(raysPerSecond(binned, batch), raysPerSecond(binned, batch));
+    const double spatialRays = std::max(raysPerSecond(spatial, batch), raysPerSecond(spatial, batch));
+    std::cout << name << ": " << mesh.triangleCount() << " triangles, binned " << binnedReport.seconds * 1000.0 << " ms SAH "
+              << binnedReport.sahCost << " " << binnedRays / 1e6 << " Mrays/s; spatial " << report.seconds * 1000.0
+              << " ms SAH " << report.sahCost << " " << spatialRays / 1e6 << " Mrays/s, "
+              << 100.0 * (report.references - mesh.triangleCount()) / mesh.triangleCount() << "% duplicated; "
+              << 100.0 * (spatialRays / binnedRays - 1.0) << "% rays/s for " << report.seconds / binnedReport.seconds
+              << "x build time" << std::endl;
+  }
+}
+
+
+// Per ray work from one counted pass, rays/s the best of three uncounted ones
+static void wideLines(const Bvh& bvh, const std::vector<BvhRay>& batch) {
+  auto line = [&](const char* kind, const auto& tree, size_t nodes, size_t bytes, double baseline) {
+    Renderer::Host::BvhCounters counters;
+    for (const BvhRay& ray : batch) {
+      BvhHit hit;
+      tree.intersect(ray, hit, &counters);
+    }
+    double best = 0.0;
+    for (int run = 0; run < 3; run++) best = std::max(best, raysPerSecond(tree, batch));
+    std::cout << "  " << kind << ": " << nodes << " nodes, " << bytes / 1024 << " KB, "
+              << (double)counters.nodes / batch.size() << " nodes / " << (double)counters.leaves / batch.size()
+              << " leaves / " << (double)counters.triangles / batch.size() << " triangles per ray, " << best / 1e6
+              << " Mrays/s (" << (baseline > 0.0 ? best / baseline : 1.0) << "x)" << std::endl;
+    return best;
+  };
+  const double binary = line("binary", bvh, bvh.nodes.size(), bvh.bytes(), 0.0);
+  for (bool quantized : {false, true}) {
+    Renderer::Host::WideSettings settings;
+    settings.quantized = quantized;
+    Renderer::Host::Bvh4 wide4;
+    Renderer::Host::Bvh8 wide8;
+    Renderer::Host::WideBuilder::collapse(bvh, wide4, settings);
+    Renderer::Host::WideBuilder::collapse(bvh, wide8, settings);
+    line(quantized ? "bvh4 quantized" : "bvh4", wide4, wide4.nodeCount(), wide4.bytes(), binary);
+    line(quantized ? "bvh8 quantized" : "bvh8", wide8, wide8.nodeCount(), wide8.bytes(), binary);
+  }
+}
+
+
+TEST(BENCH_BVH, Wide) {
+  for (const char* name : {"f16/f16", "sphere/sphere", "cruiser/cruiser"}) {
+    EXP::MDL::HostMesh mesh;
+    ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/" + name + ".obj", mesh));
+    Bvh bvh;
+    BvhBuilder::binnedSah(mesh, bvh);
+    std::cout << name << ": " << mesh.triangleCount() << " triangles" << std::endl;
+    wideLines(bvh, rays(bvh.nodes[0].bounds(), 200000));
+  }
+  // Far more nodes than fit in cache: 707 x 707 quads, 1.0M triangles
+  const Terrain terrain(707);
+  Bvh bvh;
+  BvhBuilder::binnedSah(terrain.geometries(), bvh);
+  std::cout << "terrain: " << terrain.indices.size() / 3 << " triangles" << std::endl;
+  wideLines(bvh, rays(bvh.nodes[0].bounds(), 200000));
+}
+
+
+TEST(BENCH_BVH, TlasUpdate) {
+  EXP::MDL::HostMesh mesh;
+  ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/sphere/sphere.obj", mesh));
+  Bvh bvh;
+  BvhBuilder::binnedSah(mesh, bvh);
+  Renderer::Host::Bvh8 blas;
+  Renderer::Host::WideBuilder::collapse(bvh, blas);
+  const Aabb box = blas.bounds();
+  const float spacing = 2.0f * std::max({box.max.x - box.min.x, box.max.y - box.min.y, box.max.z - box.min.z});
+
+  // 64 x 64 instances on a grid; 100 frames still, 100 with 5% of them bobbing, 100 all circling the middle
+  const uint32_t side = 64;
+  std::vector<Renderer::Host::Instance> start(side * side);
+  for (uint32_t i = 0; i < start.size(); i++) start[i].transformationMatrix.columns[3] = {spacing * (i % side), 0.0f, spacing * (i / side)};
+  auto frame = [&](uint32_t f) {
+    std::vector<Renderer::Host::Instance> instances = start;
+    const float half = 0.5f * spacing * side;
+    for (uint32_t i = 0; i < instances.size(); i++) {
+      EXP::MATH::packed3& p = instances[i].transformationMatrix.columns[3];
+      if (f >= 100 && f < 200 && i % 20 == 0) p.y = spacing * std::sin(0.2f * f + i);
+      if (f >= 200) {
+        const float angle = 0.01f * (f - 199) * (1.0f + (float)(i % 7) / 7.0f);
+        const float x = p.x - half, z = p.z - half;
+        p.x = half + x * std::cos(angle) - z * std::sin(angle), p.z = half + x * std::sin(angle) + z * std::cos(angle);
+      }
+    }
+    return instances;
+  };
+
+  // Primary rays from above, as the camera looks at the scene
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<BvhRay> batch(20000);
+  for (BvhRay& ray : batch) {
+    ray.origin = {spacing * side * unit(random), 4.0f * spacing, spacing * side * unit(random)};
+    ray.direction = {0.3f * (unit(random) - 0.5f), -1.0f, 0.3f * (unit(random) - 0.5f)};
+  }
+
+  const std::vector<const Renderer::Host::Bvh8*> structures = {&blas};
+  Renderer::Host::Tlas<Renderer::Host::Bvh8> rebuilt, updated;
+  Renderer::Host::TlasBuilder::build(frame(0), structures, rebuilt);
+  Renderer::Host::TlasBuilder::build(frame(0), structures, updated);
+  std::cout << start.size() << " instances of " << mesh.triangleCount() << " triangles, " << batch.size() << " rays per frame" << std::endl;
+  for (const char* phase : {"still", "5% moving", "all moving"}) {
+    const uint32_t first = phase[0] == 's' ? 0 : phase[0] == '5' ? 100 : 200;
+    double rebuildSeconds = 0.0, updateSeconds = 0.0, rebuiltTrace = 0.0, updatedTrace = 0.0;
+    int actions[3] = {0, 0, 0};
+    for (uint32_t f = first; f < first + 100; f++) {
+      const std::vector<Renderer::Host::Instance> instances = frame(f);
+      auto begin = clock_type::now();
+      Renderer::Host::TlasBuilder::build(instances, structures, rebuilt);
+      rebuildSeconds += std::chrono::duration<double>(clock_type::now() - begin).count();
+      begin = clock_type::now();
+      actions[(int)Renderer::Host::TlasBuilder::update(instances, updated).action]++;
+      updateSeconds += std::chrono::duration<double>(clock_type::now() - begin).count();
+      if (f % 10 == 0) {
+        rebuiltTrace += batch.size() / raysPerSecond(rebuilt, batch);
+        updatedTrace += batch.size() / raysPerSecond(updated, batch);
+      }
+    }
+    std::cout << "  " << phase << ": rebuild " << rebuildSeconds * 10.0 << " ms/frame (trace " << rebuiltTrace * 100.0
+              << " ms); update " << updateSeconds * 10.0 << " ms/frame (trace " << updatedTrace * 100.0 << " ms), "
+              << actions[0] << " skipped, " << actions[1] << " refit, " << actions[2] << " rebuilt" << std::endl;
+  }
+}
@@ -0,0 +1,85 @@
+//
+// Startup cost of the CPU BVHs: a cold launch (no .expbvh: build, lay out, write) against a warm one
+// (hash the geometry, map and load the cache), for the asset meshes and a 2M triangle height field,
+// binned SAH and spatial builds. The warm file is in the page cache, as on a relaunch.
+//
+#include <gtest/gtest.h>
+#include <DB/BvhCache.hpp>
+#include <DB/ObjRepository.hpp>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+
+using clock_type = std::chrono::steady_clock;
+using Renderer::Host::BvhGeometry;
+using Repository::BvhCache;
+using Repository::BvhCacheSettings;
+
+static double millisecondsSince(const clock_type::time_point& start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+static void startup(const std::string& label, const std::vector<BvhGeometry>& geometries, const BvhCacheSettings& settings) {
+  const std::filesystem::path directory = std::filesystem::temp_directory_path() / "explorer_bench_bvh_cache";
+  std::filesystem::create_directories(directory);
+
+  auto start = clock_type::now();
+  const uint64_t key = BvhCache::key(geometries, settings);
+  const double hashing = millisecondsSince(start);
+  const std::string path = (directory / BvhCache::fileName(key)).string();
+  std::filesystem::remove(path);
+
+  Renderer::Host::Bvh bvh;
+  bool cached = true;
+  start = clock_type::now();
+  BvhCache::fetch(path, key, geometries, bvh, settings, &cached);
+  const double cold = millisecondsSince(start);
+  ASSERT_FALSE(cached);
+
+  double warm = INFINITY;
+  for (int run = 0; run < 5; run++) {
+    start = clock_type::now();
+    BvhCache::fetch(path, key, geometries, bvh, settings, &cached);
+    warm = std::min(warm, millisecondsSince(start));
+    ASSERT_TRUE(cached);
+  }
+  std::cout << label << ": " << bvh.triangleCount() << " triangles, " << std::filesystem::file_size(path) / 1024
+            << " KB file; cold " << cold << " ms, warm " << hashing + warm << " ms (" << hashing << " ms hashing), "
+            << cold / (hashing + warm) << "x" << std::endl;
+  std::filesystem::remove(path);
+}
+
+
+TEST(BENCH_BVH_CACHE, ColdWarm) {
+  BvhCacheSettings spatial;
+  spatial.build = Repository::BvhBuild::SPATIAL;
+  for (const char* name : {"f16/f16", "sphere/sphere", "cruiser/cruiser"}) {
+    EXP::MDL::HostMesh mesh;
+    ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/" + name + ".obj", mesh));
+    const std::vector<BvhGeometry> geometries = Renderer::Host::BvhBuilder::geometries(mesh);
+    startup(std::string(name) + ", binned", geometries, {});
+    startup(std::string(name) + ", spatial", geometries, spatial);
+  }
+
+  // 1000 x 1000 quads, 2M triangles
+  std::vector<EXP::MATH::packed3> vertices;
+  std::vector<uint32_t> indices;
+  const uint32_t size = 1000;
+  for (uint32_t z = 0; z <= size; z++) {
+    for (uint32_t x = 0; x <= size; x++) {
+      const float u = (float)x / size, w = (float)z / size;
+      vertices.push_back({u, 0.05f * std::sin(40.0f * u) * std::cos(27.0f * w), w});
+    }
+  }
+  for (uint32_t z = 0; z < size; z++) {
+    for (uint32_t x = 0; x < size; x++) {
+      const uint32_t a = z * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+      indices.insert(indices.end(), {a, b, c, b, d, c});
+    }
+  }
+  const std::vector<BvhGeometry> terrain = {
+    {vertices.data(), sizeof(EXP::MATH::packed3), vertices.size(), indices.data(), indices.size() / 3}
+  };
+  startup("terrain, binned", terrain, {});
+  startup("terrain, spatial", terrain, spatial);
+}
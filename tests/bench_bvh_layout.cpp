@@ -0,0 +1,173 @@
+//
+// BVH node layouts (build order, depth first with the hot child adjacent, van Emde Boas) with the
+// triangles behind the ids or gathered into leaf order: rays/s, and on Linux the L1 data and last
+// level cache misses per ray, read from the hardware counters through perf_event_open. Incoherent
+// rays through a 2M triangle height field and the largest asset mesh, from SAH and linear builds.
+//
+#include <gtest/gtest.h>
+#include <DB/ObjRepository.hpp>
+#include <Renderer/HostBvhLayout.h>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using clock_type = std::chrono::steady_clock;
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhBuilder;
+using Renderer::Host::BvhRay;
+using Renderer::Host::LayoutSettings;
+using Renderer::Host::NodeOrder;
+
+// One hardware counter of this thread, or nothing where the kernel or the platform has none
+struct Counter {
+  int fd = -1;
+
+  Counter(uint32_t type, uint64_t config) {
+#if defined(__linux__)
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+  ~Counter() {
+#if defined(__linux__)
+    if (fd >= 0) close(fd);
+#endif
+  }
+  inline bool valid() const { return fd >= 0; }
+  void start() {
+#if defined(__linux__)
+    if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_RESET, 0), ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+  uint64_t stop() {
+    uint64_t value = 0;
+#if defined(__linux__)
+    if (fd >= 0 && (ioctl(fd, PERF_EVENT_IOC_DISABLE, 0), read(fd, &value, sizeof(value)) != sizeof(value))) value = 0;
+#endif
+    return value;
+  }
+};
+
+#if defined(__linux__)
+static constexpr uint64_t L1D_READ_MISS =
+  PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+#endif
+
+// Rays from a sphere around the bounds towards random points inside them: no two alike
+static std::vector<BvhRay> rays(const Renderer::Host::Aabb& bounds, size_t count) {
+  std::mt19937 random(9);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  const EXP::MATH::float3 center = (EXP::MATH::f3(bounds.min) + EXP::MATH::f3(bounds.max)) * 0.5f;
+  const EXP::MATH::float3 half = EXP::MATH::f3(bounds.max) - center;
+  const float radius = 2.0f * EXP::MATH::length(half);
+  std::vector<BvhRay> result(count);
+  for (BvhRay& ray : result) {
+    const EXP::MATH::float3 origin = center + EXP::MATH::normalize({unit(random), unit(random), unit(random)}) * radius;
+    const EXP::MATH::float3 target = center + half * EXP::MATH::float3{unit(random), unit(random), unit(random)} * 0.5f;
+    ray.origin = EXP::MATH::p3(origin);
+    ray.direction = EXP::MATH::p3(target - origin);
+  }
+  return result;
+}
+
+static void layouts(const char* name, const Bvh& built) {
+  const std::vector<BvhRay> batch = rays(built.bounds(), 500000);
+#if defined(__linux__)
+  Counter l1(PERF_TYPE_HW_CACHE, L1D_READ_MISS), llc(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#else
+  Counter l1(0, 0), llc(0, 0);
+#endif
+  if (!l1.valid() && !llc.valid()) std::cout << "  (no hardware cache counters here: rays/s only)" << std::endl;
+  struct Case {
+    const char* label;
+    NodeOrder order;
+    bool triangles;
+  };
+  const Case cases[] = {
+    {"build order, ids", NodeOrder::BUILD, false},
+    {"depth first, ids", NodeOrder::DEPTH_FIRST, false},
+    {"depth first, leaf order", NodeOrder::DEPTH_FIRST, true},
+    {"van Emde Boas, ids", NodeOrder::VAN_EMDE_BOAS, false},
+    {"van Emde Boas, leaf order", NodeOrder::VAN_EMDE_BOAS, true},
+  };
+  std::cout << name << ": " << built.triangleCount() << " triangles, " << built.nodes.size() << " nodes, "
+            << batch.size() << " rays" << std::endl;
+  for (const Case& test : cases) {
+    Bvh bvh = built;
+    LayoutSettings settings;
+    settings.order = test.order;
+    settings.triangles = test.triangles;
+    const auto layoutStart = clock_type::now();
+    Renderer::Host::BvhLayout::reorder(bvh, settings);
+    const double layoutSeconds = std::chrono::duration<double>(clock_type::now() - layoutStart).count();
+
+    size_t hits = 0;
+    double seconds = INFINITY;
+    uint64_t l1Misses = 0, llcMisses = 0;
+    for (int run = 0; run < 3; run++) {
+      hits = 0;
+      l1.start(), llc.start();
+      const auto start = clock_type::now();
+      for (const BvhRay& ray : batch) {
+        Renderer::Host::BvhHit hit;
+        hits += bvh.intersect(ray, hit);
+      }
+      const double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+      const uint64_t l1Run = l1.stop(), llcRun = llc.stop();
+      if (elapsed < seconds) seconds = elapsed, l1Misses = l1Run, llcMisses = llcRun;
+    }
+    std::cout << "  " << std::left << std::setw(26) << test.label << std::right << "layout " << layoutSeconds * 1000.0
+              << " ms, " << batch.size() / seconds / 1e6 << " Mrays/s";
+    if (l1.valid()) std::cout << ", " << (double)l1Misses / batch.size() << " L1D misses/ray";
+    if (llc.valid()) std::cout << ", " << (double)llcMisses / batch.size() << " LLC misses/ray";
+    std::cout << " (" << 100.0 * hits / batch.size() << "% hit)" << std::endl;
+  }
+}
+
+
+TEST(BENCH_BVH_LAYOUT, Orders) {
+  // 1000 x 1000 quads, 2M triangles: the nodes and triangles are well beyond the caches
+  std::vector<EXP::MATH::packed3> vertices;
+  std::vector<uint32_t> indices;
+  const uint32_t size = 1000;
+  for (uint32_t z = 0; z <= size; z++) {
+    for (uint32_t x = 0; x <= size; x++) {
+      const float u = (float)x / size, w = (float)z / size;
+      vertices.push_back({u, 0.05f * std::sin(40.0f * u) * std::cos(27.0f * w), w});
+    }
+  }
+  for (uint32_t z = 0; z < size; z++) {
+    for (uint32_t x = 0; x < size; x++) {
+      const uint32_t a = z * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+      indices.insert(indices.end(), {a, b, c, b, d, c});
+    }
+  }
+  const std::vector<Renderer::Host::BvhGeometry> terrain = {
+    {vertices.data(), sizeof(EXP::MATH::packed3), vertices.size(), indices.data(), indices.size() / 3}
+  };
+  Bvh bvh;
+  BvhBuilder::binnedSah(terrain, bvh);
+  layouts("terrain, binned SAH", bvh);
+  BvhBuilder::linear(terrain, bvh);
+  layouts("terrain, linear", bvh);
+
+  EXP::MDL::HostMesh mesh;
+  ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/cruiser/cruiser.obj", mesh));
+  BvhBuilder::binnedSah(mesh, bvh);
+  layouts("cruiser, binned SAH", bvh);
+}
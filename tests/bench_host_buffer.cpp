@@ -0,0 +1,59 @@
+//
+// Per primitive builder on CPU buffers: scalar reference against the parallel, streaming builder.
+//
+#include <gtest/gtest.h>
+#include <Renderer/HostBuffer.h>
+#include <Thread/Pool.h>
+#include <chrono>
+#include <random>
+
+using clock_type = std::chrono::steady_clock;
+using Renderer::Host::PrimitiveAttributes;
+using Renderer::Host::VertexAttributes;
+
+template <typename Fn> static double bestOf(int runs, const Fn& fn) {
+  double best = 1e30;
+  for (int run = 0; run < runs; run++) {
+    const auto start = clock_type::now();
+    fn();
+    best = std::min(best, std::chrono::duration<double, std::milli>(clock_type::now() - start).count());
+  }
+  return best;
+}
+
+
+TEST(BENCH_HOSTBUFFER, Triangles2M) {
+  // Grid mesh: vertices shared by six triangles, indices in row order like an imported OBJ
+  const uint32_t side = 1024;
+  std::vector<VertexAttributes> attributes((side + 1) * (side + 1));
+  for (size_t i = 0; i < attributes.size(); i++) {
+    attributes[i].color = {1.0f, 0.5f, 0.25f, 1.0f};
+    attributes[i].texture = {(float)(i % (side + 1)), (float)(i / (side + 1))};
+    attributes[i].normal = {0.0f, 0.0f, 1.0f};
+  }
+  std::vector<uint32_t> indices;
+  indices.reserve(side * side * 6);
+  for (uint32_t y = 0; y < side; y++) {
+    for (uint32_t x = 0; x < side; x++) {
+      const uint32_t v = y * (side + 1) + x;
+      indices.insert(indices.end(), {v, v + 1, v + side + 2, v, v + side + 2, v + side + 1});
+    }
+  }
+  const size_t triangles = indices.size() / 3;
+  std::vector<PrimitiveAttributes> out(triangles);
+  const double megabytes = triangles * sizeof(PrimitiveAttributes) / (1024.0 * 1024.0);
+
+  const double scalar = bestOf(5, [&] {
+    Renderer::Host::Buffer::perPrimitiveScalar(attributes.data(), indices.data(), indices.size(), 1, out.data());
+  });
+  std::cout << triangles << " triangles, " << megabytes << " MB: scalar " << scalar << " ms ("
+            << megabytes / scalar * 1000.0 / 1024.0 << " GB/s)" << std::endl;
+
+  for (unsigned int threads = 1; threads <= EXP::THREAD::Pool::shared().size(); threads *= 2) {
+    const double parallel = bestOf(5, [&] {
+      Renderer::Host::Buffer::perPrimitive(attributes.data(), indices.data(), indices.size(), 1, out.data(), threads);
+    });
+    std::cout << "  parallel x" << threads << ": " << parallel << " ms (" << megabytes / parallel * 1000.0 / 1024.0
+              << " GB/s), " << scalar / parallel << "x" << std::endl;
+  }
+}
@@ -0,0 +1,79 @@
+//
+// Texture pipeline throughput in megapixels per second: decoders and mip chain generation.
+//
+#include <gtest/gtest.h>
+#include <DB/ImageRepository.hpp>
+#include <Renderer/HostMipmap.h>
+#include <Thread/Pool.h>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using clock_type = std::chrono::steady_clock;
+using Renderer::Host::Image;
+using Renderer::Host::PixelFormat;
+
+template <typename Fn> static double bestOf(int runs, const Fn& fn) {
+  double best = 1e30;
+  for (int run = 0; run < runs; run++) {
+    const auto start = clock_type::now();
+    fn();
+    best = std::min(best, std::chrono::duration<double>(clock_type::now() - start).count());
+  }
+  return best;
+}
+
+static std::vector<uint8_t> readFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+
+TEST(BENCH_IMAGE, Decode) {
+  for (const char* name : {"Meshes/f16/f16.bmp", "Meshes/cruiser/cruiser.bmp", "Textures/island.jpg"}) {
+    const std::vector<uint8_t> file = readFile(std::string(EXPLORER_ASSET_DIR) + "/" + name);
+    Image image;
+    const double seconds = bestOf(10, [&] { ASSERT_TRUE(Repository::Images::decode(file.data(), file.size(), image)); });
+    std::cout << name << " " << image.width << "x" << image.height << ": " << seconds * 1000.0 << " ms, "
+              << image.width * image.height / seconds / 1e6 << " MP/s" << std::endl;
+  }
+
+  // 2048x2048 TGA, raw and RLE (runs of 4), built in memory
+  for (uint8_t type : {(uint8_t)2, (uint8_t)10}) {
+    std::vector<uint8_t> file = {0, 0, type, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 0, 8, 32, 0x28};
+    for (uint32_t i = 0; i < 2048 * 2048; i += type == 10 ? 4 : 1) {
+      if (type == 10) file.push_back(0x80 | 3);
+      file.insert(file.end(), {(uint8_t)i, (uint8_t)(i >> 8), (uint8_t)(i >> 16), 255});
+    }
+    Image image;
+    const double seconds = bestOf(5, [&] { ASSERT_TRUE(Repository::Images::decodeTga(file.data(), file.size(), image)); });
+    std::cout << (type == 10 ? "tga rle" : "tga raw") << " 2048x2048: " << seconds * 1000.0 << " ms, "
+              << 2048 * 2048 / seconds / 1e6 << " MP/s" << std::endl;
+  }
+}
+
+
+TEST(BENCH_IMAGE, Mips4K) {
+  // f16.bmp tiled to 4096x4096
+  Image tile, base;
+  ASSERT_TRUE(Repository::Images::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/f16/f16.bmp", tile));
+  base.allocate(4096, 4096, PixelFormat::RGBA8_SRGB);
+  for (uint32_t y = 0; y < base.height; y++) {
+    for (uint32_t x = 0; x < base.width; x += tile.width) memcpy(base.row(y) + x * 4, tile.row(y % tile.height), tile.rowBytes());
+  }
+  const double megapixels = base.width * base.height / 1e6;
+
+  for (auto filter : {Renderer::Host::MipFilter::BOX, Renderer::Host::MipFilter::KAISER}) {
+    for (PixelFormat format : {PixelFormat::RGBA8_SRGB, PixelFormat::RGBA16F}) {
+      for (unsigned int threads = 1; threads <= EXP::THREAD::Pool::shared().size(); threads *= 2) {
+        Renderer::Host::MipChain chain;
+        const double seconds = bestOf(3, [&] { Renderer::Host::Mipmap::build(base, chain, filter, format, threads); });
+        std::cout << (filter == Renderer::Host::MipFilter::BOX ? "box" : "kaiser") << " "
+                  << (format == PixelFormat::RGBA16F ? "rgba16f" : "rgba8 srgb") << " x" << threads << ": "
+                  << seconds * 1000.0 << " ms, " << megapixels / seconds << " MP/s (" << chain.levels.size()
+                  << " levels, " << chain.bytes() / (1024.0 * 1024.0) << " MB)" << std::endl;
+      }
+    }
+  }
+}
@@ -0,0 +1,68 @@
+//
+// Startup cost: OBJ import (parse + weld) against opening the .expmesh cache.
+//
+#include <gtest/gtest.h>
+#include <DB/MeshCache.hpp>
+#include <DB/ObjRepository.hpp>
+#include <Model/Weld.h>
+#include <chrono>
+#include <filesystem>
+
+using clock_type = std::chrono::steady_clock;
+
+static double millisecondsSince(const clock_type::time_point& start) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+static void benchCache(const std::string& obj, const std::string& label) {
+  const std::string cachePath = (std::filesystem::temp_directory_path() / (label + ".expmesh")).string();
+
+  auto start = clock_type::now();
+  EXP::MDL::HostMesh mesh;
+  ASSERT_TRUE(Repository::Obj::readMapped(obj, mesh));
+  EXP::MDL::Weld::apply(mesh);
+  const double import = millisecondsSince(start);
+
+  start = clock_type::now();
+  const uint64_t hash = Repository::MeshCache::hashSources(obj);
+  const double hashing = millisecondsSince(start);
+
+  start = clock_type::now();
+  ASSERT_TRUE(Repository::MeshCache::write(cachePath, mesh, hash));
+  const double write = millisecondsSince(start);
+
+  start = clock_type::now();
+  Repository::MeshCache cache;
+  ASSERT_TRUE(cache.open(cachePath, hash));
+  const double open = millisecondsSince(start);
+
+  // What an upload would read: every vertex, index and primitive page
+  start = clock_type::now();
+  uint64_t checksum = 0;
+  for (uint32_t i = 0; i < cache.vertexCount(); i++) checksum += (uint64_t)cache.vertices()[i].x;
+  for (const Repository::CachedSubmesh& submesh : cache.submeshes()) {
+    for (uint32_t i = 0; i < submesh.indexCount; i++) checksum += submesh.indices[i];
+    for (uint32_t t = 0; t < submesh.triangleCount(); t++) checksum += submesh.primitives[t].flags.x;
+  }
+  const double touch = millisecondsSince(start);
+
+  std::cout << label << ": import " << import << " ms, hash " << hashing << " ms, write " << write << " ms, open "
+            << open << " ms, open + touch " << open + touch << " ms; warm start " << import / (hashing + open + touch)
+            << "x faster, " << std::filesystem::file_size(cachePath) / (1024.0 * 1024.0) << " MB (checksum " << checksum
+            << ")" << std::endl;
+  std::filesystem::remove(cachePath);
+}
+
+
+TEST(BENCH_MESHCACHE, Assets) {
+  for (const char* name : {"f16", "sphere", "cruiser"}) {
+    benchCache(std::string(EXPLORER_ASSET_DIR) + "/Meshes/" + name + "/" + name + ".obj", name);
+  }
+}
+
+TEST(BENCH_MESHCACHE, Synthetic10M) {
+  // Written by BENCH_OBJ.Synthetic10M
+  const std::filesystem::path path = std::filesystem::temp_directory_path() / "explorer_grid_2237.obj";
+  if (!std::filesystem::exists(path)) GTEST_SKIP() << "Run BENCH_OBJ.Synthetic10M first";
+  benchCache(path.string(), "grid");
+}
@@ -0,0 +1,81 @@
+//
+// Timing of the portable OBJ reader on the bundled assets.
+// The ModelIO path logs its own load time in MeshRepository.mm for comparison on macOS.
+//
+#include <gtest/gtest.h>
+#include <DB/ObjRepository.hpp>
+#include <Thread/Pool.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+using clock_type = std::chrono::steady_clock;
+
+static void benchRead(const std::string& name, int iterations) {
+  const std::string path = std::string(EXPLORER_ASSET_DIR) + "/Meshes/" + name + "/" + name + ".obj";
+  const double megabytes = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+
+  EXP::MDL::HostMesh mesh;
+  auto start = clock_type::now();
+  for (int i = 0; i < iterations; i++) ASSERT_TRUE(Repository::Obj::read(path, mesh));
+  double ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count() / iterations;
+
+  std::cout << name << ": " << ms << " ms/load, " << megabytes / (ms / 1000.0) << " MB/s, "
+            << mesh.triangleCount() << " triangles, " << mesh.vertexCount() << " vertices" << std::endl;
+}
+
+
+TEST(BENCH_OBJ, F16) { benchRead("f16", 20); }
+TEST(BENCH_OBJ, Sphere) { benchRead("sphere", 20); }
+TEST(BENCH_OBJ, Cruiser) { benchRead("cruiser", 20); }
+
+
+// Grid of (side - 1)^2 * 2 triangles with v/vt/vn per corner; 2237^2 * 2 ~= 10M triangles.
+static std::string syntheticObj(int side) {
+  const std::filesystem::path path = std::filesystem::temp_directory_path() / ("explorer_grid_" + std::to_string(side) + ".obj");
+  if (std::filesystem::exists(path)) return path.string();
+
+  std::cout << "Writing " << path << " ..." << std::endl;
+  FILE* file = fopen(path.string().c_str(), "wb");
+  for (int y = 0; y < side; y++) {
+    for (int x = 0; x < side; x++) {
+      fprintf(file, "v %.6f %.6f %.6f\n", x / (float)side, y / (float)side, 0.01f * ((x * 7 + y * 13) % 17));
+    }
+  }
+  for (int y = 0; y < side; y++) {
+    for (int x = 0; x < side; x++) fprintf(file, "vt %.6f %.6f\n", x / (float)side, y / (float)side);
+  }
+  fprintf(file, "vn 0.000000 0.000000 1.000000\n");
+  for (int y = 0; y + 1 < side; y++) {
+    for (int x = 0; x + 1 < side; x++) {
+      int a = y * side + x + 1, b = a + 1, c = a + side + 1, d = a + side;
+      fprintf(file, "f %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b, c, c);
+      fprintf(file, "f %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, c, c, d, d);
+    }
+  }
+  fclose(file);
+  return path.string();
+}
+
+
+TEST(BENCH_OBJ, Synthetic10M) {
+  const std::string path = syntheticObj(2237);
+  const double megabytes = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+
+  // 1, 2, 4, ... up to every hardware thread
+  const unsigned int maxThreads = EXP::THREAD::Pool::shared().size();
+  std::vector<unsigned int> threadCounts;
+  for (unsigned int threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+  threadCounts.push_back(maxThreads);
+
+  double single = 0.0;
+  for (unsigned int threads : threadCounts) {
+    EXP::MDL::HostMesh mesh;
+    auto start = clock_type::now();
+    ASSERT_TRUE(Repository::Obj::readMapped(path, mesh, threads));
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    if (threads == 1) single = seconds;
+    std::cout << "threads: " << threads << ", " << seconds * 1000.0 << " ms, " << megabytes / seconds << " MB/s, speedup: "
+              << single / seconds << "x, triangles: " << mesh.triangleCount() << std::endl;
+  }
+}
@@ -0,0 +1,109 @@
+//
+// Shadow rays of the showcase scene as occlusion queries against closest hits checked against the
+// light: first the rays alone, from the primary hits of a 3024 x 1650 frame to a random light vertex
+// each, then whole ReSTIR frames pixel by pixel and stage by stage with either test. Rays/s, the
+// speedup, and how often the two tests agree.
+//
+#include <gtest/gtest.h>
+#include <DB/SceneRepository.hpp>
+#include <Renderer/HostCamera.h>
+#include <Renderer/HostRestir.h>
+#include <chrono>
+#include <random>
+
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhRay;
+using Renderer::Host::RestirRenderer;
+using Renderer::Host::RestirSettings;
+using Renderer::Host::RestirStats;
+
+static const uint32_t WIDTH = 3024, HEIGHT = 1650;
+
+static double since(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+TEST(BENCH_OCCLUSION, Rays) {
+  Repository::HostScene scene;
+  std::string error;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(std::string(EXPLORER_ASSET_DIR) + "/Meshes"), scene, "", &error)) << error;
+  const Renderer::Host::Tlas<Renderer::Host::Bvh8>& tlas = scene.tlas;
+  const Renderer::Host::RestirLight& light = scene.restir.light;
+  const Renderer::Host::VCamera camera = Renderer::Host::isometricCamera(WIDTH, HEIGHT);
+
+  // Every fourth pixel's primary hit, towards a light vertex as the kernel samples them
+  std::vector<BvhRay> rays;
+  std::vector<EXP::MATH::float3> targets;
+  std::mt19937 random(5);
+  std::uniform_int_distribution<size_t> vertex(0, light.vertices.size() - 1);
+  for (uint32_t y = 0; y < HEIGHT; y += 2) {
+    for (uint32_t x = 0; x < WIDTH; x += 2) {
+      const BvhRay primary = Renderer::Host::primaryRay(camera, x, y);
+      BvhHit hit;
+      if (!tlas.intersect(primary, hit)) continue;
+      const EXP::MATH::float3 origin = EXP::MATH::f3(primary.origin) + EXP::MATH::f3(primary.direction) * hit.t;
+      const EXP::MATH::float3 target = EXP::MATH::transformPoint(light.orientation, EXP::MATH::f3(light.vertices[vertex(random)]));
+      BvhRay shadow;
+      shadow.origin = EXP::MATH::p3(origin);
+      shadow.direction = EXP::MATH::p3(EXP::MATH::normalize(target - origin));
+      shadow.tmin = 0.001f;
+      rays.push_back(shadow);
+      targets.push_back(target);
+    }
+  }
+  ASSERT_FALSE(rays.empty());
+
+  std::vector<uint8_t> closest(rays.size()), any(rays.size());
+  Renderer::Host::BvhCounters closestWork, anyWork;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rays.size(); i++) {
+    BvhHit hit;
+    closest[i] = !tlas.intersect(rays[i], hit, 0xFF, &closestWork) ||
+                 std::sqrt(EXP::MATH::distance_squared(targets[i], EXP::MATH::f3(rays[i].origin) + EXP::MATH::f3(rays[i].direction) * hit.t)) >= 0.001f;
+  }
+  const double closestSeconds = since(start);
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rays.size(); i++) {
+    BvhRay ray = rays[i];
+    ray.tmax = std::sqrt(EXP::MATH::distance_squared(targets[i], EXP::MATH::f3(ray.origin))) - 0.001f;
+    any[i] = tlas.occluded(ray, 0xFF, &anyWork);
+  }
+  const double anySeconds = since(start);
+
+  size_t agree = 0, blocked = 0;
+  for (size_t i = 0; i < rays.size(); i++) agree += closest[i] == any[i], blocked += any[i];
+  std::cout << rays.size() << " shadow rays, " << 100.0 * blocked / rays.size() << "% blocked, tests agree on "
+            << 100.0 * agree / rays.size() << "%" << std::endl;
+  std::cout << "closest hit: " << rays.size() / closestSeconds / 1e6 << " Mrays/s, " << (double)closestWork.nodes / rays.size()
+            << " nodes, " << (double)closestWork.triangles / rays.size() << " triangles per ray" << std::endl;
+  std::cout << "occlusion: " << rays.size() / anySeconds / 1e6 << " Mrays/s (" << closestSeconds / anySeconds << "x), "
+            << (double)anyWork.nodes / rays.size() << " nodes, " << (double)anyWork.triangles / rays.size() << " triangles per ray"
+            << std::endl;
+}
+
+
+TEST(BENCH_OCCLUSION, Frame) {
+  Repository::HostScene scene;
+  std::string error;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(std::string(EXPLORER_ASSET_DIR) + "/Meshes"), scene, "", &error)) << error;
+  scene.restir.camera = Renderer::Host::isometricCamera(WIDTH, HEIGHT);
+
+  // The same frame with either shadow test, so the difference is the shadow rays' time
+  for (bool wavefront : {false, true}) {
+    double reference = 0.0;
+    for (bool occlusion : {false, true}) {
+      RestirSettings settings;
+      settings.wavefront = wavefront;
+      settings.occlusion = occlusion;
+      RestirRenderer renderer;
+      Renderer::Host::Image image;
+      const RestirStats stats = renderer.render(scene.restir, image, settings);
+      if (!occlusion) reference = stats.seconds;
+      std::cout << (wavefront ? "wavefront" : "per pixel") << (occlusion ? ", occlusion: " : ", closest hit: ") << stats.seconds * 1000.0
+                << " ms, " << stats.raysPerSecond() / 1e6 << " Mrays/s (" << reference / stats.seconds << "x)";
+      if (wavefront) std::cout << "; tracing " << stats.wavefront.traceSeconds * 1000.0 << " ms";
+      std::cout << std::endl;
+    }
+  }
+}
@@ -0,0 +1,79 @@
+//
+// Primary rays of the showcase scene at 3024 x 1650 (the window's drawable) in packets: rays/s one
+// at a time through Tlas::intersect against 8 and 16 ray packets on every instruction set the CPU
+// has, with nodes and triangles per packet and the share of boxes the packet interval culled. Then
+// the best of them from one thread to the pool (at most 64): rays/s, and rays/s per core.
+//
+#include <gtest/gtest.h>
+#include <DB/SceneRepository.hpp>
+#include <Renderer/HostCamera.h>
+#include <Renderer/HostPacket.h>
+#include <algorithm>
+
+using Renderer::Host::BvhHit;
+using Renderer::Host::PacketIsa;
+using Renderer::Host::PacketSettings;
+using Renderer::Host::PacketStats;
+using Renderer::Host::PacketTracer;
+
+static const uint32_t WIDTH = 3024, HEIGHT = 1650;
+
+// Best of three frames
+static PacketStats frame(const Repository::HostScene& scene, const PacketSettings& settings, PacketIsa isa) {
+  const Renderer::Host::VCamera camera = Renderer::Host::isometricCamera(WIDTH, HEIGHT);
+  std::vector<BvhHit> hits;
+  PacketStats best;
+  for (int run = 0; run < 3; run++) {
+    const PacketStats stats = PacketTracer::primary(scene.tlas, camera, hits, settings, isa);
+    if (run == 0 || stats.seconds < best.seconds) best = stats;
+  }
+  return best;
+}
+
+
+TEST(BENCH_PACKET, Primary) {
+  Repository::HostScene scene;
+  std::string error;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(std::string(EXPLORER_ASSET_DIR) + "/Meshes"), scene, "", &error)) << error;
+
+  PacketSettings single;
+  single.threads = 1;
+  const PacketStats scalar = frame(scene, single, PacketIsa::SCALAR);
+  std::cout << "single rays: " << scalar.seconds * 1000.0 << " ms, " << scalar.raysPerSecond() / 1e6 << " Mrays/s ("
+            << 100.0 * scalar.hits / scalar.rays << "% hit)" << std::endl;
+
+  PacketIsa bestIsa = PacketIsa::SCALAR;
+  uint32_t bestWidth = 8;
+  double bestRays = scalar.raysPerSecond();
+  for (PacketIsa isa : {PacketIsa::BASELINE, PacketIsa::AVX2, PacketIsa::AVX512}) {
+    if (!PacketTracer::supported(isa)) continue;
+    for (uint32_t lanes : {8u, 16u}) {
+      PacketSettings settings = single;
+      settings.width = lanes;
+      const PacketStats stats = frame(scene, settings, isa);
+      std::cout << PacketTracer::name(isa) << ", " << lanes << " rays: " << stats.seconds * 1000.0 << " ms, "
+                << stats.raysPerSecond() / 1e6 << " Mrays/s (" << stats.raysPerSecond() / scalar.raysPerSecond()
+                << "x), " << (double)stats.nodes / stats.packets << " nodes / " << (double)stats.triangles / stats.packets
+                << " triangles per packet, " << 100.0 * stats.culled / std::max<uint64_t>(stats.culled + stats.laneTests, 1)
+                << "% of boxes culled by the interval, " << stats.singleRays << " single rays" << std::endl;
+      if (stats.raysPerSecond() > bestRays) bestIsa = isa, bestWidth = lanes, bestRays = stats.raysPerSecond();
+    }
+  }
+
+  std::vector<unsigned int> counts;
+  const unsigned int most = std::min(64u, EXP::THREAD::Pool::shared().size());
+  for (unsigned int threads = 1; threads < most; threads *= 2) counts.push_back(threads);
+  counts.push_back(most);
+  double first = 0.0;
+  for (unsigned int threads : counts) {
+    PacketSettings settings;
+    settings.threads = threads;
+    settings.width = bestWidth;
+    const PacketStats stats = frame(scene, settings, bestIsa);
+    if (threads == 1) first = stats.raysPerSecond();
+    std::cout << PacketTracer::name(bestIsa) << ", " << bestWidth << " rays, " << threads << " threads: "
+              << stats.seconds * 1000.0 << " ms, " << stats.raysPerSecond() / 1e6 << " Mrays/s, "
+              << stats.raysPerSecond() / threads / 1e6 << " Mrays/s per core (" << 100.0 * stats.raysPerSecond() / (first * threads)
+              << "% of one)" << std::endl;
+  }
+}
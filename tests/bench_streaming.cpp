@@ -0,0 +1,60 @@
+//
+// Texture streaming: a camera path over a row of textures, per budget. Update cost, how much of
+// what was asked for is sharp, upload traffic and evictions against the CPU backend.
+//
+#include <gtest/gtest.h>
+#include <Renderer/HostStreaming.h>
+#include <chrono>
+#include <cmath>
+
+using clock_type = std::chrono::steady_clock;
+using Renderer::Host::CpuStreamBackend;
+using Renderer::Host::StreamSettings;
+using Renderer::Host::StreamSource;
+using Renderer::Host::TextureStreamer;
+
+
+TEST(BENCH_STREAMING, Flythrough) {
+  // 64 textures of 2048x2048 at one byte per texel (BC7), 5.3 MB each with mips, 341 MB in all
+  const uint32_t count = 64, size = 2048;
+  auto store = std::make_shared<std::vector<uint8_t>>((size_t)size * size, 0x5A);
+  StreamSource source;
+  for (uint32_t s = size; s > 0; s /= 2) source.levels.push_back({s, s, store->data(), (size_t)s * s, s});
+  source.store = store;
+
+  for (size_t budget : {32ull << 20, 64ull << 20, 128ull << 20}) {
+    StreamSettings settings;
+    settings.budget = budget;
+    CpuStreamBackend backend(2, 8);
+    TextureStreamer streamer(&backend, settings);
+    std::vector<uint64_t> table(count, 0);
+    streamer.setTable(table.data(), table.size());
+    for (uint32_t slot = 0; slot < count; slot++) streamer.add(slot, source);
+
+    // Textures sit one unit apart; the camera moves 0.05 per frame and sees eight units ahead.
+    // A texture d units away covers 1920 / (1 + d) pixels across.
+    const int frames = 1200;
+    double seconds = 0.0;
+    uint64_t requested = 0, sharp = 0;
+    for (int frame = 0; frame < frames; frame++) {
+      const float camera = frame * 0.05f;
+      for (uint32_t slot = (uint32_t)camera; slot < count && slot < camera + 8.0f; slot++) {
+        const float distance = std::max(0.0f, slot - camera);
+        const uint32_t level = TextureStreamer::levelFor(size, (uint32_t)(1920.0f / (1.0f + distance)));
+        streamer.request(slot, level);
+        requested++;
+        if (streamer.residentLevel(slot) <= level) sharp++;
+      }
+      const auto start = clock_type::now();
+      streamer.update();
+      seconds += std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+    const Renderer::Host::StreamStats& stats = streamer.stats();
+    std::cout << "budget " << (budget >> 20) << " MB: update " << seconds / frames * 1e6 << " us/frame, sharp "
+              << 100.0 * sharp / requested << "%, uploaded " << (stats.uploadedBytes >> 20) << " MB in "
+              << stats.uploads << ", evicted " << (stats.evictedBytes >> 20) << " MB in " << stats.evictions
+              << ", peak " << (stats.peakBytes >> 20) << " MB, stalls " << stats.stalls << std::endl;
+    ASSERT_LE(stats.peakBytes, budget);
+  }
+}
@@ -0,0 +1,171 @@
+//
+// ReSTIR frames of the showcase scene at 3024 x 1650 (the window's drawable) through the tile
+// scheduler: frame time, speedup, imbalance, efficiency and steals for row bands, scanline tiles and
+// Morton tiles with and without stealing, from one thread to the pool (at most 64). Then, from the
+// measured cost of every tile of a single threaded frame, the frame time the scheduler's deal and
+// steal policy would reach on 1 to 64 workers, for machines with fewer cores than that.
+//
+#include <gtest/gtest.h>
+#include <DB/SceneRepository.hpp>
+#include <Renderer/HostRestir.h>
+#include <Thread/TileScheduler.h>
+#include <algorithm>
+#include <numeric>
+
+using EXP::THREAD::Pool;
+using EXP::THREAD::Tile;
+using EXP::THREAD::TileScheduler;
+using EXP::THREAD::TileSettings;
+using Renderer::Host::RestirRenderer;
+using Renderer::Host::RestirSettings;
+using Renderer::Host::RestirStats;
+
+static const uint32_t WIDTH = 3024, HEIGHT = 1650;
+
+static bool showcase(Repository::HostScene& scene) {
+  std::string error;
+  if (!Repository::Scenes::load(Repository::Scenes::showcase(std::string(EXPLORER_ASSET_DIR) + "/Meshes"), scene, "", &error)) {
+    std::cerr << error << std::endl;
+    return false;
+  }
+  scene.restir.camera = Renderer::Host::isometricCamera(WIDTH, HEIGHT);
+  return true;
+}
+
+static std::vector<unsigned int> threadCounts() {
+  std::vector<unsigned int> counts;
+  const unsigned int most = std::min(64u, Pool::shared().size());
+  for (unsigned int threads = 1; threads < most; threads *= 2) counts.push_back(threads);
+  counts.push_back(most);
+  return counts;
+}
+
+
+TEST(BENCH_TILES, Frame) {
+  Repository::HostScene scene;
+  ASSERT_TRUE(showcase(scene));
+
+  struct Mode {
+    const char* name;
+    bool tiled, morton, steal;
+  };
+  const Mode modes[] = {
+    {"rows", false, false, false},
+    {"scanline tiles", true, false, true},
+    {"morton tiles, no stealing", true, true, false},
+    {"morton tiles", true, true, true},
+  };
+  for (const Mode& mode : modes) {
+    double single = 0.0;
+    for (unsigned int threads : threadCounts()) {
+      RestirSettings settings;
+      settings.threads = threads;
+      settings.tiled = mode.tiled;
+      settings.tiles.morton = mode.morton;
+      settings.tiles.steal = mode.steal;
+      // The second frame, with the reservoirs of the first, as a running renderer has them
+      RestirRenderer renderer;
+      Renderer::Host::Image image;
+      renderer.render(scene.restir, image, settings);
+      const RestirStats stats = renderer.render(scene.restir, image, settings);
+      if (threads == 1) single = stats.seconds;
+      std::cout << mode.name << ", " << threads << " threads: " << stats.seconds * 1000.0 << " ms, "
+                << stats.raysPerSecond() / 1e6 << " Mrays/s, speedup " << single / stats.seconds;
+      if (mode.tiled) {
+        std::cout << ", imbalance " << stats.tiles.imbalance() << ", efficiency " << 100.0 * stats.tiles.efficiency()
+                  << "%, " << stats.tiles.steals() << " steals (" << stats.tiles.stolen() << " of " << stats.tiles.tiles
+                  << " tiles)";
+      }
+      std::cout << std::endl;
+    }
+  }
+}
+
+
+// Replays the scheduler on `workers` idle cores with known tile costs: contiguous runs of the order
+// dealt out, each worker taking from its head, stealing the back half of the first non empty deque
+// from its right neighbour on. Lock and cache effects are left out.
+struct Replay {
+  double seconds = 0.0;
+  double imbalance = 1.0;
+  uint32_t steals = 0;
+};
+
+static Replay replay(const std::vector<double>& costs, unsigned int workers, bool steal) {
+  struct Worker {
+    double clock = 0.0, busy = 0.0;
+    size_t head = 0, tail = 0;
+    std::vector<size_t> tiles;
+  };
+  std::vector<Worker> state(workers);
+  for (unsigned int w = 0; w < workers; w++) {
+    const size_t begin = costs.size() * w / workers, end = costs.size() * (w + 1) / workers;
+    for (size_t i = begin; i < end; i++) state[w].tiles.push_back(i);
+    state[w].tail = state[w].tiles.size();
+  }
+
+  Replay result;
+  std::vector<bool> done(workers, false);
+  while (true) {
+    // The worker that is free first moves next
+    int next = -1;
+    for (unsigned int w = 0; w < workers; w++) {
+      if (!done[w] && (next < 0 || state[w].clock < state[next].clock)) next = (int)w;
+    }
+    if (next < 0) break;
+    Worker& worker = state[next];
+    if (worker.head == worker.tail) {
+      bool found = false;
+      for (unsigned int k = 1; k < workers && steal && !found; k++) {
+        Worker& victim = state[(next + k) % workers];
+        if (victim.head == victim.tail) continue;
+        const size_t count = (victim.tail - victim.head + 1) / 2;
+        worker.tiles.assign(victim.tiles.begin() + (victim.tail - count), victim.tiles.begin() + victim.tail);
+        worker.head = 0, worker.tail = count;
+        victim.tail -= count;
+        result.steals++, found = true;
+      }
+      if (!found) done[next] = true;
+      continue;
+    }
+    const double cost = costs[worker.tiles[worker.head++]];
+    worker.clock += cost, worker.busy += cost;
+  }
+
+  double total = 0.0;
+  for (const Worker& worker : state) result.seconds = std::max(result.seconds, worker.clock), total += worker.busy;
+  result.imbalance = total > 0.0 ? result.seconds * workers / total : 1.0;
+  return result;
+}
+
+
+TEST(BENCH_TILES, Projected) {
+  Repository::HostScene scene;
+  ASSERT_TRUE(showcase(scene));
+
+  for (uint32_t size : {8u, 16u, 32u, 64u}) {
+    RestirSettings settings;
+    settings.threads = 1;
+    settings.tiles.size = size;
+    settings.tiles.timeTiles = true;
+    RestirRenderer renderer;
+    Renderer::Host::Image image;
+    renderer.render(scene.restir, image, settings);
+    const RestirStats stats = renderer.render(scene.restir, image, settings);
+    const std::vector<double>& costs = stats.tiles.tileSeconds;
+    const double total = std::accumulate(costs.begin(), costs.end(), 0.0);
+    const double slowest = *std::max_element(costs.begin(), costs.end());
+    std::cout << size << " pixel tiles: " << costs.size() << " tiles, " << total * 1000.0 << " ms of work, slowest tile "
+              << slowest * 1e6 << " us, cheapest " << *std::min_element(costs.begin(), costs.end()) * 1e6 << " us"
+              << std::endl;
+
+    for (unsigned int workers = 1; workers <= 64; workers *= 2) {
+      const Replay stealing = replay(costs, workers, true), fixed = replay(costs, workers, false);
+      const double bound = std::max(total / workers, slowest);
+      std::cout << "  " << workers << " workers: " << stealing.seconds * 1000.0 << " ms, speedup "
+                << total / stealing.seconds << ", imbalance " << stealing.imbalance << ", " << stealing.steals
+                << " steals; without stealing " << fixed.seconds * 1000.0 << " ms, speedup " << total / fixed.seconds
+                << ", imbalance " << fixed.imbalance << "; bound " << bound * 1000.0 << " ms" << std::endl;
+    }
+  }
+}
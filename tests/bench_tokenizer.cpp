@@ -0,0 +1,112 @@
+//
+// Float conversion throughput on OBJ style fields: C library, from_chars and the tokenizer per Isa.
+//
+#include <gtest/gtest.h>
+#include <DB/Tokenizer.hpp>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <random>
+
+using Repository::Isa;
+using Repository::Tokenizer;
+using clock_type = std::chrono::steady_clock;
+
+// `lines` of "v x y z\n" with six decimals, like the bundled assets.
+static std::string vertexLines(int lines) {
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+  std::string text;
+  char buffer[96];
+  for (int i = 0; i < lines; i++) {
+    snprintf(buffer, sizeof(buffer), "v %.6f %.6f %.6f\n", value(random), value(random), value(random));
+    text += buffer;
+  }
+  return text;
+}
+
+// Runs `parse` over the text (returns the sum of values so nothing is optimized away).
+static void report(const std::string& label, const std::string& text, const std::function<double(const char*, const char*)>& parse) {
+  const int iterations = 10;
+  const double fields = 3.0 * std::count(text.begin(), text.end(), '\n');
+  double checksum = parse(text.data(), text.data() + text.size());
+  auto start = clock_type::now();
+  for (int i = 0; i < iterations; i++) checksum += parse(text.data(), text.data() + text.size());
+  double seconds = std::chrono::duration<double>(clock_type::now() - start).count() / iterations;
+  std::cout << label << ": " << seconds * 1e9 / fields << " ns/float, " << text.size() / seconds / (1024.0 * 1024.0)
+            << " MB/s (checksum " << checksum << ")" << std::endl;
+}
+
+
+TEST(BENCH_TOKENIZER, Vertices1M) {
+  const std::string text = vertexLines(1000000);
+
+  report("strtof", text, [](const char* p, const char* end) {
+    double sum = 0.0;
+    while (p < end) {
+      char* next = (char*)p + 1;
+      for (int i = 0; i < 3; i++) sum += strtof(next, &next);
+      p = Tokenizer::lineEnd(next, end) + 1;
+    }
+    return sum;
+  });
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  report("from_chars", text, [](const char* p, const char* end) {
+    double sum = 0.0;
+    while (p < end) {
+      p += 1;
+      for (int i = 0; i < 3; i++) {
+        float value = 0.0f;
+        Tokenizer::skipBlank(p, end);
+        p = std::from_chars(p, end, value).ptr;
+        sum += value;
+      }
+      p = Tokenizer::lineEnd(p, end) + 1;
+    }
+    return sum;
+  });
+#else
+  std::cout << "from_chars: no floating point support in this standard library" << std::endl;
+#endif
+
+  for (Isa isa : {Isa::SCALAR, Isa::SSE41, Isa::AVX2, Isa::NEON}) {
+    if (!Tokenizer::supported(isa)) continue;
+    report(std::string("tokenizer ") + Tokenizer::name(isa), text, [isa](const char* p, const char* end) {
+      double sum = 0.0;
+      float values[3];
+      while (p < end) {
+        p += 1;
+        Tokenizer::parseFloats(p, end, values, 3, isa);
+        sum += values[0] + values[1] + values[2];
+        Tokenizer::skipLine(p, end);
+      }
+      return sum;
+    });
+  }
+}
+
+
+TEST(BENCH_TOKENIZER, Indices1M) {
+  std::string text;
+  for (int i = 0; i < 1000000; i++) text += std::to_string((int64_t)i * 7919 % 2000000 + 1) + "/" + std::to_string(i % 5000 + 1) + " ";
+
+  for (Isa isa : {Isa::SCALAR, Isa::SSE41, Isa::AVX2, Isa::NEON}) {
+    if (!Tokenizer::supported(isa)) continue;
+    const int iterations = 10;
+    int64_t checksum = 0;
+    auto start = clock_type::now();
+    for (int i = 0; i < iterations; i++) {
+      const char* p = text.data();
+      const char* end = text.data() + text.size();
+      int32_t value = 0;
+      while (p < end) {
+        if (Tokenizer::parseInt(p, end, value, isa)) checksum += value;
+        p++;
+      }
+    }
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count() / iterations;
+    std::cout << "parseInt " << Tokenizer::name(isa) << ": " << seconds * 1e9 / 2e6 << " ns/int (checksum " << checksum << ")" << std::endl;
+  }
+}
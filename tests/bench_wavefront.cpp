@@ -0,0 +1,60 @@
+//
+// ReSTIR frames of the showcase scene at 3024 x 1650 (the window's drawable), pixel by pixel through
+// the tile scheduler against stage by stage over waves of pixels: frame time and rays/s, and for the
+// wavefront the time spent binning, tracing and shading, with the queues in slot order, binned by
+// octant and origin cell, traced in packets, over a few wave sizes and cell grids.
+//
+#include <gtest/gtest.h>
+#include <DB/SceneRepository.hpp>
+#include <Renderer/HostRestir.h>
+
+using Renderer::Host::RestirRenderer;
+using Renderer::Host::RestirSettings;
+using Renderer::Host::RestirStats;
+
+static const uint32_t WIDTH = 3024, HEIGHT = 1650;
+
+
+TEST(BENCH_WAVEFRONT, Frame) {
+  Repository::HostScene scene;
+  std::string error;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(std::string(EXPLORER_ASSET_DIR) + "/Meshes"), scene, "", &error)) << error;
+  scene.restir.camera = Renderer::Host::isometricCamera(WIDTH, HEIGHT);
+
+  struct Mode {
+    const char* name;
+    bool wavefront, sort, packets;
+    uint32_t wave, cellBits;
+  };
+  const Mode modes[] = {
+    {"per pixel, tiles", false, false, false, 0, 0},
+    {"wavefront, slot order", true, false, false, 1 << 16, 4},
+    {"wavefront, binned", true, true, false, 1 << 16, 4},
+    {"wavefront, binned, 2 cell bits", true, true, false, 1 << 16, 2},
+    {"wavefront, binned, 6 cell bits", true, true, false, 1 << 16, 6},
+    {"wavefront, binned, 16k waves", true, true, false, 1 << 14, 4},
+    {"wavefront, binned, 256k waves", true, true, false, 1 << 18, 4},
+    {"wavefront, binned, packets", true, true, true, 1 << 16, 4},
+  };
+  double reference = 0.0;
+  for (const Mode& mode : modes) {
+    RestirSettings settings;
+    settings.wavefront = mode.wavefront;
+    settings.queues.sort = mode.sort;
+    settings.queues.wave = mode.wave;
+    settings.queues.cellBits = mode.cellBits;
+    if (mode.packets) settings.queues.isa = Renderer::Host::PacketTracer::best();
+    RestirRenderer renderer;
+    Renderer::Host::Image image;
+    const RestirStats stats = renderer.render(scene.restir, image, settings);
+    if (!mode.wavefront) reference = stats.raysPerSecond();
+    std::cout << mode.name << ": " << stats.seconds * 1000.0 << " ms, " << stats.raysPerSecond() / 1e6 << " Mrays/s ("
+              << stats.raysPerSecond() / reference << "x)";
+    if (mode.wavefront) {
+      const Renderer::Host::WavefrontStats& queues = stats.wavefront;
+      std::cout << "; binning " << queues.binSeconds * 1000.0 << " ms, tracing " << queues.traceSeconds * 1000.0 << " ms ("
+                << queues.rays / queues.traceSeconds / 1e6 << " Mrays/s), shading " << queues.shadeSeconds * 1000.0 << " ms";
+    }
+    std::cout << std::endl;
+  }
+}
@@ -0,0 +1,206 @@
+//
+// BC1 / BC7 block compression and the .exptex cache.
+//
+#include <gtest/gtest.h>
+#include <DB/ImageRepository.hpp>
+#include <DB/TextureCache.hpp>
+#include <Renderer/HostBlock.h>
+#include <Renderer/HostMipmap.h>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+using Renderer::Host::BlockChain;
+using Renderer::Host::BlockCompress;
+using Renderer::Host::BlockFormat;
+using Renderer::Host::BlockImage;
+using Renderer::Host::BlockQuality;
+using Renderer::Host::Image;
+using Renderer::Host::PixelFormat;
+
+static const BlockQuality QUALITIES[3] = {BlockQuality::FAST, BlockQuality::NORMAL, BlockQuality::BEST};
+
+// Smooth color ramps with some noise, alpha ramps from 255 at the top to `alpha` at the bottom
+static Image gradient(uint32_t width, uint32_t height, int alpha = 255) {
+  Image image;
+  image.allocate(width, height, PixelFormat::RGBA8_SRGB);
+  uint32_t state = 12345;
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      state = state * 1664525u + 1013904223u;
+      const int noise = (int)(state >> 29) - 4;
+      uint8_t* p = image.row(y) + x * 4;
+      p[0] = (uint8_t)std::clamp((int)(x * 255 / std::max(width - 1, 1u)) + noise, 0, 255);
+      p[1] = (uint8_t)std::clamp((int)(y * 255 / std::max(height - 1, 1u)) + noise, 0, 255);
+      p[2] = (uint8_t)(128 + 100 * std::sin(x * 0.1));
+      p[3] = (uint8_t)(255 - (int)y * (255 - alpha) / (int)std::max(height - 1, 1u));
+    }
+  }
+  return image;
+}
+
+
+TEST(BLOCK, Solid0) {
+  uint8_t texels[64], decoded[64], block[16];
+  for (int i = 0; i < 16; i++) texels[i * 4] = 201, texels[i * 4 + 1] = 37, texels[i * 4 + 2] = 90, texels[i * 4 + 3] = 255;
+  for (BlockQuality quality : QUALITIES) {
+    // BC7 mode 6: one p-bit per endpoint is shared by all channels
+    BlockCompress::encodeBC7(texels, block, quality);
+    BlockCompress::decodeBC7(block, decoded);
+    for (int i = 0; i < 64; i++) ASSERT_LE(std::abs(texels[i] - decoded[i]), 1) << i;
+
+    // BC1 rounds to 565 but may interpolate between neighbouring values
+    BlockCompress::encodeBC1(texels, block, quality);
+    BlockCompress::decodeBC1(block, decoded);
+    for (int i = 0; i < 64; i++) ASSERT_LE(std::abs(texels[i] - decoded[i]), 4) << i;
+  }
+}
+
+
+TEST(BLOCK, Decode0) {
+  // Red and blue endpoints, indices 0 1 2 3 repeating: four color mode
+  const uint8_t bc1[8] = {0x00, 0xF8, 0x1F, 0x00, 0xE4, 0xE4, 0xE4, 0xE4};
+  uint8_t texels[64];
+  BlockCompress::decodeBC1(bc1, texels);
+  const uint8_t expected[4][4] = {{255, 0, 0, 255}, {0, 0, 255, 255}, {170, 0, 85, 255}, {85, 0, 170, 255}};
+  for (int i = 0; i < 16; i++) ASSERT_EQ(0, memcmp(texels + i * 4, expected[i % 4], 4)) << i;
+
+  // Same endpoints swapped: three colors and transparent black
+  const uint8_t bc1Three[8] = {0x1F, 0x00, 0x00, 0xF8, 0xE4, 0xE4, 0xE4, 0xE4};
+  BlockCompress::decodeBC1(bc1Three, texels);
+  const uint8_t expectedThree[4][4] = {{0, 0, 255, 255}, {255, 0, 0, 255}, {127, 0, 127, 255}, {0, 0, 0, 0}};
+  for (int i = 0; i < 16; i++) ASSERT_EQ(0, memcmp(texels + i * 4, expectedThree[i % 4], 4)) << i;
+
+  // BC7 mode 6: endpoints 0 and 254 | 1 in every channel, all indices 0 but the last (15)
+  uint8_t bc7[16] = {};
+  bc7[0] = 0x40; // Mode 6
+  int position = 7;
+  auto put = [&](uint32_t value, int count) {
+    for (int i = 0; i < count; i++, position++) bc7[position / 8] |= (uint8_t)((value >> i & 1) << (position % 8));
+  };
+  for (int c = 0; c < 4; c++) put(0, 7), put(127, 7);
+  put(0, 1), put(1, 1);
+  for (int i = 0; i < 16; i++) put(i == 15 ? 15 : 0, i == 0 ? 3 : 4);
+  ASSERT_EQ(position, 128);
+  BlockCompress::decodeBC7(bc7, texels);
+  for (int c = 0; c < 4; c++) {
+    ASSERT_EQ(texels[c], 0);
+    ASSERT_EQ(texels[60 + c], 255);
+  }
+
+  // Unsupported modes are magenta
+  uint8_t mode0[16] = {0x01};
+  BlockCompress::decodeBC7(mode0, texels);
+  ASSERT_EQ(texels[0], 255);
+  ASSERT_EQ(texels[1], 0);
+  ASSERT_EQ(texels[2], 255);
+}
+
+
+TEST(BLOCK, Alpha0) {
+  // BC1: texels below alpha 128 come back transparent black, the rest opaque
+  const Image image = gradient(16, 16, 0);
+  Image decoded;
+  BlockImage blocks;
+  BlockCompress::encode(image, blocks, BlockFormat::BC1);
+  BlockCompress::decode(blocks, decoded);
+  for (uint32_t y = 0; y < 16; y++) {
+    for (uint32_t x = 0; x < 16; x++) {
+      const uint8_t alpha = image.row(y)[x * 4 + 3];
+      ASSERT_EQ(decoded.row(y)[x * 4 + 3], alpha < 128 ? 0 : 255);
+    }
+  }
+
+  // BC7 keeps alpha to within a few levels
+  BlockCompress::encode(image, blocks, BlockFormat::BC7);
+  BlockCompress::decode(blocks, decoded);
+  ASSERT_GT(BlockCompress::psnr(BlockCompress::mse(image, decoded, 3, 1)), 45.0);
+}
+
+
+TEST(BLOCK, Quality0) {
+  // 61x35: partial edge blocks in both directions
+  const Image image = gradient(61, 35);
+  double previous[2] = {0.0, 0.0};
+  for (BlockQuality quality : QUALITIES) {
+    for (BlockFormat format : {BlockFormat::BC1, BlockFormat::BC7}) {
+      BlockImage blocks, single;
+      BlockCompress::encode(image, blocks, format, quality);
+      ASSERT_EQ(blocks.bytes(), 16 * 9 * BlockImage::blockBytes(format));
+      BlockCompress::encode(image, single, format, quality, 1);
+      ASSERT_EQ(blocks.data, single.data);
+
+      Image decoded;
+      BlockCompress::decode(blocks, decoded);
+      const double psnr = BlockCompress::psnr(BlockCompress::mse(image, decoded));
+      ASSERT_GT(psnr, format == BlockFormat::BC1 ? 33.0 : 40.0);
+      // Higher quality never does noticeably worse
+      ASSERT_GT(psnr, previous[(int)format] - 0.1);
+      previous[(int)format] = psnr;
+    }
+  }
+  ASSERT_GT(previous[1], previous[0]);
+}
+
+
+TEST(BLOCK, Chain0) {
+  Image image;
+  ASSERT_TRUE(Repository::Images::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/f16/f16.bmp", image));
+  Renderer::Host::MipChain chain;
+  Renderer::Host::Mipmap::build(image, chain);
+  BlockChain blocks;
+  const Renderer::Host::BlockReport report = BlockCompress::encode(chain, blocks, BlockFormat::BC7, BlockQuality::FAST);
+  ASSERT_EQ(blocks.levels.size(), chain.levels.size());
+  ASSERT_EQ(blocks.levels.back().width, 1);
+  ASSERT_EQ(blocks.levels.back().bytes(), 16);
+  ASSERT_EQ(blocks.levels[0].bytes() * 4, chain.levels[0].bytes());
+  ASSERT_GT(report.psnr, 38.0);
+  ASSERT_GT(report.alphaPsnr, 50.0); // Opaque: at most a level off where p-bits favour color
+}
+
+
+TEST(TEXTURECACHE, RoundTrip0) {
+  const std::filesystem::path directory = std::filesystem::temp_directory_path() / "explorer_texture_cache";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  const std::string source = (directory / "f16.bmp").string();
+  std::filesystem::copy_file(std::filesystem::path(EXPLORER_ASSET_DIR) / "Meshes" / "f16" / "f16.bmp", source);
+  const std::string cachePath = source + ".exptex";
+
+  Image image;
+  ASSERT_TRUE(Repository::Images::read(source, image));
+  Renderer::Host::MipChain chain;
+  Renderer::Host::Mipmap::build(image, chain);
+  BlockChain blocks;
+  const Renderer::Host::BlockReport report = BlockCompress::encode(chain, blocks, BlockFormat::BC1, BlockQuality::FAST);
+
+  const uint64_t hash = Repository::TextureCache::hashSource(source, BlockFormat::BC1, BlockQuality::FAST);
+  ASSERT_NE(hash, 0);
+  ASSERT_NE(hash, Repository::TextureCache::hashSource(source, BlockFormat::BC1, BlockQuality::NORMAL));
+  std::string error;
+  ASSERT_TRUE(Repository::TextureCache::write(cachePath, blocks, hash, report, &error)) << error;
+
+  Repository::TextureCache cache;
+  ASSERT_TRUE(cache.open(cachePath, hash, &error)) << error;
+  ASSERT_EQ(cache.format(), BlockFormat::BC1);
+  ASSERT_TRUE(cache.srgb());
+  ASSERT_EQ(cache.width(), 1024);
+  ASSERT_FLOAT_EQ(cache.psnr(), (float)report.psnr);
+  ASSERT_EQ(cache.levels().size(), blocks.levels.size());
+  for (size_t l = 0; l < blocks.levels.size(); l++) {
+    const Repository::CachedLevel& level = cache.levels()[l];
+    ASSERT_EQ(level.rowBytes, blocks.levels[l].rowBytes());
+    ASSERT_EQ((uintptr_t)level.data % Repository::TextureCache::ALIGNMENT, 0);
+    ASSERT_EQ(0, memcmp(level.data, blocks.levels[l].data.data(), level.bytes));
+  }
+  BlockChain copy;
+  cache.toBlockChain(copy);
+  ASSERT_EQ(copy.levels[3].data, blocks.levels[3].data);
+
+  // Stale and truncated files do not open
+  ASSERT_FALSE(cache.open(cachePath, hash + 1, &error));
+  ASSERT_NE(error.find("stale"), std::string::npos);
+  std::filesystem::resize_file(cachePath, std::filesystem::file_size(cachePath) - 16);
+  ASSERT_FALSE(cache.open(cachePath, hash));
+  ASSERT_FALSE(cache.isOpen());
+}
@@ -0,0 +1,406 @@
+//
+// CPU BVH builders: structure, closest hits against brute force, axis aligned rays along box planes,
+// degenerate input, parallel, linear and spatial split builds.
+//
+#include <gtest/gtest.h>
+#include <DB/ObjRepository.hpp>
+#include <Renderer/HostBvh.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using EXP::MATH::packed3;
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhBuilder;
+using Renderer::Host::BvhGeometry;
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhRay;
+using Renderer::Host::BvhSettings;
+
+// Small random triangles in the unit cube, XYZ plus a padding float per vertex
+struct Soup {
+  std::vector<float> vertices;
+  std::vector<std::vector<uint32_t>> indices;
+
+  Soup(uint32_t geometries, uint32_t trianglesEach, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f), offset(-0.05f, 0.05f);
+    for (uint32_t g = 0; g < geometries; g++) {
+      indices.emplace_back();
+      for (uint32_t t = 0; t < trianglesEach; t++) {
+        const float cx = unit(random), cy = unit(random), cz = unit(random);
+        for (int k = 0; k < 3; k++) {
+          indices.back().push_back((uint32_t)(vertices.size() / 4));
+          vertices.insert(vertices.end(), {cx + offset(random), cy + offset(random), cz + offset(random), -1.0f});
+        }
+      }
+    }
+  }
+
+  std::vector<BvhGeometry> geometries() const {
+    std::vector<BvhGeometry> result;
+    for (const std::vector<uint32_t>& list : indices) {
+      result.push_back({vertices.data(), 4 * sizeof(float), vertices.size() / 4, list.data(), list.size() / 3});
+    }
+    return result;
+  }
+};
+
+// Wavy height field of size x size quads, two triangles each
+struct Terrain {
+  std::vector<packed3> vertices;
+  std::vector<uint32_t> indices;
+
+  explicit Terrain(uint32_t size) {
+    for (uint32_t z = 0; z <= size; z++) {
+      for (uint32_t x = 0; x <= size; x++) {
+        const float u = (float)x / size, w = (float)z / size;
+        vertices.push_back({u, 0.05f * std::sin(20.0f * u) * std::cos(13.0f * w), w});
+      }
+    }
+    for (uint32_t z = 0; z < size; z++) {
+      for (uint32_t x = 0; x < size; x++) {
+        const uint32_t a = z * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+        indices.insert(indices.end(), {a, b, c, b, d, c});
+      }
+    }
+  }
+
+  std::vector<BvhGeometry> geometries() const {
+    return {{vertices.data(), sizeof(packed3), vertices.size(), indices.data(), indices.size() / 3}};
+  }
+};
+
+// Every triangle, no hierarchy
+static bool bruteForce(const Bvh& bvh, const BvhRay& ray, BvhHit& hit) {
+  Bvh single = bvh;
+  single.nodes = {{{-INFINITY, -INFINITY, -INFINITY}, 0, {INFINITY, INFINITY, INFINITY}, (uint32_t)bvh.triangleCount()}};
+  single.primitives.resize(bvh.triangleCount());
+  for (uint32_t i = 0; i < single.primitives.size(); i++) single.primitives[i] = i;
+  return single.intersect(ray, hit);
+}
+
+static BvhRay randomRay(std::mt19937& random) {
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  BvhRay ray;
+  ray.origin = {0.5f + 2.0f * unit(random), 0.5f + 2.0f * unit(random), 0.5f + 2.0f * unit(random)};
+  const packed3 target = {0.5f + 0.5f * unit(random), 0.5f + 0.5f * unit(random), 0.5f + 0.5f * unit(random)};
+  ray.direction = {target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z};
+  return ray;
+}
+
+
+TEST(BVH, Soup0) {
+  const Soup soup(3, 700, 7);
+  Bvh bvh;
+  const Renderer::Host::BvhReport report = BvhBuilder::binnedSah(soup.geometries(), bvh);
+  std::string error;
+  ASSERT_TRUE(bvh.validate(&error)) << error;
+  ASSERT_EQ(bvh.triangleCount(), 2100);
+  ASSERT_EQ(bvh.geometryFirst, std::vector<uint32_t>({0, 700, 1400, 2100}));
+  ASSERT_EQ(report.nodes, bvh.nodes.size());
+  ASSERT_EQ(report.nodes, 2 * report.leaves - 1);
+  ASSERT_GT(report.sahCost, 0.0);
+  ASSERT_LT(report.sahCost, 2100.0 / 4); // Far below one leaf with everything
+
+  std::mt19937 random(11);
+  int hits = 0;
+  for (int r = 0; r < 2000; r++) {
+    const BvhRay ray = randomRay(random);
+    BvhHit expected, hit;
+    const bool found = bruteForce(bvh, ray, expected);
+    ASSERT_EQ(bvh.intersect(ray, hit), found) << r;
+    if (!found) continue;
+    hits++;
+    ASSERT_FLOAT_EQ(hit.t, expected.t) << r;
+    ASSERT_EQ(hit.primitive, expected.primitive) << r;
+    ASSERT_EQ(hit.geometry, hit.primitive / 700) << r;
+  }
+  ASSERT_GT(hits, 500);
+
+  // tmax cuts hits off, tmin skips the first one
+  BvhRay ray;
+  ray.origin = {0.5f, 0.5f, -1.0f};
+  ray.direction = {0.0f, 0.0f, 1.0f};
+  BvhHit first, second;
+  ASSERT_TRUE(bvh.intersect(ray, first));
+  ray.tmax = first.t * 0.999f;
+  ASSERT_FALSE(bvh.intersect(ray, second));
+  ray.tmin = first.t * 1.0001f;
+  ray.tmax = INFINITY;
+  BvhHit expected;
+  ASSERT_EQ(bvh.intersect(ray, second), bruteForce(bvh, ray, expected));
+  if (expected.primitive != first.primitive) {
+    ASSERT_NE(second.primitive, first.primitive);
+  }
+}
+
+
+TEST(BVH, Axis0) {
+  // Unit triangles in the planes of an integer grid, so node boxes sit on integer planes too
+  std::mt19937 random(21);
+  std::uniform_int_distribution<int> cell(0, 9), axis(0, 2);
+  std::vector<packed3> vertices;
+  std::vector<uint32_t> indices;
+  for (uint32_t t = 0; t < 4000; t++) {
+    const int a = axis(random), b = (a + 1) % 3, c = (a + 2) % 3;
+    float corner[3] = {(float)cell(random), (float)cell(random), (float)cell(random)};
+    packed3 v[3];
+    for (int k = 0; k < 3; k++) {
+      float p[3] = {corner[0], corner[1], corner[2]};
+      if (k == 1) p[b] += 1.0f;
+      if (k == 2) p[c] += 1.0f;
+      v[k] = {p[0], p[1], p[2]};
+    }
+    vertices.insert(vertices.end(), {v[0], v[1], v[2]});
+    indices.insert(indices.end(), {3 * t, 3 * t + 1, 3 * t + 2});
+  }
+  Bvh bvh;
+  BvhBuilder::binnedSah({{vertices.data(), sizeof(packed3), vertices.size(), indices.data(), 4000}}, bvh);
+
+  // Along an axis, the other two coordinates on grid planes half of the time: zero direction
+  // components where the origin lies on a box plane
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  int hits = 0;
+  for (int r = 0; r < 20000; r++) {
+    const int a = axis(random);
+    float origin[3], direction[3] = {0.0f, 0.0f, 0.0f};
+    for (int k = 0; k < 3; k++) origin[k] = (float)cell(random) + (r % 2 ? 0.0f : 0.5f * unit(random));
+    origin[a] = r % 4 < 2 ? -1.0f : 11.0f;
+    direction[a] = r % 4 < 2 ? 1.0f : -1.0f;
+    BvhRay ray;
+    ray.origin = {origin[0], origin[1], origin[2]};
+    ray.direction = {direction[0], direction[1], direction[2]};
+    BvhHit expected, hit;
+    const bool found = bruteForce(bvh, ray, expected);
+    ASSERT_EQ(bvh.intersect(ray, hit), found) << r;
+    ASSERT_EQ(bvh.occluded(ray), found) << r;
+    if (!found) continue;
+    hits++;
+    ASSERT_EQ(hit.t, expected.t) << r;
+    // Nothing before the closest hit, tmax being exclusive
+    ray.tmax = expected.t;
+    ASSERT_FALSE(bvh.occluded(ray)) << r;
+  }
+  ASSERT_GT(hits, 5000);
+}
+
+
+TEST(BVH, Degenerate0) {
+  // 100 copies of one triangle: no plane separates them, ranges are halved down to leaves
+  std::vector<float> vertices = {0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+  std::vector<uint32_t> indices;
+  for (int t = 0; t < 100; t++) indices.insert(indices.end(), {0, 1, 2});
+  Bvh bvh;
+  BvhSettings settings;
+  settings.maxLeafSize = 4;
+  BvhBuilder::binnedSah({{vertices.data(), 12, 3, indices.data(), 100}}, bvh, settings);
+  std::string error;
+  ASSERT_TRUE(bvh.validate(&error)) << error;
+  for (const Renderer::Host::BvhNode& node : bvh.nodes) {
+    if (node.isLeaf()) {
+      ASSERT_LE(node.count, 4);
+    }
+  }
+
+  // The same triangles through uint16_t indices
+  const std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+  BvhGeometry geometry = {vertices.data(), 12, 3, shortIndices.data(), 100};
+  geometry.indexSize = sizeof(uint16_t);
+  Bvh shortBvh;
+  BvhBuilder::binnedSah({geometry}, shortBvh, settings);
+  ASSERT_TRUE(shortBvh.validate(&error)) << error;
+  ASSERT_EQ(memcmp(shortBvh.triangles.data(), bvh.triangles.data(), bvh.triangles.size() * sizeof(bvh.triangles[0])), 0);
+
+  // Nothing to build
+  Bvh empty;
+  ASSERT_EQ(BvhBuilder::binnedSah(std::vector<BvhGeometry>(), empty).nodes, 0);
+  BvhHit hit;
+  ASSERT_FALSE(empty.intersect(BvhRay(), hit));
+}
+
+
+TEST(BVH, Sphere0) {
+  EXP::MDL::HostMesh mesh;
+  ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/sphere/sphere.obj", mesh));
+  Bvh bvh, coarse;
+  const Renderer::Host::BvhReport report = BvhBuilder::binnedSah(mesh, bvh);
+  BvhSettings settings;
+  settings.bins = 4;
+  const Renderer::Host::BvhReport coarseReport = BvhBuilder::binnedSah(mesh, coarse, settings);
+  std::string error;
+  ASSERT_TRUE(bvh.validate(&error)) << error;
+  ASSERT_EQ(bvh.triangleCount(), mesh.triangleCount());
+  ASSERT_LE(report.sahCost, coarseReport.sahCost * 1.01);
+
+  // A ray through the center hits the near side of the sphere
+  BvhRay ray;
+  ray.origin = {0.0f, 0.0f, -10.0f};
+  ray.direction = {0.0f, 0.0f, 1.0f};
+  BvhHit hit;
+  ASSERT_TRUE(bvh.intersect(ray, hit));
+  ASSERT_GT(hit.t, 8.0f);
+  ASSERT_LT(hit.t, 10.0f);
+}
+
+
+TEST(BVH, Parallel0) {
+  // Small tasks so the top levels split across the pool and there are many subtrees
+  const Terrain terrain(150);
+  BvhSettings settings;
+  settings.taskSize = 2048;
+  Bvh bvh, single, serial;
+  const Renderer::Host::BvhReport report = BvhBuilder::binnedSah(terrain.geometries(), bvh, settings);
+  std::string error;
+  ASSERT_TRUE(bvh.validate(&error)) << error;
+  ASSERT_EQ(bvh.triangleCount(), 150 * 150 * 2);
+  ASSERT_EQ(report.nodes, 2 * report.leaves - 1);
+
+  // Any thread count builds the same tree
+  settings.threads = 1;
+  BvhBuilder::binnedSah(terrain.geometries(), single, settings);
+  ASSERT_EQ(single.primitives, bvh.primitives);
+  ASSERT_EQ(single.nodes.size(), bvh.nodes.size());
+  ASSERT_EQ(memcmp(single.nodes.data(), bvh.nodes.data(), bvh.nodes.size() * sizeof(bvh.nodes[0])), 0);
+
+  // Close to the tree built in one task, and the same closest hits
+  settings.taskSize = 1u << 30;
+  const Renderer::Host::BvhReport serialReport = BvhBuilder::binnedSah(terrain.geometries(), serial, settings);
+  ASSERT_LE(report.sahCost, serialReport.sahCost * 1.05);
+  std::mt19937 random(5);
+  for (int r = 0; r < 2000; r++) {
+    const BvhRay ray = randomRay(random);
+    BvhHit expected, hit;
+    ASSERT_EQ(bvh.intersect(ray, hit), serial.intersect(ray, expected)) << r;
+    if (expected.primitive != 0xFFFFFFFF) {
+      ASSERT_FLOAT_EQ(hit.t, expected.t) << r;
+    }
+  }
+}
+
+
+TEST(BVH, Morton0) {
+  ASSERT_EQ(BvhBuilder::morton({0.0f, 0.0f, 0.0f}, 30), 0);
+  ASSERT_EQ(BvhBuilder::morton({1.0f, 1.0f, 1.0f}, 30), (1u << 30) - 1);
+  ASSERT_EQ(BvhBuilder::morton({1.0f, 1.0f, 1.0f}, 63), (1ull << 63) - 1);
+  // x takes the highest bit of every triple
+  ASSERT_EQ(BvhBuilder::morton({0.5f, 0.0f, 0.0f}, 30), 1u << 29);
+  ASSERT_EQ(BvhBuilder::morton({0.0f, 0.5f, 0.0f}, 30), 1u << 28);
+  ASSERT_EQ(BvhBuilder::morton({0.0f, 0.0f, 0.5f}, 63), 1ull << 60);
+  ASSERT_EQ(BvhBuilder::morton({-1.0f, 2.0f, 0.0f}, 30), BvhBuilder::morton({0.0f, 1.0f, 0.0f}, 30));
+
+  // Stable against std::stable_sort, with many duplicate keys over several blocks
+  std::mt19937_64 random(3);
+  for (uint32_t bits : {30u, 63u}) {
+    std::vector<uint64_t> keys(200000);
+    std::vector<uint32_t> values(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      keys[i] = (random() >> (64 - bits)) & ~0xFFFull;
+      values[i] = (uint32_t)i;
+    }
+    std::vector<std::pair<uint64_t, uint32_t>> expected;
+    for (size_t i = 0; i < keys.size(); i++) expected.emplace_back(keys[i], values[i]);
+    std::stable_sort(expected.begin(), expected.end(), [](auto& a, auto& b) { return a.first < b.first; });
+    BvhBuilder::radixSort(keys, values, bits);
+    for (size_t i = 0; i < keys.size(); i++) {
+      ASSERT_EQ(keys[i], expected[i].first) << bits << " " << i;
+      ASSERT_EQ(values[i], expected[i].second) << bits << " " << i;
+    }
+  }
+}
+
+
+TEST(BVH, Linear0) {
+  const Soup soup(3, 700, 7);
+  for (uint32_t bits : {30u, 63u}) {
+    BvhSettings settings;
+    settings.mortonBits = bits;
+    Bvh bvh;
+    const Renderer::Host::BvhReport report = BvhBuilder::linear(soup.geometries(), bvh, settings);
+    std::string error;
+    ASSERT_TRUE(bvh.validate(&error)) << error;
+    ASSERT_EQ(report.leaves, 2100);
+    ASSERT_EQ(report.nodes, 2 * 2100 - 1);
+    ASSERT_LE(report.depth, 64);
+
+    std::mt19937 random(11);
+    for (int r = 0; r < 2000; r++) {
+      const BvhRay ray = randomRay(random);
+      BvhHit expected, hit;
+      const bool found = bruteForce(bvh, ray, expected);
+      ASSERT_EQ(bvh.intersect(ray, hit), found) << r;
+      if (!found) continue;
+      ASSERT_FLOAT_EQ(hit.t, expected.t) << r;
+      ASSERT_EQ(hit.primitive, expected.primitive) << r;
+      ASSERT_EQ(hit.geometry, hit.primitive / 700) << r;
+    }
+  }
+
+  // Worse than the SAH build, but not by much on a height field
+  const Terrain terrain(100);
+  Bvh linear, binned;
+  const double linearSah = BvhBuilder::linear(terrain.geometries(), linear).sahCost;
+  const double binnedSah = BvhBuilder::binnedSah(terrain.geometries(), binned).sahCost;
+  std::string error;
+  ASSERT_TRUE(linear.validate(&error)) << error;
+  ASSERT_LT(linearSah, binnedSah * 2.0);
+
+  // All keys equal, one triangle, nothing
+  std::vector<float> vertices = {0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+  std::vector<uint32_t> indices;
+  for (int t = 0; t < 100; t++) indices.insert(indices.end(), {0, 1, 2});
+  Bvh same, single, empty;
+  BvhBuilder::linear({{vertices.data(), 12, 3, indices.data(), 100}}, same);
+  ASSERT_TRUE(same.validate(&error)) << error;
+  BvhBuilder::linear({{vertices.data(), 12, 3, indices.data(), 1}}, single);
+  ASSERT_TRUE(single.validate(&error)) << error;
+  ASSERT_EQ(single.nodes.size(), 1);
+  ASSERT_EQ(BvhBuilder::linear(std::vector<BvhGeometry>(), empty).nodes, 0);
+}
+
+
+TEST(BVH, Spatial0) {
+  // Long thin triangles across the unit cube, every box overlaps most of the others
+  std::mt19937 random(9);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<packed3> vertices;
+  std::vector<uint32_t> indices;
+  for (uint32_t t = 0; t < 1500; t++) {
+    const packed3 a = {unit(random), unit(random), unit(random)}, b = {unit(random), unit(random), unit(random)};
+    vertices.insert(vertices.end(), {a, b, {a.x + 0.01f, a.y, a.z + 0.01f}});
+    indices.insert(indices.end(), {3 * t, 3 * t + 1, 3 * t + 2});
+  }
+  const std::vector<BvhGeometry> geometries = {{vertices.data(), sizeof(packed3), vertices.size(), indices.data(), 1500}};
+  Bvh binned, spatial;
+  const Renderer::Host::BvhReport binnedReport = BvhBuilder::binnedSah(geometries, binned);
+  const Renderer::Host::BvhReport report = BvhBuilder::spatial(geometries, spatial);
+  std::string error;
+  ASSERT_TRUE(spatial.validate(&error)) << error;
+  ASSERT_TRUE(spatial.spatial);
+  ASSERT_FALSE(binned.spatial);
+  ASSERT_GT(report.references, 1500);
+  ASSERT_LE(report.references, 1500 + 1500 * 3 / 10 + 1);
+  ASSERT_LT(report.sahCost, binnedReport.sahCost * 0.97);
+
+  // Chopped leaves still find every hit, duplicates do not change which one is closest
+  std::mt19937 rays(13);
+  int hits = 0;
+  for (int r = 0; r < 3000; r++) {
+    const BvhRay ray = randomRay(rays);
+    BvhHit expected, hit;
+    const bool found = bruteForce(binned, ray, expected);
+    ASSERT_EQ(spatial.intersect(ray, hit), found) << r;
+    if (!found) continue;
+    hits++;
+    ASSERT_FLOAT_EQ(hit.t, expected.t) << r;
+    ASSERT_EQ(hit.primitive, expected.primitive) << r;
+  }
+  ASSERT_GT(hits, 500);
+
+  // No budget, no duplicates
+  BvhSettings settings;
+  settings.spatialBudget = 0.0f;
+  Bvh flat;
+  ASSERT_EQ(BvhBuilder::spatial(geometries, flat, settings).references, 1500);
+  ASSERT_TRUE(flat.validate(&error)) << error;
+}
@@ -0,0 +1,190 @@
+//
+// .expbvh cache: round trip, keys, fetch building once and loading after, corruption checks.
+//
+#include <gtest/gtest.h>
+#include <DB/BvhCache.hpp>
+#include <DB/ObjRepository.hpp>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhGeometry;
+using Repository::BvhCache;
+using Repository::BvhCacheSettings;
+
+static std::filesystem::path scratch(const std::string& name) {
+  const std::filesystem::path directory = std::filesystem::temp_directory_path() / ("explorer_bvh_cache_" + name);
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  return directory;
+}
+
+static EXP::MDL::HostMesh f16() {
+  EXP::MDL::HostMesh mesh;
+  Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/f16/f16.obj", mesh);
+  return mesh;
+}
+
+static void expectSame(const Bvh& a, const Bvh& b) {
+  ASSERT_EQ(a.nodes.size(), b.nodes.size());
+  ASSERT_EQ(0, memcmp(a.nodes.data(), b.nodes.data(), a.nodes.size() * sizeof(a.nodes[0])));
+  ASSERT_EQ(a.primitives, b.primitives);
+  ASSERT_EQ(a.triangles.size(), b.triangles.size());
+  ASSERT_EQ(0, memcmp(a.triangles.data(), b.triangles.data(), a.triangles.size() * sizeof(a.triangles[0])));
+  ASSERT_EQ(a.geometryFirst, b.geometryFirst);
+  ASSERT_EQ(a.spatial, b.spatial);
+  ASSERT_EQ(a.leafOrder, b.leafOrder);
+}
+
+
+TEST(BVHCACHE, RoundTrip0) {
+  const std::filesystem::path directory = scratch("roundtrip");
+  const EXP::MDL::HostMesh mesh = f16();
+  const std::vector<BvhGeometry> geometries = Renderer::Host::BvhBuilder::geometries(mesh);
+  for (Repository::BvhBuild build : {Repository::BvhBuild::BINNED_SAH, Repository::BvhBuild::SPATIAL, Repository::BvhBuild::LINEAR}) {
+    BvhCacheSettings settings;
+    settings.build = build;
+    Bvh built;
+    const Renderer::Host::BvhReport report = BvhCache::build(geometries, built, settings);
+    ASSERT_TRUE(built.leafOrder);
+    const uint64_t key = BvhCache::key(geometries, settings);
+    const std::string path = (directory / BvhCache::fileName(key)).string();
+    std::string error;
+    ASSERT_TRUE(BvhCache::write(path, built, key, report, &error)) << error;
+    ASSERT_EQ(std::filesystem::file_size(path) % BvhCache::ALIGNMENT, 0);
+
+    BvhCache cache;
+    ASSERT_TRUE(cache.open(path, key, &error)) << error;
+    ASSERT_EQ((uintptr_t)cache.nodes() % 4096, 0);
+    ASSERT_EQ(cache.report().sahCost, report.sahCost);
+    ASSERT_EQ(cache.report().depth, report.depth);
+    ASSERT_EQ(cache.buildSeconds(), report.seconds);
+    Bvh loaded;
+    cache.toBvh(loaded);
+    expectSame(built, loaded);
+    ASSERT_TRUE(loaded.validate(&error)) << error;
+  }
+}
+
+
+TEST(BVHCACHE, Key0) {
+  const EXP::MDL::HostMesh mesh = f16();
+  std::vector<BvhGeometry> geometries = Renderer::Host::BvhBuilder::geometries(mesh);
+  const BvhCacheSettings defaults;
+  const uint64_t key = BvhCache::key(geometries, defaults);
+  ASSERT_NE(key, 0);
+
+  // Threads do not change the tree, the rest does
+  BvhCacheSettings settings;
+  settings.bvh.threads = 1;
+  ASSERT_EQ(BvhCache::key(geometries, settings), key);
+  settings.bvh.maxLeafSize = 4;
+  ASSERT_NE(BvhCache::key(geometries, settings), key);
+  settings = defaults;
+  settings.layout.order = Renderer::Host::NodeOrder::VAN_EMDE_BOAS;
+  ASSERT_NE(BvhCache::key(geometries, settings), key);
+  settings = defaults;
+  settings.build = Repository::BvhBuild::SPATIAL;
+  ASSERT_NE(BvhCache::key(geometries, settings), key);
+
+  // One moved vertex
+  EXP::MDL::HostMesh moved = mesh;
+  moved.vertices[moved.vertices.size() / 2].y += 1e-3f;
+  ASSERT_NE(BvhCache::key(Renderer::Host::BvhBuilder::geometries(moved), defaults), key);
+  geometries.pop_back();
+  ASSERT_NE(BvhCache::key(geometries, defaults), key);
+}
+
+
+TEST(BVHCACHE, Fetch0) {
+  const std::filesystem::path directory = scratch("fetch");
+  const EXP::MDL::HostMesh mesh = f16();
+  const std::vector<BvhGeometry> geometries = Renderer::Host::BvhBuilder::geometries(mesh);
+  const uint64_t key = BvhCache::key(geometries, {});
+  const std::string path = (directory / BvhCache::fileName(key)).string();
+
+  Bvh first, second;
+  bool cached = true;
+  std::string error;
+  BvhCache::fetch(path, key, geometries, first, {}, &cached, &error);
+  ASSERT_FALSE(cached);
+  ASSERT_NE(error.find("No cache"), std::string::npos);
+  ASSERT_TRUE(std::filesystem::exists(path));
+  const Renderer::Host::BvhReport report = BvhCache::fetch(path, key, geometries, second, {}, &cached, &error);
+  ASSERT_TRUE(cached);
+  ASSERT_EQ(report.nodes, first.nodes.size());
+  expectSame(first, second);
+
+  // Another key finds the file stale and replaces it
+  Bvh third;
+  BvhCache::fetch(path, key + 1, geometries, third, {}, &cached, &error);
+  ASSERT_FALSE(cached);
+  ASSERT_NE(error.find("stale"), std::string::npos);
+  BvhCache cache;
+  ASSERT_FALSE(cache.open(path, key));
+  ASSERT_TRUE(cache.open(path, key + 1));
+}
+
+
+TEST(BVHCACHE, Corrupt0) {
+  const std::filesystem::path directory = scratch("corrupt");
+  const EXP::MDL::HostMesh mesh = f16();
+  const std::vector<BvhGeometry> geometries = Renderer::Host::BvhBuilder::geometries(mesh);
+  Bvh bvh;
+  BvhCache::build(geometries, bvh);
+  const std::string path = (directory / "f16.expbvh").string();
+  ASSERT_TRUE(BvhCache::write(path, bvh, 42));
+
+  // Child indices past the end or back up the tree, and geometry ranges running backwards, are
+  // caught before traversal trusts them
+  const uint32_t interior = (uint32_t)(std::find_if(bvh.nodes.begin() + 1, bvh.nodes.end(), [](const auto& node) { return !node.isLeaf(); }) - bvh.nodes.begin());
+  ASSERT_LT(interior, bvh.nodes.size());
+  auto corrupt = [&](auto&& edit) {
+    ASSERT_TRUE(BvhCache::write(path, bvh, 42));
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    Repository::ExpBvhHeader header;
+    file.read((char*)&header, sizeof(header));
+    edit(file, header);
+  };
+  auto writeNode = [&](uint32_t index, uint32_t child) {
+    return [=, &bvh](std::fstream& file, const Repository::ExpBvhHeader& header) {
+      Renderer::Host::BvhNode node = bvh.nodes[index];
+      node.index = child;
+      file.seekp((std::streamoff)(header.nodes.offset + index * sizeof(node)));
+      file.write((const char*)&node, sizeof(node));
+    };
+  };
+  BvhCache cache;
+  std::string error;
+  for (const auto& [index, child] : {std::pair{0u, (uint32_t)bvh.nodes.size()}, {interior, 0u}, {interior, interior}}) {
+    corrupt(writeNode(index, child));
+    ASSERT_FALSE(cache.open(path, 42, &error)) << index << " -> " << child;
+    ASSERT_NE(error.find("corrupt"), std::string::npos);
+  }
+  corrupt([](std::fstream& file, const Repository::ExpBvhHeader& header) {
+    const uint32_t first = 1;
+    file.seekp((std::streamoff)header.geometryFirst.offset);
+    file.write((const char*)&first, sizeof(first));
+  });
+  ASSERT_FALSE(cache.open(path, 42, &error));
+  ASSERT_NE(error.find("corrupt"), std::string::npos);
+
+  // A linear build in build order has children ahead of their parent, which open() would refuse
+  Bvh linear;
+  BvhCacheSettings settings;
+  settings.build = Repository::BvhBuild::LINEAR;
+  settings.layout.order = Renderer::Host::NodeOrder::BUILD;
+  BvhCache::build(geometries, linear, settings);
+  ASSERT_FALSE(BvhCache::write(path, linear, 42, {}, &error));
+  ASSERT_NE(error.find("parent"), std::string::npos);
+
+  ASSERT_TRUE(BvhCache::write(path, bvh, 42));
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - BvhCache::ALIGNMENT);
+  ASSERT_FALSE(cache.open(path, 42));
+  ASSERT_FALSE(cache.isOpen());
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a bvh";
+  ASSERT_FALSE(cache.open(path, 42));
+  ASSERT_FALSE(cache.open((directory / "missing.expbvh").string(), 42));
+}
@@ -0,0 +1,162 @@
+//
+// BVH layout: every order keeps the tree, its hits and the parent before child invariant; depth
+// first puts the hot child's pair right after its parent's; leaf ordered triangles and attributes.
+//
+#include <gtest/gtest.h>
+#include <Renderer/HostBvhLayout.h>
+#include <Renderer/HostBvhQuality.h>
+#include <Renderer/HostWideBvh.h>
+#include <random>
+
+using EXP::MATH::packed3;
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhBuilder;
+using Renderer::Host::BvhGeometry;
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhLayout;
+using Renderer::Host::BvhRay;
+using Renderer::Host::LayoutSettings;
+using Renderer::Host::NodeOrder;
+
+// Small random triangles in the unit cube, split over two geometries
+struct Scatter {
+  std::vector<packed3> vertices;
+  std::vector<uint32_t> first, second;
+
+  Scatter(uint32_t count, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f), offset(-0.03f, 0.03f);
+    for (uint32_t t = 0; t < count; t++) {
+      const packed3 c = {unit(random), unit(random), unit(random)};
+      std::vector<uint32_t>& indices = t % 3 ? first : second;
+      for (int k = 0; k < 3; k++) {
+        indices.push_back((uint32_t)vertices.size());
+        vertices.push_back({c.x + offset(random), c.y + offset(random), c.z + offset(random)});
+      }
+    }
+  }
+
+  std::vector<BvhGeometry> geometries() const {
+    return {
+      {vertices.data(), sizeof(packed3), vertices.size(), first.data(), first.size() / 3},
+      {vertices.data(), sizeof(packed3), vertices.size(), second.data(), second.size() / 3},
+    };
+  }
+};
+
+static std::vector<BvhRay> rays(size_t count, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<BvhRay> result(count);
+  for (BvhRay& ray : result) {
+    ray.origin = {unit(random), unit(random), -1.0f};
+    ray.direction = {unit(random) - 0.5f, unit(random) - 0.5f, 1.0f};
+  }
+  return result;
+}
+
+static void expectSameHits(const Bvh& a, const Bvh& b, const std::vector<BvhRay>& batch) {
+  size_t hits = 0;
+  for (const BvhRay& ray : batch) {
+    BvhHit x, y;
+    ASSERT_EQ(a.intersect(ray, x), b.intersect(ray, y));
+    ASSERT_EQ(x.t, y.t);
+    ASSERT_EQ(x.primitive, y.primitive);
+    ASSERT_EQ(x.geometry, y.geometry);
+    hits += x.t < INFINITY;
+  }
+  ASSERT_GT(hits, batch.size() / 10);
+}
+
+
+TEST(LAYOUT, Orders0) {
+  const Scatter scatter(5000, 1);
+  const std::vector<BvhRay> batch = rays(2000, 2);
+  Bvh linear, spatial;
+  BvhBuilder::linear(scatter.geometries(), linear);
+  BvhBuilder::spatial(scatter.geometries(), spatial);
+  for (const Bvh* built : {&linear, &spatial}) {
+    for (NodeOrder order : {NodeOrder::BUILD, NodeOrder::DEPTH_FIRST, NodeOrder::VAN_EMDE_BOAS}) {
+      for (bool triangles : {false, true}) {
+        Bvh bvh = *built;
+        LayoutSettings settings;
+        settings.order = order;
+        settings.triangles = triangles;
+        BvhLayout::reorder(bvh, settings);
+        std::string error;
+        ASSERT_TRUE(bvh.validate(&error)) << error;
+        ASSERT_EQ(bvh.leafOrder, triangles);
+        ASSERT_EQ(bvh.nodes.size(), built->nodes.size());
+        ASSERT_EQ(bvh.triangleCount(), built->triangleCount());
+        ASSERT_NEAR(bvh.sahCost(), built->sahCost(), 1e-3 * built->sahCost());
+        // Linear builds do not keep children after their parents, the layouts do
+        for (uint32_t i = 0; i < bvh.nodes.size() && order != NodeOrder::BUILD; i++) {
+          if (bvh.nodes[i].isLeaf()) continue;
+          ASSERT_GT(bvh.nodes[i].index, i);
+        }
+        expectSameHits(*built, bvh, batch);
+      }
+    }
+  }
+  // Leaves come in node order, so entries run in order through the array
+  Bvh bvh = linear;
+  BvhLayout::reorder(bvh);
+  uint32_t next = 0;
+  for (const Renderer::Host::BvhNode& node : bvh.nodes) {
+    if (!node.isLeaf()) continue;
+    ASSERT_EQ(node.index, next);
+    next += node.count;
+  }
+  ASSERT_EQ(next, bvh.primitives.size());
+}
+
+
+TEST(LAYOUT, DepthFirst0) {
+  const Scatter scatter(3000, 3);
+  Bvh bvh;
+  BvhBuilder::binnedSah(scatter.geometries(), bvh);
+  BvhLayout::reorder(bvh);
+  // The pair below the root follows it, and every hot interior child's pair follows its own
+  ASSERT_EQ(bvh.nodes[0].index, 1);
+  size_t checked = 0;
+  for (uint32_t pair = 1; pair < bvh.nodes.size(); pair += 2) {
+    uint32_t hot = pair;
+    if (bvh.nodes[pair + 1].bounds().area() > bvh.nodes[pair].bounds().area()) hot = pair + 1;
+    if (bvh.nodes[hot].isLeaf()) continue;
+    ASSERT_EQ(bvh.nodes[hot].index, pair + 2);
+    checked++;
+  }
+  ASSERT_GT(checked, 100);
+}
+
+
+TEST(LAYOUT, Gather0) {
+  const Scatter scatter(2000, 4);
+  Bvh bvh;
+  BvhBuilder::binnedSah(scatter.geometries(), bvh);
+  BvhLayout::reorder(bvh);
+  // One attribute record per triangle id, tagged with it
+  std::vector<Renderer::Host::PrimitiveAttributes> byId(bvh.triangleCount()), ordered(bvh.primitives.size());
+  for (uint32_t t = 0; t < byId.size(); t++) byId[t].flags = {t, 0};
+  BvhLayout::gather(bvh, byId.data(), ordered.data());
+  size_t hits = 0;
+  for (const BvhRay& ray : rays(1000, 5)) {
+    BvhHit hit;
+    if (!bvh.intersect(ray, hit)) continue;
+    ASSERT_EQ(ordered[hit.entry].flags.x, hit.primitive);
+    hits++;
+  }
+  ASSERT_GT(hits, 0);
+
+  // Reordering again, the wide tree and EPO see the same triangles
+  Bvh again = bvh;
+  LayoutSettings settings;
+  settings.order = NodeOrder::VAN_EMDE_BOAS;
+  BvhLayout::reorder(again, settings);
+  ASSERT_TRUE(again.validate());
+  ASSERT_NEAR(Renderer::Host::BvhAnalyzer::epo(again), Renderer::Host::BvhAnalyzer::epo(bvh), 1e-9);
+  Renderer::Host::Bvh8 wide;
+  Renderer::Host::WideBuilder::collapse(again, wide);
+  ASSERT_TRUE(wide.validate());
+  expectSameHits(bvh, again, rays(500, 6));
+}
@@ -0,0 +1,138 @@
+//
+// BVH quality: triangle clipping, end-point overlap on a tree small enough to work out by hand, the
+// report's histogram, and heatmaps through the headless camera.
+//
+#include <gtest/gtest.h>
+#include <Renderer/HostBvhQuality.h>
+#include <Renderer/HostWideBvh.h>
+#include <random>
+
+using EXP::MATH::packed3;
+using Renderer::Host::Aabb;
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhAnalyzer;
+using Renderer::Host::BvhBuilder;
+using Renderer::Host::BvhGeometry;
+using Renderer::Host::BvhQuality;
+using Renderer::Host::BvhTriangle;
+
+// Long thin random triangles in the unit cube, whose boxes overlap whatever split is chosen
+static std::vector<packed3> slivers(uint32_t count, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f), offset(-0.01f, 0.01f);
+  std::vector<packed3> vertices;
+  for (uint32_t t = 0; t < count; t++) {
+    const packed3 a = {unit(random), unit(random), unit(random)}, b = {unit(random), unit(random), unit(random)};
+    vertices.insert(vertices.end(), {a, b, {a.x + offset(random), a.y + offset(random), a.z + offset(random)}});
+  }
+  return vertices;
+}
+
+
+TEST(QUALITY, ClippedArea0) {
+  const BvhTriangle triangle = {{0.0f, 0.0f, 0.0f}, {2.0f, 0.0f, 0.0f}, {0.0f, 2.0f, 0.0f}};
+  ASSERT_NEAR(BvhAnalyzer::clippedArea(triangle, {{0.0f, 0.0f, -1.0f}, {1.0f, 1.0f, 1.0f}}), 1.0f, 1e-6f);
+  ASSERT_NEAR(BvhAnalyzer::clippedArea(triangle, {{-1.0f, -1.0f, -1.0f}, {3.0f, 3.0f, 1.0f}}), 2.0f, 1e-6f);
+  // The corner square cut by the hypotenuse
+  ASSERT_NEAR(BvhAnalyzer::clippedArea(triangle, {{1.0f, 0.0f, -1.0f}, {2.0f, 1.0f, 1.0f}}), 0.5f, 1e-6f);
+  ASSERT_EQ(BvhAnalyzer::clippedArea(triangle, {{0.0f, 0.0f, 0.5f}, {1.0f, 1.0f, 1.0f}}), 0.0f);
+}
+
+
+TEST(QUALITY, Epo0) {
+  // Two leaves of one triangle: B lies inside A's box, and A covers all of B's box
+  Bvh bvh;
+  bvh.triangles = {
+    {{0.0f, 0.0f, 0.0f}, {2.0f, 0.0f, 0.0f}, {0.0f, 2.0f, 0.0f}}, // Area 2
+    {{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}}, // Area 0.5
+  };
+  bvh.primitives = {0, 1};
+  bvh.geometryFirst = {0};
+  bvh.nodes = {
+    {{0.0f, 0.0f, 0.0f}, 1, {2.0f, 2.0f, 0.0f}, 0},
+    {{0.0f, 0.0f, 0.0f}, 0, {2.0f, 2.0f, 0.0f}, 1},
+    {{0.0f, 0.0f, 0.0f}, 1, {1.0f, 1.0f, 0.0f}, 1},
+  };
+  ASSERT_TRUE(bvh.validate());
+  // B's 0.5 inside A's leaf, 1.0 of A inside B's, over 2.5 of surface
+  ASSERT_NEAR(BvhAnalyzer::epo(bvh), 0.6, 1e-6);
+  Renderer::Host::BvhSettings costs;
+  costs.intersectionCost = 2.0f;
+  ASSERT_NEAR(BvhAnalyzer::epo(bvh, costs), 1.2, 1e-6);
+
+  // Apart, nothing overlaps
+  BvhTriangle& b = bvh.triangles[1];
+  b.v0.z = b.v1.z = b.v2.z = 5.0f;
+  bvh.nodes[0].max.z = bvh.nodes[2].min.z = bvh.nodes[2].max.z = 5.0f;
+  ASSERT_EQ(BvhAnalyzer::epo(bvh), 0.0);
+}
+
+
+TEST(QUALITY, Analyze0) {
+  const std::vector<packed3> vertices = slivers(2000, 4);
+  std::vector<uint32_t> indices(vertices.size());
+  for (uint32_t i = 0; i < indices.size(); i++) indices[i] = i;
+  const std::vector<BvhGeometry> geometries = {{vertices.data(), sizeof(packed3), vertices.size(), indices.data(), indices.size() / 3}};
+  Bvh binned, spatial;
+  const Renderer::Host::BvhReport report = BvhBuilder::binnedSah(geometries, binned);
+  BvhBuilder::spatial(geometries, spatial);
+
+  const BvhQuality quality = BvhAnalyzer::analyze(binned);
+  ASSERT_EQ(quality.sahCost, report.sahCost);
+  ASSERT_EQ(quality.depth, report.depth);
+  ASSERT_EQ(quality.leaves, report.leaves);
+  ASSERT_EQ(quality.bytes, binned.bytes());
+  size_t leaves = 0, references = 0;
+  for (size_t n = 0; n < quality.leafSizes.size(); n++) leaves += quality.leafSizes[n], references += n * quality.leafSizes[n];
+  ASSERT_EQ(leaves, quality.leaves);
+  ASSERT_EQ(references, 2000);
+  ASSERT_GT(quality.leafDepth, 1.0);
+  ASSERT_LE(quality.leafDepth, quality.depth);
+  ASSERT_GT(quality.epo, 0.0);
+
+  // The same for any thread count; spatial splits cut the overlap
+  Renderer::Host::BvhSettings serial;
+  serial.threads = 1;
+  ASSERT_EQ(BvhAnalyzer::epo(binned, serial), quality.epo);
+  const BvhQuality split = BvhAnalyzer::analyze(spatial);
+  ASSERT_GT(split.references, 2000);
+  ASSERT_LT(split.epo, quality.epo);
+}
+
+
+TEST(QUALITY, Heatmap0) {
+  const std::vector<packed3> vertices = slivers(2000, 5);
+  std::vector<uint32_t> indices(vertices.size());
+  for (uint32_t i = 0; i < indices.size(); i++) indices[i] = i;
+  Bvh bvh;
+  BvhBuilder::binnedSah({{vertices.data(), sizeof(packed3), vertices.size(), indices.data(), indices.size() / 3}}, bvh);
+  Renderer::Host::Bvh8 wide;
+  Renderer::Host::WideBuilder::collapse(bvh, wide);
+
+  // The middle pixel's ray goes through the middle of the framed bounds, along the view
+  const Renderer::Host::VCamera camera = Renderer::Host::frameCamera(Renderer::Host::isometricCamera(64, 48), bvh.bounds());
+  const Renderer::Host::BvhRay ray = Renderer::Host::primaryRay(camera, 32, 24);
+  const EXP::MATH::float3 center = (EXP::MATH::f3(bvh.bounds().min) + EXP::MATH::f3(bvh.bounds().max)) * 0.5f;
+  const EXP::MATH::float3 toCenter = center - EXP::MATH::f3(ray.origin);
+  ASSERT_NEAR(EXP::MATH::length(EXP::MATH::cross(toCenter, EXP::MATH::f3(ray.direction))), 0.0f, 1e-4f);
+  ASSERT_GT(EXP::MATH::dot(toCenter, EXP::MATH::f3(ray.direction)), 1.0f);
+
+  Renderer::Host::Image steps, triangles, wideSteps;
+  Renderer::Host::HeatmapSettings settings;
+  settings.scale = 100.0f;
+  const Renderer::Host::BvhCounters counters = BvhAnalyzer::heatmap(bvh, camera, steps, settings);
+  const Renderer::Host::BvhCounters wideCounters = BvhAnalyzer::heatmap(wide, camera, wideSteps, settings);
+  settings.triangles = true;
+  BvhAnalyzer::heatmap(bvh, camera, triangles, settings);
+  ASSERT_EQ(steps.width, 64);
+  ASSERT_EQ(steps.height, 48);
+  ASSERT_EQ(steps.format, Renderer::Host::PixelFormat::RGBA8_UNORM);
+  ASSERT_GT(counters.triangles, 0);
+  ASSERT_LT(wideCounters.nodes, counters.nodes);
+  ASSERT_NE(steps.data, triangles.data);
+  // Corners see little, the middle a lot: bluer and redder
+  const uint8_t* corner = steps.row(0);
+  const uint8_t* middle = steps.row(24) + 32 * 4;
+  ASSERT_GT(corner[2], middle[2]);
+  ASSERT_LT(corner[0] + corner[1], middle[0] + middle[1]);
+}
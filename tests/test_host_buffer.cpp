@@ -0,0 +1,51 @@
+//
+// Parallel per primitive builder against the scalar reference.
+//
+#include <gtest/gtest.h>
+#include <DB/ObjRepository.hpp>
+#include <Renderer/HostBuffer.h>
+#include <cstring>
+#include <random>
+
+using Renderer::Host::PrimitiveAttributes;
+using Renderer::Host::VertexAttributes;
+
+static void expectIdentical(
+  const std::vector<VertexAttributes>& attributes,
+  const std::vector<uint32_t>& indices,
+  int texindex,
+  unsigned int maxThreads
+) {
+  const size_t triangles = indices.size() / 3;
+  std::vector<PrimitiveAttributes> expected(triangles), actual(triangles);
+  Renderer::Host::Buffer::perPrimitiveScalar(attributes.data(), indices.data(), indices.size(), texindex, expected.data());
+  Renderer::Host::Buffer::perPrimitive(attributes.data(), indices.data(), indices.size(), texindex, actual.data(), maxThreads);
+  ASSERT_EQ(0, memcmp(expected.data(), actual.data(), triangles * sizeof(PrimitiveAttributes)));
+}
+
+
+TEST(HOSTBUFFER, Identical0) {
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+  std::vector<VertexAttributes> attributes(50000);
+  for (VertexAttributes& attribute : attributes) {
+    attribute.color = {value(random), value(random), value(random), 1.0f};
+    attribute.texture = {value(random), value(random)};
+    attribute.normal = {value(random), value(random), value(random)};
+  }
+
+  // Below and above the streaming threshold, ragged last block, trailing partial triangle
+  const size_t streamTriangles = Renderer::Host::Buffer::STREAM_BYTES / sizeof(PrimitiveAttributes);
+  for (size_t triangles : {(size_t)1, (size_t)1000, streamTriangles + 17}) {
+    std::vector<uint32_t> indices(triangles * 3 + 1);
+    for (uint32_t& index : indices) index = random() % attributes.size();
+    for (unsigned int threads : {1u, 2u, 0u}) expectIdentical(attributes, indices, 300, threads);
+  }
+}
+
+
+TEST(HOSTBUFFER, F16) {
+  EXP::MDL::HostMesh mesh;
+  ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/f16/f16.obj", mesh));
+  for (size_t s = 0; s < mesh.submeshes.size(); s++) expectIdentical(mesh.attributes, mesh.submeshes[s].indices, (int)s, 0);
+}
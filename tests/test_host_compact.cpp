@@ -0,0 +1,126 @@
+//
+// Compact primitive layout: round trip error and memory against PrimitiveAttributes.
+//
+#include <gtest/gtest.h>
+#include <DB/ObjRepository.hpp>
+#include <Model/Weld.h>
+#include <Renderer/HostBuffer.h>
+#include <Renderer/HostCompact.h>
+#include <cmath>
+#include <random>
+
+using EXP::MATH::float3;
+using Renderer::Host::Compact;
+using Renderer::Host::CompactSubmesh;
+using Renderer::Host::PrimitiveAttributes;
+
+static float degrees(const float3& a, const float3& b) {
+  return std::acos(std::clamp(EXP::MATH::dot(EXP::MATH::normalize(a), EXP::MATH::normalize(b)), -1.0f, 1.0f)) * 57.29578f;
+}
+
+// Largest normal error in degrees and texture coordinate error in units of the submesh extent
+static void roundTrip(const std::vector<PrimitiveAttributes>& primitives, CompactSubmesh& compact, float& normalError, float& uvError) {
+  Compact::encode(primitives.data(), primitives.size(), compact);
+  std::vector<PrimitiveAttributes> decoded(primitives.size());
+  Compact::decode(compact, decoded.data());
+
+  normalError = uvError = 0.0f;
+  for (size_t i = 0; i < primitives.size(); i++) {
+    ASSERT_EQ(decoded[i].flags.x, primitives[i].flags.x & 0xFF);
+    for (int k = 0; k < 3; k++) {
+      for (int c = 0; c < 4; c++) ASSERT_EQ(decoded[i].color[k][c], primitives[i].color[k][c]);
+      if (EXP::MATH::length(primitives[i].normal[k]) > 0.0f) {
+        normalError = std::max(normalError, degrees(decoded[i].normal[k], primitives[i].normal[k]));
+      }
+      const float dx = std::fabs(decoded[i].txcoord[k].x - primitives[i].txcoord[k].x);
+      const float dy = std::fabs(decoded[i].txcoord[k].y - primitives[i].txcoord[k].y);
+      if (compact.uvExtent.x > 0.0f) uvError = std::max(uvError, dx / compact.uvExtent.x);
+      if (compact.uvExtent.y > 0.0f) uvError = std::max(uvError, dy / compact.uvExtent.y);
+    }
+  }
+}
+
+
+TEST(HOSTCOMPACT, Normals0) {
+  for (const float3& axis : {float3{1, 0, 0}, float3{0, -1, 0}, float3{0, 0, 1}, float3{0, 0, -1}}) {
+    ASSERT_LT(degrees(Compact::decodeNormal(Compact::encodeNormal(axis)), axis), 1e-3f);
+  }
+  // Zero and NaN normals both fall back to +z
+  ASSERT_EQ(Compact::encodeNormal({0, 0, 0}), 0);
+  ASSERT_EQ(Compact::encodeNormal({NAN, 0, 1}), 0);
+  ASSERT_EQ(Compact::decodeNormal(Compact::encodeNormal({0, 0, 0})).z, 1.0f);
+
+  std::mt19937 random(3);
+  std::normal_distribution<float> gaussian;
+  float worst = 0.0f;
+  for (int i = 0; i < 100000; i++) {
+    const float3 normal = EXP::MATH::normalize({gaussian(random), gaussian(random), gaussian(random)});
+    const float3 decoded = Compact::decodeNormal(Compact::encodeNormal(normal));
+    ASSERT_NEAR(EXP::MATH::length(decoded), 1.0f, 1e-5f);
+    worst = std::max(worst, degrees(decoded, normal));
+  }
+  ASSERT_LT(worst, 0.65f);
+}
+
+
+TEST(HOSTCOMPACT, RoundTrip0) {
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+  std::vector<PrimitiveAttributes> primitives(4096);
+  for (size_t i = 0; i < primitives.size(); i++) {
+    for (int k = 0; k < 3; k++) {
+      primitives[i].color[k] = {0.8f, 0.2f, 0.1f, 1.0f};
+      primitives[i].txcoord[k] = {value(random) * 4.0f, value(random)};
+      primitives[i].normal[k] = {value(random), value(random), value(random)};
+    }
+    primitives[i].flags = {(uint32_t)(i % 7), 0};
+  }
+  // A few triangles with their own (per corner) colors
+  for (size_t i = 0; i < primitives.size(); i += 97) primitives[i].color[1] = {value(random), 0.0f, 1.0f, 1.0f};
+
+  CompactSubmesh compact;
+  float normalError, uvError;
+  roundTrip(primitives, compact, normalError, uvError);
+  ASSERT_EQ(compact.colors.size(), 3 * ((primitives.size() + 96) / 97));
+  ASSERT_EQ(compact.color.x, 0.8f);
+  ASSERT_LT(normalError, 0.65f);
+  ASSERT_LE(uvError, 0.5f / 65535.0f + 1e-6f);
+
+  // Uniform texture coordinates: zero extent, still exact
+  for (PrimitiveAttributes& primitive : primitives) primitive.txcoord[0] = primitive.txcoord[1] = primitive.txcoord[2] = {0.25f, 0.5f};
+  roundTrip(primitives, compact, normalError, uvError);
+  ASSERT_EQ(Compact::decodePrimitive(compact, 0).txcoord[2].y, 0.5f);
+}
+
+
+TEST(HOSTCOMPACT, Assets) {
+  for (const char* name : {"f16", "sphere", "cruiser"}) {
+    EXP::MDL::HostMesh mesh;
+    ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/" + name + "/" + name + ".obj", mesh));
+    EXP::MDL::Weld::apply(mesh);
+
+    size_t fullBytes = 0, compactBytes = 0, overrides = 0;
+    float normalError = 0.0f, uvError = 0.0f;
+    for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+      const std::vector<uint32_t>& indices = mesh.submeshes[s].indices;
+      std::vector<PrimitiveAttributes> primitives(indices.size() / 3);
+      Renderer::Host::Buffer::perPrimitive(mesh.attributes.data(), indices.data(), indices.size(), (int)s, primitives.data());
+
+      CompactSubmesh compact;
+      float submeshNormalError, submeshUvError;
+      roundTrip(primitives, compact, submeshNormalError, submeshUvError);
+      normalError = std::max(normalError, submeshNormalError);
+      uvError = std::max(uvError, submeshUvError);
+      fullBytes += primitives.size() * sizeof(PrimitiveAttributes);
+      compactBytes += compact.bytes();
+      overrides += compact.colors.size() / 3;
+    }
+    ASSERT_LT(normalError, 0.65f);
+    ASSERT_LT(compactBytes, fullBytes);
+
+    std::cout << name << ": " << mesh.triangleCount() << " triangles, PrimitiveAttributes " << fullBytes
+              << " bytes, compact " << compactBytes << " bytes (" << (double)fullBytes / compactBytes << "x), "
+              << overrides << " color overrides, max normal error " << normalError << " deg, max uv error "
+              << uvError << " of extent" << std::endl;
+  }
+}
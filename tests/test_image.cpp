@@ -0,0 +1,284 @@
+//
+// Portable image decoders and the mip chain generator.
+//
+#include <gtest/gtest.h>
+#include <DB/ImageRepository.hpp>
+#include <Renderer/HostMipmap.h>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <tuple>
+
+using Renderer::Host::Image;
+using Renderer::Host::PixelFormat;
+
+static std::vector<uint8_t> readFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void le16(std::vector<uint8_t>& out, uint32_t value) { out.insert(out.end(), {(uint8_t)value, (uint8_t)(value >> 8)}); }
+static void le32(std::vector<uint8_t>& out, uint32_t value) { le16(out, value & 0xFFFF), le16(out, value >> 16); }
+
+// 3x2 RGBA reference, row 0 at the top
+static const uint8_t PIXELS[2][3][4] = {
+  {{255, 0, 0, 255}, {0, 255, 0, 128}, {0, 0, 255, 255}},
+  {{255, 255, 255, 0}, {0, 0, 0, 255}, {128, 64, 32, 255}},
+};
+
+static void expectPixels(const Image& image, bool alpha) {
+  ASSERT_EQ(image.width, 3);
+  ASSERT_EQ(image.height, 2);
+  ASSERT_EQ(image.format, PixelFormat::RGBA8_SRGB);
+  for (uint32_t y = 0; y < 2; y++) {
+    for (uint32_t x = 0; x < 3; x++) {
+      for (int c = 0; c < 3; c++) ASSERT_EQ(image.row(y)[x * 4 + c], PIXELS[y][x][c]) << x << "," << y;
+      ASSERT_EQ(image.row(y)[x * 4 + 3], alpha ? PIXELS[y][x][3] : 255);
+    }
+  }
+}
+
+static std::vector<uint8_t> bmp(int bits, bool topDown, bool bitfields) {
+  const size_t stride = (3 * bits + 31) / 32 * 4;
+  const uint32_t header = bitfields ? 56 : 40;
+  const uint32_t paletteBytes = bits == 8 ? 6 * 4 : 0;
+  const uint32_t offset = 14 + header + paletteBytes;
+  std::vector<uint8_t> out = {'B', 'M'};
+  le32(out, offset + (uint32_t)stride * 2), le32(out, 0), le32(out, offset);
+  le32(out, header), le32(out, 3), le32(out, topDown ? (uint32_t)-2 : 2), le16(out, 1), le16(out, bits);
+  le32(out, bitfields ? 3 : 0), le32(out, 0), le32(out, 0), le32(out, 0), le32(out, bits == 8 ? 6 : 0), le32(out, 0);
+  if (bitfields) le32(out, 0x000000FF), le32(out, 0x0000FF00), le32(out, 0x00FF0000), le32(out, 0xFF000000);
+  if (bits == 8) {
+    for (int i = 0; i < 6; i++) out.insert(out.end(), {PIXELS[i / 3][i % 3][2], PIXELS[i / 3][i % 3][1], PIXELS[i / 3][i % 3][0], 0});
+  }
+  for (int r = 0; r < 2; r++) {
+    const int y = topDown ? r : 1 - r;
+    const size_t start = out.size();
+    for (int x = 0; x < 3; x++) {
+      const uint8_t* p = PIXELS[y][x];
+      if (bits == 8) out.push_back((uint8_t)(y * 3 + x));
+      else if (bits == 24) out.insert(out.end(), {p[2], p[1], p[0]});
+      else out.insert(out.end(), {p[0], p[1], p[2], p[3]}); // Matches the masks above
+    }
+    out.resize(start + stride, 0);
+  }
+  return out;
+}
+
+static std::vector<uint8_t> tga(uint8_t type, int bits, bool topDown) {
+  const bool mapped = (type & 7) == 1;
+  std::vector<uint8_t> out = {2, (uint8_t)(mapped ? 1 : 0), type};
+  le16(out, 0), le16(out, mapped ? 6 : 0), out.push_back(mapped ? 32 : 0);
+  le16(out, 0), le16(out, 0), le16(out, 3), le16(out, 2);
+  out.insert(out.end(), {(uint8_t)bits, (uint8_t)((topDown ? 0x20 : 0) | (bits == 32 || mapped ? 8 : 0)), 'i', 'd'});
+  if (mapped) {
+    for (int i = 0; i < 6; i++) out.insert(out.end(), {PIXELS[i / 3][i % 3][2], PIXELS[i / 3][i % 3][1], PIXELS[i / 3][i % 3][0], PIXELS[i / 3][i % 3][3]});
+  }
+  for (int r = 0; r < 2; r++) {
+    const int y = topDown ? r : 1 - r;
+    if (type >= 9) out.push_back(2); // Every row as one raw packet of three pixels
+    for (int x = 0; x < 3; x++) {
+      const uint8_t* p = PIXELS[y][x];
+      if (mapped) out.push_back((uint8_t)(y * 3 + x));
+      else if (bits == 24) out.insert(out.end(), {p[2], p[1], p[0]});
+      else out.insert(out.end(), {p[2], p[1], p[0], p[3]});
+    }
+  }
+  return out;
+}
+
+
+TEST(IMAGE, Bmp0) {
+  for (const auto& [bits, topDown, bitfields] : {std::tuple{24, false, false}, {24, true, false}, {8, false, false}, {32, true, true}, {32, false, true}}) {
+    const std::vector<uint8_t> file = bmp(bits, topDown, bitfields);
+    Image image;
+    std::string error;
+    ASSERT_TRUE(Repository::Images::decodeBmp(file.data(), file.size(), image, &error)) << error;
+    expectPixels(image, bitfields);
+  }
+
+  // f16.bmp: 24 bit, bottom up, so the first file pixel is the bottom left one
+  const std::string path = std::string(EXPLORER_ASSET_DIR) + "/Meshes/f16/f16.bmp";
+  const std::vector<uint8_t> file = readFile(path);
+  Image image;
+  ASSERT_TRUE(Repository::Images::read(path, image));
+  ASSERT_EQ(image.width, 1024);
+  ASSERT_EQ(image.height, 1024);
+  const uint8_t* first = file.data() + 54;
+  ASSERT_EQ(image.row(1023)[0], first[2]);
+  ASSERT_EQ(image.row(1023)[2], first[0]);
+
+  std::vector<uint8_t> truncated(file.begin(), file.begin() + file.size() / 2);
+  std::string error;
+  ASSERT_FALSE(Repository::Images::decodeBmp(truncated.data(), truncated.size(), image, &error));
+  ASSERT_NE(error.find("truncated"), std::string::npos);
+}
+
+
+TEST(IMAGE, Tga0) {
+  for (const auto& [type, bits, topDown, alpha] : {std::tuple{(uint8_t)2, 24, false, false}, {(uint8_t)2, 32, true, true}, {(uint8_t)10, 32, false, true}, {(uint8_t)1, 8, true, true}, {(uint8_t)9, 8, false, true}}) {
+    const std::vector<uint8_t> file = tga(type, bits, topDown);
+    Image image;
+    std::string error;
+    ASSERT_TRUE(Repository::Images::decode(file.data(), file.size(), image, &error)) << error;
+    expectPixels(image, alpha);
+  }
+
+  // RLE repeat packet across a row boundary
+  std::vector<uint8_t> file = {0, 0, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 2, 0, 24, 0x20, 0x80 | 3, 1, 2, 3, 1, 4, 5, 6, 7, 8, 9};
+  Image image;
+  ASSERT_TRUE(Repository::Images::decodeTga(file.data(), file.size(), image));
+  ASSERT_EQ(image.row(1)[0], 3);
+  ASSERT_EQ(image.row(1)[4], 6);
+  ASSERT_EQ(image.row(1)[8], 9);
+  file.pop_back();
+  ASSERT_FALSE(Repository::Images::decodeTga(file.data(), file.size(), image));
+
+  // Written and read back as it was
+  Image written;
+  written.allocate(5, 3, PixelFormat::RGBA8_UNORM);
+  for (size_t i = 0; i < written.data.size(); i++) written.data[i] = (uint8_t)(i * 7);
+  std::vector<uint8_t> encoded;
+  ASSERT_TRUE(Repository::Images::encodeTga(written, encoded));
+  ASSERT_TRUE(Repository::Images::decodeTga(encoded.data(), encoded.size(), image));
+  ASSERT_EQ(image.width, 5);
+  ASSERT_EQ(image.data, written.data);
+  written.format = PixelFormat::RGBA16F;
+  ASSERT_FALSE(Repository::Images::encodeTga(written, encoded));
+  ASSERT_FALSE(Repository::Images::write("out.png", image));
+}
+
+
+TEST(IMAGE, Jpeg0) {
+  // Reference values from libjpeg (float IDCT); IDCT rounding may differ by a few levels
+  const std::string path = std::string(EXPLORER_ASSET_DIR) + "/Textures/island.jpg";
+  Image image;
+  std::string error;
+  ASSERT_TRUE(Repository::Images::read(path, image, &error)) << error;
+  ASSERT_EQ(image.width, 360);
+  ASSERT_EQ(image.height, 240);
+  const int samples[4][5] = {{13, 7, 0, 126, 177}, {110, 68, 118, 146, 71}, {207, 129, 15, 75, 99}, {304, 190, 0, 72, 97}};
+  for (const auto& sample : samples) {
+    for (int c = 0; c < 3; c++) ASSERT_NEAR(image.row(sample[1])[sample[0] * 4 + c], sample[2 + c], 2);
+  }
+
+  Image single;
+  ASSERT_TRUE(Repository::Images::read(path, single, nullptr, 1));
+  ASSERT_EQ(single.data, image.data);
+
+  const std::vector<uint8_t> progressive = {0xFF, 0xD8, 0xFF, 0xC2, 0x00, 0x0B, 8, 0, 1, 0, 1, 1, 1, 0x11, 0};
+  ASSERT_FALSE(Repository::Images::decode(progressive.data(), progressive.size(), image, &error));
+  ASSERT_NE(error.find("Progressive"), std::string::npos);
+  std::vector<uint8_t> file = readFile(path);
+  file.resize(file.size() / 3);
+  Repository::Images::decodeJpeg(file.data(), file.size(), image); // Must not crash
+}
+
+
+TEST(IMAGE, Corrupt0) {
+  Image image;
+  std::string error;
+
+  // Bit depths without a decoder, BMP reading 4 bytes per pixel of a stride made for fewer
+  for (int bits : {0, 3, 7}) {
+    std::vector<uint8_t> file = bmp(24, false, false);
+    file[28] = (uint8_t)bits;
+    ASSERT_FALSE(Repository::Images::decodeBmp(file.data(), file.size(), image, &error)) << bits;
+    ASSERT_NE(error.find("bit depth"), std::string::npos);
+  }
+
+  // TGA sizes past the limit and RLE data far too short for its size, both before allocating
+  std::vector<uint8_t> file = {0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 32, 0x28, 0, 0, 0, 0};
+  ASSERT_FALSE(Repository::Images::decodeTga(file.data(), file.size(), image, &error));
+  ASSERT_NE(error.find("size"), std::string::npos);
+  file = {0, 0, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00, 0x40, 0x00, 0x40, 24, 0x20, 0xFF, 1, 2, 3};
+  ASSERT_FALSE(Repository::Images::decodeTga(file.data(), file.size(), image, &error));
+  ASSERT_NE(error.find("truncated"), std::string::npos);
+
+  // 255 one bit codes in a DHT, where only two fit
+  file = {0xFF, 0xD8, 0xFF, 0xC4, 0x01, 0x12, 0x00, 255};
+  file.resize(file.size() + 15, 0);
+  for (int i = 0; i < 255; i++) file.push_back((uint8_t)i);
+  ASSERT_FALSE(Repository::Images::decodeJpeg(file.data(), file.size(), image, &error));
+  ASSERT_NE(error.find("DHT"), std::string::npos);
+
+  // SOS that ends before its component count
+  file = {0xFF, 0xD8, 0xFF, 0xC0, 0x00, 0x0B, 8, 0, 1, 0, 1, 1, 1, 0x11, 0, 0xFF, 0xDA, 0x00, 0x02};
+  ASSERT_FALSE(Repository::Images::decodeJpeg(file.data(), file.size(), image, &error));
+  ASSERT_NE(error.find("SOS"), std::string::npos);
+}
+
+
+TEST(IMAGE, Half0) {
+  using Renderer::Host::Half;
+  ASSERT_EQ(Half::fromFloat(1.0f), 0x3C00);
+  ASSERT_EQ(Half::fromFloat(-2.0f), 0xC000);
+  ASSERT_EQ(Half::fromFloat(65504.0f), 0x7BFF);
+  ASSERT_EQ(Half::fromFloat(1e6f), 0x7C00);
+  ASSERT_EQ(Half::fromFloat(1.0f + 1.0f / 2048.0f), 0x3C00); // Tie to even
+  ASSERT_EQ(Half::toFloat(0x0001), std::ldexp(1.0f, -24));
+  for (uint32_t bits = 0; bits < 0x7C00; bits++) ASSERT_EQ(Half::fromFloat(Half::toFloat((uint16_t)bits)), bits);
+}
+
+
+TEST(MIPMAP, Levels0) {
+  using Renderer::Host::Mipmap;
+  ASSERT_EQ(Mipmap::levelCount(1024, 1024), 11);
+  ASSERT_EQ(Mipmap::levelCount(1024, 1), 11);
+  ASSERT_EQ(Mipmap::levelCount(1, 1), 1);
+
+  Image odd;
+  odd.allocate(5, 3, PixelFormat::RGBA8_SRGB);
+  for (uint8_t& value : odd.data) value = 77;
+  for (auto filter : {Renderer::Host::MipFilter::BOX, Renderer::Host::MipFilter::KAISER}) {
+    Renderer::Host::MipChain chain;
+    Mipmap::build(odd, chain, filter);
+    ASSERT_EQ(chain.levels.size(), 3);
+    ASSERT_EQ(chain.levels[1].width, 2);
+    ASSERT_EQ(chain.levels[1].height, 1);
+    ASSERT_EQ(chain.levels[2].width, 1);
+    // A flat image stays flat, whatever the weights
+    for (const Image& level : chain.levels) {
+      for (uint8_t value : level.data) ASSERT_EQ(value, 77);
+    }
+  }
+}
+
+
+TEST(MIPMAP, GammaCorrect0) {
+  using Renderer::Host::Mipmap;
+  Image checker;
+  checker.allocate(64, 64, PixelFormat::RGBA8_SRGB);
+  for (uint32_t y = 0; y < 64; y++) {
+    for (uint32_t x = 0; x < 64; x++) {
+      const uint8_t value = (x + y) % 2 ? 255 : 0;
+      uint8_t* pixel = checker.row(y) + x * 4;
+      pixel[0] = pixel[1] = pixel[2] = value, pixel[3] = value;
+    }
+  }
+
+  Renderer::Host::MipChain chain;
+  Mipmap::build(checker, chain);
+  // Half the light: linear 0.5 is sRGB 188; alpha averages linearly
+  for (size_t level = 1; level < chain.levels.size(); level++) {
+    const uint8_t* pixel = chain.levels[level].row(0);
+    ASSERT_EQ(pixel[0], 188);
+    ASSERT_EQ(pixel[3], 128);
+  }
+  ASSERT_EQ(Mipmap::toSrgb(0.5f), 188);
+  ASSERT_NEAR(Mipmap::toLinear(188), 0.5f, 0.005f);
+
+  Renderer::Host::MipChain kaiser;
+  Mipmap::build(checker, kaiser, Renderer::Host::MipFilter::KAISER, PixelFormat::RGBA16F, 1);
+  ASSERT_EQ(kaiser.levels[0].format, PixelFormat::RGBA16F);
+  ASSERT_EQ(kaiser.levels[0].bytes(), 64 * 64 * 8);
+  uint16_t half;
+  memcpy(&half, kaiser.levels[3].row(4) + 4 * 8, 2);
+  ASSERT_NEAR(Renderer::Host::Half::toFloat(half), 0.5f, 0.01f);
+
+  // Thread count does not change the result
+  Renderer::Host::MipChain single;
+  Mipmap::build(checker, single, Renderer::Host::MipFilter::BOX, PixelFormat::RGBA8_SRGB, 1);
+  for (size_t level = 0; level < chain.levels.size(); level++) ASSERT_EQ(single.levels[level].data, chain.levels[level].data);
+}
@@ -0,0 +1,421 @@
+//
+// Two level acceleration: 4x3 transforms and their inverses, instance hits against every triangle
+// moved to world space, axis aligned rays along instance boxes, occlusion queries agreeing with
+// them, masks, and instances left out of the top level. Updates between frames: no work when
+// nothing moved, refits that hit what a rebuild would, rebuilds once refits degrade, and the same
+// over bounds-only bottom levels.
+//
+#include <gtest/gtest.h>
+#include <Renderer/HostInstance.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using EXP::MATH::float3;
+using EXP::MATH::packed3;
+using EXP::MATH::packed4x3;
+using Renderer::Host::Bvh;
+using Renderer::Host::Bvh8;
+using Renderer::Host::BvhBuilder;
+using Renderer::Host::BvhCounters;
+using Renderer::Host::BvhGeometry;
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhNode;
+using Renderer::Host::BvhRay;
+using Renderer::Host::Instance;
+using Renderer::Host::Tlas;
+using Renderer::Host::TlasAction;
+using Renderer::Host::TlasBuilder;
+using Renderer::Host::TlasUpdate;
+
+// Rotation about an axis, uniform scale, translation
+static packed4x3 transform(float3 axis, float angle, float scale, float3 translation) {
+  axis = EXP::MATH::normalize(axis);
+  const float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+  packed4x3 m;
+  m.columns[0] = {scale * (t * axis.x * axis.x + c), scale * (t * axis.x * axis.y + s * axis.z), scale * (t * axis.x * axis.z - s * axis.y)};
+  m.columns[1] = {scale * (t * axis.x * axis.y - s * axis.z), scale * (t * axis.y * axis.y + c), scale * (t * axis.y * axis.z + s * axis.x)};
+  m.columns[2] = {scale * (t * axis.x * axis.z + s * axis.y), scale * (t * axis.y * axis.z - s * axis.x), scale * (t * axis.z * axis.z + c)};
+  m.columns[3] = EXP::MATH::p3(translation);
+  return m;
+}
+
+// Random small triangles in the unit cube
+static std::vector<packed3> triangles(uint32_t count, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f), offset(-0.08f, 0.08f);
+  std::vector<packed3> vertices;
+  for (uint32_t t = 0; t < count; t++) {
+    const packed3 center = {unit(random), unit(random), unit(random)};
+    for (int k = 0; k < 3; k++) vertices.push_back({center.x + offset(random), center.y + offset(random), center.z + offset(random)});
+  }
+  return vertices;
+}
+
+static BvhGeometry geometry(const std::vector<packed3>& vertices, const std::vector<uint32_t>& indices) {
+  return {vertices.data(), sizeof(packed3), vertices.size(), indices.data(), indices.size() / 3};
+}
+
+
+TEST(INSTANCE, Transform0) {
+  const packed4x3 m = transform({1.0f, 2.0f, -0.5f}, 0.7f, 2.5f, {3.0f, -1.0f, 4.0f});
+  packed4x3 inverse;
+  ASSERT_TRUE(EXP::MATH::inverse(m, inverse));
+  for (const float3 p : {float3{0.0f, 0.0f, 0.0f}, float3{1.0f, -2.0f, 0.5f}, float3{-7.0f, 3.0f, 2.0f}}) {
+    const float3 back = EXP::MATH::transformPoint(inverse, EXP::MATH::transformPoint(m, p));
+    ASSERT_NEAR(back.x, p.x, 1e-5f);
+    ASSERT_NEAR(back.y, p.y, 1e-5f);
+    ASSERT_NEAR(back.z, p.z, 1e-5f);
+  }
+  const float3 moved = EXP::MATH::transformPoint(EXP::MATH::identity4x3(), {1.0f, 2.0f, 3.0f});
+  ASSERT_EQ(moved.y, 2.0f);
+
+  packed4x3 flat = m;
+  flat.columns[2] = {0.0f, 0.0f, 0.0f};
+  ASSERT_FALSE(EXP::MATH::inverse(flat, inverse));
+
+  // World box of a transformed box holds every transformed corner
+  const Renderer::Host::Aabb box = TlasBuilder::transform({{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}}, m);
+  const float3 corner = EXP::MATH::transformPoint(m, {1.0f, 0.0f, 1.0f});
+  ASSERT_TRUE(box.contains({EXP::MATH::p3(corner), EXP::MATH::p3(corner)}));
+  ASSERT_TRUE(TlasBuilder::transform(Renderer::Host::Aabb(), m).empty());
+}
+
+
+TEST(INSTANCE, Scene0) {
+  // Two meshes, twelve instances of them scattered, rotated and scaled
+  const std::vector<packed3> a = triangles(400, 1), b = triangles(250, 2);
+  std::vector<uint32_t> indicesA(a.size()), indicesB(b.size());
+  for (uint32_t i = 0; i < indicesA.size(); i++) indicesA[i] = i;
+  for (uint32_t i = 0; i < indicesB.size(); i++) indicesB[i] = i;
+  Bvh blasA, blasB;
+  BvhBuilder::binnedSah({geometry(a, indicesA)}, blasA);
+  BvhBuilder::binnedSah({geometry(b, indicesB)}, blasB);
+  Bvh8 wideA, wideB;
+  Renderer::Host::WideBuilder::collapse(blasA, wideA);
+  Renderer::Host::WideBuilder::collapse(blasB, wideB);
+
+  std::mt19937 random(4);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::vector<Instance> instances(12);
+  for (uint32_t i = 0; i < instances.size(); i++) {
+    instances[i].transformationMatrix =
+      transform({unit(random), unit(random), unit(random)}, 3.0f * unit(random), 1.0f + 0.5f * unit(random), {4.0f * unit(random), 4.0f * unit(random), 4.0f * unit(random)});
+    instances[i].accelerationStructureIndex = i % 2;
+    instances[i].mask = i < 6 ? 0x01 : 0x02;
+  }
+  Tlas<Bvh> tlas;
+  Tlas<Bvh8> wideTlas;
+  const Renderer::Host::BvhReport report = TlasBuilder::build(instances, {&blasA, &blasB}, tlas);
+  TlasBuilder::build(instances, {&wideA, &wideB}, wideTlas);
+  ASSERT_EQ(report.leaves, 12);
+  ASSERT_EQ(report.nodes, 23);
+
+  // Every instance's triangles moved to world space, in one flat BVH: geometry g is instance g
+  std::vector<packed3> world;
+  std::vector<std::vector<uint32_t>> worldIndices(instances.size());
+  std::vector<BvhGeometry> geometries;
+  for (uint32_t i = 0; i < instances.size(); i++) {
+    for (const packed3& p : i % 2 ? b : a) {
+      worldIndices[i].push_back((uint32_t)world.size());
+      world.push_back(EXP::MATH::p3(EXP::MATH::transformPoint(instances[i].transformationMatrix, EXP::MATH::f3(p))));
+    }
+  }
+  for (uint32_t i = 0; i < instances.size(); i++) geometries.push_back(geometry(world, worldIndices[i]));
+  Bvh flat;
+  BvhBuilder::binnedSah(geometries, flat);
+
+  int hits = 0;
+  for (int r = 0; r < 2000; r++) {
+    BvhRay ray;
+    ray.origin = {6.0f * unit(random), 6.0f * unit(random), 6.0f * unit(random)};
+    // Through one of the instances, whose triangles are sparse enough that most rays pass between them
+    const float3 target = EXP::MATH::transformPoint(instances[r % 12].transformationMatrix, float3{0.5f, 0.5f, 0.5f} + float3{unit(random), unit(random), unit(random)} * 0.4f);
+    ray.direction = EXP::MATH::p3(target - EXP::MATH::f3(ray.origin));
+    BvhHit expected, hit, wideHit;
+    const bool found = flat.intersect(ray, expected);
+    ASSERT_EQ(tlas.intersect(ray, hit), found) << r;
+    ASSERT_EQ(wideTlas.intersect(ray, wideHit), found) << r;
+    if (!found) continue;
+    hits++;
+    ASSERT_EQ(hit.instance, expected.geometry) << r;
+    ASSERT_EQ(hit.primitive, expected.primitive - flat.geometryFirst[expected.geometry]) << r;
+    ASSERT_EQ(hit.geometry, 0) << r;
+    ASSERT_NEAR(hit.t, expected.t, 1e-4f * expected.t) << r;
+    ASSERT_EQ(wideHit.instance, hit.instance) << r;
+    ASSERT_EQ(wideHit.t, hit.t) << r;
+
+    // Masks pick one half of the instances or the other
+    BvhHit masked;
+    if (tlas.intersect(ray, masked, hit.instance < 6 ? 0x01 : 0x02)) {
+      ASSERT_EQ(masked.instance, hit.instance) << r;
+    }
+    if (tlas.intersect(ray, masked, hit.instance < 6 ? 0x02 : 0x01)) {
+      ASSERT_NE(masked.instance < 6, hit.instance < 6) << r;
+      ASSERT_GE(masked.t, hit.t) << r;
+    }
+    ASSERT_FALSE(tlas.intersect(ray, masked, 0x00)) << r;
+  }
+  ASSERT_GT(hits, 250);
+}
+
+
+TEST(INSTANCE, Axis0) {
+  // Unit triangles in the planes of an integer grid, instanced at integer offsets: instance boxes,
+  // and the top level nodes around them, sit on integer planes
+  std::mt19937 random(6);
+  std::uniform_int_distribution<int> cell(0, 3), axis(0, 2), side(0, 1);
+  std::vector<packed3> vertices;
+  for (uint32_t t = 0; t < 300; t++) {
+    const int a = axis(random), b = (a + 1) % 3, c = (a + 2) % 3;
+    const float corner[3] = {(float)cell(random), (float)cell(random), (float)cell(random)};
+    for (int k = 0; k < 3; k++) {
+      float p[3] = {corner[0], corner[1], corner[2]};
+      if (k == 1) p[b] += 1.0f;
+      if (k == 2) p[c] += 1.0f;
+      vertices.push_back({p[0], p[1], p[2]});
+    }
+  }
+  std::vector<uint32_t> indices(vertices.size());
+  for (uint32_t i = 0; i < indices.size(); i++) indices[i] = i;
+  Bvh blas;
+  BvhBuilder::binnedSah({geometry(vertices, indices)}, blas);
+  Bvh8 wide;
+  Renderer::Host::WideBuilder::collapse(blas, wide);
+
+  std::vector<Instance> instances(8);
+  for (uint32_t i = 0; i < instances.size(); i++) {
+    instances[i].transformationMatrix = transform({0.0f, 0.0f, 1.0f}, 0.0f, 1.0f, {4.0f * (i % 2), 4.0f * (i / 2 % 2), 4.0f * (i / 4)});
+  }
+  Tlas<Bvh> tlas;
+  Tlas<Bvh8> wideTlas;
+  TlasBuilder::build(instances, {&blas}, tlas);
+  TlasBuilder::build(instances, {&wide}, wideTlas);
+
+  // Along an axis, the other coordinates on the planes of an instance's box; every instance tried
+  // on its own is the reference
+  int hits = 0;
+  for (int r = 0; r < 4000; r++) {
+    const Renderer::Host::Aabb box = tlas.bvh.nodes[0].bounds();
+    const BvhNode& leaf = tlas.bvh.nodes[std::uniform_int_distribution<size_t>(0, tlas.bvh.nodes.size() - 1)(random)];
+    const int a = axis(random);
+    BvhRay ray;
+    for (int k = 0; k < 3; k++) ray.origin[k] = side(random) ? leaf.min[k] : leaf.max[k], ray.direction[k] = 0.0f;
+    const bool forward = side(random);
+    ray.origin[a] = forward ? box.min[a] - 1.0f : box.max[a] + 1.0f;
+    ray.direction[a] = forward ? 1.0f : -1.0f;
+
+    BvhHit expected;
+    for (uint32_t i = 0; i < instances.size(); i++) {
+      BvhRay local = ray;
+      local.origin = EXP::MATH::p3(EXP::MATH::transformPoint(tlas.inverses[i], EXP::MATH::f3(ray.origin)));
+      local.tmax = expected.t;
+      BvhHit candidate;
+      if (blas.intersect(local, candidate)) expected = candidate;
+    }
+    const bool found = expected.t < INFINITY;
+    BvhHit hit, wideHit;
+    ASSERT_EQ(tlas.intersect(ray, hit), found) << r;
+    ASSERT_EQ(wideTlas.intersect(ray, wideHit), found) << r;
+    ASSERT_EQ(tlas.occluded(ray), found) << r;
+    ASSERT_EQ(wideTlas.occluded(ray), found) << r;
+    if (!found) continue;
+    hits++;
+    ASSERT_EQ(hit.t, expected.t) << r;
+    ASSERT_EQ(wideHit.t, expected.t) << r;
+  }
+  ASSERT_GT(hits, 1000);
+}
+
+
+TEST(INSTANCE, Occluded0) {
+  // Scene0's instances over binary, wide and quantized wide bottom levels
+  const std::vector<packed3> a = triangles(400, 1), b = triangles(250, 2);
+  std::vector<uint32_t> indicesA(a.size()), indicesB(b.size());
+  for (uint32_t i = 0; i < indicesA.size(); i++) indicesA[i] = i;
+  for (uint32_t i = 0; i < indicesB.size(); i++) indicesB[i] = i;
+  Bvh blasA, blasB;
+  BvhBuilder::binnedSah({geometry(a, indicesA)}, blasA);
+  BvhBuilder::binnedSah({geometry(b, indicesB)}, blasB);
+  Renderer::Host::WideSettings quantized;
+  quantized.quantized = true;
+  Bvh8 wideA, wideB, packedA, packedB;
+  Renderer::Host::WideBuilder::collapse(blasA, wideA);
+  Renderer::Host::WideBuilder::collapse(blasB, wideB);
+  Renderer::Host::WideBuilder::collapse(blasA, packedA, quantized);
+  Renderer::Host::WideBuilder::collapse(blasB, packedB, quantized);
+  ASSERT_TRUE(packedA.isQuantized());
+
+  std::mt19937 random(4);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::vector<Instance> instances(12);
+  for (uint32_t i = 0; i < instances.size(); i++) {
+    instances[i].transformationMatrix =
+      transform({unit(random), unit(random), unit(random)}, 3.0f * unit(random), 1.0f + 0.5f * unit(random), {4.0f * unit(random), 4.0f * unit(random), 4.0f * unit(random)});
+    instances[i].accelerationStructureIndex = i % 2;
+    instances[i].mask = i < 6 ? 0x01 : 0x02;
+  }
+  Tlas<Bvh> tlas;
+  Tlas<Bvh8> wideTlas, packedTlas;
+  TlasBuilder::build(instances, {&blasA, &blasB}, tlas);
+  TlasBuilder::build(instances, {&wideA, &wideB}, wideTlas);
+  TlasBuilder::build(instances, {&packedA, &packedB}, packedTlas);
+
+  // Blocked exactly when a closest hit lies in range, with no more work to find out
+  int blocked = 0, clear = 0;
+  BvhCounters closest, any, wideClosest, wideAny;
+  for (int r = 0; r < 2000; r++) {
+    BvhRay ray;
+    ray.origin = {6.0f * unit(random), 6.0f * unit(random), 6.0f * unit(random)};
+    const float3 target = EXP::MATH::transformPoint(instances[r % 12].transformationMatrix, float3{0.5f, 0.5f, 0.5f} + float3{unit(random), unit(random), unit(random)} * 0.4f);
+    ray.direction = EXP::MATH::p3(target - EXP::MATH::f3(ray.origin));
+    // Short of the target for a third of them, as a shadow ray stops short of its light
+    if (r % 3 == 0) ray.tmax = 0.5f + 0.5f * unit(random);
+    if (r % 5 == 0) ray.tmin = 0.25f;
+    const uint32_t mask = r % 4 == 0 ? 0x01 : 0xFF;
+    BvhHit hit;
+    const bool found = tlas.intersect(ray, hit, mask, &closest);
+    ASSERT_EQ(tlas.occluded(ray, mask, &any), found) << r;
+    wideTlas.intersect(ray, hit, mask, &wideClosest);
+    ASSERT_EQ(wideTlas.occluded(ray, mask, &wideAny), found) << r;
+    ASSERT_EQ(packedTlas.occluded(ray, mask), found) << r;
+    ASSERT_FALSE(tlas.occluded(ray, 0x00)) << r;
+    ASSERT_FALSE(wideTlas.occluded(ray, 0x00)) << r;
+    found ? blocked++ : clear++;
+  }
+  ASSERT_GT(blocked, 250);
+  ASSERT_GT(clear, 250);
+  ASSERT_LT(any.triangles, closest.triangles);
+  ASSERT_LE(any.nodes, closest.nodes);
+  ASSERT_LT(wideAny.triangles, wideClosest.triangles);
+  ASSERT_LE(wideAny.nodes, wideClosest.nodes);
+
+  // Nothing in an empty range, nor in an empty structure
+  BvhRay ray;
+  ray.origin = {0.0f, 0.0f, 0.0f};
+  ray.direction = {1.0f, 0.0f, 0.0f};
+  ray.tmin = ray.tmax = 1.0f;
+  ASSERT_FALSE(tlas.occluded(ray));
+  ASSERT_FALSE(Tlas<Bvh>().occluded(ray));
+  ASSERT_FALSE(Bvh().occluded(ray));
+}
+
+
+TEST(INSTANCE, Excluded0) {
+  const std::vector<packed3> a = triangles(50, 3);
+  std::vector<uint32_t> indices(a.size());
+  for (uint32_t i = 0; i < indices.size(); i++) indices[i] = i;
+  Bvh blas, empty;
+  BvhBuilder::binnedSah({geometry(a, indices)}, blas);
+
+  // Singular transform, missing structure, empty structure, hidden by its mask; one left to hit
+  std::vector<Instance> instances(5);
+  instances[0].transformationMatrix.columns[1] = {0.0f, 0.0f, 0.0f};
+  instances[1].accelerationStructureIndex = 7;
+  instances[2].accelerationStructureIndex = 1;
+  instances[3].mask = 0x00;
+  instances[4].transformationMatrix.columns[3] = {10.0f, 0.0f, 0.0f};
+  Tlas<Bvh> tlas;
+  const Renderer::Host::BvhReport report = TlasBuilder::build(instances, {&blas, &empty}, tlas);
+  ASSERT_EQ(report.leaves, 2);
+
+  BvhRay ray;
+  ray.origin = {10.5f, 0.5f, -5.0f};
+  ray.direction = {0.0f, 0.0f, 1.0f};
+  BvhHit hit;
+  BvhHit expected;
+  ray.origin.x -= 10.0f;
+  const bool found = blas.intersect(ray, expected);
+  ray.origin.x += 10.0f;
+  ASSERT_EQ(tlas.intersect(ray, hit), found);
+  if (found) {
+    ASSERT_EQ(hit.instance, 4);
+    ASSERT_EQ(hit.t, expected.t);
+  }
+  ray.origin.x -= 10.0f;
+  ASSERT_FALSE(tlas.intersect(ray, hit));
+
+  Tlas<Bvh> none;
+  ASSERT_EQ(TlasBuilder::build({}, std::vector<const Bvh*>(), none).nodes, 0);
+  ASSERT_FALSE(none.intersect(ray, hit));
+}
+
+
+TEST(INSTANCE, Update0) {
+  const std::vector<packed3> a = triangles(300, 5);
+  std::vector<uint32_t> indices(a.size());
+  for (uint32_t i = 0; i < indices.size(); i++) indices[i] = i;
+  Bvh blas;
+  BvhBuilder::binnedSah({geometry(a, indices)}, blas);
+
+  // A row of instances along x
+  std::vector<Instance> instances(16);
+  for (uint32_t i = 0; i < instances.size(); i++) instances[i].transformationMatrix.columns[3] = {2.0f * i, 0.0f, 0.0f};
+  Tlas<Bvh> tlas;
+  TlasBuilder::build(instances, {&blas}, tlas);
+  ASSERT_EQ(TlasBuilder::update(instances, tlas).action, TlasAction::NONE);
+
+  // A mask change is no move
+  instances[3].mask = 0x02;
+  TlasUpdate update = TlasBuilder::update(instances, tlas);
+  ASSERT_EQ(update.action, TlasAction::NONE);
+  ASSERT_EQ(tlas.instances[3].mask, 0x02);
+
+  // A small move refits, and hits what a fresh build hits
+  instances[5].transformationMatrix.columns[3].y = 0.3f;
+  update = TlasBuilder::update(instances, tlas);
+  ASSERT_EQ(update.action, TlasAction::REFIT);
+  ASSERT_EQ(update.moved, 1);
+  Tlas<Bvh> fresh;
+  TlasBuilder::build(instances, {&blas}, fresh);
+  std::mt19937 random(9);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  int hits = 0;
+  for (int r = 0; r < 500; r++) {
+    BvhRay ray;
+    ray.origin = {32.0f * unit(random), unit(random) + 0.3f * unit(random), -2.0f};
+    ray.direction = {0.2f * (unit(random) - 0.5f), 0.0f, 1.0f};
+    BvhHit hit, expected;
+    const bool found = fresh.intersect(ray, expected);
+    ASSERT_EQ(tlas.intersect(ray, hit), found) << r;
+    if (!found) continue;
+    hits++;
+    ASSERT_EQ(hit.instance, expected.instance) << r;
+    ASSERT_EQ(hit.t, expected.t) << r;
+  }
+  ASSERT_GT(hits, 60);
+
+  // Instances swapping ends of the row make refit boxes overlap: past the ratio, a rebuild
+  std::swap(instances[0].transformationMatrix, instances[15].transformationMatrix);
+  std::swap(instances[1].transformationMatrix, instances[14].transformationMatrix);
+  update = TlasBuilder::update(instances, tlas);
+  ASSERT_EQ(update.action, TlasAction::REBUILD);
+  ASSERT_LE(update.sahCost, tlas.builtSahCost);
+  ASSERT_EQ(TlasBuilder::update(instances, tlas).action, TlasAction::NONE);
+
+  // So does an instance leaving the tree, and a longer list
+  instances[7].transformationMatrix.columns[0] = {0.0f, 0.0f, 0.0f};
+  ASSERT_EQ(TlasBuilder::update(instances, tlas).action, TlasAction::REBUILD);
+  ASSERT_TRUE(tlas.boxes[7].empty());
+  instances.push_back(Instance());
+  ASSERT_EQ(TlasBuilder::update(instances, tlas).action, TlasAction::REBUILD);
+  ASSERT_EQ(tlas.bvh.primitives.size(), 16);
+
+  // Boxes alone, with no tree below them, keep a top level just as current
+  const Renderer::Host::BlasBounds bounds = {BvhBuilder::bounds({geometry(a, indices)})};
+  for (int axis = 0; axis < 3; axis++) {
+    ASSERT_EQ(bounds.box.min[axis], blas.bounds().min[axis]);
+    ASSERT_EQ(bounds.box.max[axis], blas.bounds().max[axis]);
+  }
+  Tlas<Renderer::Host::BlasBounds> boxTlas;
+  TlasBuilder::build(instances, {&bounds}, boxTlas);
+  for (float y : {0.1f, 5.0f}) {
+    instances[2].transformationMatrix.columns[3].y = y;
+    ASSERT_EQ(TlasBuilder::update(instances, boxTlas).action, TlasBuilder::update(instances, tlas).action);
+    ASSERT_EQ(boxTlas.bvh.nodes.size(), tlas.bvh.nodes.size());
+    for (size_t i = 0; i < instances.size(); i++) {
+      ASSERT_EQ(boxTlas.boxes[i].empty(), tlas.boxes[i].empty()) << i;
+      ASSERT_TRUE(tlas.boxes[i].empty() || !memcmp(&boxTlas.boxes[i], &tlas.boxes[i], sizeof(tlas.boxes[i]))) << i;
+    }
+  }
+}
@@ -0,0 +1,120 @@
+//
+// .expmesh cache: round trip, invalidation and corruption checks.
+//
+#include <gtest/gtest.h>
+#include <DB/MeshCache.hpp>
+#include <DB/ObjRepository.hpp>
+#include <Model/Weld.h>
+#include <Renderer/HostBuffer.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using HostMesh = EXP::MDL::HostMesh;
+using Repository::MeshCache;
+
+// Copies the f16 asset into a scratch directory the test may modify.
+static std::filesystem::path scratchF16(const std::string& name) {
+  const std::filesystem::path directory = std::filesystem::temp_directory_path() / ("explorer_cache_" + name);
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  const std::filesystem::path source = std::filesystem::path(EXPLORER_ASSET_DIR) / "Meshes" / "f16";
+  for (const char* file : {"f16.obj", "f16.mtl", "f16.bmp"}) std::filesystem::copy_file(source / file, directory / file);
+  return directory;
+}
+
+
+TEST(MESHCACHE, RoundTrip0) {
+  const std::filesystem::path directory = scratchF16("roundtrip");
+  const std::string obj = (directory / "f16.obj").string();
+  const std::string cachePath = (directory / "f16.expmesh").string();
+
+  HostMesh mesh;
+  ASSERT_TRUE(Repository::Obj::readMapped(obj, mesh));
+  EXP::MDL::Weld::apply(mesh);
+  const uint64_t hash = MeshCache::hashSources(obj);
+  ASSERT_NE(hash, 0);
+  std::string error;
+  ASSERT_TRUE(MeshCache::write(cachePath, mesh, hash, {3, 4}, &error)) << error;
+  ASSERT_EQ(std::filesystem::file_size(cachePath) % MeshCache::ALIGNMENT, 0);
+
+  MeshCache cache;
+  ASSERT_TRUE(cache.open(cachePath, hash, &error)) << error;
+  ASSERT_EQ(cache.name(), mesh.name);
+  ASSERT_EQ(cache.vertexCount(), mesh.vertexCount());
+  ASSERT_EQ(0, memcmp(cache.vertices(), mesh.vertices.data(), mesh.vertices.size() * sizeof(EXP::MATH::packed3)));
+  ASSERT_EQ(0, memcmp(cache.attributes(), mesh.attributes.data(), mesh.attributes.size() * sizeof(Renderer::Host::VertexAttributes)));
+  ASSERT_EQ(cache.vertexSection().offset % MeshCache::ALIGNMENT, 0);
+  ASSERT_EQ((uintptr_t)cache.vertices() % 4096, 0);
+
+  ASSERT_EQ(cache.submeshes().size(), mesh.submeshes.size());
+  for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+    const Repository::CachedSubmesh& submesh = cache.submeshes()[s];
+    ASSERT_EQ(submesh.material, mesh.submeshes[s].material);
+    ASSERT_EQ(submesh.texindex, (int)s + 3);
+    ASSERT_EQ(std::vector<uint32_t>(submesh.indices, submesh.indices + submesh.indexCount), mesh.submeshes[s].indices);
+
+    // Precomputed primitives match what the upload would build
+    std::vector<Renderer::Host::PrimitiveAttributes> expected(submesh.triangleCount());
+    Renderer::Host::Buffer::perPrimitive(mesh.attributes.data(), mesh.submeshes[s].indices.data(), submesh.indexCount, (int)s + 3, expected.data());
+    ASSERT_EQ(0, memcmp(submesh.primitives, expected.data(), expected.size() * sizeof(expected[0])));
+  }
+
+  ASSERT_EQ(cache.materials().size(), mesh.materials.size());
+  for (size_t m = 0; m < mesh.materials.size(); m++) {
+    ASSERT_EQ(cache.materials()[m].name, mesh.materials[m].name);
+    ASSERT_EQ(cache.materials()[m].diffuseTexture, mesh.materials[m].diffuseTexture);
+    ASSERT_EQ(cache.materials()[m].diffuse.x, mesh.materials[m].diffuse.x);
+  }
+
+  // Copy on write: patching the mapping never reaches the file
+  cache.submeshes()[0].primitives[0].flags.x = 77;
+  MeshCache second;
+  ASSERT_TRUE(second.open(cachePath, hash));
+  ASSERT_EQ(second.submeshes()[0].primitives[0].flags.x, 3);
+}
+
+
+TEST(MESHCACHE, Invalidation0) {
+  const std::filesystem::path directory = scratchF16("invalidation");
+  const std::string obj = (directory / "f16.obj").string();
+  const std::string cachePath = (directory / "f16.expmesh").string();
+
+  HostMesh mesh;
+  ASSERT_TRUE(Repository::Obj::read(obj, mesh));
+  const uint64_t hash = MeshCache::hashSources(obj);
+  ASSERT_TRUE(MeshCache::write(cachePath, mesh, hash));
+
+  // Editing the MTL changes the source hash; the cache no longer opens with it
+  std::ofstream(directory / "f16.mtl", std::ios::app) << "\n# edited\n";
+  const uint64_t edited = MeshCache::hashSources(obj);
+  ASSERT_NE(edited, hash);
+  MeshCache cache;
+  std::string error;
+  ASSERT_FALSE(cache.open(cachePath, edited, &error));
+  ASSERT_NE(error.find("stale"), std::string::npos);
+
+  std::ofstream(obj, std::ios::app) << "# edited\n";
+  ASSERT_NE(MeshCache::hashSources(obj), edited);
+  ASSERT_EQ(MeshCache::hashSources((directory / "missing.obj").string()), 0);
+}
+
+
+TEST(MESHCACHE, Corrupt0) {
+  const std::filesystem::path directory = scratchF16("corrupt");
+  const std::string obj = (directory / "f16.obj").string();
+  const std::string cachePath = (directory / "f16.expmesh").string();
+
+  HostMesh mesh;
+  ASSERT_TRUE(Repository::Obj::read(obj, mesh));
+  ASSERT_TRUE(MeshCache::write(cachePath, mesh, 42));
+
+  MeshCache cache;
+  std::filesystem::resize_file(cachePath, std::filesystem::file_size(cachePath) - MeshCache::ALIGNMENT);
+  ASSERT_FALSE(cache.open(cachePath, 42));
+  ASSERT_FALSE(cache.isOpen());
+
+  std::ofstream(cachePath, std::ios::binary | std::ios::trunc) << "not a mesh";
+  ASSERT_FALSE(cache.open(cachePath, 42));
+  ASSERT_FALSE(cache.open((directory / "missing.expmesh").string(), 42));
+}
@@ -0,0 +1,143 @@
+//
+// Portable OBJ reader: runs headless, no Metal required.
+//
+#include <gtest/gtest.h>
+#include <DB/ObjRepository.hpp>
+#include <cstring>
+
+using HostMesh = EXP::MDL::HostMesh;
+
+static bool parseText(const std::string& text, HostMesh& mesh) {
+  return Repository::Obj::parse(text.data(), text.data() + text.size(), "", mesh);
+}
+
+
+TEST(OBJ, Quad0) {
+  // A quad is fan triangulated; shared corners are emitted once.
+  const std::string text =
+    "# quad\n"
+    "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+    "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+    "vn 0 0 1\n"
+    "f 1/1/1 2/2/1 3/3/1 4/4/1\n";
+  HostMesh mesh;
+  ASSERT_TRUE(parseText(text, mesh));
+  ASSERT_EQ(mesh.submeshes.size(), 1);
+  ASSERT_EQ(mesh.vertexCount(), 4);
+  ASSERT_EQ(mesh.triangleCount(), 2);
+  std::vector<uint32_t> expected = {0, 1, 2, 0, 2, 3};
+  ASSERT_EQ(mesh.submeshes[0].indices, expected);
+  ASSERT_FLOAT_EQ(mesh.attributes[2].texture.x, 1.0f);
+  ASSERT_FLOAT_EQ(mesh.attributes[2].normal.z, 1.0f);
+}
+
+
+TEST(OBJ, NegativeIndices0) {
+  const std::string text =
+    "v 0 0 0\r\nv 1 0 0\r\nv 0 1 0\r\n"
+    "f -3 -2 -1\r\n";
+  HostMesh mesh;
+  ASSERT_TRUE(parseText(text, mesh));
+  ASSERT_EQ(mesh.triangleCount(), 1);
+  ASSERT_FLOAT_EQ(mesh.vertices[1].x, 1.0f);
+  // No normals in file: generated from the face
+  ASSERT_FLOAT_EQ(mesh.attributes[0].normal.z, 1.0f);
+}
+
+
+TEST(OBJ, Materials0) {
+  // One submesh per material; the same position with different uvs becomes two vertices.
+  const std::string text =
+    "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+    "vt 0 0\nvt 1 1\n"
+    "usemtl a\nf 1/1 2/1 3/1\n"
+    "usemtl b\nf 1/2 2/2 3/2\n"
+    "usemtl a\nf 3/1 2/1 1/1\n";
+  HostMesh mesh;
+  ASSERT_TRUE(parseText(text, mesh));
+  ASSERT_EQ(mesh.submeshes.size(), 2);
+  ASSERT_EQ(mesh.submeshes[0].indices.size(), 6);
+  ASSERT_EQ(mesh.submeshes[1].indices.size(), 3);
+  ASSERT_EQ(mesh.vertexCount(), 6);
+  ASSERT_EQ(mesh.materials[mesh.submeshes[1].material].name, "b");
+}
+
+
+TEST(OBJ, Floats0) {
+  const std::string text = "v -1.5e2 +0.000001 3\nv .25 1E-3 -0\nv 0.905208 -0.054739 -0.000000\nf 1 2 3\n";
+  HostMesh mesh;
+  ASSERT_TRUE(parseText(text, mesh));
+  ASSERT_EQ(mesh.vertices[0].x, -150.0f);
+  ASSERT_EQ(mesh.vertices[0].y, 0.000001f);
+  ASSERT_EQ(mesh.vertices[1].x, 0.25f);
+  ASSERT_EQ(mesh.vertices[1].y, 0.001f);
+  ASSERT_EQ(mesh.vertices[2].x, 0.905208f);
+  ASSERT_EQ(mesh.vertices[2].y, -0.054739f);
+}
+
+
+TEST(OBJ, F16) {
+  HostMesh mesh;
+  std::string error;
+  ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/f16/f16.obj", mesh, &error)) << error;
+  ASSERT_EQ(mesh.submeshes.size(), 2);
+  ASSERT_EQ(mesh.triangleCount(), 4056);
+  ASSERT_EQ(mesh.materials.size(), 2);
+  ASSERT_NE(mesh.materials[0].diffuseTexture.find("f16.bmp"), std::string::npos);
+  std::cout << "f16 vertices: " << mesh.vertexCount() << ", bytes: " << mesh.bytes() << std::endl;
+}
+
+
+TEST(OBJ, Chunks0) {
+  // Chunked tokenizing gives the same mesh as one pass, relative indices and materials included.
+  std::string text = "mtllib none.mtl\n";
+  for (int row = 0; row < 40; row++) {
+    for (int col = 0; col < 40; col++) {
+      text += "v " + std::to_string(col * 0.25) + " " + std::to_string(row * 0.5) + " 0.125\n";
+      text += "vt " + std::to_string(col / 40.0) + " " + std::to_string(row / 40.0) + "\n";
+    }
+  }
+  text += "vn 0 0 1\n";
+  for (int row = 0; row < 39; row++) {
+    if (row % 10 == 0) text += "usemtl m" + std::to_string(row % 20) + "\n";
+    for (int col = 0; col < 39; col++) {
+      int a = row * 40 + col + 1, b = a + 1, c = a + 41, d = a + 40;
+      if (col % 2) {
+        text += "f " + std::to_string(a) + "/" + std::to_string(a) + "/1 " + std::to_string(b) + "/" + std::to_string(b) +
+                "/1 " + std::to_string(c) + "/" + std::to_string(c) + "/1 " + std::to_string(d) + "/" + std::to_string(d) + "/1\n";
+      } else {
+        text += "v 9 9 9\nf -1 " + std::to_string(a) + "//1 " + std::to_string(b) + "//1\n";
+      }
+    }
+  }
+
+  HostMesh reference;
+  ASSERT_TRUE(parseText(text, reference));
+
+  for (size_t chunkCount : {2, 7, 31}) {
+    auto ranges = Repository::Obj::split(text.data(), text.data() + text.size(), chunkCount);
+    std::vector<Repository::ObjRecords> chunks(ranges.size());
+    for (size_t c = 0; c < ranges.size(); c++) {
+      Repository::Obj::tokenize(text.data() + ranges[c].first, text.data() + ranges[c].second, chunks[c]);
+    }
+    HostMesh mesh;
+    ASSERT_TRUE(Repository::Obj::build(chunks, "", mesh, nullptr, 3));
+    ASSERT_EQ(mesh.vertexCount(), reference.vertexCount());
+    ASSERT_EQ(mesh.submeshes.size(), reference.submeshes.size());
+    ASSERT_EQ(0, memcmp(mesh.vertices.data(), reference.vertices.data(), mesh.vertices.size() * sizeof(EXP::MATH::packed3)));
+    for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+      ASSERT_EQ(mesh.submeshes[s].indices, reference.submeshes[s].indices);
+      ASSERT_EQ(mesh.submeshes[s].material, reference.submeshes[s].material);
+    }
+  }
+}
+
+
+TEST(OBJ, Mapped0) {
+  const std::string path = std::string(EXPLORER_ASSET_DIR) + "/Meshes/sphere/sphere.obj";
+  HostMesh reference, mesh;
+  ASSERT_TRUE(Repository::Obj::read(path, reference));
+  ASSERT_TRUE(Repository::Obj::readMapped(path, mesh, 4));
+  ASSERT_EQ(mesh.triangleCount(), reference.triangleCount());
+  ASSERT_EQ(mesh.submeshes[0].indices, reference.submeshes[0].indices);
+}
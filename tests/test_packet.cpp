@@ -0,0 +1,174 @@
+//
+// Ray packets over the showcase scene: primary rays in 8 and 16 ray packets on every instruction set
+// find the hits Tlas::intersect finds, also along an axis, incoherent rays fall back to single rays,
+// and partial packets, ray extents and instance masks are honoured.
+//
+#include <gtest/gtest.h>
+#include <DB/SceneRepository.hpp>
+#include <Renderer/HostCamera.h>
+#include <Renderer/HostPacket.h>
+#include <random>
+
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhRay;
+using Renderer::Host::PacketIsa;
+using Renderer::Host::PacketSettings;
+using Renderer::Host::PacketStats;
+using Renderer::Host::PacketTracer;
+
+static const std::string MESHES = std::string(EXPLORER_ASSET_DIR) + "/Meshes";
+
+// Same triangle of the same instance, or both missing; a fused multiply-add may move t by a few ulps,
+// and a ray grazing an edge shared by two triangles may pick either
+static size_t mismatches(const std::vector<BvhHit>& hits, const std::vector<BvhHit>& expected) {
+  size_t result = 0;
+  for (size_t i = 0; i < hits.size(); i++) {
+    const BvhHit& a = hits[i];
+    const BvhHit& b = expected[i];
+    const bool same = a.t == INFINITY ? b.t == INFINITY
+                                      : a.instance == b.instance && a.primitive == b.primitive && a.geometry == b.geometry &&
+                                          std::fabs(a.t - b.t) <= 1e-4f * std::max(1.0f, b.t);
+    result += !same;
+  }
+  return result;
+}
+
+static std::vector<PacketIsa> isas() {
+  std::vector<PacketIsa> result;
+  for (PacketIsa isa : {PacketIsa::SCALAR, PacketIsa::BASELINE, PacketIsa::AVX2, PacketIsa::AVX512}) {
+    if (PacketTracer::supported(isa)) result.push_back(isa);
+  }
+  return result;
+}
+
+
+TEST(PACKET, Primary0) {
+  Repository::HostScene scene;
+  std::string error;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(MESHES), scene, "", &error)) << error;
+  const uint32_t width = 200, height = 112;
+  const Renderer::Host::VCamera camera = Renderer::Host::isometricCamera(width, height);
+
+  std::vector<BvhHit> expected((size_t)width * height);
+  size_t hit = 0;
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) hit += scene.tlas.intersect(Renderer::Host::primaryRay(camera, x, y), expected[(size_t)y * width + x]);
+  }
+  ASSERT_GT(hit, width * height / 20);
+
+  ASSERT_TRUE(PacketTracer::supported(PacketIsa::SCALAR));
+  ASSERT_TRUE(PacketTracer::supported(PacketIsa::BASELINE));
+  for (PacketIsa isa : isas()) {
+    for (uint32_t lanes : {8u, 16u}) {
+      PacketSettings settings;
+      settings.width = lanes;
+      std::vector<BvhHit> hits;
+      const PacketStats stats = PacketTracer::primary(scene.tlas, camera, hits, settings, isa);
+      ASSERT_EQ(hits.size(), expected.size());
+      ASSERT_LE(mismatches(hits, expected), hits.size() / 1000) << PacketTracer::name(isa) << " " << lanes;
+      ASSERT_EQ(stats.rays, (uint64_t)width * height);
+      ASSERT_NEAR((double)stats.hits, (double)hit, hit / 1000.0);
+      if (isa == PacketIsa::SCALAR) {
+        ASSERT_EQ(stats.singleRays, stats.rays);
+        continue;
+      }
+      // Parallel rays never diverge; 200 x 112 in 16 pixel tiles leaves only whole blocks
+      ASSERT_EQ(stats.singleRays, 0);
+      ASSERT_EQ(stats.packets, stats.rays / lanes);
+      ASSERT_GT(stats.culled, 0);
+      ASSERT_GT(stats.laneTests, 0);
+    }
+  }
+
+  // Threads only change who traces a tile
+  PacketSettings one;
+  one.threads = 1;
+  std::vector<BvhHit> serial, parallel;
+  EXP::THREAD::Pool pool(4);
+  PacketTracer::primary(scene.tlas, camera, serial, one, pool);
+  PacketTracer::primary(scene.tlas, camera, parallel, {}, pool);
+  ASSERT_EQ(mismatches(serial, parallel), 0);
+}
+
+
+TEST(PACKET, Axis0) {
+  // The app camera's starting view: straight down -z, so every ray has 0 x and y components
+  Repository::HostScene scene;
+  std::string error;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(MESHES), scene, "", &error)) << error;
+  const uint32_t width = 160, height = 96;
+  Renderer::Host::VCamera camera = Renderer::Host::isometricCamera(width, height);
+  camera.vecForward = {0.0f, 0.0f, -1.0f};
+  camera.vecRight = {1.0f, 0.0f, 0.0f};
+  camera.vecUp = {0.0f, 1.0f, 0.0f};
+  camera = Renderer::Host::frameCamera(camera, scene.tlas.bvh.bounds());
+
+  std::vector<BvhHit> expected((size_t)width * height);
+  size_t hit = 0;
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) hit += scene.tlas.intersect(Renderer::Host::primaryRay(camera, x, y), expected[(size_t)y * width + x]);
+  }
+  ASSERT_GT(hit, width * height / 40);
+
+  for (PacketIsa isa : isas()) {
+    if (isa == PacketIsa::SCALAR) continue;
+    for (uint32_t lanes : {8u, 16u}) {
+      PacketSettings settings;
+      settings.width = lanes;
+      std::vector<BvhHit> hits;
+      const PacketStats stats = PacketTracer::primary(scene.tlas, camera, hits, settings, isa);
+      ASSERT_LE(mismatches(hits, expected), hits.size() / 1000) << PacketTracer::name(isa) << " " << lanes;
+      ASSERT_EQ(stats.singleRays, 0) << PacketTracer::name(isa) << " " << lanes;
+      ASSERT_GT(stats.culled, 0);
+    }
+  }
+}
+
+
+TEST(PACKET, Diverge0) {
+  Repository::HostScene scene;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(MESHES), scene));
+  const Renderer::Host::Aabb bounds = scene.tlas.bvh.bounds();
+  const EXP::MATH::float3 center = (EXP::MATH::f3(bounds.min) + EXP::MATH::f3(bounds.max)) * 0.5f;
+
+  // Rays from all around the scene towards its middle, then a coherent bundle: 1001 of each, so the
+  // last packet is partial
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::vector<BvhRay> rays(2002);
+  for (size_t i = 0; i < 1001; i++) {
+    const EXP::MATH::float3 direction = EXP::MATH::normalize({unit(random), unit(random), unit(random)});
+    rays[i].origin = EXP::MATH::p3(center + direction * 3.0f);
+    rays[i].direction = EXP::MATH::p3(direction * -1.0f + EXP::MATH::float3{unit(random), unit(random), unit(random)} * 0.2f);
+  }
+  for (size_t i = 1001; i < rays.size(); i++) {
+    rays[i].origin = EXP::MATH::p3(center + EXP::MATH::float3{unit(random) * 0.5f, 3.0f, unit(random) * 0.5f});
+    rays[i].direction = {0.05f, -1.0f, 0.02f};
+    rays[i].tmax = i % 3 == 0 ? 2.5f : INFINITY;
+  }
+  std::vector<BvhHit> expected(rays.size());
+  for (size_t i = 0; i < rays.size(); i++) scene.tlas.intersect(rays[i], expected[i]);
+
+  for (PacketIsa isa : isas()) {
+    for (uint32_t lanes : {8u, 16u}) {
+      PacketSettings settings;
+      settings.width = lanes;
+      std::vector<BvhHit> hits(rays.size());
+      const PacketStats stats = PacketTracer::intersect(scene.tlas, rays.data(), rays.size(), hits.data(), settings, isa);
+      ASSERT_LE(mismatches(hits, expected), 2) << PacketTracer::name(isa) << " " << lanes;
+      ASSERT_EQ(stats.packets, (rays.size() + lanes - 1) / lanes);
+      if (isa != PacketIsa::SCALAR) {
+        ASSERT_GE(stats.singleRays, 1001 / lanes * lanes);
+        ASSERT_LT(stats.singleRays, 1001 + lanes);
+      }
+    }
+  }
+
+  // No instance shares a bit with the mask
+  PacketSettings none;
+  none.mask = 0;
+  std::vector<BvhHit> hits(rays.size());
+  const PacketStats stats = PacketTracer::intersect(scene.tlas, rays.data() + 1001, 1001, hits.data(), none);
+  ASSERT_EQ(stats.hits, 0);
+  for (size_t i = 0; i < 1001; i++) ASSERT_EQ(hits[i].t, INFINITY);
+}
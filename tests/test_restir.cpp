@@ -0,0 +1,161 @@
+//
+// CPU temporal_reuse: texture sampling, the showcase scene rendered the same on any thread count,
+// reservoirs carried between frames, lights seen directly, and the ground plane under an empty scene.
+//
+#include <gtest/gtest.h>
+#include <DB/SceneRepository.hpp>
+#include <Renderer/HostMipmap.h>
+
+using EXP::MATH::float4;
+using Renderer::Host::Image;
+using Renderer::Host::PixelFormat;
+using Renderer::Host::RestirRenderer;
+using Renderer::Host::RestirStats;
+
+static const std::string MESHES = std::string(EXPLORER_ASSET_DIR) + "/Meshes";
+
+
+TEST(RESTIR, Sample0) {
+  Image texture;
+  texture.allocate(2, 2, PixelFormat::RGBA8_UNORM);
+  const uint8_t texels[16] = {0, 0, 0, 255, 255, 0, 0, 255, 0, 255, 0, 255, 0, 0, 255, 255};
+  std::copy(texels, texels + 16, texture.data.begin());
+
+  // Texel centers, the middle of all four, and clamped to the edge outside
+  float4 value = RestirRenderer::sample(texture, {0.75f, 0.25f});
+  ASSERT_FLOAT_EQ(value.x, 1.0f);
+  ASSERT_FLOAT_EQ(value.y, 0.0f);
+  value = RestirRenderer::sample(texture, {0.5f, 0.5f});
+  ASSERT_FLOAT_EQ(value.x, 0.25f);
+  ASSERT_FLOAT_EQ(value.y, 0.25f);
+  ASSERT_FLOAT_EQ(value.z, 0.25f);
+  ASSERT_FLOAT_EQ(value.w, 1.0f);
+  value = RestirRenderer::sample(texture, {-3.0f, 7.0f});
+  ASSERT_FLOAT_EQ(value.y, 1.0f);
+
+  // sRGB texels come back linear, a missing texture as 0
+  texture.format = PixelFormat::RGBA8_SRGB;
+  ASSERT_FLOAT_EQ(RestirRenderer::sample(texture, {0.75f, 0.25f}).x, Renderer::Host::Mipmap::toLinear(255));
+  ASSERT_FLOAT_EQ(RestirRenderer::sample(texture, {0.5f, 0.5f}).x, 0.25f);
+  ASSERT_FLOAT_EQ(RestirRenderer::sample(Image(), {0.5f, 0.5f}).w, 0.0f);
+}
+
+
+TEST(RESTIR, Showcase0) {
+  Repository::HostScene scene;
+  std::string error;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(MESHES), scene, "", &error)) << error;
+  ASSERT_EQ(scene.restir.primitives.size(), 3);
+  ASSERT_EQ(scene.restir.light.vertices.size(), scene.meshes[1].vertexCount());
+  ASSERT_EQ(scene.restir.primitives[1][0].flags.y, 1);
+  scene.restir.camera = Renderer::Host::isometricCamera(96, 52);
+
+  RestirRenderer serial, parallel;
+  Image one, all;
+  Renderer::Host::RestirSettings settings;
+  settings.threads = 1;
+  const RestirStats stats = serial.render(scene.restir, one, settings);
+  parallel.render(scene.restir, all);
+  ASSERT_EQ(one.format, PixelFormat::RGBA8_SRGB);
+  ASSERT_EQ(one.data, all.data);
+  ASSERT_EQ(stats.pixels, 96 * 52);
+  ASSERT_EQ(stats.primaryRays, stats.pixels);
+  ASSERT_GT(stats.shadowRays, stats.pixels);
+  ASSERT_GT(stats.raysPerSecond(), 0.0);
+  ASSERT_EQ(stats.tiles.tiles, 6 * 4);
+  ASSERT_EQ(stats.tiles.workers.size(), 1);
+
+  // Row bands and odd tile sizes shade the same pixels
+  for (uint32_t size : {7u, 64u}) {
+    RestirRenderer other;
+    Image image;
+    Renderer::Host::RestirSettings tiles;
+    tiles.tiles.size = size;
+    other.render(scene.restir, image, tiles);
+    ASSERT_EQ(image.data, one.data);
+  }
+  {
+    RestirRenderer rows;
+    Image image;
+    Renderer::Host::RestirSettings banded;
+    banded.tiled = false;
+    const RestirStats rowStats = rows.render(scene.restir, image, banded);
+    ASSERT_EQ(image.data, one.data);
+    ASSERT_EQ(rowStats.rays(), stats.rays());
+    ASSERT_EQ(rowStats.tiles.tiles, 0);
+  }
+
+  // The emissive sphere shows its own color, white once clamped
+  size_t white = 0;
+  for (size_t i = 0; i < one.data.size(); i += 4) white += one.data[i] == 255 && one.data[i + 1] == 255 && one.data[i + 2] == 255;
+  ASSERT_GT(white, 20);
+
+  // Shaded pixels resample 32 lights a frame; the previous frame's count is kept, up to 20 times the new one
+  size_t shaded = 0;
+  for (uint32_t y = 0; y < 52; y++) {
+    for (uint32_t x = 0; x < 96; x++) {
+      const float m = serial.reservoir(x, y).z;
+      ASSERT_TRUE(m == 0.0f || m == 32.0f);
+      shaded += m == 32.0f;
+    }
+  }
+  ASSERT_GT(shaded, 96 * 52 / 2);
+  serial.render(scene.restir, one, settings);
+  for (int frame = 0; frame < 30; frame++) parallel.render(scene.restir, all);
+  for (uint32_t y = 0; y < 52; y++) {
+    for (uint32_t x = 0; x < 96; x++) {
+      const float m = serial.reservoir(x, y).z;
+      ASSERT_TRUE(m == 0.0f || m == 64.0f);
+      ASSERT_LE(parallel.reservoir(x, y).z, 21.0f * 32.0f);
+    }
+  }
+  serial.reset();
+  ASSERT_EQ(serial.reservoir(10, 10).z, 0.0f);
+}
+
+
+TEST(RESTIR, Empty0) {
+  Repository::HostScene scene;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(MESHES), scene));
+  scene.restir.camera = Renderer::Host::isometricCamera(40, 30);
+  RestirRenderer renderer;
+  Image image;
+
+  // No structure renders black, without a ray
+  const Renderer::Host::Tlas<Renderer::Host::Bvh8>* structure = scene.restir.structure;
+  scene.restir.structure = nullptr;
+  RestirStats stats = renderer.render(scene.restir, image);
+  ASSERT_EQ(stats.rays(), 0);
+  for (uint8_t value : image.data) ASSERT_EQ(value, 0);
+
+  // Nothing to hit: every ray falls on the ground plane and the bounce goes to the sky, blue over
+  // the grey; black only where the bounce grazes the plane. The closest hit test never finds the
+  // lights, which are not in the structure
+  Renderer::Host::Tlas<Renderer::Host::Bvh8> empty;
+  Renderer::Host::TlasBuilder::build({}, std::vector<const Renderer::Host::Bvh8*>{}, empty);
+  scene.restir.structure = &empty;
+  Renderer::Host::RestirSettings closest;
+  closest.occlusion = false;
+  stats = renderer.render(scene.restir, image, closest);
+  ASSERT_EQ(stats.primaryRays, stats.pixels);
+  ASSERT_EQ(stats.shadowRays, 2 * stats.pixels);
+  ASSERT_EQ(stats.bounceRays, stats.pixels);
+  size_t lit = 0;
+  for (size_t i = 0; i < image.data.size(); i += 4) {
+    ASSERT_GE(image.data[i + 2], image.data[i]);
+    lit += image.data[i + 2] > image.data[i];
+  }
+  ASSERT_GT(lit, stats.pixels * 9 / 10);
+
+  // Nothing blocks an occlusion query: the lights add to every pixel they face
+  RestirRenderer occlusion;
+  Image unblocked;
+  occlusion.render(scene.restir, unblocked);
+  size_t brighter = 0;
+  for (size_t i = 0; i < image.data.size(); i++) {
+    ASSERT_GE(unblocked.data[i], image.data[i]) << i;
+    brighter += unblocked.data[i] > image.data[i];
+  }
+  ASSERT_GT(brighter, stats.pixels / 2);
+  scene.restir.structure = structure;
+}
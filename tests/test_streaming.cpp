@@ -0,0 +1,157 @@
+//
+// Texture streaming: tails, budget, LRU eviction and slot patching against the CPU backend.
+//
+#include <gtest/gtest.h>
+#include <Renderer/HostStreaming.h>
+
+using Renderer::Host::CpuStreamBackend;
+using Renderer::Host::StreamSettings;
+using Renderer::Host::StreamSource;
+using Renderer::Host::TextureStreamer;
+
+// Square chain down to 1x1 at 1 byte per texel, every byte of level l is `seed + l`
+static StreamSource chain(uint32_t size, uint8_t seed) {
+  auto store = std::make_shared<std::vector<std::vector<uint8_t>>>();
+  for (uint32_t s = size; s > 0; s /= 2) store->emplace_back((size_t)s * s, (uint8_t)(seed + store->size()));
+  StreamSource source;
+  for (size_t l = 0; l < store->size(); l++) {
+    const uint32_t s = size >> l;
+    source.levels.push_back({s, s, (*store)[l].data(), (*store)[l].size(), s});
+  }
+  source.store = store;
+  return source;
+}
+
+static size_t bytesFrom(uint32_t size, uint32_t first) {
+  size_t bytes = 0;
+  for (uint32_t s = size >> first; s > 0; s /= 2) bytes += (size_t)s * s;
+  return bytes;
+}
+
+
+TEST(STREAMING, Tail0) {
+  CpuStreamBackend backend;
+  TextureStreamer streamer(&backend);
+  std::vector<uint64_t> table(2, 0);
+  streamer.setTable(table.data(), table.size());
+
+  streamer.add(1, chain(1024, 10));
+  ASSERT_EQ(streamer.residentLevel(1), TextureStreamer::NONE);
+  ASSERT_EQ(table[1], 0);
+  ASSERT_EQ(streamer.update(), 1);
+
+  // 64x64 and below: levels 4 to 10
+  ASSERT_EQ(streamer.residentLevel(1), 4);
+  ASSERT_NE(table[1], 0);
+  ASSERT_EQ(table[0], 0);
+  const CpuStreamBackend::Texture* texture = backend.texture(table[1]);
+  ASSERT_NE(texture, nullptr);
+  ASSERT_EQ(texture->first, 4);
+  ASSERT_EQ(texture->levels.size(), 7);
+  ASSERT_EQ(texture->levels[0].size(), 64 * 64);
+  ASSERT_EQ(texture->levels[0][0], 14);
+  ASSERT_EQ(streamer.stats().residentBytes, bytesFrom(1024, 4));
+  ASSERT_EQ(backend.liveBytes(), streamer.stats().residentBytes);
+
+  ASSERT_EQ(TextureStreamer::levelFor(1024, 1024), 0);
+  ASSERT_EQ(TextureStreamer::levelFor(1024, 300), 1);
+  ASSERT_EQ(TextureStreamer::levelFor(1024, 256), 2);
+  ASSERT_EQ(TextureStreamer::levelFor(256, 2000), 0);
+}
+
+
+TEST(STREAMING, Patch0) {
+  // Two frames per upload: the slot gets sharper one level at a time, old textures are retired
+  CpuStreamBackend backend(2);
+  TextureStreamer streamer(&backend);
+  std::vector<uint64_t> table(1, 0);
+  streamer.setTable(table.data(), table.size());
+  streamer.add(0, chain(512, 0));
+
+  uint32_t previousLevel = TextureStreamer::NONE;
+  uint64_t previousHandle = 0;
+  for (int frame = 0; frame < 20 && streamer.residentLevel(0) != 0; frame++) {
+    streamer.request(0, 0);
+    streamer.update();
+    const uint32_t level = streamer.residentLevel(0);
+    if (level == previousLevel) continue;
+    if (previousLevel != TextureStreamer::NONE) {
+      ASSERT_EQ(level, previousLevel - 1);
+    }
+    ASSERT_NE(table[0], previousHandle);
+    ASSERT_EQ(backend.texture(previousHandle), nullptr);
+    ASSERT_EQ(backend.texture(table[0])->first, level);
+    ASSERT_EQ(backend.texture(table[0])->levels[0][0], level);
+    previousLevel = level;
+    previousHandle = table[0];
+  }
+  ASSERT_EQ(streamer.residentLevel(0), 0);
+  ASSERT_EQ(streamer.stats().uploads, 4); // Tail at 3, then 2, 1, 0
+  ASSERT_EQ(backend.liveTextures(), 1);
+  ASSERT_EQ(backend.liveBytes(), bytesFrom(512, 0));
+
+  // Asking for less does not drop anything while there is room
+  for (int frame = 0; frame < 4; frame++) {
+    streamer.request(0, 2);
+    streamer.update();
+  }
+  ASSERT_EQ(streamer.residentLevel(0), 0);
+  ASSERT_EQ(streamer.stats().evictions, 0);
+}
+
+
+TEST(STREAMING, Budget0) {
+  // Eight 512 chains, room for the three in view and the one being built
+  StreamSettings settings;
+  settings.budget = 4 * bytesFrom(512, 0) + 8 * bytesFrom(512, 3);
+  settings.uploadBytesPerFrame = 256 * 1024;
+  CpuStreamBackend backend(1, 4);
+  TextureStreamer streamer(&backend, settings);
+  for (uint32_t slot = 0; slot < 8; slot++) streamer.add(slot, chain(512, (uint8_t)(slot * 16)));
+
+  // A moving window of three visible textures
+  for (int frame = 0; frame < 400; frame++) {
+    const uint32_t first = (uint32_t)(frame / 40) % 8;
+    for (uint32_t k = 0; k < 3; k++) streamer.request((first + k) % 8, 0);
+    streamer.update();
+
+    const Renderer::Host::StreamStats& stats = streamer.stats();
+    ASSERT_LE(stats.residentBytes + stats.pendingBytes, settings.budget) << frame;
+    ASSERT_EQ(backend.liveBytes(), stats.residentBytes + stats.pendingBytes) << frame;
+    // Once the window settles everything in it is sharp
+    if (frame % 40 == 39) {
+      for (uint32_t k = 0; k < 3; k++) ASSERT_EQ(streamer.residentLevel((first + k) % 8), 0) << frame;
+    }
+  }
+  ASSERT_LE(streamer.stats().peakBytes, settings.budget);
+  ASSERT_GT(streamer.stats().evictions, 0);
+}
+
+
+TEST(STREAMING, Lru0) {
+  // Two full chains, the tails, and room to build level 1 of a third
+  StreamSettings settings;
+  settings.budget = 2 * bytesFrom(256, 0) + bytesFrom(256, 1) + bytesFrom(256, 2);
+  CpuStreamBackend backend;
+  TextureStreamer streamer(&backend, settings);
+  for (uint32_t slot = 0; slot < 3; slot++) streamer.add(slot, chain(256, 0));
+
+  // 0 then 1 become sharp, 1 is used last
+  for (int frame = 0; frame < 10; frame++) {
+    streamer.request(0, 0);
+    streamer.request(1, 0);
+    streamer.update();
+  }
+  ASSERT_EQ(streamer.residentLevel(0), 0);
+  ASSERT_EQ(streamer.residentLevel(1), 0);
+
+  // Only 2 is visible now: 0 goes first, 1 stays as long as 2 fits next to it
+  for (int frame = 0; frame < 10; frame++) {
+    streamer.request(2, 0);
+    streamer.update();
+  }
+  ASSERT_EQ(streamer.residentLevel(2), 0);
+  ASSERT_EQ(streamer.residentLevel(0), 2);
+  ASSERT_EQ(streamer.residentLevel(1), 0);
+  ASSERT_EQ(streamer.stats().evictions, 1);
+}
@@ -0,0 +1,126 @@
+//
+// Tile scheduler: Morton codes and tile order, every tile run exactly once by one worker at a time,
+// and stealing evening out a frame whose expensive tiles all start on one worker.
+//
+#include <gtest/gtest.h>
+#include <Thread/TileScheduler.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using EXP::THREAD::Pool;
+using EXP::THREAD::Tile;
+using EXP::THREAD::TileScheduler;
+using EXP::THREAD::TileSettings;
+using EXP::THREAD::TileStats;
+
+
+TEST(TILES, Morton0) {
+  ASSERT_EQ(TileScheduler::morton(0, 0), 0);
+  ASSERT_EQ(TileScheduler::morton(1, 0), 1);
+  ASSERT_EQ(TileScheduler::morton(0, 1), 2);
+  ASSERT_EQ(TileScheduler::morton(3, 3), 15);
+  ASSERT_EQ(TileScheduler::morton(0xFFFFFFFF, 0), 0x5555555555555555ull);
+
+  // 3024 x 1650 in 16 pixel tiles: the last column and row clipped, every pixel in one tile
+  const std::vector<Tile> tiles = TileScheduler::tiles(3024, 1650, 16);
+  ASSERT_EQ(tiles.size(), 189 * 104);
+  uint64_t pixels = 0;
+  for (const Tile& tile : tiles) {
+    ASSERT_TRUE(tile.x % 16 == 0 && tile.y % 16 == 0);
+    ASSERT_EQ(tile.height, tile.y == 1648 ? 2 : 16);
+    pixels += (uint64_t)tile.width * tile.height;
+  }
+  ASSERT_EQ(pixels, 3024ull * 1650);
+
+  // Z order: the first quad, then the one right of it
+  const uint32_t expected[8][2] = {{0, 0}, {16, 0}, {0, 16}, {16, 16}, {32, 0}, {48, 0}, {32, 16}, {48, 16}};
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(tiles[i].x, expected[i][0]);
+    ASSERT_EQ(tiles[i].y, expected[i][1]);
+  }
+  const std::vector<Tile> scanline = TileScheduler::tiles(3024, 1650, 16, false);
+  ASSERT_EQ(scanline[1].x, 16);
+  ASSERT_EQ(scanline[189].y, 16);
+}
+
+
+TEST(TILES, Run0) {
+  Pool pool(4);
+  for (bool steal : {true, false}) {
+    TileSettings settings;
+    settings.size = 32;
+    settings.steal = steal;
+    settings.timeTiles = true;
+    const uint32_t columns = (1000 + 31) / 32, rows = (700 + 31) / 32;
+    std::vector<std::atomic<int>> runs(columns * rows);
+    std::atomic<bool> busy[4] = {};
+    std::atomic<bool> overlap{false};
+    const TileStats stats = TileScheduler::run(
+      1000,
+      700,
+      [&](const Tile& tile, unsigned int worker) {
+        ASSERT_LT(worker, 4);
+        if (busy[worker].exchange(true)) overlap = true;
+        runs[tile.y / 32 * columns + tile.x / 32]++;
+        busy[worker] = false;
+      },
+      settings,
+      pool
+    );
+    ASSERT_FALSE(overlap);
+    for (const std::atomic<int>& count : runs) ASSERT_EQ(count, 1);
+    ASSERT_EQ(stats.tiles, columns * rows);
+    ASSERT_EQ(stats.workers.size(), 4);
+    ASSERT_EQ(stats.tileSeconds.size(), stats.tiles);
+    uint32_t total = 0;
+    for (const EXP::THREAD::TileWorkerStats& worker : stats.workers) total += worker.tiles;
+    ASSERT_EQ(total, stats.tiles);
+    ASSERT_GE(stats.imbalance(), 1.0);
+    if (!steal) {
+      ASSERT_EQ(stats.steals(), 0);
+    }
+  }
+
+  // Fewer tiles than workers
+  uint32_t calls = 0;
+  const TileStats one = TileScheduler::run(5, 5, [&](const Tile&, unsigned int) { calls++; }, {}, pool);
+  ASSERT_EQ(calls, 1);
+  ASSERT_EQ(one.workers.size(), 1);
+  ASSERT_EQ(TileScheduler::run(0, 10, [&](const Tile&, unsigned int) { calls++; }, {}, pool).tiles, 0);
+}
+
+
+TEST(TILES, Steal0) {
+  // The first quarter of the order is slow, all of it dealt to worker 0
+  Pool pool(4);
+  const std::vector<Tile> order = TileScheduler::tiles(256, 256, 16);
+  auto slow = [&](const Tile& tile) {
+    for (size_t i = 0; i < order.size() / 4; i++) {
+      if (order[i].x == tile.x && order[i].y == tile.y) return true;
+    }
+    return false;
+  };
+  auto run = [&](bool steal) {
+    TileSettings settings;
+    settings.steal = steal;
+    return TileScheduler::run(
+      256,
+      256,
+      [&](const Tile& tile, unsigned int) {
+        if (slow(tile)) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      },
+      settings,
+      pool
+    );
+  };
+
+  const TileStats fixed = run(false);
+  ASSERT_EQ(fixed.workers[0].tiles, order.size() / 4);
+  ASSERT_EQ(fixed.stolen(), 0);
+  const TileStats stealing = run(true);
+  ASSERT_GT(stealing.steals(), 0);
+  ASSERT_GT(stealing.stolen(), 0);
+  ASSERT_LT(stealing.workers[0].tiles, order.size() / 4);
+  ASSERT_LT(stealing.imbalance(), fixed.imbalance());
+}
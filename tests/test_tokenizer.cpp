@@ -0,0 +1,163 @@
+//
+// Number tokenizer: every vector path must agree bit for bit with the scalar parser.
+//
+#include <gtest/gtest.h>
+#include <DB/Tokenizer.hpp>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+using Repository::Isa;
+using Repository::Tokenizer;
+
+static std::vector<Isa> vectorIsas() {
+  std::vector<Isa> isas;
+  for (Isa isa : {Isa::SSE41, Isa::AVX2, Isa::NEON}) {
+    if (Tokenizer::supported(isa)) isas.push_back(isa);
+  }
+  return isas;
+}
+
+static uint32_t bits(float value) {
+  uint32_t result;
+  memcpy(&result, &value, sizeof(result));
+  return result;
+}
+
+// Parses `count` floats of every line with `isa` and compares values, counts and end positions to scalar.
+static void expectSameFloats(const std::string& text, int count, const Isa& isa) {
+  const char* end = text.data() + text.size();
+  const char* line = text.data();
+  while (line < end) {
+    const char* scalar = line;
+    const char* vector = line;
+    float expected[4] = {-1.0f, -1.0f, -1.0f, -1.0f};
+    float actual[4] = {-1.0f, -1.0f, -1.0f, -1.0f};
+    const int expectedCount = Tokenizer::parseFloats(scalar, end, expected, count, Isa::SCALAR);
+    const int actualCount = Tokenizer::parseFloats(vector, end, actual, count, isa);
+    const std::string context = std::string(Tokenizer::name(isa)) + ": " + std::string(line, Tokenizer::lineEnd(line, end));
+    ASSERT_EQ(actualCount, expectedCount) << context;
+    ASSERT_EQ(vector, scalar) << context;
+    for (int i = 0; i < expectedCount; i++) ASSERT_EQ(bits(actual[i]), bits(expected[i])) << context;
+    Tokenizer::skipLine(line, end);
+  }
+}
+
+
+TEST(TOKENIZER, Scalar0) {
+  const std::string text = "-1.5e2 +0.000001 3 .25 1E-3 -0 0.905208 -0.054739 5. 0x1";
+  const char* p = text.data();
+  const char* end = text.data() + text.size();
+  float values[12];
+  ASSERT_EQ(Tokenizer::parseFloats(p, end, values, 12, Isa::SCALAR), 10);
+  ASSERT_EQ(values[0], -150.0f);
+  ASSERT_EQ(values[1], 0.000001f);
+  ASSERT_EQ(values[3], 0.25f);
+  ASSERT_EQ(values[4], 0.001f);
+  ASSERT_EQ(bits(values[5]), bits(-0.0f));
+  ASSERT_EQ(values[7], -0.054739f);
+  ASSERT_EQ(values[8], 5.0f);
+  ASSERT_EQ(values[9], 0.0f); // Stops at the x
+  ASSERT_EQ(*p, 'x');
+
+  // An exponent without digits is not an exponent
+  const std::string dangling = "1e x";
+  p = dangling.data();
+  ASSERT_TRUE(Tokenizer::parseFloat(p, dangling.data() + dangling.size(), values[0]));
+  ASSERT_EQ(values[0], 1.0f);
+  ASSERT_EQ(*p, 'e');
+}
+
+
+TEST(TOKENIZER, Edges0) {
+  // Exponents, long mantissas, stray points and characters, lines ending near the buffer end
+  const std::string text =
+    "v 1 2 3\n"
+    "v -0.000000 +1.000000 -1.000000\n"
+    "v 1e5 2.5E-3 -7e+2\n"
+    "v 0.12345678901234567890 123456789012345678901234 0.000000000000000000001\n"
+    "v 1.2.3 4..5 .5\n"
+    "v . - +\n"
+    "v 1.0x 2.0 3.0\n"
+    "v 1.0/2.0 3\n"
+    "v\t\t0.5\t-0.25 \t 0.125   \r\n"
+    "v 0.905208 -0.054739 -0.000000 0.5\n"
+    "v 123456789012345 1234567890123456 12345678901234.5\n"
+    "v 0.1";
+  for (const Isa& isa : vectorIsas()) {
+    for (int count = 1; count <= 4; count++) {
+      expectSameFloats(text, count, isa);
+      // Every suffix: puts each field at every distance from the buffer end
+      for (size_t offset = 0; offset < text.size(); offset += 7) expectSameFloats(text.substr(offset), count, isa);
+    }
+  }
+}
+
+
+TEST(TOKENIZER, Random0) {
+  // OBJ style lines: fixed and general notation, 0..9 decimals, blanks, signs
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<double> magnitude(-6.0, 6.0);
+  std::uniform_int_distribution<int> pick(0, 9);
+  std::string text;
+  char buffer[64];
+  for (int line = 0; line < 20000; line++) {
+    text += pick(random) < 5 ? "v" : "vt";
+    for (int i = 0; i < 3; i++) {
+      const double value = std::pow(10.0, magnitude(random)) * (pick(random) < 5 ? -1.0 : 1.0);
+      const int format = pick(random);
+      if (format < 7) snprintf(buffer, sizeof(buffer), "%.*f", format + 3, value);
+      else if (format < 9) snprintf(buffer, sizeof(buffer), "%.7g", value);
+      else snprintf(buffer, sizeof(buffer), "%d", (int)value);
+      text += pick(random) == 0 ? "  " : " ";
+      text += buffer;
+    }
+    text += pick(random) == 0 ? "\r\n" : "\n";
+  }
+  for (const Isa& isa : vectorIsas()) expectSameFloats(text, 3, isa);
+}
+
+
+TEST(TOKENIZER, Strtof0) {
+  // Six decimals as written by most exporters: one rounding, same as the C library
+  std::ifstream file(std::string(EXPLORER_ASSET_DIR) + "/Meshes/f16/f16.obj");
+  std::stringstream reader;
+  reader << file.rdbuf();
+  const std::string text = reader.str();
+  const char* end = text.data() + text.size();
+
+  size_t compared = 0;
+  for (const char* line = text.data(); line < end; Tokenizer::skipLine(line, end)) {
+    if (line[0] != 'v') continue;
+    const char* p = line + (line[1] == ' ' ? 1 : 2);
+    float values[3];
+    const int count = Tokenizer::parseFloats(p, end, values, 3);
+    char* reference = (char*)line + (line[1] == ' ' ? 1 : 2);
+    for (int i = 0; i < count; i++, compared++) ASSERT_EQ(bits(values[i]), bits(strtof(reference, &reference)));
+  }
+  ASSERT_GT(compared, 20000);
+}
+
+
+TEST(TOKENIZER, Ints0) {
+  const std::string text = "1 -2 +3 0 007 123456789 -987654321 2147483647 99999999999 12/34//5 - x 7";
+  for (const Isa& isa : vectorIsas()) {
+    const char* scalar = text.data();
+    const char* vector = text.data();
+    const char* end = text.data() + text.size();
+    while (scalar < end) {
+      int32_t expected = -1, actual = -1;
+      const bool expectedOk = Tokenizer::parseInt(scalar, end, expected, Isa::SCALAR);
+      const bool actualOk = Tokenizer::parseInt(vector, end, actual, isa);
+      ASSERT_EQ(actualOk, expectedOk);
+      ASSERT_EQ(actual, expected);
+      ASSERT_EQ(vector, scalar);
+      // Skip whatever stopped the number
+      scalar++;
+      vector++;
+    }
+  }
+}
@@ -0,0 +1,183 @@
+//
+// Wavefront tracing: queues binned by octant and origin cell, queued rays finding the hits
+// Tlas::intersect finds in any order, and ReSTIR frames rendered stage by stage the same as pixel by
+// pixel, over any wave size, with shadow rays as occlusion queries or closest hits.
+//
+#include <gtest/gtest.h>
+#include <DB/SceneRepository.hpp>
+#include <Renderer/HostWavefront.h>
+#include <random>
+
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhRay;
+using Renderer::Host::RayQueue;
+using Renderer::Host::RestirRenderer;
+using Renderer::Host::RestirSettings;
+using Renderer::Host::RestirStats;
+using Renderer::Host::WavefrontSettings;
+using Renderer::Host::WavefrontStats;
+using Renderer::Host::WavefrontTracer;
+
+static const std::string MESHES = std::string(EXPLORER_ASSET_DIR) + "/Meshes";
+
+static BvhRay ray(const EXP::MATH::packed3& origin, const EXP::MATH::packed3& direction) {
+  BvhRay result;
+  result.origin = origin;
+  result.direction = direction;
+  return result;
+}
+
+
+TEST(WAVEFRONT, Bin0) {
+  RayQueue queue;
+  queue.resize(7);
+  ASSERT_EQ(queue.slots(), 7);
+  queue.push(0, ray({1.0f, 0.0f, 0.0f}, {-1.0f, 1.0f, 1.0f})); // Octant 4, far cell
+  queue.push(1, ray({0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}));  // Octant 0
+  queue.push(3, ray({0.0f, 0.0f, 0.0f}, {-1.0f, 1.0f, 1.0f})); // Octant 4, near cell
+  queue.push(4, ray({1.0f, 1.0f, 1.0f}, {1.0f, 2.0f, 3.0f}));  // Octant 0, far cell
+  queue.push(5, ray({0.0f, 0.0f, 0.0f}, {1.0f, -1.0f, 1.0f})); // Octant 2
+  queue.push(6, ray({0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}));  // Same bin as 1, after it
+
+  Renderer::Host::Aabb bounds;
+  bounds.grow(EXP::MATH::packed3{0.0f, 0.0f, 0.0f});
+  bounds.grow(EXP::MATH::packed3{1.0f, 1.0f, 1.0f});
+  ASSERT_EQ(WavefrontTracer::key(queue.ray(1), bounds, 4), 0);
+  ASSERT_EQ(WavefrontTracer::key(queue.ray(4), bounds, 4), 0xFFF);
+  ASSERT_EQ(WavefrontTracer::key(queue.ray(5), bounds, 4), 2 << 12);
+  ASSERT_EQ(WavefrontTracer::key(queue.ray(0), bounds, 2), 4 << 6 | 0b100100); // Cell x = 3, interleaved x highest
+
+  // Slot 2 was never queued
+  WavefrontTracer::bin(queue);
+  ASSERT_EQ(queue.order, (std::vector<uint32_t>{1, 6, 4, 5, 3, 0}));
+  WavefrontSettings unsorted;
+  unsorted.sort = false;
+  WavefrontTracer::bin(queue, unsorted);
+  ASSERT_EQ(queue.order, (std::vector<uint32_t>{0, 1, 3, 4, 5, 6}));
+
+  // Cleared slots keep their rays
+  queue.clear();
+  WavefrontTracer::bin(queue);
+  ASSERT_TRUE(queue.order.empty());
+  ASSERT_EQ(queue.ray(4).direction.z, 3.0f);
+}
+
+
+TEST(WAVEFRONT, Trace0) {
+  Repository::HostScene scene;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(MESHES), scene));
+  const Renderer::Host::Aabb bounds = scene.tlas.bvh.bounds();
+
+  // Rays between random points of the scene's box, every other slot queued
+  std::mt19937 random(11);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  auto point = [&]() {
+    return EXP::MATH::packed3{
+      bounds.min.x + unit(random) * (bounds.max.x - bounds.min.x),
+      bounds.min.y + unit(random) * (bounds.max.y - bounds.min.y),
+      bounds.min.z + unit(random) * (bounds.max.z - bounds.min.z)
+    };
+  };
+  RayQueue queue;
+  queue.resize(3001);
+  std::vector<BvhHit> expected(queue.slots());
+  size_t hit = 0;
+  for (size_t i = 0; i < queue.slots(); i += 2) {
+    const EXP::MATH::packed3 from = point(), to = point();
+    BvhRay r = ray(from, {to.x - from.x, to.y - from.y, to.z - from.z});
+    r.tmax = i % 3 == 0 ? 0.5f : INFINITY;
+    queue.push(i, r);
+    hit += scene.tlas.intersect(r, expected[i]);
+  }
+  ASSERT_GT(hit, 100);
+
+  for (bool sort : {true, false}) {
+    for (uint32_t batch : {1u, 64u, 5000u}) {
+      WavefrontSettings settings;
+      settings.sort = sort;
+      settings.batch = batch;
+      std::vector<BvhHit> hits;
+      WavefrontStats stats;
+      WavefrontTracer::trace(scene.tlas, queue, hits, settings, &stats);
+      ASSERT_EQ(hits.size(), queue.slots());
+      ASSERT_EQ(stats.rays, 1501);
+      ASSERT_EQ(stats.queues, 1);
+      ASSERT_EQ(stats.packets.hits, hit);
+      for (size_t i = 0; i < queue.slots(); i += 2) {
+        ASSERT_EQ(hits[i].t, expected[i].t);
+        ASSERT_EQ(hits[i].primitive, expected[i].primitive);
+        ASSERT_EQ(hits[i].instance, expected[i].instance);
+      }
+    }
+  }
+
+  // Occlusion queries block exactly the rays that hit something
+  for (bool sort : {true, false}) {
+    WavefrontSettings settings;
+    settings.sort = sort;
+    std::vector<uint8_t> occluded;
+    WavefrontStats stats;
+    WavefrontTracer::occluded(scene.tlas, queue, occluded, settings, &stats);
+    ASSERT_EQ(occluded.size(), queue.slots());
+    ASSERT_EQ(stats.rays, 1501);
+    ASSERT_EQ(stats.packets.hits, hit);
+    for (size_t i = 0; i < queue.slots(); i += 2) ASSERT_EQ(occluded[i], expected[i].t < INFINITY) << i;
+  }
+
+  // Packets find the same triangles, up to rounding on grazing rays
+  WavefrontSettings packets;
+  packets.isa = Renderer::Host::PacketTracer::best();
+  std::vector<BvhHit> hits;
+  WavefrontTracer::trace(scene.tlas, queue, hits, packets);
+  size_t same = 0;
+  for (size_t i = 0; i < queue.slots(); i += 2) same += hits[i].primitive == expected[i].primitive && hits[i].instance == expected[i].instance;
+  ASSERT_GE(same, 1501 - 2);
+}
+
+
+TEST(WAVEFRONT, Restir0) {
+  Repository::HostScene scene;
+  ASSERT_TRUE(Repository::Scenes::load(Repository::Scenes::showcase(MESHES), scene));
+  scene.restir.camera = Renderer::Host::isometricCamera(96, 52);
+
+  // Two frames, so that the second reuses reservoirs; 1000 pixel waves leave a partial one
+  RestirRenderer pixels, waves, unsorted;
+  Renderer::Host::Image expected, image;
+  RestirSettings settings, wavefront, slots;
+  wavefront.wavefront = true;
+  wavefront.queues.wave = 1000;
+  slots = wavefront;
+  slots.queues.sort = false;
+  for (int frame = 0; frame < 2; frame++) {
+    const RestirStats reference = pixels.render(scene.restir, expected, settings);
+    const RestirStats stats = waves.render(scene.restir, image, wavefront);
+    ASSERT_EQ(image.data, expected.data);
+    ASSERT_EQ(stats.primaryRays, reference.primaryRays);
+    ASSERT_EQ(stats.shadowRays, reference.shadowRays);
+    ASSERT_EQ(stats.bounceRays, reference.bounceRays);
+    ASSERT_EQ(stats.wavefront.waves, 5);
+    ASSERT_EQ(stats.wavefront.queues, 5 * 5);
+    ASSERT_EQ(stats.wavefront.rays, stats.rays());
+    unsorted.render(scene.restir, image, slots);
+    ASSERT_EQ(image.data, expected.data);
+  }
+  for (uint32_t y = 0; y < 52; y++) {
+    for (uint32_t x = 0; x < 96; x++) ASSERT_EQ(waves.reservoir(x, y).x, pixels.reservoir(x, y).x);
+  }
+
+  // Shadow rays as closest hits: stage by stage still the same
+  RestirRenderer closest, closestWaves;
+  settings.occlusion = wavefront.occlusion = false;
+  for (int frame = 0; frame < 2; frame++) {
+    const RestirStats reference = closest.render(scene.restir, expected, settings);
+    const RestirStats stats = closestWaves.render(scene.restir, image, wavefront);
+    ASSERT_EQ(image.data, expected.data);
+    ASSERT_EQ(stats.shadowRays, reference.shadowRays);
+  }
+
+  // Without a structure, black and no rays
+  scene.restir.structure = nullptr;
+  const RestirStats none = waves.render(scene.restir, image, wavefront);
+  ASSERT_EQ(none.rays(), 0);
+  for (uint8_t value : image.data) ASSERT_EQ(value, 0);
+}
@@ -0,0 +1,115 @@
+//
+// Vertex welding on host meshes.
+//
+#include <gtest/gtest.h>
+#include <DB/ObjRepository.hpp>
+#include <Model/Weld.h>
+
+using HostMesh = EXP::MDL::HostMesh;
+using Weld = EXP::MDL::Weld;
+
+static void addVertex(HostMesh& mesh, EXP::MATH::packed3 position, EXP::MATH::float2 texture = {0.0f, 0.0f}) {
+  mesh.vertices.push_back(position);
+  mesh.attributes.push_back({{0.0f, 0.0f, 0.0f, 1.0f}, texture, {0.0f, 0.0f, 1.0f}});
+}
+
+// Same triangles, same corner values: the welded mesh must render identically.
+static void expectSameGeometry(const HostMesh& a, const HostMesh& b, float epsilon) {
+  ASSERT_EQ(a.submeshes.size(), b.submeshes.size());
+  for (size_t s = 0; s < a.submeshes.size(); s++) {
+    ASSERT_EQ(a.submeshes[s].indices.size(), b.submeshes[s].indices.size());
+    for (size_t i = 0; i < a.submeshes[s].indices.size(); i++) {
+      const uint32_t ia = a.submeshes[s].indices[i], ib = b.submeshes[s].indices[i];
+      for (int k = 0; k < 3; k++) ASSERT_NEAR(a.vertices[ia][k], b.vertices[ib][k], epsilon);
+      ASSERT_NEAR(a.attributes[ia].texture.x, b.attributes[ib].texture.x, epsilon);
+      ASSERT_NEAR(a.attributes[ia].normal.z, b.attributes[ib].normal.z, epsilon);
+    }
+  }
+}
+
+
+TEST(WELD, Exact0) {
+  // Quad as two triangles with all six corners separate, plus one unreferenced vertex
+  HostMesh mesh;
+  addVertex(mesh, {0, 0, 0});
+  addVertex(mesh, {1, 0, 0});
+  addVertex(mesh, {1, 1, 0});
+  addVertex(mesh, {-0.0f, 0, 0}); // Same as vertex 0
+  addVertex(mesh, {1, 1, 0});
+  addVertex(mesh, {0, 1, 0});
+  addVertex(mesh, {5, 5, 5});
+  mesh.submeshes.push_back({{0, 1, 2, 3, 4, 5}, -1});
+  const HostMesh original = mesh;
+
+  EXP::MDL::WeldReport report = Weld::apply(mesh);
+  ASSERT_EQ(report.verticesBefore, 7);
+  ASSERT_EQ(report.verticesAfter, 4);
+  ASSERT_EQ(report.bytesSaved(), 3 * (sizeof(EXP::MATH::packed3) + sizeof(Renderer::Host::VertexAttributes)));
+  std::vector<uint32_t> expected = {0, 1, 2, 0, 2, 3};
+  ASSERT_EQ(mesh.submeshes[0].indices, expected);
+  expectSameGeometry(original, mesh, 0.0f);
+}
+
+
+TEST(WELD, Attributes0) {
+  // Same position, different texcoord: a seam, kept apart
+  HostMesh mesh;
+  addVertex(mesh, {0, 0, 0}, {0.0f, 0.0f});
+  addVertex(mesh, {1, 0, 0});
+  addVertex(mesh, {0, 1, 0});
+  addVertex(mesh, {0, 0, 0}, {1.0f, 0.0f});
+  mesh.submeshes.push_back({{0, 1, 2}, 0});
+  mesh.submeshes.push_back({{3, 1, 2}, 1});
+
+  std::vector<uint32_t> remap;
+  ASSERT_EQ(Weld::remap(mesh, remap), 4);
+  ASSERT_NE(remap[0], remap[3]);
+  // Welding works across submeshes
+  ASSERT_EQ(Weld::apply(mesh).verticesAfter, 4);
+  ASSERT_EQ(mesh.submeshes[1].indices[1], mesh.submeshes[0].indices[1]);
+}
+
+
+TEST(WELD, Epsilon0) {
+  // Near duplicates on both sides of a cell boundary
+  const float epsilon = 1e-4f;
+  HostMesh mesh;
+  addVertex(mesh, {0.99995e-4f, 0, 0});
+  addVertex(mesh, {1, 0, 0});
+  addVertex(mesh, {0, 1, 0});
+  addVertex(mesh, {1.00004e-4f, 0, 0});
+  addVertex(mesh, {1, 0.00002f, 0});
+  addVertex(mesh, {0, 1, 0.5f});
+  mesh.submeshes.push_back({{0, 1, 2, 3, 4, 5}, -1});
+  const HostMesh original = mesh;
+
+  HostMesh exact = mesh;
+  ASSERT_EQ(Weld::apply(exact).verticesAfter, 6);
+
+  EXP::MDL::WeldReport report = Weld::apply(mesh, epsilon);
+  ASSERT_EQ(report.verticesAfter, 4);
+  std::vector<uint32_t> expected = {0, 1, 2, 0, 1, 3};
+  ASSERT_EQ(mesh.submeshes[0].indices, expected);
+  expectSameGeometry(original, mesh, epsilon);
+}
+
+
+TEST(WELD, F16) {
+  HostMesh mesh;
+  ASSERT_TRUE(Repository::Obj::read(std::string(EXPLORER_ASSET_DIR) + "/Meshes/f16/f16.obj", mesh));
+  const HostMesh original = mesh;
+
+  EXP::MDL::WeldReport report = Weld::apply(mesh);
+  ASSERT_LE(report.verticesAfter, report.verticesBefore);
+  ASSERT_EQ(mesh.triangleCount(), original.triangleCount());
+  expectSameGeometry(original, mesh, 0.0f);
+
+  HostMesh tolerant = original;
+  EXP::MDL::WeldReport tolerantReport = Weld::apply(tolerant, 1e-4f);
+  ASSERT_LE(tolerantReport.verticesAfter, report.verticesAfter);
+  expectSameGeometry(original, tolerant, 1e-4f);
+
+  std::cout << "f16 exact: " << report.verticesBefore << " -> " << report.verticesAfter << " vertices, saved "
+            << report.bytesSaved() << " bytes; epsilon 1e-4: " << tolerantReport.verticesAfter << " vertices, saved "
+            << tolerantReport.bytesSaved() << " bytes" << std::endl;
+}
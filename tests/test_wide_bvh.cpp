@@ -0,0 +1,216 @@
+//
+// Wide BVHs: collapse of binned, linear and spatial trees into 4 and 8 wide nodes, float and
+// quantized, with the same closest hits as the binary tree (random rays, and axis aligned ones on
+// box planes) and fewer nodes visited.
+//
+#include <gtest/gtest.h>
+#include <Renderer/HostWideBvh.h>
+#include <cmath>
+#include <random>
+
+using EXP::MATH::packed3;
+using Renderer::Host::Bvh;
+using Renderer::Host::Bvh4;
+using Renderer::Host::Bvh8;
+using Renderer::Host::BvhBuilder;
+using Renderer::Host::BvhCounters;
+using Renderer::Host::BvhGeometry;
+using Renderer::Host::BvhHit;
+using Renderer::Host::BvhRay;
+using Renderer::Host::WideBuilder;
+using Renderer::Host::WideSettings;
+
+// Small random triangles in the unit cube, `geometries` geometries of `each`
+struct Scatter {
+  std::vector<packed3> vertices;
+  std::vector<std::vector<uint32_t>> indices;
+
+  Scatter(uint32_t geometries, uint32_t each, float size, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f), offset(-size, size);
+    for (uint32_t g = 0; g < geometries; g++) {
+      indices.emplace_back();
+      for (uint32_t t = 0; t < each; t++) {
+        const packed3 center = {unit(random), unit(random), unit(random)};
+        for (int k = 0; k < 3; k++) {
+          indices.back().push_back((uint32_t)vertices.size());
+          vertices.push_back({center.x + offset(random), center.y + offset(random), center.z + offset(random)});
+        }
+      }
+    }
+  }
+
+  std::vector<BvhGeometry> geometries() const {
+    std::vector<BvhGeometry> result;
+    for (const std::vector<uint32_t>& list : indices) {
+      result.push_back({vertices.data(), sizeof(packed3), vertices.size(), list.data(), list.size() / 3});
+    }
+    return result;
+  }
+};
+
+static BvhRay randomRay(std::mt19937& random) {
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  BvhRay ray;
+  ray.origin = {0.5f + 2.0f * unit(random), 0.5f + 2.0f * unit(random), 0.5f + 2.0f * unit(random)};
+  const packed3 target = {0.5f + 0.5f * unit(random), 0.5f + 0.5f * unit(random), 0.5f + 0.5f * unit(random)};
+  ray.direction = {target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z};
+  return ray;
+}
+
+// Along an axis, the other two coordinates on the planes of a node of `bvh`: zero direction
+// components with the origin on a box plane
+static BvhRay axisRay(const Bvh& bvh, std::mt19937& random) {
+  std::uniform_int_distribution<size_t> node(0, bvh.nodes.size() - 1);
+  std::uniform_int_distribution<int> axis(0, 2), side(0, 1);
+  const Renderer::Host::BvhNode& box = bvh.nodes[node(random)];
+  const int a = axis(random);
+  BvhRay ray;
+  for (int k = 0; k < 3; k++) {
+    ray.origin[k] = side(random) ? box.min[k] : box.max[k];
+    ray.direction[k] = 0.0f;
+  }
+  const bool forward = side(random);
+  ray.origin[a] = forward ? -1.5f : 2.5f;
+  ray.direction[a] = forward ? 1.0f : -1.0f;
+  return ray;
+}
+
+// Same hits as the binary tree, for every width and node format
+template <typename Wide> static void compare(const Bvh& bvh, const Wide& wide, uint32_t seed) {
+  std::string error;
+  ASSERT_TRUE(wide.validate(&error)) << error;
+  std::mt19937 random(seed);
+  int hits = 0, axisHits = 0;
+  for (int r = 0; r < 4000; r++) {
+    const bool axis = r >= 2000;
+    const BvhRay ray = axis ? axisRay(bvh, random) : randomRay(random);
+    BvhHit expected, hit;
+    const bool found = bvh.intersect(ray, expected);
+    ASSERT_EQ(wide.intersect(ray, hit), found) << r;
+    if (!found) continue;
+    axis ? axisHits++ : hits++;
+    ASSERT_EQ(hit.t, expected.t) << r;
+    ASSERT_EQ(hit.primitive, expected.primitive) << r;
+    ASSERT_EQ(hit.geometry, expected.geometry) << r;
+    ASSERT_EQ(hit.u, expected.u) << r;
+  }
+  ASSERT_GT(hits, 300);
+  ASSERT_GT(axisHits, 300);
+}
+
+
+TEST(WIDE_BVH, Collapse0) {
+  const Scatter scatter(3, 1000, 0.04f, 5);
+  Bvh bvh;
+  BvhBuilder::binnedSah(scatter.geometries(), bvh);
+  WideSettings quantized;
+  quantized.quantized = true;
+
+  Bvh4 wide4, quantized4;
+  const Renderer::Host::BvhReport report4 = WideBuilder::collapse(bvh, wide4);
+  WideBuilder::collapse(bvh, quantized4, quantized);
+  compare(bvh, wide4, 1);
+  compare(bvh, quantized4, 1);
+  ASSERT_EQ(report4.nodes, wide4.nodes.size());
+  ASSERT_EQ(report4.references, 3000);
+  ASSERT_EQ(wide4.geometryFirst, bvh.geometryFirst);
+  ASSERT_TRUE(quantized4.isQuantized());
+  ASSERT_TRUE(quantized4.nodes.empty());
+  ASSERT_EQ(quantized4.nodeCount(), wide4.nodeCount());
+  // Every interior node but the root takes a lane of its parent
+  size_t lanes = 0;
+  for (const Renderer::Host::WideNode<4>& node : wide4.nodes) {
+    for (uint32_t lane = 0; lane < 4; lane++) lanes += node.child[lane] != Bvh4::EMPTY && node.count[lane] == 0;
+  }
+  ASSERT_EQ(lanes + 1, wide4.nodes.size());
+  ASSERT_LT(wide4.nodes.size(), bvh.nodes.size() / 3);
+
+  Bvh8 wide8, quantized8;
+  const Renderer::Host::BvhReport report8 = WideBuilder::collapse(bvh, wide8);
+  WideBuilder::collapse(bvh, quantized8, quantized);
+  compare(bvh, wide8, 2);
+  compare(bvh, quantized8, 2);
+  ASSERT_LT(report8.nodes, report4.nodes);
+  ASSERT_LT(report8.depth, report4.depth);
+  ASSERT_EQ(report8.leaves, report4.leaves);
+  ASSERT_LT(quantized8.bytes(), wide8.bytes());
+}
+
+
+TEST(WIDE_BVH, Builders0) {
+  // Linear and spatial trees collapse the same way; spatial duplicates stay in their leaves
+  const Scatter scatter(1, 1500, 0.2f, 8);
+  Bvh linear, spatial;
+  BvhBuilder::linear(scatter.geometries(), linear);
+  BvhBuilder::spatial(scatter.geometries(), spatial);
+  ASSERT_GT(spatial.primitives.size(), spatial.triangleCount());
+
+  WideSettings quantized;
+  quantized.quantized = true;
+  Bvh4 linear4, spatial4;
+  Bvh8 spatial8;
+  WideBuilder::collapse(linear, linear4, quantized);
+  WideBuilder::collapse(spatial, spatial4);
+  WideBuilder::collapse(spatial, spatial8, quantized);
+  compare(linear, linear4, 3);
+  compare(spatial, spatial4, 4);
+  compare(spatial, spatial8, 4);
+  ASSERT_TRUE(spatial8.spatial);
+  ASSERT_EQ(spatial4.triangles.size(), spatial.primitives.size());
+}
+
+
+TEST(WIDE_BVH, Visits0) {
+  // A height field seen from above: wide nodes cut node visits, boxes as tight as before
+  std::vector<packed3> vertices;
+  std::vector<uint32_t> indices;
+  const uint32_t size = 64;
+  for (uint32_t z = 0; z <= size; z++) {
+    for (uint32_t x = 0; x <= size; x++) {
+      const float u = (float)x / size, w = (float)z / size;
+      vertices.push_back({u, 0.05f * std::sin(20.0f * u) * std::cos(13.0f * w), w});
+    }
+  }
+  for (uint32_t z = 0; z < size; z++) {
+    for (uint32_t x = 0; x < size; x++) {
+      const uint32_t a = z * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+      indices.insert(indices.end(), {a, b, c, b, d, c});
+    }
+  }
+  Bvh bvh;
+  BvhBuilder::binnedSah({{vertices.data(), sizeof(packed3), vertices.size(), indices.data(), indices.size() / 3}}, bvh);
+  Bvh4 wide;
+  WideBuilder::collapse(bvh, wide);
+
+  std::mt19937 random(6);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  BvhCounters binary, four;
+  for (int r = 0; r < 1000; r++) {
+    BvhRay ray;
+    ray.origin = {0.1f + 0.8f * unit(random), 1.0f, 0.1f + 0.8f * unit(random)};
+    ray.direction = {0.2f * (unit(random) - 0.5f), -1.0f, 0.2f * (unit(random) - 0.5f)};
+    BvhHit expected, hit;
+    ASSERT_TRUE(bvh.intersect(ray, expected, &binary));
+    ASSERT_TRUE(wide.intersect(ray, hit, &four));
+    ASSERT_EQ(hit.primitive, expected.primitive) << r;
+  }
+  ASSERT_LT(four.nodes, binary.nodes * 0.6);
+
+  // One triangle: the root is a node with a single leaf lane
+  Bvh single;
+  BvhBuilder::binnedSah({{vertices.data(), sizeof(packed3), vertices.size(), indices.data(), 1}}, single);
+  Bvh8 wideSingle;
+  WideBuilder::collapse(single, wideSingle);
+  ASSERT_EQ(wideSingle.nodes.size(), 1);
+  ASSERT_TRUE(wideSingle.validate());
+  BvhRay ray;
+  ray.origin = {0.01f, 1.0f, 0.005f};
+  ray.direction = {0.0f, -1.0f, 0.0f};
+  BvhHit hit;
+  ASSERT_TRUE(wideSingle.intersect(ray, hit));
+  ASSERT_EQ(hit.primitive, 0);
+  Bvh4 empty;
+  ASSERT_EQ(WideBuilder::collapse(Bvh(), empty).nodes, 0);
+  ASSERT_FALSE(empty.intersect(ray, hit));
+}
@@ -0,0 +1,143 @@
+//
+// Headless BVH quality report: builds a CPU BVH over a mesh and prints SAH cost, EPO, node and leaf
+// counts, depth, memory and the leaf size histogram; optionally writes traversal heatmaps (TGA) seen
+// from a VCamera. With --max-sah / --max-epo it exits 1 past either, for CI.
+//
+//   EXPLORER_BVH_QUALITY f16/f16 --builder spatial --heatmap f16 --wide 8
+//
+#include <DB/ImageRepository.hpp>
+#include <DB/ObjRepository.hpp>
+#include <Renderer/HostBvhQuality.h>
+#include <Renderer/HostWideBvh.h>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+using Renderer::Host::Bvh;
+using Renderer::Host::BvhAnalyzer;
+using Renderer::Host::BvhBuilder;
+using Renderer::Host::BvhCounters;
+using Renderer::Host::BvhReport;
+using Renderer::Host::BvhSettings;
+
+static int usage() {
+  std::cerr << "Usage: EXPLORER_BVH_QUALITY <mesh.obj | name under Assets/Meshes> [options]\n"
+               "  --builder binned|spatial|linear  (binned)\n"
+               "  --leaf N                         maximum leaf size (8)\n"
+               "  --heatmap PREFIX                 write PREFIX_steps.tga and PREFIX_triangles.tga\n"
+               "  --wide 2|4|8                     tree the heatmaps traverse (2)\n"
+               "  --size W H                       heatmap resolution (1024 768)\n"
+               "  --camera OX OY OZ FX FY FZ HALF  origin, forward and half height; isometric and framed otherwise\n"
+               "  --scale STEPS                    count shown red, fixed to compare images (largest in the image)\n"
+               "  --max-sah X, --max-epo X         exit 1 when the tree is worse\n";
+  return 2;
+}
+
+template <typename Tree>
+static void heatmaps(const Tree& tree, const Renderer::Host::VCamera& camera, const std::string& prefix, float scale) {
+  const size_t pixels = (size_t)camera.resolution.x * (size_t)camera.resolution.y;
+  for (bool triangles : {false, true}) {
+    Renderer::Host::Image image;
+    Renderer::Host::HeatmapSettings settings;
+    settings.triangles = triangles;
+    settings.scale = scale;
+    const BvhCounters counters = BvhAnalyzer::heatmap(tree, camera, image, settings);
+    const std::string path = prefix + (triangles ? "_triangles.tga" : "_steps.tga");
+    std::string error;
+    if (!Repository::Images::write(path, image, &error)) {
+      std::cerr << error << std::endl;
+      continue;
+    }
+    std::cout << "  " << path << ": "
+              << (triangles ? (double)counters.triangles / pixels : (double)(counters.nodes + counters.leaves) / pixels)
+              << (triangles ? " triangles" : " steps") << " per ray" << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) return usage();
+  std::string mesh = argv[1], builder = "binned", prefix;
+  BvhSettings settings;
+  int wide = 2;
+  uint32_t width = 1024, height = 768;
+  float scale = 0.0f, maxSah = 0.0f, maxEpo = 0.0f;
+  bool framed = true;
+  Renderer::Host::VCamera camera = Renderer::Host::isometricCamera(width, height);
+
+  for (int i = 2; i < argc; i++) {
+    const std::string option = argv[i];
+    auto next = [&](int count) { return i + count < argc; };
+    if (option == "--builder" && next(1)) builder = argv[++i];
+    else if (option == "--leaf" && next(1)) settings.maxLeafSize = (uint32_t)std::atoi(argv[++i]);
+    else if (option == "--heatmap" && next(1)) prefix = argv[++i];
+    else if (option == "--wide" && next(1)) wide = std::atoi(argv[++i]);
+    else if (option == "--size" && next(2)) width = (uint32_t)std::atoi(argv[i + 1]), height = (uint32_t)std::atoi(argv[i + 2]), i += 2;
+    else if (option == "--scale" && next(1)) scale = (float)std::atof(argv[++i]);
+    else if (option == "--max-sah" && next(1)) maxSah = (float)std::atof(argv[++i]);
+    else if (option == "--max-epo" && next(1)) maxEpo = (float)std::atof(argv[++i]);
+    else if (option == "--camera" && next(7)) {
+      float v[7];
+      for (int k = 0; k < 7; k++) v[k] = (float)std::atof(argv[i + 1 + k]);
+      i += 7;
+      const EXP::MATH::float3 forward = EXP::MATH::normalize({v[3], v[4], v[5]}), up = {0.0f, 1.0f, 0.0f};
+      camera.vecOrigin = {v[0], v[1], v[2]};
+      camera.vecForward = EXP::MATH::p3(forward);
+      camera.vecRight = EXP::MATH::p3(EXP::MATH::cross(forward, up));
+      camera.vecUp = EXP::MATH::p3(up);
+      camera.fovScale = v[6];
+      framed = false;
+    } else return usage();
+  }
+  if (wide != 2 && wide != 4 && wide != 8) return usage();
+  if (width == 0 || height == 0) return usage();
+  camera.resolution = {(float)width, (float)height, 1.0f};
+
+  std::string path = mesh;
+  if (!std::filesystem::exists(path)) path = std::string(EXPLORER_ASSET_DIR) + "/Meshes/" + mesh + ".obj";
+  EXP::MDL::HostMesh hostMesh;
+  std::string error;
+  if (!Repository::Obj::read(path, hostMesh, &error)) {
+    std::cerr << error << std::endl;
+    return 2;
+  }
+
+  Bvh bvh;
+  BvhReport report;
+  if (builder == "binned") report = BvhBuilder::binnedSah(hostMesh, bvh, settings);
+  else if (builder == "spatial") report = BvhBuilder::spatial(hostMesh, bvh, settings);
+  else if (builder == "linear") report = BvhBuilder::linear(BvhBuilder::geometries(hostMesh), bvh, settings);
+  else return usage();
+
+  const Renderer::Host::BvhQuality quality = BvhAnalyzer::analyze(bvh, settings);
+  std::cout << mesh << ": " << bvh.triangleCount() << " triangles, " << builder << " build " << report.seconds * 1000.0
+            << " ms" << std::endl;
+  std::cout << "  SAH " << quality.sahCost << ", EPO " << quality.epo << ", " << quality.nodes << " nodes, "
+            << quality.leaves << " leaves, " << quality.references << " references, depth " << quality.depth << " ("
+            << quality.leafDepth << " mean leaf depth), " << quality.bytes / 1024 << " KB" << std::endl;
+  std::cout << "  leaf sizes:";
+  for (size_t n = 0; n < quality.leafSizes.size(); n++) {
+    if (quality.leafSizes[n]) std::cout << " " << n << ": " << quality.leafSizes[n];
+  }
+  std::cout << std::endl;
+
+  if (!prefix.empty()) {
+    if (framed) camera = Renderer::Host::frameCamera(camera, bvh.bounds());
+    if (wide == 2) heatmaps(bvh, camera, prefix, scale);
+    Renderer::Host::Bvh4 bvh4;
+    Renderer::Host::Bvh8 bvh8;
+    if (wide == 4) Renderer::Host::WideBuilder::collapse(bvh, bvh4), heatmaps(bvh4, camera, prefix, scale);
+    if (wide == 8) Renderer::Host::WideBuilder::collapse(bvh, bvh8), heatmaps(bvh8, camera, prefix, scale);
+  }
+
+  bool pass = true;
+  if (maxSah > 0.0f && quality.sahCost > maxSah) {
+    std::cerr << "SAH cost " << quality.sahCost << " is above " << maxSah << std::endl;
+    pass = false;
+  }
+  if (maxEpo > 0.0f && quality.epo > maxEpo) {
+    std::cerr << "EPO " << quality.epo << " is above " << maxEpo << std::endl;
+    pass = false;
+  }
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+//
+// Headless render of the ReSTIR scene: RayTraceLayer's models through the CPU port of temporal_reuse,
+// for machines without Metal. Renders a number of frames (the reservoirs carry over, as on the GPU),
+// prints the time, rays/s and load balance of each and writes the last one as a TGA.
+//
+//   EXPLORER_RESTIR --size 1512 825 --frames 4 --output restir.tga
+//
+#include <DB/ImageRepository.hpp>
+#include <DB/SceneRepository.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+static int usage() {
+  std::cerr << "Usage: EXPLORER_RESTIR [options]\n"
+               "  --size W H        resolution (3024 1650, the window's drawable)\n"
+               "  --frames N        frames to render, reservoirs reused between them (1)\n"
+               "  --threads N       pool threads to use, 0 for all (0)\n"
+               "  --tile N          tile edge in pixels (16)\n"
+               "  --rows            row bands over parallelFor instead of tiles\n"
+               "  --wavefront       stage by stage over waves of pixels, rays queued and binned\n"
+               "  --wave N          pixels per wave (65536)\n"
+               "  --unsorted        wavefront queues traced in pixel order, not binned\n"
+               "  --packets         wavefront queues traced in SIMD packets\n"
+               "  --closest-shadows shadow rays as closest hits checked against the light, not occlusion queries\n"
+               "  --output PATH     the last frame, TGA (restir.tga)\n"
+               "  --meshes DIR      mesh directory (Assets/Meshes)\n"
+               "  --cache DIR       .expbvh cache directory, none by default\n";
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  uint32_t width = 3024, height = 1650, frames = 1;
+  Renderer::Host::RestirSettings settings;
+  std::string output = "restir.tga", meshes = std::string(EXPLORER_ASSET_DIR) + "/Meshes", cache;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string option = argv[i];
+    auto next = [&](int count) { return i + count < argc; };
+    if (option == "--size" && next(2)) width = (uint32_t)std::atoi(argv[i + 1]), height = (uint32_t)std::atoi(argv[i + 2]), i += 2;
+    else if (option == "--frames" && next(1)) frames = (uint32_t)std::atoi(argv[++i]);
+    else if (option == "--threads" && next(1)) settings.threads = (unsigned int)std::atoi(argv[++i]);
+    else if (option == "--tile" && next(1)) settings.tiles.size = (uint32_t)std::atoi(argv[++i]);
+    else if (option == "--rows") settings.tiled = false;
+    else if (option == "--wavefront") settings.wavefront = true;
+    else if (option == "--wave" && next(1)) settings.queues.wave = (uint32_t)std::atoi(argv[++i]);
+    else if (option == "--unsorted") settings.queues.sort = false;
+    else if (option == "--packets") settings.queues.isa = Renderer::Host::PacketTracer::best();
+    else if (option == "--closest-shadows") settings.occlusion = false;
+    else if (option == "--output" && next(1)) output = argv[++i];
+    else if (option == "--meshes" && next(1)) meshes = argv[++i];
+    else if (option == "--cache" && next(1)) cache = argv[++i];
+    else return usage();
+  }
+  if (width == 0 || height == 0 || frames == 0 || settings.tiles.size == 0 || settings.queues.wave == 0) return usage();
+
+  Repository::HostScene scene;
+  std::string error;
+  if (!Repository::Scenes::load(Repository::Scenes::showcase(meshes), scene, cache, &error)) {
+    std::cerr << error << std::endl;
+    return 2;
+  }
+  scene.restir.camera = Renderer::Host::isometricCamera(width, height);
+  size_t triangles = 0;
+  for (const EXP::MDL::HostMesh& mesh : scene.meshes) triangles += mesh.triangleCount();
+  std::cout << scene.meshes.size() << " models, " << triangles << " triangles, " << scene.restir.light.vertices.size()
+            << " light vertices, " << width << " x " << height << std::endl;
+
+  Renderer::Host::RestirRenderer renderer;
+  Renderer::Host::Image image;
+  double total = 0.0;
+  uint64_t rays = 0;
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    const Renderer::Host::RestirStats stats = renderer.render(scene.restir, image, settings);
+    total += stats.seconds, rays += stats.rays();
+    std::cout << "  frame " << frame << ": " << stats.seconds * 1000.0 << " ms, " << stats.raysPerSecond() / 1e6
+              << " Mrays/s (" << (double)stats.rays() / stats.pixels << " rays per pixel: " << stats.primaryRays
+              << " primary, " << stats.shadowRays << " shadow, " << stats.bounceRays << " bounce)" << std::endl;
+    if (settings.wavefront) {
+      const Renderer::Host::WavefrontStats& queues = stats.wavefront;
+      std::cout << "    " << queues.waves << " waves, " << queues.queues << " queues: binning " << queues.binSeconds * 1000.0
+                << " ms, tracing " << queues.traceSeconds * 1000.0 << " ms, shading " << queues.shadeSeconds * 1000.0 << " ms"
+                << std::endl;
+    } else if (settings.tiled) {
+      std::cout << "    " << stats.tiles.tiles << " tiles on " << stats.tiles.workers.size() << " workers, imbalance "
+                << stats.tiles.imbalance() << ", efficiency " << 100.0 * stats.tiles.efficiency() << "%, "
+                << stats.tiles.steals() << " steals (" << stats.tiles.stolen() << " tiles)" << std::endl;
+    }
+  }
+  std::cout << "  mean " << total / frames * 1000.0 << " ms per frame, " << rays / total / 1e6 << " Mrays/s" << std::endl;
+
+  if (!Repository::Images::write(output, image, &error)) {
+    std::cerr << error << std::endl;
+    return 2;
+  }
+  std::cout << "  " << output << std::endl;
+  return 0;
+}